@@ -0,0 +1,447 @@
+#include "binaryClientAction.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdio.h>
+
+
+
+static void appendVarint( SimpleVector<unsigned char> *ioBuffer,
+                          unsigned int inValue ) {
+    while( inValue >= 0x80 ) {
+        ioBuffer->push_back( (unsigned char)( inValue | 0x80 ) );
+        inValue >>= 7;
+        }
+    ioBuffer->push_back( (unsigned char)inValue );
+    }
+
+
+
+static void appendSignedVarint( SimpleVector<unsigned char> *ioBuffer,
+                                int inValue ) {
+    appendVarint( ioBuffer,
+                  ( (unsigned int)inValue << 1 ) ^
+                  (unsigned int)( inValue >> 31 ) );
+    }
+
+
+
+typedef struct ActionName {
+        const char *name;
+        int code;
+    } ActionName;
+
+
+static ActionName actionNames[] = {
+    { "MOVE", BINARY_ACTION_MOVE },
+    { "USE", BINARY_ACTION_USE },
+    { "SELF", BINARY_ACTION_SELF },
+    { "BABY", BINARY_ACTION_BABY },
+    { "UBABY", BINARY_ACTION_UBABY },
+    { "REMV", BINARY_ACTION_REMV },
+    { "SREMV", BINARY_ACTION_SREMV },
+    { "DROP", BINARY_ACTION_DROP },
+    { "SWAP", BINARY_ACTION_SWAP },
+    { "KILL", BINARY_ACTION_KILL },
+    { "SAY", BINARY_ACTION_SAY },
+    { "EMOT", BINARY_ACTION_EMOT },
+    { "JUMP", BINARY_ACTION_JUMP } };
+
+static int numActionNames = sizeof( actionNames ) / sizeof( ActionName );
+
+
+
+// end of message text, ignoring # terminator
+// returns NULL if there's anything after the terminator
+static const char *findMessageEnd( const char *inMessage ) {
+    const char *end = strchr( inMessage, '#' );
+
+    if( end == NULL ) {
+        return inMessage + strlen( inMessage );
+        }
+    if( end[1] != '\0' ) {
+        return NULL;
+        }
+    return end;
+    }
+
+
+
+static char isIntStart( char inC ) {
+    return inC == '-' || ( inC >= '0' && inC <= '9' );
+    }
+
+
+
+// reads one integer token at *ioPos, and the single space after it, if any
+// only accepts tokens that text parsing would read the same way
+static char readIntToken( const char **ioPos, const char *inEnd,
+                          int *outValue ) {
+    const char *start = *ioPos;
+
+    if( start >= inEnd || ! isIntStart( *start ) ) {
+        return false;
+        }
+
+    char *tokenEnd;
+    long value = strtol( start, &tokenEnd, 10 );
+
+    if( tokenEnd == start || tokenEnd > inEnd ||
+        ( tokenEnd < inEnd && *tokenEnd != ' ' ) ||
+        value > INT_MAX || value < INT_MIN ) {
+        return false;
+        }
+
+    *outValue = (int)value;
+
+    *ioPos = tokenEnd;
+
+    if( *ioPos < inEnd ) {
+        // skip single separator, which can't be the last character
+        ( *ioPos )++;
+
+        if( *ioPos == inEnd ) {
+            return false;
+            }
+        }
+    return true;
+    }
+
+
+
+char encodeBinaryClientAction( const char *inMessage,
+                               SimpleVector<unsigned char> *outFrame ) {
+
+    const char *end = findMessageEnd( inMessage );
+
+    if( end == NULL ) {
+        return false;
+        }
+
+    const char *nameEnd = strchr( inMessage, ' ' );
+
+    if( nameEnd == NULL || nameEnd > end ) {
+        return false;
+        }
+
+    int nameLength = nameEnd - inMessage;
+
+    int code = -1;
+
+    for( int i=0; i<numActionNames; i++ ) {
+        if( (int)strlen( actionNames[i].name ) == nameLength &&
+            strncmp( actionNames[i].name, inMessage, nameLength ) == 0 ) {
+            code = actionNames[i].code;
+            break;
+            }
+        }
+
+    if( code == -1 ) {
+        return false;
+        }
+
+
+    const char *pos = nameEnd + 1;
+
+    int x, y;
+
+    if( ! readIntToken( &pos, end, &x ) ) {
+        return false;
+        }
+
+    if( code == BINARY_ACTION_SAY ) {
+        // text starts after the space that follows y
+        // no text at all is different from empty text, and is left to
+        // the text protocol
+        const char *yStart = pos;
+
+        char *yEnd;
+        long yValue = strtol( yStart, &yEnd, 10 );
+
+        if( yEnd == yStart || ! isIntStart( *yStart ) ||
+            *yEnd != ' ' || yEnd >= end ||
+            yValue > INT_MAX || yValue < INT_MIN ) {
+            return false;
+            }
+        y = (int)yValue;
+        pos = yEnd + 1;
+        }
+    else if( ! readIntToken( &pos, end, &y ) ) {
+        return false;
+        }
+
+
+    SimpleVector<unsigned char> body;
+
+    body.push_back( (unsigned char)code );
+    appendSignedVarint( &body, x );
+    appendSignedVarint( &body, y );
+
+    if( code == BINARY_ACTION_SAY ) {
+        appendVarint( &body, 0 );
+
+        body.appendArray( (unsigned char*)pos, end - pos );
+        }
+    else if( code == BINARY_ACTION_MOVE ) {
+        appendVarint( &body, 0 );
+
+        int sequenceNumber = -1;
+
+        if( pos < end && *pos == '@' ) {
+            pos++;
+            if( ! readIntToken( &pos, end, &sequenceNumber ) ) {
+                return false;
+                }
+            }
+        appendSignedVarint( &body, sequenceNumber );
+
+        SimpleVector<unsigned char> steps;
+
+        while( pos < end ) {
+            int d;
+            if( ! readIntToken( &pos, end, &d ) ||
+                d < -128 || d > 127 ) {
+                return false;
+                }
+            steps.push_back( (unsigned char)(signed char)d );
+            }
+
+        if( steps.size() == 0 || steps.size() % 2 != 0 ) {
+            return false;
+            }
+
+        appendVarint( &body, steps.size() / 2 );
+        body.appendArray( steps.getElement( 0 ), steps.size() );
+        }
+    else {
+        int fields[ BINARY_CLIENT_ACTION_MAX_FIELDS ];
+        int numFields = 0;
+
+        while( pos < end ) {
+            if( numFields == BINARY_CLIENT_ACTION_MAX_FIELDS ||
+                ! readIntToken( &pos, end, &( fields[ numFields ] ) ) ) {
+                return false;
+                }
+            numFields++;
+            }
+
+        appendVarint( &body, numFields );
+        for( int i=0; i<numFields; i++ ) {
+            appendSignedVarint( &body, fields[i] );
+            }
+        }
+
+    if( body.size() > BINARY_CLIENT_ACTION_MAX_BODY ) {
+        return false;
+        }
+
+    outFrame->push_back( BINARY_CLIENT_ACTION_MARKER );
+    appendVarint( outFrame, body.size() );
+    outFrame->appendArray( body.getElement( 0 ), body.size() );
+
+    return true;
+    }
+
+
+
+binaryClientFrameStatus findBinaryClientActionFrame(
+    const unsigned char *inData, int inLength,
+    int *outBodyStart, int *outBodyLength ) {
+
+    if( inLength < 1 || inData[0] != BINARY_CLIENT_ACTION_MARKER ) {
+        return BINARY_FRAME_NONE;
+        }
+
+    unsigned int bodyLength = 0;
+    int shift = 0;
+    int pos = 1;
+
+    while( true ) {
+        if( pos >= inLength ) {
+            return BINARY_FRAME_PARTIAL;
+            }
+        unsigned char byte = inData[ pos ];
+        pos++;
+
+        bodyLength |= (unsigned int)( byte & 0x7F ) << shift;
+
+        if( bodyLength > BINARY_CLIENT_ACTION_MAX_BODY ) {
+            return BINARY_FRAME_BAD;
+            }
+
+        if( ! ( byte & 0x80 ) ) {
+            break;
+            }
+        shift += 7;
+
+        if( shift > 14 ) {
+            // over-long encoding of a small length
+            return BINARY_FRAME_BAD;
+            }
+        }
+
+    if( bodyLength == 0 ) {
+        return BINARY_FRAME_BAD;
+        }
+
+    if( inLength - pos < (int)bodyLength ) {
+        return BINARY_FRAME_PARTIAL;
+        }
+
+    *outBodyStart = pos;
+    *outBodyLength = (int)bodyLength;
+
+    return BINARY_FRAME_READY;
+    }
+
+
+
+typedef struct BinaryReader {
+        const unsigned char *data;
+        int length;
+        int pos;
+        char error;
+    } BinaryReader;
+
+
+
+static unsigned int readVarint( BinaryReader *inReader ) {
+    unsigned int value = 0;
+    int shift = 0;
+
+    while( true ) {
+        if( inReader->pos >= inReader->length || shift > 28 ) {
+            inReader->error = true;
+            return 0;
+            }
+        unsigned char byte = inReader->data[ inReader->pos ];
+        inReader->pos++;
+
+        value |= (unsigned int)( byte & 0x7F ) << shift;
+
+        if( ! ( byte & 0x80 ) ) {
+            return value;
+            }
+        shift += 7;
+        }
+    }
+
+
+
+static int readSignedVarint( BinaryReader *inReader ) {
+    unsigned int v = readVarint( inReader );
+
+    return (int)( v >> 1 ) ^ -(int)( v & 1 );
+    }
+
+
+
+char decodeBinaryClientAction( const unsigned char *inBody, int inLength,
+                               BinaryClientAction *outAction ) {
+
+    BinaryReader reader = { inBody, inLength, 0, false };
+
+    if( inLength < 1 ) {
+        return false;
+        }
+
+    outAction->code = inBody[0];
+    reader.pos = 1;
+
+    if( outAction->code < BINARY_ACTION_MOVE ||
+        outAction->code > BINARY_ACTION_JUMP ) {
+        return false;
+        }
+
+    outAction->x = readSignedVarint( &reader );
+    outAction->y = readSignedVarint( &reader );
+
+    unsigned int numFields = readVarint( &reader );
+
+    if( reader.error || numFields > BINARY_CLIENT_ACTION_MAX_FIELDS ) {
+        return false;
+        }
+    outAction->numFields = numFields;
+
+    for( unsigned int i=0; i<numFields; i++ ) {
+        outAction->fields[i] = readSignedVarint( &reader );
+        }
+
+    outAction->sequenceNumber = -1;
+    outAction->numSteps = 0;
+    outAction->steps = NULL;
+    outAction->text = NULL;
+    outAction->textLength = 0;
+
+    if( outAction->code == BINARY_ACTION_MOVE ) {
+        outAction->sequenceNumber = readSignedVarint( &reader );
+
+        unsigned int numSteps = readVarint( &reader );
+
+        if( reader.error ||
+            numSteps == 0 ||
+            numSteps != (unsigned int)( reader.length - reader.pos ) / 2 ) {
+            return false;
+            }
+        outAction->numSteps = numSteps;
+        outAction->steps = (const signed char*)&( inBody[ reader.pos ] );
+
+        reader.pos += numSteps * 2;
+        }
+    else if( outAction->code == BINARY_ACTION_SAY ) {
+        if( reader.error ) {
+            return false;
+            }
+        outAction->text = (const char*)&( inBody[ reader.pos ] );
+        outAction->textLength = reader.length - reader.pos;
+
+        reader.pos = reader.length;
+        }
+
+    // every byte of body must be used
+    if( reader.error || reader.pos != reader.length ) {
+        return false;
+        }
+
+    return true;
+    }
+
+
+
+void getBinaryClientActionText( BinaryClientAction *inAction,
+                                char *outText ) {
+    int pos = 0;
+
+    for( int i=0; i<numActionNames; i++ ) {
+        if( actionNames[i].code == inAction->code ) {
+            pos += sprintf( &( outText[ pos ] ), "%s", actionNames[i].name );
+            break;
+            }
+        }
+
+    pos += sprintf( &( outText[ pos ] ), " %d %d", inAction->x, inAction->y );
+
+    for( int i=0; i<inAction->numFields; i++ ) {
+        pos += sprintf( &( outText[ pos ] ), " %d", inAction->fields[i] );
+        }
+
+    if( inAction->code == BINARY_ACTION_MOVE ) {
+        if( inAction->sequenceNumber != -1 ) {
+            pos += sprintf( &( outText[ pos ] ), " @%d",
+                            inAction->sequenceNumber );
+            }
+        for( int i=0; i<inAction->numSteps * 2; i++ ) {
+            pos += sprintf( &( outText[ pos ] ), " %d", inAction->steps[i] );
+            }
+        }
+    else if( inAction->code == BINARY_ACTION_SAY ) {
+        outText[ pos ] = ' ';
+        pos++;
+        memcpy( &( outText[ pos ] ), inAction->text, inAction->textLength );
+        pos += inAction->textLength;
+        }
+
+    outText[ pos ] = '#';
+    outText[ pos + 1 ] = '\0';
+    }
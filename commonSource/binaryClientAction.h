@@ -0,0 +1,137 @@
+#ifndef BINARY_CLIENT_ACTION_H_INCLUDED
+#define BINARY_CLIENT_ACTION_H_INCLUDED
+
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// Compact binary framing for the most common client-to-server actions,
+// shared by client (encode) and server (decode).
+//
+// Only used by clients that add BINARY_CLIENT_ACTION_TAG to the end of
+// their LOGIN client tag, and only once the server has echoed the tag back
+// on the line after ACCEPTED.  Binary frames and # terminated text messages
+// can be mixed freely on the same connection, so actions not covered here
+// (and anything the encoder can't represent exactly) are still sent as
+// text.
+//
+// Frame layout, integers are LEB128 varints, signed ones zig-zag encoded:
+//
+//   marker byte BINARY_CLIENT_ACTION_MARKER
+//     (text messages always start with a printable character)
+//   body length
+//   body:
+//     action code byte
+//     x, y (signed)
+//     number of extra fields, then each field (signed), in the order
+//       they appear in the text message
+//     MOVE only:
+//       sequence number (signed, -1 if none)
+//       number of steps
+//       two signed bytes per step, dx then dy, relative to x y
+//     SAY only:
+//       rest of body is the said text, not terminated
+
+
+#define BINARY_CLIENT_ACTION_TAG "+acb"
+
+#define BINARY_CLIENT_ACTION_MARKER 0xB1
+
+// bigger bodies are treated as malformed
+#define BINARY_CLIENT_ACTION_MAX_BODY 4096
+
+#define BINARY_CLIENT_ACTION_MAX_FIELDS 4
+
+
+enum binaryClientActionCode {
+    BINARY_ACTION_MOVE = 1,
+    BINARY_ACTION_USE,
+    BINARY_ACTION_SELF,
+    BINARY_ACTION_BABY,
+    BINARY_ACTION_UBABY,
+    BINARY_ACTION_REMV,
+    BINARY_ACTION_SREMV,
+    BINARY_ACTION_DROP,
+    BINARY_ACTION_SWAP,
+    BINARY_ACTION_KILL,
+    BINARY_ACTION_SAY,
+    BINARY_ACTION_EMOT,
+    BINARY_ACTION_JUMP
+    };
+
+
+
+// inMessage is a text client message, with or without its # terminator
+// appends a whole frame to outFrame
+//
+// returns false, and appends nothing, if message is of a type not covered
+// here, or can't be represented exactly (non-numeric fields, path steps
+// outside of a signed byte, too long)
+char encodeBinaryClientAction( const char *inMessage,
+                               SimpleVector<unsigned char> *outFrame );
+
+
+
+enum binaryClientFrameStatus {
+    // data doesn't start with a frame marker (or is empty)
+    BINARY_FRAME_NONE,
+    // frame started, but not all of it has arrived yet
+    BINARY_FRAME_PARTIAL,
+    BINARY_FRAME_READY,
+    // bad length, can't find the start of the next message
+    BINARY_FRAME_BAD
+    };
+
+
+// looks for a frame at the start of inData
+// outBodyStart and outBodyLength only set if result is BINARY_FRAME_READY
+// whole frame is outBodyStart + outBodyLength bytes long
+binaryClientFrameStatus findBinaryClientActionFrame(
+    const unsigned char *inData, int inLength,
+    int *outBodyStart, int *outBodyLength );
+
+
+
+// decoded frame body
+// steps and text point into the body that was decoded
+typedef struct BinaryClientAction {
+        int code;
+        int x, y;
+
+        int numFields;
+        int fields[ BINARY_CLIENT_ACTION_MAX_FIELDS ];
+
+        // MOVE only
+        int sequenceNumber;
+        int numSteps;
+        const signed char *steps;
+
+        // SAY only
+        const char *text;
+        int textLength;
+    } BinaryClientAction;
+
+
+// returns false if body is malformed
+char decodeBinaryClientAction( const unsigned char *inBody, int inLength,
+                               BinaryClientAction *outAction );
+
+
+// longest text getBinaryClientActionText can write, including terminators
+// each path step byte becomes at most 5 characters (" -128"), and the
+// other values, at most 7 of them, at most 12 each
+#define BINARY_CLIENT_ACTION_MAX_TEXT \
+    ( BINARY_CLIENT_ACTION_MAX_BODY * 5 + 128 )
+
+
+// writes the text message that a decoded action was encoded from,
+// with its # terminator, into outText, for logging
+//
+// outText must hold BINARY_CLIENT_ACTION_MAX_TEXT bytes
+// no memory is allocated
+void getBinaryClientActionText( BinaryClientAction *inAction,
+                                char *outText );
+
+
+#endif
@@ -0,0 +1,347 @@
+#include "binaryMapChunk.h"
+
+#include <string.h>
+
+
+
+static void appendVarint( SimpleVector<unsigned char> *ioBuffer,
+                          unsigned int inValue ) {
+    while( inValue >= 0x80 ) {
+        ioBuffer->push_back( (unsigned char)( inValue | 0x80 ) );
+        inValue >>= 7;
+        }
+    ioBuffer->push_back( (unsigned char)inValue );
+    }
+
+
+
+// maps small negative numbers (like -1 for unknown biome) to small
+// unsigned numbers
+static void appendSignedVarint( SimpleVector<unsigned char> *ioBuffer,
+                                int inValue ) {
+    appendVarint( ioBuffer, 
+                  ( (unsigned int)inValue << 1 ) ^ 
+                  (unsigned int)( inValue >> 31 ) );
+    }
+
+
+
+static void appendBitmap( SimpleVector<unsigned char> *ioBuffer,
+                          unsigned char *inBits, int inNumBits ) {
+    int numBytes = ( inNumBits + 7 ) / 8;
+    
+    for( int b=0; b<numBytes; b++ ) {
+        unsigned char byte = 0;
+        
+        for( int i=0; i<8; i++ ) {
+            int bitIndex = b * 8 + i;
+            
+            if( bitIndex < inNumBits && inBits[ bitIndex ] ) {
+                byte |= (unsigned char)( 1 << i );
+                }
+            }
+        ioBuffer->push_back( byte );
+        }
+    }
+
+
+
+static void appendRunLengthLayer( SimpleVector<unsigned char> *ioBuffer,
+                                  SimpleVector<int> *inValues ) {
+    int numValues = inValues->size();
+    
+    int i = 0;
+    while( i < numValues ) {
+        int value = inValues->getElementDirect( i );
+        
+        int run = 1;
+        while( i + run < numValues && 
+               inValues->getElementDirect( i + run ) == value ) {
+            run++;
+            }
+        
+        appendVarint( ioBuffer, run );
+        appendSignedVarint( ioBuffer, value );
+
+        i += run;
+        }
+    }
+
+
+
+void encodeBinaryMapChunk( int inNumCells,
+                           unsigned char *inUnchangedCells,
+                           int *inBiomes, int *inFloors, int *inObjects,
+                           int *inContainedStackSizes,
+                           int **inContainedStacks,
+                           int **inSubContainedStackSizes,
+                           int ***inSubContainedStacks,
+                           SimpleVector<unsigned char> *outBuffer ) {
+    
+    unsigned char flags = 0;
+    
+    if( inUnchangedCells != NULL ) {
+        flags |= BINARY_MAP_CHUNK_UNCHANGED_FLAG;
+        }
+    
+    outBuffer->push_back( flags );
+    
+    if( inUnchangedCells != NULL ) {
+        appendBitmap( outBuffer, inUnchangedCells, inNumCells );
+        }
+    
+
+    SimpleVector<int> sentCells( inNumCells );
+    
+    for( int i=0; i<inNumCells; i++ ) {
+        if( inUnchangedCells == NULL || ! inUnchangedCells[i] ) {
+            sentCells.push_back( i );
+            }
+        }
+    
+    int numSent = sentCells.size();
+    
+    
+    SimpleVector<int> layer( numSent );
+    
+    for( int s=0; s<numSent; s++ ) {
+        layer.push_back( inBiomes[ sentCells.getElementDirect( s ) ] );
+        }
+    appendRunLengthLayer( outBuffer, &layer );
+    
+    layer.deleteAll();
+    
+    for( int s=0; s<numSent; s++ ) {
+        layer.push_back( inFloors[ sentCells.getElementDirect( s ) ] );
+        }
+    appendRunLengthLayer( outBuffer, &layer );
+    
+
+    unsigned char *occupied = new unsigned char[ numSent + 1 ];
+    
+    for( int s=0; s<numSent; s++ ) {
+        occupied[s] = ( inObjects[ sentCells.getElementDirect( s ) ] != 0 );
+        }
+    appendBitmap( outBuffer, occupied, numSent );
+    
+    
+    for( int s=0; s<numSent; s++ ) {
+        if( ! occupied[s] ) {
+            continue;
+            }
+        int i = sentCells.getElementDirect( s );
+        
+        appendVarint( outBuffer, inObjects[i] );
+
+        if( inContainedStacks[i] == NULL ) {
+            appendVarint( outBuffer, 0 );
+            continue;
+            }
+        
+        appendVarint( outBuffer, inContainedStackSizes[i] );
+
+        for( int c=0; c<inContainedStackSizes[i]; c++ ) {
+            appendVarint( outBuffer, inContainedStacks[i][c] );
+            
+            if( inSubContainedStacks[i][c] == NULL ) {
+                appendVarint( outBuffer, 0 );
+                continue;
+                }
+            
+            appendVarint( outBuffer, inSubContainedStackSizes[i][c] );
+            
+            for( int u=0; u<inSubContainedStackSizes[i][c]; u++ ) {
+                appendVarint( outBuffer, inSubContainedStacks[i][c][u] );
+                }
+            }
+        }
+    
+    delete [] occupied;
+    }
+
+
+
+typedef struct BinaryReader {
+        unsigned char *data;
+        int length;
+        int pos;
+        char error;
+    } BinaryReader;
+
+
+
+static unsigned int readVarint( BinaryReader *inReader ) {
+    unsigned int value = 0;
+    int shift = 0;
+    
+    while( true ) {
+        if( inReader->pos >= inReader->length || shift > 28 ) {
+            inReader->error = true;
+            return 0;
+            }
+        unsigned char byte = inReader->data[ inReader->pos ];
+        inReader->pos++;
+        
+        value |= (unsigned int)( byte & 0x7F ) << shift;
+        
+        if( ! ( byte & 0x80 ) ) {
+            return value;
+            }
+        shift += 7;
+        }
+    }
+
+
+
+static int readSignedVarint( BinaryReader *inReader ) {
+    unsigned int v = readVarint( inReader );
+    
+    return (int)( v >> 1 ) ^ -(int)( v & 1 );
+    }
+
+
+
+static void readBitmap( BinaryReader *inReader, 
+                        unsigned char *outBits, int inNumBits ) {
+    int numBytes = ( inNumBits + 7 ) / 8;
+    
+    if( inReader->pos + numBytes > inReader->length ) {
+        inReader->error = true;
+        return;
+        }
+    
+    for( int i=0; i<inNumBits; i++ ) {
+        unsigned char byte = inReader->data[ inReader->pos + i / 8 ];
+        
+        outBits[i] = ( byte >> ( i % 8 ) ) & 1;
+        }
+    inReader->pos += numBytes;
+    }
+
+
+
+static void readRunLengthLayer( BinaryReader *inReader,
+                                int *outValues, int inNumValues ) {
+    int i = 0;
+    while( i < inNumValues && ! inReader->error ) {
+        unsigned int run = readVarint( inReader );
+        int value = readSignedVarint( inReader );
+        
+        if( run == 0 || run > (unsigned int)( inNumValues - i ) ) {
+            inReader->error = true;
+            return;
+            }
+        for( unsigned int r=0; r<run; r++ ) {
+            outValues[i] = value;
+            i++;
+            }
+        }
+    }
+
+
+
+char decodeBinaryMapChunk( unsigned char *inData, int inLength,
+                           int inNumCells,
+                           unsigned char *outUnchanged,
+                           MapChunkCell *outCells ) {
+    
+    BinaryReader reader = { inData, inLength, 0, false };
+    
+    if( inLength < 1 ) {
+        return false;
+        }
+    
+    unsigned char flags = inData[0];
+    reader.pos = 1;
+    
+    if( flags & BINARY_MAP_CHUNK_UNCHANGED_FLAG ) {
+        readBitmap( &reader, outUnchanged, inNumCells );
+        }
+    else {
+        memset( outUnchanged, 0, inNumCells );
+        }
+    
+    if( reader.error ) {
+        return false;
+        }
+    
+
+    int *sentCells = new int[ inNumCells + 1 ];
+    int numSent = 0;
+
+    for( int i=0; i<inNumCells; i++ ) {
+        if( ! outUnchanged[i] ) {
+            sentCells[ numSent ] = i;
+            numSent++;
+            }
+        }
+
+    int *layer = new int[ numSent + 1 ];
+    
+    readRunLengthLayer( &reader, layer, numSent );
+    
+    for( int s=0; s<numSent && ! reader.error; s++ ) {
+        outCells[ sentCells[s] ].biome = layer[s];
+        }
+    
+    readRunLengthLayer( &reader, layer, numSent );
+    
+    for( int s=0; s<numSent && ! reader.error; s++ ) {
+        outCells[ sentCells[s] ].floor = layer[s];
+        }
+    
+    delete [] layer;
+    
+
+    unsigned char *occupied = new unsigned char[ numSent + 1 ];
+    
+    if( ! reader.error ) {
+        readBitmap( &reader, occupied, numSent );
+        }
+    
+    for( int s=0; s<numSent && ! reader.error; s++ ) {
+        MapChunkCell *cell = &( outCells[ sentCells[s] ] );
+        
+        cell->object = 0;
+        cell->contained.deleteAll();
+        cell->subContained.deleteAll();
+        
+        if( ! occupied[s] ) {
+            continue;
+            }
+        
+        cell->object = readVarint( &reader );
+        
+        unsigned int numContained = readVarint( &reader );
+        
+        if( numContained > (unsigned int)inLength ) {
+            reader.error = true;
+            break;
+            }
+        
+        for( unsigned int c=0; c<numContained && ! reader.error; c++ ) {
+            cell->contained.push_back( readVarint( &reader ) );
+            
+            SimpleVector<int> subStack;
+            cell->subContained.push_back( subStack );
+            
+            unsigned int numSub = readVarint( &reader );
+            
+            if( numSub > (unsigned int)inLength ) {
+                reader.error = true;
+                break;
+                }
+            
+            SimpleVector<int> *sub = cell->subContained.getElement( c );
+            
+            for( unsigned int u=0; u<numSub && ! reader.error; u++ ) {
+                sub->push_back( readVarint( &reader ) );
+                }
+            }
+        }
+    
+    delete [] occupied;
+    delete [] sentCells;
+    
+    return ! reader.error;
+    }
@@ -0,0 +1,103 @@
+#ifndef BINARY_MAP_CHUNK_H_INCLUDED
+#define BINARY_MAP_CHUNK_H_INCLUDED
+
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// Compact binary body for map chunk messages, shared by server (encode)
+// and client (decode).
+//
+// Sent with an MB header instead of MC (same header fields), and zipped
+// just like MC text bodies.  Only sent to clients that ask for it by adding
+// BINARY_MAP_CHUNK_CLIENT_TAG to the end of their LOGIN client tag.
+//
+// Body layout, all integers are LEB128 varints:
+//
+//   flags byte
+//     bit 0 set if an unchanged-cell bitmap follows
+//
+//   unchanged-cell bitmap (if flag set), one bit per cell, LSB first
+//     set bits mark cells that are the same as the last time they were
+//     sent to this client, and that are not sent again.
+//     Client pulls these from its own MapChunkCache.
+//
+//   all following layers cover only the cells that ARE sent, in row order
+//
+//   biome layer, run-length encoded as (run length, zig-zag value) pairs
+//   floor layer, run-length encoded the same way
+//
+//   occupied bitmap, one bit per sent cell, set if cell has an object
+//
+//   for each occupied cell:
+//     object ID
+//     number of contained items
+//     for each contained item:
+//       contained ID
+//       number of sub-contained items
+//       sub-contained IDs
+
+
+#define BINARY_MAP_CHUNK_CLIENT_TAG "+mcb"
+
+#define BINARY_MAP_CHUNK_UNCHANGED_FLAG 1
+
+
+
+// Both ends remember the last-sent contents of a 128x128 window of cells,
+// direct-mapped by position, with each sent cell replacing what was
+// in its slot.  Since both ends apply the same replacements in the same
+// order, they always agree about what is in each slot.
+//
+// Coordinates are as sent in chunk headers, relative to the client's
+// birth position.
+#define MAP_CHUNK_CACHE_D 128
+
+
+inline int getMapChunkCacheSlot( int inX, int inY ) {
+    // works for negative coordinates too
+    int slotX = inX & ( MAP_CHUNK_CACHE_D - 1 );
+    int slotY = inY & ( MAP_CHUNK_CACHE_D - 1 );
+    
+    return slotY * MAP_CHUNK_CACHE_D + slotX;
+    }
+
+
+
+// inUnchangedCells can be NULL if client has none of these cells
+// appends encoded body to outBuffer
+void encodeBinaryMapChunk( int inNumCells,
+                           unsigned char *inUnchangedCells,
+                           int *inBiomes, int *inFloors, int *inObjects,
+                           int *inContainedStackSizes,
+                           int **inContainedStacks,
+                           int **inSubContainedStackSizes,
+                           int ***inSubContainedStacks,
+                           SimpleVector<unsigned char> *outBuffer );
+
+
+
+// one decoded cell, as stored in client's map
+typedef struct MapChunkCell {
+        int biome;
+        int floor;
+        int object;
+        SimpleVector<int> contained;
+        SimpleVector< SimpleVector<int> > subContained;
+    } MapChunkCell;
+
+
+
+// decodes body into outCells, which has inNumCells elements
+// outUnchanged gets 1 for each cell that was not sent (and 0 for the rest),
+// and the matching outCells entries are left untouched
+//
+// returns false if body is malformed
+char decodeBinaryMapChunk( unsigned char *inData, int inLength,
+                           int inNumCells,
+                           unsigned char *outUnchanged,
+                           MapChunkCell *outCells );
+
+
+#endif
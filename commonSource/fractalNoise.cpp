@@ -1,5 +1,6 @@
 #include <stdarg.h>
 #include <math.h>
+#include <string.h>
 
 #include "fractalNoise.h"
 
@@ -11,14 +12,21 @@
 #define XX_PRIME32_5 374761393U
 
 
-static uint32_t xxSeedA = 0U;
-static uint32_t xxSeedB = 0U;
+// global seed used by the non-reentrant calls
+static XYRandomSeed xxSeed = { 0U, 0U };
 
 
 
 void setXYRandomSeed( uint32_t inSeedA, uint32_t inSeedB ) {
-    xxSeedA = inSeedA;
-    xxSeedB = inSeedB;
+    xxSeed.a = inSeedA;
+    xxSeed.b = inSeedB;
+    }
+
+
+
+XYRandomSeed makeXYRandomSeed( uint32_t inSeedA, uint32_t inSeedB ) {
+    XYRandomSeed s = { inSeedA, inSeedB };
+    return s;
     }
 
 
@@ -60,15 +68,16 @@ static uint32_t xxHash2D( uint32_t inX, uint32_t inY ) {
 
 // tweaked to be faster by removing lines that don't seem to matter
 // for procedural content generation
-static uint32_t xxTweakedHash2D( uint32_t inX, uint32_t inY ) {
-    uint32_t h32 = xxSeedA + inX + XX_PRIME32_5;
+static inline uint32_t xxTweakedHash2D( XYRandomSeed inSeed, 
+                                        uint32_t inX, uint32_t inY ) {
+    uint32_t h32 = inSeed.a + inX + XX_PRIME32_5;
     //h32 += 4U;
     h32 += inY * XX_PRIME32_3;
     //h32 = XX_ROTATE_LEFT( h32, 17 ) * XX_PRIME32_4;
     //h32 ^= h32 >> 15;
     h32 *= XX_PRIME32_2;
     h32 ^= h32 >> 13;
-    h32 += xxSeedB;
+    h32 += inSeed.b;
     h32 *= XX_PRIME32_3;
     h32 ^= h32 >> 16;
     return h32;
@@ -78,14 +87,20 @@ static uint32_t xxTweakedHash2D( uint32_t inX, uint32_t inY ) {
 static double oneOverIntMax = 1.0 / ( (double)4294967295U );
 
 
+double getXYRandom( XYRandomSeed inSeed, int inX, int inY ) {
+    return xxTweakedHash2D( inSeed, inX, inY ) * oneOverIntMax;
+    }
+
+
+
 double getXYRandom( int inX, int inY ) {
-    return xxTweakedHash2D( inX, inY ) * oneOverIntMax;
+    return getXYRandom( xxSeed, inX, inY );
     }
 
 
 // in 0..uintMax
 // interpolated for inX,inY that aren't integers
-static double getXYRandomBN( double inX, double inY ) {
+static double getXYRandomBN( XYRandomSeed inSeed, double inX, double inY ) {
     
     int floorX = lrint( floor(inX) );
     int ceilX = floorX + 1;
@@ -93,11 +108,11 @@ static double getXYRandomBN( double inX, double inY ) {
     int ceilY = floorY + 1;
     
 
-    double cornerA1 = xxTweakedHash2D( floorX, floorY );
-    double cornerA2 = xxTweakedHash2D( ceilX, floorY );
+    double cornerA1 = xxTweakedHash2D( inSeed, floorX, floorY );
+    double cornerA2 = xxTweakedHash2D( inSeed, ceilX, floorY );
 
-    double cornerB1 = xxTweakedHash2D( floorX, ceilY );
-    double cornerB2 = xxTweakedHash2D( ceilX, ceilY );
+    double cornerB1 = xxTweakedHash2D( inSeed, floorX, ceilY );
+    double cornerB2 = xxTweakedHash2D( inSeed, ceilX, ceilY );
 
 
     double xOffset = inX - floorX;
@@ -114,32 +129,332 @@ static double getXYRandomBN( double inX, double inY ) {
 
 
 
-double getXYFractal( int inX, int inY, double inRoughness, double inScale ) {
+double getXYFractal( XYRandomSeed inSeed, int inX, int inY, 
+                     double inRoughness, double inScale ) {
 
     double b = inRoughness;
     double a = 1 - b;
 
     double sum =
-        a * getXYRandomBN( inX / (32 * inScale), inY / (32 * inScale) )
+        a * getXYRandomBN( inSeed, inX / (32 * inScale), inY / (32 * inScale) )
         +
         b * (
-            a * getXYRandomBN( inX / (16 * inScale), inY / (16 * inScale) )
+            a * getXYRandomBN( inSeed, 
+                               inX / (16 * inScale), inY / (16 * inScale) )
             +
             b * (
-                a * getXYRandomBN( inX / (8 * inScale), 
+                a * getXYRandomBN( inSeed, inX / (8 * inScale), 
                                    inY / (8 * inScale) )
                 +
                 b * (
-                    a * getXYRandomBN( inX / (4 * inScale), 
+                    a * getXYRandomBN( inSeed, inX / (4 * inScale), 
                                        inY / (4 * inScale) )
                     +
                     b * (
-                        a * getXYRandomBN( inX / (2 * inScale), 
+                        a * getXYRandomBN( inSeed, inX / (2 * inScale), 
                                            inY / (2 * inScale) )
                         +
                         b * (
-                            getXYRandomBN( inX / inScale, inY / inScale )
+                            getXYRandomBN( inSeed, 
+                                           inX / inScale, inY / inScale )
                             ) ) ) ) );
     
     return sum * oneOverIntMax;
     }
+
+
+
+double getXYFractal( int inX, int inY, double inRoughness, double inScale ) {
+    return getXYFractal( xxSeed, inX, inY, inRoughness, inScale );
+    }
+
+
+
+void getXYRandomRegion( XYRandomSeed inSeed, int inX, int inY,
+                        int inWidth, int inHeight, double *outValues ) {
+    for( int y=0; y<inHeight; y++ ) {
+        uint32_t hashY = inY + y;
+        double *row = &( outValues[ y * inWidth ] );
+        
+        for( int x=0; x<inWidth; x++ ) {
+            row[x] = xxTweakedHash2D( inSeed, inX + x, hashY ) * oneOverIntMax;
+            }
+        }
+    }
+
+
+
+
+// one octave of getXYFractalRegion
+// Walks the rows of the region, filling a row of getXYRandomBN values at
+// a time.
+//
+// getXYRandomBN's lattice cell depends only on x for the columns, and only
+// on y for the rows, so column positions are worked out once, and the
+// lattice corner hashes for a row are shared by every cell in it, and by
+// following rows that fall in the same lattice row.
+//
+// Corners that get zero weight (offset exactly 0) are never hashed, because
+// they can't change the result.  This keeps fine octaves, where every cell
+// lands on its own lattice point, from doing more work than per-cell calls.
+typedef struct FractalOctave {
+        double divisor;
+        
+        // per region column
+        int *latticeIndex;
+        double *xOffset;
+        
+        // lattice column number for first lattice index
+        long firstColumn;
+        int numColumns;
+        
+        // lattice indices that are ever used by a corner
+        int *usedColumns;
+        int numUsedColumns;
+
+        // corner hashes for current lattice row and the one below it
+        double *topHashes;
+        double *bottomHashes;
+        long topRow;
+        char topValid;
+        char bottomValid;
+    } FractalOctave;
+
+
+
+// returns false if octave spans too many lattice columns to bother with
+static char initOctave( FractalOctave *inOctave, double inDivisor,
+                        int inX, int inWidth ) {
+    inOctave->divisor = inDivisor;
+    
+    // lattice columns are monotonic in x
+    long firstColumn = lrint( floor( ( inX ) / inDivisor ) );
+    long lastColumn = lrint( floor( ( inX + inWidth - 1 ) / inDivisor ) ) + 1;
+    
+    long numColumns = lastColumn - firstColumn + 1;
+    
+    if( numColumns > 8 * (long)inWidth + 16 ) {
+        return false;
+        }
+    
+    inOctave->firstColumn = firstColumn;
+    inOctave->numColumns = (int)numColumns;
+    
+    inOctave->latticeIndex = new int[ inWidth ];
+    inOctave->xOffset = new double[ inWidth ];
+    
+    char *used = new char[ numColumns ];
+    memset( used, false, numColumns );
+    
+    for( int x=0; x<inWidth; x++ ) {
+        double fx = ( inX + x ) / inDivisor;
+        
+        long floorLong = lrint( floor( fx ) );
+        
+        // truncated to int exactly as in getXYRandomBN
+        int floorX = floorLong;
+        
+        inOctave->latticeIndex[x] = (int)( floorLong - firstColumn );
+        inOctave->xOffset[x] = fx - floorX;
+        
+        used[ inOctave->latticeIndex[x] ] = true;
+        
+        if( inOctave->xOffset[x] != 0 ) {
+            used[ inOctave->latticeIndex[x] + 1 ] = true;
+            }
+        }
+    
+    inOctave->usedColumns = new int[ numColumns ];
+    inOctave->numUsedColumns = 0;
+    
+    for( int c=0; c<numColumns; c++ ) {
+        if( used[c] ) {
+            inOctave->usedColumns[ inOctave->numUsedColumns ] = c;
+            inOctave->numUsedColumns++;
+            }
+        }
+    delete [] used;
+    
+    // unused corners are multiplied by a zero weight, and must still
+    // be finite
+    inOctave->topHashes = new double[ numColumns ];
+    inOctave->bottomHashes = new double[ numColumns ];
+    memset( inOctave->topHashes, 0, numColumns * sizeof( double ) );
+    memset( inOctave->bottomHashes, 0, numColumns * sizeof( double ) );
+    
+    inOctave->topValid = false;
+    inOctave->bottomValid = false;
+    inOctave->topRow = 0;
+    
+    return true;
+    }
+
+
+
+static void freeOctave( FractalOctave *inOctave ) {
+    delete [] inOctave->latticeIndex;
+    delete [] inOctave->xOffset;
+    delete [] inOctave->usedColumns;
+    delete [] inOctave->topHashes;
+    delete [] inOctave->bottomHashes;
+    }
+
+
+
+static void hashLatticeRow( XYRandomSeed inSeed, FractalOctave *inOctave,
+                            uint32_t inRow, double *outHashes ) {
+    // x truncated to 32 bits exactly as in getXYRandomBN
+    uint32_t firstColumn = (uint32_t)inOctave->firstColumn;
+    
+    for( int i=0; i<inOctave->numUsedColumns; i++ ) {
+        int c = inOctave->usedColumns[i];
+        outHashes[c] = xxTweakedHash2D( inSeed, firstColumn + c, inRow );
+        }
+    }
+
+
+
+// fills inWidth values of getXYRandomBN for region row at inY
+static void getOctaveRow( XYRandomSeed inSeed, FractalOctave *inOctave,
+                          int inY, int inWidth, double *outValues ) {
+    
+    double fy = inY / inOctave->divisor;
+    
+    long floorLong = lrint( floor( fy ) );
+    int floorY = floorLong;
+    
+    double yOffset = fy - floorY;
+    
+    if( ! inOctave->topValid || inOctave->topRow != floorLong ) {
+        
+        if( inOctave->topValid && inOctave->bottomValid &&
+            inOctave->topRow + 1 == floorLong ) {
+            // moved down one lattice row, old bottom is new top
+            double *temp = inOctave->topHashes;
+            inOctave->topHashes = inOctave->bottomHashes;
+            inOctave->bottomHashes = temp;
+            }
+        else {
+            hashLatticeRow( inSeed, inOctave, floorY, inOctave->topHashes );
+            }
+        inOctave->topRow = floorLong;
+        inOctave->topValid = true;
+        inOctave->bottomValid = false;
+        }
+    
+    if( yOffset != 0 && ! inOctave->bottomValid ) {
+        hashLatticeRow( inSeed, inOctave, (uint32_t)floorY + 1, 
+                        inOctave->bottomHashes );
+        inOctave->bottomValid = true;
+        }
+    
+    
+    const double *top = inOctave->topHashes;
+    const double *bottom = inOctave->bottomHashes;
+    const int *index = inOctave->latticeIndex;
+    const double *xOffset = inOctave->xOffset;
+    
+    // same operations, in same order, as getXYRandomBN
+    for( int x=0; x<inWidth; x++ ) {
+        int c = index[x];
+        double xo = xOffset[x];
+        
+        double topBlend = top[c + 1] * xo + (1-xo) * top[c];
+    
+        double bottomBlend = bottom[c + 1] * xo + (1-xo) * bottom[c];
+        
+        outValues[x] = bottomBlend * yOffset + (1-yOffset) * topBlend;
+        }
+    }
+
+
+
+void getXYFractalRegion( XYRandomSeed inSeed, int inX, int inY,
+                         int inWidth, int inHeight,
+                         double inRoughness, double inScale,
+                         double *outValues ) {
+    
+    if( inWidth <= 0 || inHeight <= 0 ) {
+        return;
+        }
+    
+    // divisors as computed in getXYFractal, from coarsest to finest
+    double divisors[6] = { 32 * inScale, 16 * inScale, 8 * inScale,
+                           4 * inScale, 2 * inScale, inScale };
+    
+    FractalOctave octaves[6];
+    
+    int numOctaves = 0;
+    
+    if( inScale > 0 ) {
+        for( int o=0; o<6; o++ ) {
+            if( ! initOctave( &( octaves[o] ), divisors[o], inX, inWidth ) ) {
+                break;
+                }
+            numOctaves++;
+            }
+        }
+    
+    if( numOctaves < 6 ) {
+        // lattice too sparse for sharing to help (or bad scale)
+        for( int o=0; o<numOctaves; o++ ) {
+            freeOctave( &( octaves[o] ) );
+            }
+        
+        for( int y=0; y<inHeight; y++ ) {
+            for( int x=0; x<inWidth; x++ ) {
+                outValues[ y * inWidth + x ] =
+                    getXYFractal( inSeed, inX + x, inY + y, 
+                                  inRoughness, inScale );
+                }
+            }
+        return;
+        }
+    
+
+    double b = inRoughness;
+    double a = 1 - b;
+    
+    double *bn[6];
+    for( int o=0; o<6; o++ ) {
+        bn[o] = new double[ inWidth ];
+        }
+    
+    for( int y=0; y<inHeight; y++ ) {
+        
+        for( int o=0; o<6; o++ ) {
+            getOctaveRow( inSeed, &( octaves[o] ), inY + y, inWidth, bn[o] );
+            }
+        
+        double *row = &( outValues[ y * inWidth ] );
+        
+        for( int x=0; x<inWidth; x++ ) {
+            // same nesting as getXYFractal
+            double sum =
+                a * bn[0][x]
+                +
+                b * (
+                    a * bn[1][x]
+                    +
+                    b * (
+                        a * bn[2][x]
+                        +
+                        b * (
+                            a * bn[3][x]
+                            +
+                            b * (
+                                a * bn[4][x]
+                                +
+                                b * (
+                                    bn[5][x]
+                                    ) ) ) ) );
+            
+            row[x] = sum * oneOverIntMax;
+            }
+        }
+    
+    for( int o=0; o<6; o++ ) {
+        delete [] bn[o];
+        freeOctave( &( octaves[o] ) );
+        }
+    }
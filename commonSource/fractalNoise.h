@@ -1,3 +1,7 @@
+#ifndef FRACTAL_NOISE_H_INCLUDED
+#define FRACTAL_NOISE_H_INCLUDED
+
+
 #include <stdint.h>
 
 
@@ -18,3 +22,42 @@ double getXYRandom( int inX, int inY );
 // BUT can be larger than 1 sometimes
 double getXYFractal( int inX, int inY, double inRoughness, double inScale );
 
+
+
+
+// Reentrant versions of the above, which take the seed as a parameter
+// instead of using the one set by setXYRandomSeed.
+// Same seed gives exactly the same values as the global-seed versions.
+
+typedef struct XYRandomSeed {
+        uint32_t a;
+        uint32_t b;
+    } XYRandomSeed;
+
+
+XYRandomSeed makeXYRandomSeed( uint32_t inSeedA, uint32_t inSeedB = 0 );
+
+
+double getXYRandom( XYRandomSeed inSeed, int inX, int inY );
+
+double getXYFractal( XYRandomSeed inSeed, int inX, int inY,
+                     double inRoughness, double inScale );
+
+
+
+// Region versions, filling inWidth * inHeight values for the block starting
+// at inX, inY, in row-major order.
+// Each value is bit-identical to the per-cell call for that x,y.
+//
+// The fractal version shares noise lattice hashes between neighboring cells
+// and rows, so it is much cheaper per cell than per-cell calls.
+void getXYRandomRegion( XYRandomSeed inSeed, int inX, int inY,
+                        int inWidth, int inHeight, double *outValues );
+
+void getXYFractalRegion( XYRandomSeed inSeed, int inX, int inY,
+                         int inWidth, int inHeight,
+                         double inRoughness, double inScale,
+                         double *outValues );
+
+
+#endif
@@ -30,6 +30,8 @@
 
 #include "rocketAnimation.h"
 
+#include "serverReceiver.h"
+
 
 
 #include "../commonSource/fractalNoise.h"
@@ -178,6 +180,8 @@ extern int userTwinCount;
 
 extern char userReconnect;
 
+extern char gamePlayingBack;
+
 extern char *ahapAccountURL;
 extern char *ahapSteamKey;
 
@@ -1183,6 +1187,7 @@ static void replaceLastMessageSent( char *inNewMessage ) {
 
 
 
+// data read from socket this step, before it goes to server receiver
 SimpleVector<unsigned char> serverSocketBuffer;
 
 static char serverSocketConnected = false;
@@ -1220,6 +1225,12 @@ static char readServerSocketFull( int inServerSocket ) {
         
         numRead = readFromSocket( inServerSocket, buffer, 512 );
         }    
+    
+    if( serverSocketBuffer.size() > 0 ) {
+        addServerBytes( serverSocketBuffer.getElement( 0 ),
+                        serverSocketBuffer.size() );
+        serverSocketBuffer.deleteAll();
+        }
 
     if( numRead == -1 ) {
         printf( "Failed to read from server socket at time %f\n",
@@ -1249,9 +1260,20 @@ void LivingLifePage::sendToServerSocket( char *inMessage ) {
     
     replaceLastMessageSent( stringDuplicate( inMessage ) );    
 
+    unsigned char *data = (unsigned char*)inMessage;
     int len = strlen( inMessage );
     
-    int numSent = sendToSocket( mServerSocket, (unsigned char*)inMessage, len );
+    if( mBinaryClientActions ) {
+        mBinaryActionFrame.deleteAll();
+        
+        // anything that has no binary form goes out as text
+        if( encodeBinaryClientAction( inMessage, &mBinaryActionFrame ) ) {
+            data = mBinaryActionFrame.getElement( 0 );
+            len = mBinaryActionFrame.size();
+            }
+        }
+    
+    int numSent = sendToSocket( mServerSocket, data, len );
     
     if( numSent == len ) {
         numServerBytesSent += len;
@@ -1484,245 +1506,6 @@ static bool isAllDigits( std::string &str ) {
     }
 
 
-typedef enum messageType {
-    SHUTDOWN,
-    SERVER_FULL,
-	SEQUENCE_NUMBER,
-    ACCEPTED,
-    NO_LIFE_TOKENS,
-    REJECTED,
-    MAP_CHUNK,
-    MAP_CHANGE,
-    PLAYER_UPDATE,
-    PLAYER_MOVES_START,
-    PLAYER_OUT_OF_RANGE,
-    BABY_WIGGLE,
-    PLAYER_SAYS,
-    LOCATION_SAYS,
-    PLAYER_EMOT,
-    FOOD_CHANGE,
-    HEAT_CHANGE,
-    LINEAGE,
-    CURSED,
-    CURSE_TOKEN_CHANGE,
-    CURSE_SCORE,
-    NAMES,
-    APOCALYPSE,
-    APOCALYPSE_DONE,
-    DYING,
-    HEALED,
-    POSSE_JOIN,
-    MONUMENT_CALL,
-    GRAVE,
-    GRAVE_MOVE,
-    GRAVE_OLD,
-    OWNER,
-    FOLLOWING,
-    EXILED,
-    VALLEY_SPACING,
-    FLIGHT_DEST,
-    BAD_BIOMES,
-    VOG_UPDATE,
-    PHOTO_SIGNATURE,
-    FORCED_SHUTDOWN,
-    GLOBAL_MESSAGE,
-    WAR_REPORT,
-    LEARNED_TOOL_REPORT,
-    TOOL_EXPERTS,
-    TOOL_SLOTS,
-    HOMELAND,
-    FLIP,
-    CRAVING,
-    GHOST,
-    ROCKET_RIDE,
-    ROCKET_ACCOUNT,
-    PONG,
-    COMPRESSED_MESSAGE,
-    UNKNOWN
-    } messageType;
-
-
-
-messageType getMessageType( char *inMessage ) {
-    char *copy = stringDuplicate( inMessage );
-    
-    char *firstBreak = strstr( copy, "\n" );
-    
-    if( firstBreak == NULL ) {
-        delete [] copy;
-        return UNKNOWN;
-        }
-    
-    firstBreak[0] = '\0';
-    
-    messageType returnValue = UNKNOWN;
-
-    if( strcmp( copy, "CM" ) == 0 ) {
-        returnValue = COMPRESSED_MESSAGE;
-        }
-    else if( strcmp( copy, "MC" ) == 0 ) {
-        returnValue = MAP_CHUNK;
-        }
-    else if( strcmp( copy, "MX" ) == 0 ) {
-        returnValue = MAP_CHANGE;
-        }
-    else if( strcmp( copy, "PU" ) == 0 ) {
-        returnValue = PLAYER_UPDATE;
-        }
-    else if( strcmp( copy, "PM" ) == 0 ) {
-        returnValue = PLAYER_MOVES_START;
-        }
-    else if( strcmp( copy, "PO" ) == 0 ) {
-        returnValue = PLAYER_OUT_OF_RANGE;
-        }
-    else if( strcmp( copy, "BW" ) == 0 ) {
-        returnValue = BABY_WIGGLE;
-        }
-    else if( strcmp( copy, "PS" ) == 0 ) {
-        returnValue = PLAYER_SAYS;
-        }
-    else if( strcmp( copy, "LS" ) == 0 ) {
-        returnValue = LOCATION_SAYS;
-        }
-    else if( strcmp( copy, "PE" ) == 0 ) {
-        returnValue = PLAYER_EMOT;
-        }
-    else if( strcmp( copy, "FX" ) == 0 ) {
-        returnValue = FOOD_CHANGE;
-        }
-    else if( strcmp( copy, "HX" ) == 0 ) {
-        returnValue = HEAT_CHANGE;
-        }
-    else if( strcmp( copy, "LN" ) == 0 ) {
-        returnValue = LINEAGE;
-        }
-    else if( strcmp( copy, "CU" ) == 0 ) {
-        returnValue = CURSED;
-        }
-    else if( strcmp( copy, "CX" ) == 0 ) {
-        returnValue = CURSE_TOKEN_CHANGE;
-        }
-    else if( strcmp( copy, "CS" ) == 0 ) {
-        returnValue = CURSE_SCORE;
-        }
-    else if( strcmp( copy, "NM" ) == 0 ) {
-        returnValue = NAMES;
-        }
-    else if( strcmp( copy, "AP" ) == 0 ) {
-        returnValue = APOCALYPSE;
-        }
-    else if( strcmp( copy, "AD" ) == 0 ) {
-        returnValue = APOCALYPSE_DONE;
-        }
-    else if( strcmp( copy, "DY" ) == 0 ) {
-        returnValue = DYING;
-        }
-    else if( strcmp( copy, "HE" ) == 0 ) {
-        returnValue = HEALED;
-        }
-    else if( strcmp( copy, "PJ" ) == 0 ) {
-        returnValue = POSSE_JOIN;
-        }
-    else if( strcmp( copy, "MN" ) == 0 ) {
-        returnValue = MONUMENT_CALL;
-        }
-    else if( strcmp( copy, "GV" ) == 0 ) {
-        returnValue = GRAVE;
-        }
-    else if( strcmp( copy, "GM" ) == 0 ) {
-        returnValue = GRAVE_MOVE;
-        }
-    else if( strcmp( copy, "GO" ) == 0 ) {
-        returnValue = GRAVE_OLD;
-        }
-    else if( strcmp( copy, "OW" ) == 0 ) {
-        returnValue = OWNER;
-        }
-    else if( strcmp( copy, "FW" ) == 0 ) {
-        returnValue = FOLLOWING;
-        }
-    else if( strcmp( copy, "EX" ) == 0 ) {
-        returnValue = EXILED;
-        }
-    else if( strcmp( copy, "VS" ) == 0 ) {
-        returnValue = VALLEY_SPACING;
-        }
-    else if( strcmp( copy, "FD" ) == 0 ) {
-        returnValue = FLIGHT_DEST;
-        }
-    else if( strcmp( copy, "BB" ) == 0 ) {
-        returnValue = BAD_BIOMES;
-        }
-    else if( strcmp( copy, "VU" ) == 0 ) {
-        returnValue = VOG_UPDATE;
-        }
-    else if( strcmp( copy, "PH" ) == 0 ) {
-        returnValue = PHOTO_SIGNATURE;
-        }
-    else if( strcmp( copy, "PONG" ) == 0 ) {
-        returnValue = PONG;
-        }
-    else if( strcmp( copy, "SHUTDOWN" ) == 0 ) {
-        returnValue = SHUTDOWN;
-        }
-    else if( strcmp( copy, "SERVER_FULL" ) == 0 ) {
-        returnValue = SERVER_FULL;
-        }
-    else if( strcmp( copy, "SN" ) == 0 ) {
-        returnValue = SEQUENCE_NUMBER;
-        }
-    else if( strcmp( copy, "ACCEPTED" ) == 0 ) {
-        returnValue = ACCEPTED;
-        }
-    else if( strcmp( copy, "REJECTED" ) == 0 ) {
-        returnValue = REJECTED;
-        }
-    else if( strcmp( copy, "NO_LIFE_TOKENS" ) == 0 ) {
-        returnValue = NO_LIFE_TOKENS;
-        }
-    else if( strcmp( copy, "SD" ) == 0 ) {
-        returnValue = FORCED_SHUTDOWN;
-        }
-    else if( strcmp( copy, "MS" ) == 0 ) {
-        returnValue = GLOBAL_MESSAGE;
-        }
-    else if( strcmp( copy, "WR" ) == 0 ) {
-        returnValue = WAR_REPORT;
-        }
-    else if( strcmp( copy, "LR" ) == 0 ) {
-        returnValue = LEARNED_TOOL_REPORT;
-        }
-    else if( strcmp( copy, "TE" ) == 0 ) {
-        returnValue = TOOL_EXPERTS;
-        }
-    else if( strcmp( copy, "TS" ) == 0 ) {
-        returnValue = TOOL_SLOTS;
-        }
-    else if( strcmp( copy, "HL" ) == 0 ) {
-        returnValue = HOMELAND;
-        }
-    else if( strcmp( copy, "FL" ) == 0 ) {
-        returnValue = FLIP;
-        }
-    else if( strcmp( copy, "CR" ) == 0 ) {
-        returnValue = CRAVING;
-        }
-    else if( strcmp( copy, "GH" ) == 0 ) {
-        returnValue = GHOST;
-        }
-    else if( strcmp( copy, "RR" ) == 0 ) {
-        returnValue = ROCKET_RIDE;
-        }
-    else if( strcmp( copy, "RA" ) == 0 ) {
-        returnValue = ROCKET_ACCOUNT;
-        }
-    
-    delete [] copy;
-    return returnValue;
-    }
-
-
-
 doublePair getVectorFromCamera( int inMapX, int inMapY ) {
     doublePair vector = 
         { inMapX - lastScreenViewCenter.x / CELL_D, 
@@ -1734,14 +1517,6 @@ doublePair getVectorFromCamera( int inMapX, int inMapY ) {
                                  
 
 
-char *pendingMapChunkMessage = NULL;
-int pendingCompressedChunkSize;
-
-char pendingCMData = false;
-int pendingCMCompressedSize = 0;
-int pendingCMDecompressedSize = 0;
-
-
 SimpleVector<char*> readyPendingReceivedMessages;
 
 static double lastServerMessageReceiveTime = 0;
@@ -1751,83 +1526,60 @@ static double lastServerMessageReceiveTime = 0;
 // This is an approximation of our outtage time.
 static double largestPendingMessageTimeGap = 0;
 
-static char waitForFrameMessages = false;
-
 
-// NULL if there's no full message available
-char *getNextServerMessageRaw() {        
+// frame we are returning messages from
+static ServerFrame *currentServerFrame = NULL;
+static int nextServerFrameMessage = 0;
 
-    if( pendingMapChunkMessage != NULL ) {
-        // wait for full binary data chunk to arrive completely
-        // after message before we report that the message is ready
+// decompressed body of the last map chunk message returned
+// NULL if decompression failed
+// its length is in the message header
+static unsigned char *mapChunkBody = NULL;
 
-        if( serverSocketBuffer.size() >= pendingCompressedChunkSize ) {
-            char *returnMessage = pendingMapChunkMessage;
-            pendingMapChunkMessage = NULL;
 
-            messagesInCount++;
 
-            return returnMessage;
-            }
-        else {
-            // wait for more data to arrive before saying this MC message
-            // is ready
-            return NULL;
-            }
+static void clearReceivedServerMessages() {
+    resetServerReceiver();
+    
+    if( currentServerFrame != NULL ) {
+        freeServerFrame( currentServerFrame );
+        currentServerFrame = NULL;
         }
     
-    if( pendingCMData ) {
-        if( serverSocketBuffer.size() >= pendingCMCompressedSize ) {
-            pendingCMData = false;
-            
-            unsigned char *compressedData = 
-                new unsigned char[ pendingCMCompressedSize ];
-            
-            for( int i=0; i<pendingCMCompressedSize; i++ ) {
-                compressedData[i] = serverSocketBuffer.getElementDirect( i );
-                }
-            serverSocketBuffer.deleteStartElements( pendingCMCompressedSize );
-            
-            unsigned char *decompressedMessage =
-                zipDecompress( compressedData, 
-                               pendingCMCompressedSize,
-                               pendingCMDecompressedSize );
-
-            delete [] compressedData;
-
-            if( decompressedMessage == NULL ) {
-                printf( "Decompressing CM message failed\n" );
-                return NULL;
-                }
-            else {
-                char *textMessage = new char[ pendingCMDecompressedSize + 1 ];
-                memcpy( textMessage, decompressedMessage,
-                       pendingCMDecompressedSize );
-                textMessage[ pendingCMDecompressedSize ] = '\0';
-                
-                delete [] decompressedMessage;
-                
-                messagesInCount++;
-                return textMessage;
-                }
-            }
-        else {
-            // wait for more data to arrive
-            return NULL;
-            }
+    if( mapChunkBody != NULL ) {
+        delete [] mapChunkBody;
+        mapChunkBody = NULL;
         }
     
+    serverSocketBuffer.deleteAll();
+    }
 
 
-    // find first terminal character #
 
-    int index = serverSocketBuffer.getElementIndex( '#' );
+// NULL if there's no full message available
+//
+// server receiver only passes on whole frames, after we are ACCEPTED
+char *getNextServerMessageRaw() {        
+    
+    if( currentServerFrame != NULL &&
+        nextServerFrameMessage >= currentServerFrame->messages.size() ) {
+        freeServerFrame( currentServerFrame );
+        currentServerFrame = NULL;
+        }
+    
+    if( currentServerFrame == NULL ) {
+        currentServerFrame = getNextServerFrame();
+        nextServerFrameMessage = 0;
         
-    if( index == -1 ) {
-        return NULL;
+        if( currentServerFrame == NULL ) {
+            return NULL;
+            }
         }
-
-    // terminal character means message arrived
+    
+    ServerMessage *m = 
+        currentServerFrame->messages.getElement( nextServerFrameMessage );
+    nextServerFrameMessage++;
+    
 
     double curTime = game_getCurrentTime();
     
@@ -1839,60 +1591,28 @@ char *getNextServerMessageRaw() {
 
     lastServerMessageReceiveTime = curTime;
 
-
-    
-    char *message = new char[ index + 1 ];
     
-    for( int i=0; i<index; i++ ) {
-        message[i] = (char)( serverSocketBuffer.getElementDirect( i ) );
+    if( m->type == MAP_CHUNK ) {
+        if( mapChunkBody != NULL ) {
+            delete [] mapChunkBody;
+            }
+        mapChunkBody = m->body;
+        m->body = NULL;
         }
-    // delete message and terminal character
-    serverSocketBuffer.deleteStartElements( index + 1 );
     
-    message[ index ] = '\0';
-
-    if( getMessageType( message ) == MAP_CHUNK ) {
-        pendingMapChunkMessage = message;
-        
-        int sizeX, sizeY, x, y, binarySize;
-        sscanf( message, "MC\n%d %d %d %d\n%d %d\n", 
-                &sizeX, &sizeY,
-                &x, &y, &binarySize, &pendingCompressedChunkSize );
-
-
-        return getNextServerMessageRaw();
-        }
-    else if( getMessageType( message ) == COMPRESSED_MESSAGE ) {
-        pendingCMData = true;
-        
-        printf( "Got compressed message header:\n%s\n\n", message );
-
-        sscanf( message, "CM\n%d %d\n", 
-                &pendingCMDecompressedSize, &pendingCMCompressedSize );
-
-        delete [] message;
-        return NULL;
-        }
-    else {
-        messagesInCount++;
-        return message;
-        }
+    char *message = m->text;
+    m->text = NULL;
+    
+    messagesInCount++;
+    return message;
     }
 
 
 
-char serverFrameReady;
-static SimpleVector<char*> serverFrameMessages;
-
-
 // either returns a pending recieved message (one that was received earlier
 // or held back
 //
-// or receives the next message from the server socket (if we are not waiting
-// for full frames of messages)
-//
-// or returns NULL until a full frame of messages is available, and
-// then returns the first message from the frame
+// or returns the next message received from the server
 char *getNextServerMessage() {
     
     if( readyPendingReceivedMessages.size() > 0 ) {
@@ -1902,74 +1622,7 @@ char *getNextServerMessage() {
         return message;
         }
     
-    if( !waitForFrameMessages ) {
-        return getNextServerMessageRaw();
-        }
-    else {
-        if( !serverFrameReady ) {
-            // read more and look for end of frame
-            
-            char *message = getNextServerMessageRaw();
-            
-            while( message != NULL ) {
-                messageType t = getMessageType( message );
-                
-                if( strstr( message, "FM" ) == message ) {
-                    // end of frame, discard the marker message
-                    delete [] message;
-                    
-                    if( serverFrameMessages.size() > 0 ) {
-                        serverFrameReady = true;
-                        // see end of frame, stop reading more messages
-                        // for now (they are part of next frame)
-                        // and start returning message to caller from
-                        // this frame
-                        break;
-                        }
-                    }
-                else if( t == MAP_CHUNK ||
-                         t == PONG ||
-                         t == FLIGHT_DEST ||
-                         t == PHOTO_SIGNATURE ) {
-                    // map chunks are followed by compressed data
-                    // they cannot be queued
-                    
-                    // PONG messages should be returned instantly
-                    
-                    // FLIGHT_DEST messages also should be returned instantly
-                    // otherwise, they will be queued and seen by 
-                    // the client after the corresponding MC message
-                    // for the new location.
-                    // which will invalidate the map around player's old
-                    // location
-                    return message;
-                    }
-                else {
-                    // some other message in the middle of the frame
-                    // keep it
-                    serverFrameMessages.push_back( message );
-                    }
-                
-                // keep reading messages, until we either see the 
-                // end of the frame or read all available messages
-                message = getNextServerMessageRaw();
-                }
-            }
-
-        if( serverFrameReady ) {
-            char *message = serverFrameMessages.getElementDirect( 0 );
-            
-            serverFrameMessages.deleteElement( 0 );
-
-            if( serverFrameMessages.size() == 0 ) {
-                serverFrameReady = false;
-                }
-            return message;
-            }
-        else {
-            return NULL;
-            }
-        }
+    return getNextServerMessageRaw();
     }
 
 
@@ -2346,10 +1999,10 @@ void LivingLifePage::computePathToDest( LiveObject *inObject ) {
             }
         
         if( startPointBad ||
-            isBadBiome( startInd - 1 ) ||
-            isBadBiome( startInd + 1 ) ||
-            isBadBiome( startInd - mMapD ) ||
-            isBadBiome( startInd + mMapD ) ) {
+            isBadBiome( getMapIndex( start.x - 1, start.y ) ) ||
+            isBadBiome( getMapIndex( start.x + 1, start.y ) ) ||
+            isBadBiome( getMapIndex( start.x, start.y - 1 ) ) ||
+            isBadBiome( getMapIndex( start.x, start.y + 1 ) ) ) {
             
             startBiomeBad = true;
             }
@@ -2402,7 +2055,7 @@ void LivingLifePage::computePathToDest( LiveObject *inObject ) {
             if( mapY >= 0 && mapY < mMapD &&
                 mapX >= 0 && mapX < mMapD ) { 
 
-                int mapI = mapY * mMapD + mapX;
+                int mapI = getMapCellIndex( mapX, mapY );
             
                 // note that unknowns (-1) count as blocked too
                 if( mMap[ mapI ] == 0
@@ -2451,7 +2104,7 @@ void LivingLifePage::computePathToDest( LiveObject *inObject ) {
             if( mapY >= 0 && mapY < mMapD &&
                 mapX >= 0 && mapX < mMapD ) { 
 
-                int mapI = mapY * mMapD + mapX;
+                int mapI = getMapCellIndex( mapX, mapY );
                 
                 if( mMap[ mapI ] > 0 ) {
                     ObjectRecord *o = getObject( mMap[ mapI ] );
@@ -2848,16 +2501,15 @@ void LivingLifePage::hetuwSetNextActionEating( bool b ) {
 int LivingLifePage::hetuwGetMapI( int tileX, int tileY ) {
 	int mapX = tileX - mMapOffsetX + mMapD / 2;
 	int mapY = tileY - mMapOffsetY + mMapD / 2;
-	if (mapX >= mMapD || mapY >= mMapD) return -1;
-	return mapY * mMapD + mapX;
+	if (mapX < 0 || mapY < 0 || mapX >= mMapD || mapY >= mMapD) return -1;
+	return getMapCellIndex( mapX, mapY );
 }
 
 int LivingLifePage::hetuwGetObjId( int tileX, int tileY ) {
 	int mapX = tileX - mMapOffsetX + mMapD / 2;
 	int mapY = tileY - mMapOffsetY + mMapD / 2;
-	int i = mapY * mMapD + mapX;
-	if (i < 0 || i >= mMapD*mMapD) return -1;
-	return mMap[i];
+	if (mapX < 0 || mapY < 0 || mapX >= mMapD || mapY >= mMapD) return -1;
+	return mMap[ getMapCellIndex( mapX, mapY ) ];
 }
 
 static Image *expandToPowersOfTwoWhite( Image *inImage ) {
@@ -2908,6 +2560,49 @@ static void splitAndExpandSprites( const char *inTgaFileName, int inNumSprites,
 
 
 
+void LivingLifePage::resetMapCell( int inMapI, 
+                                   int inWorldX, int inWorldY ) {
+    int i = inMapI;
+    
+    // starts uknown, not empty
+    mMap[i] = -1;
+    mMapBiomes[i] = -1;
+    mMapFloors[i] = -1;
+
+    // each cell is different, but always the same
+    mMapAnimationFrameCount[i] =
+        lrint( getXYRandom( inWorldX, inWorldY ) * 10000 );
+    mMapAnimationLastFrameCount[i] = mMapAnimationFrameCount[i];
+    
+    mMapAnimationFrozenRotFrameCount[i] = 0;
+    mMapAnimationFrozenRotFrameCountUsed[i] = false;
+    
+    mMapFloorAnimationFrameCount[i] =
+        lrint( getXYRandom( inWorldX, inWorldY ) * 13853 );
+    
+    mMapCurAnimType[i] = ground;
+    mMapLastAnimType[i] = ground;
+    mMapLastAnimFade[i] = 0;
+    mMapDropOffsets[i].x = 0;
+    mMapDropOffsets[i].y = 0;
+    mMapDropRot[i] = 0;
+    
+    mMapDropSounds[i] = blankSoundUsage;
+    
+    mMapMoveOffsets[i].x = 0;
+    mMapMoveOffsets[i].y = 0;
+    mMapMoveSpeeds[i] = 0;
+    
+    mMapTileFlips[i] = false;
+    
+    mMapContainedStacks[i].deleteAll();
+    mMapSubContainedStacks[i].deleteAll();
+
+    mMapPlayerPlacedFlags[i] = false;
+    }
+
+
+
 void LivingLifePage::clearMap() {
     for( int i=0; i<mMapD *mMapD; i++ ) {
         // -1 represents unknown
@@ -2988,6 +2683,16 @@ LivingLifePage::LivingLifePage()
         mUsingSteam = true;
         }
 
+    
+    // recorded games replay socket reads step by step, so messages
+    // must come out in the same step the bytes were read
+    char receiveThread = 
+        SettingsManager::getIntSetting( "serverReceiveThread", 1 ) &&
+        ! gamePlayingBack &&
+        SettingsManager::getIntSetting( "recordGame", 0 ) != 1;
+    
+    initServerReceiver( receiveThread );
+    
 
     const char *badgeSettingsNames[3] = { "badgeObjects",
                                           "badgeObjectsHalfX",
@@ -3303,6 +3008,17 @@ LivingLifePage::LivingLifePage()
     
     mMapPlayerPlacedFlags = new char[ mMapD * mMapD ];
     
+    mBinaryMapChunks = false;
+    mBinaryClientActions = false;
+    
+    mMapChunkCacheCells = 
+        new MapChunkCell[ MAP_CHUNK_CACHE_D * MAP_CHUNK_CACHE_D ];
+    mMapChunkCachePos = new GridPos[ MAP_CHUNK_CACHE_D * MAP_CHUNK_CACHE_D ];
+    mMapChunkCacheValid = new char[ MAP_CHUNK_CACHE_D * MAP_CHUNK_CACHE_D ];
+    
+    memset( mMapChunkCacheValid, false, 
+            MAP_CHUNK_CACHE_D * MAP_CHUNK_CACHE_D );
+    
 
     clearMap();
 
@@ -3492,12 +3208,8 @@ LivingLifePage::~LivingLifePage() {
 
     readyPendingReceivedMessages.deallocateStringElements();
 
-    serverFrameMessages.deallocateStringElements();
-    
-    if( pendingMapChunkMessage != NULL ) {
-        delete [] pendingMapChunkMessage;
-        pendingMapChunkMessage = NULL;
-        }
+    clearReceivedServerMessages();
+    freeServerReceiver();
     
 
     clearLiveObjects();
@@ -3561,6 +3273,10 @@ LivingLifePage::~LivingLifePage() {
     delete [] mMapCellDrawnFlags;
 
     delete [] mMapPlayerPlacedFlags;
+    
+    delete [] mMapChunkCacheCells;
+    delete [] mMapChunkCachePos;
+    delete [] mMapChunkCacheValid;
 
     if( nextActionMessageToSend != NULL ) {
         delete [] nextActionMessageToSend;
@@ -4671,7 +4387,8 @@ void LivingLifePage::drawMapCell( int inMapI,
         
         if( mCurMouseOverID > 0 &&
             ! mCurMouseOverSelf &&
-            mCurMouseOverSpot.y * mMapD + mCurMouseOverSpot.x == inMapI ) {
+            getMapCellIndex( mCurMouseOverSpot.x, 
+                             mCurMouseOverSpot.y ) == inMapI ) {
             
             if( mCurMouseOverBehind ) {
                 highlight = inHighlightOnly;
@@ -4686,7 +4403,7 @@ void LivingLifePage::drawMapCell( int inMapI,
             for( int i=0; i<mPrevMouseOverSpots.size(); i++ ) {
                 GridPos prev = mPrevMouseOverSpots.getElementDirect( i );
                 
-                if( prev.y * mMapD + prev.x == inMapI ) {
+                if( getMapCellIndex( prev.x, prev.y ) == inMapI ) {
                     if( mPrevMouseOverSpotsBehind.getElementDirect( i ) ) {
                         highlight = inHighlightOnly;
                         }
@@ -4837,8 +4554,9 @@ void LivingLifePage::drawMapCell( int inMapI,
             FloatColor badgeColor = { 1, 1, 1, 1 };
             
 
-            int x = inMapI % mMapD;
-            int y = inMapI / mMapD;
+            GridPos mapPos = getMapCellPos( inMapI );
+            int x = mapPos.x;
+            int y = mapPos.y;
             
             int worldY = y + mMapOffsetY - mMapD / 2;
 
@@ -5009,7 +4727,7 @@ int LivingLifePage::getMapIndex( int inWorldX, int inWorldY ) {
     if( mapTarget.y >= 0 && mapTarget.y < mMapD &&
         mapTarget.x >= 0 && mapTarget.x < mMapD ) {
                     
-        return mapTarget.y * mMapD + mapTarget.x;
+        return getMapCellIndex( mapTarget.x, mapTarget.y );
         }
     return -1;
     }
@@ -7042,7 +6760,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
         screenY -= 32;
         
         for( int x=xStartFloor; x<=xEndFloor; x++ ) {
-            int mapI = y * mMapD + x;
+            int mapI = getMapCellIndex( x, y );
             
             char inBounds = isInBounds( x, y, mMapD );
 
@@ -7129,7 +6847,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
                                  nX <= x + s->numTilesWide; nX++ ) {
                                 
                                 if( nX >=0 && nX < mMapD ) {
-                                    int nI = nY * mMapD + nX;
+                                    int nI = getMapCellIndex( nX, nY );
                                     
                                     int nB = -1;
                                     
@@ -7170,7 +6888,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
                                      sX < x + s->numTilesWide; sX++ ) {
                                 
                                     if( sX >=0 && sX < mMapD ) {
-                                        int sI = sY * mMapD + sX;
+                                        int sI = getMapCellIndex( sX, sY );
                                         
                                         mMapCellDrawnFlags[sI] = true;
                                         }
@@ -7189,14 +6907,14 @@ void LivingLifePage::draw( doublePair inViewCenter,
                     int diagB = -1;
                     
                     if( isInBounds( x -1, y, mMapD ) ) {    
-                        leftB = mMapBiomes[ mapI - 1 ];
+                        leftB = mMapBiomes[ getMapCellIndex( x - 1, y ) ];
                         }
                     if( isInBounds( x, y + 1, mMapD ) ) {    
-                        aboveB = mMapBiomes[ mapI + mMapD ];
+                        aboveB = mMapBiomes[ getMapCellIndex( x, y + 1 ) ];
                         }
                     
                     if( isInBounds( x + 1, y + 1, mMapD ) ) {    
-                        diagB = mMapBiomes[ mapI + mMapD + 1 ];
+                        diagB = mMapBiomes[ getMapCellIndex( x + 1, y + 1 ) ];
                         }
                     
                     char floorAt = isCoveredByFloor( mapI );
@@ -7205,13 +6923,16 @@ void LivingLifePage::draw( doublePair inViewCenter,
                     char floorBR = false;
                     
                     if( isInBounds( x +1, y, mMapD ) ) {    
-                        floorR = isCoveredByFloor( mapI + 1 );
+                        floorR = isCoveredByFloor( 
+                            getMapCellIndex( x + 1, y ) );
                         }
                     if( isInBounds( x, y - 1, mMapD ) ) {    
-                        floorB = isCoveredByFloor( mapI - mMapD );
+                        floorB = isCoveredByFloor( 
+                            getMapCellIndex( x, y - 1 ) );
                         }
                     if( isInBounds( x +1, y - 1, mMapD ) ) {    
-                        floorBR = isCoveredByFloor( mapI - mMapD + 1 );
+                        floorBR = isCoveredByFloor( 
+                            getMapCellIndex( x + 1, y - 1 ) );
                         }
 
 
@@ -7241,19 +6962,24 @@ void LivingLifePage::draw( doublePair inViewCenter,
                         char floorBL = false;
                     
                         if( isInBounds( x -1, y, mMapD ) ) {    
-                            floorL = isCoveredByFloor( mapI - 1 );
+                            floorL = isCoveredByFloor( 
+                                getMapCellIndex( x - 1, y ) );
                             }
                         if( isInBounds( x, y+1, mMapD ) ) {    
-                            floorA = isCoveredByFloor( mapI + mMapD );
+                            floorA = isCoveredByFloor( 
+                                getMapCellIndex( x, y + 1 ) );
                             }
                         if( isInBounds( x-1, y+1, mMapD ) ) {    
-                            floorAL = isCoveredByFloor( mapI + mMapD - 1 );
+                            floorAL = isCoveredByFloor( 
+                                getMapCellIndex( x - 1, y + 1 ) );
                             }
                         if( isInBounds( x+1, y+1, mMapD ) ) {    
-                            floorAR = isCoveredByFloor( mapI + mMapD + 1 );
+                            floorAR = isCoveredByFloor( 
+                                getMapCellIndex( x + 1, y + 1 ) );
                             }
                         if( isInBounds( x-1, y-1, mMapD ) ) {    
-                            floorBL = isCoveredByFloor( mapI - mMapD - 1 );
+                            floorBL = isCoveredByFloor( 
+                                getMapCellIndex( x - 1, y - 1 ) );
                             }
 
                         if( !( floorAt && floorR && floorB && floorBR &&
@@ -7334,7 +7060,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
             int worldX = x + mMapOffsetX - mMapD / 2;
 
 
-            int mapI = y * mMapD + x;
+            int mapI = getMapCellIndex( x, y );
 
             int oID = mMapFloors[mapI];
 
@@ -7368,19 +7094,22 @@ void LivingLifePage::draw( doublePair inViewCenter,
                     // them hug walls.  Single-tile floors and roads can
                     // hug walls just fine.
 
-                    if( x > 0 && mMapFloors[ mapI - 1 ] > 0 &&
-                        getObject( mMapFloors[ mapI - 1 ] )->roadParentID 
+                    int leftI = getMapCellIndex( x - 1, y );
+                    int rightI = getMapCellIndex( x + 1, y );
+
+                    if( x > 0 && mMapFloors[ leftI ] > 0 &&
+                        getObject( mMapFloors[ leftI ] )->roadParentID 
                         == -1 ) {
                         // floor to our left
-                        passIDs[1] = mMapFloors[ mapI - 1 ];
+                        passIDs[1] = mMapFloors[ leftI ];
                         drawHuggingFloor = true;
                         }
                     
-                    if( x < mMapD - 1 && mMapFloors[ mapI + 1 ] > 0  &&
-                        getObject( mMapFloors[ mapI + 1 ] )->roadParentID 
+                    if( x < mMapD - 1 && mMapFloors[ rightI ] > 0  &&
+                        getObject( mMapFloors[ rightI ] )->roadParentID 
                         == -1 ) {
                         // floor to our right
-                        passIDs[2] = mMapFloors[ mapI + 1 ];
+                        passIDs[2] = mMapFloors[ rightI ];
                         drawHuggingFloor = true;
                         
                         }
@@ -7692,7 +7421,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
         int screenX = 
             CELL_D * ( mCurMouseOverCell.x + mMapOffsetX - mMapD / 2 );        
         
-        int mapI = mCurMouseOverCell.y * mMapD + mCurMouseOverCell.x;
+        int mapI = getMapCellIndex( mCurMouseOverCell.x, mCurMouseOverCell.y );
         
         int id = mMap[mapI];
         
@@ -7751,7 +7480,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
             CELL_D * ( prev.x + mMapOffsetX - mMapD / 2 );        
 
         
-        int mapI = prev.y * mMapD + prev.x;
+        int mapI = getMapCellIndex( prev.x, prev.y );
         
         int id = mMap[mapI];
         
@@ -8057,7 +7786,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
     
     for( int y=0; y<mMapD; y++ ) {
         for( int x=0; x<mMapD; x++ ) {
-            int mapI = y * mMapD + x;
+            int mapI = getMapCellIndex( x, y );
             
             if( mMap[ mapI ] > 0 &&
                 mMapMoveSpeeds[ mapI ] > 0 ) {
@@ -8087,7 +7816,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
             int worldX = x + mMapOffsetX - mMapD / 2;
 
 
-            int mapI = y * mMapD + x;
+            int mapI = getMapCellIndex( x, y );
 
             if( cellDrawn[mapI] ) {
                 continue;
@@ -8133,7 +7862,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
             int worldX = x + mMapOffsetX - mMapD / 2;
 
 
-            int mapI = y * mMapD + x;
+            int mapI = getMapCellIndex( x, y );
 
             if( cellDrawn[mapI] ) {
                 continue;
@@ -8313,8 +8042,9 @@ void LivingLifePage::draw( doublePair inViewCenter,
                 }
             
 
-            int oX = mapI % mMapD;
-            int oY = mapI / mMapD;
+            GridPos oPos = getMapCellPos( mapI );
+            int oX = oPos.x;
+            int oY = oPos.y;
             
             int movingX = lrint( oX + mMapMoveOffsets[mapI].x );
 
@@ -8380,7 +8110,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
                 int mapX = movingWorldPos.x - mMapOffsetX + mMapD / 2;
                 int mapY = movingWorldPos.y - mMapOffsetY + mMapD / 2;
                     
-                int mapI = mapY * mMapD + mapX;
+                int mapI = getMapCellIndex( mapX, mapY );
 
 
                 int movingScreenX = CELL_D * movingWorldPos.x;
@@ -8574,7 +8304,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
 
         // first permanent, non-wall objects
         for( int x=xStart; x<=xEnd; x++ ) {
-            int mapI = y * mMapD + x;
+            int mapI = getMapCellIndex( x, y );
             
             if( cellDrawn[ mapI ] ) {
                 continue;
@@ -8610,7 +8340,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
 
         // then non-permanent, non-wall objects
         for( int x=xStart; x<=xEnd; x++ ) {
-            int mapI = y * mMapD + x;
+            int mapI = getMapCellIndex( x, y );
             
             if( cellDrawn[ mapI ] ) {
                 continue;
@@ -8656,7 +8386,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
 
         // then permanent, non-container, wall objects
         for( int x=xStart; x<=xEnd; x++ ) {
-            int mapI = y * mMapD + x;
+            int mapI = getMapCellIndex( x, y );
             
             if( cellDrawn[ mapI ] ) {
                 continue;
@@ -8692,7 +8422,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
 
         // then permanent, container, wall objects (walls with signs)
         for( int x=xStart; x<=xEnd; x++ ) {
-            int mapI = y * mMapD + x;
+            int mapI = getMapCellIndex( x, y );
             
             if( cellDrawn[ mapI ] ) {
                 continue;
@@ -8735,7 +8465,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
         
         int screenY = CELL_D * worldY;
         
-        int mapI = mCurMouseOverSpot.y * mMapD + mCurMouseOverSpot.x;
+        int mapI = getMapCellIndex( mCurMouseOverSpot.x, mCurMouseOverSpot.y );
         int screenX = 
             CELL_D * ( mCurMouseOverSpot.x + mMapOffsetX - mMapD / 2 );
         
@@ -8753,7 +8483,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
         
             int screenY = CELL_D * worldY;
         
-            int mapI = prev.y * mMapD + prev.x;
+            int mapI = getMapCellIndex( prev.x, prev.y );
             int screenX = 
                 CELL_D * ( prev.x + mMapOffsetX - mMapD / 2 );
         
@@ -9151,7 +8881,7 @@ void LivingLifePage::draw( doublePair inViewCenter,
 
                     if( worldX >= xLimit ) {
                         
-                        int mapI = y * mMapD + x;
+                        int mapI = getMapCellIndex( x, y );
                     
                         int screenX = CELL_D * worldX;
                         
@@ -11711,6 +11441,197 @@ void LivingLifePage::applyReceiveOffset( int *inX, int *inY ) {
 
 
 
+
+void LivingLifePage::applyTextMapChunk( unsigned char *inData, 
+                                        int inLength,
+                                        int inSizeX, int inSizeY,
+                                        int inX, int inY ) {
+    unsigned char *binaryChunk = new unsigned char[ inLength + 1 ];
+
+    memcpy( binaryChunk, inData, inLength );
+
+    // for now, binary chunk is actually just ASCII
+    binaryChunk[ inLength ] = '\0';
+
+    SimpleVector<char *> *tokens = tokenizeString( (char*)binaryChunk );
+
+    delete [] binaryChunk;
+
+
+    int numCells = inSizeX * inSizeY;
+    
+    if( tokens->size() == numCells ) {
+        
+        for( int i=0; i<tokens->size(); i++ ) {
+            int cX = i % inSizeX;
+            int cY = i / inSizeX;
+            
+            int mapX = cX + inX - mMapOffsetX + mMapD / 2;
+            int mapY = cY + inY - mMapOffsetY + mMapD / 2;
+            
+            if( mapX >= 0 && mapX < mMapD
+                &&
+                mapY >= 0 && mapY < mMapD ) {
+                
+                
+                int mapI = getMapCellIndex( mapX, mapY );
+                int oldMapID = mMap[mapI];
+                
+                sscanf( tokens->getElementDirect(i),
+                        "%d:%d:%d", 
+                        &( mMapBiomes[mapI] ),
+                        &( mMapFloors[mapI] ),
+                        &( mMap[mapI] ) );
+                
+                if( mMap[mapI] != oldMapID ) {
+                    // our placement status cleared
+                    mMapPlayerPlacedFlags[mapI] = false;
+                    }
+
+                mMapContainedStacks[mapI].deleteAll();
+                mMapSubContainedStacks[mapI].deleteAll();
+                
+                if( strstr( tokens->getElementDirect(i), "," ) 
+                    != NULL ) {
+                    
+                    int numInts;
+                    char **ints = 
+                        split( tokens->getElementDirect(i), 
+                               ",", &numInts );
+                    
+                    delete [] ints[0];
+                    
+                    int numContained = numInts - 1;
+                    
+                    for( int c=0; c<numContained; c++ ) {
+                        SimpleVector<int> newSubStack;
+                        
+                        mMapSubContainedStacks[mapI].push_back(
+                            newSubStack );
+                        
+                        int contained = atoi( ints[ c + 1 ] );
+                        mMapContainedStacks[mapI].push_back( 
+                            contained );
+                        
+                        if( strstr( ints[c + 1], ":" ) != NULL ) {
+                            // sub-container items
+                    
+                            int numSubInts;
+                            char **subInts = 
+                                split( ints[c + 1], 
+                                       ":", &numSubInts );
+                    
+                            delete [] subInts[0];
+                            int numSubCont = numSubInts - 1;
+
+                            SimpleVector<int> *subStack =
+                                mMapSubContainedStacks[mapI].
+                                getElement(c);
+
+                            for( int s=0; s<numSubCont; s++ ) {
+                                subStack->push_back(
+                                    atoi( subInts[ s + 1 ] ) );
+                                delete [] subInts[ s + 1 ];
+                                }
+
+                            delete [] subInts;
+                            }
+
+                        delete [] ints[ c + 1 ];
+                        }
+                    delete [] ints;
+                    }
+                }
+            }
+        }   
+    
+    tokens->deallocateStringElements();
+    delete tokens;
+    }
+
+
+
+
+void LivingLifePage::applyBinaryMapChunk( unsigned char *inData, 
+                                          int inLength,
+                                          int inSizeX, int inSizeY,
+                                          int inX, int inY,
+                                          int inRawX, int inRawY ) {
+    int numCells = inSizeX * inSizeY;
+    
+    MapChunkCell *cells = new MapChunkCell[ numCells ];
+    unsigned char *unchanged = new unsigned char[ numCells ];
+    
+    if( ! decodeBinaryMapChunk( inData, inLength, numCells, 
+                                unchanged, cells ) ) {
+        printf( "Decoding binary map chunk failed\n" );
+        
+        delete [] cells;
+        delete [] unchanged;
+        return;
+        }
+    
+    for( int i=0; i<numCells; i++ ) {
+        int cX = i % inSizeX;
+        int cY = i / inSizeX;
+        
+        int cacheX = cX + inRawX;
+        int cacheY = cY + inRawY;
+        
+        int slot = getMapChunkCacheSlot( cacheX, cacheY );
+        
+        MapChunkCell *cell = &( cells[i] );
+        
+        if( unchanged[i] ) {
+            if( ! mMapChunkCacheValid[slot] ||
+                mMapChunkCachePos[slot].x != cacheX ||
+                mMapChunkCachePos[slot].y != cacheY ) {
+                // server thinks we have this, but we don't
+                // should never happen
+                printf( "Binary map chunk cell %d,%d missing from cache\n",
+                        cacheX, cacheY );
+                continue;
+                }
+            cell = &( mMapChunkCacheCells[slot] );
+            }
+        else {
+            mMapChunkCacheCells[slot] = *cell;
+            mMapChunkCachePos[slot].x = cacheX;
+            mMapChunkCachePos[slot].y = cacheY;
+            mMapChunkCacheValid[slot] = true;
+            }
+        
+
+        int mapX = cX + inX - mMapOffsetX + mMapD / 2;
+        int mapY = cY + inY - mMapOffsetY + mMapD / 2;
+                        
+        if( mapX >= 0 && mapX < mMapD
+            &&
+            mapY >= 0 && mapY < mMapD ) {
+            
+            int mapI = getMapCellIndex( mapX, mapY );
+            int oldMapID = mMap[mapI];
+            
+            mMapBiomes[mapI] = cell->biome;
+            mMapFloors[mapI] = cell->floor;
+            mMap[mapI] = cell->object;
+                            
+            if( mMap[mapI] != oldMapID ) {
+                // our placement status cleared
+                mMapPlayerPlacedFlags[mapI] = false;
+                }
+            
+            mMapContainedStacks[mapI] = cell->contained;
+            mMapSubContainedStacks[mapI] = cell->subContained;
+            }
+        }
+    
+    delete [] cells;
+    delete [] unchanged;
+    }
+
+
+
 int LivingLifePage::sendX( int inX ) {
     if( mMapGlobalOffsetSet ) {
         return inX + mMapGlobalOffset.x;
@@ -14233,7 +14154,7 @@ void LivingLifePage::step() {
                 
                 if( dist < closeDist ) {
                     
-                    int mapI = y * mMapD + x;
+                    int mapI = getMapCellIndex( x, y );
                     
                     int mapID = mMap[ mapI ];
                     
@@ -15252,11 +15173,36 @@ void LivingLifePage::step() {
                 loginWord = "RLOGIN";
                 }
 
+            
+            // server starts with an empty cache for each new connection
+            memset( mMapChunkCacheValid, false, 
+                    MAP_CHUNK_CACHE_D * MAP_CHUNK_CACHE_D );
+            
+            mBinaryMapChunks = 
+                SettingsManager::getIntSetting( "useBinaryMapChunks", 0 );
+            
+            const char *binaryTag = "";
+            
+            if( mBinaryMapChunks ) {
+                binaryTag = BINARY_MAP_CHUNK_CLIENT_TAG;
+                }
+            
+            // only switched on if server echoes tag back in ACCEPTED
+            mBinaryClientActions = false;
+            
+            const char *actionTag = "";
+            
+            if( SettingsManager::getIntSetting( "useBinaryClientActions", 
+                                                0 ) ) {
+                actionTag = BINARY_CLIENT_ACTION_TAG;
+                }
+
 
             if( strlen( userEmail ) <= 80 ) {    
-                outMessage = autoSprintf( "%s %s %-80s %s %s %d%s#",
+                outMessage = autoSprintf( "%s %s%s%s %-80s %s %s %d%s#",
                                           loginWord,
-                                          clientTag, tempEmail, pwHash, keyHash,
+                                          clientTag, binaryTag, actionTag,
+                                          tempEmail, pwHash, keyHash,
                                           mTutorialNumber, twinExtra );
                 }
             else {
@@ -15264,9 +15210,10 @@ void LivingLifePage::step() {
                 // don't cut it off.
                 // but note that the playback will fail if email.ini
                 // doesn't match on the playback machine
-                outMessage = autoSprintf( "%s %s %s %s %s %d%s#",
+                outMessage = autoSprintf( "%s %s%s%s %s %s %s %d%s#",
                                           loginWord,
-                                          clientTag, tempEmail, pwHash, keyHash,
+                                          clientTag, binaryTag, actionTag,
+                                          tempEmail, pwHash, keyHash,
                                           mTutorialNumber, twinExtra );
                 }
             
@@ -15285,11 +15232,15 @@ void LivingLifePage::step() {
         else if( type == ACCEPTED ) {
             // logged in successfully, wait for next message
             
-            // subsequent messages should all be part of FRAME batches
-            waitForFrameMessages = true;
+            // subsequent messages are all part of FRAME batches,
+            // which server receiver only passes on once complete
 
             SettingsManager::setSetting( "loginSuccess", 1 );
 
+            if( strstr( message, BINARY_CLIENT_ACTION_TAG ) != NULL ) {
+                mBinaryClientActions = true;
+                }
+
             delete [] message;
 
             
@@ -15979,9 +15930,16 @@ void LivingLifePage::step() {
             int binarySize = 0;
             int compressedSize = 0;
             
-            sscanf( message, "MC\n%d %d %d %d\n%d %d\n", 
+            // MC or MB
+            sscanf( message, "M%*c\n%d %d %d %d\n%d %d\n", 
                     &sizeX, &sizeY, &x, &y, &binarySize, &compressedSize );
             
+            char binaryChunkBody = ( strstr( message, "MB" ) == message );
+            
+            // keep coordinates as sent, for MB cache
+            int rawX = x;
+            int rawY = y;
+            
             printf( "Got map chunk with bin size %d, compressed size %d\n", 
                     binarySize, compressedSize );
             
@@ -16020,358 +15978,55 @@ void LivingLifePage::step() {
             int newMapOffsetX = x + sizeX/2;
             int newMapOffsetY = y + sizeY/2;
             
-            // move old cached map cells over to line up with new center
-
-            int xMove = mMapOffsetX - newMapOffsetX;
-            int yMove = mMapOffsetY - newMapOffsetY;
-            
-            int *newMap = new int[ mMapD * mMapD ];
-            int *newMapBiomes = new int[ mMapD * mMapD ];
-            int *newMapFloors = new int[ mMapD * mMapD ];
-            
+            // cells that stay in view keep their spot in the map ring
+            // buffer, so only cells that scroll in need to be reset
 
-            double *newMapAnimationFrameCount = new double[ mMapD * mMapD ];
-            double *newMapAnimationLastFrameCount = new double[ mMapD * mMapD ];
-
-            double *newMapAnimationFrozenRotFameCount = 
-                new double[ mMapD * mMapD ];
-
-            char *newMapAnimationFrozenRotFameCountUsed = 
-                new char[ mMapD * mMapD ];
-
-            int *newMapFloorAnimationFrameCount = new int[ mMapD * mMapD ];
-        
-            AnimType *newMapCurAnimType = new AnimType[ mMapD * mMapD ];
-            AnimType *newMapLastAnimType = new AnimType[ mMapD * mMapD ];
-            double *newMapLastAnimFade = new double[ mMapD * mMapD ];
+            // where old map lies relative to new map
+            int oldStartX = mMapOffsetX - newMapOffsetX;
+            int oldStartY = mMapOffsetY - newMapOffsetY;
             
-            doublePair *newMapDropOffsets = new doublePair[ mMapD * mMapD ];
-            double *newMapDropRot = new double[ mMapD * mMapD ];
-            SoundUsage *newMapDropSounds = new SoundUsage[ mMapD * mMapD ];
-
-            doublePair *newMapMoveOffsets = new doublePair[ mMapD * mMapD ];
-            double *newMapMoveSpeeds = new double[ mMapD * mMapD ];
-
-
-            char *newMapTileFlips= new char[ mMapD * mMapD ];
-            
-            SimpleVector<int> *newMapContainedStacks = 
-                new SimpleVector<int>[ mMapD * mMapD ];
-            
-            SimpleVector< SimpleVector<int> > *newMapSubContainedStacks = 
-                new SimpleVector< SimpleVector<int> >[ mMapD * mMapD ];
-
-            char *newMapPlayerPlacedFlags = new char[ mMapD * mMapD ];
-
+            mMapOffsetX = newMapOffsetX;
+            mMapOffsetY = newMapOffsetY;
             
-            for( int i=0; i<mMapD *mMapD; i++ ) {
-                // starts uknown, not empty
-                newMap[i] = -1;
-                newMapBiomes[i] = -1;
-                newMapFloors[i] = -1;
-
-                int newX = i % mMapD;
-                int newY = i / mMapD;
-
-                int worldX = newX + mMapOffsetX - mMapD / 2;
-                int worldY = newY + mMapOffsetY - mMapD / 2;
-                
-                // each cell is different, but always the same
-                newMapAnimationFrameCount[i] =
-                    lrint( getXYRandom( worldX, worldY ) * 10000 );
-                newMapAnimationLastFrameCount[i] =
-                    newMapAnimationFrameCount[i];
-                
-                newMapAnimationFrozenRotFameCount[i] = 0;
-                newMapAnimationFrozenRotFameCountUsed[i] = false;
-                
-                newMapFloorAnimationFrameCount[i] =
-                    lrint( getXYRandom( worldX, worldY ) * 13853 );
-                
+            for( int mapY=0; mapY<mMapD; mapY++ ) {
                 
-
-                newMapCurAnimType[i] = ground;
-                newMapLastAnimType[i] = ground;
-                newMapLastAnimFade[i] = 0;
-                newMapDropOffsets[i].x = 0;
-                newMapDropOffsets[i].y = 0;
-                newMapDropRot[i] = 0;
-                
-                newMapDropSounds[i] = blankSoundUsage;
-                
-                newMapMoveOffsets[i].x = 0;
-                newMapMoveOffsets[i].y = 0;
-                newMapMoveSpeeds[i] = 0;
-
-                newMapTileFlips[i] = false;
-                newMapPlayerPlacedFlags[i] = false;
-                
-
+                char rowInOld = ( mapY >= oldStartY && 
+                                  mapY < oldStartY + mMapD );
                 
-                int oldX = newX - xMove;
-                int oldY = newY - yMove;
-                
-                if( oldX >= 0 && oldX < mMapD
-                    &&
-                    oldY >= 0 && oldY < mMapD ) {
+                for( int mapX=0; mapX<mMapD; mapX++ ) {
                     
-                    int oI = oldY * mMapD + oldX;
-
-                    newMap[i] = mMap[oI];
-                    newMapBiomes[i] = mMapBiomes[oI];
-                    newMapFloors[i] = mMapFloors[oI];
-
-                    newMapAnimationFrameCount[i] = mMapAnimationFrameCount[oI];
-                    newMapAnimationLastFrameCount[i] = 
-                        mMapAnimationLastFrameCount[oI];
-
-                    newMapAnimationFrozenRotFameCount[i] = 
-                        mMapAnimationFrozenRotFrameCount[oI];
-
-                    newMapAnimationFrozenRotFameCountUsed[i] = 
-                        mMapAnimationFrozenRotFrameCountUsed[oI];
-
-                    newMapFloorAnimationFrameCount[i] = 
-                        mMapFloorAnimationFrameCount[oI];
-                    
-                    newMapCurAnimType[i] = mMapCurAnimType[oI];
-                    newMapLastAnimType[i] = mMapLastAnimType[oI];
-                    newMapLastAnimFade[i] = mMapLastAnimFade[oI];
-                    newMapDropOffsets[i] = mMapDropOffsets[oI];
-                    newMapDropRot[i] = mMapDropRot[oI];
-                    newMapDropSounds[i] = mMapDropSounds[oI];
-
-                    newMapMoveOffsets[i] = mMapMoveOffsets[oI];
-                    newMapMoveSpeeds[i] = mMapMoveSpeeds[oI];
-
-                    newMapTileFlips[i] = mMapTileFlips[oI];
+                    if( rowInOld && 
+                        mapX >= oldStartX && mapX < oldStartX + mMapD ) {
+                        // already have this one
+                        continue;
+                        }
                     
-
-                    newMapContainedStacks[i] = mMapContainedStacks[oI];
-                    newMapSubContainedStacks[i] = mMapSubContainedStacks[oI];
-
-                    newMapPlayerPlacedFlags[i] = 
-                        mMapPlayerPlacedFlags[oI];
+                    resetMapCell( getMapCellIndex( mapX, mapY ),
+                                  mapX + mMapOffsetX - mMapD / 2,
+                                  mapY + mMapOffsetY - mMapD / 2 );
                     }
                 }
             
-            memcpy( mMap, newMap, mMapD * mMapD * sizeof( int ) );
-            memcpy( mMapBiomes, newMapBiomes, mMapD * mMapD * sizeof( int ) );
-            memcpy( mMapFloors, newMapFloors, mMapD * mMapD * sizeof( int ) );
-
-            memcpy( mMapAnimationFrameCount, newMapAnimationFrameCount, 
-                    mMapD * mMapD * sizeof( double ) );
-            memcpy( mMapAnimationLastFrameCount, 
-                    newMapAnimationLastFrameCount, 
-                    mMapD * mMapD * sizeof( double ) );
-
-            memcpy( mMapAnimationFrozenRotFrameCount, 
-                    newMapAnimationFrozenRotFameCount, 
-                    mMapD * mMapD * sizeof( double ) );
-
-            memcpy( mMapAnimationFrozenRotFrameCountUsed, 
-                    newMapAnimationFrozenRotFameCountUsed, 
-                    mMapD * mMapD * sizeof( char ) );
-
-            
-            memcpy( mMapFloorAnimationFrameCount, 
-                    newMapFloorAnimationFrameCount, 
-                    mMapD * mMapD * sizeof( int ) );
-
-            
-            memcpy( mMapCurAnimType, newMapCurAnimType, 
-                    mMapD * mMapD * sizeof( AnimType ) );
-            memcpy( mMapLastAnimType, newMapLastAnimType,
-                    mMapD * mMapD * sizeof( AnimType ) );
-            memcpy( mMapLastAnimFade, newMapLastAnimFade,
-                    mMapD * mMapD * sizeof( double ) );
-            memcpy( mMapDropOffsets, newMapDropOffsets,
-                    mMapD * mMapD * sizeof( doublePair ) );
-            memcpy( mMapDropRot, newMapDropRot,
-                    mMapD * mMapD * sizeof( double ) );
-            memcpy( mMapDropSounds, newMapDropSounds,
-                    mMapD * mMapD * sizeof( SoundUsage ) );
-
-            memcpy( mMapMoveOffsets, newMapMoveOffsets,
-                    mMapD * mMapD * sizeof( doublePair ) );
-            memcpy( mMapMoveSpeeds, newMapMoveSpeeds,
-                    mMapD * mMapD * sizeof( double ) );
-
-            
-            memcpy( mMapTileFlips, newMapTileFlips,
-                    mMapD * mMapD * sizeof( char ) );
-            
-            // can't memcpy vectors
-            // need to assign them so copy constructors are invoked
-            for( int i=0; i<mMapD *mMapD; i++ ) {
-                mMapContainedStacks[i] = newMapContainedStacks[i];
-                mMapSubContainedStacks[i] = newMapSubContainedStacks[i];
-                }
-            
-
-            memcpy( mMapPlayerPlacedFlags, newMapPlayerPlacedFlags,
-                    mMapD * mMapD * sizeof( char ) );
-            
-            delete [] newMap;
-            delete [] newMapBiomes;
-            delete [] newMapFloors;
-            delete [] newMapAnimationFrameCount;
-            delete [] newMapAnimationLastFrameCount;
-            delete [] newMapAnimationFrozenRotFameCount;
-            delete [] newMapAnimationFrozenRotFameCountUsed;
-            delete [] newMapFloorAnimationFrameCount;
-            
-            delete [] newMapCurAnimType;
-            delete [] newMapLastAnimType;
-            delete [] newMapLastAnimFade;
-            delete [] newMapDropOffsets;
-            delete [] newMapDropRot;
-            delete [] newMapDropSounds;
-
-            delete [] newMapMoveOffsets;
-            delete [] newMapMoveSpeeds;
-            
-            delete [] newMapTileFlips;
-            delete [] newMapContainedStacks;
-            delete [] newMapSubContainedStacks;
-            
-            delete [] newMapPlayerPlacedFlags;
-            
-            
-
-            mMapOffsetX = newMapOffsetX;
-            mMapOffsetY = newMapOffsetY;
             
-            
-            unsigned char *compressedChunk = 
-                new unsigned char[ compressedSize ];
-    
-            
-            for( int i=0; i<compressedSize; i++ ) {
-                compressedChunk[i] = serverSocketBuffer.getElementDirect( i );
-                }
-            serverSocketBuffer.deleteStartElements( compressedSize );
-
-            
-            unsigned char *decompressedChunk =
-                zipDecompress( compressedChunk, 
-                               compressedSize,
-                               binarySize );
-            
-            delete [] compressedChunk;
+            // server receiver already decompressed the body
+            unsigned char *decompressedChunk = mapChunkBody;
+            mapChunkBody = NULL;
             
             if( decompressedChunk == NULL ) {
                 printf( "Decompressing chunk failed\n" );
                 }
             else {
                 
-                unsigned char *binaryChunk = 
-                    new unsigned char[ binarySize + 1 ];
-            
-                memcpy( binaryChunk, decompressedChunk, binarySize );
-            
-                delete [] decompressedChunk;
- 
-            
-                // for now, binary chunk is actually just ASCII
-                binaryChunk[ binarySize ] = '\0';
-            
-                
-                SimpleVector<char *> *tokens = 
-                    tokenizeString( (char*)binaryChunk );
-            
-                delete [] binaryChunk;
-
-
-                int numCells = sizeX * sizeY;
-                
-                if( tokens->size() == numCells ) {
-                    
-                    for( int i=0; i<tokens->size(); i++ ) {
-                        int cX = i % sizeX;
-                        int cY = i / sizeX;
-                        
-                        int mapX = cX + x - mMapOffsetX + mMapD / 2;
-                        int mapY = cY + y - mMapOffsetY + mMapD / 2;
-                        
-                        if( mapX >= 0 && mapX < mMapD
-                            &&
-                            mapY >= 0 && mapY < mMapD ) {
-                            
-                            
-                            int mapI = mapY * mMapD + mapX;
-                            int oldMapID = mMap[mapI];
-                            
-                            sscanf( tokens->getElementDirect(i),
-                                    "%d:%d:%d", 
-                                    &( mMapBiomes[mapI] ),
-                                    &( mMapFloors[mapI] ),
-                                    &( mMap[mapI] ) );
-                            
-                            if( mMap[mapI] != oldMapID ) {
-                                // our placement status cleared
-                                mMapPlayerPlacedFlags[mapI] = false;
-                                }
-
-                            mMapContainedStacks[mapI].deleteAll();
-                            mMapSubContainedStacks[mapI].deleteAll();
-                            
-                            if( strstr( tokens->getElementDirect(i), "," ) 
-                                != NULL ) {
-                                
-                                int numInts;
-                                char **ints = 
-                                    split( tokens->getElementDirect(i), 
-                                           ",", &numInts );
-                                
-                                delete [] ints[0];
-                                
-                                int numContained = numInts - 1;
-                                
-                                for( int c=0; c<numContained; c++ ) {
-                                    SimpleVector<int> newSubStack;
-                                    
-                                    mMapSubContainedStacks[mapI].push_back(
-                                        newSubStack );
-                                    
-                                    int contained = atoi( ints[ c + 1 ] );
-                                    mMapContainedStacks[mapI].push_back( 
-                                        contained );
-                                    
-                                    if( strstr( ints[c + 1], ":" ) != NULL ) {
-                                        // sub-container items
-                                
-                                        int numSubInts;
-                                        char **subInts = 
-                                            split( ints[c + 1], 
-                                                   ":", &numSubInts );
-                                
-                                        delete [] subInts[0];
-                                        int numSubCont = numSubInts - 1;
-
-                                        SimpleVector<int> *subStack =
-                                            mMapSubContainedStacks[mapI].
-                                            getElement(c);
-
-                                        for( int s=0; s<numSubCont; s++ ) {
-                                            subStack->push_back(
-                                                atoi( subInts[ s + 1 ] ) );
-                                            delete [] subInts[ s + 1 ];
-                                            }
-
-                                        delete [] subInts;
-                                        }
-
-                                    delete [] ints[ c + 1 ];
-                                    }
-                                delete [] ints;
-                                }
-                            }
-                        }
-                    }   
+                if( binaryChunkBody ) {
+                    applyBinaryMapChunk( decompressedChunk, binarySize,
+                                         sizeX, sizeY, x, y, rawX, rawY );
+                    }
+                else {
+                    applyTextMapChunk( decompressedChunk, binarySize,
+                                       sizeX, sizeY, x, y );
+                    }
                 
-                tokens->deallocateStringElements();
-                delete tokens;
+                delete [] decompressedChunk;
                 
                 if( !( mFirstServerMessagesReceived & 1 ) ) {
                     // first map chunk just recieved
@@ -16395,7 +16050,7 @@ void LivingLifePage::step() {
                     for( int mapY=0; mapY < mMapD; mapY++ ) {
                         for( int mapX=0; mapX < mMapD; mapX++ ) {
                         
-                            int i = mMapD * mapY + mapX;
+                            int i = getMapCellIndex( mapX, mapY );
                             
                             int id = mMap[ i ];
                             
@@ -16529,7 +16184,7 @@ void LivingLifePage::step() {
                         &&
                         mapY >= 0 && mapY < mMapD ) {
                         
-                        int mapI = mapY * mMapD + mapX;
+                        int mapI = getMapCellIndex( mapX, mapY );
                         
                         int oldFloor = mMapFloors[ mapI ];
 
@@ -17070,7 +16725,8 @@ void LivingLifePage::step() {
                                                 mapRY >= 0 && mapRY < mMapD ) {
                         
                                                 int mapRI = 
-                                                    mapRY * mMapD + mapRX;
+                                                    getMapCellIndex( mapRX, 
+                                                                     mapRY );
                         
                                                 int cellID = mMap[ mapRI ];
                                                 
@@ -18534,8 +18190,8 @@ void LivingLifePage::step() {
                                         mapHeldOriginY < mMapD ) {
                                         
                                         int mapHeldOriginI = 
-                                            mapHeldOriginY * mMapD + 
-                                            mapHeldOriginX;
+                                            getMapCellIndex( mapHeldOriginX,
+                                                             mapHeldOriginY );
                                         
                                         if( mMapMoveSpeeds[ mapHeldOriginI ]
                                             > 0 &&
@@ -18585,7 +18241,7 @@ void LivingLifePage::step() {
                                         &&
                                         mapY >= 0 && mapY < mMapD ) {
                                         
-                                        int mapI = mapY * mMapD + mapX;
+                                        int mapI = getMapCellIndex( mapX, mapY );
                                         
                                         existing->heldFrozenRotFrameCount =
                                             mMapAnimationFrozenRotFrameCount
@@ -23561,8 +23217,6 @@ void LivingLifePage::makeActive( char inFresh ) {
     showNet = false;
     showPing = false;
     
-    waitForFrameMessages = false;
-
     serverSocketConnected = false;
     serverSocketHardFail = false;
     connectionMessageFade = 1.0f;
@@ -23747,13 +23401,8 @@ void LivingLifePage::makeActive( char inFresh ) {
     setWaiting( true, false );
 
     readyPendingReceivedMessages.deallocateStringElements();
-    serverFrameMessages.deallocateStringElements();
 
-    if( pendingMapChunkMessage != NULL ) {
-        delete [] pendingMapChunkMessage;
-        pendingMapChunkMessage = NULL;
-        }
-    pendingCMData = false;
+    clearReceivedServerMessages();
     
 
     clearLiveObjects();
@@ -23772,8 +23421,6 @@ void LivingLifePage::makeActive( char inFresh ) {
     yumEvaluatedRebirth = false;
     yumDidAutoSIDS = false;
 
-    serverSocketBuffer.deleteAll();
-
     if( nextActionMessageToSend != NULL ) {    
         delete [] nextActionMessageToSend;
         nextActionMessageToSend = NULL;
@@ -23820,7 +23467,7 @@ void LivingLifePage::checkForPointerHit( PointerHitRecord *inRecord,
     int clickDestMapX = clickDestX - mMapOffsetX + mMapD / 2;
     int clickDestMapY = clickDestY - mMapOffsetY + mMapD / 2;
     
-    int clickDestMapI = clickDestMapY * mMapD + clickDestMapX;
+    int clickDestMapI = getMapCellIndex( clickDestMapX, clickDestMapY );
     
     if( clickDestMapY >= 0 && clickDestMapY < mMapD &&
         clickDestMapX >= 0 && clickDestMapX < mMapD ) {
@@ -23956,7 +23603,7 @@ void LivingLifePage::checkForPointerHit( PointerHitRecord *inRecord,
                 }
             
 
-            int mapI = mapY * mMapD + mapX;
+            int mapI = getMapCellIndex( mapX, mapY );
 
             int oID = mMap[ mapI ];
             
@@ -24148,7 +23795,7 @@ void LivingLifePage::checkForPointerHit( PointerHitRecord *inRecord,
                 continue;
                 }
 
-            int mapI = mapY * mMapD + mapX;
+            int mapI = getMapCellIndex( mapX, mapY );
 
             int oID = mMap[ mapI ];
             
@@ -24397,11 +24044,11 @@ void LivingLifePage::pointerMove( float inX, float inY ) {
         mapX >= 0 && mapX < mMapD ) {
         
         if( p.hitAnObject ) {
-            destID = mMap[ mapY * mMapD + mapX ];
+            destID = mMap[ getMapCellIndex( mapX, mapY ) ];
             }
         
-        destBiome = mMapBiomes[ mapY * mMapD + mapX ];
-        destFloor = mMapFloors[ mapY * mMapD + mapX ];
+        destBiome = mMapBiomes[ getMapCellIndex( mapX, mapY ) ];
+        destFloor = mMapFloors[ getMapCellIndex( mapX, mapY ) ];
         }
 
 
@@ -24507,7 +24154,7 @@ void LivingLifePage::pointerMove( float inX, float inY ) {
         
         if( p.hitSlotIndex != -1 ) {
             mCurMouseOverID = 
-                mMapContainedStacks[ mapY * mMapD + mapX ].
+                mMapContainedStacks[ getMapCellIndex( mapX, mapY ) ].
                 getElementDirect( p.hitSlotIndex );
             }
         
@@ -24608,7 +24255,7 @@ char LivingLifePage::getCellBlocksWalking( int inMapX, int inMapY ) {
     if( inMapY >= 0 && inMapY < mMapD &&
         inMapX >= 0 && inMapX < mMapD ) {
         
-        int destID = mMap[ inMapY * mMapD + inMapX ];
+        int destID = mMap[ getMapCellIndex( inMapX, inMapY ) ];
         
         
         if( destID > 0 && getObject( destID )->blocksWalking ) {
@@ -24629,7 +24276,7 @@ char LivingLifePage::getCellBlocksWalking( int inMapX, int inMapY ) {
                 endX = mMapD - 1;
                 }
             for( int x=startX; x<=endX; x++ ) {
-                int nID = mMap[ inMapY * mMapD + x ];
+                int nID = mMap[ getMapCellIndex( x, inMapY ) ];
 
                 if( nID > 0 ) {
                     ObjectRecord *nO = getObject( nID );
@@ -25110,8 +24757,8 @@ void LivingLifePage::pointerDown( float inX, float inY ) {
         mapY >= 0 && mapY < mMapD &&
         mapX >= 0 && mapX < mMapD ) {
         
-        destID = mMap[ mapY * mMapD + mapX ];
-        floorDestID = mMapFloors[ mapY * mMapD + mapX ];
+        destID = mMap[ getMapCellIndex( mapX, mapY ) ];
+        floorDestID = mMapFloors[ getMapCellIndex( mapX, mapY ) ];
         
         destObjInClickedTile = destID;
 
@@ -25120,7 +24767,8 @@ void LivingLifePage::pointerDown( float inX, float inY ) {
                 getObject( destObjInClickedTile )->permanent;
             }
     
-        destNumContained = mMapContainedStacks[ mapY * mMapD + mapX ].size();
+        destNumContained = 
+            mMapContainedStacks[ getMapCellIndex( mapX, mapY ) ].size();
         
 
         // if holding something, and this is a set-down action
@@ -25128,7 +24776,7 @@ void LivingLifePage::pointerDown( float inX, float inY ) {
         if( modClick &&
             ourLiveObject->holdingID != 0 ) {
         
-            int mapI = mapY * mMapD + mapX;
+            int mapI = getMapCellIndex( mapX, mapY );
             
             int id = mMap[mapI];
             
@@ -25328,7 +24976,7 @@ void LivingLifePage::pointerDown( float inX, float inY ) {
                     if( mapPY >= 0 && mapPY < mMapD &&
                         mapPX >= 0 && mapPX < mMapD ) {
                         
-                        int oID = mMap[ mapPY * mMapD + mapPX ];
+                        int oID = mMap[ getMapCellIndex( mapPX, mapPY ) ];
 
                         if( oID == 0 
                             ||
@@ -25812,7 +25460,7 @@ void LivingLifePage::pointerDown( float inX, float inY ) {
                     x >= 0 && x < mMapD ) {
                  
                     
-                    int mapI = y * mMapD + x;
+                    int mapI = getMapCellIndex( x, y );
                     
                     if( mMap[ mapI ] == 0
                         ||
@@ -26187,7 +25835,7 @@ void LivingLifePage::pointerDown( float inX, float inY ) {
                 if( mapY >= 0 && mapY < mMapD &&
                     mapX >= 0 && mapX < mMapD ) {
                     
-                    int mapI = mapY * mMapD + mapX;
+                    int mapI = getMapCellIndex( mapX, mapY );
                     
                     if( mMapMoveSpeeds[ mapI ] > 0 ) {        
                         
@@ -24,6 +24,9 @@
 
 #include "TextField.h"
 
+#include "../commonSource/binaryMapChunk.h"
+#include "../commonSource/binaryClientAction.h"
+
 #include <string>
 
 
@@ -719,6 +722,35 @@ class LivingLifePage : public GamePage, public ActionListener {
         // player was responsible for placing
         char *mMapPlayerPlacedFlags;
         
+
+        // true if we asked server for MB map chunks during login
+        char mBinaryMapChunks;
+        
+        // true if server echoed BINARY_CLIENT_ACTION_TAG back with ACCEPTED
+        char mBinaryClientActions;
+        
+        // reused for encoding binary action frames
+        SimpleVector<unsigned char> mBinaryActionFrame;
+        
+        // last-sent cells for MB map chunks, see binaryMapChunk.h
+        // MAP_CHUNK_CACHE_D * MAP_CHUNK_CACHE_D slots
+        MapChunkCell *mMapChunkCacheCells;
+        GridPos *mMapChunkCachePos;
+        char *mMapChunkCacheValid;
+        
+        // applies decompressed MC chunk body, one text token per cell
+        void applyTextMapChunk( unsigned char *inData, int inLength,
+                                int inSizeX, int inSizeY,
+                                int inX, int inY );
+
+        // applies decoded MB chunk body to map
+        // inRawX, inRawY is chunk corner as received, before
+        // applyReceiveOffset
+        void applyBinaryMapChunk( unsigned char *inData, int inLength,
+                                  int inSizeX, int inSizeY,
+                                  int inX, int inY,
+                                  int inRawX, int inRawY );
+        
         SimpleVector<GridPos> mMapExtraMovingObjectsDestWorldPos;
         SimpleVector<int> mMapExtraMovingObjectsDestObjectIDs;
         SimpleVector<ExtraMapObject> mMapExtraMovingObjects;
@@ -726,6 +758,28 @@ class LivingLifePage : public GamePage, public ActionListener {
         public: // minitech
         int mMapOffsetX;
         int mMapOffsetY;
+
+        // map cell arrays are a ring buffer indexed by world position
+        // wrapped to mMapD (a power of 2), so cells stay put when the map
+        // recenters, and only cells that scroll in need to be reset
+
+        // index in map cell arrays for map (not world) x,y
+        int getMapCellIndex( int inMapX, int inMapY ) {
+            int mask = mMapD - 1;
+            int worldX = inMapX + mMapOffsetX - mMapD / 2;
+            int worldY = inMapY + mMapOffsetY - mMapD / 2;
+
+            return ( worldY & mask ) * mMapD + ( worldX & mask );
+            }
+
+        // map x,y for an index in map cell arrays
+        GridPos getMapCellPos( int inMapI ) {
+            int mask = mMapD - 1;
+            GridPos p =
+                { ( inMapI % mMapD - mMapOffsetX + mMapD / 2 ) & mask,
+                  ( inMapI / mMapD - mMapOffsetY + mMapD / 2 ) & mask };
+            return p;
+            }
 		protected: // minitech
 
         char mEKeyEnabled;
@@ -932,6 +986,10 @@ class LivingLifePage : public GamePage, public ActionListener {
 
         // -1 if outside bounds of locally stored map
         int getMapIndex( int inWorldX, int inWorldY );
+
+        // sets map cell at index to unknown, for a world spot that just
+        // scrolled into locally stored map
+        void resetMapCell( int inMapI, int inWorldX, int inWorldY );
         
 
         int mCurrentArrowI;
@@ -0,0 +1,498 @@
+#include "bankSnapshot.h"
+
+#include "minorGems/io/file/File.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/util/crc32.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+// Layout:
+// BankSnapshotHeader
+// object section bytes
+// category section bytes
+// transition section bytes
+
+
+#define BANK_SNAPSHOT_MAGIC 0x534B4E42
+#define BANK_SNAPSHOT_VERSION 1
+
+typedef struct BankSnapshotHeader {
+        uint32_t magic;
+        uint32_t version;
+
+        // crc32 of sorted name/size/mtime listing of source .txt files
+        // and of each folder's cache.fcz
+        uint32_t sourceKey;
+        uint32_t sourceListingLength;
+
+        uint32_t sectionTag[ endSnapshotSection ];
+        uint32_t sectionRecordSize[ endSnapshotSection ];
+        uint32_t sectionLength[ endSnapshotSection ];
+    } BankSnapshotHeader;
+
+
+
+typedef struct SnapshotSectionRecord {
+        char present;
+
+        // freshly built by bank this run (bytes owned here)
+        // rather than pointing into loaded file data
+        char fresh;
+
+        uint32_t tag;
+        uint32_t recordSize;
+
+        int length;
+        unsigned char *bytes;
+    } SnapshotSectionRecord;
+
+
+// false if source folders couldn't be keyed
+static char snapshotEnabled = false;
+
+static uint32_t sourceKey = 0;
+static uint32_t sourceListingLength = 0;
+
+static File *snapshotFile = NULL;
+
+// whole snapshot file, read in one go
+static unsigned char *loadedData = NULL;
+
+static SnapshotSectionRecord sections[ endSnapshotSection ];
+
+
+
+typedef struct SourceListingEntry {
+        char *name;
+        long length;
+        timeSec_t modTime;
+    } SourceListingEntry;
+
+
+static int compareListingEntries( const void *inA, const void *inB ) {
+    SourceListingEntry *a = (SourceListingEntry *)inA;
+    SourceListingEntry *b = (SourceListingEntry *)inB;
+
+    return strcmp( a->name, b->name );
+    }
+
+
+
+// appends name, size, and modification time of every .txt file in folder,
+// sorted by name, then size and modification time of folder's cache.fcz
+// returns false if folder or its cache.fcz is missing
+static char appendSourceListing( SimpleVector<unsigned char> *inListing,
+                                 const char *inFolderName ) {
+    File folder( NULL, inFolderName );
+
+    if( ! folder.exists() || ! folder.isDirectory() ) {
+        return false;
+        }
+
+    File *cacheFile = folder.getChildFile( "cache.fcz" );
+    if( ! cacheFile->exists() ) {
+        delete cacheFile;
+        // folder cache being rebuilt, let banks rebuild it from sources
+        return false;
+        }
+
+    // banks load from cache.fcz when present, so a cache rebuilt
+    // or replaced without touching any .txt must change key too
+    int64_t cacheLength = cacheFile->getLength();
+    timeSec_t cacheModTime = cacheFile->getModificationTime();
+    delete cacheFile;
+
+    int numFiles;
+    File **files = folder.getChildFiles( &numFiles );
+
+    SimpleVector<SourceListingEntry> entries;
+
+    for( int i=0; i<numFiles; i++ ) {
+        char *name = files[i]->getFileName();
+
+        int nameLength = strlen( name );
+
+        if( nameLength > 4 &&
+            strcmp( &( name[ nameLength - 4 ] ), ".txt" ) == 0 ) {
+
+            SourceListingEntry e = { name,
+                                     files[i]->getLength(),
+                                     files[i]->getModificationTime() };
+            entries.push_back( e );
+            }
+        else {
+            delete [] name;
+            }
+        delete files[i];
+        }
+    delete [] files;
+
+
+    SourceListingEntry *entryArray = entries.getElementArray();
+    int numEntries = entries.size();
+
+    qsort( entryArray, numEntries, sizeof( SourceListingEntry ),
+           compareListingEntries );
+
+    snapshotPushString( inListing, inFolderName );
+    snapshotPushInt( inListing, numEntries );
+
+    for( int i=0; i<numEntries; i++ ) {
+        SourceListingEntry *e = &( entryArray[i] );
+
+        snapshotPushString( inListing, e->name );
+
+        int64_t length = e->length;
+        snapshotPushBytes( inListing, &length, sizeof( length ) );
+        snapshotPushBytes( inListing, &( e->modTime ), sizeof( timeSec_t ) );
+
+        delete [] e->name;
+        }
+
+    delete [] entryArray;
+
+    snapshotPushBytes( inListing, &cacheLength, sizeof( cacheLength ) );
+    snapshotPushBytes( inListing, &cacheModTime, sizeof( timeSec_t ) );
+
+    return true;
+    }
+
+
+
+static void freeSnapshotData() {
+    for( int i=0; i<endSnapshotSection; i++ ) {
+        if( sections[i].fresh && sections[i].bytes != NULL ) {
+            delete [] sections[i].bytes;
+            }
+        sections[i].present = false;
+        sections[i].fresh = false;
+        sections[i].bytes = NULL;
+        sections[i].length = 0;
+        }
+
+    if( loadedData != NULL ) {
+        delete [] loadedData;
+        loadedData = NULL;
+        }
+
+    if( snapshotFile != NULL ) {
+        delete snapshotFile;
+        snapshotFile = NULL;
+        }
+
+    snapshotEnabled = false;
+    }
+
+
+
+static void readSnapshotFile() {
+    char *path = snapshotFile->getFullFileName();
+
+    FILE *inFile = fopen( path, "rb" );
+
+    delete [] path;
+
+    if( inFile == NULL ) {
+        return;
+        }
+
+    fseek( inFile, 0, SEEK_END );
+    long length = ftell( inFile );
+    fseek( inFile, 0, SEEK_SET );
+
+    if( length < (long)sizeof( BankSnapshotHeader ) ) {
+        fclose( inFile );
+        return;
+        }
+
+    unsigned char *data = new unsigned char[ length ];
+
+    long numRead = fread( data, 1, length, inFile );
+
+    fclose( inFile );
+
+    if( numRead != length ) {
+        delete [] data;
+        return;
+        }
+
+    BankSnapshotHeader header;
+    memcpy( &header, data, sizeof( header ) );
+
+    uint64_t totalLength = sizeof( header );
+
+    for( int i=0; i<endSnapshotSection; i++ ) {
+        totalLength += header.sectionLength[i];
+        }
+
+    if( header.magic != BANK_SNAPSHOT_MAGIC ||
+        header.version != BANK_SNAPSHOT_VERSION ||
+        header.sourceKey != sourceKey ||
+        header.sourceListingLength != sourceListingLength ||
+        totalLength != (uint64_t)length ) {
+
+        delete [] data;
+        return;
+        }
+
+    loadedData = data;
+
+    unsigned char *next = &( data[ sizeof( header ) ] );
+
+    for( int i=0; i<endSnapshotSection; i++ ) {
+        SnapshotSectionRecord *s = &( sections[i] );
+
+        s->tag = header.sectionTag[i];
+        s->recordSize = header.sectionRecordSize[i];
+        s->length = header.sectionLength[i];
+        s->bytes = next;
+        s->present = true;
+        s->fresh = false;
+
+        next += s->length;
+        }
+    }
+
+
+
+void openBankSnapshot( char inAutoGenerateUsedObjects,
+                       char inAutoGenerateVariableObjects ) {
+    freeSnapshotData();
+
+    SimpleVector<unsigned char> listing;
+
+    const char *folders[3] = { "objects", "categories", "transitions" };
+
+    for( int i=0; i<3; i++ ) {
+        if( ! appendSourceListing( &listing, folders[i] ) ) {
+            return;
+            }
+        }
+
+    unsigned char *listingBytes = listing.getElementArray();
+
+    sourceKey = crc32( listingBytes, listing.size() );
+    sourceListingLength = listing.size();
+
+    delete [] listingBytes;
+
+
+    File objectsFolder( NULL, "objects" );
+
+    char *name = autoSprintf( "snapshot_%d%d.bin",
+                              inAutoGenerateUsedObjects,
+                              inAutoGenerateVariableObjects );
+
+    snapshotFile = objectsFolder.getChildFile( name );
+
+    delete [] name;
+
+    snapshotEnabled = true;
+
+    readSnapshotFile();
+    }
+
+
+
+unsigned char *getBankSnapshotSection( BankSnapshotSection inSection,
+                                       uint32_t inTag,
+                                       uint32_t inRecordSize,
+                                       int *outLength ) {
+    SnapshotSectionRecord *s = &( sections[ inSection ] );
+
+    if( ! snapshotEnabled || ! s->present || s->fresh ||
+        s->tag != inTag || s->recordSize != inRecordSize ) {
+        return NULL;
+        }
+
+    *outLength = s->length;
+    return s->bytes;
+    }
+
+
+
+void setBankSnapshotSection( BankSnapshotSection inSection,
+                             uint32_t inTag,
+                             uint32_t inRecordSize,
+                             SimpleVector<unsigned char> *inData ) {
+    if( ! snapshotEnabled ) {
+        return;
+        }
+
+    SnapshotSectionRecord *s = &( sections[ inSection ] );
+
+    if( s->fresh && s->bytes != NULL ) {
+        delete [] s->bytes;
+        }
+
+    s->present = true;
+    s->fresh = true;
+    s->tag = inTag;
+    s->recordSize = inRecordSize;
+    s->length = inData->size();
+    s->bytes = inData->getElementArray();
+    }
+
+
+
+static void writeSnapshotFile() {
+    char *path = snapshotFile->getFullFileName();
+
+    FILE *outFile = fopen( path, "wb" );
+
+    if( outFile == NULL ) {
+        printf( "Failed to open bank snapshot %s for writing\n", path );
+        delete [] path;
+        return;
+        }
+
+    BankSnapshotHeader header;
+    memset( &header, 0, sizeof( header ) );
+
+    header.magic = BANK_SNAPSHOT_MAGIC;
+    header.version = BANK_SNAPSHOT_VERSION;
+    header.sourceKey = sourceKey;
+    header.sourceListingLength = sourceListingLength;
+
+    for( int i=0; i<endSnapshotSection; i++ ) {
+        header.sectionTag[i] = sections[i].tag;
+        header.sectionRecordSize[i] = sections[i].recordSize;
+        header.sectionLength[i] = sections[i].length;
+        }
+
+    fwrite( &header, sizeof( header ), 1, outFile );
+
+    for( int i=0; i<endSnapshotSection; i++ ) {
+        fwrite( sections[i].bytes, 1, sections[i].length, outFile );
+        }
+
+    if( fclose( outFile ) != 0 ) {
+        printf( "Failed to write bank snapshot %s\n", path );
+        remove( path );
+        }
+
+    delete [] path;
+    }
+
+
+
+void closeBankSnapshot() {
+    if( snapshotEnabled ) {
+        char allPresent = true;
+        char anyFresh = false;
+
+        for( int i=0; i<endSnapshotSection; i++ ) {
+            if( ! sections[i].present ) {
+                allPresent = false;
+                }
+            if( sections[i].fresh ) {
+                anyFresh = true;
+                }
+            }
+
+        if( allPresent && anyFresh ) {
+            writeSnapshotFile();
+            }
+        }
+
+    freeSnapshotData();
+    }
+
+
+
+
+void snapshotPushBytes( SimpleVector<unsigned char> *inData,
+                        const void *inBytes, int inLength ) {
+    if( inLength > 0 ) {
+        inData->appendArray( (unsigned char *)inBytes, inLength );
+        }
+    }
+
+
+
+void snapshotPushInt( SimpleVector<unsigned char> *inData, int inValue ) {
+    snapshotPushBytes( inData, &inValue, sizeof( int ) );
+    }
+
+
+
+void snapshotPushString( SimpleVector<unsigned char> *inData,
+                         const char *inString ) {
+    if( inString == NULL ) {
+        snapshotPushInt( inData, -1 );
+        return;
+        }
+    int length = strlen( inString );
+
+    snapshotPushInt( inData, length );
+    snapshotPushBytes( inData, inString, length );
+    }
+
+
+
+void snapshotPushIntVector( SimpleVector<unsigned char> *inData,
+                            SimpleVector<int> *inVector ) {
+    int num = inVector->size();
+
+    snapshotPushInt( inData, num );
+
+    for( int i=0; i<num; i++ ) {
+        snapshotPushInt( inData, inVector->getElementDirect( i ) );
+        }
+    }
+
+
+
+void snapshotReadBytes( SnapshotReader *inReader,
+                        void *outBytes, int inLength ) {
+    if( inReader->failed || inReader->end - inReader->next < inLength ) {
+        inReader->failed = true;
+        memset( outBytes, 0, inLength );
+        return;
+        }
+    memcpy( outBytes, inReader->next, inLength );
+    inReader->next += inLength;
+    }
+
+
+
+int snapshotReadInt( SnapshotReader *inReader ) {
+    int value;
+    snapshotReadBytes( inReader, &value, sizeof( int ) );
+    return value;
+    }
+
+
+
+char *snapshotReadString( SnapshotReader *inReader ) {
+    int length = snapshotReadInt( inReader );
+
+    if( length < 0 || inReader->failed ) {
+        return NULL;
+        }
+    if( inReader->end - inReader->next < length ) {
+        inReader->failed = true;
+        return NULL;
+        }
+
+    char *s = new char[ length + 1 ];
+    memcpy( s, inReader->next, length );
+    s[ length ] = '\0';
+
+    inReader->next += length;
+
+    return s;
+    }
+
+
+
+void snapshotReadIntVector( SnapshotReader *inReader,
+                            SimpleVector<int> *outVector ) {
+    int num = snapshotReadInt( inReader );
+
+    for( int i=0; i<num && ! inReader->failed; i++ ) {
+        outVector->push_back( snapshotReadInt( inReader ) );
+        }
+    }
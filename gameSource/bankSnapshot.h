@@ -0,0 +1,149 @@
+#ifndef BANK_SNAPSHOT_INCLUDED
+#define BANK_SNAPSHOT_INCLUDED
+
+
+#include "minorGems/util/SimpleVector.h"
+
+#include <stdint.h>
+#include <string.h>
+
+
+
+// Single binary snapshot of the fully-initialized object, category, and
+// transition banks, including auto-generated records and derived tables.
+//
+// Saved as objects/snapshot_<objectFlags>.bin after a normal load, and
+// read back in one read at the start of the next load, when the .txt
+// files in the objects, categories, and transitions folders have the same
+// names, sizes, and modification times (crc32 key over that listing).
+//
+// Each bank builds and restores its own section.  A section is only handed
+// back to a bank if its tag (generation flags) and record size match.
+
+
+typedef enum BankSnapshotSection {
+    snapshotObjects = 0,
+    snapshotCategories,
+    snapshotTransitions,
+    endSnapshotSection
+    } BankSnapshotSection;
+
+
+
+// discards any earlier snapshot state, computes the source key, and loads
+// the snapshot file for these object generation flags if it matches
+//
+// called at start of object bank init, before the other banks
+// no snapshot is read or saved if a folder's cache.fcz is missing
+void openBankSnapshot( char inAutoGenerateUsedObjects,
+                       char inAutoGenerateVariableObjects );
+
+
+// returns NULL if section not loaded, or built with different tag or
+// record size
+//
+// result owned by snapshot, valid until closeBankSnapshot
+unsigned char *getBankSnapshotSection( BankSnapshotSection inSection,
+                                       uint32_t inTag,
+                                       uint32_t inRecordSize,
+                                       int *outLength );
+
+
+// hands a freshly-built section to the snapshot
+// inData copied internally
+void setBankSnapshotSection( BankSnapshotSection inSection,
+                             uint32_t inTag,
+                             uint32_t inRecordSize,
+                             SimpleVector<unsigned char> *inData );
+
+
+// writes snapshot file if any section was freshly built and all sections
+// are present, then frees snapshot data
+//
+// called at end of transition bank init
+void closeBankSnapshot();
+
+
+
+
+// helpers for building sections
+
+void snapshotPushBytes( SimpleVector<unsigned char> *inData,
+                        const void *inBytes, int inLength );
+
+void snapshotPushInt( SimpleVector<unsigned char> *inData, int inValue );
+
+// NULL stored as length -1
+void snapshotPushString( SimpleVector<unsigned char> *inData,
+                         const char *inString );
+
+void snapshotPushIntVector( SimpleVector<unsigned char> *inData,
+                            SimpleVector<int> *inVector );
+
+
+// NULL stored as count -1
+template <class T>
+void snapshotPushArray( SimpleVector<unsigned char> *inData,
+                        const T *inArray, int inCount ) {
+    if( inArray == NULL ) {
+        snapshotPushInt( inData, -1 );
+        return;
+        }
+    snapshotPushInt( inData, inCount );
+    snapshotPushBytes( inData, inArray, inCount * sizeof( T ) );
+    }
+
+
+
+// helpers for restoring sections
+
+typedef struct SnapshotReader {
+        unsigned char *next;
+        unsigned char *end;
+
+        // set on overrun, after which reads return zeros and NULLs
+        char failed;
+    } SnapshotReader;
+
+
+void snapshotReadBytes( SnapshotReader *inReader,
+                        void *outBytes, int inLength );
+
+int snapshotReadInt( SnapshotReader *inReader );
+
+// result destroyed by caller
+char *snapshotReadString( SnapshotReader *inReader );
+
+void snapshotReadIntVector( SnapshotReader *inReader,
+                            SimpleVector<int> *outVector );
+
+
+// result destroyed by caller
+template <class T>
+T *snapshotReadArray( SnapshotReader *inReader, int *outCount = NULL ) {
+    int count = snapshotReadInt( inReader );
+
+    if( outCount != NULL ) {
+        *outCount = count;
+        }
+
+    if( count < 0 || inReader->failed ) {
+        return NULL;
+        }
+
+    if( (uint64_t)( inReader->end - inReader->next ) <
+        (uint64_t)count * sizeof( T ) ) {
+        inReader->failed = true;
+        return NULL;
+        }
+
+    T *array = new T[ count ];
+    memcpy( (void*)array, inReader->next, count * sizeof( T ) );
+    inReader->next += count * sizeof( T );
+
+    return array;
+    }
+
+
+
+#endif
@@ -12,6 +12,8 @@
 
 #include "folderCache.h"
 
+#include "bankSnapshot.h"
+
 
 static JenkinsRandomSource randSource;
 
@@ -36,6 +38,9 @@ static FolderCache cache;
 
 static int currentFile;
 
+// records restored by initCategoryBankStart
+static char loadedFromSnapshot = false;
+
 
 static SimpleVector<CategoryRecord*> records;
 static int maxID;
@@ -52,12 +57,129 @@ static char shouldFileBeCached( char *inFileName ) {
 
 
 
+// category section of bank snapshot
+//
+// Layout:
+// numRecords int
+// for each record, parentID, isPattern, isProbabilitySet ints,
+//   then objectIDSet and objectWeights as counted arrays
+
+static void writeCategorySnapshot() {
+    SimpleVector<unsigned char> data;
+    
+    snapshotPushInt( &data, records.size() );
+    
+    for( int i=0; i<records.size(); i++ ) {
+        CategoryRecord *r = records.getElementDirect( i );
+        
+        snapshotPushInt( &data, r->parentID );
+        snapshotPushInt( &data, r->isPattern );
+        snapshotPushInt( &data, r->isProbabilitySet );
+        
+        snapshotPushIntVector( &data, &( r->objectIDSet ) );
+        
+        snapshotPushInt( &data, r->objectWeights.size() );
+        for( int j=0; j<r->objectWeights.size(); j++ ) {
+            float w = r->objectWeights.getElementDirect( j );
+            snapshotPushBytes( &data, &w, sizeof( float ) );
+            }
+        }
+    
+    setBankSnapshotSection( snapshotCategories, 0, 
+                            sizeof( CategoryRecord ), &data );
+    }
+
+
+
+// on success, fills records, maxID, and maxObjectID
+static char readCategorySnapshot() {
+    int length;
+    unsigned char *bytes = 
+        getBankSnapshotSection( snapshotCategories, 0, 
+                                sizeof( CategoryRecord ), &length );
+    
+    if( bytes == NULL ) {
+        return false;
+        }
+    
+    SnapshotReader reader = { bytes, bytes + length, false };
+    
+    SimpleVector<CategoryRecord*> loaded;
+    
+    int numRecords = snapshotReadInt( &reader );
+    
+    for( int i=0; i<numRecords && ! reader.failed; i++ ) {
+        CategoryRecord *r = new CategoryRecord;
+        loaded.push_back( r );
+        
+        r->parentID = snapshotReadInt( &reader );
+        r->isPattern = snapshotReadInt( &reader );
+        r->isProbabilitySet = snapshotReadInt( &reader );
+        
+        snapshotReadIntVector( &reader, &( r->objectIDSet ) );
+        
+        int numWeights = snapshotReadInt( &reader );
+        for( int j=0; j<numWeights && ! reader.failed; j++ ) {
+            float w;
+            snapshotReadBytes( &reader, &w, sizeof( float ) );
+            r->objectWeights.push_back( w );
+            }
+        
+        if( r->parentID < 0 ) {
+            reader.failed = true;
+            }
+        for( int j=0; j<r->objectIDSet.size(); j++ ) {
+            if( r->objectIDSet.getElementDirect( j ) <= 0 ) {
+                reader.failed = true;
+                }
+            }
+        }
+    
+    if( reader.failed || reader.next != reader.end ) {
+        for( int i=0; i<loaded.size(); i++ ) {
+            delete loaded.getElementDirect( i );
+            }
+        return false;
+        }
+    
+    for( int i=0; i<loaded.size(); i++ ) {
+        CategoryRecord *r = loaded.getElementDirect( i );
+        
+        if( r->parentID > maxID ) {
+            maxID = r->parentID;
+            }
+        for( int j=0; j<r->objectIDSet.size(); j++ ) {
+            int objID = r->objectIDSet.getElementDirect( j );
+            
+            if( objID > maxObjectID ) {
+                maxObjectID = objID;
+                }
+            }
+        records.push_back( r );
+        }
+    
+    return true;
+    }
+
+
+
+static FolderCache emptyCache = { NULL, 0, NULL, NULL, NULL };
+
+
 int initCategoryBankStart( char *outRebuildingCache ) {
     maxID = 0;
     maxObjectID = 0;
     
     currentFile = 0;
     
+    loadedFromSnapshot = readCategorySnapshot();
+    
+    if( loadedFromSnapshot ) {
+        // nothing left to parse
+        cache = emptyCache;
+        *outRebuildingCache = false;
+        return 0;
+        }
 
     cache = initFolderCache( "categories", outRebuildingCache,
                              shouldFileBeCached );
@@ -214,7 +336,15 @@ void initCategoryBankFinish() {
     
 
     
-    printf( "Loaded %d categories from categories folder\n", numRecords );
+    if( loadedFromSnapshot ) {
+        printf( "Loaded %d categories from snapshot\n", numRecords );
+        }
+    else {
+        printf( "Loaded %d categories from categories folder\n", 
+                numRecords );
+        
+        writeCategorySnapshot();
+        }
     }
 
 
@@ -282,3 +282,464 @@ void convolve( double *inA, int inLengthA,
     //        inLengthA, inLengthB, Time::getCurrentTime() - start );
     }
 
+
+
+
+
+
+// float FFT for PartitionedConvolution
+//
+// radix-2, iterative, with real and imaginary parts in separate arrays
+// twiddles for each pass are stored together, so every inner loop
+// walks its arrays in order, and the compiler can vectorize it
+
+
+static int roundUpToPowerOf2( int inValue ) {
+    int p = 1;
+    while( p < inValue ) {
+        p *= 2;
+        }
+    return p;
+    }
+
+
+
+static void makeFFTTables( PartitionedConvolution *inC ) {
+    int m = inC->partitionSize;
+    
+    int numBits = 0;
+    while( ( 1 << numBits ) < m ) {
+        numBits++;
+        }
+
+    inC->bitReverse = new int[ m ];
+    
+    for( int i=0; i<m; i++ ) {
+        int r = 0;
+        for( int b=0; b<numBits; b++ ) {
+            if( i & ( 1 << b ) ) {
+                r |= 1 << ( numBits - 1 - b );
+                }
+            }
+        inC->bitReverse[i] = r;
+        }
+    
+
+    // twiddles for pass that combines halves of size h start at h - 1
+    inC->twiddleReal = new float[ m ];
+    inC->twiddleImag = new float[ m ];
+    
+    for( int h=1; h<m; h*=2 ) {
+        for( int j=0; j<h; j++ ) {
+            double angle = - M_PI * j / h;
+            
+            inC->twiddleReal[ h - 1 + j ] = (float)cos( angle );
+            inC->twiddleImag[ h - 1 + j ] = (float)sin( angle );
+            }
+        }
+    
+
+    // e^( -i pi k / m ), for splitting packed spectrum
+    inC->realTwiddleReal = new float[ m + 1 ];
+    inC->realTwiddleImag = new float[ m + 1 ];
+    
+    for( int k=0; k<=m; k++ ) {
+        double angle = - M_PI * k / m;
+        
+        inC->realTwiddleReal[k] = (float)cos( angle );
+        inC->realTwiddleImag[k] = (float)sin( angle );
+        }
+    }
+
+
+
+// in place, input in bit-reversed order
+static void floatComplexFFT( PartitionedConvolution *inC, 
+                             float *ioReal, float *ioImag ) {
+    int m = inC->partitionSize;
+
+    int firstH = 1;
+    
+    if( m >= 4 ) {
+        // first two passes together, since their twiddles are
+        // 1 and -i, which need no multiplies
+        for( int start=0; start<m; start += 4 ) {
+            float *r = &( ioReal[ start ] );
+            float *i = &( ioImag[ start ] );
+            
+            float aR = r[0] + r[1];
+            float aI = i[0] + i[1];
+            float bR = r[0] - r[1];
+            float bI = i[0] - i[1];
+            float cR = r[2] + r[3];
+            float cI = i[2] + i[3];
+            float dR = r[2] - r[3];
+            float dI = i[2] - i[3];
+            
+            r[0] = aR + cR;
+            i[0] = aI + cI;
+            r[2] = aR - cR;
+            i[2] = aI - cI;
+            
+            // d times -i
+            r[1] = bR + dI;
+            i[1] = bI - dR;
+            r[3] = bR - dI;
+            i[3] = bI + dR;
+            }
+        firstH = 4;
+        }
+
+    for( int h=firstH; h<m; h*=2 ) {
+        float *twR = &( inC->twiddleReal[ h - 1 ] );
+        float *twI = &( inC->twiddleImag[ h - 1 ] );
+        
+        for( int start=0; start<m; start += 2 * h ) {
+            float *aR = &( ioReal[ start ] );
+            float *aI = &( ioImag[ start ] );
+            float *bR = &( ioReal[ start + h ] );
+            float *bI = &( ioImag[ start + h ] );
+            
+            for( int j=0; j<h; j++ ) {
+                float tR = bR[j] * twR[j] - bI[j] * twI[j];
+                float tI = bR[j] * twI[j] + bI[j] * twR[j];
+                
+                bR[j] = aR[j] - tR;
+                bI[j] = aI[j] - tI;
+                aR[j] += tR;
+                aI[j] += tI;
+                }
+            }
+        }
+    }
+
+
+
+struct ConvolutionScratch {
+        int partitionSize;
+        int numPartitions;
+
+        // 2 * partitionSize real samples
+        float *block;
+        
+        // partitionSize complex values
+        float *packedReal;
+        float *packedImag;
+        float *workReal;
+        float *workImag;
+        
+        // spectra of last numPartitions blocks of A, 
+        // each with partitionSize + 1 bins
+        float *historyReal;
+        float *historyImag;
+        
+        float *sumReal;
+        float *sumImag;
+        
+        // 2 * partitionSize real samples
+        float *result;
+    };
+
+
+
+// inReal has 2 * partitionSize values
+// outReal and outImag get partitionSize + 1 bins
+static void floatRealFFT( PartitionedConvolution *inC,
+                          ConvolutionScratch *inScratch,
+                          float *inReal, 
+                          float *outReal, float *outImag ) {
+    int m = inC->partitionSize;
+    
+    float *zR = inScratch->workReal;
+    float *zI = inScratch->workImag;
+    
+    // pack even samples as real parts, odd as imaginary
+    for( int i=0; i<m; i++ ) {
+        int r = inC->bitReverse[i];
+        zR[i] = inReal[ 2 * r ];
+        zI[i] = inReal[ 2 * r + 1 ];
+        }
+    
+    floatComplexFFT( inC, zR, zI );
+    
+    // split into spectra of even and odd samples, and combine
+    for( int k=0; k<=m; k++ ) {
+        int a = k & ( m - 1 );
+        int b = ( m - k ) & ( m - 1 );
+        
+        float eR = 0.5f * ( zR[a] + zR[b] );
+        float eI = 0.5f * ( zI[a] - zI[b] );
+        
+        float oR = 0.5f * ( zI[a] + zI[b] );
+        float oI = -0.5f * ( zR[a] - zR[b] );
+        
+        float wR = inC->realTwiddleReal[k];
+        float wI = inC->realTwiddleImag[k];
+        
+        outReal[k] = eR + wR * oR - wI * oI;
+        outImag[k] = eI + wR * oI + wI * oR;
+        }
+    }
+
+
+
+// inverse of floatRealFFT
+// outReal gets 2 * partitionSize values
+static void floatRealInverseFFT( PartitionedConvolution *inC,
+                                 ConvolutionScratch *inScratch,
+                                 float *inReal, float *inImag,
+                                 float *outReal ) {
+    int m = inC->partitionSize;
+    
+    float *zR = inScratch->packedReal;
+    float *zI = inScratch->packedImag;
+    
+    for( int k=0; k<m; k++ ) {
+        float aR = inReal[k];
+        float aI = inImag[k];
+        float bR = inReal[ m - k ];
+        float bI = inImag[ m - k ];
+        
+        float eR = 0.5f * ( aR + bR );
+        float eI = 0.5f * ( aI - bI );
+        
+        float dR = 0.5f * ( aR - bR );
+        float dI = 0.5f * ( aI + bI );
+        
+        // divide by twiddle, which is multiplying by its conjugate
+        float wR = inC->realTwiddleReal[k];
+        float wI = - inC->realTwiddleImag[k];
+        
+        float oR = dR * wR - dI * wI;
+        float oI = dR * wI + dI * wR;
+        
+        zR[k] = eR - oI;
+        zI[k] = eI + oR;
+        }
+    
+    // inverse through forward transform of conjugate
+    float *wR = inScratch->workReal;
+    float *wI = inScratch->workImag;
+    
+    for( int i=0; i<m; i++ ) {
+        int r = inC->bitReverse[i];
+        wR[i] = zR[r];
+        wI[i] = - zI[r];
+        }
+    
+    floatComplexFFT( inC, wR, wI );
+    
+    float scale = 1.0f / m;
+    
+    for( int i=0; i<m; i++ ) {
+        outReal[ 2 * i ] = wR[i] * scale;
+        outReal[ 2 * i + 1 ] = - wI[i] * scale;
+        }
+    }
+
+
+
+PartitionedConvolution startPartitionedConvolution( 
+    float *inB, int inLengthB, int inPartitionSize ) {
+    
+    PartitionedConvolution c;
+    
+    // at least 2, so real transform packing works
+    c.partitionSize = roundUpToPowerOf2( inPartitionSize );
+    if( c.partitionSize < 2 ) {
+        c.partitionSize = 2;
+        }
+    
+    c.numSamplesB = inLengthB;
+    c.numPartitions = 
+        ( inLengthB + c.partitionSize - 1 ) / c.partitionSize;
+    
+    makeFFTTables( &c );
+
+    int n = c.partitionSize;
+    int numBins = n + 1;
+    
+    c.spectraReal = new float[ c.numPartitions * numBins ];
+    c.spectraImag = new float[ c.numPartitions * numBins ];
+
+    ConvolutionScratch *scratch = newConvolutionScratch( &c );
+    
+    for( int p=0; p<c.numPartitions; p++ ) {
+        
+        memset( scratch->block, 0, sizeof( float ) * 2 * n );
+        
+        int offset = p * n;
+        int numToCopy = inLengthB - offset;
+        if( numToCopy > n ) {
+            numToCopy = n;
+            }
+        memcpy( scratch->block, &( inB[ offset ] ), 
+                sizeof( float ) * numToCopy );
+        
+        floatRealFFT( &c, scratch, scratch->block,
+                      &( c.spectraReal[ p * numBins ] ),
+                      &( c.spectraImag[ p * numBins ] ) );
+        }
+    
+    deleteConvolutionScratch( scratch );
+    
+    return c;
+    }
+
+
+
+void endPartitionedConvolution( PartitionedConvolution *inConvolution ) {
+    if( inConvolution->numSamplesB == -1 ) {
+        return;
+        }
+    
+    delete [] inConvolution->spectraReal;
+    delete [] inConvolution->spectraImag;
+    delete [] inConvolution->bitReverse;
+    delete [] inConvolution->twiddleReal;
+    delete [] inConvolution->twiddleImag;
+    delete [] inConvolution->realTwiddleReal;
+    delete [] inConvolution->realTwiddleImag;
+    
+    inConvolution->numSamplesB = -1;
+    }
+
+
+
+ConvolutionScratch *newConvolutionScratch( 
+    PartitionedConvolution *inConvolution ) {
+    
+    ConvolutionScratch *s = new ConvolutionScratch;
+
+    int n = inConvolution->partitionSize;
+    int numBins = n + 1;
+    
+    s->partitionSize = n;
+    s->numPartitions = inConvolution->numPartitions;
+    
+    s->block = new float[ 2 * n ];
+    
+    s->packedReal = new float[ n ];
+    s->packedImag = new float[ n ];
+    s->workReal = new float[ n ];
+    s->workImag = new float[ n ];
+    
+    s->historyReal = new float[ s->numPartitions * numBins ];
+    s->historyImag = new float[ s->numPartitions * numBins ];
+    
+    s->sumReal = new float[ numBins ];
+    s->sumImag = new float[ numBins ];
+
+    s->result = new float[ 2 * n ];
+    
+    return s;
+    }
+
+
+
+void deleteConvolutionScratch( ConvolutionScratch *inScratch ) {
+    delete [] inScratch->block;
+    delete [] inScratch->packedReal;
+    delete [] inScratch->packedImag;
+    delete [] inScratch->workReal;
+    delete [] inScratch->workImag;
+    delete [] inScratch->historyReal;
+    delete [] inScratch->historyImag;
+    delete [] inScratch->sumReal;
+    delete [] inScratch->sumImag;
+    delete [] inScratch->result;
+    
+    delete inScratch;
+    }
+
+
+
+void partitionedConvolve( PartitionedConvolution *inConvolution,
+                          ConvolutionScratch *inScratch,
+                          float *inA, int inLengthA,
+                          float *inDest ) {
+    
+    PartitionedConvolution *c = inConvolution;
+    ConvolutionScratch *s = inScratch;
+    
+    int n = c->partitionSize;
+    int numBins = n + 1;
+    int numPartitions = c->numPartitions;
+    
+    int destLength = inLengthA + c->numSamplesB;
+    
+    if( numPartitions == 0 ) {
+        memset( inDest, 0, sizeof( float ) * destLength );
+        return;
+        }
+
+    // blocks of A from before the start are silent
+    memset( s->historyReal, 0, sizeof( float ) * numPartitions * numBins );
+    memset( s->historyImag, 0, sizeof( float ) * numPartitions * numBins );
+    
+    // block holds previous N samples of A, then current N
+    memset( s->block, 0, sizeof( float ) * 2 * n );
+    
+    int numBlocks = ( destLength + n - 1 ) / n;
+    
+    for( int k=0; k<numBlocks; k++ ) {
+        
+        memmove( s->block, &( s->block[n] ), sizeof( float ) * n );
+        
+        int offset = k * n;
+        int numToCopy = inLengthA - offset;
+        if( numToCopy > n ) {
+            numToCopy = n;
+            }
+        if( numToCopy < 0 ) {
+            numToCopy = 0;
+            }
+        memcpy( &( s->block[n] ), &( inA[ offset ] ),
+                sizeof( float ) * numToCopy );
+        memset( &( s->block[ n + numToCopy ] ), 0, 
+                sizeof( float ) * ( n - numToCopy ) );
+        
+        
+        int slot = k % numPartitions;
+        
+        floatRealFFT( c, s, s->block,
+                      &( s->historyReal[ slot * numBins ] ),
+                      &( s->historyImag[ slot * numBins ] ) );
+        
+        
+        // multiply each partition of B against block of A from
+        // that many blocks ago
+        float *sumR = s->sumReal;
+        float *sumI = s->sumImag;
+        
+        memset( sumR, 0, sizeof( float ) * numBins );
+        memset( sumI, 0, sizeof( float ) * numBins );
+        
+        for( int p=0; p<numPartitions; p++ ) {
+            int aSlot = ( k - p ) % numPartitions;
+            if( aSlot < 0 ) {
+                aSlot += numPartitions;
+                }
+            
+            float *aR = &( s->historyReal[ aSlot * numBins ] );
+            float *aI = &( s->historyImag[ aSlot * numBins ] );
+            float *bR = &( c->spectraReal[ p * numBins ] );
+            float *bI = &( c->spectraImag[ p * numBins ] );
+            
+            for( int i=0; i<numBins; i++ ) {
+                sumR[i] += aR[i] * bR[i] - aI[i] * bI[i];
+                sumI[i] += aR[i] * bI[i] + aI[i] * bR[i];
+                }
+            }
+        
+        floatRealInverseFFT( c, s, sumR, sumI, s->result );
+        
+        // second half of circular result is free of wrap-around
+        int numToWrite = destLength - offset;
+        if( numToWrite > n ) {
+            numToWrite = n;
+            }
+        memcpy( &( inDest[ offset ] ), &( s->result[ n ] ), 
+                sizeof( float ) * numToWrite );
+        }
+    }
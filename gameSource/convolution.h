@@ -31,3 +31,72 @@ void multiConvolve( MultiConvolution inMulti, double *inA, int inLengthA,
 // frees pre-computed resources for B
 void endMultiConvolution( MultiConvolution *inMulti );
 
+
+
+
+
+// Float version of MultiConvolution, for convolving many A's against
+// the same B.
+//
+// B is cut into partitions of inPartitionSize samples, and the spectrum
+// of each is computed once.  A is run through in blocks of the same size,
+// and each block's spectrum is multiplied against every partition's
+// spectrum (uniformly partitioned overlap-save), so the FFTs stay small
+// no matter how long A or B are.
+//
+// Spectra are stored with real and imaginary parts in separate arrays,
+// so the inner multiply-add loops vectorize.
+typedef struct PartitionedConvolution {
+        // set to -1 if not initialized
+        int numSamplesB;
+        
+        // power of 2
+        int partitionSize;
+        int numPartitions;
+        
+        // numPartitions spectra, each with partitionSize + 1 bins
+        float *spectraReal;
+        float *spectraImag;
+
+        // FFT tables, for transforms of partitionSize complex values
+        int *bitReverse;
+        float *twiddleReal;
+        float *twiddleImag;
+        
+        // for packing 2 * partitionSize real values into
+        // partitionSize complex values
+        float *realTwiddleReal;
+        float *realTwiddleImag;
+    } PartitionedConvolution;
+
+
+
+// inPartitionSize rounded up to power of 2
+PartitionedConvolution startPartitionedConvolution( 
+    float *inB, int inLengthB, int inPartitionSize = 4096 );
+
+
+// frees pre-computed resources for B
+void endPartitionedConvolution( PartitionedConvolution *inConvolution );
+
+
+
+// working buffers for partitionedConvolve, reused between calls
+//
+// a PartitionedConvolution can be used by several threads at once,
+// each with its own scratch
+typedef struct ConvolutionScratch ConvolutionScratch;
+
+
+ConvolutionScratch *newConvolutionScratch( 
+    PartitionedConvolution *inConvolution );
+
+void deleteConvolutionScratch( ConvolutionScratch *inScratch );
+
+
+
+// inDest must be of length inLengthA + inLengthB, and is overwritten
+void partitionedConvolve( PartitionedConvolution *inConvolution,
+                          ConvolutionScratch *inScratch,
+                          float *inA, int inLengthA,
+                          float *inDest );
@@ -1088,8 +1088,10 @@ void drawFrame( char inUpdate ) {
 
                         // editor pre-computes sound hashes
                         // to help with export/import
-                        int numSounds = initSoundBankStart( &rebuilding,
-                                                            true );
+                        int numSounds = 
+                            initSoundBankStart( 
+                                &rebuilding, true,
+                                getReverbThreadsSetting() );
 
                         if( rebuilding ) {
                             loadingPage->setCurrentPhase( 
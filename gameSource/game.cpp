@@ -510,9 +510,18 @@ static void startSpriteLoading() {
     
     char rebuilding;
     
+    // pack sprites into shared textures, so that objects on screen can
+    // be drawn without switching textures for every sprite layer
+    // left on, so that sprites reloaded after eviction go back into
+    // space freed in atlas pages
+    toggleSpriteAtlasPacking( 
+        SettingsManager::getIntSetting( "useSpriteAtlas", 1 ) );
+    
     // game needs to compute hashes for mod loading
     int numSprites = 
-        initSpriteBankStart( &rebuilding, true );
+        initSpriteBankStart( 
+            &rebuilding, true,
+            SettingsManager::getIntSetting( "spriteDecodeThreads", 4 ) );
                         
     if( rebuilding ) {
         loadingPage->setCurrentPhase( translate( "spritesRebuild" ) );
@@ -1755,8 +1764,10 @@ void drawFrame( char inUpdate ) {
                         char rebuilding;
 
                         // compute hashes for mod loading
-                        int numSounds = initSoundBankStart( &rebuilding,
-                                                            true );
+                        int numSounds = 
+                            initSoundBankStart( 
+                                &rebuilding, true,
+                                getReverbThreadsSetting() );
 
                         if( rebuilding ) {
                             loadingPage->setCurrentPhase( 
@@ -4,11 +4,15 @@
 #include "../commonSource/fractalNoise.h"
 
 
-#include "minorGems/graphics/filters/BoxBlurFilter.h"
 #include "minorGems/util/SimpleVector.h"
 #include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/crc32.h"
 #include "minorGems/io/file/File.h"
 
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
 
 
 
@@ -71,6 +75,428 @@ int initGroundSpritesStart( char inPrintSteps ) {
     }
 
 
+// Each biome's finished tiles are cached in one file,
+// groundTileCache/biome_N.bin, so later launches can upload them without
+// rebuilding them or reading two TGA files per tile.
+//
+// Layout:
+// GroundCacheHeader
+// for each tile, row by row:
+//   (CELL_D * 2)^2 RGBA bytes of edge-blurred tile
+//   CELL_D^2 RGBA bytes of square tile
+//
+// The header holds a hash of the source image's pixels and the blur
+// radius, so a changed ground image or groundTileEdgeBlurRadius setting
+// rebuilds the cache.
+
+#define GROUND_CACHE_MAGIC 0x31435447
+#define GROUND_CACHE_VERSION 1
+
+typedef struct GroundCacheHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t sourceHash;
+        uint32_t sourceWidth;
+        uint32_t sourceHeight;
+        uint32_t cellD;
+        uint32_t blurRadius;
+    } GroundCacheHeader;
+
+
+
+static int getGroundCacheLength( GroundCacheHeader *inHeader ) {
+    int numTiles = 
+        ( inHeader->sourceWidth / CELL_D ) * 
+        ( inHeader->sourceHeight / CELL_D );
+    
+    int tileD = CELL_D * 2;
+    
+    return sizeof( GroundCacheHeader ) + 
+        numTiles * ( tileD * tileD + CELL_D * CELL_D ) * 4;
+    }
+
+
+
+static File *getGroundCacheFile( int inCacheFileNumber ) {
+    char *name = autoSprintf( "biome_%d.bin", inCacheFileNumber );
+    
+    File *file = groundTileCacheDir.getChildFile( name );
+    
+    delete [] name;
+    
+    return file;
+    }
+
+
+
+// returns NULL if cache file missing, or doesn't match inHeader
+// result is header followed by tile data, destroyed by caller
+static unsigned char *readGroundCache( int inCacheFileNumber,
+                                       GroundCacheHeader *inHeader ) {
+    File *file = getGroundCacheFile( inCacheFileNumber );
+    
+    if( ! file->exists() ) {
+        delete file;
+        return NULL;
+        }
+    
+    int length;
+    unsigned char *data = file->readFileContents( &length );
+    delete file;
+    
+    if( data == NULL ) {
+        return NULL;
+        }
+    
+    if( length != getGroundCacheLength( inHeader ) ||
+        memcmp( data, inHeader, sizeof( GroundCacheHeader ) ) != 0 ) {
+        delete [] data;
+        return NULL;
+        }
+    
+    return data;
+    }
+
+
+
+static void writeGroundCache( int inCacheFileNumber, unsigned char *inSheet ) {
+    File *file = getGroundCacheFile( inCacheFileNumber );
+    
+    char *path = file->getFullFileName();
+    delete file;
+    
+    FILE *outFile = fopen( path, "wb" );
+    
+    if( outFile == NULL ) {
+        printf( "Failed to open ground tile cache %s for writing\n", path );
+        delete [] path;
+        return;
+        }
+    
+    fwrite( inSheet, 1, 
+            getGroundCacheLength( (GroundCacheHeader*)inSheet ), outFile );
+    
+    if( fclose( outFile ) != 0 ) {
+        printf( "Failed to write ground tile cache %s\n", path );
+        remove( path );
+        }
+    else {
+        // tiles used to be cached as two TGA files each, which this
+        // file replaces
+        GroundCacheHeader *header = (GroundCacheHeader*)inSheet;
+
+        int tW = header->sourceWidth / CELL_D;
+        int tH = header->sourceHeight / CELL_D;
+
+        for( int ty=0; ty<tH; ty++ ) {
+            for( int tx=0; tx<tW; tx++ ) {
+                for( int s=0; s<2; s++ ) {
+                    const char *suffix = "";
+                    if( s == 1 ) {
+                        suffix = "_square";
+                        }
+
+                    char *oldName = autoSprintf( "biome_%d_x%d_y%d%s.tga",
+                                                 inCacheFileNumber,
+                                                 tx, ty, suffix );
+
+                    File *oldFile =
+                        groundTileCacheDir.getChildFile( oldName );
+
+                    oldFile->remove();
+
+                    delete oldFile;
+                    delete [] oldName;
+                    }
+                }
+            }
+        }
+
+    delete [] path;
+    }
+
+
+
+// Box blur of a 0/1 mask into the alpha bytes of inD x inD RGBA tile.
+// Same result as BoxBlurFilter followed by a TGA write:  each value is the
+// average over the box, clipped to the tile.
+//
+// Box sums of a 0/1 mask are small integers, so summing along rows and
+// then along columns with running sums gives exactly the sums that
+// BoxBlurFilter's double summed-area table does.  The column pass works
+// on whole rows at a time, in loops that compilers vectorize.
+static void blurAlphaMask( unsigned char *inMask, int inD, int inRadius,
+                           int *inRowSumsBuffer, int *inColSumsBuffer,
+                           unsigned char *outRGBA ) {
+    
+    int r = inRadius;
+    
+    // horizontal pass, window [x - r, x + r]
+    for( int y=0; y<inD; y++ ) {
+        unsigned char *maskRow = &( inMask[ y * inD ] );
+        int *sumRow = &( inRowSumsBuffer[ y * inD ] );
+        
+        int sum = 0;
+        for( int x=0; x<=r && x<inD; x++ ) {
+            sum += maskRow[x];
+            }
+        
+        for( int x=0; x<inD; x++ ) {
+            sumRow[x] = sum;
+            
+            if( x + r + 1 < inD ) {
+                sum += maskRow[ x + r + 1 ];
+                }
+            if( x - r >= 0 ) {
+                sum -= maskRow[ x - r ];
+                }
+            }
+        }
+    
+    
+    // vertical pass, window [y - r, y + r]
+    int *colSums = inColSumsBuffer;
+    memset( colSums, 0, inD * sizeof( int ) );
+    
+    for( int y=0; y<=r && y<inD; y++ ) {
+        int *sumRow = &( inRowSumsBuffer[ y * inD ] );
+        
+        for( int x=0; x<inD; x++ ) {
+            colSums[x] += sumRow[x];
+            }
+        }
+    
+    for( int y=0; y<inD; y++ ) {
+        int yStart = y - r;
+        int yEnd = y + r;
+        
+        if( yStart < 0 ) {
+            yStart = 0;
+            }
+        if( yEnd >= inD ) {
+            yEnd = inD - 1;
+            }
+        
+        int yDimension = yEnd - yStart + 1;
+        
+        unsigned char *alpha = &( outRGBA[ y * inD * 4 + 3 ] );
+        
+        for( int x=0; x<inD; x++ ) {
+            int xStart = x - r;
+            int xEnd = x + r;
+            
+            if( xStart < 0 ) {
+                xStart = 0;
+                }
+            if( xEnd >= inD ) {
+                xEnd = inD - 1;
+                }
+            
+            double boxValueMultiplier = 
+                1.0 / ( ( xEnd - xStart + 1 ) * yDimension );
+            
+            alpha[ x * 4 ] = 
+                (unsigned char)lrint( 255 * 
+                                      ( boxValueMultiplier * colSums[x] ) );
+            }
+        
+        if( y + r + 1 < inD ) {
+            int *addRow = &( inRowSumsBuffer[ ( y + r + 1 ) * inD ] );
+            
+            for( int x=0; x<inD; x++ ) {
+                colSums[x] += addRow[x];
+                }
+            }
+        if( y - r >= 0 ) {
+            int *subRow = &( inRowSumsBuffer[ ( y - r ) * inD ] );
+            
+            for( int x=0; x<inD; x++ ) {
+                colSums[x] -= subRow[x];
+                }
+            }
+        }
+    }
+
+
+
+// builds every tile from the RGBA source image
+// result laid out like cache file, with copy of inHeader at start
+// result destroyed by caller
+static unsigned char *buildGroundTiles( GroundCacheHeader *inHeader,
+                                        RawRGBAImage *inSource ) {
+    
+    int length = getGroundCacheLength( inHeader );
+    
+    unsigned char *sheet = new unsigned char[ length ];
+    
+    memcpy( sheet, inHeader, sizeof( GroundCacheHeader ) );
+    
+    int w = inSource->mWidth;
+    int h = inSource->mHeight;
+    
+    unsigned char *source = inSource->mRGBABytes;
+    
+    int tW = w / CELL_D;
+    int tH = h / CELL_D;
+    
+    int tileD = CELL_D * 2;
+    
+    
+    // alpha shape settings, same for every tile
+
+    int cellR = CELL_D / 2;
+    
+    // radius to cornerof map tile
+    int cellCornerR = (int)sqrt( 2 * cellR * cellR );
+
+    int tileR = tileD / 2;
+
+    // grow out from min only
+    int targetR = cellCornerR + 1;
+    
+    double wiggleScale = 0.95 * tileR - targetR;
+
+    // make sure square of cell plus blur radius is solid, so that corners
+    // are not undercut by blur
+    // this will make some weird square points sticking out, but they will
+    // be blurred anyway, so that's okay
+    int edgeStartA = CELL_D - ( CELL_D/2 + blurRadius );
+    int edgeStartB = CELL_D + ( CELL_D/2 + blurRadius + 1 );
+
+    // solid square can't go past tile for huge blur radius
+    int solidStart = edgeStartA;
+    int solidEnd = edgeStartB;
+    
+    if( solidStart < 0 ) {
+        solidStart = 0;
+        }
+    if( solidEnd >= tileD ) {
+        solidEnd = tileD - 1;
+        }
+    
+    
+    double *wiggle = new double[ tileD * tileD ];
+    unsigned char *mask = new unsigned char[ tileD * tileD ];
+    int *rowSums = new int[ tileD * tileD ];
+    int *colSums = new int[ tileD ];
+    
+    unsigned char *nextTile = &( sheet[ sizeof( GroundCacheHeader ) ] );
+    
+    for( int ty=0; ty<tH; ty++ ) {
+        for( int tx=0; tx<tW; tx++ ) {
+            
+            unsigned char *tile = nextTile;
+            unsigned char *square = &( nextTile[ tileD * tileD * 4 ] );
+            
+            nextTile = &( square[ CELL_D * CELL_D * 4 ] );
+
+
+            // square tile is just this cell of the source image
+            for( int y=0; y<CELL_D; y++ ) {
+                memcpy( &( square[ y * CELL_D * 4 ] ),
+                        &( source[ ( ( ty * CELL_D + y ) * w + 
+                                     tx * CELL_D ) * 4 ] ),
+                        CELL_D * 4 );
+                }
+            
+            
+            // copy from source image to fill 2x tile
+            // centered on 1x tile of image, wrapping
+            // around in source image as needed
+            int imStartX = tx * CELL_D - ( tileD - CELL_D ) / 2;
+            int imStartY = ty * CELL_D - ( tileD - CELL_D ) / 2;
+            
+            for( int dY=0; dY<tileD; dY++ ) {
+                int wrapY = imStartY + dY;
+                
+                if( wrapY >= h ) {
+                    wrapY -= h;
+                    }
+                else if( wrapY < 0 ) {
+                    wrapY += h;
+                    }
+                
+                unsigned char *destRow = &( tile[ dY * tileD * 4 ] );
+                unsigned char *srcRow = &( source[ wrapY * w * 4 ] );
+                
+                for( int dX=0; dX<tileD; dX++ ) {
+                    int wrapX = imStartX + dX;
+                    
+                    if( wrapX >= w ) {
+                        wrapX -= w;
+                        }
+                    else if( wrapX < 0 ) {
+                        wrapX += w;
+                        }
+                    
+                    memcpy( &( destRow[ dX * 4 ] ), 
+                            &( srcRow[ wrapX * 4 ] ), 3 );
+                    }
+                }
+            
+
+            // now set alpha based on radius, with a fractal wiggle
+            getXYFractalRegion( makeXYRandomSeed( ty * 237 + tx ),
+                                0, 0, tileD, tileD, 0, .5, wiggle );
+            
+            for( int y=0; y<tileD; y++ ) {
+                int deltY = y - tileD/2;
+                
+                for( int x=0; x<tileD; x++ ) {    
+                    int deltX = x - tileD/2;
+                    
+                    double r = sqrt( deltY * deltY + deltX * deltX );
+                    
+                    int p = y * tileD + x;
+                    
+                    if( r > targetR + wiggle[p] * wiggleScale ) {
+                        mask[p] = 0;
+                        }
+                    else {
+                        mask[p] = 1;
+                        }
+                    }
+                }
+            
+            for( int y=solidStart; y<=solidEnd; y++ ) {
+                memset( &( mask[ y * tileD + solidStart ] ), 1,
+                        solidEnd - solidStart + 1 );
+                }
+            
+            // trim off lower right edges
+            if( edgeStartB < tileD ) {
+                for( int y=0; y<tileD; y++ ) {
+                    memset( &( mask[ y * tileD + edgeStartB ] ), 0,
+                            tileD - edgeStartB );
+                    }
+                memset( &( mask[ edgeStartB * tileD ] ), 0,
+                        ( tileD - edgeStartB ) * tileD );
+                }
+            
+            
+            if( blurRadius > 0 ) {
+                blurAlphaMask( mask, tileD, blurRadius, rowSums, colSums,
+                               tile );
+                }
+            else {
+                for( int p=0; p<tileD * tileD; p++ ) {
+                    tile[ p * 4 + 3 ] = mask[p] * 255;
+                    }
+                }
+            }
+        }
+    
+    delete [] wiggle;
+    delete [] mask;
+    delete [] rowSums;
+    delete [] colSums;
+    
+    return sheet;
+    }
+
+
+
+
 // returns progress... ready for Finish when progress == 1.0
 float initGroundSpritesStep() {
     
@@ -154,270 +580,54 @@ float initGroundSpritesStep() {
                 groundSprites[b]->tiles = new SpriteHandle*[tH];
                 groundSprites[b]->squareTiles = new SpriteHandle*[tH];
                 
-                groundSprites[b]->wholeSheet = fillSprite( rawImage );
-
-                // check if all cache files exist
-                // if so, don't need to load double version of whole image
-                char allCacheFilesExist = true;
+                GroundCacheHeader header = 
+                    { GROUND_CACHE_MAGIC,
+                      GROUND_CACHE_VERSION,
+                      crc32( rawImage->mRGBABytes, w * h * 4 ),
+                      (uint32_t)w,
+                      (uint32_t)h,
+                      CELL_D,
+                      (uint32_t)blurRadius };
+                
+                unsigned char *sheet = 
+                    readGroundCache( cacheFileNumber, &header );
+                
+                if( sheet == NULL ) {
+                    if( printSteps ) {    
+                        printf( "Ground tile cache for %s missing or out "
+                                "of date, rebuilding.\n", fileName );
+                        }
+                    
+                    // build before fillSprite below, which can modify
+                    // rawImage
+                    sheet = buildGroundTiles( &header, rawImage );
+                    
+                    writeGroundCache( cacheFileNumber, sheet );
+                    }
+                
+                
+                int tileD = CELL_D * 2;
+                
+                unsigned char *nextTile = &( sheet[ sizeof( header ) ] );
                 
                 for( int ty=0; ty<tH; ty++ ) {
                     groundSprites[b]->tiles[ty] = new SpriteHandle[tW];
                     groundSprites[b]->squareTiles[ty] = new SpriteHandle[tW];
                     
                     for( int tx=0; tx<tW; tx++ ) {
-                        
-                        char *cacheFileName = 
-                            autoSprintf( 
-                                "groundTileCache/biome_%d_x%d_y%d.tga",
-                                cacheFileNumber, tx, ty );
-
                         groundSprites[b]->tiles[ty][tx] = 
-                            loadSpriteBase( cacheFileName, false );
+                            fillSprite( nextTile, tileD, tileD );
+                        nextTile += tileD * tileD * 4;
                         
-                        char *squareCacheFileName = 
-                            autoSprintf( 
-                                "groundTileCache/biome_%d_x%d_y%d_square.tga",
-                                cacheFileNumber, tx, ty );
-
                         groundSprites[b]->squareTiles[ty][tx] = 
-                            loadSpriteBase( squareCacheFileName, false );
-                        
-                        
-                        if( groundSprites[b]->tiles[ty][tx] == NULL ) {
-                            // cache miss
-                            
-                            allCacheFilesExist = false;
-                            }
-                        if( groundSprites[b]->squareTiles[ty][tx] == NULL ) {
-                            // cache miss
-                            
-                            allCacheFilesExist = false;
-                            }
-                        delete [] cacheFileName;
-                        delete [] squareCacheFileName;
+                            fillSprite( nextTile, CELL_D, CELL_D );
+                        nextTile += CELL_D * CELL_D * 4;
                         }
                     }
                 
-
-                if( !allCacheFilesExist ) {
-                    // need to regenerate some
-                    
-                    // spend time to load the double-converted image
-                    Image *image = readTGAFileBase( fullFileName );
-
-                    int tileD = CELL_D * 2;
+                delete [] sheet;
                 
-                    for( int ty=0; ty<tH; ty++ ) {
-                        
-                        for( int tx=0; tx<tW; tx++ ) {
-                        
-                            if( groundSprites[b]->squareTiles[ty][tx] == 
-                                NULL ) {
-                                
-                                // cache miss
-
-                                char *cacheFileName = autoSprintf( 
-                                  "groundTileCache/biome_%d_x%d_y%d_square.tga",
-                                  cacheFileNumber, tx, ty );
-
-                                if( printSteps ) {    
-                                    printf( "Cache file %s does not exist, "
-                                            "rebuilding.\n", cacheFileName );
-                                    }
-                                
-                                        
-                                Image *tileImage = image->getSubImage( 
-                                    tx * CELL_D, ty * CELL_D, CELL_D, CELL_D );
-                                
-                                writeTGAFile( cacheFileName, tileImage );
-
-                                delete [] cacheFileName;
-                                
-                                groundSprites[b]->squareTiles[ty][tx] = 
-                                    fillSprite( tileImage, false );
-                                
-                                delete tileImage;
-                                }
-                            if( groundSprites[b]->tiles[ty][tx] == NULL ) {
-                                // cache miss
-
-                                char *cacheFileName = 
-                                    autoSprintf( 
-                                        "groundTileCache/biome_%d_x%d_y%d.tga",
-                                        cacheFileNumber, tx, ty );
-
-                                if( printSteps ) {    
-                                    printf( "Cache file %s does not exist, "
-                                            "rebuilding.\n", cacheFileName );
-                                    }
-                                
-                                // generate from scratch
-
-                                Image tileImage( tileD, tileD, 4, false );
-                        
-                                setXYRandomSeed( ty * 237 + tx );
-                        
-                                // first, copy from source image to 
-                                // fill 2x tile
-                                // centered on 1x tile of image, wrapping
-                                // around in source image as needed
-                                int imStartX = 
-                                    tx * CELL_D - ( tileD - CELL_D ) / 2;
-                                int imStartY = 
-                                    ty * CELL_D - ( tileD - CELL_D ) / 2;
-
-                                int imEndX = imStartX + tileD;
-                                int imEndY = imStartY + tileD;
-                                for( int c=0; c<3; c++ ) {
-                                    double *chanSrc = image->getChannel( c );
-                                    double *chanDest = 
-                                        tileImage.getChannel( c );
-                            
-                                    int dY = 0;
-                                    for( int y = imStartY; y<imEndY; y++ ) {
-                                        int wrapY = y;
-                                
-                                        if( wrapY >= h ) {
-                                            wrapY -= h;
-                                            }
-                                        else if( wrapY < 0 ) {
-                                            wrapY += h;
-                                            }
-                                
-                                        int dX = 0;
-                                        for( int x = imStartX;  x<imEndX; 
-                                             x++ ) {
-                                            
-                                            int wrapX = x;
-                                    
-                                            if( wrapX >= w ) {
-                                                wrapX -= w;
-                                                }
-                                            else if( wrapX < 0 ) {
-                                                wrapX += w;
-                                                }
-                                    
-                                            chanDest[ dY * tileD + dX ] =
-                                                chanSrc[ wrapY * w + wrapX ];
-                                            dX++;
-                                            }
-                                        dY++;
-                                        }
-                                    }
-
-                                // now set alpha based on radius
-
-                                int cellR = CELL_D / 2;
-                        
-                                // radius to cornerof map tile
-                                int cellCornerR = 
-                                    (int)sqrt( 2 * cellR * cellR );
-
-                                int tileR = tileD / 2;
-
-                                                
-                                // halfway between
-                                int targetR = ( tileR + cellCornerR ) / 2;
-                        
-
-                                // better:
-                                // grow out from min only
-                                targetR = cellCornerR + 1;
-                        
-                                double wiggleScale = 0.95 * tileR - targetR;
-                        
-                        
-                                double *tileAlpha = tileImage.getChannel( 3 );
-                                for( int y=0; y<tileD; y++ ) {
-                                    int deltY = y - tileD/2;
-                            
-                                    for( int x=0; x<tileD; x++ ) {    
-                                        int deltX = x - tileD/2;
-                                
-                                        double r = 
-                                            sqrt( deltY * deltY + 
-                                                  deltX * deltX );
-                                
-                                        int p = y * tileD + x;
-                                
-                                        double wiggle = 
-                                            getXYFractal( x, y, 0, .5 );
-                                
-                                        wiggle *= wiggleScale;
- 
-                                        if( r > targetR + wiggle ) {
-                                            tileAlpha[p] = 0;
-                                            }
-                                        else {
-                                            tileAlpha[p] = 1;
-                                            }
-                                        }
-                                    }
-
-                                // make sure square of cell plus blur
-                                // radius is solid, so that corners
-                                // are not undercut by blur
-                                // this will make some weird square points
-                                // sticking out, but they will be blurred
-                                // anyway, so that's okay
-                                
-                                int edgeStartA = CELL_D - 
-                                    ( CELL_D/2 + blurRadius );
-
-                                int edgeStartB = CELL_D + 
-                                    ( CELL_D/2 + blurRadius + 1 );
-                                
-                                for( int y=edgeStartA; y<=edgeStartB; y++ ) {
-                                    for( int x=edgeStartA; 
-                                         x<=edgeStartB; x++ ) {    
-                                        
-                                        int p = y * tileD + x;
-                                        tileAlpha[p] = 1.0;
-                                        }
-                                    }
-                                
-
-                                // trimm off lower right edges
-                                for( int y=0; y<tileD; y++ ) {
-                                    
-                                    for( int x=edgeStartB; x<tileD; x++ ) {    
-                                        
-                                        int p = y * tileD + x;
-                                        tileAlpha[p] = 0;
-                                        }
-                                    }
-                                for( int y=edgeStartB; y<tileD; y++ ) {
-                                    
-                                    for( int x=0; x<tileD; x++ ) {    
-                                        
-                                        int p = y * tileD + x;
-                                        tileAlpha[p] = 0;
-                                        }
-                                    }
-                        
-                                if( blurRadius > 0 ) {
-                                    BoxBlurFilter blur( blurRadius );
-                                    
-                                    tileImage.filter( &blur, 3 );
-                                    }
-                                
-                                // cache for next time
-                                
-                                
-                                writeTGAFile( cacheFileName, &tileImage );
-
-                                delete [] cacheFileName;
-                                
-                                // to test a single tile
-                                //exit(0);
-                                
-                                groundSprites[b]->tiles[ty][tx] = 
-                                    fillSprite( &tileImage, false );
-                                }
-                            }
-                        }
-                    delete image;
-                    }
+                groundSprites[b]->wholeSheet = fillSprite( rawImage );
                 }
             
             delete rawImage;
@@ -239,7 +239,7 @@ GridPos minitech::getClosestTile(GridPos src, int objId) {
 
 				bool foundInThisTile = false;
 
-				int mapI = mapY * mMapD + mapX;
+				int mapI = livingLifePage->getMapCellIndex( mapX, mapY );
 				int id = mMap[mapI];
 				id = getDummyParent(id);
 
@@ -420,7 +420,7 @@ int minitech::objIdFromXY( int x, int y ) {
 	int *mMap = livingLifePage->mMap;
 	int mapX = x - mMapOffsetX + mMapD / 2;
 	int mapY = y - mMapOffsetY + mMapD / 2;
-	return mMap[ mapY * mMapD + mapX ];
+	return mMap[ livingLifePage->getMapCellIndex( mapX, mapY ) ];
 }
 
 vector<bool> minitech::getObjIsCloseVector() {
@@ -446,7 +446,7 @@ vector<bool> minitech::getObjIsCloseVector() {
 				
 				bool foundInThisTile = false;
 				
-				int mapI = mapY * mMapD + mapX;
+				int mapI = livingLifePage->getMapCellIndex( mapX, mapY );
 				int id = mMap[mapI];
 				
 				if ( ! (!id || id <= 0 || id >= maxObjects) ) {
@@ -19,6 +19,8 @@
 
 #include "folderCache.h"
 
+#include "bankSnapshot.h"
+
 #include "soundBank.h"
 
 #include "animationBank.h"
@@ -247,6 +249,9 @@ static FolderCache cache;
 
 static int currentFile;
 
+// records and derived tables restored by initObjectBankStart
+static char loadedFromSnapshot = false;
+
 
 static SimpleVector<ObjectRecord*> records;
 static int maxID;
@@ -290,6 +295,12 @@ static char autoGenerateUsedObjects = false;
 static char autoGenerateVariableObjects = false;
 
 
+static char readObjectSnapshot();
+
+
+static FolderCache emptyCache = { NULL, 0, NULL, NULL, NULL };
+
+
 int initObjectBankStart( char *outRebuildingCache, 
                          char inAutoGenerateUsedObjects,
                          char inAutoGenerateVariableObjects ) {
@@ -297,13 +308,23 @@ int initObjectBankStart( char *outRebuildingCache,
 
     currentFile = 0;
     
+    autoGenerateUsedObjects = inAutoGenerateUsedObjects;
+    autoGenerateVariableObjects = inAutoGenerateVariableObjects;
+
+    openBankSnapshot( autoGenerateUsedObjects, autoGenerateVariableObjects );
+    
+    loadedFromSnapshot = readObjectSnapshot();
+    
+    if( loadedFromSnapshot ) {
+        // nothing left to parse
+        cache = emptyCache;
+        *outRebuildingCache = false;
+        return 0;
+        }
 
     cache = initFolderCache( "objects", outRebuildingCache,
                              shouldFileBeCached );
 
-    autoGenerateUsedObjects = inAutoGenerateUsedObjects;
-    autoGenerateVariableObjects = inAutoGenerateVariableObjects;
-
     return cache.numFiles;
     }
 
@@ -2219,10 +2240,76 @@ void setupNumericSprites( ObjectRecord *inO, int inNumber, int inMax,
 
 
 
+static void copyDummyAnimations( int inMainID, int inDummyID ) {
+    for( int t=0; t<endAnimType; t++ ) {
+        AnimationRecord *a = getAnimation( inMainID, (AnimType)t );
+
+        if( a != NULL ) {
+            
+            // feels more risky, but way faster
+            // than copying it
+            
+            // temporarily replace the object ID
+            // before adding this record
+            // it will be copied internally
+            a->objectID = inDummyID;
+            
+            addAnimation( a, true );
+            
+            // restore original record
+            a->objectID = inMainID;
+            }
+        }
+    }
+
+
+
+// animation bank isn't part of snapshot, so dummies restored from it
+// still need their parent's animations
+static void restoreDummyAnimations() {
+    for( int i=0; i<mapSize; i++ ) {
+        if( idMap[i] != NULL && idMap[i]->useDummyIDs != NULL ) {
+            ObjectRecord *o = idMap[i];
+            
+            for( int d=0; d < o->numUses - 1; d++ ) {
+                copyDummyAnimations( o->id, o->useDummyIDs[d] );
+                }
+            }
+        }
+    for( int i=0; i<mapSize; i++ ) {
+        if( idMap[i] != NULL && idMap[i]->variableDummyIDs != NULL ) {
+            ObjectRecord *o = idMap[i];
+            
+            for( int d=0; d < o->numVariableDummyIDs; d++ ) {
+                copyDummyAnimations( o->id, o->variableDummyIDs[d] );
+                }
+            }
+        }
+    }
+
+
+
+// lowercase descriptions of scanned records, as inserted into search tree
+static SimpleVector<int> searchKeyIDs;
+static SimpleVector<char*> searchKeys;
+
+
+static void writeObjectSnapshot();
+
+
+
 void initObjectBankFinish() {
   
     freeFolderCache( cache );
     
+    if( loadedFromSnapshot ) {
+        // generated dummies and derived tables are already in there
+        restoreDummyAnimations();
+        
+        printf( "Loaded %d objects from snapshot\n", records.size() );
+        return;
+        }
+
     mapSize = maxID + 1;
     
     idMap = new ObjectRecord*[ mapSize ];
@@ -2248,13 +2335,16 @@ void initObjectBankFinish() {
         else {
             idMap[ r->id ] = r;
 
+            // saved for snapshot even if search is off, because 
+            // descriptions of variable objects are changed below
+            char *lowercase = stringToLowerCase( r->description );
+            
             if( makeNewObjectsSearchable ) {    
-                char *lowercase = stringToLowerCase( r->description );
-                
                 tree.insert( lowercase, r );
-                
-                delete [] lowercase;
                 }
+            
+            searchKeyIDs.push_back( r->id );
+            searchKeys.push_back( lowercase );
             }
         }
     
@@ -2386,26 +2476,7 @@ void initObjectBankFinish() {
                         
                         
                         // copy anims too
-                        for( int t=0; t<endAnimType; t++ ) {
-                            AnimationRecord *a = getAnimation( mainID,
-                                                               (AnimType)t );
-
-                            if( a != NULL ) {
-                                
-                                // feels more risky, but way faster
-                                // than copying it
-                                
-                                // temporarily replace the object ID
-                                // before adding this record
-                                // it will be copied internally
-                                a->objectID = dummyID;
-                                
-                                addAnimation( a, true );
-
-                                // restore original record
-                                a->objectID = mainID;
-                                }
-                            }
+                        copyDummyAnimations( mainID, dummyID );
                         }
                     }
                 
@@ -2506,26 +2577,7 @@ void initObjectBankFinish() {
                         dummyO->isVariableHidden = variableHidden;
                         
                         // copy anims too
-                        for( int t=0; t<endAnimType; t++ ) {
-                            AnimationRecord *a = getAnimation( mainID,
-                                                               (AnimType)t );
-
-                            if( a != NULL ) {
-                                
-                                // feels more risky, but way faster
-                                // than copying it
-                                
-                                // temporarily replace the object ID
-                                // before adding this record
-                                // it will be copied internally
-                                a->objectID = dummyID;
-                                
-                                addAnimation( a, true );
-
-                                // restore original record
-                                a->objectID = mainID;
-                                }
-                            }
+                        copyDummyAnimations( mainID, dummyID );
                         if( numericLabel ) {
                             setupNumericSprites( dummyO, d, numVar,
                                                  dummyO->spriteSkipDrawing );
@@ -2929,6 +2981,424 @@ void initObjectBankFinish() {
     if( false ) {
         countVisuallyUniqueObjects();
         }
+    
+    writeObjectSnapshot();
+    }
+
+
+
+
+// object section of bank snapshot
+//
+// Layout:
+// mapSize, maxID, numRecords ints
+// for each record, raw ObjectRecord struct (pointer fields ignored)
+//   followed by each pointer field as a counted array
+// scalar derived values
+// derived ID lists, tapout records, global triggers, tool sets
+// biome heat map
+// search tree keys with object IDs
+
+static uint32_t getObjectSnapshotTag() {
+    return autoGenerateUsedObjects | autoGenerateVariableObjects << 1;
+    }
+
+
+
+static void pushSoundUsage( SimpleVector<unsigned char> *inData,
+                            SoundUsage *inUsage ) {
+    snapshotPushArray( inData, inUsage->ids, inUsage->numSubSounds );
+    snapshotPushArray( inData, inUsage->volumes, inUsage->numSubSounds );
+    }
+
+
+
+static void readSoundUsage( SnapshotReader *inReader, SoundUsage *inUsage ) {
+    inUsage->ids = snapshotReadArray<int>( inReader );
+    inUsage->volumes = snapshotReadArray<double>( inReader );
+    }
+
+
+
+static void pushObjectRecord( SimpleVector<unsigned char> *inData,
+                              ObjectRecord *inR ) {
+    snapshotPushBytes( inData, inR, sizeof( ObjectRecord ) );
+
+    snapshotPushString( inData, inR->description );
+    snapshotPushString( inData, inR->authorTag );
+    
+    int n = inR->numSprites;
+
+    snapshotPushArray( inData, inR->spriteBehindPlayer, n );
+    snapshotPushArray( inData, inR->spriteAdditiveBlend, n );
+    snapshotPushArray( inData, inR->biomes, inR->numBiomes );
+    
+    pushSoundUsage( inData, &( inR->creationSound ) );
+    pushSoundUsage( inData, &( inR->usingSound ) );
+    pushSoundUsage( inData, &( inR->eatingSound ) );
+    pushSoundUsage( inData, &( inR->decaySound ) );
+
+    snapshotPushArray( inData, inR->slotPos, inR->numSlots );
+    snapshotPushArray( inData, inR->slotVert, inR->numSlots );
+    snapshotPushArray( inData, inR->slotParent, inR->numSlots );
+
+    snapshotPushArray( inData, inR->sprites, n );
+    snapshotPushArray( inData, inR->spritePos, n );
+    snapshotPushArray( inData, inR->spriteRot, n );
+    snapshotPushArray( inData, inR->spriteHFlip, n );
+    snapshotPushArray( inData, inR->spriteColor, n );
+    snapshotPushArray( inData, inR->spriteAgeStart, n );
+    snapshotPushArray( inData, inR->spriteAgeEnd, n );
+    snapshotPushArray( inData, inR->spriteParent, n );
+    snapshotPushArray( inData, inR->spriteInvisibleWhenHolding, n );
+    snapshotPushArray( inData, inR->spriteInvisibleWhenWorn, n );
+    snapshotPushArray( inData, inR->spriteBehindSlots, n );
+    snapshotPushArray( inData, inR->spriteInvisibleWhenContained, n );
+    snapshotPushArray( inData, inR->spriteIsHead, n );
+    snapshotPushArray( inData, inR->spriteIsBody, n );
+    snapshotPushArray( inData, inR->spriteIsBackFoot, n );
+    snapshotPushArray( inData, inR->spriteIsFrontFoot, n );
+    snapshotPushArray( inData, inR->spriteIsEyes, n );
+    snapshotPushArray( inData, inR->spriteIsMouth, n );
+    snapshotPushArray( inData, inR->spriteUseVanish, n );
+    snapshotPushArray( inData, inR->spriteUseAppear, n );
+    snapshotPushArray( inData, inR->spriteSkipDrawing, n );
+    snapshotPushArray( inData, inR->spriteNoFlipXPos, n );
+
+    snapshotPushArray( inData, inR->useDummyIDs, inR->numUses - 1 );
+    snapshotPushArray( inData, inR->variableDummyIDs, 
+                       inR->numVariableDummyIDs );
+    snapshotPushArray( inData, inR->permittedBiomeMap, 
+                       inR->maxBiomeMapEntry + 1 );
+    }
+
+
+
+// always returns a record that can be passed to freeObjectRecord,
+// even if reader fails part way through
+static ObjectRecord *readObjectRecord( SnapshotReader *inReader ) {
+    ObjectRecord *r = new ObjectRecord;
+    
+    snapshotReadBytes( inReader, r, sizeof( ObjectRecord ) );
+    
+    r->description = snapshotReadString( inReader );
+    r->authorTag = snapshotReadString( inReader );
+
+    r->spriteBehindPlayer = snapshotReadArray<char>( inReader );
+    r->spriteAdditiveBlend = snapshotReadArray<char>( inReader );
+    r->biomes = snapshotReadArray<int>( inReader );
+    
+    readSoundUsage( inReader, &( r->creationSound ) );
+    readSoundUsage( inReader, &( r->usingSound ) );
+    readSoundUsage( inReader, &( r->eatingSound ) );
+    readSoundUsage( inReader, &( r->decaySound ) );
+
+    r->slotPos = snapshotReadArray<doublePair>( inReader );
+    r->slotVert = snapshotReadArray<char>( inReader );
+    r->slotParent = snapshotReadArray<int>( inReader );
+
+    r->sprites = snapshotReadArray<int>( inReader );
+    r->spritePos = snapshotReadArray<doublePair>( inReader );
+    r->spriteRot = snapshotReadArray<double>( inReader );
+    r->spriteHFlip = snapshotReadArray<char>( inReader );
+    r->spriteColor = snapshotReadArray<FloatRGB>( inReader );
+    r->spriteAgeStart = snapshotReadArray<double>( inReader );
+    r->spriteAgeEnd = snapshotReadArray<double>( inReader );
+    r->spriteParent = snapshotReadArray<int>( inReader );
+    r->spriteInvisibleWhenHolding = snapshotReadArray<char>( inReader );
+    r->spriteInvisibleWhenWorn = snapshotReadArray<int>( inReader );
+    r->spriteBehindSlots = snapshotReadArray<char>( inReader );
+    r->spriteInvisibleWhenContained = snapshotReadArray<char>( inReader );
+    r->spriteIsHead = snapshotReadArray<char>( inReader );
+    r->spriteIsBody = snapshotReadArray<char>( inReader );
+    r->spriteIsBackFoot = snapshotReadArray<char>( inReader );
+    r->spriteIsFrontFoot = snapshotReadArray<char>( inReader );
+    r->spriteIsEyes = snapshotReadArray<char>( inReader );
+    r->spriteIsMouth = snapshotReadArray<char>( inReader );
+    r->spriteUseVanish = snapshotReadArray<char>( inReader );
+    r->spriteUseAppear = snapshotReadArray<char>( inReader );
+    r->spriteSkipDrawing = snapshotReadArray<char>( inReader );
+    r->spriteNoFlipXPos = snapshotReadArray<double>( inReader );
+
+    r->useDummyIDs = snapshotReadArray<int>( inReader );
+    r->variableDummyIDs = snapshotReadArray<int>( inReader );
+    r->permittedBiomeMap = snapshotReadArray<char>( inReader );
+
+    if( r->description == NULL ) {
+        inReader->failed = true;
+        }
+    
+    return r;
+    }
+
+
+
+static void writeObjectSnapshot() {
+    SimpleVector<unsigned char> data;
+    
+    int numRecords = 0;
+    for( int i=0; i<mapSize; i++ ) {
+        if( idMap[i] != NULL ) {
+            numRecords++;
+            }
+        }
+
+    snapshotPushInt( &data, mapSize );
+    snapshotPushInt( &data, maxID );
+    snapshotPushInt( &data, numRecords );
+    
+    for( int i=0; i<mapSize; i++ ) {
+        if( idMap[i] != NULL ) {
+            pushObjectRecord( &data, idMap[i] );
+            }
+        }
+    
+    snapshotPushInt( &data, defaultObjectID );
+    snapshotPushInt( &data, maxFoodValue );
+    snapshotPushInt( &data, maxWideRadius );
+    snapshotPushInt( &data, maxSpeechPipeIndex );
+    
+    snapshotPushIntVector( &data, &personObjectIDs );
+    snapshotPushIntVector( &data, &femalePersonObjectIDs );
+    snapshotPushIntVector( &data, &monumentCallObjectIDs );
+    snapshotPushIntVector( &data, &deathMarkerObjectIDs );
+    snapshotPushIntVector( &data, &allPossibleDeathMarkerIDs );
+    snapshotPushIntVector( &data, &allPossibleFoodIDs );
+    
+    for( int i=0; i<=MAX_RACE; i++ ) {
+        snapshotPushIntVector( &data, &( racePersonObjectIDs[i] ) );
+        }
+    snapshotPushIntVector( &data, &raceList );
+    
+    snapshotPushInt( &data, tapoutRecords.size() );
+    for( int i=0; i<tapoutRecords.size(); i++ ) {
+        snapshotPushBytes( &data, tapoutRecords.getElement( i ),
+                           sizeof( TapoutRecord ) );
+        }
+
+    snapshotPushInt( &data, globalTriggers.size() );
+    for( int i=0; i<globalTriggers.size(); i++ ) {
+        snapshotPushInt( &data, 
+                         globalTriggers.getElementDirect( i ).onTriggerID );
+        }
+
+    snapshotPushInt( &data, toolSetRecords.size() );
+    for( int i=0; i<toolSetRecords.size(); i++ ) {
+        ToolSetRecord *t = toolSetRecords.getElement( i );
+        
+        snapshotPushString( &data, t->setTag );
+        snapshotPushIntVector( &data, &( t->setMembership ) );
+        }
+    
+    snapshotPushArray( &data, biomeHeatMap, MAX_BIOME + 1 );
+    
+    snapshotPushInt( &data, searchKeys.size() );
+    for( int i=0; i<searchKeys.size(); i++ ) {
+        snapshotPushInt( &data, searchKeyIDs.getElementDirect( i ) );
+        snapshotPushString( &data, searchKeys.getElementDirect( i ) );
+        }
+    
+    searchKeyIDs.deleteAll();
+    searchKeys.deallocateStringElements();
+    
+    setBankSnapshotSection( snapshotObjects, getObjectSnapshotTag(),
+                            sizeof( ObjectRecord ), &data );
+    }
+
+
+
+// on success, fills idMap, records, and all derived tables
+static char readObjectSnapshot() {
+    int length;
+    unsigned char *bytes = 
+        getBankSnapshotSection( snapshotObjects, getObjectSnapshotTag(),
+                                sizeof( ObjectRecord ), &length );
+    
+    if( bytes == NULL ) {
+        return false;
+        }
+    
+    SnapshotReader reader = { bytes, bytes + length, false };
+    
+    int newMapSize = snapshotReadInt( &reader );
+    int newMaxID = snapshotReadInt( &reader );
+    int numRecords = snapshotReadInt( &reader );
+    
+    if( reader.failed || 
+        newMapSize <= newMaxID || newMaxID < 0 || numRecords < 0 ) {
+        return false;
+        }
+    
+    ObjectRecord **newMap = new ObjectRecord*[ newMapSize ];
+    
+    for( int i=0; i<newMapSize; i++ ) {
+        newMap[i] = NULL;
+        }
+    
+    for( int i=0; i<numRecords && ! reader.failed; i++ ) {
+        ObjectRecord *r = readObjectRecord( &reader );
+        
+        if( r->id < 0 || r->id >= newMapSize || newMap[ r->id ] != NULL ) {
+            reader.failed = true;
+            }
+
+        if( reader.failed ) {
+            freeObjectRecord( r );
+            }
+        else {
+            newMap[ r->id ] = r;
+            }
+        }
+    
+    int newDefaultObjectID = snapshotReadInt( &reader );
+    int newMaxFoodValue = snapshotReadInt( &reader );
+    int newMaxWideRadius = snapshotReadInt( &reader );
+    int newMaxSpeechPipeIndex = snapshotReadInt( &reader );
+
+    SimpleVector<int> lists[6];
+    
+    for( int i=0; i<6; i++ ) {
+        snapshotReadIntVector( &reader, &( lists[i] ) );
+        }
+    
+    SimpleVector<int> raceLists[ MAX_RACE + 1 ];
+    
+    for( int i=0; i<=MAX_RACE; i++ ) {
+        snapshotReadIntVector( &reader, &( raceLists[i] ) );
+        }
+    SimpleVector<int> newRaceList;
+    snapshotReadIntVector( &reader, &newRaceList );
+    
+    SimpleVector<TapoutRecord> newTapoutRecords;
+    int numTapout = snapshotReadInt( &reader );
+    for( int i=0; i<numTapout && ! reader.failed; i++ ) {
+        TapoutRecord t;
+        snapshotReadBytes( &reader, &t, sizeof( TapoutRecord ) );
+        newTapoutRecords.push_back( t );
+        }
+
+    SimpleVector<GlobalTrigger> newGlobalTriggers;
+    int numTriggers = snapshotReadInt( &reader );
+    for( int i=0; i<numTriggers && ! reader.failed; i++ ) {
+        GlobalTrigger g = { snapshotReadInt( &reader ) };
+        newGlobalTriggers.push_back( g );
+        }
+    
+    SimpleVector<ToolSetRecord> newToolSets;
+    int numToolSets = snapshotReadInt( &reader );
+    for( int i=0; i<numToolSets && ! reader.failed; i++ ) {
+        ToolSetRecord t = { snapshotReadString( &reader ) };
+        newToolSets.push_back( t );
+        
+        snapshotReadIntVector( 
+            &reader, 
+            &( newToolSets.getElement( newToolSets.size() - 1 )->
+               setMembership ) );
+        }
+
+    int numHeat;
+    float *heat = snapshotReadArray<float>( &reader, &numHeat );
+    
+    if( heat == NULL || numHeat != MAX_BIOME + 1 ) {
+        reader.failed = true;
+        }
+    
+    SimpleVector<int> keyIDs;
+    SimpleVector<char*> keys;
+    int numKeys = snapshotReadInt( &reader );
+    for( int i=0; i<numKeys && ! reader.failed; i++ ) {
+        int id = snapshotReadInt( &reader );
+        char *key = snapshotReadString( &reader );
+        
+        if( key == NULL ) {
+            reader.failed = true;
+            break;
+            }
+        
+        keyIDs.push_back( id );
+        keys.push_back( key );
+
+        if( id < 0 || id >= newMapSize || newMap[ id ] == NULL ) {
+            reader.failed = true;
+            }
+        }
+
+    if( reader.failed || reader.next != reader.end ) {
+        for( int i=0; i<newMapSize; i++ ) {
+            if( newMap[i] != NULL ) {
+                freeObjectRecord( newMap[i] );
+                }
+            }
+        delete [] newMap;
+        
+        for( int i=0; i<newToolSets.size(); i++ ) {
+            char *tag = newToolSets.getElementDirect( i ).setTag;
+            if( tag != NULL ) {
+                delete [] tag;
+                }
+            }
+        if( heat != NULL ) {
+            delete [] heat;
+            }
+        keys.deallocateStringElements();
+        return false;
+        }
+    
+
+    mapSize = newMapSize;
+    maxID = newMaxID;
+    idMap = newMap;
+    
+    for( int i=0; i<mapSize; i++ ) {
+        if( idMap[i] != NULL ) {
+            records.push_back( idMap[i] );
+            }
+        }
+
+    defaultObjectID = newDefaultObjectID;
+    maxFoodValue = newMaxFoodValue;
+    maxWideRadius = newMaxWideRadius;
+    maxSpeechPipeIndex = newMaxSpeechPipeIndex;
+    
+    SimpleVector<int> *destLists[6] = { &personObjectIDs,
+                                         &femalePersonObjectIDs,
+                                         &monumentCallObjectIDs,
+                                         &deathMarkerObjectIDs,
+                                         &allPossibleDeathMarkerIDs,
+                                         &allPossibleFoodIDs };
+    for( int i=0; i<6; i++ ) {
+        destLists[i]->deleteAll();
+        destLists[i]->push_back_other( &( lists[i] ) );
+        }
+    
+    for( int i=0; i<=MAX_RACE; i++ ) {
+        racePersonObjectIDs[i].deleteAll();
+        racePersonObjectIDs[i].push_back_other( &( raceLists[i] ) );
+        }
+    raceList.deleteAll();
+    raceList.push_back_other( &newRaceList );
+    
+    tapoutRecords.deleteAll();
+    tapoutRecords.push_back_other( &newTapoutRecords );
+    
+    globalTriggers.deleteAll();
+    globalTriggers.push_back_other( &newGlobalTriggers );
+    
+    toolSetRecords.deleteAll();
+    toolSetRecords.push_back_other( &newToolSets );
+    
+    memcpy( biomeHeatMap, heat, sizeof( float ) * ( MAX_BIOME + 1 ) );
+    delete [] heat;
+    
+    if( makeNewObjectsSearchable ) {
+        for( int i=0; i<keys.size(); i++ ) {
+            tree.insert( keys.getElementDirect( i ), 
+                         idMap[ keyIDs.getElementDirect( i ) ] );
+            }
+        }
+    keys.deallocateStringElements();
+    
+    return true;
     }
 
 
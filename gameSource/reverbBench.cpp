@@ -0,0 +1,418 @@
+// times reverb cache generation the old way (double precision, one big
+// FFT window per pair of windows, one thread) against partitioned float
+// convolution, on one thread and on several, and checks that the
+// resulting 16-bit samples match
+//
+// usage:  reverbBench [impulse.aiff [sound.aiff ...]]
+//
+// impulse defaults to reverbImpulseResponse.aiff
+// with no sounds, made-up ones are used, of lengths like those in the
+// sounds folder
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdint.h>
+
+
+#include "minorGems/sound/formats/aiff.h"
+#include "minorGems/io/file/File.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/random/JenkinsRandomSource.h"
+
+
+#include "convolution.h"
+
+
+
+#define NUM_THREADS 4
+
+
+
+static int16_t *readAIFFFile( const char *inFileName, int *outNumSamples ) {
+    File file( NULL, inFileName );
+
+    int numBytes;
+    unsigned char *data =
+        file.readFileContents( &numBytes );
+
+    if( data != NULL ) {
+        int16_t *samples = readMono16AIFFData( data, numBytes, outNumSamples );
+
+        delete [] data;
+
+        return samples;
+        }
+
+    return NULL;
+    }
+
+
+
+typedef struct Sound {
+        int16_t *samples;
+        int numSamples;
+
+        // results
+        int16_t *oldWet;
+        int16_t *newWet;
+    } Sound;
+
+
+static SimpleVector<Sound> sounds;
+
+
+
+// normalized like generateWetConvolve
+template <class Sample>
+static int16_t *normalizeWet( Sample *inWet, int inNumWet ) {
+    double maxWet = 0;
+    double minWet = 0;
+
+    for( int i=0; i<inNumWet; i++ ) {
+        if( inWet[ i ] > maxWet ) {
+            maxWet = inWet[ i ];
+            }
+        else if( inWet[ i ] < minWet ) {
+            minWet = inWet[ i ];
+            }
+        }
+    double scale = maxWet;
+    if( -minWet > scale ) {
+        scale = -minWet;
+        }
+    double normalizeFactor = 1.0 / scale;
+
+    int16_t *wetSamples = new int16_t[ inNumWet ];
+    for( int i=0; i<inNumWet; i++ ) {
+        wetSamples[i] =
+            (int16_t)( lrint( 32767 * normalizeFactor * inWet[i] ) );
+        }
+    return wetSamples;
+    }
+
+
+
+static int16_t *oldWetConvolve( MultiConvolution inMulti, Sound *inSound ) {
+    int numWet = inSound->numSamples + inMulti.savedNumSamplesB;
+
+    double *wet = new double[ numWet ];
+    for( int i=0; i<numWet; i++ ) {
+        wet[i] = 0;
+        }
+
+    double *dry = new double[ inSound->numSamples ];
+    for( int i=0; i<inSound->numSamples; i++ ) {
+        dry[i] = (double) inSound->samples[i] / 32768.0;
+        }
+
+    multiConvolve( inMulti, dry, inSound->numSamples, wet );
+
+    int16_t *result = normalizeWet( wet, numWet );
+
+    delete [] dry;
+    delete [] wet;
+
+    return result;
+    }
+
+
+
+static int16_t *newWetConvolve( PartitionedConvolution *inConvolution,
+                                ConvolutionScratch *inScratch,
+                                Sound *inSound ) {
+    int numWet = inSound->numSamples + inConvolution->numSamplesB;
+
+    float *wet = new float[ numWet ];
+
+    float *dry = new float[ inSound->numSamples ];
+    for( int i=0; i<inSound->numSamples; i++ ) {
+        dry[i] = (float) inSound->samples[i] / 32768.0f;
+        }
+
+    partitionedConvolve( inConvolution, inScratch,
+                         dry, inSound->numSamples, wet );
+
+    int16_t *result = normalizeWet( wet, numWet );
+
+    delete [] dry;
+    delete [] wet;
+
+    return result;
+    }
+
+
+
+static PartitionedConvolution *sharedConvolution;
+
+static MutexLock soundLock;
+static int nextSound = 0;
+
+
+
+class BenchThread : public Thread {
+    public:
+
+        BenchThread() {
+            start();
+            }
+
+        virtual void run() {
+            ConvolutionScratch *scratch =
+                newConvolutionScratch( sharedConvolution );
+
+            while( true ) {
+                soundLock.lock();
+                int i = nextSound;
+                nextSound++;
+                soundLock.unlock();
+
+                if( i >= sounds.size() ) {
+                    break;
+                    }
+
+                Sound *s = sounds.getElement( i );
+
+                s->newWet = newWetConvolve( sharedConvolution, scratch, s );
+                }
+
+            deleteConvolutionScratch( scratch );
+            }
+    };
+
+
+
+static void clearNewResults() {
+    for( int i=0; i<sounds.size(); i++ ) {
+        Sound *s = sounds.getElement( i );
+
+        if( s->newWet != NULL ) {
+            delete [] s->newWet;
+            s->newWet = NULL;
+            }
+        }
+    }
+
+
+
+static double runNewSerial( PartitionedConvolution *inConvolution ) {
+    clearNewResults();
+
+    double startTime = Time::getCurrentTime();
+
+    ConvolutionScratch *scratch = newConvolutionScratch( inConvolution );
+
+    for( int i=0; i<sounds.size(); i++ ) {
+        Sound *s = sounds.getElement( i );
+        s->newWet = newWetConvolve( inConvolution, scratch, s );
+        }
+
+    deleteConvolutionScratch( scratch );
+
+    return Time::getCurrentTime() - startTime;
+    }
+
+
+
+static void makeSounds() {
+    JenkinsRandomSource randSource( 1937 );
+
+    for( int i=0; i<100; i++ ) {
+        Sound s;
+
+        // most sounds are short, a few are several seconds
+        double seconds = 0.1 + 3 * pow( randSource.getRandomDouble(), 3 );
+
+        s.numSamples = (int)( seconds * 44100 );
+        s.samples = new int16_t[ s.numSamples ];
+
+        // decaying noise
+        double decay = 5 / (double)s.numSamples;
+
+        for( int j=0; j<s.numSamples; j++ ) {
+            s.samples[j] =
+                (int16_t)( randSource.getRandomBoundedInt( -20000, 20000 ) *
+                           exp( - j * decay ) );
+            }
+        s.oldWet = NULL;
+        s.newWet = NULL;
+
+        sounds.push_back( s );
+        }
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    const char *impulseFileName = "reverbImpulseResponse.aiff";
+
+    if( inNumArgs > 1 ) {
+        impulseFileName = inArgs[1];
+        }
+
+    int numImpulseSamples;
+    int16_t *impulseSamples =
+        readAIFFFile( impulseFileName, &numImpulseSamples );
+
+    if( impulseSamples == NULL ) {
+        printf( "Failed to read %s\n", impulseFileName );
+        return 1;
+        }
+
+    for( int i=2; i<inNumArgs; i++ ) {
+        Sound s;
+        s.samples = readAIFFFile( inArgs[i], &( s.numSamples ) );
+        s.oldWet = NULL;
+        s.newWet = NULL;
+
+        if( s.samples == NULL ) {
+            printf( "Failed to read %s\n", inArgs[i] );
+            return 1;
+            }
+        sounds.push_back( s );
+        }
+
+    if( sounds.size() == 0 ) {
+        makeSounds();
+        }
+
+    int totalSamples = 0;
+    for( int i=0; i<sounds.size(); i++ ) {
+        totalSamples += sounds.getElement( i )->numSamples;
+        }
+
+    printf( "Impulse response has %d samples, "
+            "convolving %d sounds with %d samples total\n",
+            numImpulseSamples, sounds.size(), totalSamples );
+
+
+    double *impulseDoubles = new double[ numImpulseSamples ];
+    float *impulseFloats = new float[ numImpulseSamples ];
+
+    for( int i=0; i<numImpulseSamples; i++ ) {
+        impulseDoubles[i] = (double) impulseSamples[i] / 32768.0;
+        impulseFloats[i] = (float) impulseSamples[i] / 32768.0f;
+        }
+
+
+    // old way
+    double startTime = Time::getCurrentTime();
+
+    MultiConvolution multi =
+        startMultiConvolution( impulseDoubles, numImpulseSamples );
+
+    for( int i=0; i<sounds.size(); i++ ) {
+        Sound *s = sounds.getElement( i );
+        s->oldWet = oldWetConvolve( multi, s );
+        }
+
+    endMultiConvolution( &multi );
+
+    double oldSeconds = Time::getCurrentTime() - startTime;
+
+    printf( "Double, 65536 window, 1 thread:        %7.3f sec\n",
+            oldSeconds );
+
+
+    // new way, one thread, for a range of partition sizes
+    int partitionSizes[] = { 512, 1024, 2048, 4096, 8192 };
+
+    for( int p=0; p<5; p++ ) {
+        PartitionedConvolution c =
+            startPartitionedConvolution( impulseFloats, numImpulseSamples,
+                                         partitionSizes[p] );
+
+        double seconds = runNewSerial( &c );
+
+        printf( "Float, %4d partitions, 1 thread:      %7.3f sec  "
+                "(%.1fx)\n",
+                partitionSizes[p], seconds, oldSeconds / seconds );
+
+        endPartitionedConvolution( &c );
+        }
+
+
+    // new way with default partition size, serial, then on threads
+    PartitionedConvolution c =
+        startPartitionedConvolution( impulseFloats, numImpulseSamples );
+
+    double serialSeconds = runNewSerial( &c );
+
+
+    clearNewResults();
+
+    sharedConvolution = &c;
+    nextSound = 0;
+
+    startTime = Time::getCurrentTime();
+
+    BenchThread *threads[ NUM_THREADS ];
+    for( int t=0; t<NUM_THREADS; t++ ) {
+        threads[t] = new BenchThread();
+        }
+    for( int t=0; t<NUM_THREADS; t++ ) {
+        threads[t]->join();
+        delete threads[t];
+        }
+
+    double threadedSeconds = Time::getCurrentTime() - startTime;
+
+    printf( "Float, %4d partitions, %d threads:     %7.3f sec  "
+            "(%.1fx)\n",
+            c.partitionSize, NUM_THREADS, threadedSeconds,
+            oldSeconds / threadedSeconds );
+    printf( "    (same on 1 thread:                  %7.3f sec)\n",
+            serialSeconds );
+
+    endPartitionedConvolution( &c );
+
+
+    // compare output samples
+    int maxDiff = 0;
+    int numDiffering = 0;
+
+    for( int i=0; i<sounds.size(); i++ ) {
+        Sound *s = sounds.getElement( i );
+
+        int numWet = s->numSamples + numImpulseSamples;
+
+        for( int j=0; j<numWet; j++ ) {
+            int d = abs( s->oldWet[j] - s->newWet[j] );
+
+            if( d > 0 ) {
+                numDiffering++;
+                }
+            if( d > maxDiff ) {
+                maxDiff = d;
+                }
+            }
+        }
+
+    printf( "Largest difference in 16-bit output: %d "
+            "(%d samples differ at all)\n", maxDiff, numDiffering );
+
+
+    for( int i=0; i<sounds.size(); i++ ) {
+        Sound *s = sounds.getElement( i );
+        delete [] s->samples;
+        delete [] s->oldWet;
+        delete [] s->newWet;
+        }
+
+    delete [] impulseSamples;
+    delete [] impulseDoubles;
+    delete [] impulseFloats;
+
+
+    // off by one from rounding is expected from float math
+    if( maxDiff > 2 ) {
+        printf( "FAILED:  output differs too much\n" );
+        return 1;
+        }
+
+    return 0;
+    }
@@ -0,0 +1,651 @@
+#include "serverReceiver.h"
+
+#include "spscQueue.h"
+
+#include "minorGems/formats/encodingUtils.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/BinarySemaphore.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+
+
+typedef struct MessageTypeCode {
+        const char *code;
+        messageType type;
+    } MessageTypeCode;
+
+
+static MessageTypeCode messageTypeCodes[] = {
+    { "CM", COMPRESSED_MESSAGE },
+    // MB is binary version, see binaryMapChunk.h
+    { "MC", MAP_CHUNK },
+    { "MB", MAP_CHUNK },
+    { "MX", MAP_CHANGE },
+    { "PU", PLAYER_UPDATE },
+    { "PM", PLAYER_MOVES_START },
+    { "PO", PLAYER_OUT_OF_RANGE },
+    { "BW", BABY_WIGGLE },
+    { "PS", PLAYER_SAYS },
+    { "LS", LOCATION_SAYS },
+    { "PE", PLAYER_EMOT },
+    { "FX", FOOD_CHANGE },
+    { "HX", HEAT_CHANGE },
+    { "LN", LINEAGE },
+    { "CU", CURSED },
+    { "CX", CURSE_TOKEN_CHANGE },
+    { "CS", CURSE_SCORE },
+    { "NM", NAMES },
+    { "AP", APOCALYPSE },
+    { "AD", APOCALYPSE_DONE },
+    { "DY", DYING },
+    { "HE", HEALED },
+    { "PJ", POSSE_JOIN },
+    { "MN", MONUMENT_CALL },
+    { "GV", GRAVE },
+    { "GM", GRAVE_MOVE },
+    { "GO", GRAVE_OLD },
+    { "OW", OWNER },
+    { "FW", FOLLOWING },
+    { "EX", EXILED },
+    { "VS", VALLEY_SPACING },
+    { "FD", FLIGHT_DEST },
+    { "BB", BAD_BIOMES },
+    { "VU", VOG_UPDATE },
+    { "PH", PHOTO_SIGNATURE },
+    { "PONG", PONG },
+    { "SHUTDOWN", SHUTDOWN },
+    { "SERVER_FULL", SERVER_FULL },
+    { "SN", SEQUENCE_NUMBER },
+    { "ACCEPTED", ACCEPTED },
+    { "REJECTED", REJECTED },
+    { "NO_LIFE_TOKENS", NO_LIFE_TOKENS },
+    { "SD", FORCED_SHUTDOWN },
+    { "MS", GLOBAL_MESSAGE },
+    { "WR", WAR_REPORT },
+    { "LR", LEARNED_TOOL_REPORT },
+    { "TE", TOOL_EXPERTS },
+    { "TS", TOOL_SLOTS },
+    { "HL", HOMELAND },
+    { "FL", FLIP },
+    { "CR", CRAVING },
+    { "GH", GHOST },
+    { "RR", ROCKET_RIDE },
+    { "RA", ROCKET_ACCOUNT } };
+
+
+static int numMessageTypeCodes =
+    sizeof( messageTypeCodes ) / sizeof( MessageTypeCode );
+
+
+
+messageType getMessageType( const char *inMessage ) {
+
+    const char *firstBreak = strstr( inMessage, "\n" );
+
+    if( firstBreak == NULL ) {
+        return UNKNOWN;
+        }
+
+    int lineLength = firstBreak - inMessage;
+
+    for( int i=0; i<numMessageTypeCodes; i++ ) {
+        const char *code = messageTypeCodes[i].code;
+
+        if( strncmp( inMessage, code, lineLength ) == 0 &&
+            code[ lineLength ] == '\0' ) {
+            return messageTypeCodes[i].type;
+            }
+        }
+
+    return UNKNOWN;
+    }
+
+
+
+
+typedef struct ByteBlock {
+        // NULL for a reset marker
+        unsigned char *data;
+        int length;
+
+        // resets that main thread has made, up to this block
+        int generation;
+    } ByteBlock;
+
+
+
+typedef struct GenerationFrame {
+        ServerFrame *frame;
+        int generation;
+    } GenerationFrame;
+
+
+
+// main thread to receive thread
+static SPSCQueue<ByteBlock*> *byteQueue = NULL;
+
+// receive thread to main thread
+static SPSCQueue<GenerationFrame> *frameQueue = NULL;
+
+// frames made on main thread, if not threaded
+static SimpleVector<GenerationFrame> inlineFrames;
+
+
+// blocks that didn't fit in byteQueue, in order, waiting to be pushed
+// only touched by main thread
+static SimpleVector<ByteBlock*> unqueuedBlocks;
+
+// count of resetServerReceiver calls
+// only touched by main thread
+static int mainGeneration = 0;
+
+
+static char threaded = false;
+
+// signaled when blocks are pushed, or thread should stop
+static BinarySemaphore bytesAvailable;
+
+static std::atomic<char> stopThread( false );
+
+
+
+// state below is only touched by receive thread
+// (or by main thread, if not threaded)
+
+static int receiveGeneration = 0;
+
+static SimpleVector<unsigned char> buffer;
+
+// bytes before this in buffer have been used
+static int bufferStart = 0;
+
+// no # before this in buffer
+static int scanStart = 0;
+
+
+// waiting for compressed body of MC or MB message
+static char mapChunkPending = false;
+static ServerMessage pendingMapChunk;
+static int pendingMapChunkCompressedSize = 0;
+
+// waiting for compressed body of CM message
+static char compressedMessagePending = false;
+static int pendingCMCompressedSize = 0;
+static int pendingCMDecompressedSize = 0;
+
+
+// true after ACCEPTED
+static char framing = false;
+
+static ServerFrame *currentFrame = NULL;
+
+
+
+static void clearReceiveState() {
+    buffer.deleteAll();
+    bufferStart = 0;
+    scanStart = 0;
+
+    if( mapChunkPending ) {
+        delete [] pendingMapChunk.text;
+        mapChunkPending = false;
+        }
+
+    compressedMessagePending = false;
+
+    framing = false;
+
+    if( currentFrame != NULL ) {
+        freeServerFrame( currentFrame );
+        currentFrame = NULL;
+        }
+    }
+
+
+
+static void sendFrame( ServerFrame *inFrame ) {
+    GenerationFrame f = { inFrame, receiveGeneration };
+
+    if( ! threaded ) {
+        inlineFrames.push_back( f );
+        return;
+        }
+
+    while( ! frameQueue->push( f ) ) {
+        if( stopThread ) {
+            freeServerFrame( inFrame );
+            return;
+            }
+        // wait for main thread to catch up
+        Thread::staticSleep( 1 );
+        }
+    }
+
+
+
+static void sendMessageAlone( ServerMessage inMessage ) {
+    ServerFrame *frame = new ServerFrame;
+    frame->messages.push_back( inMessage );
+    sendFrame( frame );
+    }
+
+
+
+static void handleMessage( ServerMessage inMessage ) {
+    if( ! framing ) {
+        sendMessageAlone( inMessage );
+
+        if( inMessage.type == ACCEPTED ) {
+            // subsequent messages should all be part of FRAME batches
+            framing = true;
+            }
+        return;
+        }
+
+    if( strstr( inMessage.text, "FM" ) == inMessage.text ) {
+        // end of frame, discard the marker message
+        delete [] inMessage.text;
+
+        if( currentFrame != NULL ) {
+            sendFrame( currentFrame );
+            currentFrame = NULL;
+            }
+        return;
+        }
+
+    if( inMessage.type == MAP_CHUNK ||
+        inMessage.type == PONG ||
+        inMessage.type == FLIGHT_DEST ||
+        inMessage.type == PHOTO_SIGNATURE ) {
+        // map chunks cannot wait for the rest of their frame
+
+        // PONG messages should be returned instantly
+
+        // FLIGHT_DEST messages also should be returned instantly
+        // otherwise, they will be queued and seen by
+        // the client after the corresponding MC message
+        // for the new location.
+        // which will invalidate the map around player's old
+        // location
+        sendMessageAlone( inMessage );
+        return;
+        }
+
+    // some other message in the middle of the frame
+    // keep it
+    if( currentFrame == NULL ) {
+        currentFrame = new ServerFrame;
+        }
+    currentFrame->messages.push_back( inMessage );
+    }
+
+
+
+// NULL if decompression fails
+static unsigned char *decompressFromBuffer( int inCompressedSize,
+                                            int inDecompressedSize ) {
+    unsigned char *result =
+        zipDecompress( buffer.getElement( bufferStart ),
+                       inCompressedSize,
+                       inDecompressedSize );
+
+    bufferStart += inCompressedSize;
+    scanStart = bufferStart;
+
+    return result;
+    }
+
+
+
+static void parseBuffer() {
+
+    while( true ) {
+        int numAvailable = buffer.size() - bufferStart;
+
+        if( mapChunkPending ) {
+            // wait for full binary data chunk to arrive completely
+            // after message before we report that the message is ready
+            if( numAvailable < pendingMapChunkCompressedSize ) {
+                break;
+                }
+
+            mapChunkPending = false;
+
+            pendingMapChunk.body =
+                decompressFromBuffer( pendingMapChunkCompressedSize,
+                                      pendingMapChunk.bodyLength );
+
+            handleMessage( pendingMapChunk );
+            continue;
+            }
+
+        if( compressedMessagePending ) {
+            if( numAvailable < pendingCMCompressedSize ) {
+                break;
+                }
+
+            compressedMessagePending = false;
+
+            unsigned char *decompressedMessage =
+                decompressFromBuffer( pendingCMCompressedSize,
+                                      pendingCMDecompressedSize );
+
+            if( decompressedMessage == NULL ) {
+                printf( "Decompressing CM message failed\n" );
+                continue;
+                }
+
+            ServerMessage m;
+            m.text = new char[ pendingCMDecompressedSize + 1 ];
+            memcpy( m.text, decompressedMessage, pendingCMDecompressedSize );
+            m.text[ pendingCMDecompressedSize ] = '\0';
+
+            delete [] decompressedMessage;
+
+            m.type = getMessageType( m.text );
+            m.body = NULL;
+            m.bodyLength = 0;
+
+            handleMessage( m );
+            continue;
+            }
+
+
+        // find first terminal character #
+
+        if( scanStart >= buffer.size() ) {
+            break;
+            }
+
+        unsigned char *start = buffer.getElement( scanStart );
+        unsigned char *terminal =
+            (unsigned char*)memchr( start, '#', buffer.size() - scanStart );
+
+        if( terminal == NULL ) {
+            scanStart = buffer.size();
+            break;
+            }
+
+        int index = scanStart + ( terminal - start );
+        int length = index - bufferStart;
+
+        ServerMessage m;
+        m.text = new char[ length + 1 ];
+        memcpy( m.text, buffer.getElement( bufferStart ), length );
+        m.text[ length ] = '\0';
+
+        m.type = getMessageType( m.text );
+        m.body = NULL;
+        m.bodyLength = 0;
+
+        // skip message and terminal character
+        bufferStart = index + 1;
+        scanStart = bufferStart;
+
+
+        if( m.type == MAP_CHUNK ) {
+            int sizeX, sizeY, x, y;
+
+            m.bodyLength = 0;
+            pendingMapChunkCompressedSize = 0;
+
+            // MC or MB
+            sscanf( m.text, "M%*c\n%d %d %d %d\n%d %d\n",
+                    &sizeX, &sizeY,
+                    &x, &y, &( m.bodyLength ),
+                    &pendingMapChunkCompressedSize );
+
+            pendingMapChunk = m;
+            mapChunkPending = true;
+            }
+        else if( m.type == COMPRESSED_MESSAGE ) {
+            printf( "Got compressed message header:\n%s\n\n", m.text );
+
+            pendingCMDecompressedSize = 0;
+            pendingCMCompressedSize = 0;
+
+            sscanf( m.text, "CM\n%d %d\n",
+                    &pendingCMDecompressedSize, &pendingCMCompressedSize );
+
+            delete [] m.text;
+
+            compressedMessagePending = true;
+            }
+        else {
+            handleMessage( m );
+            }
+        }
+
+
+    // drop used bytes once they are at least half of buffer
+    // so each byte is moved only a few times
+    if( bufferStart > 0 && bufferStart >= buffer.size() / 2 ) {
+        buffer.deleteStartElements( bufferStart );
+        scanStart -= bufferStart;
+        bufferStart = 0;
+        }
+    }
+
+
+
+static void handleBlock( ByteBlock *inBlock ) {
+    if( inBlock->data == NULL ) {
+        clearReceiveState();
+        receiveGeneration = inBlock->generation;
+        }
+    else {
+        buffer.appendArray( inBlock->data, inBlock->length );
+        parseBuffer();
+
+        delete [] inBlock->data;
+        }
+
+    delete inBlock;
+    }
+
+
+
+class ServerReceiverThread : public Thread {
+    public:
+
+        ServerReceiverThread() {
+            start();
+            }
+
+        virtual void run() {
+            while( true ) {
+                ByteBlock *block;
+
+                if( byteQueue->pop( &block ) ) {
+                    handleBlock( block );
+                    continue;
+                    }
+
+                if( stopThread ) {
+                    return;
+                    }
+
+                bytesAvailable.wait();
+                }
+            }
+    };
+
+
+
+static ServerReceiverThread *receiverThread = NULL;
+
+
+
+void initServerReceiver( char inThreaded ) {
+    byteQueue = new SPSCQueue<ByteBlock*>( 1024 );
+    frameQueue = new SPSCQueue<GenerationFrame>( 1024 );
+
+    mainGeneration = 0;
+    receiveGeneration = 0;
+
+    threaded = inThreaded;
+
+    if( threaded ) {
+        stopThread = false;
+        receiverThread = new ServerReceiverThread();
+        }
+    }
+
+
+
+void freeServerReceiver() {
+    if( receiverThread != NULL ) {
+        stopThread = true;
+        bytesAvailable.signal();
+
+        receiverThread->join();
+        delete receiverThread;
+        receiverThread = NULL;
+        }
+
+    for( int i=0; i<unqueuedBlocks.size(); i++ ) {
+        ByteBlock *b = unqueuedBlocks.getElementDirect( i );
+        if( b->data != NULL ) {
+            delete [] b->data;
+            }
+        delete b;
+        }
+    unqueuedBlocks.deleteAll();
+
+    if( byteQueue != NULL ) {
+        ByteBlock *b;
+        while( byteQueue->pop( &b ) ) {
+            if( b->data != NULL ) {
+                delete [] b->data;
+                }
+            delete b;
+            }
+        delete byteQueue;
+        byteQueue = NULL;
+        }
+
+    if( frameQueue != NULL ) {
+        GenerationFrame f;
+        while( frameQueue->pop( &f ) ) {
+            freeServerFrame( f.frame );
+            }
+        delete frameQueue;
+        frameQueue = NULL;
+        }
+
+    for( int i=0; i<inlineFrames.size(); i++ ) {
+        freeServerFrame( inlineFrames.getElementDirect( i ).frame );
+        }
+    inlineFrames.deleteAll();
+
+    clearReceiveState();
+    }
+
+
+
+// pushes blocks that didn't fit in byteQueue before
+static void pushUnqueuedBlocks() {
+    int numPushed = 0;
+
+    while( numPushed < unqueuedBlocks.size() &&
+           byteQueue->push( unqueuedBlocks.getElementDirect( numPushed ) ) ) {
+        numPushed++;
+        }
+
+    unqueuedBlocks.deleteStartElements( numPushed );
+
+    if( numPushed > 0 ) {
+        bytesAvailable.signal();
+        }
+    }
+
+
+
+static void addBlock( ByteBlock *inBlock ) {
+    if( ! threaded ) {
+        handleBlock( inBlock );
+        return;
+        }
+
+    // keep blocks in order behind any that didn't fit before
+    unqueuedBlocks.push_back( inBlock );
+
+    pushUnqueuedBlocks();
+    }
+
+
+
+void resetServerReceiver() {
+    mainGeneration++;
+
+    ByteBlock *b = new ByteBlock;
+    b->data = NULL;
+    b->length = 0;
+    b->generation = mainGeneration;
+
+    // frames made before this are dropped in getNextServerFrame
+    addBlock( b );
+    }
+
+
+
+void addServerBytes( unsigned char *inBytes, int inLength ) {
+    if( inLength <= 0 ) {
+        return;
+        }
+
+    ByteBlock *b = new ByteBlock;
+    b->data = new unsigned char[ inLength ];
+    memcpy( b->data, inBytes, inLength );
+    b->length = inLength;
+    b->generation = mainGeneration;
+
+    addBlock( b );
+    }
+
+
+
+ServerFrame *getNextServerFrame() {
+    if( unqueuedBlocks.size() > 0 ) {
+        pushUnqueuedBlocks();
+        }
+
+    GenerationFrame f;
+
+    while( true ) {
+        if( inlineFrames.size() > 0 ) {
+            f = inlineFrames.getElementDirect( 0 );
+            inlineFrames.deleteElement( 0 );
+            }
+        else if( ! frameQueue->pop( &f ) ) {
+            return NULL;
+            }
+
+        if( f.generation == mainGeneration ) {
+            return f.frame;
+            }
+        // made before last reset
+        freeServerFrame( f.frame );
+        }
+    }
+
+
+
+void freeServerFrame( ServerFrame *inFrame ) {
+    for( int i=0; i<inFrame->messages.size(); i++ ) {
+        ServerMessage *m = inFrame->messages.getElement( i );
+
+        if( m->text != NULL ) {
+            delete [] m->text;
+            }
+        if( m->body != NULL ) {
+            delete [] m->body;
+            }
+        }
+
+    delete inFrame;
+    }
@@ -0,0 +1,136 @@
+#ifndef SERVER_RECEIVER_H_INCLUDED
+#define SERVER_RECEIVER_H_INCLUDED
+
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// Turns data from the server socket into messages, on a thread of its own.
+//
+// The main thread still reads the socket, because socket calls go through
+// the game recording layer, which is not thread-safe.  It hands the raw
+// bytes over, and the receive thread finds message boundaries, picks up the
+// compressed bodies that follow MC, MB, and CM headers, decompresses them,
+// and classifies each message.
+//
+// Once the server has ACCEPTED us, messages are grouped into frames that
+// end with FM, and a frame is only passed back once it is complete.
+// Finished frames come back through a lock-free queue.
+
+
+typedef enum messageType {
+    SHUTDOWN,
+    SERVER_FULL,
+    SEQUENCE_NUMBER,
+    ACCEPTED,
+    NO_LIFE_TOKENS,
+    REJECTED,
+    MAP_CHUNK,
+    MAP_CHANGE,
+    PLAYER_UPDATE,
+    PLAYER_MOVES_START,
+    PLAYER_OUT_OF_RANGE,
+    BABY_WIGGLE,
+    PLAYER_SAYS,
+    LOCATION_SAYS,
+    PLAYER_EMOT,
+    FOOD_CHANGE,
+    HEAT_CHANGE,
+    LINEAGE,
+    CURSED,
+    CURSE_TOKEN_CHANGE,
+    CURSE_SCORE,
+    NAMES,
+    APOCALYPSE,
+    APOCALYPSE_DONE,
+    DYING,
+    HEALED,
+    POSSE_JOIN,
+    MONUMENT_CALL,
+    GRAVE,
+    GRAVE_MOVE,
+    GRAVE_OLD,
+    OWNER,
+    FOLLOWING,
+    EXILED,
+    VALLEY_SPACING,
+    FLIGHT_DEST,
+    BAD_BIOMES,
+    VOG_UPDATE,
+    PHOTO_SIGNATURE,
+    FORCED_SHUTDOWN,
+    GLOBAL_MESSAGE,
+    WAR_REPORT,
+    LEARNED_TOOL_REPORT,
+    TOOL_EXPERTS,
+    TOOL_SLOTS,
+    HOMELAND,
+    FLIP,
+    CRAVING,
+    GHOST,
+    ROCKET_RIDE,
+    ROCKET_ACCOUNT,
+    PONG,
+    COMPRESSED_MESSAGE,
+    UNKNOWN
+    } messageType;
+
+
+// type from first line of message
+messageType getMessageType( const char *inMessage );
+
+
+
+typedef struct ServerMessage {
+        messageType type;
+
+        // without terminating #
+        // for a CM message, the decompressed message
+        char *text;
+
+        // decompressed body that followed an MC or MB header
+        // NULL if decompression failed, or not a map chunk
+        unsigned char *body;
+        int bodyLength;
+    } ServerMessage;
+
+
+
+typedef struct ServerFrame {
+        SimpleVector<ServerMessage> messages;
+    } ServerFrame;
+
+
+
+// if inThreaded is false, bytes are handled right away in addServerBytes
+void initServerReceiver( char inThreaded );
+
+void freeServerReceiver();
+
+
+// drops buffered bytes and frames that haven't been taken yet,
+// and goes back to passing messages on one at a time until next ACCEPTED
+void resetServerReceiver();
+
+
+// bytes are copied
+void addServerBytes( unsigned char *inBytes, int inLength );
+
+
+// returns next complete frame, or NULL
+//
+// messages that must be handled right away (map chunks, PONG, FD, PH)
+// come in frames of their own, ahead of the rest of the frame they were
+// sent in
+//
+// caller can take text and body out of messages, setting them to NULL
+ServerFrame *getNextServerFrame();
+
+
+// destroys any text and bodies still in frame
+void freeServerFrame( ServerFrame *inFrame );
+
+
+
+#endif
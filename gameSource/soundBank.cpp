@@ -7,6 +7,8 @@
 #include <stdlib.h>
 #include <math.h>
 
+#include <thread>
+
 #include "minorGems/util/SettingsManager.h"
 
 #include "minorGems/util/SimpleVector.h"
@@ -19,6 +21,9 @@
 #include "minorGems/sound/formats/aiff.h"
 
 #include "minorGems/system/Time.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/BinarySemaphore.h"
 
 #include "minorGems/util/crc32.h"
 
@@ -221,15 +226,18 @@ static char printSteps = false;
 #include "convolution.h"
 
 
-MultiConvolution reverbConvolution = { -1, -1, NULL };
-MultiConvolution eqConvolution = { -1, -1, NULL };
+PartitionedConvolution reverbConvolution = { -1 };
+PartitionedConvolution eqConvolution = { -1 };
 
 
-static int16_t *generateWetConvolve( MultiConvolution inMulti, int inNumSamples,
+// inScratch can be NULL
+static int16_t *generateWetConvolve( PartitionedConvolution *inConvolution,
+                                     ConvolutionScratch *inScratch,
+                                     int inNumSamples,
                                      int16_t *inSamples, 
                                      int *outNumWetSamples ) {
 
-    if( inMulti.savedNumSamplesB <= 0 ) {
+    if( inConvolution->numSamplesB <= 0 ) {
         // no covolution impulse response loaded
         // can't convolve
         // just return copy of dry samples
@@ -244,25 +252,31 @@ static int16_t *generateWetConvolve( MultiConvolution inMulti, int inNumSamples,
         }
     
 
-    int numWetSamples = inNumSamples + inMulti.savedNumSamplesB;
+    int numWetSamples = inNumSamples + inConvolution->numSamplesB;
             
-    double *wetSampleFloats = new double[ numWetSamples ];
+    float *wetSampleFloats = new float[ numWetSamples ];
     
-    for( int i=0; i<numWetSamples; i++ ) {
-        wetSampleFloats[i] = 0;
-        }
-            
-            
 
-    double *sampleFloats = new double[ inNumSamples ];
+    float *sampleFloats = new float[ inNumSamples ];
     
     for( int i=0; i<inNumSamples; i++ ) {
-        sampleFloats[i] = (double) inSamples[i] / 32768.0;
+        sampleFloats[i] = (float) inSamples[i] / 32768.0f;
         }
     
-    // b data has been pre-generated with startMultiConvolution
-    multiConvolve( inMulti, sampleFloats, inNumSamples,
-                   wetSampleFloats );
+    ConvolutionScratch *scratch = inScratch;
+    
+    if( scratch == NULL ) {
+        scratch = newConvolutionScratch( inConvolution );
+        }
+
+    // b data has been pre-generated with startPartitionedConvolution
+    partitionedConvolve( inConvolution, scratch, 
+                         sampleFloats, inNumSamples,
+                         wetSampleFloats );
+    
+    if( inScratch == NULL ) {
+        deleteConvolutionScratch( scratch );
+        }
 
     delete [] sampleFloats;
 
@@ -299,8 +313,10 @@ static int16_t *generateWetConvolve( MultiConvolution inMulti, int inNumSamples,
 
 
 
+// inScratch can be NULL
 static void generateReverb( SoundRecord *inRecord,
-                            File *inReverbFolder ) {
+                            File *inReverbFolder,
+                            ConvolutionScratch *inScratch ) {
     
     char *cacheFileName = autoSprintf( "%d.aiff", inRecord->id );
     
@@ -331,7 +347,8 @@ static void generateReverb( SoundRecord *inRecord,
             
             int numWetSamples;
             
-            int16_t *wetSamples = generateWetConvolve( reverbConvolution,
+            int16_t *wetSamples = generateWetConvolve( &reverbConvolution,
+                                                       inScratch,
                                                        numSamples,
                                                        samples,
                                                        &numWetSamples );
@@ -367,6 +384,90 @@ static SimpleVector<int> reverbsToRegenerate;
 static int nextReverbToRegenerate = 0;
 static File *reverbFolder;
 
+
+
+// reverbs are regenerated by worker threads, each with its own
+// convolution scratch, sharing reverbConvolution
+//
+// workers take IDs from reverbsToRegenerate in order, and
+// initSoundBankStep waits for one more to finish each time it is called,
+// so progress still moves one reverb per step
+
+static int numReverbThreads = 0;
+
+static MutexLock reverbLock;
+
+// guarded by reverbLock
+static int nextReverbToClaim = 0;
+static int numReverbsFinished = 0;
+static char stopReverbWorkers = false;
+
+static BinarySemaphore reverbFinishedSemaphore;
+
+
+
+class ReverbThread : public Thread {
+    public:
+        
+        ReverbThread() {
+            start();
+            }
+        
+        virtual void run() {
+            ConvolutionScratch *scratch = 
+                newConvolutionScratch( &reverbConvolution );
+            
+            while( true ) {
+                reverbLock.lock();
+                
+                if( stopReverbWorkers ||
+                    nextReverbToClaim >= reverbsToRegenerate.size() ) {
+                    reverbLock.unlock();
+                    break;
+                    }
+                
+                int id = reverbsToRegenerate.getElementDirect( 
+                    nextReverbToClaim );
+                nextReverbToClaim++;
+                
+                reverbLock.unlock();
+                
+                
+                generateReverb( getSoundRecord( id ), reverbFolder, 
+                                scratch );
+                
+                
+                reverbLock.lock();
+                numReverbsFinished++;
+                reverbLock.unlock();
+                
+                reverbFinishedSemaphore.signal();
+                }
+            
+            deleteConvolutionScratch( scratch );
+            }
+    };
+
+
+
+static SimpleVector<ReverbThread*> reverbWorkers;
+
+
+
+// waits for workers to finish reverbs that they've already started
+static void stopReverbThreads() {
+    reverbLock.lock();
+    stopReverbWorkers = true;
+    reverbLock.unlock();
+    
+    for( int i=0; i<reverbWorkers.size(); i++ ) {
+        ReverbThread *t = reverbWorkers.getElementDirect( i );
+        t->join();
+        delete t;
+        }
+    reverbWorkers.deleteAll();
+    }
+
 static int currentSoundFile = 0;
 static int currentReverbFile = 0;
 
@@ -378,11 +479,31 @@ SimpleVector<SoundRecord*> records;
 
 
 
+int getReverbThreadsSetting() {
+    int numThreads = std::thread::hardware_concurrency();
+    
+    if( numThreads <= 0 ) {
+        // count not available on this platform
+        numThreads = 4;
+        }
+    
+    return SettingsManager::getIntSetting( "reverbThreads", numThreads );
+    }
+
+
+
 int initSoundBankStart( char *outRebuildingCache,
-                        char inComputeSoundHashes ) {
+                        char inComputeSoundHashes,
+                        int inNumReverbThreads ) {
     
     doComputeSoundHashes = inComputeSoundHashes;
 
+    numReverbThreads = inNumReverbThreads;
+    
+    nextReverbToClaim = 0;
+    numReverbsFinished = 0;
+    stopReverbWorkers = false;
+
     //printSteps = inPrintSteps;
     
     
@@ -420,13 +541,14 @@ int initSoundBankStart( char *outRebuildingCache,
         int16_t *eqSamples = readAIFFFile( &eqFile, &numEqSamples );
             
         if( eqSamples != NULL ) {        
-            double *eqFloats = new double[ numEqSamples ];
+            float *eqFloats = new float[ numEqSamples ];
             
             for( int j=0; j<numEqSamples; j++ ) {
-                eqFloats[j] = (double) eqSamples[j] / 32768.0;
+                eqFloats[j] = (float) eqSamples[j] / 32768.0f;
                 }
                 
-            eqConvolution = startMultiConvolution( eqFloats, numEqSamples );
+            eqConvolution = 
+                startPartitionedConvolution( eqFloats, numEqSamples );
                 
             delete [] eqFloats;
             delete [] eqSamples;
@@ -454,14 +576,15 @@ int initSoundBankStart( char *outRebuildingCache,
                                                    &numReverbSamples );
             
             if( reverbSamples != NULL ) {        
-                double *reverbFloats = new double[ numReverbSamples ];
+                float *reverbFloats = new float[ numReverbSamples ];
             
                 for( int j=0; j<numReverbSamples; j++ ) {
-                    reverbFloats[j] = (double) reverbSamples[j] / 32768.0;
+                    reverbFloats[j] = (float) reverbSamples[j] / 32768.0f;
                     }
                 
                 reverbConvolution = 
-                    startMultiConvolution( reverbFloats, numReverbSamples );
+                    startPartitionedConvolution( reverbFloats, 
+                                                 numReverbSamples );
                 
                 delete [] reverbFloats;
 
@@ -765,15 +888,39 @@ float initSoundBankStep() {
         }
     else if( nextReverbToRegenerate < reverbsToRegenerate.size() ) {
 
-        int id = reverbsToRegenerate.getElementDirect( nextReverbToRegenerate );
+        if( numReverbThreads <= 0 ) {
+            int id = 
+                reverbsToRegenerate.getElementDirect( nextReverbToRegenerate );
     
-        generateReverb( getSoundRecord( id ), reverbFolder );
+            generateReverb( getSoundRecord( id ), reverbFolder, NULL );
+            }
+        else {
+            if( reverbWorkers.size() == 0 && nextReverbToRegenerate == 0 ) {
+                for( int i=0; i<numReverbThreads; i++ ) {
+                    reverbWorkers.push_back( new ReverbThread() );
+                    }
+                }
+            
+            // wait for one more to finish
+            reverbLock.lock();
+            
+            while( numReverbsFinished <= nextReverbToRegenerate ) {
+                reverbLock.unlock();
+                reverbFinishedSemaphore.wait();
+                reverbLock.lock();
+                }
+            
+            reverbLock.unlock();
+            }
 
         nextReverbToRegenerate++;
         
         if( nextReverbToRegenerate == reverbsToRegenerate.size() ) {
             // done regenning reverbs, and there were some
 
+            // workers are out of work by now
+            stopReverbThreads();
+
             // rebuild cache of reverb sounds from scratch            
             clearReverbCacheFile();
             freeBinFolderCache( reverbCache );
@@ -950,12 +1097,15 @@ void freeSoundBank() {
         delete [] loadingFailureFileName;
         }
 
-    if( reverbConvolution.savedNumWindowsB != -1 ) {
+    // in case we quit during loading
+    stopReverbThreads();
+
+    if( reverbConvolution.numSamplesB != -1 ) {
         // doneApplyingReverb was never called?
-        endMultiConvolution( &reverbConvolution );
+        endPartitionedConvolution( &reverbConvolution );
         }
     
-    endMultiConvolution( &eqConvolution );
+    endPartitionedConvolution( &eqConvolution );
 
     for( int i=0; i<mapSize; i++ ) {
         if( idMap[i] != NULL ) {
@@ -1735,7 +1885,7 @@ int stopRecordingSound() {
         int numWet = 0;
 
         int16_t *wetSamples = 
-            generateWetConvolve( eqConvolution, finalNumSamples,
+            generateWetConvolve( &eqConvolution, NULL, finalNumSamples,
                                  &( samples[ finalStartPoint ] ), 
                                  &numWet );
         
@@ -2088,11 +2238,12 @@ int addSoundToBank( int inNumSoundFileBytes,
     
     r->reverbSound = NULL;
 
-    if( reverbConvolution.savedNumWindowsB != -1 ) {
+    if( reverbConvolution.numSamplesB != -1 ) {
         // convolution exists, apply it
         int numWetSamples;
             
-        int16_t *wetSamples = generateWetConvolve( reverbConvolution,
+        int16_t *wetSamples = generateWetConvolve( &reverbConvolution,
+                                                   NULL,
                                                    numSamples,
                                                    samples,
                                                    &numWetSamples );
@@ -2172,6 +2323,6 @@ int addSoundToBank( int inNumSoundFileBytes,
 
 
 void doneApplyingReverb() {
-    endMultiConvolution( &reverbConvolution );
+    endPartitionedConvolution( &reverbConvolution );
     }
 
@@ -40,8 +40,16 @@ typedef struct SoundRecord {
 
 
 // returns number of sounds that need to be loaded (or reverbs regenerated)
+//
+// missing reverbs are regenerated on inNumReverbThreads worker threads
+// (or inline in initSoundBankStep, if 0)
 int initSoundBankStart( char *outRebuildingCache,
-                        char inComputeSoundHashes = false );
+                        char inComputeSoundHashes = false,
+                        int inNumReverbThreads = 0 );
+
+
+// reverbThreads setting, or one thread per hardware thread if not set
+int getReverbThreadsSetting();
 
 
 // returns progress... ready for Finish when progress == 1.0
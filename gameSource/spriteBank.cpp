@@ -23,6 +23,7 @@
 #include "binFolderCache.h"
 
 #include "authorship.h"
+#include "spriteDecoder.h"
 
 
 
@@ -80,6 +81,22 @@ static char *loadingFailureFileName = NULL;
 
 
 
+// sprites decoding on worker threads during init, in bin cache order
+typedef struct PendingSpriteDecode {
+        SpriteDecodeJob *job;
+        
+        // owned by us, freed once job finished
+        unsigned char *tgaData;
+        int tgaDataLength;
+    } PendingSpriteDecode;
+
+static SimpleVector<PendingSpriteDecode> pendingDecodes;
+
+// keep workers busy, without holding too many undecoded files in RAM
+static int maxPendingDecodes = 8;
+
+
+
 
 int getMaxSpriteID() {
     return maxID;
@@ -108,9 +125,14 @@ static char shouldFileBeCached( char *inFileName ) {
 
 
 int initSpriteBankStart( char *outRebuildingCache, 
-                         char inComputeSpriteHashes ) {
+                         char inComputeSpriteHashes,
+                         int inNumDecodeThreads ) {
     doComputeSpriteHashes = inComputeSpriteHashes;
     
+    initSpriteDecoder( inNumDecodeThreads );
+    
+    maxPendingDecodes = 4 * inNumDecodeThreads + 8;
+    
     maxID = 0;
     
     currentFile = 0;
@@ -145,35 +167,6 @@ int initSpriteBankStart( char *outRebuildingCache,
 
 
 
-// expands true regions by making neighbor pixels true also
-void expandMap( char *inMap, int inW, int inH ) {
-    int numPixels = inW * inH;
-    
-    char *copy = new char[ numPixels ];
-    
-    memcpy( copy, inMap, numPixels );
-    
-    // avoid edges
-    for( int y = 1; y < inH-1; y++ ) {
-        for( int x = 1; x < inW-1; x++ ) {
-            int index = y * inW + x;
-            
-            if( copy[index] ) {
-                // make neighbors true also
-
-                inMap[index-1] = true;
-                inMap[index+1] = true;
-
-                inMap[index-inW] = true;
-                inMap[index+inW] = true;                
-                }
-            }
-        }
-    
-    delete [] copy;
-    }
-
-
 static void setLoadingFailureFileName( char *inNewFileName ) {
     if( loadingFailureFileName != NULL ) {
         delete [] loadingFailureFileName;
@@ -184,25 +177,25 @@ static void setLoadingFailureFileName( char *inNewFileName ) {
 
 
 
-static void loadSpriteFromRawTGAData( int inSpriteID, unsigned char *inTGAData,
-                                      int inDataLength ) {
+// applies decoded image data to sprite's record
+// must be called on GL thread
+// consumes image and hitMap in inDecoded
+static void applyDecodedSprite( DecodedSprite *inDecoded ) {
+    int spriteID = inDecoded->spriteID;
     
-    RawRGBAImage *spriteImage = readTGAFileRawFromBuffer( inTGAData, 
-                                                          inDataLength);
-
-    if( spriteImage != NULL && spriteImage->mNumChannels != 4 ) {
+    if( inDecoded->wrongChannels ) {
         printf( "Sprite loading for id %d not a 4-channel image, "
                 "failed to load.\n",
-                inSpriteID );
-        delete spriteImage;
-        spriteImage = NULL;
+                spriteID );
         
         setLoadingFailureFileName(
-            autoSprintf( "sprites/%d.tga", inSpriteID ) );
+            autoSprintf( "sprites/%d.tga", spriteID ) );
         }
-                            
+    
+    RawRGBAImage *spriteImage = inDecoded->image;
+    
     if( spriteImage != NULL ) {
-        SpriteRecord *r = getSpriteRecord( inSpriteID );
+        SpriteRecord *r = getSpriteRecord( spriteID );
                         
         r->sprite =
             fillSprite( spriteImage->mRGBABytes, 
@@ -224,58 +217,13 @@ static void loadSpriteFromRawTGAData( int inSpriteID, unsigned char *inTGAData,
             r->maxD = r->h;
             }        
         
-        int numPixels = r->w * r->h;
-        r->hitMap = new char[ numPixels ];
+        r->hitMap = inDecoded->hitMap;
         
-        memset( r->hitMap, 1, numPixels );
+        int minX = inDecoded->minX;
+        int maxX = inDecoded->maxX;
         
-                    
-        int numBytes = numPixels * 4;
-                    
-        unsigned char *bytes = spriteImage->mRGBABytes;
-                    
-        // track max/min x and y to compute average for center
-
-        int minX = r->w;
-        int maxX = 0;
-                    
-        int minY = r->h;
-        int maxY = 0;
-                    
-        int w = r->w;
-                    
-
-        // alpha is 4th byte
-        int p=0;
-        for( int b=3; b<numBytes; b+=4 ) {
-            if( bytes[b] < 64 ) {
-                r->hitMap[p] = 0;
-                }
-            else {
-                int y = p / w;
-                int x = p % w;
-
-                if( y < minY ) {
-                    minY = y;
-                    }
-                if( y > maxY ) {
-                    maxY = y;
-                    }
-
-                if( x < minX ) {
-                    minX = x;
-                    }
-                if( x > maxX ) {
-                    maxX = x;
-                    }
-                }
-                        
-            p++;
-            }
-                    
-        for( int e=0; e<3; e++ ) {    
-            expandMap( r->hitMap, r->w, r->h );
-            }
+        int minY = inDecoded->minY;
+        int maxY = inDecoded->maxY;
 
         r->centerXOffset = 
             ( maxX + minX ) / 2 - 
@@ -294,6 +242,21 @@ static void loadSpriteFromRawTGAData( int inSpriteID, unsigned char *inTGAData,
 
 
 
+static void loadSpriteFromRawTGAData( int inSpriteID, unsigned char *inTGAData,
+                                      int inDataLength ) {
+    
+    DecodedSprite decoded;
+    decoded.spriteID = inSpriteID;
+    decoded.tgaData = inTGAData;
+    decoded.tgaDataLength = inDataLength;
+    
+    decodeSprite( &decoded );
+    
+    applyDecodedSprite( &decoded );
+    }
+
+
+
 
 
 typedef struct LoadedSpritePlaceholder {
@@ -488,6 +451,29 @@ static void recomputeSpriteHash( SpriteRecord *inRecord ) {
 
 
 
+static void finishOldestSpriteDecode() {
+    PendingSpriteDecode d = pendingDecodes.getElementDirect( 0 );
+    pendingDecodes.deleteElement( 0 );
+    
+    DecodedSprite decoded = finishSpriteDecode( d.job );
+    
+    applyDecodedSprite( &decoded );
+    
+    SpriteRecord *r = getSpriteRecord( decoded.spriteID );
+    
+    r->numStepsUnused = 0;
+    loadedSprites.push_back( decoded.spriteID );
+    
+    
+    if( doComputeSpriteHashes ) {
+        recomputeSpriteHash( r, d.tgaDataLength, d.tgaData );
+        }
+    
+    delete [] d.tgaData;
+    }
+
+
+
 float initSpriteBankStep() {
     
     if( currentFile == cache.numFiles &&
@@ -692,24 +678,29 @@ float initSpriteBankStep() {
                     SpriteRecord *r = getSpriteRecord( spriteID );
                     
                     if( r != NULL ) {
-                        loadSpriteFromRawTGAData( 
-                            spriteID, contents, contSize );
-                    
-                        r->numStepsUnused = 0;
-                        loadedSprites.push_back( spriteID );
+                        PendingSpriteDecode d = {
+                            startSpriteDecode( spriteID, 
+                                               contents, contSize ),
+                            contents, contSize };
                         
-                        
-                        if( doComputeSpriteHashes ) {
-                            recomputeSpriteHash( r, contSize, contents );
-                            }
+                        pendingDecodes.push_back( d );
+                        }
+                    else {
+                        delete [] contents;
                         }
-                    
-                    delete [] contents;
                     }
                 }
             }
         delete [] fileName;
         currentBinFile++;
+        
+        // finish in the order we started, so loadedSprites order is
+        // same as when sprites were decoded one at a time
+        while( pendingDecodes.size() > 0 &&
+               ( pendingDecodes.size() > maxPendingDecodes ||
+                 currentBinFile == binCache.numFiles ) ) {
+            finishOldestSpriteDecode();
+            }
         }
     
     
@@ -725,6 +716,8 @@ static char spriteBankLoaded = false;
 
 void initSpriteBankFinish() {    
 
+    freeSpriteDecoder();
+    
     freeFolderCache( cache );
     freeBinFolderCache( binCache );
     
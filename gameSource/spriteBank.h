@@ -78,8 +78,12 @@ void enableSpriteSearch( char inEnable );
 
 
 // returns number of sprite metadata files that need to be loaded
+//
+// inNumDecodeThreads worker threads decode sprite images while loading
+// (0 to decode them on the calling thread)
 int initSpriteBankStart( char *outRebuildingCache,
-                         char inComputeSpriteHashes = false );
+                         char inComputeSpriteHashes = false,
+                         int inNumDecodeThreads = 0 );
 
 
 // returns progress... ready for Finish when progress == 1.0
@@ -0,0 +1,294 @@
+#include "spriteDecoder.h"
+
+#include "minorGems/game/gameGraphics.h"
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/BinarySemaphore.h"
+#include "minorGems/util/SimpleVector.h"
+
+#include <string.h>
+
+
+
+void expandMap( char *inMap, int inW, int inH ) {
+    int numPixels = inW * inH;
+    
+    char *copy = new char[ numPixels ];
+    
+    memcpy( copy, inMap, numPixels );
+    
+    // avoid edges
+    for( int y = 1; y < inH-1; y++ ) {
+        for( int x = 1; x < inW-1; x++ ) {
+            int index = y * inW + x;
+            
+            if( copy[index] ) {
+                // make neighbors true also
+
+                inMap[index-1] = true;
+                inMap[index+1] = true;
+
+                inMap[index-inW] = true;
+                inMap[index+inW] = true;                
+                }
+            }
+        }
+    
+    delete [] copy;
+    }
+
+
+
+void decodeSprite( DecodedSprite *ioSprite ) {
+    ioSprite->hitMap = NULL;
+    ioSprite->wrongChannels = false;
+    
+    ioSprite->image = readTGAFileRawFromBuffer( ioSprite->tgaData,
+                                                ioSprite->tgaDataLength );
+
+    if( ioSprite->image != NULL && ioSprite->image->mNumChannels != 4 ) {
+        delete ioSprite->image;
+        ioSprite->image = NULL;
+        ioSprite->wrongChannels = true;
+        }
+    
+    if( ioSprite->image == NULL ) {
+        return;
+        }
+    
+    int w = ioSprite->image->mWidth;
+    int h = ioSprite->image->mHeight;
+
+    int numPixels = w * h;
+
+    char *hitMap = new char[ numPixels ];
+        
+    memset( hitMap, 1, numPixels );
+        
+                    
+    int numBytes = numPixels * 4;
+                    
+    unsigned char *bytes = ioSprite->image->mRGBABytes;
+                    
+    // track max/min x and y to compute average for center
+
+    int minX = w;
+    int maxX = 0;
+    
+    int minY = h;
+    int maxY = 0;
+                    
+
+    // alpha is 4th byte
+    int p=0;
+    for( int b=3; b<numBytes; b+=4 ) {
+        if( bytes[b] < 64 ) {
+            hitMap[p] = 0;
+            }
+        else {
+            int y = p / w;
+            int x = p % w;
+
+            if( y < minY ) {
+                minY = y;
+                }
+            if( y > maxY ) {
+                maxY = y;
+                }
+
+            if( x < minX ) {
+                minX = x;
+                }
+            if( x > maxX ) {
+                maxX = x;
+                }
+            }
+                        
+        p++;
+        }
+                    
+    for( int e=0; e<3; e++ ) {    
+        expandMap( hitMap, w, h );
+        }
+    
+    ioSprite->hitMap = hitMap;
+    ioSprite->minX = minX;
+    ioSprite->maxX = maxX;
+    ioSprite->minY = minY;
+    ioSprite->maxY = maxY;
+    }
+
+
+
+struct SpriteDecodeJob {
+        DecodedSprite sprite;
+        
+        // set once a worker (or finishSpriteDecode) has taken job off queue
+        char claimed;
+        
+        // signaled by worker when sprite is decoded
+        BinarySemaphore doneSemaphore;
+    };
+
+
+
+static MutexLock queueLock;
+
+// signaled when jobs are queued
+// a binary semaphore can collapse several signals into one, so a worker
+// that wakes passes the signal on while jobs remain, and every worker
+// checks the queue before waiting again
+static BinarySemaphore jobsAvailable;
+
+static SimpleVector<SpriteDecodeJob*> jobQueue;
+
+static char stopWorkers = false;
+
+
+
+// pops next unclaimed job, or returns NULL
+// queueLock must be held
+static SpriteDecodeJob *claimNextJob() {
+    if( jobQueue.size() == 0 ) {
+        return NULL;
+        }
+    
+    SpriteDecodeJob *job = jobQueue.getElementDirect( 0 );
+    jobQueue.deleteElement( 0 );
+    
+    job->claimed = true;
+    
+    return job;
+    }
+
+
+
+class SpriteDecoderThread : public Thread {
+    public:
+        
+        SpriteDecoderThread() {
+            start();
+            }
+        
+        virtual void run() {
+            while( true ) {
+                queueLock.lock();
+                
+                if( stopWorkers ) {
+                    queueLock.unlock();
+                    
+                    // wake next worker so it can stop too
+                    jobsAvailable.signal();
+                    return;
+                    }
+                
+                SpriteDecodeJob *job = claimNextJob();
+                
+                char moreJobs = ( jobQueue.size() > 0 );
+                
+                queueLock.unlock();
+                
+                if( job == NULL ) {
+                    jobsAvailable.wait();
+                    continue;
+                    }
+                
+                if( moreJobs ) {
+                    jobsAvailable.signal();
+                    }
+                
+                decodeSprite( &( job->sprite ) );
+                    
+                job->doneSemaphore.signal();
+                }
+            }
+    };
+
+
+
+static SimpleVector<SpriteDecoderThread*> workers;
+
+
+
+void initSpriteDecoder( int inNumThreads ) {
+    stopWorkers = false;
+    
+    for( int i=0; i<inNumThreads; i++ ) {
+        workers.push_back( new SpriteDecoderThread() );
+        }
+    }
+
+
+
+void freeSpriteDecoder() {
+    queueLock.lock();
+    stopWorkers = true;
+    queueLock.unlock();
+    
+    jobsAvailable.signal();
+    
+    for( int i=0; i<workers.size(); i++ ) {
+        SpriteDecoderThread *t = workers.getElementDirect( i );
+        t->join();
+        delete t;
+        }
+    workers.deleteAll();
+    }
+
+
+
+SpriteDecodeJob *startSpriteDecode( int inSpriteID, 
+                                    unsigned char *inTGAData,
+                                    int inTGADataLength ) {
+    SpriteDecodeJob *job = new SpriteDecodeJob;
+    
+    job->sprite.spriteID = inSpriteID;
+    job->sprite.tgaData = inTGAData;
+    job->sprite.tgaDataLength = inTGADataLength;
+    job->sprite.image = NULL;
+    job->sprite.hitMap = NULL;
+    job->claimed = false;
+    
+    if( workers.size() > 0 ) {
+        queueLock.lock();
+        jobQueue.push_back( job );
+        queueLock.unlock();
+        
+        jobsAvailable.signal();
+        }
+    
+    return job;
+    }
+
+
+
+DecodedSprite finishSpriteDecode( SpriteDecodeJob *inJob ) {
+    
+    queueLock.lock();
+    
+    char claimedHere = false;
+    
+    if( ! inJob->claimed ) {
+        // still waiting in queue (or no workers), don't wait for it
+        jobQueue.deleteElementEqualTo( inJob );
+        inJob->claimed = true;
+        claimedHere = true;
+        }
+    
+    queueLock.unlock();
+    
+
+    if( claimedHere ) {
+        decodeSprite( &( inJob->sprite ) );
+        }
+    else {
+        inJob->doneSemaphore.wait();
+        }
+    
+    DecodedSprite result = inJob->sprite;
+    
+    delete inJob;
+    
+    return result;
+    }
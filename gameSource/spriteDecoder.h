@@ -0,0 +1,77 @@
+#ifndef SPRITE_DECODER_H_INCLUDED
+#define SPRITE_DECODER_H_INCLUDED
+
+
+#include <stdlib.h>
+
+#include "minorGems/graphics/RawRGBAImage.h"
+
+
+
+// Pool of worker threads that decode sprite TGA data and build hit maps
+// while the sprite bank loads.
+//
+// Decoding touches nothing but the job's own data, so many sprites can be
+// decoded in parallel while the main thread keeps reading the bin cache
+// and uploading finished sprites (which must happen on the GL thread).
+
+
+typedef struct DecodedSprite {
+        int spriteID;
+        
+        // TGA file contents, not touched by decodeSprite
+        unsigned char *tgaData;
+        int tgaDataLength;
+        
+        // NULL if data could not be read as a 4-channel TGA
+        RawRGBAImage *image;
+        
+        // true if data was a TGA, but not 4-channel
+        char wrongChannels;
+        
+        // image->mWidth * image->mHeight, true where sprite can be clicked
+        // NULL if image NULL
+        char *hitMap;
+        
+        // bounds of non-transparent pixels
+        int minX, maxX;
+        int minY, maxY;
+    } DecodedSprite;
+
+
+
+// fills in image, hitMap, and bounds from TGA data
+// thread-safe
+void decodeSprite( DecodedSprite *ioSprite );
+
+
+// expands true regions by making neighbor pixels true also
+void expandMap( char *inMap, int inW, int inH );
+
+
+
+typedef struct SpriteDecodeJob SpriteDecodeJob;
+
+
+// 0 threads means jobs are decoded inline in finishSpriteDecode
+void initSpriteDecoder( int inNumThreads );
+
+// waits for running jobs to finish
+// jobs that were never finished are leaked, so finish them all first
+void freeSpriteDecoder();
+
+
+// inTGAData stays owned by caller, and must live until job is finished
+SpriteDecodeJob *startSpriteDecode( int inSpriteID, 
+                                    unsigned char *inTGAData,
+                                    int inTGADataLength );
+
+
+// blocks until job is done, then destroys job
+// a job that no worker has picked up yet is decoded on the calling thread
+//
+// image and hitMap in result are destroyed by caller
+DecodedSprite finishSpriteDecode( SpriteDecodeJob *inJob );
+
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SPSC_QUEUE_H_INCLUDED
+#define SPSC_QUEUE_H_INCLUDED
+
+
+#include <atomic>
+
+
+
+// Fixed-size queue that one thread pushes to and one other thread pops
+// from, without locks.
+//
+// Each index is written by only one side.  Storing an index publishes the
+// slot that was filled (or emptied) before it.
+template <class Type>
+class SPSCQueue {
+    public:
+
+        // capacity is rounded up to a power of 2
+        SPSCQueue( int inCapacity = 256 );
+
+        ~SPSCQueue();
+
+
+        // call only from producer thread
+        // returns false if queue is full
+        char push( Type inItem );
+
+        // call only from consumer thread
+        // returns false if queue is empty
+        char pop( Type *outItem );
+
+
+    private:
+        Type *mSlots;
+        unsigned int mMask;
+
+        // next slot to pop, written by consumer
+        std::atomic<unsigned int> mHead;
+
+        // keep indices on separate cache lines
+        char mPad[64];
+
+        // next slot to push, written by producer
+        std::atomic<unsigned int> mTail;
+    };
+
+
+
+template <class Type>
+inline SPSCQueue<Type>::SPSCQueue( int inCapacity )
+        : mHead( 0 ), mTail( 0 ) {
+
+    unsigned int capacity = 1;
+    while( capacity < (unsigned int)inCapacity ) {
+        capacity *= 2;
+        }
+
+    mSlots = new Type[ capacity ];
+    mMask = capacity - 1;
+    }
+
+
+
+template <class Type>
+inline SPSCQueue<Type>::~SPSCQueue() {
+    delete [] mSlots;
+    }
+
+
+
+template <class Type>
+inline char SPSCQueue<Type>::push( Type inItem ) {
+    unsigned int tail = mTail.load( std::memory_order_relaxed );
+    unsigned int head = mHead.load( std::memory_order_acquire );
+
+    // indices wrap around, but their difference is still the item count
+    if( tail - head > mMask ) {
+        return false;
+        }
+
+    mSlots[ tail & mMask ] = inItem;
+
+    mTail.store( tail + 1, std::memory_order_release );
+    return true;
+    }
+
+
+
+template <class Type>
+inline char SPSCQueue<Type>::pop( Type *outItem ) {
+    unsigned int head = mHead.load( std::memory_order_relaxed );
+    unsigned int tail = mTail.load( std::memory_order_acquire );
+
+    if( head == tail ) {
+        return false;
+        }
+
+    *outItem = mSlots[ head & mMask ];
+
+    mHead.store( head + 1, std::memory_order_release );
+    return true;
+    }
+
+
+
+#endif
@@ -9,6 +9,7 @@
 
 
 #include "folderCache.h"
+#include "bankSnapshot.h"
 #include "objectBank.h"
 #include "categoryBank.h"
 
@@ -39,6 +40,15 @@ static SimpleVector<TransRecord *> *usesMap;
 static SimpleVector<TransRecord *> *producesMap;
 
 
+// open-addressing index of records by the getTrans key
+// (actor, target, lastUseActor, lastUseTarget), so that getTrans doesn't
+// need to scan the long usesMap vectors of things like fire and baskets
+// size is always a power of 2, and table is at most half full
+static TransRecord **transTable = NULL;
+static int transTableSize = 0;
+static int transTableCount = 0;
+
+
 static int depthMapSize = 0;
 static int *depthMap = NULL;
 
@@ -69,6 +79,176 @@ static char shouldFileBeCached( char *inFileName ) {
 
 
 
+// transition section of bank snapshot, holding the fully-initialized bank
+// (including auto-generated transitions, depth map, and human-made map)
+//
+// Layout:
+// numRecords, mapSize, depthMapSize, humanMadeMapSize ints
+// numRecords raw TransRecord structs (pointer fields ignored)
+// for each record, comment and authorTag as counted strings
+// depthMapSize ints
+// humanMadeMapSize chars
+
+static char loadedFromSnapshot = false;
+
+
+
+// section only valid for this combination of generation flags
+static uint32_t getTransSnapshotTag() {
+    return autoGenerateCategoryTransitions |
+        autoGenerateUsedObjectTransitions << 1 |
+        autoGenerateGenericUseTransitions << 2 |
+        autoGenerateVariableTransitions << 3;
+    }
+
+
+
+// on success, fills records, depth map, and human-made map
+static char readTransSnapshot() {
+    int length;
+    unsigned char *bytes = 
+        getBankSnapshotSection( snapshotTransitions, getTransSnapshotTag(),
+                                sizeof( TransRecord ), &length );
+    
+    if( bytes == NULL ) {
+        return false;
+        }
+
+    SnapshotReader reader = { bytes, bytes + length, false };
+    
+    int objectMapSize = getMaxObjectID() + 1;
+    
+    int numRecords = snapshotReadInt( &reader );
+    int newMapSize = snapshotReadInt( &reader );
+    int newDepthMapSize = snapshotReadInt( &reader );
+    int newHumanMadeMapSize = snapshotReadInt( &reader );
+
+    if( reader.failed ||
+        numRecords < 0 ||
+        newMapSize <= 0 ||
+        newDepthMapSize != objectMapSize ||
+        newHumanMadeMapSize != objectMapSize ||
+        (uint64_t)( reader.end - reader.next ) < 
+        (uint64_t)numRecords * sizeof( TransRecord ) ) {
+        return false;
+        }
+    
+    SimpleVector<TransRecord*> loaded;
+    
+    for( int i=0; i<numRecords; i++ ) {
+        TransRecord *r = new TransRecord;
+        
+        snapshotReadBytes( &reader, r, sizeof( TransRecord ) );
+        r->comment = NULL;
+        r->authorTag = NULL;
+        
+        loaded.push_back( r );
+        }
+    
+    for( int i=0; i<numRecords && ! reader.failed; i++ ) {
+        TransRecord *r = loaded.getElementDirect( i );
+        
+        r->comment = snapshotReadString( &reader );
+        r->authorTag = snapshotReadString( &reader );
+        
+        if( r->comment == NULL ) {
+            reader.failed = true;
+            }
+        
+        int ids[6] = { r->actor, r->target, r->newActor, r->newTarget,
+                       r->newActorNoChange, r->newTargetNoChange };
+        
+        for( int j=0; j<6; j++ ) {
+            if( ids[j] >= newMapSize ) {
+                reader.failed = true;
+                }
+            }
+        }
+    
+    int loadedDepthMapSize;
+    int *loadedDepthMap = 
+        snapshotReadArray<int>( &reader, &loadedDepthMapSize );
+    
+    int loadedHumanMadeMapSize;
+    char *loadedHumanMadeMap = 
+        snapshotReadArray<char>( &reader, &loadedHumanMadeMapSize );
+    
+    if( reader.failed || reader.next != reader.end ||
+        loadedDepthMap == NULL || loadedHumanMadeMap == NULL ||
+        loadedDepthMapSize != objectMapSize ||
+        loadedHumanMadeMapSize != objectMapSize ) {
+
+        for( int i=0; i<loaded.size(); i++ ) {
+            TransRecord *r = loaded.getElementDirect( i );
+            if( r->comment != NULL ) {
+                delete [] r->comment;
+                }
+            if( r->authorTag != NULL ) {
+                delete [] r->authorTag;
+                }
+            delete r;
+            }
+        if( loadedDepthMap != NULL ) {
+            delete [] loadedDepthMap;
+            }
+        if( loadedHumanMadeMap != NULL ) {
+            delete [] loadedHumanMadeMap;
+            }
+        return false;
+        }
+    
+    
+    for( int i=0; i<loaded.size(); i++ ) {
+        records.push_back( loaded.getElementDirect( i ) );
+        }
+    
+    // uses and produces maps rebuilt at their final size, which includes
+    // room added while generating transitions
+    maxID = newMapSize - 1;
+    
+
+    depthMapSize = objectMapSize;
+    depthMap = loadedDepthMap;
+    
+    humanMadeMapSize = objectMapSize;
+    humanMadeMap = loadedHumanMadeMap;
+    
+    return true;
+    }
+
+
+
+static void writeTransSnapshot() {
+    SimpleVector<unsigned char> data;
+    
+    snapshotPushInt( &data, records.size() );
+    snapshotPushInt( &data, mapSize );
+    snapshotPushInt( &data, depthMapSize );
+    snapshotPushInt( &data, humanMadeMapSize );
+    
+    for( int i=0; i<records.size(); i++ ) {
+        snapshotPushBytes( &data, records.getElementDirect( i ), 
+                           sizeof( TransRecord ) );
+        }
+    for( int i=0; i<records.size(); i++ ) {
+        TransRecord *r = records.getElementDirect( i );
+        
+        snapshotPushString( &data, r->comment );
+        snapshotPushString( &data, r->authorTag );
+        }
+
+    snapshotPushArray( &data, depthMap, depthMapSize );
+    snapshotPushArray( &data, humanMadeMap, humanMadeMapSize );
+    
+    setBankSnapshotSection( snapshotTransitions, getTransSnapshotTag(),
+                            sizeof( TransRecord ), &data );
+    }
+
+
+
+static FolderCache emptyCache = { NULL, 0, NULL, NULL, NULL };
+
+
 int initTransBankStart( char *outRebuildingCache,
                         char inAutoGenerateCategoryTransitions,
                         char inAutoGenerateUsedObjectTransitions,
@@ -84,6 +264,15 @@ int initTransBankStart( char *outRebuildingCache,
 
     currentFile = 0;
 
+    
+    loadedFromSnapshot = readTransSnapshot();
+    
+    if( loadedFromSnapshot ) {
+        // nothing left to parse
+        cache = emptyCache;
+        *outRebuildingCache = false;
+        return 0;
+        }
 
     cache = initFolderCache( "transitions", outRebuildingCache,
                              shouldFileBeCached );
@@ -312,6 +501,191 @@ static void handleWhatProbSetProduces( int inPossibleSetID,
 
 
 
+static unsigned int hashTransKey( int inActor, int inTarget,
+                                  char inLastUseActor, 
+                                  char inLastUseTarget ) {
+    unsigned int hash = (unsigned int)inActor * 0x9E3779B1U;
+    
+    hash = ( hash ^ (unsigned int)inTarget ) * 0x85EBCA77U;
+    hash = ( hash ^ ( ( inLastUseActor << 1 ) | inLastUseTarget ) ) * 
+        0xC2B2AE3DU;
+    
+    return hash ^ ( hash >> 16 );
+    }
+
+
+
+// true if getTrans can find inT
+// (matches where records are placed in usesMap)
+static char isTransIndexed( TransRecord *inT ) {
+    return inT->actor > 0 || 
+        ( inT->target >= 0 && inT->target != inT->actor );
+    }
+
+
+
+// returns slot holding matching record, or empty slot where it would go
+static int findTransSlot( int inActor, int inTarget,
+                          char inLastUseActor, char inLastUseTarget ) {
+    
+    unsigned int mask = (unsigned int)transTableSize - 1;
+    
+    unsigned int slot = 
+        hashTransKey( inActor, inTarget, 
+                      inLastUseActor, inLastUseTarget ) & mask;
+    
+    while( true ) {
+        TransRecord *r = transTable[ slot ];
+        
+        if( r == NULL ||
+            ( r->actor == inActor && r->target == inTarget &&
+              r->lastUseActor == inLastUseActor &&
+              r->lastUseTarget == inLastUseTarget ) ) {
+            return slot;
+            }
+        
+        slot = ( slot + 1 ) & mask;
+        }
+    }
+
+
+
+static void rebuildTransIndex();
+
+
+
+static void insertTransIndex( TransRecord *inT ) {
+    if( ! isTransIndexed( inT ) ) {
+        return;
+        }
+
+    if( transTable == NULL || 
+        ( transTableCount + 1 ) * 2 > transTableSize ) {
+        // rebuild includes inT, if it's already in records
+        rebuildTransIndex();
+        
+        if( transTable[ findTransSlot( inT->actor, inT->target,
+                                       inT->lastUseActor, 
+                                       inT->lastUseTarget ) ] != NULL ) {
+            return;
+            }
+        }
+    
+    int slot = findTransSlot( inT->actor, inT->target,
+                              inT->lastUseActor, inT->lastUseTarget );
+    
+    if( transTable[ slot ] == NULL ) {
+        transTable[ slot ] = inT;
+        transTableCount++;
+        }
+    // else an earlier record with same key, which getTrans has always
+    // returned first
+    }
+
+
+
+static void rebuildTransIndex() {
+    if( transTable != NULL ) {
+        delete [] transTable;
+        }
+    
+    transTableSize = 1024;
+    
+    while( transTableSize < records.size() * 4 ) {
+        transTableSize *= 2;
+        }
+    
+    transTable = new TransRecord*[ transTableSize ];
+    memset( transTable, 0, transTableSize * sizeof( TransRecord* ) );
+    transTableCount = 0;
+    
+    // in records order, so first of any duplicates is indexed, like 
+    // the usesMap vectors
+    for( int i=0; i<records.size(); i++ ) {
+        insertTransIndex( records.getElementDirect( i ) );
+        }
+    }
+
+
+
+// call after inT has been removed from usesMap
+static void removeTransIndex( TransRecord *inT ) {
+    if( transTable == NULL || ! isTransIndexed( inT ) ) {
+        return;
+        }
+    
+    unsigned int mask = (unsigned int)transTableSize - 1;
+
+    unsigned int hole = findTransSlot( inT->actor, inT->target,
+                                       inT->lastUseActor, 
+                                       inT->lastUseTarget );
+    
+    if( transTable[ hole ] != inT ) {
+        // shadowed by an earlier duplicate
+        return;
+        }
+    
+    // shift later records in this probe run back into hole, if
+    // their home slot allows it
+    unsigned int next = hole;
+    
+    while( true ) {
+        next = ( next + 1 ) & mask;
+        
+        TransRecord *r = transTable[ next ];
+        
+        if( r == NULL ) {
+            break;
+            }
+        
+        unsigned int home = 
+            hashTransKey( r->actor, r->target, 
+                          r->lastUseActor, r->lastUseTarget ) & mask;
+        
+        char homeInRun;
+        
+        if( hole <= next ) {
+            homeInRun = ( hole < home && home <= next );
+            }
+        else {
+            homeInRun = ( hole < home || home <= next );
+            }
+        
+        if( ! homeInRun ) {
+            transTable[ hole ] = r;
+            hole = next;
+            }
+        }
+    
+    transTable[ hole ] = NULL;
+    transTableCount--;
+    
+    
+    // a later duplicate might have been shadowed by inT
+    int mapIndex = inT->target;
+    
+    if( mapIndex < 0 ) {
+        mapIndex = inT->actor;
+        }
+    
+    SimpleVector<TransRecord*> *uses = &( usesMap[ mapIndex ] );
+    
+    for( int i=0; i<uses->size(); i++ ) {
+        TransRecord *r = uses->getElementDirect( i );
+        
+        if( r != inT &&
+            r->actor == inT->actor && r->target == inT->target &&
+            r->lastUseActor == inT->lastUseActor &&
+            r->lastUseTarget == inT->lastUseTarget ) {
+            
+            insertTransIndex( r );
+            break;
+            }
+        }
+    }
+
+
+
 static void regenUsesAndProducesMaps() {
     for( int i=0; i<mapSize; i++ ) {
         usesMap[i].deleteAll();
@@ -360,6 +734,8 @@ static void regenUsesAndProducesMaps() {
             }
         
         }
+    
+    rebuildTransIndex();
     }
 
 
@@ -383,6 +759,14 @@ void initTransBankFinish() {
 
     int numRecords = records.size();    
     
+    if( loadedFromSnapshot ) {
+        // generated transitions and derived maps are already in there
+        printf( "Loaded %d transitions from snapshot\n", numRecords );
+        
+        closeBankSnapshot();
+        return;
+        }
+    
     printf( "Loaded %d transitions from transitions folder\n", numRecords );
 
     if( autoGenerateCategoryTransitions ) {
@@ -1676,6 +2060,9 @@ void initTransBankFinish() {
 
     regenerateDepthMap();
     regenerateHumanMadeMap();
+    
+    writeTransSnapshot();
+    closeBankSnapshot();
     }
 
 
@@ -1698,6 +2085,13 @@ void freeTransBank() {
     delete [] usesMap;
     delete [] producesMap;
     
+    if( transTable != NULL ) {
+        delete [] transTable;
+        transTable = NULL;
+        }
+    transTableSize = 0;
+    transTableCount = 0;
+    
     if( depthMap != NULL ) {
         delete [] depthMap;
         depthMap = NULL;
@@ -2020,34 +2414,13 @@ void regenerateHumanMadeMap() {
 
 TransRecord *getTrans( int inActor, int inTarget, char inLastUseActor,
                        char inLastUseTarget ) {
-    int mapIndex = inTarget;
-    
-    if( mapIndex < 0 ) {
-        mapIndex = inActor;
-        }
-    
-    if( mapIndex < 0 ) {
-        return NULL;
-        }
-
-    if( mapIndex >= mapSize ) {
+    if( transTable == NULL ) {
         return NULL;
         }
     
-    int numRecords = usesMap[mapIndex].size();
-    
-    for( int i=0; i<numRecords; i++ ) {
-        
-        TransRecord *r = usesMap[mapIndex].getElementDirect(i);
-        
-        if( r->actor == inActor && r->target == inTarget &&
-            r->lastUseActor == inLastUseActor &&
-            r->lastUseTarget == inLastUseTarget ) {
-            return r;
-            }
-        }
-    
-    return NULL;
+    // NULL if slot empty
+    return transTable[ findTransSlot( inActor, inTarget,
+                                      inLastUseActor, inLastUseTarget ) ];
     }
 
 
@@ -2690,6 +3063,8 @@ void addTrans( int inActor, int inTarget,
             producesMap[inNewTarget].push_back( t );
             }
         
+        insertTransIndex( t );
+        
         writeToFile = true;
         }
     else {
@@ -2959,6 +3334,8 @@ void deleteTransFromBank( int inActor, int inTarget,
             usesMap[inTarget].deleteElementEqualTo( t );
             }
         
+        removeTransIndex( t );
+        
 
         records.deleteElementEqualTo( t );
         
@@ -159,6 +159,12 @@ void toggleMipMapGeneration( char inGenerateMipMaps );
 void toggleTransparentCropping( char inCrop );
 
 
+// if on, small sprites are packed into a few large shared textures, so
+// that runs of them can be drawn without switching textures
+// affects sprites filled from RGBA data after the call
+void toggleSpriteAtlasPacking( char inPack );
+
+
 // loads sprite from graphics directory
 // can be NULL on load failure
 SpriteHandle loadSprite( const char *inTGAFileName, 
@@ -280,6 +286,13 @@ void drawSpriteAlphaOnly( SpriteHandle inSprite, doublePair inCenter,
                           char inFlipH = false );
 
 
+// sprite draws are collected and drawn together when other drawing state
+// changes (blend modes, stencils, untextured drawing, etc.)
+// Call before raw graphics calls that must come after sprites already drawn
+// (projection changes, reading the screen, ending the frame).
+void flushSpriteBatch();
+
+
 
 
 // both cooridinates must be in the range (0,0) to (width-1, height-1)
@@ -2816,6 +2816,9 @@ static float visibleHeight = -1;
 
 
 static void redoDrawMatrix() {
+    // sprites already drawn use old matrix
+    flushSpriteBatch();
+    
     // viewport square centered on screen (even if screen is rectangle)
     float hRadius = viewSize / 2;
     
@@ -3327,6 +3330,7 @@ void GameSceneHandler::drawScene() {
                 }
             }
 
+        flushSpriteBatch();
         return;
         }
     else if( !loadingMessageShown ) {
@@ -3426,6 +3430,8 @@ void GameSceneHandler::drawScene() {
         
         drawFrame( update );
         
+        flushSpriteBatch();
+        
         if( cursorMode > 0 ) {
             // draw emulated cursor
 
@@ -3696,6 +3702,8 @@ void GameSceneHandler::drawScene() {
         // thus, to be safe, we keep glScissor off and manually draw letterboxes
         // just in case glViewport doesn't clip the image.
     
+        flushSpriteBatch();
+        
         glMatrixMode(GL_PROJECTION);
         glLoadIdentity();
             
@@ -3770,6 +3778,8 @@ void GameSceneHandler::drawScene() {
         }
     
 
+    flushSpriteBatch();
+    
     if( shouldTakeScreenshot ) {
         takeScreenShot();
 
@@ -4591,6 +4601,8 @@ static Image *getScreenRegionInternal(
     unsigned char *rgbBytes = 
         new unsigned char[ numBytes ];
 
+    flushSpriteBatch();
+    
     // w and h might not be multiples of 4
     GLint oldAlignment;
     glGetIntegerv( GL_PACK_ALIGNMENT, &oldAlignment );
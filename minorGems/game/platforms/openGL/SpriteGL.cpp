@@ -4,6 +4,7 @@
 #include "minorGems/math/geometry/Angle3D.h"
 
 #include "minorGems/util/log/AppLog.h"
+#include "minorGems/util/SimpleVector.h"
 
 
 
@@ -13,11 +14,333 @@ char SpriteGL::sStateSet = false;
 
 char SpriteGL::sGenerateMipMaps = false;
 
+char SpriteGL::sPackInAtlas = false;
+
+float SpriteGL::sCurrentColor[4] = { 1, 1, 1, 1 };
+
 char SpriteGL::sCountingPixels = false;
 double SpriteGL::sPixelsDrawn = 0;
 
 
 
+// blank pixels around each atlas region, filled by repeating region's
+// edge pixels, so that filtering and lower mipmap levels don't pick up
+// colors from neighboring regions
+#define ATLAS_PADDING 8
+
+// region corners are aligned to this, so that regions stay separate
+// in the first few mipmap levels
+#define ATLAS_ALIGN 8
+
+
+static int atlasPageSize = 0;
+
+static SimpleVector<SpriteAtlasPageGL*> atlasPages;
+
+
+
+SpriteAtlasPageGL::SpriteAtlasPageGL( int inSize, char inMipMap )
+        : mSize( inSize ), mMipMap( inMipMap ), mNumRegions( 0 ),
+          mShelfX( 0 ), mShelfY( 0 ), mShelfHeight( 0 ) {
+    
+    int numBytes = mSize * mSize * 4;
+    
+    unsigned char *blank = new unsigned char[ numBytes ];
+    memset( blank, 0, numBytes );
+    
+    mTexture = new SingleTextureGL( blank, mSize, mSize,
+                                    // no wrap
+                                    false,
+                                    mMipMap );
+    delete [] blank;
+    }
+
+
+
+SpriteAtlasPageGL::~SpriteAtlasPageGL() {
+    delete mTexture;
+    }
+
+
+
+static int roundUpToAlign( int inValue ) {
+    return ( ( inValue + ATLAS_ALIGN - 1 ) / ATLAS_ALIGN ) * ATLAS_ALIGN;
+    }
+
+
+
+char SpriteAtlasPageGL::addRegion( unsigned char *inRGBA, 
+                                   int inWidth, int inHeight,
+                                   int *outX, int *outY ) {
+    
+    int cellW = roundUpToAlign( inWidth + 2 * ATLAS_PADDING );
+    int cellH = roundUpToAlign( inHeight + 2 * ATLAS_PADDING );
+    
+    if( cellW > mSize ) {
+        return false;
+        }
+    
+    int cellX, cellY;
+    
+    if( ! takeFreeCell( cellW, cellH, &cellX, &cellY ) ) {
+        
+        if( mShelfX + cellW > mSize ) {
+            // start next shelf
+            mShelfY += mShelfHeight;
+            mShelfX = 0;
+            mShelfHeight = 0;
+            }
+        
+        if( mShelfY + cellH > mSize ) {
+            return false;
+            }
+        
+        cellX = mShelfX;
+        cellY = mShelfY;
+        
+        mShelfX += cellW;
+        
+        if( cellH > mShelfHeight ) {
+            mShelfHeight = cellH;
+            }
+        }
+    
+
+    // fill padding by clamping to image edge, like GL_CLAMP_TO_EDGE
+    unsigned char *cell = new unsigned char[ cellW * cellH * 4 ];
+    
+    for( int y=0; y<cellH; y++ ) {
+        int sourceY = y - ATLAS_PADDING;
+        
+        if( sourceY < 0 ) {
+            sourceY = 0;
+            }
+        else if( sourceY >= inHeight ) {
+            sourceY = inHeight - 1;
+            }
+        
+        unsigned char *sourceRow = &( inRGBA[ sourceY * inWidth * 4 ] );
+        unsigned char *destRow = &( cell[ y * cellW * 4 ] );
+        
+        for( int x=0; x<cellW; x++ ) {
+            int sourceX = x - ATLAS_PADDING;
+            
+            if( sourceX < 0 ) {
+                sourceX = 0;
+                }
+            else if( sourceX >= inWidth ) {
+                sourceX = inWidth - 1;
+                }
+            
+            memcpy( &( destRow[ x * 4 ] ), &( sourceRow[ sourceX * 4 ] ), 4 );
+            }
+        }
+    
+    mTexture->replaceTextureRegion( cell, cellX, cellY, cellW, cellH );
+    
+    delete [] cell;
+    
+    *outX = cellX + ATLAS_PADDING;
+    *outY = cellY + ATLAS_PADDING;
+    
+    return true;
+    }
+
+
+
+char SpriteAtlasPageGL::takeFreeCell( int inW, int inH, 
+                                      int *outX, int *outY ) {
+    int bestIndex = -1;
+    int bestArea = 0;
+    
+    for( int i=0; i<mFreeCells.size(); i++ ) {
+        SpriteAtlasCell *c = mFreeCells.getElement( i );
+        
+        if( c->w >= inW && c->h >= inH ) {
+            int area = c->w * c->h;
+            
+            if( bestIndex == -1 || area < bestArea ) {
+                bestIndex = i;
+                bestArea = area;
+                }
+            }
+        }
+    
+    if( bestIndex == -1 ) {
+        return false;
+        }
+    
+    SpriteAtlasCell c = mFreeCells.getElementDirect( bestIndex );
+    mFreeCells.deleteElement( bestIndex );
+    
+    *outX = c.x;
+    *outY = c.y;
+    
+    // leftover to right of used part, same height as used part
+    if( c.w > inW ) {
+        SpriteAtlasCell right = { c.x + inW, c.y, c.w - inW, inH };
+        mFreeCells.push_back( right );
+        }
+    // leftover above used part, full width of cell
+    if( c.h > inH ) {
+        SpriteAtlasCell above = { c.x, c.y + inH, c.w, c.h - inH };
+        mFreeCells.push_back( above );
+        }
+    
+    return true;
+    }
+
+
+
+void SpriteAtlasPageGL::freeRegion( int inX, int inY, 
+                                    int inWidth, int inHeight ) {
+    SpriteAtlasCell c = { inX - ATLAS_PADDING,
+                          inY - ATLAS_PADDING,
+                          roundUpToAlign( inWidth + 2 * ATLAS_PADDING ),
+                          roundUpToAlign( inHeight + 2 * ATLAS_PADDING ) };
+    
+    // merge with free neighbors until none line up with us
+    char merged = true;
+    
+    while( merged ) {
+        merged = false;
+        
+        for( int i=0; i<mFreeCells.size(); i++ ) {
+            SpriteAtlasCell *f = mFreeCells.getElement( i );
+            
+            if( f->y == c.y && f->h == c.h &&
+                ( f->x + f->w == c.x || c.x + c.w == f->x ) ) {
+                
+                if( f->x < c.x ) {
+                    c.x = f->x;
+                    }
+                c.w += f->w;
+                merged = true;
+                }
+            else if( f->x == c.x && f->w == c.w &&
+                     ( f->y + f->h == c.y || c.y + c.h == f->y ) ) {
+                
+                if( f->y < c.y ) {
+                    c.y = f->y;
+                    }
+                c.h += f->h;
+                merged = true;
+                }
+            
+            if( merged ) {
+                mFreeCells.deleteElement( i );
+                break;
+                }
+            }
+        }
+    
+    mFreeCells.push_back( c );
+    }
+
+
+
+char SpriteGL::packInAtlas( unsigned char *inRGBA, 
+                            unsigned int inWidth, unsigned int inHeight ) {
+#ifdef GLES
+    // GLES draw path doesn't map texture coordinates into pages
+    return false;
+#else
+    
+    if( atlasPageSize == 0 ) {
+        GLint maxSize;
+        glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxSize );
+        
+        atlasPageSize = 2048;
+        
+        if( maxSize < atlasPageSize ) {
+            atlasPageSize = maxSize;
+            }
+        }
+    
+    // big sprites would leave too much unused space in pages
+    if( (int)inWidth > atlasPageSize / 4 || 
+        (int)inHeight > atlasPageSize / 4 ) {
+        return false;
+        }
+
+    // same processing that our own texture would do
+    SingleTextureGL::expandEdges( inRGBA, inWidth, inHeight );
+    
+    int x, y;
+    
+    SpriteAtlasPageGL *page = NULL;
+    
+    for( int i=0; i<atlasPages.size(); i++ ) {
+        SpriteAtlasPageGL *p = atlasPages.getElementDirect( i );
+        
+        if( p->mMipMap == sGenerateMipMaps &&
+            p->addRegion( inRGBA, inWidth, inHeight, &x, &y ) ) {
+            page = p;
+            break;
+            }
+        }
+    
+    if( page == NULL ) {
+        page = new SpriteAtlasPageGL( atlasPageSize, sGenerateMipMaps );
+        atlasPages.push_back( page );
+        
+        AppLog::infoF( "Started sprite atlas page %d (%dx%d)",
+                       atlasPages.size(), atlasPageSize, atlasPageSize );
+        
+        if( ! page->addRegion( inRGBA, inWidth, inHeight, &x, &y ) ) {
+            return false;
+            }
+        }
+    
+    page->mNumRegions++;
+    
+    mAtlasPage = page;
+    mTexture = page->mTexture;
+    
+    mAtlasX = x;
+    mAtlasY = y;
+    
+    mTexOffsetX = x / (double)atlasPageSize;
+    mTexOffsetY = y / (double)atlasPageSize;
+    
+    mTexScaleX = inWidth / (double)atlasPageSize;
+    mTexScaleY = inHeight / (double)atlasPageSize;
+    
+    return true;
+#endif
+    }
+
+
+
+
+// sprite draws collected since last flush
+// four vertices per quad, in same BL, BR, TL, TR order as a single
+// sprite's triangle strip
+
+#define BATCH_MAX_QUADS 1024
+
+static GLfloat batchVertices[ BATCH_MAX_QUADS * 4 * 2 ];
+
+static GLfloat batchTextureCoords[ BATCH_MAX_QUADS * 4 * 2 ];
+
+static GLfloat batchColors[ BATCH_MAX_QUADS * 4 * 4 ];
+
+// two triangles per quad, split along same diagonal as triangle strip,
+// so that corner colors blend the same way
+static GLushort batchIndices[ BATCH_MAX_QUADS * 6 ];
+
+static char batchIndicesSet = false;
+
+static int numBatchQuads = 0;
+
+static SingleTextureGL *batchTexture = NULL;
+
+static char batchLinearMagFilter = false;
+static char batchMipMapFilter = false;
+
+
+
+
 void SpriteGL::findColoredRadii( Image *inImage ) {
     
     if( inImage->getNumChannels() < 4 ) {
@@ -195,8 +518,11 @@ void SpriteGL::initTexture( Image *inImage,
                             int inNumFrames,
                             int inNumPages, char inSetColoredRadii ) {
     
-    mLastSetMinFilter = -1;
-    mLastSetMagFilter = -1;
+    mAtlasPage = NULL;
+    mTexOffsetX = 0;
+    mTexOffsetY = 0;
+    mTexScaleX = 1;
+    mTexScaleY = 1;
     
     mColoredRadiusLeftX = 0.5;
     mColoredRadiusRightX = 0.5;
@@ -282,8 +608,11 @@ SpriteGL::SpriteGL( unsigned char *inRGBA,
                     int inNumPages,
                     char inSetColoredRadii ) {
 
-    mLastSetMinFilter = -1;
-    mLastSetMagFilter = -1;
+    mAtlasPage = NULL;
+    mTexOffsetX = 0;
+    mTexOffsetY = 0;
+    mTexScaleX = 1;
+    mTexScaleY = 1;
     
     mColoredRadiusLeftX = 0.5;
     mColoredRadiusRightX = 0.5;
@@ -297,10 +626,15 @@ SpriteGL::SpriteGL( unsigned char *inRGBA,
         findColoredRadii( inRGBA, inWidth, inHeight );
         }
     
-    mTexture = new SingleTextureGL( inRGBA, inWidth, inHeight,
-                                    // no wrap
-                                    false,
-                                    sGenerateMipMaps );    
+    if( ! sPackInAtlas ||
+        mNumFrames != 1 || mNumPages != 1 ||
+        ! packInAtlas( inRGBA, inWidth, inHeight ) ) {
+        
+        mTexture = new SingleTextureGL( inRGBA, inWidth, inHeight,
+                                        // no wrap
+                                        false,
+                                        sGenerateMipMaps );
+        }
 
     mWidth = inWidth;
     mHeight = inHeight;
@@ -325,8 +659,11 @@ SpriteGL::SpriteGL( char inAlphaOnly,
                     int inNumPages,
                     char inSetColoredRadii ) {
 
-    mLastSetMinFilter = -1;
-    mLastSetMagFilter = -1;
+    mAtlasPage = NULL;
+    mTexOffsetX = 0;
+    mTexOffsetY = 0;
+    mTexScaleX = 1;
+    mTexScaleY = 1;
     
     mColoredRadiusLeftX = 0.5;
     mColoredRadiusRightX = 0.5;
@@ -364,7 +701,25 @@ SpriteGL::SpriteGL( char inAlphaOnly,
 
 
 SpriteGL::~SpriteGL() {
-    delete mTexture;
+    if( batchTexture == mTexture ) {
+        // don't leave batch pointing to a deleted texture
+        flushBatch();
+        batchTexture = NULL;
+        }
+    
+    if( mAtlasPage != NULL ) {
+        mAtlasPage->freeRegion( mAtlasX, mAtlasY, mWidth, mHeight );
+        
+        mAtlasPage->mNumRegions --;
+        
+        if( mAtlasPage->mNumRegions == 0 ) {
+            atlasPages.deleteElementEqualTo( mAtlasPage );
+            delete mAtlasPage;
+            }
+        }
+    else {
+        delete mTexture;
+        }
     }
 
 
@@ -469,43 +824,7 @@ void SpriteGL::prepareDraw( int inFrame,
 
     mTexture->enable();
     
-    if( inMipMapFilter ) {
-        if( mLastSetMinFilter != 2 ) {
-            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
-                             GL_LINEAR_MIPMAP_LINEAR );
-            mLastSetMinFilter = 2;
-            }
-        }
-    else {
-        
-        if( inLinearMagFilter ) {
-            if( mLastSetMinFilter != 1 ) {
-                glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
-                                 GL_LINEAR );
-                mLastSetMinFilter = 1;
-                }
-            }
-        else {
-            if( mLastSetMinFilter != 0 ) {
-                glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
-                                 GL_NEAREST );
-                mLastSetMinFilter = 0;
-                }
-            }
-        }
-    
-    if( inLinearMagFilter ) {
-        if( mLastSetMagFilter != 1 ) {
-            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-            mLastSetMagFilter = 1;
-            }
-        }
-    else {
-        if( mLastSetMagFilter != 0 ) {
-            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-            mLastSetMagFilter = 0;
-            }
-        }
+    mTexture->setFilters( inLinearMagFilter, inMipMapFilter );
     
 
 
@@ -627,6 +946,14 @@ void SpriteGL::draw( int inFrame,
 
 
 
+
+
+// GLES path draws each sprite right away
+void SpriteGL::flushBatch() {
+    }
+
+
+
 #else
 
 // opt (found with profiler)
@@ -777,51 +1104,10 @@ void SpriteGL::prepareDraw( int inFrame,
         glColor4f( 1, 1, 1, inFadeFactor );
         }
     */          
-    mTexture->enable();
-    
-
-    if( inMipMapFilter ) {
-        if( mLastSetMinFilter != 2 ) {
-            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
-                             GL_LINEAR_MIPMAP_LINEAR );
-            mLastSetMinFilter = 2;
-            }
-        }
-    else {
-        
-        if( inLinearMagFilter ) {
-            if( mLastSetMinFilter != 1 ) {
-                glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
-                                 GL_LINEAR );
-                mLastSetMinFilter = 1;
-                }
-            }
-        else {
-            if( mLastSetMinFilter != 0 ) {
-                glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
-                                 GL_NEAREST );
-                mLastSetMinFilter = 0;
-                }
-            }
-        }
-    
-    if( inLinearMagFilter ) {
-        if( mLastSetMagFilter != 1 ) {
-            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-            mLastSetMagFilter = 1;
-            }
-        }
-    else {
-        if( mLastSetMagFilter != 0 ) {
-            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-            mLastSetMagFilter = 0;
-            }
-        }
-
-    
+    // texture and filters are set when batch is drawn
     
     
-    textXA = (1.0 / mNumPages) * mCurrentPage;
+        textXA = (1.0 / mNumPages) * mCurrentPage;
     textXB = textXA + (1.0 / mNumPages );
     
     textXA += 0.5 - mColoredRadiusLeftX;
@@ -834,6 +1120,13 @@ void SpriteGL::prepareDraw( int inFrame,
     textYB += 0.5 - mColoredRadiusTopY;
     textYA -= 0.5 - mColoredRadiusBottomY;
 
+    // map into our region of atlas page
+    textXA = mTexOffsetX + textXA * mTexScaleX;
+    textXB = mTexOffsetX + textXB * mTexScaleX;
+    
+    textYA = mTexOffsetY + textYA * mTexScaleY;
+    textYB = mTexOffsetY + textYB * mTexScaleY;
+
     squareTextureCoords[0] = textXA;
     squareTextureCoords[1] = textYA;
 
@@ -852,88 +1145,86 @@ void SpriteGL::prepareDraw( int inFrame,
 extern int numPixelsDrawn;
 
 
-void SpriteGL::draw( int inFrame, 
-                     Vector3D *inPosition, 
-                     double inScale,
-                     char inLinearMagFilter,
-                     char inMipMapFilter,
-                     double inRotation,
-                     char inFlipH ) {
-    // numPixelsDrawn += 
-    //    ( mColoredRadiusRightX + mColoredRadiusLeftX ) * mWidth *
-    //    ( mColoredRadiusTopY + mColoredRadiusBottomY ) * mHeight;
 
-        
-    prepareDraw( inFrame, inPosition, inScale, inLinearMagFilter,
-                 inMipMapFilter,
-                 inRotation, inFlipH );
-
-
-    glVertexPointer( 2, GL_FLOAT, 0, squareVertices );
+void SpriteGL::flushBatch() {
+    if( numBatchQuads == 0 ) {
+        return;
+        }
     
+    batchTexture->refreshMipMaps();
     
-    glTexCoordPointer( 2, GL_FLOAT, 0, squareTextureCoords );
+    batchTexture->enable();
+    
+    batchTexture->setFilters( batchLinearMagFilter, batchMipMapFilter );
+    
+
+    glVertexPointer( 2, GL_FLOAT, 0, batchVertices );
+    glTexCoordPointer( 2, GL_FLOAT, 0, batchTextureCoords );
     
     if( !sStateSet ) {    
         glEnableClientState( GL_VERTEX_ARRAY );
         glEnableClientState( GL_TEXTURE_COORD_ARRAY );
         sStateSet = true;
         }
-    
-    glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
-
 
-    /*
-      // for debugging
-      // show red square around each sprite
-    
-    SingleTextureGL::disableTexturing();
+    glColorPointer( 4, GL_FLOAT, 0, batchColors );
+    glEnableClientState( GL_COLOR_ARRAY );
     
-    FloatColor oldColor = getDrawColor();
-    setDrawColor( 1, 0, 0, 0.75 );
+    if( !batchIndicesSet ) {
+        for( int q=0; q<BATCH_MAX_QUADS; q++ ) {
+            GLushort *indices = &( batchIndices[ q * 6 ] );
+            GLushort first = (GLushort)( q * 4 );
+            
+            indices[0] = first;
+            indices[1] = first + 1;
+            indices[2] = first + 2;
 
-    GLfloat temp = squareVertices[4];
-    squareVertices[4] = squareVertices[6];
-    squareVertices[6] = temp;
+            indices[3] = first + 2;
+            indices[4] = first + 1;
+            indices[5] = first + 3;
+            }
+        batchIndicesSet = true;
+        }
     
-    temp = squareVertices[5];
-    squareVertices[5] = squareVertices[7];
-    squareVertices[7] = temp;
-    //glVertexPointer( 2, GL_FLOAT, 0, squareVertices );
+    glDrawElements( GL_TRIANGLES, numBatchQuads * 6, 
+                    GL_UNSIGNED_SHORT, batchIndices );
     
-    glDrawArrays( GL_LINE_LOOP, 0, 4 );
+    glDisableClientState( GL_COLOR_ARRAY );
     
-    setDrawColor( oldColor );
-    */
+    // current color is undefined after drawing with color array
+    glColor4fv( sCurrentColor );
+    
+    numBatchQuads = 0;
     }
 
 
 
-void SpriteGL::draw( int inFrame,
-                     Vector3D *inPosition,
-                     FloatColor inCornerColors[4],
-                     double inScale,
-                     char inLinearMagFilter,
-                     char inMipMapFilter,
-                     double inRotation,
-                     char inFlipH ) {
-
-    prepareDraw( inFrame, inPosition, inScale, inLinearMagFilter,
-                 inMipMapFilter,
-                 inRotation, inFlipH );
-
-
-    glVertexPointer( 2, GL_FLOAT, 0, squareVertices );
-    glTexCoordPointer( 2, GL_FLOAT, 0, squareTextureCoords );
+void SpriteGL::addToBatch( FloatColor *inCornerColors,
+                           char inLinearMagFilter,
+                           char inMipMapFilter ) {
     
-    if( !sStateSet ) {    
-        glEnableClientState( GL_VERTEX_ARRAY );
-        glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-        sStateSet = true;
+    if( numBatchQuads > 0 &&
+        ( numBatchQuads == BATCH_MAX_QUADS ||
+          batchTexture != mTexture ||
+          batchLinearMagFilter != inLinearMagFilter ||
+          batchMipMapFilter != inMipMapFilter ) ) {
+        flushBatch();
         }
+    
+    batchTexture = mTexture;
+    batchLinearMagFilter = inLinearMagFilter;
+    batchMipMapFilter = inMipMapFilter;
+    
 
+    GLfloat *verts = &( batchVertices[ numBatchQuads * 8 ] );
+    GLfloat *coords = &( batchTextureCoords[ numBatchQuads * 8 ] );
+    GLfloat *colors = &( batchColors[ numBatchQuads * 16 ] );
+    
+    memcpy( verts, squareVertices, 8 * sizeof( GLfloat ) );
+    memcpy( coords, squareTextureCoords, 8 * sizeof( GLfloat ) );
+    
     for( int c=0; c<4; c++ ) {
-        
+        // corner colors are in BL, BR, TR, TL order
         int cDest = c;
         if( c == 2 ) {
             cDest = 3;
@@ -943,21 +1234,58 @@ void SpriteGL::draw( int inFrame,
             }
 
         int start = cDest * 4;
-        squareColors[ start ] = inCornerColors[c].r;
-        squareColors[ start + 1 ] = inCornerColors[c].g;
-        squareColors[ start + 2 ] = inCornerColors[c].b;
-        squareColors[ start + 3 ] = inCornerColors[c].a;
+
+        if( inCornerColors != NULL ) {
+            colors[ start ] = inCornerColors[c].r;
+            colors[ start + 1 ] = inCornerColors[c].g;
+            colors[ start + 2 ] = inCornerColors[c].b;
+            colors[ start + 3 ] = inCornerColors[c].a;
+            }
+        else {
+            memcpy( &( colors[ start ] ), sCurrentColor, 4 * sizeof( float ) );
+            }
         }
     
-    
-    glColorPointer( 4, GL_FLOAT, 0, squareColors );
-    glEnableClientState( GL_COLOR_ARRAY );
+    numBatchQuads++;
+    }
 
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-    
-    glDisableClientState( GL_COLOR_ARRAY );
+void SpriteGL::draw( int inFrame, 
+                     Vector3D *inPosition, 
+                     double inScale,
+                     char inLinearMagFilter,
+                     char inMipMapFilter,
+                     double inRotation,
+                     char inFlipH ) {
+    // numPixelsDrawn += 
+    //    ( mColoredRadiusRightX + mColoredRadiusLeftX ) * mWidth *
+    //    ( mColoredRadiusTopY + mColoredRadiusBottomY ) * mHeight;
+
+        
+    prepareDraw( inFrame, inPosition, inScale, inLinearMagFilter,
+                 inMipMapFilter,
+                 inRotation, inFlipH );
+
+    addToBatch( NULL, inLinearMagFilter, inMipMapFilter );
+    }
+
+
+
+void SpriteGL::draw( int inFrame,
+                     Vector3D *inPosition,
+                     FloatColor inCornerColors[4],
+                     double inScale,
+                     char inLinearMagFilter,
+                     char inMipMapFilter,
+                     double inRotation,
+                     char inFlipH ) {
+
+    prepareDraw( inFrame, inPosition, inScale, inLinearMagFilter,
+                 inMipMapFilter,
+                 inRotation, inFlipH );
+
+    addToBatch( inCornerColors, inLinearMagFilter, inMipMapFilter );
     }
 
 
@@ -991,42 +1319,7 @@ void SpriteGL::draw( int inFrame,
     squareVertices[6] = inCornerPos[2].x;
     squareVertices[7] = inCornerPos[2].y;
     
-    
-    glVertexPointer( 2, GL_FLOAT, 0, squareVertices );
-    glTexCoordPointer( 2, GL_FLOAT, 0, squareTextureCoords );
-    
-    if( !sStateSet ) {    
-        glEnableClientState( GL_VERTEX_ARRAY );
-        glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-        sStateSet = true;
-        }
-
-    for( int c=0; c<4; c++ ) {
-        
-        int cDest = c;
-        if( c == 2 ) {
-            cDest = 3;
-            }
-        else if( c == 3 ) {
-            cDest = 2;
-            }
-
-        int start = cDest * 4;
-        squareColors[ start ] = inCornerColors[c].r;
-        squareColors[ start + 1 ] = inCornerColors[c].g;
-        squareColors[ start + 2 ] = inCornerColors[c].b;
-        squareColors[ start + 3 ] = inCornerColors[c].a;
-        }
-    
-    
-    glColorPointer( 4, GL_FLOAT, 0, squareColors );
-    glEnableClientState( GL_COLOR_ARRAY );
-
-
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-    
-    glDisableClientState( GL_COLOR_ARRAY );
+    addToBatch( inCornerColors, inLinearMagFilter, inMipMapFilter );
     }
 
 
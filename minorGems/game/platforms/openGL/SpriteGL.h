@@ -9,10 +9,72 @@
 
 #include "minorGems/math/geometry/Vector3D.h"
 
+#include "minorGems/util/SimpleVector.h"
+
 #include <stdlib.h>
 
 
 
+// rectangle of atlas page pixels, including a region's padding
+typedef struct SpriteAtlasCell {
+        int x, y;
+        int w, h;
+    } SpriteAtlasCell;
+
+
+
+// a large texture shared by many small sprites, so that they can be
+// drawn together without switching textures
+class SpriteAtlasPageGL {
+    public:
+        
+        SpriteAtlasPageGL( int inSize, char inMipMap );
+        
+        ~SpriteAtlasPageGL();
+        
+        
+        // finds room for an inWidth x inHeight image and copies it in
+        // returns false if page is full
+        char addRegion( unsigned char *inRGBA, 
+                        int inWidth, int inHeight,
+                        int *outX, int *outY );
+
+        
+        // gives space of a region back to page, for reuse by later
+        // addRegion calls
+        // inX, inY as returned by addRegion
+        void freeRegion( int inX, int inY, int inWidth, int inHeight );
+        
+        
+        SingleTextureGL *mTexture;
+        
+        int mSize;
+        char mMipMap;
+        
+        // number of sprites still using page
+        int mNumRegions;
+        
+    private:
+        
+        // regions are packed left to right into shelves, which are
+        // stacked bottom to top
+        int mShelfX;
+        int mShelfY;
+        int mShelfHeight;
+        
+        // space of freed regions, tried before shelf space
+        // adjacent cells of same width or height are merged
+        SimpleVector<SpriteAtlasCell> mFreeCells;
+        
+        // removes best-fitting free cell, returning leftover parts
+        // to free list
+        // returns false if no free cell is big enough
+        char takeFreeCell( int inW, int inH, int *outX, int *outY );
+    };
+
+
+
+
 class SpriteGL{
     public:
         
@@ -21,6 +83,13 @@ class SpriteGL{
             sGenerateMipMaps = inGenerateMipMaps;
             }
             
+
+        // toggles packing of subsequent RGBA sprites into shared atlas
+        // pages (sprites too big for a page get their own texture)
+        static void togglePackInAtlas( char inPack ) {
+            sPackInAtlas = inPack;
+            }
+        
         
 
         // transparent color for RGB images can be taken from lower-left
@@ -157,11 +226,31 @@ class SpriteGL{
         
         
         static void setTexturingDisabled() {
+            flushBatch();
+            
             // need to renable client states later
             sStateSet = false;
             SingleTextureGL::disableTexturing();
             }
 
+
+        // sprite draws that share a texture and filters are collected
+        // and drawn together
+        // must be called before any GL state change that would affect
+        // how already-drawn sprites look
+        static void flushBatch();
+        
+        
+        // tells batch about the current glColor, which is used for
+        // sprites that have no corner colors
+        static void setCurrentColor( float inR, float inG, float inB,
+                                     float inA ) {
+            sCurrentColor[0] = inR;
+            sCurrentColor[1] = inG;
+            sCurrentColor[2] = inB;
+            sCurrentColor[3] = inA;
+            }
+
         
         int mWidth, mHeight;
 
@@ -169,22 +258,32 @@ class SpriteGL{
 
         static char sGenerateMipMaps;
         
+        static char sPackInAtlas;
+        
         static char sCountingPixels;
         static double sPixelsDrawn;
 
-        // -1 for unset, 0 for nearest, 1 for linear, 2 for mipmap
-        int mLastSetMinFilter;
-        
-        // -1 for unset, 0 for nearest, 1 for linear
-        int mLastSetMagFilter;
-        
         static char sWrapSet;
 
         static char sStateSet;
         
+        static float sCurrentColor[4];
+        
 
+        // owned by us, unless we're in an atlas page
         SingleTextureGL *mTexture;
         
+        // NULL if we have our own texture
+        SpriteAtlasPageGL *mAtlasPage;
+        
+        // our region's corner in atlas page, in pixels
+        int mAtlasX, mAtlasY;
+        
+        // maps our texture coordinates into atlas page
+        // (offset 0 and scale 1 if not in an atlas)
+        double mTexOffsetX, mTexOffsetY;
+        double mTexScaleX, mTexScaleY;
+        
         int mNumFrames;
         int mNumPages;
         
@@ -232,6 +331,18 @@ class SpriteGL{
 
 
 
+        // tries to place image in an atlas page, instead of our own texture
+        // returns false if it doesn't fit
+        char packInAtlas( unsigned char *inRGBA, 
+                          unsigned int inWidth, unsigned int inHeight );
+        
+        // adds last prepared quad to batch
+        // inCornerColors can be NULL to use current color
+        void addToBatch( FloatColor *inCornerColors,
+                         char inLinearMagFilter,
+                         char inMipMapFilter );
+        
+
         void findColoredRadii( Image *inImage );
         
         void findColoredRadii( unsigned char *inRGBA, 
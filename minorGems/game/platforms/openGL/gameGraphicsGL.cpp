@@ -76,6 +76,7 @@ float getTotalGlobalFade() {
 
 void hetuwSetDrawColor(float r, float g, float b, float a) {
 	if (HetuwMod::drawColorAlpha != 1.0f) a = HetuwMod::drawColorAlpha;
+	SpriteGL::setCurrentColor(r, g, b, a);
 	glColor4f(r, g, b, a);
 }
 
@@ -160,6 +161,12 @@ FloatColor getFloatColor( const char *inHexString ) {
 
 
 
+void flushSpriteBatch() {
+    SpriteGL::flushBatch();
+    }
+
+
+
 static void setNormalBlend() {
     glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
     }
@@ -167,6 +174,8 @@ static void setNormalBlend() {
 
 
 void toggleAdditiveBlend( char inAdditive ) {
+    SpriteGL::flushBatch();
+    
     if( inAdditive ) {
         glBlendFunc( GL_SRC_ALPHA, GL_ONE );
         }
@@ -178,6 +187,8 @@ void toggleAdditiveBlend( char inAdditive ) {
 
 
 void toggleMultiplicativeBlend( char inMultiplicative ) {
+    SpriteGL::flushBatch();
+    
     if( inMultiplicative ) {
         glBlendFunc( GL_DST_COLOR, GL_ZERO );
         }
@@ -188,6 +199,8 @@ void toggleMultiplicativeBlend( char inMultiplicative ) {
 
 
 void toggleInvertedBlend( char inInverted ) {
+    SpriteGL::flushBatch();
+    
     if( inInverted ) {
         glBlendFunc( GL_ONE_MINUS_DST_COLOR, GL_ZERO );
         }
@@ -199,6 +212,8 @@ void toggleInvertedBlend( char inInverted ) {
 
 
 void toggleAdditiveTextureColoring( char inAdditive ) {
+    SpriteGL::flushBatch();
+    
     if( inAdditive ) {
         glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_ADD );
         }
@@ -246,6 +261,12 @@ void toggleTransparentCropping( char inCrop ) {
     }
 
 
+
+void toggleSpriteAtlasPacking( char inPack ) {
+    SpriteGL::togglePackInAtlas( inPack );
+    }
+
+
 #ifdef GLES
 // GL ES versions of these functions
 
@@ -533,6 +554,8 @@ void drawTrianglesColor( int inNumTriangles, double inVertices[],
 
 
 void enableScissor( double inX, double inY, double inWidth, double inHeight ) {
+    SpriteGL::flushBatch();
+    
     
     double endX = inX + inWidth;
     double endY = inY + inHeight;
@@ -567,6 +590,8 @@ void enableScissor( double inX, double inY, double inWidth, double inHeight ) {
 
 
 void disableScissor() {
+    SpriteGL::flushBatch();
+    
     glDisable( GL_SCISSOR_TEST );
     }
 
@@ -574,6 +599,8 @@ void disableScissor() {
 
 void startAddingToStencil( char inDrawColorToo, char inAdd,
                            float inMinAlpha ) {
+    SpriteGL::flushBatch();
+    
     if( !inDrawColorToo ) {
         
         // stop updating color
@@ -606,6 +633,8 @@ void startAddingToStencil( char inDrawColorToo, char inAdd,
 
 
 void startDrawingThroughStencil( char inInvertStencil ) {
+    SpriteGL::flushBatch();
+    
     // Re-enable update of color
     glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
     glDisable( GL_ALPHA_TEST );
@@ -634,6 +663,8 @@ void stopStencil() {
 
 
 void disableStencil() {
+    SpriteGL::flushBatch();
+    
     // Re-enable update of color (just in case stencil drawing was not started)
     glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
     glDisable( GL_ALPHA_TEST );
@@ -801,6 +832,8 @@ void drawSpriteAlphaOnly( SpriteHandle inSprite, doublePair inCenter,
     // http://stackoverflow.com/questions/2485370/
     //      use-only-alpha-channel-of-texture-in-opengl
 
+    SpriteGL::flushBatch();
+    
     glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
     glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_REPLACE);
     glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_PREVIOUS);
@@ -812,6 +845,8 @@ void drawSpriteAlphaOnly( SpriteHandle inSprite, doublePair inCenter,
 
     drawSprite( inSprite, inCenter, inZoom, inRotation, inFlipH );
 
+    SpriteGL::flushBatch();
+    
     // restore texture mode
     glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
     }
@@ -78,6 +78,11 @@ void SingleTextureGL::reloadFromBackup() {
                     error, glGetString( error ) );
             }
         
+        // fresh texture has default filters, and setTextureData
+        // builds its mipmaps from scratch
+        mLastSetMinFilter = -1;
+        mLastSetMagFilter = -1;
+        mMipMapsStale = false;
         
         setTextureData( mBackupBytes, mAlphaOnly, 
                         mWidthBackup, mHeightBackup, 
@@ -93,6 +98,9 @@ SingleTextureGL::SingleTextureGL( Image *inImage, char inRepeat,
                                   char inMipMap )
     : mRepeat( inRepeat ), 
       mMipMap( inMipMap ),
+      mMipMapsStale( false ),
+      mLastSetMinFilter( -1 ),
+      mLastSetMagFilter( -1 ),
       mAlphaOnly( false ),
       mBackupBytes( NULL ) {
 
@@ -118,6 +126,9 @@ SingleTextureGL::SingleTextureGL( unsigned char *inRGBA,
                                   char inRepeat, char inMipMap )
     : mRepeat( inRepeat ),
       mMipMap( inMipMap ),
+      mMipMapsStale( false ),
+      mLastSetMinFilter( -1 ),
+      mLastSetMagFilter( -1 ),
       mAlphaOnly( false ),
       mBackupBytes( NULL ) {
 
@@ -143,6 +154,9 @@ SingleTextureGL::SingleTextureGL( char inAlphaOnly,
                                   char inRepeat, char inMipMap )
     : mRepeat( inRepeat ),
       mMipMap( inMipMap ),
+      mMipMapsStale( false ),
+      mLastSetMinFilter( -1 ),
+      mLastSetMagFilter( -1 ),
       mAlphaOnly( true ),
       mBackupBytes( NULL ) {
 
@@ -228,151 +242,158 @@ void SingleTextureGL::replaceBackupData( unsigned char *inBytes,
 
 
 
-void SingleTextureGL::setTextureData( unsigned char *inBytes,
-                                      char inAlphaOnly,
-                                      unsigned int inWidth, 
-                                      unsigned int inHeight,
-                                      char inExpandEdge ) {
+void SingleTextureGL::expandEdges( unsigned char *inRGBA,
+                                   unsigned int inWidth, 
+                                   unsigned int inHeight ) {
     
-    if( inExpandEdge && !inAlphaOnly ) {
-        
-        unsigned int maxY = 0;
-        unsigned int minY = inHeight - 1;
-        
-        unsigned int maxX = 0;
-        unsigned int minX = inWidth - 1;
-        
-        int aIndex = 3;
-        for( unsigned int y=0; y<inHeight; y++ ) {
-            for( unsigned int x=0; x<inWidth; x++ ) {
-                
-                if( inBytes[ aIndex ] > 0 ) {    
-                    if( x > maxX ) {
-                        maxX = x;
-                        }
-                    if( x < minX ) {
-                        minX = x;
-                        }
-                    if( y > maxY ) {
-                        maxY = y;
-                        }
-                    if( y < minY ) {
-                        minY = y;
-                        }
+    unsigned int maxY = 0;
+    unsigned int minY = inHeight - 1;
+    
+    unsigned int maxX = 0;
+    unsigned int minX = inWidth - 1;
+    
+    int aIndex = 3;
+    for( unsigned int y=0; y<inHeight; y++ ) {
+        for( unsigned int x=0; x<inWidth; x++ ) {
+            
+            if( inRGBA[ aIndex ] > 0 ) {    
+                if( x > maxX ) {
+                    maxX = x;
+                    }
+                if( x < minX ) {
+                    minX = x;
+                    }
+                if( y > maxY ) {
+                    maxY = y;
+                    }
+                if( y < minY ) {
+                    minY = y;
                     }
-
-                aIndex += 4;
                 }
+
+            aIndex += 4;
             }
+        }
 
-        if( minY < maxY &&
-            minX < maxX &&
-            minY > 0 &&
-            maxY < inHeight - 1 &&  
-            minX > 0 &&
-            maxX < inWidth - 1 ) {
+    if( minY < maxY &&
+        minX < maxX &&
+        minY > 0 &&
+        maxY < inHeight - 1 &&  
+        minX > 0 &&
+        maxX < inWidth - 1 ) {
 
-            // found edges away from image edge
+        // found edges away from image edge
 
-            // duplicate them
-            
-            // row edges
+        // duplicate them
+        
+        // row edges
 
-            int rowBytes = inWidth * 4;
+        int rowBytes = inWidth * 4;
 
-            int rowStart = minY * rowBytes;
-            int rowDestStart = rowStart - rowBytes;
+        int rowStart = minY * rowBytes;
+        int rowDestStart = rowStart - rowBytes;
 
-            // don't duplicate row unless it has some fully-opaque
-            // pixels in it (it's something of a hard edge)
-            // thus, we don't accidentally expand the soft edges
-            // of feathered sprites, fonts, etc
-            char solidPresent = false;
-            
-            for( int i=rowStart + 3; i<rowStart + rowBytes; i+=4 ) {
-                if( inBytes[i] == 255 ) {
-                    solidPresent = true;
-                    break;
-                    }
+        // don't duplicate row unless it has some fully-opaque
+        // pixels in it (it's something of a hard edge)
+        // thus, we don't accidentally expand the soft edges
+        // of feathered sprites, fonts, etc
+        char solidPresent = false;
+        
+        for( int i=rowStart + 3; i<rowStart + rowBytes; i+=4 ) {
+            if( inRGBA[i] == 255 ) {
+                solidPresent = true;
+                break;
                 }
+            }
 
-            if( solidPresent ) {
-                memcpy( &( inBytes[ rowDestStart ] ), 
-                        &( inBytes[ rowStart ] ), 
-                        inWidth * 4 );
-                }
-            
-            rowStart = maxY * inWidth * 4;
-            rowDestStart = rowStart + inWidth * 4;
+        if( solidPresent ) {
+            memcpy( &( inRGBA[ rowDestStart ] ), 
+                    &( inRGBA[ rowStart ] ), 
+                    inWidth * 4 );
+            }
+        
+        rowStart = maxY * inWidth * 4;
+        rowDestStart = rowStart + inWidth * 4;
 
-            solidPresent = false;
+        solidPresent = false;
 
-            for( int i=rowStart + 3; i<rowStart + rowBytes; i+=4 ) {
-                if( inBytes[i] == 255 ) {
-                    solidPresent = true;
-                    break;
-                    }
+        for( int i=rowStart + 3; i<rowStart + rowBytes; i+=4 ) {
+            if( inRGBA[i] == 255 ) {
+                solidPresent = true;
+                break;
                 }
+            }
 
-            if( solidPresent ) {
-                memcpy( &( inBytes[ rowDestStart ] ), 
-                        &( inBytes[ rowStart ] ), 
-                        inWidth * 4 );
-                }
-            
+        if( solidPresent ) {
+            memcpy( &( inRGBA[ rowDestStart ] ), 
+                    &( inRGBA[ rowStart ] ), 
+                    inWidth * 4 );
+            }
+        
 
-            // now column edges
+        // now column edges
 
-            char solidPresentLeft = false;
-            char solidPresentRight = false;
-            
-            for( unsigned int y=minY; y<=maxY; y++ ) {
+        char solidPresentLeft = false;
+        char solidPresentRight = false;
+        
+        for( unsigned int y=minY; y<=maxY; y++ ) {
 
-                int iL = (y * inWidth + minX) * 4;
+            int iL = (y * inWidth + minX) * 4;
 
-                if( inBytes[ iL + 3 ] == 255 ) {
-                    solidPresentLeft = true;
-                    break;
-                    }
+            if( inRGBA[ iL + 3 ] == 255 ) {
+                solidPresentLeft = true;
+                break;
                 }
-            
-            for( unsigned int y=minY; y<=maxY; y++ ) {
+            }
+        
+        for( unsigned int y=minY; y<=maxY; y++ ) {
 
-                int iR = (y * inWidth + maxX) * 4;
+            int iR = (y * inWidth + maxX) * 4;
 
-                if( inBytes[ iR + 3 ] == 255 ) {
-                    solidPresentRight = true;
-                    break;
-                    }
+            if( inRGBA[ iR + 3 ] == 255 ) {
+                solidPresentRight = true;
+                break;
                 }
-            
+            }
+        
 
-            if( solidPresentLeft ) {    
-                for( unsigned int y=minY; y<=maxY; y++ ) {
-                    int iL = (y * inWidth + minX) * 4;
-                    
-                    inBytes[iL - 4] = inBytes[ iL ];
-                    inBytes[iL - 3] = inBytes[ iL + 1 ];
-                    inBytes[iL - 2] = inBytes[ iL + 2 ];
-                    inBytes[iL - 1] = inBytes[ iL + 3 ];
-                    }
+        if( solidPresentLeft ) {    
+            for( unsigned int y=minY; y<=maxY; y++ ) {
+                int iL = (y * inWidth + minX) * 4;
+                
+                inRGBA[iL - 4] = inRGBA[ iL ];
+                inRGBA[iL - 3] = inRGBA[ iL + 1 ];
+                inRGBA[iL - 2] = inRGBA[ iL + 2 ];
+                inRGBA[iL - 1] = inRGBA[ iL + 3 ];
                 }
+            }
+        
             
-                
 
-            if( solidPresentRight ) {
-                for( unsigned int y=minY; y<=maxY; y++ ) {
-                    int iR = (y * inWidth + maxX) * 4;
-                    inBytes[iR + 4] = inBytes[ iR ];
-                    inBytes[iR + 5] = inBytes[ iR + 1 ];
-                    inBytes[iR + 6] = inBytes[ iR + 2 ];
-                    inBytes[iR + 7] = inBytes[ iR + 3 ];
-                    }
+        if( solidPresentRight ) {
+            for( unsigned int y=minY; y<=maxY; y++ ) {
+                int iR = (y * inWidth + maxX) * 4;
+                inRGBA[iR + 4] = inRGBA[ iR ];
+                inRGBA[iR + 5] = inRGBA[ iR + 1 ];
+                inRGBA[iR + 6] = inRGBA[ iR + 2 ];
+                inRGBA[iR + 7] = inRGBA[ iR + 3 ];
                 }
-            
             }
         
         }
+    }
+
+
+
+void SingleTextureGL::setTextureData( unsigned char *inBytes,
+                                      char inAlphaOnly,
+                                      unsigned int inWidth, 
+                                      unsigned int inHeight,
+                                      char inExpandEdge ) {
+    
+    if( inExpandEdge && !inAlphaOnly ) {
+        expandEdges( inBytes, inWidth, inHeight );
+        }
     
 
     replaceBackupData( inBytes, inAlphaOnly, inWidth, inHeight );
@@ -494,3 +515,125 @@ void SingleTextureGL::replaceTextureData( unsigned char *inBytes,
     }
 
         
+
+
+
+void SingleTextureGL::replaceTextureRegion( unsigned char *inRGBA,
+                                            unsigned int inX, 
+                                            unsigned int inY,
+                                            unsigned int inWidth, 
+                                            unsigned int inHeight ) {
+    
+    if( mBackupBytes != NULL && !mAlphaOnly ) {
+        for( unsigned int y=0; y<inHeight; y++ ) {
+            memcpy( &( mBackupBytes[ ( ( inY + y ) * mWidthBackup + inX ) 
+                                     * 4 ] ),
+                    &( inRGBA[ y * inWidth * 4 ] ),
+                    inWidth * 4 );
+            }
+        }
+    
+
+    glBindTexture( GL_TEXTURE_2D, mTextureID );
+    sLastBoundTextureID = mTextureID;
+    
+    if( mMipMap ) {
+       #ifdef GL_GENERATE_MIPMAP
+            // don't rebuild whole mipmap chain for each region
+            glTexParameteri( GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE );
+       #endif
+        mMipMapsStale = true;
+        }
+    
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+    glTexSubImage2D( GL_TEXTURE_2D, 0,
+                     inX, inY,
+                     inWidth, inHeight, 
+                     GL_RGBA,
+                     GL_UNSIGNED_BYTE, inRGBA );
+
+	int error = glGetError();
+	if( error != GL_NO_ERROR ) {		// error
+		printf( "Error replacing texture region for id %d, error = %d\n",
+                (int)mTextureID, error );
+		}
+    }
+
+
+
+void SingleTextureGL::refreshMipMaps() {
+    if( !mMipMapsStale ) {
+        return;
+        }
+    mMipMapsStale = false;
+    
+    if( mBackupBytes == NULL || mAlphaOnly ) {
+        return;
+        }
+    
+    glBindTexture( GL_TEXTURE_2D, mTextureID );
+    sLastBoundTextureID = mTextureID;
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+   #ifdef GL_GENERATE_MIPMAP
+        glTexParameteri( GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE );
+        
+        // any change to level 0 rebuilds mipmaps
+        // send first row again
+        glTexSubImage2D( GL_TEXTURE_2D, 0,
+                         0, 0,
+                         mWidthBackup, 1,
+                         GL_RGBA,
+                         GL_UNSIGNED_BYTE, mBackupBytes );
+   #else
+        gluBuild2DMipmaps( GL_TEXTURE_2D,
+                           GL_RGBA, mWidthBackup,
+                           mHeightBackup,
+                           GL_RGBA, GL_UNSIGNED_BYTE, mBackupBytes );
+   #endif
+    }
+
+
+
+void SingleTextureGL::setFilters( char inLinearMagFilter, 
+                                  char inMipMapFilter ) {
+    if( inMipMapFilter ) {
+        if( mLastSetMinFilter != 2 ) {
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
+                             GL_LINEAR_MIPMAP_LINEAR );
+            mLastSetMinFilter = 2;
+            }
+        }
+    else {
+        
+        if( inLinearMagFilter ) {
+            if( mLastSetMinFilter != 1 ) {
+                glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
+                                 GL_LINEAR );
+                mLastSetMinFilter = 1;
+                }
+            }
+        else {
+            if( mLastSetMinFilter != 0 ) {
+                glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
+                                 GL_NEAREST );
+                mLastSetMinFilter = 0;
+                }
+            }
+        }
+    
+    if( inLinearMagFilter ) {
+        if( mLastSetMagFilter != 1 ) {
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+            mLastSetMagFilter = 1;
+            }
+        }
+    else {
+        if( mLastSetMagFilter != 0 ) {
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+            mLastSetMagFilter = 0;
+            }
+        }
+    }
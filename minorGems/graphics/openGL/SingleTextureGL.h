@@ -126,6 +126,27 @@ class SingleTextureGL {
                                  unsigned int inHeight );
         
 
+        /**
+         * Replaces a rectangle of RGBA data inside an RGBA texture.
+         * Rectangle must lie inside texture.
+         *
+         * For mipmapped textures, mipmaps are not rebuilt until 
+         * refreshMipMaps is called, so that many rectangles can be
+         * replaced for the cost of one rebuild.
+         */
+        void replaceTextureRegion( unsigned char *inRGBA,
+                                   unsigned int inX, unsigned int inY,
+                                   unsigned int inWidth, 
+                                   unsigned int inHeight );
+        
+
+        /**
+         * Rebuilds mipmaps after replaceTextureRegion calls.
+         * Does nothing if mipmaps are up to date.
+         */
+        void refreshMipMaps();
+        
+
 		
 		/**
 		 * Sets the data for this texture.
@@ -170,6 +191,24 @@ class SingleTextureGL {
 		void enable();	
 
 
+        /**
+         * Sets min and mag filters for this texture, skipping GL calls
+         * for filters that are already set.
+         *
+         * Texture must be enabled.
+         */
+        void setFilters( char inLinearMagFilter, char inMipMapFilter );
+        
+
+        /**
+         * Repeats hard edges of non-zero alpha area out by one pixel, as
+         * done by setTextureData when inExpandEdge is true.
+         */
+        static void expandEdges( unsigned char *inRGBA,
+                                 unsigned int inWidth, 
+                                 unsigned int inHeight );
+
+
         // tell all textures about a GL context change so they can reload
         // int texture memory
         static void contextChanged();
@@ -187,6 +226,16 @@ class SingleTextureGL {
         char mRepeat;
         char mMipMap;
         
+        // true if replaceTextureRegion has changed level 0 since mipmaps
+        // were last built
+        char mMipMapsStale;
+        
+        // -1 for unset, 0 for nearest, 1 for linear, 2 for mipmap
+        int mLastSetMinFilter;
+        
+        // -1 for unset, 0 for nearest, 1 for linear
+        int mLastSetMagFilter;
+        
 		GLuint mTextureID;
         
         char mAlphaOnly;
@@ -159,6 +159,38 @@ class Socket {
 		int send( unsigned char *inBuffer, int inNumBytes,
                   char inAllowedToBlock = true,
                   char inAllowDelay = true );
+
+
+        /**
+         * Sends several buffers through this socket, in order, with
+         * gather-write calls of up to 16 buffers each where the platform
+         * supports them.
+         *
+         * Never blocks.  Whether it waits for more data to accumulate
+         * is left to setAlwaysNoDelay, which callers flushing once per
+         * step should turn on when the socket is accepted.
+         *
+         * @param inBuffers the buffers of bytes to send.
+         * @param inNumBytes the number of bytes to send from each buffer.
+         * @param inNumBuffers the number of buffers.
+         *
+         * @return the total number of bytes sent successfully, which
+         *   may be fewer than requested if the socket's send buffer
+         *   filled up, or -1 for a socket error.
+         *   Returns -2 if no bytes could be sent without blocking.
+         */
+        int sendMulti( unsigned char **inBuffers, int *inNumBytes,
+                       int inNumBuffers );
+
+
+        /**
+         * Disables (or re-enables) the Nagle algorithm for every later
+         * send on this socket, once, instead of toggling it around each
+         * send that passes inAllowDelay=false.
+         *
+         * @param inNoDelay true to send each buffer NOW.
+         */
+        void setAlwaysNoDelay( char inNoDelay );
 		
 		
 		/**
@@ -283,6 +315,9 @@ class Socket {
         
         char mIsConnectionBroken;
         
+        // set by setAlwaysNoDelay, sends leave Nagle algorithm alone
+        char mAlwaysNoDelay;
+        
 
         // toggle Nagle algorithm (inValue=1 turns it off)
         void setNoDelay( int inValue );
@@ -293,8 +328,16 @@ class Socket {
 
 
 inline Socket::Socket()
-    : mConnected( true ), mIsConnectionBroken( false ) {
+    : mConnected( true ), mIsConnectionBroken( false ),
+      mAlwaysNoDelay( false ) {
+
+    }
+
+
 
+inline void Socket::setAlwaysNoDelay( char inNoDelay ) {
+    mAlwaysNoDelay = inNoDelay;
+    setNoDelay( inNoDelay );
     }
 
 
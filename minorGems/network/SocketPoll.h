@@ -12,6 +12,9 @@ typedef struct SocketOrServer {
         SocketServer *server;
 
         void *otherData;
+
+        // also watching socket for room to write
+        char watchWritable;
         
     } SocketOrServer;
 
@@ -52,6 +55,16 @@ class SocketPoll {
         void removeSocket( Socket *inSock );
         void removeSocketServer( SocketServer *inServer );
 
+
+        // turns watching an added socket for room to write on or off
+        //
+        // Off by default.  Turn it on only while there is data waiting
+        // to be sent, because a socket with room to write is returned
+        // by every wait call.
+        //
+        // returns true on success, false on failure
+        char setWatchWritable( Socket *inSock, char inWatch );
+
         
         // waits for next event, and returns socket or server that
         // needs attention, along with its original inOtherData
@@ -94,6 +94,7 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/errno.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -237,14 +238,14 @@ int Socket::send( unsigned char *inBuffer, int inNumBytes,
     
 
     if( inAllowedToBlock ) {
-        if( ! inAllowDelay ) {
+        if( ! inAllowDelay && ! mAlwaysNoDelay ) {
             // turn nodelay on
             setNoDelay( 1 );
             }
             
         int returnVal = ::send( mNativeSocketID, inBuffer, inNumBytes, 0 );
         
-        if( ! inAllowDelay ) {
+        if( ! inAllowDelay && ! mAlwaysNoDelay ) {
             // turn nodelay back off
             setNoDelay( 0 );
             }
@@ -260,7 +261,7 @@ int Socket::send( unsigned char *inBuffer, int inNumBytes,
             return result;
             }
         
-        if( ! inAllowDelay ) {
+        if( ! inAllowDelay && ! mAlwaysNoDelay ) {
             // turn nodelay on
             setNoDelay( 1 );
             }
@@ -271,7 +272,7 @@ int Socket::send( unsigned char *inBuffer, int inNumBytes,
                                   0 );
         
         
-        if( ! inAllowDelay ) {
+        if( ! inAllowDelay && ! mAlwaysNoDelay ) {
             // turn nodelay back off
             setNoDelay( 0 );
             }
@@ -295,6 +296,67 @@ int Socket::send( unsigned char *inBuffer, int inNumBytes,
     }
 		
 		
+int Socket::sendMulti( unsigned char **inBuffers, int *inNumBytes,
+                       int inNumBuffers ) {
+
+    // gather-write at most this many buffers per sendmsg call
+    struct iovec vec[ 16 ];
+
+    int numSent = 0;
+    
+    for( int start=0; start<inNumBuffers; start += 16 ) {
+        
+        int numInBatch = inNumBuffers - start;
+        
+        if( numInBatch > 16 ) {
+            numInBatch = 16;
+            }
+        
+        int batchBytes = 0;
+        
+        for( int i=0; i<numInBatch; i++ ) {
+            vec[i].iov_base = inBuffers[ start + i ];
+            vec[i].iov_len = inNumBytes[ start + i ];
+            
+            batchBytes += inNumBytes[ start + i ];
+            }
+        
+        struct msghdr header;
+        memset( &header, 0, sizeof( header ) );
+        
+        header.msg_iov = vec;
+        header.msg_iovlen = numInBatch;
+        
+        
+        // MSG_DONTWAIT instead of toggling O_NONBLOCK around the call
+        int returnValue = sendmsg( mNativeSocketID, &header, MSG_DONTWAIT );
+        int sendError = errno;
+        
+        if( returnValue < 0 ) {
+            if( numSent > 0 ) {
+                // report what made it through
+                return numSent;
+                }
+            
+            if( sendError == EAGAIN || sendError == EWOULDBLOCK ) {
+                return -2;
+                }
+            return -1;
+            }
+        
+        numSent += returnValue;
+        
+        if( returnValue < batchBytes ) {
+            // send buffer full
+            break;
+            }
+        }
+    
+    return numSent;
+    }
+
+
+
 int Socket::receive( unsigned char *inBuffer, int inNumBytes,
 	long inTimeout ) {
 	
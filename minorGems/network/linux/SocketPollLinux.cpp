@@ -58,6 +58,7 @@ char SocketPoll::addSocket( Socket *inSock, void *inOtherData ) {
     s->sock = inSock;
     s->server = NULL;
     s->otherData = inOtherData;
+    s->watchWritable = false;
     
     mWatchedList.push_back( s );
     
@@ -102,6 +103,7 @@ char SocketPoll::addSocketServer( SocketServer *inServer, void *inOtherData ) {
     s->sock = NULL;
     s->server = inServer;
     s->otherData = inOtherData;
+    s->watchWritable = false;
     
     mWatchedList.push_back( s );
     
@@ -151,6 +153,49 @@ void SocketPoll::removeSocket( Socket *inSock ) {
         }
     }
 
+char SocketPoll::setWatchWritable( Socket *inSock, char inWatch ) {
+    int *epollStorage = (int *)( mNativeObjectPointer );
+    int epollHandle = epollStorage[0];
+
+    if( epollHandle == -1 ) {
+        return false;
+        }
+
+	int socketID = inSock->mNativeSocketID;
+
+
+    for( int i=0; i<mWatchedList.size(); i++ ) {
+        SocketOrServer *s = *( mWatchedList.getElement( i ) );
+        if( s->sock == inSock ) {
+            
+            if( s->watchWritable == inWatch ) {
+                return true;
+                }
+            
+            struct epoll_event ev;
+            ev.events = EPOLLIN | EPOLLPRI | EPOLLERR | EPOLLHUP;
+            
+            if( inWatch ) {
+                ev.events |= EPOLLOUT;
+                }
+            
+            ev.data.u64 = 0;
+            ev.data.ptr = s;
+
+            int result = epoll_ctl( epollHandle, EPOLL_CTL_MOD, socketID, &ev );
+            
+            if( result == 0 ) {
+                s->watchWritable = inWatch;
+                return true;
+                }
+            return false;
+            }
+        }
+    return false;
+    }
+
+
+
 void SocketPoll::removeSocketServer( SocketServer *inServer ) {
     int *epollStorage = (int *)( mNativeObjectPointer );
     int epollHandle = epollStorage[0];
@@ -77,6 +77,7 @@ char SocketPoll::addSocket( Socket *inSock, void *inOtherData ) {
     s->sock = inSock;
     s->server = NULL;
     s->otherData = inOtherData;
+    s->watchWritable = false;
     
     mWatchedList.push_back( s );
     
@@ -94,6 +95,7 @@ char SocketPoll::addSocketServer( SocketServer *inServer, void *inOtherData ) {
     s->sock = NULL;
     s->server = inServer;
     s->otherData = inOtherData;
+    s->watchWritable = false;
     
     mWatchedList.push_back( s );
     
@@ -133,6 +135,21 @@ void SocketPoll::removeSocketServer( SocketServer *inServer ) {
 
 
 
+char SocketPoll::setWatchWritable( Socket *inSock, char inWatch ) {
+
+    for( int i=0; i<mWatchedList.size(); i++ ) {
+        SocketOrServer *s = *( mWatchedList.getElement( i ) );
+        if( s->sock == inSock ) {
+            s->watchWritable = inWatch;
+            return true;
+            }
+        }
+    return false;
+    }
+
+
+
+
 SocketOrServer *SocketPoll::wait( int inTimeoutMS ) {
     double startTime = Time::getCurrentTime();
     
@@ -165,8 +182,10 @@ SocketOrServer *SocketPoll::wait( int inTimeoutMS ) {
         SimpleVector<int> checkIDList;
 
         fd_set fdr;
+        fd_set fdw;
 
         FD_ZERO( &fdr );
+        FD_ZERO( &fdw );
 
         int maxSocketID = 0;
 
@@ -190,6 +209,10 @@ SocketOrServer *SocketPoll::wait( int inTimeoutMS ) {
             checkIDList.push_back( socketID );
 
             FD_SET( socketID, &fdr );
+
+            if( s->isSocket && s->watchWritable ) {
+                FD_SET( socketID, &fdw );
+                }
             
             if( socketID > maxSocketID ) {
                 maxSocketID = socketID;
@@ -253,7 +276,7 @@ SocketOrServer *SocketPoll::wait( int inTimeoutMS ) {
             }
         
 
-        int ret = select( maxSocketID + 1, &fdr, NULL, NULL, tvPointer );
+        int ret = select( maxSocketID + 1, &fdr, &fdw, NULL, tvPointer );
 
         if( ret > 0 ) {
             
@@ -263,7 +286,9 @@ SocketOrServer *SocketPoll::wait( int inTimeoutMS ) {
             
             for( int i=0; i<numChecked; i++ ) {
                 
-                if( FD_ISSET( checkIDList.getElementDirect( i ), &fdr ) ) {
+                int id = checkIDList.getElementDirect( i );
+                
+                if( FD_ISSET( id, &fdr ) || FD_ISSET( id, &fdw ) ) {
                     
                     mReadyList.push_back( checkList.getElementDirect( i ) );
                     }
@@ -228,14 +228,14 @@ int Socket::send( unsigned char *inBuffer, int inNumBytes,
 	unsigned int socketID = mNativeSocketID;
 
     if( inAllowedToBlock ) {
-        if( ! inAllowDelay ) {
+        if( ! inAllowDelay && ! mAlwaysNoDelay ) {
             // turn nodelay on
             setNoDelay( 1 );
             }        
         
         int returnVal = ::send( socketID, (char*)inBuffer, inNumBytes, 0 );
         
-        if( ! inAllowDelay ) {
+        if( ! inAllowDelay && ! mAlwaysNoDelay ) {
             // turn nodelay back off
             setNoDelay( 0 );
             }
@@ -247,14 +247,14 @@ int Socket::send( unsigned char *inBuffer, int inNumBytes,
         u_long socketMode = 1;
         ioctlsocket( socketID, FIONBIO, &socketMode );
 
-        if( ! inAllowDelay ) {
+        if( ! inAllowDelay && ! mAlwaysNoDelay ) {
             // turn nodelay on
             setNoDelay( 1 );
             }
 
         int result = ::send( socketID, (char*)inBuffer, inNumBytes, 0 );
         
-        if( ! inAllowDelay ) {
+        if( ! inAllowDelay && ! mAlwaysNoDelay ) {
             // turn nodelay back off
             setNoDelay( 0 );
             }
@@ -278,6 +278,36 @@ int Socket::send( unsigned char *inBuffer, int inNumBytes,
 		
 		
 		
+int Socket::sendMulti( unsigned char **inBuffers, int *inNumBytes,
+                       int inNumBuffers ) {
+
+    // no gather write in plain winsock, send buffers one at a time
+    int numSent = 0;
+    
+    for( int i=0; i<inNumBuffers; i++ ) {
+        int result = send( inBuffers[i], inNumBytes[i], false );
+        
+        if( result < 0 ) {
+            if( numSent > 0 ) {
+                // report what made it through
+                return numSent;
+                }
+            return result;
+            }
+        
+        numSent += result;
+        
+        if( result < inNumBytes[i] ) {
+            // send buffer full
+            break;
+            }
+        }
+
+    return numSent;
+    }
+
+
+
 int Socket::receive( unsigned char *inBuffer, int inNumBytes,
 	long inTimeout ) {
 	
@@ -59,6 +59,10 @@
 #include "minorGems/crypto/hashes/sha1.h"
 
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
 
 // will be destroyed automatically at program termination
 SettingsManagerStaticMembers SettingsManager::mStaticMembers;
@@ -67,9 +71,95 @@ char SettingsManager::mHashingOn = false;
 
 
 
+// what we know about a settings file without opening it
+typedef struct FileStamp {
+        char exists;
+        time_t modTime;
+        off_t size;
+    } FileStamp;
+
+
+
+static FileStamp getFileStamp( const char *inFileName ) {
+    FileStamp stamp = { false, 0, 0 };
+    
+    struct stat fileInfo;
+    
+    if( stat( inFileName, &fileInfo ) == 0 ) {
+        stamp.exists = true;
+        stamp.modTime = fileInfo.st_mtime;
+        stamp.size = fileInfo.st_size;
+        }
+    return stamp;
+    }
+
+
+
+static char sameStamp( FileStamp inA, FileStamp inB ) {
+    return inA.exists == inB.exists &&
+        inA.modTime == inB.modTime &&
+        inA.size == inB.size;
+    }
+
+
+
+struct SettingsCacheRecord {
+        char *name;
+        
+        char *fileName;
+        char *hashFileName;
+        
+        // NULL if setting couldn't be read
+        char *contents;
+        
+        // files as they were just before we read them
+        FileStamp stamp;
+        FileStamp hashStamp;
+        
+        double readTime;
+        double lastCheckTime;
+    };
+
+
+
+static void deleteCacheRecord( SettingsCacheRecord *inRecord ) {
+    delete [] inRecord->name;
+    delete [] inRecord->fileName;
+    delete [] inRecord->hashFileName;
+    
+    if( inRecord->contents != NULL ) {
+        delete [] inRecord->contents;
+        }
+    delete inRecord;
+    }
+
+
+
+static int getCacheBucket( const char *inSettingName ) {
+    unsigned int hash = 5381;
+    
+    for( const char *c = inSettingName; *c != '\0'; c++ ) {
+        hash = hash * 33 + (unsigned char)( *c );
+        }
+    return hash % SETTINGS_MANAGER_CACHE_BUCKETS;
+    }
+
+
+
+// file modification times only have 1-second resolution, so a file that
+// changed in the same second that we read it might change again without
+// its stamp changing
+// don't trust stamps until file is older than this when we read it
+#define RACY_STAMP_SECONDS 2
+
+
+
 void SettingsManager::setDirectoryName( const char *inName ) {
     delete [] mStaticMembers.mDirectoryName;
     mStaticMembers.mDirectoryName = stringDuplicate( inName );
+    
+    // cached file names no longer valid
+    clearCache();
     }
 
 
@@ -83,6 +173,8 @@ char *SettingsManager::getDirectoryName() {
 void SettingsManager::setHashSalt( const char *inSalt ) {
     delete [] mStaticMembers.mHashSalt;
     mStaticMembers.mHashSalt = stringDuplicate( inSalt );
+    
+    clearCache();
     }
 
 
@@ -95,6 +187,34 @@ char *SettingsManager::getHashSalt() {
 
 void SettingsManager::setHashingOn( char inOn ) {
     mHashingOn = inOn;
+    
+    clearCache();
+    }
+
+
+
+void SettingsManager::setCacheCheckInterval( double inSeconds ) {
+    mStaticMembers.mCacheLock.lock();
+    mStaticMembers.mCacheCheckInterval = inSeconds;
+    mStaticMembers.mCacheLock.unlock();
+    }
+
+
+
+void SettingsManager::clearCache() {
+    mStaticMembers.mCacheLock.lock();
+    
+    for( int b=0; b<SETTINGS_MANAGER_CACHE_BUCKETS; b++ ) {
+        SimpleVector<SettingsCacheRecord*> *bucket = 
+            &( mStaticMembers.mCache[b] );
+        
+        for( int i=0; i<bucket->size(); i++ ) {
+            deleteCacheRecord( bucket->getElementDirect( i ) );
+            }
+        bucket->deleteAll();
+        }
+    
+    mStaticMembers.mCacheLock.unlock();
     }
 
 
@@ -214,6 +334,106 @@ SimpleVector<double> *SettingsManager::getDoubleSettingMulti(
 
 
 char *SettingsManager::getSettingContents( const char *inSettingName ) {
+    
+    mStaticMembers.mCacheLock.lock();
+    
+    double interval = mStaticMembers.mCacheCheckInterval;
+    
+    if( interval < 0 ) {
+        mStaticMembers.mCacheLock.unlock();
+        return readSettingContents( inSettingName );
+        }
+    
+
+    SimpleVector<SettingsCacheRecord*> *bucket = 
+        &( mStaticMembers.mCache[ getCacheBucket( inSettingName ) ] );
+    
+    SettingsCacheRecord *record = NULL;
+    
+    for( int i=0; i<bucket->size(); i++ ) {
+        SettingsCacheRecord *r = bucket->getElementDirect( i );
+        
+        if( strcmp( r->name, inSettingName ) == 0 ) {
+            record = r;
+            break;
+            }
+        }
+    
+    double curTime = Time::getCurrentTime();
+    
+    if( record == NULL ) {
+        record = new SettingsCacheRecord;
+        
+        record->name = stringDuplicate( inSettingName );
+        record->fileName = getSettingsFileName( inSettingName );
+        record->hashFileName = getSettingsFileName( inSettingName, "hash" );
+        record->contents = NULL;
+        
+        // force read below
+        record->readTime = 0;
+        record->lastCheckTime = curTime - interval - 1;
+        record->stamp.exists = false;
+        
+        bucket->push_back( record );
+        }
+    
+    
+    if( curTime - record->lastCheckTime >= interval ) {
+        // time to see whether files have changed
+        
+        FileStamp stamp = getFileStamp( record->fileName );
+        
+        FileStamp hashStamp = { false, 0, 0 };
+        
+        if( mHashingOn ) {
+            hashStamp = getFileStamp( record->hashFileName );
+            }
+        
+        
+        char changed = 
+            record->readTime == 0 ||
+            ! sameStamp( stamp, record->stamp ) ||
+            ! sameStamp( hashStamp, record->hashStamp );
+        
+        if( ! changed && 
+            ( stamp.modTime + RACY_STAMP_SECONDS > record->readTime ||
+              hashStamp.modTime + RACY_STAMP_SECONDS > record->readTime ) ) {
+            // files were modified right around when we read them
+            // can't tell from stamps whether they changed again
+            changed = true;
+            }
+        
+        if( changed ) {
+            if( record->contents != NULL ) {
+                delete [] record->contents;
+                }
+            
+            // stamps taken before reading, so a change during read
+            // is caught next time
+            record->contents = readSettingContents( inSettingName );
+            record->stamp = stamp;
+            record->hashStamp = hashStamp;
+            record->readTime = curTime;
+            }
+        
+        record->lastCheckTime = curTime;
+        }
+    
+    
+    char *contents = NULL;
+    
+    if( record->contents != NULL ) {
+        contents = stringDuplicate( record->contents );
+        }
+    
+    mStaticMembers.mCacheLock.unlock();
+    
+    return contents;
+    }
+
+
+
+char *SettingsManager::readSettingContents( const char *inSettingName ) {
 
     char *fileName = getSettingsFileName( inSettingName );
     File *settingsFile = new File( NULL, fileName );
@@ -533,6 +753,25 @@ void SettingsManager::setSetting( const char *inSettingName,
         
         fclose( file );
         }
+    
+
+    // drop any cached copy, so next read sees what we just wrote
+    mStaticMembers.mCacheLock.lock();
+    
+    SimpleVector<SettingsCacheRecord*> *bucket = 
+        &( mStaticMembers.mCache[ getCacheBucket( inSettingName ) ] );
+    
+    for( int i=0; i<bucket->size(); i++ ) {
+        SettingsCacheRecord *r = bucket->getElementDirect( i );
+        
+        if( strcmp( r->name, inSettingName ) == 0 ) {
+            deleteCacheRecord( r );
+            bucket->deleteElement( i );
+            break;
+            }
+        }
+    
+    mStaticMembers.mCacheLock.unlock();
     }
 
 
@@ -639,7 +878,8 @@ char *SettingsManager::getSettingsFileName( const char *inSettingName,
 
 SettingsManagerStaticMembers::SettingsManagerStaticMembers()
     : mDirectoryName( stringDuplicate( "settings" ) ),
-      mHashSalt( stringDuplicate( "default_salt" ) ) {
+      mHashSalt( stringDuplicate( "default_salt" ) ),
+      mCacheCheckInterval( 2 ) {
     
     }
 
@@ -648,5 +888,11 @@ SettingsManagerStaticMembers::SettingsManagerStaticMembers()
 SettingsManagerStaticMembers::~SettingsManagerStaticMembers() {
     delete [] mDirectoryName;
     delete [] mHashSalt;
+    
+    for( int b=0; b<SETTINGS_MANAGER_CACHE_BUCKETS; b++ ) {
+        for( int i=0; i<mCache[b].size(); i++ ) {
+            deleteCacheRecord( mCache[b].getElementDirect( i ) );
+            }
+        }
     }
 
@@ -68,6 +68,12 @@
 class SettingsManagerStaticMembers;
 
 
+// one setting's cached file contents, defined in SettingsManager.cpp
+struct SettingsCacheRecord;
+
+#define SETTINGS_MANAGER_CACHE_BUCKETS 256
+
+
 
 /**
  * Class that manages program settings.
@@ -133,6 +139,36 @@ class SettingsManager {
         static void setHashingOn( char inOn );
 
 
+
+        /**
+         * Sets how long a setting read from disk is trusted before
+         * checking whether its file has changed.
+         *
+         * Settings are cached in RAM after the first read, so reads
+         * inside this window never touch the filesystem.  After it, the
+         * next read stats the setting's file (and hash file, if hashing
+         * is on), and only reads it again if it has changed.  Edits made
+         * to settings files while the program runs are therefore seen
+         * within this many seconds.
+         *
+         * Settings changed through setSetting are seen right away.
+         *
+         * Defaults to 2 seconds.
+         *
+         * @param inSeconds the interval, or 0 to check file on every read,
+         *   or -1 to turn cache off and read file on every read.
+         */
+        static void setCacheCheckInterval( double inSeconds );
+
+
+
+        /**
+         * Drops all cached settings, so that the next read of each
+         * setting goes to disk.
+         */
+        static void clearCache();
+
+
         
         /**
          * Gets a setting, tokenized by whitespace into separate strings.
@@ -405,6 +441,20 @@ class SettingsManager {
          */
         static char *getSettingsFileName( const char *inSettingName,
                                           const char *inExtension );
+
+
+        /**
+         * Reads the contents of a setting's file, checking its hash.
+         * Same as getSettingContents, but without the cache.
+         *
+         * @param inSettingName the name of the setting.
+         *   Must be destroyed by caller if non-const.
+         *
+         * @return file contents, or NULL if file can't be read, or its
+         *   hash doesn't match.
+         *   Must be destroyed by caller.
+         */
+        static char *readSettingContents( const char *inSettingName );
         
     };
 
@@ -429,6 +479,15 @@ class SettingsManagerStaticMembers {
         
         char *mDirectoryName;
         char *mHashSalt;
+
+        // cached settings, hashed by name
+        SimpleVector<SettingsCacheRecord*> 
+            mCache[ SETTINGS_MANAGER_CACHE_BUCKETS ];
+        
+        // cache can be read from several threads
+        MutexLock mCacheLock;
+        
+        double mCacheCheckInterval;
         
 
 
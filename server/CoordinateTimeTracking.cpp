@@ -1,133 +1,233 @@
 #include "CoordinateTimeTracking.h"
 
+#include <stdint.h>
+#include <string.h>
+
+
+#define MIN_TABLE_SIZE 64
+
+
+
+static uint32_t hashCoordinates( int inX, int inY ) {
+    uint32_t h = (uint32_t)inX * 2654435761U;
+    h ^= (uint32_t)inY * 2246822519U;
+    h ^= h >> 15;
+    return h;
+    }
+
 
 
 CoordinateTimeTracking::CoordinateTimeTracking()
-        :mNextIndex( 0 ) {
+        : mTableSize( MIN_TABLE_SIZE ),
+          mNumRecords( 0 ) {
+
+    mRecords = new CoordinateXYRecord[ mTableSize ];
+    mUsed = new char[ mTableSize ];
+    memset( mUsed, false, mTableSize );
     }
 
 
 
+CoordinateTimeTracking::~CoordinateTimeTracking() {
+    delete [] mRecords;
+    delete [] mUsed;
 
-char CoordinateTimeTracking::checkExists( int inX, int inY, 
-                                          timeSec_t inCurTime ) {
-    
-    int dir = 1;
-    
-    int numRecords = mRecords.size();
-    
-
-    if( numRecords > 0 ) {
-        
-        CoordinateXYRecord *testR = mRecords.getElement( mNextIndex );
-
-        if( testR->y == inY &&
-            testR->x == inX ) {
-            
-            testR->t = inCurTime;
-            
-            return true;
+    for( int i=0; i<mBuckets.size(); i++ ) {
+        delete mBuckets.getElementDirect( i ).coords;
+        }
+    }
+
+
+
+int CoordinateTimeTracking::getNumRecords() {
+    return mNumRecords;
+    }
+
+
+
+int CoordinateTimeTracking::findSlot( int inX, int inY ) {
+    int mask = mTableSize - 1;
+
+    int i = hashCoordinates( inX, inY ) & mask;
+
+    while( mUsed[i] ) {
+        if( mRecords[i].x == inX && mRecords[i].y == inY ) {
+            break;
+            }
+        i = ( i + 1 ) & mask;
+        }
+
+    return i;
+    }
+
+
+
+void CoordinateTimeTracking::resizeTable( int inNewSize ) {
+    CoordinateXYRecord *oldRecords = mRecords;
+    char *oldUsed = mUsed;
+    int oldSize = mTableSize;
+
+    mTableSize = inNewSize;
+    mRecords = new CoordinateXYRecord[ mTableSize ];
+    mUsed = new char[ mTableSize ];
+    memset( mUsed, false, mTableSize );
+
+    for( int i=0; i<oldSize; i++ ) {
+        if( oldUsed[i] ) {
+            int slot = findSlot( oldRecords[i].x, oldRecords[i].y );
+
+            mRecords[slot] = oldRecords[i];
+            mUsed[slot] = true;
             }
+        }
+
+    delete [] oldRecords;
+    delete [] oldUsed;
+    }
 
 
-        if( testR->y > inY ||
-            ( testR->y == inY 
-              && 
-              testR->x > inX ) ) {
-            dir = -1;
+
+void CoordinateTimeTracking::removeRecord( int inSlot ) {
+    int mask = mTableSize - 1;
+
+    int hole = inSlot;
+    mUsed[hole] = false;
+    mNumRecords--;
+
+    // shift later records in probe run back, so no lookup stops early
+    // at the hole
+    int i = hole;
+
+    while( true ) {
+        i = ( i + 1 ) & mask;
+
+        if( ! mUsed[i] ) {
+            break;
             }
 
+        int home = hashCoordinates( mRecords[i].x, mRecords[i].y ) & mask;
 
-        if( dir == 1 ) {
-            for( mNextIndex = mNextIndex; 
-                 mNextIndex < numRecords; mNextIndex ++ ) {
-                
-                CoordinateXYRecord *r = mRecords.getElement( mNextIndex );
-                if( r->y == inY &&
-                    r->x == inX ) {
-                    
-                    r->t = inCurTime;
-                    
-                    return true;
-                    }
-                
-                if( r->y > inY ||
-                    ( r->y == inY &&
-                      r->x > inX ) ) {
-                    // walked past spot and not found
-                    // keep mNextIndex as insert point
-                    break;
-                    }
-                }
+        // distance walked from home to reach i, and to reach hole
+        int distToI = ( i - home ) & mask;
+        int distToHole = ( hole - home ) & mask;
+
+        if( distToHole < distToI ) {
+            // hole is on record's probe path, move it there
+            mRecords[hole] = mRecords[i];
+            mUsed[hole] = true;
+            mUsed[i] = false;
+            hole = i;
             }
-        else if( dir == -1 ) {
-            for( mNextIndex = mNextIndex; mNextIndex > -1; mNextIndex -- ) {
-                CoordinateXYRecord *r = mRecords.getElement( mNextIndex );
-                if( r->y == inY &&
-                    r->x == inX ) {
-                    
-                    r->t = inCurTime;
-                    
-                    return true;
-                    }
-                
-                if( r->y < inY ||
-                    ( r->y == inY &&
-                      r->x < inX ) ) {
-                    // walked past spot and not found
-                    // keep mNextIndex as insert point
-                    break;
-                    }
-                }
+        }
+    }
+
+
+
+void CoordinateTimeTracking::addToBucket( int inX, int inY,
+                                          timeSec_t inTime ) {
+    int numBuckets = mBuckets.size();
+
+    CoordinateTimeBucket *b = NULL;
+
+    if( numBuckets > 0 ) {
+        b = mBuckets.getElement( numBuckets - 1 );
+
+        if( b->t != inTime ) {
+            b = NULL;
             }
         }
-    else {
-        // no records, use this as insertion point
-        mNextIndex = 0;
+
+    if( b == NULL ) {
+        CoordinateTimeBucket newBucket =
+            { inTime, new SimpleVector<CoordinateXY>() };
+
+        mBuckets.push_back( newBucket );
+
+        b = mBuckets.getElement( numBuckets );
+        }
+
+    CoordinateXY c = { inX, inY };
+    b->coords->push_back( c );
+    }
+
+
+
+char CoordinateTimeTracking::checkExists( int inX, int inY,
+                                          timeSec_t inCurTime ) {
+
+    int slot = findSlot( inX, inY );
+
+    if( mUsed[slot] ) {
+        CoordinateXYRecord *r = &( mRecords[slot] );
+
+        if( r->t != inCurTime ) {
+            r->t = inCurTime;
+            addToBucket( inX, inY, inCurTime );
+            }
+        return true;
         }
-    
+
 
     // not found
-    
+
     // insert new
     CoordinateXYRecord r = { inX, inY, inCurTime };
-    
-    if( mNextIndex == numRecords ) {
-        // stick on end
-        mRecords.push_back( r );
-        }
-    else if( mNextIndex == -1 ) {
-        // stick on front
-        mRecords.push_front( r );
-        mNextIndex = 0;
-        }
-    else {
-        mRecords.push_middle( r, mNextIndex );
+
+    mRecords[slot] = r;
+    mUsed[slot] = true;
+    mNumRecords++;
+
+    addToBucket( inX, inY, inCurTime );
+
+    if( mNumRecords * 2 > mTableSize ) {
+        resizeTable( mTableSize * 2 );
         }
+
     return false;
     }
 
 
 
 void CoordinateTimeTracking::cleanStale( timeSec_t inStaleTime ) {
-    int beforeCleanSize = mRecords.size();
-    
-    // pre-allocate space
-    SimpleVector<CoordinateXYRecord> temp( beforeCleanSize );
-    
-    
-    for( int i=0; i<mRecords.size(); i++ ) {
-        CoordinateXYRecord *r = mRecords.getElement( i );
-        
-        if( r->t > inStaleTime ) {
-            temp.push_back( *r );
+
+    int numCleaned = 0;
+
+    while( numCleaned < mBuckets.size() ) {
+        CoordinateTimeBucket *b = mBuckets.getElement( numCleaned );
+
+        if( b->t > inStaleTime ) {
+            break;
+            }
+
+        for( int i=0; i<b->coords->size(); i++ ) {
+            CoordinateXY *c = b->coords->getElement( i );
+
+            int slot = findSlot( c->x, c->y );
+
+            if( mUsed[slot] && mRecords[slot].t <= inStaleTime ) {
+                removeRecord( slot );
+                }
             }
+
+        delete b->coords;
+        numCleaned++;
         }
-    mRecords.deleteAll();
-    mRecords.push_back_other( &temp );
-    
 
-    // start index over after cleaning
-    mNextIndex = 0;
+    if( numCleaned == 0 ) {
+        return;
+        }
+
+    mBuckets.deleteStartElements( numCleaned );
+
+
+    int newSize = mTableSize;
+
+    while( newSize > MIN_TABLE_SIZE && mNumRecords * 8 < newSize ) {
+        newSize /= 2;
+        }
+
+    if( newSize != mTableSize ) {
+        resizeTable( newSize );
+        }
     }
 
@@ -11,11 +11,27 @@ typedef struct CoordinateXYRecord {
 
 
 
+typedef struct CoordinateXY {
+        int x, y;
+    } CoordinateXY;
+
+
+
+// coordinates whose time was set to t
+typedef struct CoordinateTimeBucket {
+        timeSec_t t;
+        SimpleVector<CoordinateXY> *coords;
+    } CoordinateTimeBucket;
+
+
+
 class CoordinateTimeTracking {
     public:
 
         CoordinateTimeTracking();
 
+        ~CoordinateTimeTracking();
+
 
         // returns true if exists, or false if not (and new record created if
         // not).  If exists, time of record will be updated to inCurTime
@@ -23,18 +39,47 @@ class CoordinateTimeTracking {
 
         // any records with times equal to or older than inStaleTime will be
         // cleared
+        //
+        // only looks at records whose time has come up since the last
+        // clean, not at every record
         void cleanStale( timeSec_t inStaleTime );
 
 
+        int getNumRecords();
+
+
     private:
 
-        SimpleVector<CoordinateXYRecord> mRecords;
-        
-        // track index across searches as starting point for next
-        // search, because usually coordinates are checked in
-        // row-major order (a rectangular look region)
-        int mNextIndex;
-        
+        // open addressing with linear probing
+        // size is a power of 2, and table is at most half full
+        CoordinateXYRecord *mRecords;
+        char *mUsed;
+        int mTableSize;
+
+        int mNumRecords;
+
+
+        // every time a record's time changes, its coordinates are added
+        // to the bucket for the new time
+        // buckets are in the order they were made, oldest first
+        //
+        // when a bucket is cleaned, coordinates whose record has a newer
+        // time by then are skipped
+        //
+        // if time ever runs backwards, records in a bucket made after that
+        // are cleaned a bit late, but never too early
+        SimpleVector<CoordinateTimeBucket> mBuckets;
+
+
+        // slot holding record, or empty slot where it should go
+        int findSlot( int inX, int inY );
+
+        void resizeTable( int inNewSize );
+
+        void removeRecord( int inSlot );
+
+        void addToBucket( int inX, int inY, timeSec_t inTime );
+
     };
 
-    
+
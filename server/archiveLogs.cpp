@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include "logArchive.h"
+
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/system/Time.h"
+
+
+
+void usage() {
+    printf( "Usage:\n" );
+    printf( "archiveLogs path_to_server_dir [archive_dir] [num_threads]\n\n" );
+
+    printf( "Converts life, food, and curse logs into a compact archive\n" );
+    printf( "that report tools can read instead of the text logs.\n" );
+    printf( "Only new or changed log files are converted on each run.\n\n" );
+
+    printf( "archive_dir defaults to path_to_server_dir/logArchive\n" );
+    printf( "num_threads defaults to 4\n\n" );
+
+    printf( "Example:\n" );
+    printf( "archiveLogs ~/checkout/OneLife/server\n\n" );
+
+    exit( 1 );
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    if( inNumArgs < 2 || inNumArgs > 4 ) {
+        usage();
+        }
+
+    char *path = inArgs[1];
+
+    if( path[strlen(path) - 1] == '/' ) {
+        path[strlen(path) - 1] = '\0';
+        }
+
+    char *archivePath;
+
+    if( inNumArgs > 2 ) {
+        archivePath = stringDuplicate( inArgs[2] );
+        }
+    else {
+        archivePath = autoSprintf( "%s/logArchive", path );
+        }
+
+    int numThreads = 4;
+
+    if( inNumArgs > 3 ) {
+        sscanf( inArgs[3], "%d", &numThreads );
+        }
+
+
+    double startTime = Time::getCurrentTime();
+
+    int numConverted = convertLogsToArchive( path, archivePath, numThreads );
+
+    if( numConverted < 0 ) {
+        delete [] archivePath;
+        return 1;
+        }
+
+    printf( "Converted %d log files into %s in %.2f seconds\n",
+            numConverted, archivePath, Time::getCurrentTime() - startTime );
+
+    delete [] archivePath;
+
+    return 0;
+    }
@@ -0,0 +1,191 @@
+#include "chunkBuilder.h"
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/BinarySemaphore.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/log/AppLog.h"
+
+
+
+struct ChunkBuildJob {
+        MapChunkSnapshot *snapshot;
+        
+        // set once a worker (or finishChunkBuild) has taken job off queue
+        char claimed;
+        
+        unsigned char *message;
+        int messageLength;
+        
+        // signaled by worker when message is ready
+        BinarySemaphore doneSemaphore;
+    };
+
+
+
+static MutexLock queueLock;
+
+// signaled when jobs are queued
+// a binary semaphore can collapse several signals into one, so a worker
+// that wakes passes the signal on while jobs remain, and every worker
+// checks the queue before waiting again
+static BinarySemaphore jobsAvailable;
+
+static SimpleVector<ChunkBuildJob*> jobQueue;
+
+static char stopWorkers = false;
+
+
+
+// pops next unclaimed job, or returns NULL
+// queueLock must be held
+static ChunkBuildJob *claimNextJob() {
+    if( jobQueue.size() == 0 ) {
+        return NULL;
+        }
+    
+    ChunkBuildJob *job = jobQueue.getElementDirect( 0 );
+    jobQueue.deleteElement( 0 );
+    
+    job->claimed = true;
+    
+    return job;
+    }
+
+
+
+class ChunkBuilderThread : public Thread {
+    public:
+        
+        ChunkBuilderThread() {
+            start();
+            }
+        
+        virtual void run() {
+            while( true ) {
+                queueLock.lock();
+                
+                if( stopWorkers ) {
+                    queueLock.unlock();
+                    
+                    // wake next worker so it can stop too
+                    jobsAvailable.signal();
+                    return;
+                    }
+                
+                ChunkBuildJob *job = claimNextJob();
+                
+                char moreJobs = ( jobQueue.size() > 0 );
+                
+                queueLock.unlock();
+                
+                if( job == NULL ) {
+                    jobsAvailable.wait();
+                    continue;
+                    }
+                
+                if( moreJobs ) {
+                    jobsAvailable.signal();
+                    }
+                
+                job->message = 
+                    encodeChunkSnapshot( job->snapshot,
+                                         &( job->messageLength ) );
+                job->snapshot = NULL;
+                    
+                job->doneSemaphore.signal();
+                }
+            }
+    };
+
+
+
+static SimpleVector<ChunkBuilderThread*> workers;
+
+
+
+void initChunkBuilder( int inNumThreads ) {
+    stopWorkers = false;
+    
+    for( int i=0; i<inNumThreads; i++ ) {
+        workers.push_back( new ChunkBuilderThread() );
+        }
+    
+    if( inNumThreads > 0 ) {
+        AppLog::infoF( "Building map chunks with %d worker threads",
+                       inNumThreads );
+        }
+    }
+
+
+
+void freeChunkBuilder() {
+    queueLock.lock();
+    stopWorkers = true;
+    queueLock.unlock();
+    
+    jobsAvailable.signal();
+    
+    for( int i=0; i<workers.size(); i++ ) {
+        ChunkBuilderThread *t = workers.getElementDirect( i );
+        t->join();
+        delete t;
+        }
+    workers.deleteAll();
+    }
+
+
+
+ChunkBuildJob *startChunkBuild( MapChunkSnapshot *inSnapshot ) {
+    ChunkBuildJob *job = new ChunkBuildJob;
+    
+    job->snapshot = inSnapshot;
+    job->claimed = false;
+    job->message = NULL;
+    job->messageLength = 0;
+    
+    if( workers.size() > 0 ) {
+        queueLock.lock();
+        jobQueue.push_back( job );
+        queueLock.unlock();
+        
+        jobsAvailable.signal();
+        }
+    
+    return job;
+    }
+
+
+
+unsigned char *finishChunkBuild( ChunkBuildJob *inJob,
+                                 int *outMessageLength ) {
+    
+    queueLock.lock();
+    
+    char claimedHere = false;
+    
+    if( ! inJob->claimed ) {
+        // still waiting in queue (or no workers), don't wait for it
+        jobQueue.deleteElementEqualTo( inJob );
+        inJob->claimed = true;
+        claimedHere = true;
+        }
+    
+    queueLock.unlock();
+    
+
+    if( claimedHere ) {
+        inJob->message = encodeChunkSnapshot( inJob->snapshot,
+                                              &( inJob->messageLength ) );
+        }
+    else {
+        inJob->doneSemaphore.wait();
+        }
+    
+    unsigned char *message = inJob->message;
+    *outMessageLength = inJob->messageLength;
+    
+    delete inJob;
+    
+    return message;
+    }
@@ -0,0 +1,42 @@
+#ifndef CHUNK_BUILDER_H_INCLUDED
+#define CHUNK_BUILDER_H_INCLUDED
+
+
+#include "map.h"
+
+
+
+// Pool of worker threads that encode and compress map chunk messages
+// from snapshots taken on the main thread.
+//
+// Encoding (string formatting and zipCompress) is most of the cost of a
+// chunk message, and it touches nothing but the snapshot, so chunks for
+// many players can be built in parallel while the main thread keeps
+// gathering more snapshots.
+
+
+typedef struct ChunkBuildJob ChunkBuildJob;
+
+
+
+// 0 threads means jobs are encoded inline in finishChunkBuild
+void initChunkBuilder( int inNumThreads );
+
+// waits for running jobs to finish
+// jobs that were never finished are leaked, so finish them all first
+void freeChunkBuilder();
+
+
+// takes ownership of inSnapshot
+ChunkBuildJob *startChunkBuild( MapChunkSnapshot *inSnapshot );
+
+
+// blocks until job is done, then destroys job
+// a job that no worker has picked up yet is encoded on the calling thread
+//
+// returns message like getChunkMessage, destroyed by caller
+unsigned char *finishChunkBuild( ChunkBuildJob *inJob,
+                                 int *outMessageLength );
+
+
+#endif
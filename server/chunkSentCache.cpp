@@ -0,0 +1,153 @@
+#include "chunkSentCache.h"
+
+#include "../commonSource/binaryMapChunk.h"
+
+#include <string.h>
+
+
+
+ChunkSentCache *newChunkSentCache() {
+    ChunkSentCache *cache = new ChunkSentCache;
+    
+    int numCells = MAP_CHUNK_CACHE_D * MAP_CHUNK_CACHE_D;
+    
+    cache->cells = new ChunkSentCacheCell[ numCells ];
+    
+    memset( cache->cells, 0, numCells * sizeof( ChunkSentCacheCell ) );
+    
+    cache->generation = 0;
+    
+    return cache;
+    }
+
+
+
+void freeChunkSentCache( ChunkSentCache *inCache ) {
+    delete [] inCache->cells;
+    delete inCache;
+    }
+
+
+
+// FNV-1a, 64-bit
+static uint64_t hashInt( uint64_t inHash, int inValue ) {
+    unsigned int v = (unsigned int)inValue;
+    
+    for( int b=0; b<4; b++ ) {
+        inHash = ( inHash ^ ( v & 0xFF ) ) * 1099511628211ULL;
+        v >>= 8;
+        }
+    return inHash;
+    }
+
+
+
+uint64_t *getChunkSnapshotCellHashes( MapChunkSnapshot *inSnapshot ) {
+    int numCells = inSnapshot->width * inSnapshot->height;
+    
+    uint64_t *hashes = new uint64_t[ numCells ];
+    
+    for( int i=0; i<numCells; i++ ) {
+        uint64_t h = 14695981039346656037ULL;
+        
+        h = hashInt( h, inSnapshot->biomes[i] );
+        h = hashInt( h, inSnapshot->floors[i] );
+        h = hashInt( h, inSnapshot->objects[i] );
+        
+        if( inSnapshot->containedStacks[i] != NULL ) {
+            h = hashInt( h, inSnapshot->containedStackSizes[i] );
+            
+            for( int c=0; c<inSnapshot->containedStackSizes[i]; c++ ) {
+                h = hashInt( h, inSnapshot->containedStacks[i][c] );
+                
+                if( inSnapshot->subContainedStacks[i][c] != NULL ) {
+                    int numSub = inSnapshot->subContainedStackSizes[i][c];
+                    
+                    h = hashInt( h, numSub );
+                    
+                    for( int s=0; s<numSub; s++ ) {
+                        h = hashInt( h, 
+                                     inSnapshot->subContainedStacks[i][c][s] );
+                        }
+                    }
+                else {
+                    h = hashInt( h, 0 );
+                    }
+                }
+            }
+        else {
+            h = hashInt( h, 0 );
+            }
+        
+        hashes[i] = h;
+        }
+    
+    return hashes;
+    }
+
+
+
+void markUnchangedCells( ChunkSentCache *inCache, 
+                         MapChunkSnapshot *inSnapshot,
+                         uint64_t *inCellHashes ) {
+    
+    int startX = inSnapshot->startX - inSnapshot->relativeToPos.x;
+    int startY = inSnapshot->startY - inSnapshot->relativeToPos.y;
+    
+    int numCells = inSnapshot->width * inSnapshot->height;
+    
+    unsigned char *unchanged = new unsigned char[ numCells ];
+    
+    int numUnchanged = 0;
+    
+    for( int i=0; i<numCells; i++ ) {
+        int x = startX + i % inSnapshot->width;
+        int y = startY + i / inSnapshot->width;
+        
+        ChunkSentCacheCell *c = 
+            &( inCache->cells[ getMapChunkCacheSlot( x, y ) ] );
+        
+        unchanged[i] = 
+            c->valid && c->x == x && c->y == y && 
+            c->hash == inCellHashes[i];
+        
+        if( unchanged[i] ) {
+            numUnchanged++;
+            }
+        }
+    
+    if( numUnchanged == 0 ) {
+        delete [] unchanged;
+        unchanged = NULL;
+        }
+    
+    if( inSnapshot->unchangedCells != NULL ) {
+        delete [] inSnapshot->unchangedCells;
+        }
+    inSnapshot->unchangedCells = unchanged;
+    }
+
+
+
+void recordSentCells( ChunkSentCache *inCache,
+                      int inStartX, int inStartY, 
+                      int inWidth, int inHeight,
+                      uint64_t *inCellHashes ) {
+    
+    int numCells = inWidth * inHeight;
+    
+    for( int i=0; i<numCells; i++ ) {
+        int x = inStartX + i % inWidth;
+        int y = inStartY + i / inWidth;
+        
+        ChunkSentCacheCell *c = 
+            &( inCache->cells[ getMapChunkCacheSlot( x, y ) ] );
+        
+        c->x = x;
+        c->y = y;
+        c->hash = inCellHashes[i];
+        c->valid = true;
+        }
+    
+    inCache->generation++;
+    }
@@ -0,0 +1,64 @@
+#ifndef CHUNK_SENT_CACHE_H_INCLUDED
+#define CHUNK_SENT_CACHE_H_INCLUDED
+
+
+#include "map.h"
+
+#include <stdint.h>
+
+
+
+// Server's half of the per-player cache described in binaryMapChunk.h
+//
+// Server only needs to know whether a cell changed since it was last sent,
+// so it keeps a hash of each sent cell instead of the cell itself.
+
+
+typedef struct ChunkSentCacheCell {
+        int x, y;
+        uint64_t hash;
+        char valid;
+    } ChunkSentCacheCell;
+
+
+typedef struct ChunkSentCache {
+        ChunkSentCacheCell *cells;
+        
+        // bumped every time cells are recorded, so that a message built
+        // against an older state of the cache can be detected
+        int generation;
+    } ChunkSentCache;
+
+
+
+ChunkSentCache *newChunkSentCache();
+
+void freeChunkSentCache( ChunkSentCache *inCache );
+
+
+
+// computes a hash of each cell in snapshot
+// result destroyed by caller
+uint64_t *getChunkSnapshotCellHashes( MapChunkSnapshot *inSnapshot );
+
+
+
+// sets inSnapshot->unchangedCells to mark cells that inCache says
+// the client already has
+// leaves it NULL if there are no such cells
+void markUnchangedCells( ChunkSentCache *inCache, 
+                         MapChunkSnapshot *inSnapshot,
+                         uint64_t *inCellHashes );
+
+
+
+// records cells of a chunk as sent
+// inStartX and inStartY are relative to client's birth pos, as in the
+// chunk header
+void recordSentCells( ChunkSentCache *inCache,
+                      int inStartX, int inStartY, 
+                      int inWidth, int inHeight,
+                      uint64_t *inCellHashes );
+
+
+#endif
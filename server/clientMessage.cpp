@@ -0,0 +1,727 @@
+#include "clientMessage.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/util/log/AppLog.h"
+
+
+
+char *getNextClientMessage( SimpleVector<char> *inBuffer,
+                            char inLoginMessageOnly ) {
+
+    // find first terminal character #
+
+    int index = inBuffer->getElementIndex( '#' );
+        
+    if( index == -1 ) {
+
+        if( inBuffer->size() > 200 ) {
+            // 200 characters with no message terminator?
+            // client is sending us nonsense
+            // cut it off here to avoid buffer overflow
+            
+            AppLog::info( "More than 200 characters in client receive buffer "
+                          "with no messsage terminator present, "
+                          "generating NONSENSE message." );
+            
+            return stringDuplicate( "NONSENSE 0 0" );
+            }
+        else if( inLoginMessageOnly && inBuffer->size() >= 6 ) {
+            char *buffString = inBuffer->getElementString();
+            
+            if( strstr( buffString, "LOGIN" ) != buffString &&
+                strstr( buffString, "RLOGIN" ) != buffString ) {
+                delete [] buffString;
+                
+                AppLog::info( 
+                    "More than 6 characters in client receive buffer "
+                    "with no LOGIN or RLOGIN present, when inLoginMessageOnly "
+                    "set, generating NONSENSE message." );
+                
+                return stringDuplicate( "NONSENSE 0 0" );
+                }
+            
+            delete [] buffString;
+            }
+        
+
+
+        return NULL;
+        }
+    
+    if( index > 1 && 
+        inBuffer->getElementDirect( 0 ) == 'K' &&
+        inBuffer->getElementDirect( 1 ) == 'A' ) {
+        
+        // a KA (keep alive) message
+        // short-cicuit the processing here
+        
+        inBuffer->deleteStartElements( index + 1 );
+        return NULL;
+        }
+    
+        
+
+    char *message = new char[ index + 1 ];
+    
+    // all but terminal character
+    for( int i=0; i<index; i++ ) {
+        message[i] = inBuffer->getElementDirect( i );
+        }
+    
+    // delete from buffer, including terminal character
+    inBuffer->deleteStartElements( index + 1 );
+    
+    message[ index ] = '\0';
+    
+    return message;
+    }
+
+
+
+
+
+static int stringToInt( char *inString ) {
+    return strtol( inString, NULL, 10 );
+    }
+
+
+
+ClientMessage parseMessage( GridPos inBirthPos, char *inMessage ) {
+    
+    char nameBuffer[100];
+    
+    ClientMessage m;
+    
+    m.i = -1;
+    m.c = -1;
+    m.id = -1;
+    m.trigger = -1;
+    m.numExtraPos = 0;
+    m.extraPos = NULL;
+    m.extraPosShared = false;
+    m.saidText = NULL;
+    m.voteGithubUsername = NULL;
+    m.bugText = NULL;
+    m.photoIDString = NULL;
+    m.sequenceNumber = -1;
+    
+    // don't require # terminator here
+    
+    
+    //int numRead = sscanf( inMessage, 
+    //                      "%99s %d %d", nameBuffer, &( m.x ), &( m.y ) );
+    
+
+    // profiler finds sscanf as a hotspot
+    // try a custom bit of code instead
+    
+    int numRead = 0;
+    
+    int parseLen = strlen( inMessage );
+    if( parseLen > 99 ) {
+        parseLen = 99;
+        }
+    
+    for( int i=0; i<parseLen; i++ ) {
+        if( inMessage[i] == ' ' ) {
+            switch( numRead ) {
+                case 0:
+                    if( i != 0 ) {
+                        memcpy( nameBuffer, inMessage, i );
+                        nameBuffer[i] = '\0';
+                        numRead++;
+                        // rewind back to read the space again
+                        // before the first number
+                        i--;
+                        }
+                    break;
+                case 1:
+                    m.x = stringToInt( &( inMessage[i] ) );
+                    numRead++;
+                    break;
+                case 2:
+                    m.y = stringToInt( &( inMessage[i] ) );
+                    numRead++;
+                    break;
+                }
+            if( numRead == 3 ) {
+                break;
+                }
+            }
+        }
+    
+
+    
+    if( numRead >= 2 &&
+        strcmp( nameBuffer, "BUG" ) == 0 ) {
+        m.type = BUG;
+        m.bug = m.x;
+        m.bugText = stringDuplicate( inMessage );
+        return m;
+        }
+
+
+    if( numRead != 3 ) {
+        
+        if( numRead == 2 &&
+            strcmp( nameBuffer, "TRIGGER" ) == 0 ) {
+            m.type = TRIGGER;
+            m.trigger = m.x;
+            }
+        else {
+            m.type = UNKNOWN;
+            }
+        
+        return m;
+        }
+    
+
+    if( strcmp( nameBuffer, "MOVE" ) == 0) {
+        m.type = MOVE;
+        
+        char *atPos = strstr( inMessage, "@" );
+        
+        int offset = 3;
+        
+        if( atPos != NULL ) {
+            offset = 4;            
+            }
+        
+
+        // in place, so we don't need to deallocate them
+        SimpleVector<char *> *tokens =
+            tokenizeStringInPlace( inMessage );
+        
+        // require an even number of extra coords beyond offset
+        if( tokens->size() < offset + 2 || 
+            ( tokens->size() - offset ) %2 != 0 ) {
+            
+            delete tokens;
+            
+            m.type = UNKNOWN;
+            return m;
+            }
+        
+        if( atPos != NULL ) {
+            // skip @ symbol in token and parse int
+            m.sequenceNumber = 
+                stringToInt( &( tokens->getElementDirect( 3 )[1] ) );
+            }
+
+        int numTokens = tokens->size();
+        
+        m.numExtraPos = (numTokens - offset) / 2;
+        
+        m.extraPos = new GridPos[ m.numExtraPos ];
+
+        for( int e=0; e<m.numExtraPos; e++ ) {
+            
+            char *xToken = tokens->getElementDirect( offset + e * 2 );
+            char *yToken = tokens->getElementDirect( offset + e * 2 + 1 );
+            
+            // profiler found sscanf is a bottleneck here
+            // try atoi (stringToInt) instead
+            //sscanf( xToken, "%d", &( m.extraPos[e].x ) );
+            //sscanf( yToken, "%d", &( m.extraPos[e].y ) );
+
+            m.extraPos[e].x = stringToInt( xToken );
+            m.extraPos[e].y = stringToInt( yToken );
+            
+            
+            if( abs( m.extraPos[e].x ) > PATH_DELTA_MAX ||
+                abs( m.extraPos[e].y ) > PATH_DELTA_MAX ) {
+                // path goes too far afield
+                
+                // terminate it here
+                m.numExtraPos = e;
+                
+                if( e == 0 ) {
+                    delete [] m.extraPos;
+                    m.extraPos = NULL;
+                    m.numExtraPos = 0;
+                    m.type = UNKNOWN;
+                    delete tokens;
+                    return m;
+                    }
+                break;
+                }
+                
+
+            // make them absolute
+            m.extraPos[e].x += m.x;
+            m.extraPos[e].y += m.y;
+            }
+        
+        delete tokens;
+        }
+    else if( strcmp( nameBuffer, "JUMP" ) == 0 ) {
+        m.type = JUMP;
+        }
+    else if( strcmp( nameBuffer, "DIE" ) == 0 ) {
+        m.type = DIE;
+        }
+    else if( strcmp( nameBuffer, "GRAVE" ) == 0 ) {
+        m.type = GRAVE;
+        }
+    else if( strcmp( nameBuffer, "OWNER" ) == 0 ) {
+        m.type = OWNER;
+        }
+    else if( strcmp( nameBuffer, "FORCE" ) == 0 ) {
+        m.type = FORCE;
+        }
+    else if( strcmp( nameBuffer, "USE" ) == 0 ) {
+        m.type = USE;
+        // read optional id parameter
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ), &( m.id ), &( m.i ) );
+        
+        if( numRead < 5 ) {
+            m.i = -1;
+            }
+        if( numRead < 4 ) {
+            m.id = -1;
+            }
+        }
+    else if( strcmp( nameBuffer, "SELF" ) == 0 ) {
+        m.type = SELF;
+
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ), &( m.i ) );
+        
+        if( numRead != 4 ) {
+            m.type = UNKNOWN;
+            }
+        }
+    else if( strcmp( nameBuffer, "UBABY" ) == 0 ) {
+        m.type = UBABY;
+
+        // id param optional
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ), &( m.i ), &( m.id ) );
+        
+        if( numRead != 4 && numRead != 5 ) {
+            m.type = UNKNOWN;
+            }
+        if( numRead != 5 ) {
+            m.id = -1;
+            }
+        }
+    else if( strcmp( nameBuffer, "BABY" ) == 0 ) {
+        m.type = BABY;
+        // read optional id parameter
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ), &( m.id ) );
+        
+        if( numRead != 4 ) {
+            m.id = -1;
+            }
+        }
+    else if( strcmp( nameBuffer, "PING" ) == 0 ) {
+        m.type = PING;
+        // read unique id parameter
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ), &( m.id ) );
+        
+        if( numRead != 4 ) {
+            m.id = 0;
+            }
+        }
+    else if( strcmp( nameBuffer, "SREMV" ) == 0 ) {
+        m.type = SREMV;
+        
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ), &( m.c ),
+                          &( m.i ) );
+        
+        if( numRead != 5 ) {
+            m.type = UNKNOWN;
+            }
+        }
+    else if( strcmp( nameBuffer, "REMV" ) == 0 ) {
+        m.type = REMV;
+        
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ), &( m.i ) );
+        
+        if( numRead != 4 ) {
+            m.type = UNKNOWN;
+            }
+        }
+    else if( strcmp( nameBuffer, "DROP" ) == 0 ) {
+        m.type = DROP;
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ), &( m.c ) );
+        
+        if( numRead != 4 ) {
+            m.type = UNKNOWN;
+            }
+        }
+    else if( strcmp( nameBuffer, "SWAP" ) == 0 ) {
+        m.type = SWAP;
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ) );
+        
+        if( numRead != 3 ) {
+            m.type = UNKNOWN;
+            }
+        }
+    else if( strcmp( nameBuffer, "KILL" ) == 0 ) {
+        m.type = KILL;
+        
+        // read optional id parameter
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ), &( m.id ) );
+        
+        if( numRead != 4 ) {
+            m.id = -1;
+            }
+        }
+    else if( strcmp( nameBuffer, "MAP" ) == 0 ) {
+        m.type = MAP;
+        }
+    else if( strcmp( nameBuffer, "SAY" ) == 0 ) {
+        m.type = SAY;
+
+        // look after third space
+        char *firstSpace = strstr( inMessage, " " );
+        
+        if( firstSpace != NULL ) {
+            
+            char *secondSpace = strstr( &( firstSpace[1] ), " " );
+            
+            if( secondSpace != NULL ) {
+
+                char *thirdSpace = strstr( &( secondSpace[1] ), " " );
+                
+                if( thirdSpace != NULL ) {
+                    m.saidText = stringDuplicate( &( thirdSpace[1] ) );
+                    }
+                }
+            }
+        }
+    else if( strcmp( nameBuffer, "EMOT" ) == 0 ) {
+        m.type = EMOT;
+
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ), &( m.i ) );
+        
+        if( numRead != 4 ) {
+            m.type = UNKNOWN;
+            }
+        }
+    else if( strcmp( nameBuffer, "VOGS" ) == 0 ) {
+        m.type = VOGS;
+        }
+    else if( strcmp( nameBuffer, "VOGN" ) == 0 ) {
+        m.type = VOGN;
+        }
+    else if( strcmp( nameBuffer, "VOGP" ) == 0 ) {
+        m.type = VOGP;
+        }
+    else if( strcmp( nameBuffer, "VOGM" ) == 0 ) {
+        m.type = VOGM;
+        }
+    else if( strcmp( nameBuffer, "VOGI" ) == 0 ) {
+        m.type = VOGI;
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ), &( m.id ) );
+        
+        if( numRead != 4 ) {
+            m.id = -1;
+            }
+        }
+    else if( strcmp( nameBuffer, "VOGT" ) == 0 ) {
+        m.type = VOGT;
+
+        // look after second space
+        char *firstSpace = strstr( inMessage, " " );
+        
+        if( firstSpace != NULL ) {
+            
+            char *secondSpace = strstr( &( firstSpace[1] ), " " );
+            
+            if( secondSpace != NULL ) {
+
+                char *thirdSpace = strstr( &( secondSpace[1] ), " " );
+                
+                if( thirdSpace != NULL ) {
+                    m.saidText = stringDuplicate( &( thirdSpace[1] ) );
+                    }
+                }
+            }
+        }
+    else if( strcmp( nameBuffer, "VOGX" ) == 0 ) {
+        m.type = VOGX;
+        }
+    else if( strcmp( nameBuffer, "PHOTO" ) == 0 ) {
+        m.type = PHOTO;
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %d", 
+                          nameBuffer, &( m.x ), &( m.y ), &( m.id ) );
+        
+        if( numRead != 4 ) {
+            m.id = 0;
+            }
+        }
+    else if( strcmp( nameBuffer, "PHOID" ) == 0 ) {
+        m.type = PHOID;
+        
+        m.photoIDString = new char[41];
+        m.photoIDString[0] = '\0';
+        
+        numRead = sscanf( inMessage, 
+                          "%99s %d %d %40s", 
+                          nameBuffer, &( m.x ), &( m.y ), m.photoIDString );
+        }
+    else if( strcmp( nameBuffer, "LEAD" ) == 0 ) {
+        m.type = LEAD;
+        }
+    else if( strcmp( nameBuffer, "UNFOL" ) == 0 ) {
+        m.type = UNFOL;
+        }
+    else if( strcmp( nameBuffer, "PROP" ) == 0 ) {
+        m.type = PROP;
+        }
+    else if( strcmp( nameBuffer, "ORDR" ) == 0 ) {
+        m.type = ORDR;
+        }
+    else if( strcmp( nameBuffer, "FLIP" ) == 0 ) {
+        m.type = FLIP;
+        }
+    else if( strcmp( nameBuffer, "MOTH" ) == 0 ) {
+        m.type = MOTH;
+        }
+    else if( strcmp( nameBuffer, "APVT" ) == 0 ) {
+        m.type = APVT;
+
+        // look after third space
+        char *firstSpace = strstr( inMessage, " " );
+        
+        if( firstSpace != NULL ) {
+            
+            char *secondSpace = strstr( &( firstSpace[1] ), " " );
+            
+            if( secondSpace != NULL ) {
+
+                char *thirdSpace = strstr( &( secondSpace[1] ), " " );
+                
+                if( thirdSpace != NULL ) {
+                    m.voteGithubUsername = 
+                        stringDuplicate( &( thirdSpace[1] ) );
+                    }
+                }
+            }
+        }
+    else {
+        m.type = UNKNOWN;
+        }
+    
+    // incoming client messages are relative to birth pos
+    // except NOT map pull messages, which are absolute
+    if( m.type != MAP ) {    
+        m.x += inBirthPos.x;
+        m.y += inBirthPos.y;
+
+        for( int i=0; i<m.numExtraPos; i++ ) {
+            m.extraPos[i].x += inBirthPos.x;
+            m.extraPos[i].y += inBirthPos.y;
+            }
+        }
+
+    return m;
+    }
+
+
+
+// MOVE paths from binary messages are decoded into here
+// each step takes two bytes of body
+static GridPos sharedPath[ BINARY_CLIENT_ACTION_MAX_BODY / 2 ];
+
+
+
+// how extra fields of a binary action fill in a ClientMessage, matching
+// what parseMessage does with the same text message
+typedef struct BinaryActionLayout {
+        messageType type;
+        
+        // ClientMessage field for each extra field, in order
+        // c for c, i for i, d for id
+        const char *fieldTargets;
+        
+        // message is UNKNOWN with fewer fields than this
+        int numRequired;
+    } BinaryActionLayout;
+
+
+// indexed by binaryClientActionCode
+static BinaryActionLayout binaryActionLayouts[] = {
+    { UNKNOWN, "", 0 },
+    { MOVE, "", 0 },
+    { USE, "di", 0 },
+    { SELF, "i", 1 },
+    { BABY, "d", 0 },
+    { UBABY, "id", 1 },
+    { REMV, "i", 1 },
+    { SREMV, "ci", 2 },
+    { DROP, "c", 1 },
+    { SWAP, "", 0 },
+    { KILL, "d", 0 },
+    { SAY, "", 0 },
+    { EMOT, "i", 1 },
+    { JUMP, "", 0 } };
+
+
+
+binaryClientFrameStatus getNextBinaryClientMessage(
+    SimpleVector<char> *inBuffer, GridPos inBirthPos,
+    ClientMessage *outMessage, char *outMessageText ) {
+    
+    if( inBuffer->size() == 0 ) {
+        return BINARY_FRAME_NONE;
+        }
+    
+    unsigned char *data = (unsigned char*)inBuffer->getElement( 0 );
+    
+    int bodyStart, bodyLength;
+    
+    binaryClientFrameStatus status = 
+        findBinaryClientActionFrame( data, inBuffer->size(),
+                                     &bodyStart, &bodyLength );
+    
+    if( status != BINARY_FRAME_READY ) {
+        return status;
+        }
+    
+    BinaryClientAction a;
+    
+    if( ! decodeBinaryClientAction( &( data[ bodyStart ] ), bodyLength,
+                                    &a ) ) {
+        return BINARY_FRAME_BAD;
+        }
+    
+    if( outMessageText != NULL ) {
+        getBinaryClientActionText( &a, outMessageText );
+        }
+    
+    ClientMessage *m = outMessage;
+    
+    BinaryActionLayout *layout = &( binaryActionLayouts[ a.code ] );
+    
+    m->type = layout->type;
+    m->x = a.x;
+    m->y = a.y;
+    m->c = -1;
+    m->i = -1;
+    m->id = -1;
+    m->trigger = -1;
+    m->numExtraPos = 0;
+    m->extraPos = NULL;
+    m->extraPosShared = false;
+    m->saidText = NULL;
+    m->voteGithubUsername = NULL;
+    m->bugText = NULL;
+    m->photoIDString = NULL;
+    m->sequenceNumber = -1;
+    
+    
+    const char *target = layout->fieldTargets;
+    
+    for( int f=0; f<a.numFields && target[f] != '\0'; f++ ) {
+        switch( target[f] ) {
+            case 'c':
+                m->c = a.fields[f];
+                break;
+            case 'i':
+                m->i = a.fields[f];
+                break;
+            case 'd':
+                m->id = a.fields[f];
+                break;
+            }
+        }
+    
+    if( a.numFields < layout->numRequired ) {
+        m->type = UNKNOWN;
+        }
+    
+    
+    if( m->type == MOVE ) {
+        m->sequenceNumber = a.sequenceNumber;
+        
+        m->extraPos = sharedPath;
+        m->extraPosShared = true;
+        m->numExtraPos = a.numSteps;
+        
+        for( int e=0; e<a.numSteps; e++ ) {
+            int dx = a.steps[ e * 2 ];
+            int dy = a.steps[ e * 2 + 1 ];
+            
+            if( abs( dx ) > PATH_DELTA_MAX ||
+                abs( dy ) > PATH_DELTA_MAX ) {
+                // path goes too far afield
+                
+                // terminate it here
+                m->numExtraPos = e;
+                break;
+                }
+            
+            sharedPath[e].x = m->x + dx + inBirthPos.x;
+            sharedPath[e].y = m->y + dy + inBirthPos.y;
+            }
+        
+        if( m->numExtraPos == 0 ) {
+            m->type = UNKNOWN;
+            m->extraPos = NULL;
+            m->extraPosShared = false;
+            }
+        }
+    else if( m->type == SAY ) {
+        // copy, because SAY handling replaces it with a filtered version
+        m->saidText = new char[ a.textLength + 1 ];
+        memcpy( m->saidText, a.text, a.textLength );
+        m->saidText[ a.textLength ] = '\0';
+        }
+    
+    if( m->type != UNKNOWN || a.code != BINARY_ACTION_MOVE ) {
+        m->x += inBirthPos.x;
+        m->y += inBirthPos.y;
+        }
+    
+    inBuffer->deleteStartElements( bodyStart + bodyLength );
+    
+    return BINARY_FRAME_READY;
+    }
+
+
+
+void freeClientMessage( ClientMessage *inMessage ) {
+    if( inMessage->numExtraPos > 0 && ! inMessage->extraPosShared ) {
+        delete [] inMessage->extraPos;
+        }
+    
+    if( inMessage->saidText != NULL ) {
+        delete [] inMessage->saidText;
+        }
+    if( inMessage->voteGithubUsername != NULL ) {
+        delete [] inMessage->voteGithubUsername;
+        }
+    if( inMessage->bugText != NULL ) {
+        delete [] inMessage->bugText;
+        }
+    }
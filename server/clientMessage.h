@@ -0,0 +1,145 @@
+#ifndef CLIENT_MESSAGE_H_INCLUDED
+#define CLIENT_MESSAGE_H_INCLUDED
+
+
+#include "minorGems/util/SimpleVector.h"
+
+#include "../gameSource/GridPos.h"
+#include "../commonSource/binaryClientAction.h"
+
+
+
+// furthest that one step of a MOVE path can be from the start of the path
+#define PATH_DELTA_MAX 16
+
+
+
+typedef enum messageType {
+	MOVE,
+    USE,
+    SELF,
+    BABY,
+    UBABY,
+    REMV,
+    SREMV,
+    DROP,
+    SWAP,
+    KILL,
+    SAY,
+    EMOT,
+    JUMP,
+    DIE,
+    GRAVE,
+    OWNER,
+    FORCE,
+    MAP,
+    TRIGGER,
+    BUG,
+    PING,
+    VOGS,
+    VOGN,
+    VOGP,
+    VOGM,
+    VOGI,
+    VOGT,
+    VOGX,
+    PHOTO,
+    PHOID,
+    LEAD,
+    UNFOL,
+    PROP,
+    ORDR,
+    FLIP,
+    MOTH,
+    APVT,
+    UNKNOWN
+    } messageType;
+
+
+
+
+typedef struct ClientMessage {
+        messageType type;
+        int x, y, c, i, id;
+
+        int trigger;
+        int bug;
+
+        // some messages have extra positions attached
+        int numExtraPos;
+
+        // NULL if there are no extra
+        GridPos *extraPos;
+
+        // true if extraPos points into a buffer shared by all binary
+        // messages, which is only good until the next one is parsed
+        char extraPosShared;
+
+        // null if type not SAY
+        char *saidText;
+
+        // NULL if type not APVT
+        char *voteGithubUsername;
+
+        // null if type not BUG
+        char *bugText;
+
+        // null if type not PHOID
+        char *photoIDString;
+
+
+        // for MOVE messages
+        int sequenceNumber;
+
+    } ClientMessage;
+
+
+
+// NULL if there's no full message available
+// if inLoginMessageOnly true, then we look for messages that start with
+// LOGIN or RLOGIN, and count sufficiently long messages that don't
+// start with either string as NONSENSE (this allows us to instantly reject
+// web requests and other non-OHOL messages that don't end with # and don't
+// exceed our 200 char limit)
+char *getNextClientMessage( SimpleVector<char> *inBuffer,
+                            char inLoginMessageOnly = false );
+
+
+
+// if extraPos present in result, destroyed by caller
+// inMessage may be modified by this call
+// positions in message are relative to inBirthPos
+ClientMessage parseMessage( GridPos inBirthPos, char *inMessage );
+
+
+
+// for connections that negotiated BINARY_CLIENT_ACTION_TAG
+//
+// if inBuffer starts with a complete binary frame, decodes it straight out
+// of the buffer into outMessage, removes it from the buffer, and returns
+// BINARY_FRAME_READY
+//
+// no memory is allocated, except for said text in SAY messages, and MOVE
+// paths are left in a shared buffer (extraPosShared set)
+//
+// BINARY_FRAME_NONE means the next message is text, and BINARY_FRAME_PARTIAL
+// that the rest of the frame hasn't arrived yet.  For either, buffer is not
+// touched.
+//
+// BINARY_FRAME_BAD means the frame length, or its body, is garbage
+//
+// if outMessageText is non-NULL, the text message that a READY frame was
+// encoded from is written there, and it must hold
+// BINARY_CLIENT_ACTION_MAX_TEXT bytes
+binaryClientFrameStatus getNextBinaryClientMessage(
+    SimpleVector<char> *inBuffer, GridPos inBirthPos,
+    ClientMessage *outMessage, char *outMessageText = NULL );
+
+
+
+// frees what parsing allocated for a message, after it has been handled
+// (except photoIDString, which the PHOID handler frees)
+void freeClientMessage( ClientMessage *inMessage );
+
+
+#endif
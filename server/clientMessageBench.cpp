@@ -0,0 +1,694 @@
+// replays client messages through the text parser and through binary
+// action frames, checks that both give the same ClientMessage, times
+// each, counts heap allocations, and then fuzzes the binary decoder with
+// damaged frames
+//
+// usage:  clientMessageBench [serverLog.txt ...]
+//
+// client messages are pulled from "Got client message from" lines in
+// server logs
+// with no logs, a made-up session is used, mostly MOVE, USE, and SELF
+//
+// build with -fsanitize=address to catch out-of-bounds reads while fuzzing
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#include "clientMessage.h"
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/util/log/AppLog.h"
+#include "minorGems/util/random/JenkinsRandomSource.h"
+
+
+
+static int numAllocations = 0;
+
+
+void *operator new( size_t inSize ) {
+    numAllocations++;
+    void *p = malloc( inSize );
+    if( p == NULL ) {
+        throw std::bad_alloc();
+        }
+    return p;
+    }
+
+void *operator new[]( size_t inSize ) {
+    numAllocations++;
+    void *p = malloc( inSize );
+    if( p == NULL ) {
+        throw std::bad_alloc();
+        }
+    return p;
+    }
+
+void operator delete( void *inP ) noexcept {
+    free( inP );
+    }
+
+void operator delete[]( void *inP ) noexcept {
+    free( inP );
+    }
+
+void operator delete( void *inP, size_t ) noexcept {
+    free( inP );
+    }
+
+void operator delete[]( void *inP, size_t ) noexcept {
+    free( inP );
+    }
+
+
+
+static SimpleVector<char*> messages;
+
+static GridPos birthPos = { 1000, -2000 };
+
+
+
+static void readLog( const char *inFileName ) {
+    FILE *f = fopen( inFileName, "r" );
+
+    if( f == NULL ) {
+        printf( "Failed to open %s\n", inFileName );
+        return;
+        }
+
+    const char *key = "Got client message from ";
+
+    char line[ 4096 ];
+
+    while( fgets( line, sizeof( line ), f ) != NULL ) {
+        char *found = strstr( line, key );
+
+        if( found == NULL ) {
+            continue;
+            }
+
+        char *colon = strstr( found, ": " );
+
+        if( colon == NULL ) {
+            continue;
+            }
+
+        char *start = &( colon[2] );
+
+        int len = strlen( start );
+        while( len > 0 &&
+               ( start[ len - 1 ] == '\n' || start[ len - 1 ] == '\r' ) ) {
+            len--;
+            }
+        start[ len ] = '\0';
+
+        if( len > 0 ) {
+            messages.push_back( stringDuplicate( start ) );
+            }
+        }
+
+    fclose( f );
+    }
+
+
+
+static void makeSession( int inNumMessages ) {
+    JenkinsRandomSource randSource( 1717 );
+
+    int x = 0;
+    int y = 0;
+    int sequenceNumber = 1;
+
+    for( int i=0; i<inNumMessages; i++ ) {
+        int pick = randSource.getRandomBoundedInt( 0, 99 );
+
+        char *m;
+
+        if( pick < 45 ) {
+            // walk somewhere, long paths now and then
+            int numSteps = randSource.getRandomBoundedInt( 1, 8 );
+            if( randSource.getRandomBoundedInt( 0, 9 ) == 0 ) {
+                numSteps = randSource.getRandomBoundedInt( 10, 60 );
+                }
+
+            SimpleVector<char> path;
+            int dx = 0;
+            int dy = 0;
+            for( int s=0; s<numSteps; s++ ) {
+                dx += randSource.getRandomBoundedInt( -1, 1 );
+                dy += randSource.getRandomBoundedInt( -1, 1 );
+                char *step = autoSprintf( " %d %d", dx, dy );
+                path.appendElementString( step );
+                delete [] step;
+                }
+            char *pathString = path.getElementString();
+
+            m = autoSprintf( "MOVE %d %d @%d%s", x, y, sequenceNumber,
+                             pathString );
+            delete [] pathString;
+
+            sequenceNumber++;
+            x += dx;
+            y += dy;
+            }
+        else if( pick < 65 ) {
+            m = autoSprintf( "USE %d %d", x + 1, y );
+            }
+        else if( pick < 72 ) {
+            m = autoSprintf( "USE %d %d %d %d", x, y + 1,
+                             randSource.getRandomBoundedInt( 1, 4000 ),
+                             randSource.getRandomBoundedInt( 0, 3 ) );
+            }
+        else if( pick < 82 ) {
+            m = autoSprintf( "SELF %d %d %d", x, y,
+                             randSource.getRandomBoundedInt( -1, 3 ) );
+            }
+        else if( pick < 88 ) {
+            m = autoSprintf( "DROP %d %d %d", x - 1, y,
+                             randSource.getRandomBoundedInt( -1, 3 ) );
+            }
+        else if( pick < 91 ) {
+            m = autoSprintf( "REMV %d %d %d", x, y - 1,
+                             randSource.getRandomBoundedInt( -1, 3 ) );
+            }
+        else if( pick < 94 ) {
+            m = autoSprintf( "SAY 0 0 HELLO THERE NUMBER %d", i );
+            }
+        else if( pick < 96 ) {
+            m = autoSprintf( "EMOT 0 0 %d",
+                             randSource.getRandomBoundedInt( 0, 20 ) );
+            }
+        else if( pick < 98 ) {
+            m = autoSprintf( "KILL %d %d %d", x, y,
+                             randSource.getRandomBoundedInt( 1, 500 ) );
+            }
+        else {
+            // no binary form
+            m = stringDuplicate( "PING 0 0 5" );
+            }
+
+        messages.push_back( m );
+        }
+    }
+
+
+
+static ClientMessage parseText( const char *inMessage,
+                                SimpleVector<char> *inBuffer ) {
+    inBuffer->appendElementString( inMessage );
+    inBuffer->push_back( '#' );
+
+    char *message = getNextClientMessage( inBuffer );
+
+    ClientMessage m = parseMessage( birthPos, message );
+
+    delete [] message;
+
+    return m;
+    }
+
+
+
+static char sameString( const char *inA, const char *inB ) {
+    if( inA == NULL || inB == NULL ) {
+        return inA == inB;
+        }
+    return strcmp( inA, inB ) == 0;
+    }
+
+
+
+static char sameMessage( ClientMessage *inA, ClientMessage *inB ) {
+    if( inA->type != inB->type ) {
+        return false;
+        }
+    if( inA->type == UNKNOWN ) {
+        // text parser leaves garbage in some fields here
+        return true;
+        }
+    if( inA->x != inB->x || inA->y != inB->y ||
+        inA->c != inB->c || inA->i != inB->i || inA->id != inB->id ||
+        inA->sequenceNumber != inB->sequenceNumber ||
+        inA->numExtraPos != inB->numExtraPos ) {
+        return false;
+        }
+    for( int e=0; e<inA->numExtraPos; e++ ) {
+        if( inA->extraPos[e].x != inB->extraPos[e].x ||
+            inA->extraPos[e].y != inB->extraPos[e].y ) {
+            return false;
+            }
+        }
+    return sameString( inA->saidText, inB->saidText );
+    }
+
+
+
+// sanity checks on whatever decoder made of a damaged frame
+static int checkDecoded( ClientMessage *inM ) {
+    int numProblems = 0;
+
+    if( inM->numExtraPos < 0 ||
+        inM->numExtraPos > BINARY_CLIENT_ACTION_MAX_BODY / 2 ||
+        ( inM->numExtraPos > 0 && inM->extraPos == NULL ) ) {
+        numProblems++;
+        }
+    for( int e=0; e<inM->numExtraPos; e++ ) {
+        // read every step, so ASAN sees any bad pointer
+        if( abs( inM->extraPos[e].x - inM->x ) > PATH_DELTA_MAX ||
+            abs( inM->extraPos[e].y - inM->y ) > PATH_DELTA_MAX ) {
+            numProblems++;
+            }
+        }
+    if( inM->saidText != NULL &&
+        strlen( inM->saidText ) > BINARY_CLIENT_ACTION_MAX_BODY ) {
+        numProblems++;
+        }
+    return numProblems;
+    }
+
+
+
+static void mutateFrame( SimpleVector<unsigned char> *ioFrame,
+                         JenkinsRandomSource *inRandSource ) {
+    int numMutations = inRandSource->getRandomBoundedInt( 1, 4 );
+
+    for( int n=0; n<numMutations; n++ ) {
+        int size = ioFrame->size();
+        int pick = inRandSource->getRandomBoundedInt( 0, 5 );
+
+        if( size == 0 ) {
+            pick = 2;
+            }
+
+        int spot = 0;
+        if( size > 0 ) {
+            spot = inRandSource->getRandomBoundedInt( 0, size - 1 );
+            }
+
+        switch( pick ) {
+            case 0:
+                // flip a bit
+                *( ioFrame->getElement( spot ) ) ^=
+                    (unsigned char)( 1 << inRandSource->getRandomBoundedInt(
+                                         0, 7 ) );
+                break;
+            case 1:
+                *( ioFrame->getElement( spot ) ) =
+                    (unsigned char)inRandSource->getRandomBoundedInt(
+                        0, 255 );
+                break;
+            case 2:
+                ioFrame->push_middle(
+                    (unsigned char)inRandSource->getRandomBoundedInt(
+                        0, 255 ),
+                    spot );
+                break;
+            case 3:
+                ioFrame->deleteElement( spot );
+                break;
+            case 4:
+                // cut off end
+                while( ioFrame->size() > spot ) {
+                    ioFrame->deleteLastElement();
+                    }
+                break;
+            case 5: {
+                // big length that still looks like a varint
+                if( size > 2 ) {
+                    *( ioFrame->getElement( 1 ) ) = 0xFF;
+                    *( ioFrame->getElement( 2 ) ) =
+                        (unsigned char)inRandSource->getRandomBoundedInt(
+                            0, 255 );
+                    }
+                break;
+                }
+            }
+        }
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    AppLog::setLoggingLevel( Log::CRITICAL_ERROR_LEVEL );
+
+    for( int i=1; i<inNumArgs; i++ ) {
+        readLog( inArgs[i] );
+        }
+
+    if( messages.size() > 0 ) {
+        printf( "Read %d client messages from logs\n", messages.size() );
+        }
+    else {
+        makeSession( 20000 );
+        printf( "Made session with %d client messages\n", messages.size() );
+        }
+
+
+    // encode everything once, as a client would
+    SimpleVector<unsigned char> allFrames;
+    SimpleVector<char> encodable;
+    SimpleVector<int> frameStarts;
+
+    int textBytes = 0;
+
+    for( int i=0; i<messages.size(); i++ ) {
+        char *text = messages.getElementDirect( i );
+
+        frameStarts.push_back( allFrames.size() );
+
+        char encoded = encodeBinaryClientAction( text, &allFrames );
+        encodable.push_back( encoded );
+
+        if( encoded ) {
+            textBytes += strlen( text ) + 1;
+            }
+        }
+    frameStarts.push_back( allFrames.size() );
+
+
+    // check that both ways agree
+    int numEncodable = 0;
+    int numMismatches = 0;
+
+    SimpleVector<char> textBuffer;
+    SimpleVector<char> binaryBuffer;
+
+    for( int i=0; i<messages.size(); i++ ) {
+        if( ! encodable.getElementDirect( i ) ) {
+            continue;
+            }
+        numEncodable++;
+
+        char *text = stringDuplicate( messages.getElementDirect( i ) );
+        ClientMessage textM = parseText( text, &textBuffer );
+        delete [] text;
+
+        int start = frameStarts.getElementDirect( i );
+        int end = frameStarts.getElementDirect( i + 1 );
+
+        for( int b=start; b<end; b++ ) {
+            binaryBuffer.push_back(
+                (char)allFrames.getElementDirect( b ) );
+            }
+
+        ClientMessage binaryM;
+
+        binaryClientFrameStatus status =
+            getNextBinaryClientMessage( &binaryBuffer, birthPos, &binaryM );
+
+        if( status != BINARY_FRAME_READY ||
+            binaryBuffer.size() != 0 ) {
+            printf( "Frame not read back:  %s\n",
+                    messages.getElementDirect( i ) );
+            numMismatches++;
+            binaryBuffer.deleteAll();
+            }
+        else {
+            if( ! sameMessage( &textM, &binaryM ) ) {
+                printf( "Mismatch:  %s\n", messages.getElementDirect( i ) );
+                numMismatches++;
+                }
+            freeClientMessage( &binaryM );
+            }
+
+        freeClientMessage( &textM );
+        }
+
+    printf( "%d of %d messages have a binary form, "
+            "%d text bytes vs %d binary bytes\n",
+            numEncodable, messages.size(), textBytes, allFrames.size() );
+
+
+    // mixed stream, arriving in odd-sized pieces, read like server does
+    JenkinsRandomSource randSource( 4242 );
+
+    SimpleVector<unsigned char> stream;
+
+    for( int i=0; i<messages.size(); i++ ) {
+        if( encodable.getElementDirect( i ) &&
+            randSource.getRandomBoundedInt( 0, 3 ) != 0 ) {
+            int start = frameStarts.getElementDirect( i );
+            int end = frameStarts.getElementDirect( i + 1 );
+            for( int b=start; b<end; b++ ) {
+                stream.push_back( allFrames.getElementDirect( b ) );
+                }
+            }
+        else {
+            stream.appendArray( (unsigned char*)messages.getElementDirect( i ),
+                                strlen( messages.getElementDirect( i ) ) );
+            stream.push_back( '#' );
+            }
+        }
+
+    SimpleVector<char> sockBuffer;
+    int streamPos = 0;
+    int numRead = 0;
+
+    while( true ) {
+        ClientMessage m;
+        binaryClientFrameStatus status =
+            getNextBinaryClientMessage( &sockBuffer, birthPos, &m );
+
+        if( status == BINARY_FRAME_READY ) {
+            numRead++;
+            freeClientMessage( &m );
+            continue;
+            }
+        if( status == BINARY_FRAME_BAD ) {
+            printf( "Bad frame in mixed stream\n" );
+            numMismatches++;
+            break;
+            }
+        if( status == BINARY_FRAME_NONE ) {
+            char *message = getNextClientMessage( &sockBuffer );
+            if( message != NULL ) {
+                if( strcmp( message, "NONSENSE 0 0" ) == 0 ) {
+                    // long MOVE text cut off by piece boundary, more than
+                    // 200 chars with no # yet
+                    // server would see this too, but it reads everything
+                    // the socket has, so it rarely happens there
+                    delete [] message;
+                    }
+                else {
+                    numRead++;
+                    delete [] message;
+                    continue;
+                    }
+                }
+            }
+
+        // need more data
+        if( streamPos == stream.size() ) {
+            break;
+            }
+        int pieceSize = randSource.getRandomBoundedInt( 1, 700 );
+        if( streamPos + pieceSize > stream.size() ) {
+            pieceSize = stream.size() - streamPos;
+            }
+        sockBuffer.appendArray( (char*)stream.getElement( streamPos ),
+                                pieceSize );
+        streamPos += pieceSize;
+        }
+
+    // KA isn't in logs, so every message comes back out
+    if( numRead != messages.size() || sockBuffer.size() != 0 ) {
+        printf( "Mixed stream gave %d messages, expected %d\n",
+                numRead, messages.size() );
+        numMismatches++;
+        }
+
+
+    // timing, only over messages that have both forms, arriving one
+    // at a time in receive buffer, like server sees them
+    // allocations are only counted for parsing, not for growing buffer
+    int numReps = 20;
+
+    double startTime = Time::getCurrentTime();
+    int textAllocations = 0;
+
+    for( int r=0; r<numReps; r++ ) {
+        for( int i=0; i<messages.size(); i++ ) {
+            if( ! encodable.getElementDirect( i ) ) {
+                continue;
+                }
+            textBuffer.appendElementString( messages.getElementDirect( i ) );
+            textBuffer.push_back( '#' );
+
+            int allocationsBefore = numAllocations;
+
+            char *message = getNextClientMessage( &textBuffer );
+            ClientMessage m = parseMessage( birthPos, message );
+            delete [] message;
+            freeClientMessage( &m );
+
+            textAllocations += numAllocations - allocationsBefore;
+            }
+        }
+
+    double textSeconds = Time::getCurrentTime() - startTime;
+
+
+    startTime = Time::getCurrentTime();
+    int binaryAllocations = 0;
+    int numSay = 0;
+
+    for( int r=0; r<numReps; r++ ) {
+        for( int i=0; i<messages.size(); i++ ) {
+            if( ! encodable.getElementDirect( i ) ) {
+                continue;
+                }
+            int start = frameStarts.getElementDirect( i );
+            int end = frameStarts.getElementDirect( i + 1 );
+
+            binaryBuffer.appendArray( (char*)allFrames.getElement( start ),
+                                      end - start );
+
+            int allocationsBefore = numAllocations;
+
+            ClientMessage m;
+            getNextBinaryClientMessage( &binaryBuffer, birthPos, &m );
+
+            if( m.saidText != NULL ) {
+                numSay++;
+                }
+            freeClientMessage( &m );
+
+            binaryAllocations += numAllocations - allocationsBefore;
+            }
+        }
+
+    double binarySeconds = Time::getCurrentTime() - startTime;
+
+    int numParsed = numEncodable * numReps;
+
+    printf( "Text parse:    %.3f sec (%.0f ns per message), "
+            "%.2f allocations per message\n",
+            textSeconds, 1e9 * textSeconds / numParsed,
+            textAllocations / (double)numParsed );
+    printf( "Binary parse:  %.3f sec (%.0f ns per message), "
+            "%d allocations for %d SAY texts\n",
+            binarySeconds, 1e9 * binarySeconds / numParsed,
+            binaryAllocations, numSay );
+
+    if( binaryAllocations != numSay ) {
+        printf( "Binary parse allocated for more than SAY texts\n" );
+        numMismatches++;
+        }
+
+
+    // fuzz decoder with damaged frames, one after another in one buffer,
+    // so bad lengths run into the next frame
+    int numFuzz = 200000;
+    int numReady = 0;
+    int numBad = 0;
+    int numProblems = 0;
+
+    SimpleVector<unsigned char> frame;
+    SimpleVector<char> fuzzBuffer;
+
+    for( int f=0; f<numFuzz; f++ ) {
+        int i = randSource.getRandomBoundedInt( 0, messages.size() - 1 );
+
+        frame.deleteAll();
+        int start = frameStarts.getElementDirect( i );
+        int end = frameStarts.getElementDirect( i + 1 );
+        for( int b=start; b<end; b++ ) {
+            frame.push_back( allFrames.getElementDirect( b ) );
+            }
+
+        mutateFrame( &frame, &randSource );
+
+        if( frame.size() > 0 ) {
+            fuzzBuffer.appendArray( (char*)frame.getElement( 0 ),
+                                    frame.size() );
+            }
+
+        while( true ) {
+            ClientMessage m;
+            binaryClientFrameStatus status =
+                getNextBinaryClientMessage( &fuzzBuffer, birthPos, &m );
+
+            if( status == BINARY_FRAME_READY ) {
+                numReady++;
+                numProblems += checkDecoded( &m );
+                freeClientMessage( &m );
+                }
+            else if( status == BINARY_FRAME_PARTIAL ) {
+                if( fuzzBuffer.size() > BINARY_CLIENT_ACTION_MAX_BODY + 8 ) {
+                    // can't be partial with this much data
+                    numProblems++;
+                    fuzzBuffer.deleteAll();
+                    }
+                break;
+                }
+            else {
+                // server would disconnect here (or for NONE, read text)
+                if( status == BINARY_FRAME_BAD ) {
+                    numBad++;
+                    }
+                fuzzBuffer.deleteAll();
+                break;
+                }
+            }
+        }
+
+    // and the encoder with damaged text
+    for( int f=0; f<numFuzz; f++ ) {
+        int i = randSource.getRandomBoundedInt( 0, messages.size() - 1 );
+
+        char *text = stringDuplicate( messages.getElementDirect( i ) );
+        int len = strlen( text );
+
+        for( int n=0; n<3 && len > 0; n++ ) {
+            text[ randSource.getRandomBoundedInt( 0, len - 1 ) ] =
+                (char)randSource.getRandomBoundedInt( 1, 127 );
+            }
+
+        frame.deleteAll();
+        if( encodeBinaryClientAction( text, &frame ) ) {
+            // whatever encoder accepts must parse the same both ways
+            SimpleVector<char> buffer;
+            buffer.appendArray( (char*)frame.getElement( 0 ), frame.size() );
+
+            ClientMessage binaryM;
+            if( getNextBinaryClientMessage( &buffer, birthPos, &binaryM )
+                != BINARY_FRAME_READY ) {
+                numProblems++;
+                }
+            else {
+                if( strchr( text, '#' ) == NULL ) {
+                    ClientMessage textM = parseText( text, &textBuffer );
+                    if( ! sameMessage( &textM, &binaryM ) ) {
+                        printf( "Mismatch after damage:  %s\n", text );
+                        numProblems++;
+                        }
+                    freeClientMessage( &textM );
+                    textBuffer.deleteAll();
+                    }
+                freeClientMessage( &binaryM );
+                }
+            }
+        delete [] text;
+        }
+
+    printf( "Fuzzed %d damaged frames (%d decoded, %d rejected) "
+            "and %d damaged texts\n",
+            numFuzz, numReady, numBad, numFuzz );
+
+
+    for( int i=0; i<messages.size(); i++ ) {
+        delete [] messages.getElementDirect( i );
+        }
+
+    if( numMismatches > 0 || numProblems > 0 ) {
+        printf( "FAILED:  %d mismatches, %d fuzz problems\n",
+                numMismatches, numProblems );
+        return 1;
+        }
+
+    printf( "All results match\n" );
+    return 0;
+    }
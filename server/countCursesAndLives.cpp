@@ -1,7 +1,10 @@
 #include <stdio.h>
+#include <time.h>
 #include "minorGems/util/SimpleVector.h"
 #include "minorGems/util/stringUtils.h"
 
+#include "logArchive.h"
+
 
 typedef struct EmailRecord {
         char *email;
@@ -13,7 +16,7 @@ typedef struct EmailRecord {
 static SimpleVector<EmailRecord> records;
 
 
-EmailRecord *getRecord( char *inEmail, char inMakeNew = true ) {
+EmailRecord *getRecord( const char *inEmail, char inMakeNew = true ) {
     
     for( int i=0; i<records.size(); i++ ) {
         EmailRecord *r = records.getElement( i );
@@ -36,7 +39,129 @@ EmailRecord *getRecord( char *inEmail, char inMakeNew = true ) {
 
 
 
-int main() {
+// counts deaths and curse events from the archive's lifeLog and curseLog
+// folders, from rows logged between 30 days and 1 day ago, the window that
+// cursesVsMinutesPlayed.sh uses for text lifeLog files
+// returns false if no archive found
+char countFromArchive( const char *inServerDir, int inNumThreads ) {
+    char *archivePath = autoSprintf( "%s/logArchive", inServerDir );
+    
+    LogArchive *archive = openLogArchive( archivePath );
+    
+    delete [] archivePath;
+
+    if( archive == NULL ) {
+        return false;
+        }
+    
+    time_t t = time( NULL );
+    
+    LogArchiveQuery q;
+    
+    // lives first, so curses only counted for people who actually
+    // played recently
+    for( int pass=0; pass<2; pass++ ) {
+        
+        const char *folder = "lifeLog";
+        int timeColumn = LIFE_TIME;
+        int eventColumn = LIFE_EVENT;
+        char event = 'D';
+        int emailColumn = LIFE_EMAIL;
+        
+        if( pass == 0 ) {
+            initLogArchiveQuery( &q, LOG_ARCHIVE_LIFE );
+            q.columnMask = 
+                ( 1 << LIFE_TIME ) | ( 1 << LIFE_EVENT ) | 
+                ( 1 << LIFE_EMAIL ) | ( 1 << LIFE_AGE );
+            }
+        else {
+            initLogArchiveQuery( &q, LOG_ARCHIVE_CURSE );
+            q.columnMask = 
+                ( 1 << CURSE_TIME ) | ( 1 << CURSE_EVENT ) | 
+                ( 1 << CURSE_TARGET_EMAIL );
+            
+            folder = "curseLog";
+            timeColumn = CURSE_TIME;
+            eventColumn = CURSE_EVENT;
+            event = 'C';
+            emailColumn = CURSE_TARGET_EMAIL;
+            }
+        
+        // between 30 days and 1 day ago
+        q.minTime = t - 30 * 24 * 3600;
+        q.maxTime = t - 24 * 3600;
+        
+        int numPartitions;
+        LogArchivePartition **partitions = (LogArchivePartition **)
+            runLogArchiveQuery( archive, &q, inNumThreads, &numPartitions );
+        
+        for( int p=0; p<numPartitions; p++ ) {
+            LogArchivePartition *part = partitions[p];
+            
+            if( part == NULL ) {
+                continue;
+                }
+            
+            // only this server's own logs, not lifeLog_server2, etc.
+            if( strcmp( part->sourceFolder, folder ) == 0 ) {
+                
+                for( int i=0; i<part->numRows; i++ ) {
+                    double rowTime = 
+                        getLogArchiveNumber( part, timeColumn, i );
+                    
+                    if( rowTime < q.minTime || rowTime > q.maxTime ||
+                        getLogArchiveNumber( part, eventColumn, i ) 
+                        != event ) {
+                        continue;
+                        }
+                    
+                    const char *email = 
+                        getLogArchiveString( part, emailColumn, i );
+                    
+                    if( pass == 0 ) {
+                        EmailRecord *r = getRecord( email );
+                        r->lifeMinutes += 
+                            getLogArchiveNumber( part, LIFE_AGE, i );
+                        }
+                    else {
+                        EmailRecord *r = getRecord( email, false );
+                        
+                        if( r != NULL ) {
+                            r->curses ++;
+                            }
+                        }
+                    }
+                }
+            freeLogArchivePartition( part );
+            }
+        delete [] partitions;
+        }
+    
+    closeLogArchive( archive );
+
+    return true;
+    }
+
+
+
+// no args:  read tempCursedEmails.txt and tempEmailLives.txt
+// countCursesAndLives path_to_server_dir [num_threads]:  read logArchive
+int main( int inNumArgs, char **inArgs ) {
+    
+    if( inNumArgs > 1 ) {
+        int numThreads = 4;
+        
+        if( inNumArgs > 2 ) {
+            sscanf( inArgs[2], "%d", &numThreads );
+            }
+        
+        if( ! countFromArchive( inArgs[1], numThreads ) ) {
+            printf( "No logArchive found in %s\n", inArgs[1] );
+            return 0;
+            }
+        }
+    else {
+    
     FILE *curseFile = fopen( "tempCursedEmails.txt", "r" );
 
     FILE *livesFile = fopen( "tempEmailLives.txt", "r" );
@@ -95,6 +220,7 @@ int main() {
 
     fclose( curseFile );
     fclose( livesFile );
+        }
 
 
 
@@ -3,6 +3,7 @@
 
 
 #include "curses.h"
+#include "logWriter.h"
 
 
 
@@ -14,7 +15,7 @@
 
 #include "minorGems/system/Time.h"
 
-static FILE *logFile;
+static LogWriterFile *logFile;
 
 static int currentYear;
 static int currentDay;
@@ -45,17 +46,21 @@ static void openCurrentLogFiles() {
     
     char *newFileName = newFile->getFullFileName();
     
-    logFile = fopen( newFileName, "a" );
+    // open here, so a failure is noticed and retried next step
+    // writes, flushes, and closes happen on log writer thread
+    FILE *file = fopen( newFileName, "a" );
 
     delete newFile;
     
-    if( logFile == NULL ) {
+    if( file == NULL ) {
         AppLog::errorF( "Failed to open log file %s", newFileName );
         delete [] newFileName;
 
         return;
         }
 
+    logFile = logWriterAdopt( file, newFileName );
+
     // only set these if opened successfully
     currentYear = timeStruct->tm_year;
     currentDay = timeStruct->tm_yday;    
@@ -79,9 +84,7 @@ void initCurseLog() {
 
     if( logFile != NULL ) {
 
-        fprintf( logFile, "START %.0f\n", Time::timeSec() );
-        
-        fflush( logFile );
+        logWriterPrintf( logFile, "START %.0f\n", Time::timeSec() );
         }
     }
 
@@ -89,11 +92,9 @@ void initCurseLog() {
 
 void freeCurseLog() {
     if( logFile != NULL ) {
-        fprintf( logFile, "STOP %.0f\n", Time::timeSec() );
-        
-        fflush( logFile );
+        logWriterPrintf( logFile, "STOP %.0f\n", Time::timeSec() );
 
-        fclose( logFile );
+        logWriterClose( logFile );
         }
     }
 
@@ -107,7 +108,7 @@ static void stepLog() {
         timeStruct->tm_yday != currentDay ) {
 
         if( logFile != NULL ) {
-            fclose( logFile );
+            logWriterClose( logFile );
             logFile = NULL;
             }
         
@@ -125,12 +126,10 @@ void logCurse( int inPlayerID, char *inPlayerEmail,
 
         if( logFile != NULL ) {
 
-            fprintf( logFile, "C %.0f %d %s => %s\n",
-                     Time::timeSec(),
-                     inPlayerID, inPlayerEmail, 
-                     inTargetPlayerEmail );
-            
-            fflush( logFile );
+            logWriterPrintf( logFile, "C %.0f %d %s => %s\n",
+                             Time::timeSec(),
+                             inPlayerID, inPlayerEmail, 
+                             inTargetPlayerEmail );
             }
         }
     }
@@ -145,12 +144,10 @@ void logForgive( int inPlayerID, char *inPlayerEmail,
 
         if( logFile != NULL ) {
 
-            fprintf( logFile, "F %.0f %d %s => %s\n",
-                     Time::timeSec(),
-                     inPlayerID, inPlayerEmail, 
-                     inTargetPlayerEmail );
-            
-            fflush( logFile );
+            logWriterPrintf( logFile, "F %.0f %d %s => %s\n",
+                             Time::timeSec(),
+                             inPlayerID, inPlayerEmail, 
+                             inTargetPlayerEmail );
             }
         }
     }
@@ -164,11 +161,9 @@ void logForgiveAll( int inPlayerID, char *inPlayerEmail ) {
 
         if( logFile != NULL ) {
 
-            fprintf( logFile, "A %.0f %d %s\n",
-                     Time::timeSec(),
-                     inPlayerID, inPlayerEmail );
-            
-            fflush( logFile );
+            logWriterPrintf( logFile, "A %.0f %d %s\n",
+                             Time::timeSec(),
+                             inPlayerID, inPlayerEmail );
             }
         }
     }
@@ -183,12 +178,10 @@ void logForgiveAllEffect( char *inPlayerEmail,
 
         if( logFile != NULL ) {
 
-            fprintf( logFile, "A %.0f %s => %s\n",
-                     Time::timeSec(),
-                     inPlayerEmail, 
-                     inTargetPlayerEmail );
-            
-            fflush( logFile );
+            logWriterPrintf( logFile, "A %.0f %s => %s\n",
+                             Time::timeSec(),
+                             inPlayerEmail, 
+                             inTargetPlayerEmail );
             }
         }
     }
@@ -204,12 +197,10 @@ void logCurseExpire( char *inPlayerEmail,
 
         if( logFile != NULL ) {
 
-            fprintf( logFile, "E %.0f %s => %s\n",
-                     Time::timeSec(),
-                     inPlayerEmail, 
-                     inTargetPlayerEmail );
-            
-            fflush( logFile );
+            logWriterPrintf( logFile, "E %.0f %s => %s\n",
+                             Time::timeSec(),
+                             inPlayerEmail, 
+                             inTargetPlayerEmail );
             }
         }
     }
@@ -224,12 +215,10 @@ void logTrust( int inPlayerID, char *inPlayerEmail,
 
         if( logFile != NULL ) {
 
-            fprintf( logFile, "T %.0f %d %s => %s\n",
-                     Time::timeSec(),
-                     inPlayerID, inPlayerEmail, 
-                     inTargetPlayerEmail );
-            
-            fflush( logFile );
+            logWriterPrintf( logFile, "T %.0f %d %s => %s\n",
+                             Time::timeSec(),
+                             inPlayerID, inPlayerEmail, 
+                             inTargetPlayerEmail );
             }
         }
     }
@@ -244,11 +233,9 @@ void logCurseScore( char *inPlayerEmail,
 
         if( logFile != NULL ) {
 
-            fprintf( logFile, "S %.0f %s %d\n",
-                     Time::timeSec(), inPlayerEmail,
-                     inCurseScore );
-            
-            fflush( logFile );
+            logWriterPrintf( logFile, "S %.0f %s %d\n",
+                             Time::timeSec(), inPlayerEmail,
+                             inCurseScore );
             }
         }
     }
@@ -1,12 +1,20 @@
 
 
-./listCursedEmails.sh > tempCursedEmails.txt
+g++ -g -I../.. -o countCursesAndLives countCursesAndLives.cpp logArchive.cpp ../../minorGems/io/file/linux/PathLinux.cpp ../../minorGems/io/file/unix/DirectoryUnix.cpp ../../minorGems/util/stringUtils.cpp ../../minorGems/system/linux/ThreadLinux.cpp ../../minorGems/system/linux/MutexLockLinux.cpp -lpthread
 
 
-find lifeLog/ -type f -mtime -30 -mtime +0 -print0 | xargs -0 grep -h "^D " | sed "s/D [0-9]* [0-9]* //" | sed "s/ [FM] .*//" > tempEmailLives.txt
+if [ -d logArchive ]
+then
+	# counts curse events from curse logs, not curses still in curse DB
+	./countCursesAndLives .
+	exit
+fi
+
+
+./listCursedEmails.sh > tempCursedEmails.txt
 
 
-g++ -g -I../.. -o countCursesAndLives countCursesAndLives.cpp
+find lifeLog/ -type f -mtime -30 -mtime +0 -print0 | xargs -0 grep -h "^D " | sed "s/D [0-9]* [0-9]* //" | sed "s/ [FM] .*//" > tempEmailLives.txt
 
 
 ./countCursesAndLives
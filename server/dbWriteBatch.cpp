@@ -0,0 +1,429 @@
+#include "dbWriteBatch.h"
+
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/util/log/AppLog.h"
+
+#include <string.h>
+#include <stdio.h>
+
+
+
+// redo log record types
+// a DB header names the file behind a DB index, and must appear before any
+// puts to that index
+#define LOG_DB_HEADER 'D'
+#define LOG_PUT 'P'
+
+
+#define INITIAL_TABLE_SIZE 1024
+
+
+
+// FNV-1a over DB index and key bytes
+static unsigned int hashBatchKey( int inDBIndex, const unsigned char *inKey,
+                                  int inKeySize ) {
+    unsigned int hash = 2166136261U;
+
+    hash = ( hash ^ (unsigned char)inDBIndex ) * 16777619U;
+
+    for( int i=0; i<inKeySize; i++ ) {
+        hash = ( hash ^ inKey[i] ) * 16777619U;
+        }
+    return hash;
+    }
+
+
+
+DBWriteBatch::DBWriteBatch()
+        : mTable( new int[ INITIAL_TABLE_SIZE ] ),
+          mTableSize( INITIAL_TABLE_SIZE ),
+          mLogPath( NULL ),
+          mLogFile( NULL ) {
+
+    memset( mTable, -1, mTableSize * sizeof( int ) );
+    }
+
+
+
+DBWriteBatch::~DBWriteBatch() {
+    if( mLogFile != NULL ) {
+        fclose( mLogFile );
+        }
+    if( mLogPath != NULL ) {
+        delete [] mLogPath;
+        }
+    mDBPaths.deallocateStringElements();
+
+    delete [] mTable;
+    }
+
+
+
+char DBWriteBatch::openLog( const char *inLogPath ) {
+    if( mLogFile != NULL ) {
+        fclose( mLogFile );
+        }
+    // inLogPath may be mLogPath itself, when restarting log
+    char *newPath = stringDuplicate( inLogPath );
+
+    if( mLogPath != NULL ) {
+        delete [] mLogPath;
+        }
+
+    mLogPath = newPath;
+
+    mLogFile = fopen( mLogPath, "wb" );
+
+    if( mLogFile == NULL ) {
+        AppLog::errorF( "Failed to open DB write batch redo log %s",
+                        mLogPath );
+        return false;
+        }
+
+    for( int i=0; i<mDBs.size(); i++ ) {
+        writeLogHeader( i );
+        }
+    fflush( mLogFile );
+
+    return true;
+    }
+
+
+
+void DBWriteBatch::closeLog() {
+    char flushed = flush();
+
+    if( mLogFile != NULL ) {
+        fclose( mLogFile );
+        mLogFile = NULL;
+        }
+
+    if( mLogPath != NULL ) {
+        if( flushed ) {
+            remove( mLogPath );
+            }
+        // else leave it to be replayed on next startup
+        delete [] mLogPath;
+        mLogPath = NULL;
+        }
+
+    mDBs.deleteAll();
+    mDBPaths.deallocateStringElements();
+    }
+
+
+
+void DBWriteBatch::writeLogHeader( int inDBIndex ) {
+    if( mLogFile == NULL ) {
+        return;
+        }
+
+    LINEARDB3 *db = mDBs.getElementDirect( inDBIndex );
+    char *path = mDBPaths.getElementDirect( inDBIndex );
+
+    uint32_t header[3] = { db->keySize, db->valueSize,
+                           (uint32_t)strlen( path ) };
+
+    fputc( LOG_DB_HEADER, mLogFile );
+    fputc( inDBIndex, mLogFile );
+    fwrite( header, sizeof( uint32_t ), 3, mLogFile );
+    fwrite( path, 1, header[2], mLogFile );
+    }
+
+
+
+int DBWriteBatch::addDB( LINEARDB3 *inDB, const char *inPath ) {
+    mDBs.push_back( inDB );
+    mDBPaths.push_back( stringDuplicate( inPath ) );
+
+    int index = mDBs.size() - 1;
+
+    writeLogHeader( index );
+
+    return index;
+    }
+
+
+
+int DBWriteBatch::findSlot( int inDBIndex, const void *inKey ) {
+    int keySize = mDBs.getElementDirect( inDBIndex )->keySize;
+
+    unsigned int mask = (unsigned int)mTableSize - 1;
+
+    unsigned int slot =
+        hashBatchKey( inDBIndex, (const unsigned char*)inKey, keySize )
+        & mask;
+
+    while( true ) {
+        int r = mTable[ slot ];
+
+        if( r == -1 ) {
+            return slot;
+            }
+
+        DBWriteBatchRecord *rec = mRecords.getElement( r );
+
+        if( rec->dbIndex == inDBIndex &&
+            memcmp( rec->key, inKey, keySize ) == 0 ) {
+            return slot;
+            }
+
+        slot = ( slot + 1 ) & mask;
+        }
+    }
+
+
+
+void DBWriteBatch::rebuildTable( int inNewSize ) {
+    delete [] mTable;
+
+    mTableSize = inNewSize;
+    mTable = new int[ mTableSize ];
+    memset( mTable, -1, mTableSize * sizeof( int ) );
+
+    for( int i=0; i<mRecords.size(); i++ ) {
+        DBWriteBatchRecord *rec = mRecords.getElement( i );
+
+        mTable[ findSlot( rec->dbIndex, rec->key ) ] = i;
+        }
+    }
+
+
+
+void DBWriteBatch::put( int inDBIndex, const void *inKey,
+                        const void *inValue ) {
+
+    LINEARDB3 *db = mDBs.getElementDirect( inDBIndex );
+
+    if( mLogFile != NULL ) {
+        fputc( LOG_PUT, mLogFile );
+        fputc( inDBIndex, mLogFile );
+        fwrite( inKey, db->keySize, 1, mLogFile );
+        fwrite( inValue, db->valueSize, 1, mLogFile );
+
+        // a single sequential append, instead of the seeks, reads, and
+        // writes that a direct DB put costs
+        fflush( mLogFile );
+        }
+
+
+    int slot = findSlot( inDBIndex, inKey );
+
+    if( mTable[ slot ] != -1 ) {
+        // coalesce with earlier put to same key
+        DBWriteBatchRecord *rec = mRecords.getElement( mTable[ slot ] );
+        memcpy( rec->value, inValue, db->valueSize );
+        return;
+        }
+
+    DBWriteBatchRecord rec;
+    rec.dbIndex = inDBIndex;
+    memcpy( rec.key, inKey, db->keySize );
+    memcpy( rec.value, inValue, db->valueSize );
+
+    mRecords.push_back( rec );
+    mTable[ slot ] = mRecords.size() - 1;
+
+    if( mRecords.size() * 2 > mTableSize ) {
+        rebuildTable( mTableSize * 2 );
+        }
+    }
+
+
+
+char DBWriteBatch::get( int inDBIndex, const void *inKey, void *outValue ) {
+    if( mRecords.size() == 0 ) {
+        return false;
+        }
+
+    int r = mTable[ findSlot( inDBIndex, inKey ) ];
+
+    if( r == -1 ) {
+        return false;
+        }
+
+    memcpy( outValue, mRecords.getElement( r )->value,
+            mDBs.getElementDirect( inDBIndex )->valueSize );
+    return true;
+    }
+
+
+
+char DBWriteBatch::flush() {
+    int numRecords = mRecords.size();
+
+    if( numRecords == 0 ) {
+        return true;
+        }
+
+    char success = true;
+
+    unsigned char *keys =
+        new unsigned char[ numRecords * DB_WRITE_BATCH_MAX_KEY ];
+    unsigned char *values =
+        new unsigned char[ numRecords * DB_WRITE_BATCH_MAX_VALUE ];
+
+    for( int d=0; d<mDBs.size(); d++ ) {
+        LINEARDB3 *db = mDBs.getElementDirect( d );
+
+        unsigned int numForDB = 0;
+
+        for( int i=0; i<numRecords; i++ ) {
+            DBWriteBatchRecord *rec = mRecords.getElement( i );
+
+            if( rec->dbIndex == d ) {
+                memcpy( &( keys[ numForDB * db->keySize ] ),
+                        rec->key, db->keySize );
+                memcpy( &( values[ numForDB * db->valueSize ] ),
+                        rec->value, db->valueSize );
+                numForDB++;
+                }
+            }
+
+        if( numForDB == 0 ) {
+            continue;
+            }
+
+        if( LINEARDB3_putMany( db, numForDB, keys, values ) != 0 ) {
+            AppLog::errorF( "Failed to flush %d batched writes to %s",
+                            numForDB, mDBPaths.getElementDirect( d ) );
+            success = false;
+            }
+
+        // make sure DB file holds everything before we drop the log
+        if( db->file != NULL ) {
+            fflush( db->file );
+            }
+        }
+
+    delete [] keys;
+    delete [] values;
+
+
+    mRecords.deleteAll();
+
+    if( mTableSize > INITIAL_TABLE_SIZE && numRecords * 8 < mTableSize ) {
+        // last batch was much smaller than table, shrink it
+        rebuildTable( INITIAL_TABLE_SIZE );
+        }
+    else {
+        memset( mTable, -1, mTableSize * sizeof( int ) );
+        }
+
+
+    if( success && mLogPath != NULL ) {
+        // start log over
+        openLog( mLogPath );
+        }
+
+    return success;
+    }
+
+
+
+int replayDBWriteBatchLog( const char *inLogPath ) {
+    FILE *logFile = fopen( inLogPath, "rb" );
+
+    if( logFile == NULL ) {
+        // nothing left behind
+        return 0;
+        }
+
+    // indexed by DB index in log
+    LINEARDB3 *dbs[256];
+    memset( dbs, 0, sizeof( dbs ) );
+
+    unsigned char key[ DB_WRITE_BATCH_MAX_KEY ];
+    unsigned char value[ DB_WRITE_BATCH_MAX_VALUE ];
+
+    int numApplied = 0;
+    char error = false;
+
+    while( ! error ) {
+        int type = fgetc( logFile );
+        int index = fgetc( logFile );
+
+        if( type == EOF || index == EOF ) {
+            break;
+            }
+
+        if( type == LOG_DB_HEADER ) {
+            uint32_t header[3];
+
+            if( fread( header, sizeof( uint32_t ), 3, logFile ) != 3 ||
+                header[0] > DB_WRITE_BATCH_MAX_KEY ||
+                header[1] > DB_WRITE_BATCH_MAX_VALUE ||
+                header[2] > 1024 ) {
+                break;
+                }
+
+            char *path = new char[ header[2] + 1 ];
+
+            if( fread( path, 1, header[2], logFile ) != header[2] ) {
+                delete [] path;
+                break;
+                }
+            path[ header[2] ] = '\0';
+
+            if( dbs[ index ] == NULL ) {
+                LINEARDB3 *db = new LINEARDB3;
+
+                if( LINEARDB3_open( db, path, 0, 80000,
+                                    header[0], header[1] ) != 0 ) {
+                    AppLog::errorF( "Failed to open %s to replay redo log %s",
+                                    path, inLogPath );
+                    delete db;
+                    error = true;
+                    }
+                else {
+                    dbs[ index ] = db;
+                    }
+                }
+            delete [] path;
+            }
+        else if( type == LOG_PUT ) {
+            LINEARDB3 *db = dbs[ index ];
+
+            if( db == NULL ) {
+                AppLog::errorF( "Redo log %s has put for unknown DB %d",
+                                inLogPath, index );
+                error = true;
+                break;
+                }
+
+            if( fread( key, db->keySize, 1, logFile ) != 1 ||
+                fread( value, db->valueSize, 1, logFile ) != 1 ) {
+                // partial record from crash mid-write, never acknowledged
+                break;
+                }
+
+            if( LINEARDB3_put( db, key, value ) != 0 ) {
+                error = true;
+                break;
+                }
+            numApplied++;
+            }
+        else {
+            AppLog::errorF( "Bad record type %d in redo log %s",
+                            type, inLogPath );
+            error = true;
+            }
+        }
+
+    fclose( logFile );
+
+    for( int i=0; i<256; i++ ) {
+        if( dbs[i] != NULL ) {
+            LINEARDB3_close( dbs[i] );
+            delete dbs[i];
+            }
+        }
+
+    if( error ) {
+        return -1;
+        }
+
+    remove( inLogPath );
+
+    return numApplied;
+    }
@@ -0,0 +1,109 @@
+#ifndef DB_WRITE_BATCH_H_INCLUDED
+#define DB_WRITE_BATCH_H_INCLUDED
+
+
+#include "lineardb3.h"
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// big enough for all of the map DBs
+#define DB_WRITE_BATCH_MAX_KEY 16
+#define DB_WRITE_BATCH_MAX_VALUE 16
+
+
+
+typedef struct DBWriteBatchRecord {
+        int dbIndex;
+        unsigned char key[ DB_WRITE_BATCH_MAX_KEY ];
+        unsigned char value[ DB_WRITE_BATCH_MAX_VALUE ];
+    } DBWriteBatchRecord;
+
+
+
+// Collects puts to a set of LINEARDB3 databases in RAM, coalescing repeated
+// puts to the same key, and applies them all at once with LINEARDB3_putMany.
+//
+// Every put is also appended to a redo log before it returns, so pending
+// puts survive a server crash.  The log is emptied after each flush, and
+// replayDBWriteBatchLog applies any leftover log on the next startup.
+class DBWriteBatch {
+    public:
+
+        DBWriteBatch();
+
+        // pending puts are NOT flushed
+        ~DBWriteBatch();
+
+
+        // starts a fresh redo log at inLogPath, replacing any existing
+        // file there
+        // returns true on success
+        char openLog( const char *inLogPath );
+
+        // flushes and removes log, and forgets all DBs
+        void closeLog();
+
+
+        // inPath is the DB's file path, recorded in the redo log
+        // key and value sizes must be no bigger than the MAX defines above
+        //
+        // returns index used to refer to this DB in other calls
+        int addDB( LINEARDB3 *inDB, const char *inPath );
+
+
+        void put( int inDBIndex, const void *inKey, const void *inValue );
+
+
+        // returns true and fills outValue if a put is pending for inKey
+        char get( int inDBIndex, const void *inKey, void *outValue );
+
+
+        // applies all pending puts to their DBs, and empties the redo log
+        // returns false on a DB write error
+        char flush();
+
+
+        int getNumPending() {
+            return mRecords.size();
+            }
+
+
+    private:
+
+        SimpleVector<LINEARDB3*> mDBs;
+        SimpleVector<char*> mDBPaths;
+
+        SimpleVector<DBWriteBatchRecord> mRecords;
+
+        // open-addressing index into mRecords, -1 for empty slots
+        // size is always a power of 2
+        int *mTable;
+        int mTableSize;
+
+        char *mLogPath;
+        FILE *mLogFile;
+
+
+        int findSlot( int inDBIndex, const void *inKey );
+
+        void rebuildTable( int inNewSize );
+
+        void writeLogHeader( int inDBIndex );
+
+    };
+
+
+
+// applies puts from a redo log left behind by a DBWriteBatch that was never
+// flushed (server crashed), opening and closing the DB files named in
+// the log
+// Must be called before those DB files are opened elsewhere.
+// Log file is removed afterward.
+//
+// returns number of puts applied, or -1 on error
+int replayDBWriteBatchLog( const char *inLogPath );
+
+
+#endif
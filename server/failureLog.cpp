@@ -13,8 +13,10 @@
 
 #include "../gameSource/objectBank.h"
 
+#include "logWriter.h"
 
-static FILE *logFile;
+
+static LogWriterFile *logFile;
 
 static int currentYear;
 static int currentDay;
@@ -22,7 +24,7 @@ static int currentHour;
 
 
 
-static FILE *openCurrentLogFile() {
+static LogWriterFile *openCurrentLogFile() {
     time_t t = time( NULL );
     struct tm *timeStruct = localtime( &t );
     
@@ -45,12 +47,18 @@ static FILE *openCurrentLogFile() {
     
     char *newFileName = newFile->getFullFileName();
     
+    // open here, so a failure is noticed right away
+    // writes, flushes, and closes happen on log writer thread
     FILE *file = fopen( newFileName, "a" );
     
+    LogWriterFile *writerFile = NULL;
+
     if( file == NULL ) {
         AppLog::errorF( "Failed to open log file %s", newFileName );
         }
     else {
+        writerFile = logWriterAdopt( file, newFileName );
+
         currentYear = timeStruct->tm_year;
         currentDay = timeStruct->tm_yday;
         }
@@ -58,7 +66,7 @@ static FILE *openCurrentLogFile() {
     delete newFile;
     delete [] newFileName;
     
-    return file;
+    return writerFile;
     }
 
 
@@ -126,7 +134,7 @@ static void stepLog( char inForceOutput ) {
         // hour change
         // add latest data averages to file
         
-        fprintf( logFile, "hour=%d\n", currentHour );
+        logWriterPrintf( logFile, "hour=%d\n", currentHour );
 
         for( int i=0; i<=maxSeenObjectID; i++ ) {
             
@@ -136,7 +144,7 @@ static void stepLog( char inForceOutput ) {
                     
                     FailureRecord *r = failureLists[i].getElement( j );
                     
-                    fprintf( 
+                    logWriterPrintf( 
                         logFile, 
                         "%d + %d  count=%d\n",
                         r->actorID,
@@ -147,8 +155,6 @@ static void stepLog( char inForceOutput ) {
                 failureLists[i].deleteAll();
                 }
             }
-        
-        fflush( logFile );
 
         maxSeenObjectID = 0;        
         currentHour = timeStruct->tm_hour;
@@ -159,7 +165,7 @@ static void stepLog( char inForceOutput ) {
         timeStruct->tm_yday != currentDay ) {
 
         if( logFile != NULL ) {
-            fclose( logFile );
+            logWriterClose( logFile );
             }
         
         logFile = openCurrentLogFile();
@@ -174,7 +180,7 @@ void freeFailureLog() {
         // final output
         stepLog( true );
         
-        fclose( logFile );
+        logWriterClose( logFile );
         }
     delete [] failureLists;
     }
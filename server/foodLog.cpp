@@ -12,9 +12,11 @@
 
 #include "../gameSource/objectBank.h"
 
+#include "logWriter.h"
 
-static FILE *logFile;
-static FILE *logDetailFile;
+
+static LogWriterFile *logFile;
+static LogWriterFile *logDetailFile;
 
 static int currentYear;
 static int currentDay;
@@ -22,7 +24,7 @@ static int currentHour;
 
 
 
-static FILE *openCurrentLogFile( const char *inDirName ) {
+static LogWriterFile *openCurrentLogFile( const char *inDirName ) {
     time_t t = time( NULL );
     struct tm *timeStruct = localtime( &t );
     
@@ -45,12 +47,18 @@ static FILE *openCurrentLogFile( const char *inDirName ) {
     
     char *newFileName = newFile->getFullFileName();
     
+    // open here, so a failure is noticed right away
+    // writes, flushes, and closes happen on log writer thread
     FILE *file = fopen( newFileName, "a" );
     
+    LogWriterFile *writerFile = NULL;
+
     if( file == NULL ) {
         AppLog::errorF( "Failed to open log file %s", newFileName );
         }
     else {
+        writerFile = logWriterAdopt( file, newFileName );
+
         currentYear = timeStruct->tm_year;
         currentDay = timeStruct->tm_yday;
         }
@@ -58,18 +66,18 @@ static FILE *openCurrentLogFile( const char *inDirName ) {
     delete newFile;
     delete [] newFileName;
     
-    return file;
+    return writerFile;
     }
 
 
 
 
-static FILE *openCurrentLogFile() {
+static LogWriterFile *openCurrentLogFile() {
     return openCurrentLogFile( "foodLog" );
     }
 
 
-static FILE *openCurrentDetailLogFile() {
+static LogWriterFile *openCurrentDetailLogFile() {
     return openCurrentLogFile( "foodLogDetail" );
     }
 
@@ -142,13 +150,13 @@ static void stepLog( char inForceOutput ) {
         // hour change
         // add latest data averages to file
         
-        fprintf( logFile, "hour=%d\n", currentHour );
+        logWriterPrintf( logFile, "hour=%d\n", currentHour );
 
         for( int i=0; i<=maxSeenObjectID; i++ ) {
             
             if( eatFoodCounts[i] > 0 ) {
                 
-                fprintf( 
+                logWriterPrintf( 
                     logFile, 
                     "id=%d count=%d value=%d av_age=%f "
                     "av_mapX=%d av_mapY=%d\n",
@@ -165,8 +173,6 @@ static void stepLog( char inForceOutput ) {
                 mapLocationSums[i].y = 0.0;
                 }
             }
-        
-        fflush( logFile );
 
         maxSeenObjectID = 0;        
         currentHour = timeStruct->tm_hour;
@@ -179,10 +185,10 @@ static void stepLog( char inForceOutput ) {
         // open new files each day change
 
         if( logFile != NULL ) {
-            fclose( logFile );
+            logWriterClose( logFile );
             }
         if( logDetailFile != NULL ) {
-            fclose( logDetailFile );
+            logWriterClose( logDetailFile );
             }
         
         logFile = openCurrentLogFile();
@@ -198,11 +204,11 @@ void freeFoodLog() {
         // final output
         stepLog( true );
         
-        fclose( logFile );
+        logWriterClose( logFile );
         }
     
     if( logDetailFile != NULL ) {
-        fclose( logDetailFile );
+        logWriterClose( logDetailFile );
         }
     
     delete [] eatFoodCounts;
@@ -250,8 +256,8 @@ void logEating( int inPlayerID,
         }
 
     if( logDetailFile != NULL ) {
-        fprintf( logDetailFile, "%.2f %d %d\n", 
-                 Time::getCurrentTime(), inPlayerID, idToLog );
+        logWriterPrintf( logDetailFile, "%.2f %d %d\n", 
+                         Time::getCurrentTime(), inPlayerID, idToLog );
         }
 
     }
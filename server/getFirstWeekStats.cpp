@@ -6,13 +6,20 @@
 #include "minorGems/util/SimpleVector.h"
 #include "minorGems/util/StringTree.h"
 #include "minorGems/util/crc32.h"
+#include "minorGems/util/stringUtils.h"
+
+#include "logArchive.h"
 
 
 int binSeconds = 3600 * 24 * 7;
 
 
 void usage() {
-    printf( "Usage:\n\ngetFirstWeekStats lifeLogDir [bin_seconds]\n\n" );
+    printf( "Usage:\n\ngetFirstWeekStats lifeLogDir [bin_seconds] "
+            "[num_threads]\n\n" );
+    printf( "If lifeLogDir contains a logArchive dir made by archiveLogs,\n"
+            "that is read instead, using num_threads threads "
+            "(default 4)\n\n" );
     exit( 0 );
     }
 
@@ -325,6 +332,46 @@ void processSubDir( File *inFile ) {
     }
 
 
+// births and deaths from archive, in order partitions were written
+void processArchivePartitions( LogArchivePartition **inPartitions,
+                               int inNumPartitions ) {
+    
+    for( int p=0; p<inNumPartitions; p++ ) {
+        LogArchivePartition *part = inPartitions[p];
+
+        printf("\r%5d/%d (%5d unique records) (%7d total email bytes)", 
+               p, inNumPartitions,
+               records.size(),
+               totalEmailAllocation );
+        fflush( stdout );
+        
+        if( part == NULL ) {
+            continue;
+            }
+        
+        for( int i=0; i<part->numRows; i++ ) {
+            char bOrD = (char)getLogArchiveNumber( part, LIFE_EVENT, i );
+            double t = getLogArchiveNumber( part, LIFE_TIME, i );
+            int id = (int)getLogArchiveNumber( part, LIFE_ID, i );
+            
+            // same 99-char limit as text scan
+            char emailBuffer[100];
+            snprintf( emailBuffer, sizeof( emailBuffer ), "%s",
+                      getLogArchiveString( part, LIFE_EMAIL, i ) );
+            
+            if( bOrD == 'B' ) {
+                addBirth( emailBuffer, t, id );
+                }
+            else if( bOrD == 'D' ) {
+                addDeath( emailBuffer, t, id );
+                }
+            }
+        }
+    printf( "\n" );
+    }
+
+
+
 void processDir( File *inDir ) {
     int numChildFiles;
     File **childFiles = inDir->getChildFiles( &numChildFiles );
@@ -344,14 +391,20 @@ int main( int inNumArgs, char **inArgs ) {
 
     hashTableInit();
     
-    if( inNumArgs != 2 && inNumArgs != 3 ) {
+    if( inNumArgs < 2 || inNumArgs > 4 ) {
         usage();
         }
     
-    if( inNumArgs == 3 ) {
+    if( inNumArgs >= 3 ) {
         sscanf( inArgs[2], "%d", &binSeconds );
         }
     
+    int numThreads = 4;
+    
+    if( inNumArgs == 4 ) {
+        sscanf( inArgs[3], "%d", &numThreads );
+        }
+
     char *dirName = inArgs[1];
     
     File dirFile( NULL, dirName );
@@ -361,9 +414,42 @@ int main( int inNumArgs, char **inArgs ) {
         usage();
         }
 
+
+    char *archiveName = autoSprintf( "%s/logArchive", dirName );
+    
+    LogArchive *archive = openLogArchive( archiveName );
+    
+    delete [] archiveName;
+    
+    LogArchivePartition **partitions = NULL;
+    int numPartitions = 0;
+    
+    if( archive != NULL ) {
+        printf( "\n\nReading log archive\n" );
+        
+        LogArchiveQuery q;
+        initLogArchiveQuery( &q, LOG_ARCHIVE_LIFE );
+        
+        q.columnMask = 
+            ( 1 << LIFE_TIME ) | ( 1 << LIFE_EVENT ) | 
+            ( 1 << LIFE_ID ) | ( 1 << LIFE_EMAIL );
+        
+        // keep partitions for both passes
+        partitions = (LogArchivePartition **)
+            runLogArchiveQuery( archive, &q, numThreads, &numPartitions );
+        
+        closeLogArchive( archive );
+        }
+    
+
     // process once to get first life time for each player
     printf( "\n\nFirst pass\n" );
-    processDir( &dirFile );
+    if( partitions != NULL ) {
+        processArchivePartitions( partitions, numPartitions );
+        }
+    else {
+        processDir( &dirFile );
+        }
     
     
     // now clean all records of everything BUT first and last life time
@@ -377,7 +463,19 @@ int main( int inNumArgs, char **inArgs ) {
     
     // process again here
     printf( "\n\nSecond pass\n" );
-    processDir( &dirFile );
+    if( partitions != NULL ) {
+        processArchivePartitions( partitions, numPartitions );
+        
+        for( int p=0; p<numPartitions; p++ ) {
+            if( partitions[p] != NULL ) {
+                freeLogArchivePartition( partitions[p] );
+                }
+            }
+        delete [] partitions;
+        }
+    else {
+        processDir( &dirFile );
+        }
 
     
     // now we have actual binned life times, in bin starting at
@@ -35,6 +35,9 @@
 //#define USE_LINEARDB2
 #define USE_LINEARDB3
 
+// test LINEARDB3 in memory-mapped mode
+//#define USE_LINEARDB3_MMAP
+
 
 
 #ifdef USE_KISSDB
@@ -230,6 +233,11 @@ int main() {
    
 
     int tableSize = TABLE_SIZE;
+
+    #if defined( USE_LINEARDB3 ) && defined( USE_LINEARDB3_MMAP )
+    printf( "Using memory-mapped LinearDB3 file\n" );
+    LINEARDB3_setUseMmap( true );
+    #endif
     
     int error = DB_open( &db, 
                              "test.db", 
@@ -243,6 +243,9 @@ static void closeFreqMirrorShuffle( SimpleVector<int> *inIndexList,
 
 
 
+static unsigned int nextLearningMapVersion = 1;
+
+
 typedef struct LanguageLearningMap {
         int eveIDA;
         int eveIDB;
@@ -254,6 +257,12 @@ typedef struct LanguageLearningMap {
         // false until first utterance heard by listener
         char firstPhraseHeard;
         
+        // unique across all maps, and changed every time this map learns
+        // something, so that translations made with this map can be
+        // cached and reused until it changes
+        // 0 for the blank map
+        unsigned int version;
+
         // these are false if the mapping is not learned, true if learned
         char startingMapping[ NUM_STARTING_CONSONANT_CLUSTERS ];
         char endingMapping[ NUM_ENDING_CONSONANT_CLUSTERS ];
@@ -353,6 +362,7 @@ static const char *clusterMap(
             
             // B learns this for the future
             inLearnB->allMappings[inSetIndex][inClusterIndex] = true;
+            inLearnB->version = nextLearningMapVersion++;
             
             // need back-mapping too
             // search source map for dest cluster
@@ -655,6 +665,7 @@ static void initMapping( LanguageLearningMap *inMap,
     inMap->eveIDB = inEveIDB;
     inMap->playerID = inPlayerID;
     inMap->firstPhraseHeard = false;
+    inMap->version = nextLearningMapVersion++;
 
     inMap->allMappings[ START_I ] = inMap->startingMapping;
     inMap->allMappings[ END_I ] = inMap->endingMapping;
@@ -698,6 +709,283 @@ static LanguageLearningMap blankLearningMap;
 
 
 
+// open-addressing index of every map in learningRecords by
+// (playerID, eveIDA, eveIDB), so that finding the speaker's and each
+// listener's map doesn't scan all players and all of their maps
+// size is always a power of 2, and table is at most half full
+static LanguageLearningMap **learningMapTable = NULL;
+static int learningMapTableSize = 0;
+static int learningMapTableCount = 0;
+
+#define MIN_LEARNING_MAP_TABLE_SIZE 256
+
+
+
+static unsigned int hashLearningMapKey( int inPlayerID, 
+                                        int inEveIDA, int inEveIDB ) {
+    unsigned int hash = (unsigned int)inPlayerID * 0x9E3779B1U;
+    
+    hash = ( hash ^ (unsigned int)inEveIDA ) * 0x85EBCA77U;
+    hash = ( hash ^ (unsigned int)inEveIDB ) * 0xC2B2AE3DU;
+    
+    return hash ^ ( hash >> 16 );
+    }
+
+
+
+// returns slot holding matching map, or empty slot where it would go
+static int findLearningMapSlot( int inPlayerID, 
+                                int inEveIDA, int inEveIDB ) {
+    
+    unsigned int mask = (unsigned int)learningMapTableSize - 1;
+    
+    unsigned int slot = 
+        hashLearningMapKey( inPlayerID, inEveIDA, inEveIDB ) & mask;
+    
+    while( true ) {
+        LanguageLearningMap *m = learningMapTable[ slot ];
+        
+        if( m == NULL ||
+            ( m->playerID == inPlayerID && 
+              m->eveIDA == inEveIDA && 
+              m->eveIDB == inEveIDB ) ) {
+            return slot;
+            }
+        
+        slot = ( slot + 1 ) & mask;
+        }
+    }
+
+
+
+static void rebuildLearningMapIndex( int inMinCount ) {
+    if( learningMapTable != NULL ) {
+        delete [] learningMapTable;
+        }
+    
+    learningMapTableSize = MIN_LEARNING_MAP_TABLE_SIZE;
+    
+    while( learningMapTableSize < inMinCount * 4 ) {
+        learningMapTableSize *= 2;
+        }
+    
+    learningMapTable = new LanguageLearningMap*[ learningMapTableSize ];
+    memset( learningMapTable, 0, 
+            learningMapTableSize * sizeof( LanguageLearningMap* ) );
+    learningMapTableCount = 0;
+
+    for( int p=0; p<learningRecords.size(); p++ ) {
+        PlayerLearningRecord *r = learningRecords.getElementDirect( p );
+        
+        for( int m=0; m<r->learningMaps.size(); m++ ) {
+            LanguageLearningMap *map = r->learningMaps.getElementDirect( m );
+            
+            learningMapTable[ findLearningMapSlot( map->playerID,
+                                                   map->eveIDA,
+                                                   map->eveIDB ) ] = map;
+            learningMapTableCount++;
+            }
+        }
+    }
+
+
+
+// call after inMap has been added to learningRecords
+static void insertLearningMapIndex( LanguageLearningMap *inMap ) {
+    if( learningMapTable == NULL || 
+        ( learningMapTableCount + 1 ) * 2 > learningMapTableSize ) {
+        // rebuild includes inMap
+        rebuildLearningMapIndex( learningMapTableCount + 1 );
+        return;
+        }
+    
+    learningMapTable[ findLearningMapSlot( inMap->playerID,
+                                           inMap->eveIDA,
+                                           inMap->eveIDB ) ] = inMap;
+    learningMapTableCount++;
+    }
+
+
+
+static void removeLearningMapIndex( LanguageLearningMap *inMap ) {
+    if( learningMapTable == NULL ) {
+        return;
+        }
+    
+    unsigned int mask = (unsigned int)learningMapTableSize - 1;
+
+    unsigned int hole = findLearningMapSlot( inMap->playerID,
+                                             inMap->eveIDA,
+                                             inMap->eveIDB );
+    
+    if( learningMapTable[ hole ] != inMap ) {
+        return;
+        }
+    
+    // shift later maps in this probe run back into hole, if
+    // their home slot allows it
+    unsigned int next = hole;
+    
+    while( true ) {
+        next = ( next + 1 ) & mask;
+        
+        LanguageLearningMap *m = learningMapTable[ next ];
+        
+        if( m == NULL ) {
+            break;
+            }
+        
+        unsigned int home = 
+            hashLearningMapKey( m->playerID, m->eveIDA, m->eveIDB ) & mask;
+        
+        char homeInRun;
+        
+        if( hole <= next ) {
+            homeInRun = ( hole < home && home <= next );
+            }
+        else {
+            homeInRun = ( hole < home || home <= next );
+            }
+        
+        if( ! homeInRun ) {
+            learningMapTable[ hole ] = m;
+            hole = next;
+            }
+        }
+    
+    learningMapTable[ hole ] = NULL;
+    learningMapTableCount--;
+    }
+
+
+
+
+// Translations are cached when the listener can't learn from them, because
+// then the result only depends on the phrase, the two languages, and the
+// contents of the two learning maps, which the map versions stand for.
+// All the adult listeners of a lineage who never learned the speaker's 
+// language share the blank map, and thus share cached translations.
+//
+// Direct-mapped, so a new entry replaces whatever was in its slot.
+typedef struct TranslationCacheEntry {
+        // NULL if slot empty
+        char *phrase;
+        unsigned int hash;
+        
+        int eveIDA;
+        int eveIDB;
+        unsigned int versionA;
+        unsigned int versionB;
+        double fractionToPassThrough;
+        
+        char *translation;
+    } TranslationCacheEntry;
+
+
+static TranslationCacheEntry *translationCache = NULL;
+
+// power of 2, or 0 if cache off
+static int translationCacheSize = 0;
+
+
+
+static void clearTranslationCache() {
+    for( int i=0; i<translationCacheSize; i++ ) {
+        TranslationCacheEntry *e = &( translationCache[i] );
+        
+        if( e->phrase != NULL ) {
+            delete [] e->phrase;
+            delete [] e->translation;
+            e->phrase = NULL;
+            e->translation = NULL;
+            }
+        }
+    }
+
+
+
+static void setTranslationCacheSize( int inSize ) {
+    int newSize = 0;
+    
+    if( inSize > 0 ) {
+        newSize = 1;
+        while( newSize < inSize ) {
+            newSize *= 2;
+            }
+        }
+    
+    if( newSize == translationCacheSize ) {
+        return;
+        }
+    
+    if( translationCache != NULL ) {
+        clearTranslationCache();
+        delete [] translationCache;
+        translationCache = NULL;
+        }
+    
+    translationCacheSize = newSize;
+    
+    if( translationCacheSize > 0 ) {
+        translationCache = new TranslationCacheEntry[ translationCacheSize ];
+        
+        for( int i=0; i<translationCacheSize; i++ ) {
+            translationCache[i].phrase = NULL;
+            translationCache[i].translation = NULL;
+            }
+        }
+    }
+
+
+
+static unsigned int hashTranslationKey( const char *inPhrase,
+                                        int inEveIDA, int inEveIDB,
+                                        unsigned int inVersionA,
+                                        unsigned int inVersionB ) {
+    // FNV-1a
+    unsigned int hash = 2166136261U;
+    
+    for( const char *c = inPhrase; *c != '\0'; c++ ) {
+        hash = ( hash ^ (unsigned char)( *c ) ) * 16777619U;
+        }
+    
+    hash = ( hash ^ (unsigned int)inEveIDA ) * 0x9E3779B1U;
+    hash = ( hash ^ (unsigned int)inEveIDB ) * 0x85EBCA77U;
+    hash = ( hash ^ inVersionA ) * 0xC2B2AE3DU;
+    hash = ( hash ^ inVersionB ) * 0x9E3779B1U;
+    
+    return hash ^ ( hash >> 16 );
+    }
+
+
+
+static TranslationCacheEntry *getTranslationCacheSlot( 
+    unsigned int inHash ) {
+    
+    return &( translationCache[ inHash & ( translationCacheSize - 1 ) ] );
+    }
+
+
+
+static char entryMatches( TranslationCacheEntry *inEntry,
+                          unsigned int inHash,
+                          const char *inPhrase,
+                          int inEveIDA, int inEveIDB,
+                          unsigned int inVersionA,
+                          unsigned int inVersionB,
+                          double inFractionToPassThrough ) {
+    return 
+        inEntry->phrase != NULL &&
+        inEntry->hash == inHash &&
+        inEntry->eveIDA == inEveIDA &&
+        inEntry->eveIDB == inEveIDB &&
+        inEntry->versionA == inVersionA &&
+        inEntry->versionB == inVersionB &&
+        inEntry->fractionToPassThrough == inFractionToPassThrough &&
+        strcmp( inEntry->phrase, inPhrase ) == 0;
+    }
+
+
 
 // if age too old to learn, and no map exists, returns NULL
 // if young enough to learn, and no map exists, returns fresh map
@@ -706,6 +994,20 @@ static LanguageLearningMap *getPlayerLearningMap( int inEveIDA, int inEveIDB,
                                                   double inPlayerAge,
                                                   int inParentID = -1 ) {
     
+    if( learningMapTable != NULL ) {
+        LanguageLearningMap *map = 
+            learningMapTable[ findLearningMapSlot( inPlayerID,
+                                                   inEveIDA, inEveIDB ) ];
+        if( map != NULL ) {
+            return map;
+            }
+        }
+    
+    // no player map for this eve combo
+    if( inPlayerAge > maxLanguageLearningAge ) {
+        return NULL;
+        }
+    
     PlayerLearningRecord *playerRec = NULL;
     
     for( int p=0; p < learningRecords.size(); p++ ) {
@@ -719,64 +1021,43 @@ static LanguageLearningMap *getPlayerLearningMap( int inEveIDA, int inEveIDB,
     
     if( playerRec == NULL ) {
         // no rec for this player
-        if( inPlayerAge > maxLanguageLearningAge ) {
-            return NULL;
-            }
         playerRec = new PlayerLearningRecord;
         playerRec->playerID = inPlayerID;
         
         learningRecords.push_back( playerRec );
         }
 
-    LanguageLearningMap *map = NULL;
+    // copy from parent, if it exists
+    LanguageLearningMap *parentMap = NULL;
     
-    for( int m=0; m< playerRec->learningMaps.size(); m++ ) {
-        LanguageLearningMap *checkMap = 
-            playerRec->learningMaps.getElementDirect( m );
-        
-        if( checkMap->eveIDA == inEveIDA &&
-            checkMap->eveIDB == inEveIDB ) {
-            map = checkMap;
-            break;
-            }
+    if( inParentID != -1 ) {
+        // NULL if parent dead or parent never learned this language
+        parentMap = 
+            getPlayerLearningMap( inEveIDA, inEveIDB,
+                                  inParentID,
+                                  // dummy parent age
+                                  // don't allow creation of new parent
+                                  // map here
+                                  maxLanguageLearningAge + 1 );
         }
+    
 
-    if( map == NULL ) {
-        // no player map for this eve combo
-        if( inPlayerAge > maxLanguageLearningAge ) {
-            return NULL;
-            }
+    // add a blank one
+    LanguageLearningMap *map = new LanguageLearningMap;
+    initMapping( map, inEveIDA, inEveIDB, inPlayerID );
 
-        // copy from parent, if it exists
-        LanguageLearningMap *parentMap = NULL;
+    if( parentMap != NULL ) {
         
-        if( inParentID != -1 ) {
-            // NULL if parent dead or parent never learned this language
-            parentMap = 
-                getPlayerLearningMap( inEveIDA, inEveIDB,
-                                      inParentID,
-                                      // dummy parent age
-                                      // don't allow creation of new parent
-                                      // map here
-                                      maxLanguageLearningAge + 1 );
-            }
-        
-
-        // add a blank one
-        map = new LanguageLearningMap;
-        initMapping( map, inEveIDA, inEveIDB, inPlayerID );
-
-        if( parentMap != NULL ) {
-            
-            // copy parent's map            
-            for( int s=0; s<NUM_CLUSTER_SETS; s++ ) {    
-                memcpy( map->allMappings[s], parentMap->allMappings[s],
-                        allClusterSizes[s] );
-                }
+        // copy parent's map            
+        for( int s=0; s<NUM_CLUSTER_SETS; s++ ) {    
+            memcpy( map->allMappings[s], parentMap->allMappings[s],
+                    allClusterSizes[s] );
             }
-
-        playerRec->learningMaps.push_back( map );
         }
+
+    playerRec->learningMaps.push_back( map );
+    
+    insertLearningMapIndex( map );
     
     return map;
     }
@@ -784,9 +1065,9 @@ static LanguageLearningMap *getPlayerLearningMap( int inEveIDA, int inEveIDB,
 
 
 
-
 void initLanguage() {
     initMapping( &blankLearningMap, 0, 0, 0 );
+    blankLearningMap.version = 0;
 
     for( int i=0; i<NUM_CLUSTER_SETS; i++ ) {
         allClustersFreqTotals[ i ] = 0;
@@ -811,6 +1092,8 @@ static void freeEveLangRecord( EveLangRecord *inR ) {
 
 static void freePlayerLearningRecord( PlayerLearningRecord *inR ) {
     for( int m=0; m < inR->learningMaps.size(); m++ ) {
+        removeLearningMapIndex( inR->learningMaps.getElementDirect( m ) );
+
         inR->learningMaps.getElementDirect( m )->
             recentWords.deallocateStringElements();
         
@@ -827,6 +1110,12 @@ void removePlayerLanguageMaps( int inPlayerID ) {
         if( r->playerID == inPlayerID ) {
             freePlayerLearningRecord( r );
             learningRecords.deleteElement( p );
+
+            if( learningMapTableSize > MIN_LEARNING_MAP_TABLE_SIZE &&
+                learningMapTableCount * 8 < learningMapTableSize ) {
+                // most maps gone, shrink
+                rebuildLearningMapIndex( learningMapTableCount );
+                }
             return;
             }
         }
@@ -849,6 +1138,15 @@ void freeLanguage() {
         freePlayerLearningRecord( r );
         }
     learningRecords.deleteAll();
+
+    if( learningMapTable != NULL ) {
+        delete [] learningMapTable;
+        learningMapTable = NULL;
+        }
+    learningMapTableSize = 0;
+    learningMapTableCount = 0;
+    
+    setTranslationCacheSize( 0 );
     }
 
 
@@ -904,6 +1202,10 @@ int decrementLanguageCount( int inEveID ) {
             freeEveLangRecord( r );                        
             langRecords.deleteElement( rInd );
 
+            // cached translations to or from this language
+            // were made with maps that are going away
+            clearTranslationCache();
+
             // now walk through and remove other mappings
             for( int e=0; e<langRecords.size(); e++ ) {
                 EveLangRecord *rOther = langRecords.getElementDirect( e );
@@ -941,6 +1243,9 @@ void stepLanguage() {
     languageLearningBaseFraction = 
         SettingsManager::getFloatSetting( "languageLearningBaseFraction", 0.1 );
     
+    setTranslationCacheSize( 
+        SettingsManager::getIntSetting( "translationCacheSize", 4096 ) );
+    
     // see if there's one mapping that needs generating
     // spread the work out for generating mappings
     for( int e=0; e<langRecords.size(); e++ ) {
@@ -1098,15 +1403,47 @@ char *mapLanguagePhrase( char *inPhrase, int inEveIDA, int inEveIDB,
             }
         
         learnB->firstPhraseHeard = true;
+        learnB->version = nextLearningMapVersion++;
         }
 
 
     // temporarily replace map with a stripped one that lets more pass through
     // but don't do this if gradual learning over time is enabled
+    char passThrough = ( inFractionToPassThrough > 0 && 
+                         languageLearningRate == 0 );
+
+    double fractionToPassThrough = 0;
+    
+    if( passThrough ) {
+        fractionToPassThrough = inFractionToPassThrough;
+        }
+    
+
+    // if B can't learn, nothing below changes B's map or uses randSource,
+    // so the translation can come from the cache
+    char useCache = ( ! canLearnB && translationCacheSize > 0 );
+    
+    unsigned int versionA = learnA->version;
+    unsigned int versionB = learnB->version;
+    
+    unsigned int cacheHash = 0;
+    
+    if( useCache ) {
+        cacheHash = hashTranslationKey( inPhrase, inEveIDA, inEveIDB,
+                                        versionA, versionB );
+        
+        TranslationCacheEntry *e = getTranslationCacheSlot( cacheHash );
+        
+        if( entryMatches( e, cacheHash, inPhrase, inEveIDA, inEveIDB,
+                          versionA, versionB, fractionToPassThrough ) ) {
+            return stringDuplicate( e->translation );
+            }
+        }
+    
+
     char deleteMapA = false;
     
-    if( learnA != NULL && inFractionToPassThrough > 0 && 
-        languageLearningRate == 0 ) {
+    if( passThrough ) {
         
         LanguageLearningMap *tweakedMap = cloneMapping( learnA );
         
@@ -1225,6 +1562,25 @@ char *mapLanguagePhrase( char *inPhrase, int inEveIDA, int inEveIDB,
                     char *ucNew = stringToUpperCase( newPhrase );
                     delete [] newPhrase;
                     
+                    if( useCache ) {
+                        TranslationCacheEntry *e = 
+                            getTranslationCacheSlot( cacheHash );
+                        
+                        if( e->phrase != NULL ) {
+                            delete [] e->phrase;
+                            delete [] e->translation;
+                            }
+                        
+                        e->phrase = stringDuplicate( inPhrase );
+                        e->hash = cacheHash;
+                        e->eveIDA = inEveIDA;
+                        e->eveIDB = inEveIDB;
+                        e->versionA = versionA;
+                        e->versionB = versionB;
+                        e->fractionToPassThrough = fractionToPassThrough;
+                        e->translation = stringDuplicate( ucNew );
+                        }
+                    
                     if( deleteMapA ) {
                         delete learnA;
                         }
@@ -6,6 +6,7 @@
 #include "lineageLog.h"
 
 #include "curses.h"
+#include "logWriter.h"
 
 #include "../gameSource/objectBank.h"
 
@@ -19,8 +20,8 @@
 
 #include "minorGems/system/Time.h"
 
-static FILE *logFile;
-static FILE *nameLogFile;
+static LogWriterFile *logFile;
+static LogWriterFile *nameLogFile;
 
 static int currentYear;
 static int currentDay;
@@ -55,17 +56,21 @@ static void openCurrentLogFiles() {
     
     char *newFileName = newFile->getFullFileName();
     
-    logFile = fopen( newFileName, "a" );
+    // open here, so a failure is noticed and retried next step
+    // writes, flushes, and closes happen on log writer thread
+    FILE *file = fopen( newFileName, "a" );
 
     delete newFile;
     
-    if( logFile == NULL ) {
+    if( file == NULL ) {
         AppLog::errorF( "Failed to open log file %s", newFileName );
         delete [] newFileName;
 
         return;
         }
 
+    logFile = logWriterAdopt( file, newFileName );
+
     delete [] newFileName;
 
 
@@ -75,14 +80,16 @@ static void openCurrentLogFiles() {
     
     newFileName = newFile->getFullFileName();
     
-    nameLogFile = fopen( newFileName, "a" );
+    file = fopen( newFileName, "a" );
     
     delete newFile;
 
-    if( nameLogFile == NULL ) {
+    if( file == NULL ) {
         AppLog::errorF( "Failed to open log file %s", newFileName );
         }
     else {
+        nameLogFile = logWriterAdopt( file, newFileName );
+
         // only set these if BOTH opened successfully
         currentYear = timeStruct->tm_year;
         currentDay = timeStruct->tm_yday;
@@ -110,10 +117,10 @@ void initLifeLog() {
 
 void freeLifeLog() {
     if( logFile != NULL ) {
-        fclose( logFile );
+        logWriterClose( logFile );
         }
     if( nameLogFile != NULL ) {
-        fclose( nameLogFile );
+        logWriterClose( nameLogFile );
         }
     }
 
@@ -127,11 +134,11 @@ static void stepLog() {
         timeStruct->tm_yday != currentDay ) {
 
         if( logFile != NULL ) {
-            fclose( logFile );
+            logWriterClose( logFile );
             logFile = NULL;
             }
         if( nameLogFile != NULL ) {
-            fclose( nameLogFile );
+            logWriterClose( nameLogFile );
             nameLogFile = NULL;
             }
         
@@ -181,16 +188,15 @@ void logBirth( int inPlayerID, char *inPlayerEmail,
                 statusChar = 'D';
                 }
 
-            fprintf( logFile, 
-                     "B %.f %d %s %c (%d,%d) %s pop=%d chain=%d race=%c "
-                     "status=%c\n",
-                     Time::timeSec(),
-                     inPlayerID, inPlayerEmail, genderChar, inMapX, inMapY, 
-                     parentString,
-                     inTotalPopulation, inParentChainLength, raceChar,
-                     statusChar );
-            
-            fflush( logFile );
+            logWriterPrintf( 
+                logFile, 
+                "B %.f %d %s %c (%d,%d) %s pop=%d chain=%d race=%c "
+                "status=%c\n",
+                Time::timeSec(),
+                inPlayerID, inPlayerEmail, genderChar, inMapX, inMapY, 
+                parentString,
+                inTotalPopulation, inParentChainLength, raceChar,
+                statusChar );
 
             delete [] parentString;
             }
@@ -300,14 +306,14 @@ void logDeath( int inPlayerID, char *inPlayerEmail,
                 genderChar = 'M';
                 }
 
-            fprintf( logFile, "D %.0f %d %s age=%.2f %c (%d,%d) %s pop=%d\n",
-                     Time::timeSec(),
-                     inPlayerID, inPlayerEmail, 
-                     inAge, genderChar,
-                     inMapX, inMapY,
-                     causeString,
-                     inTotalRemainingPopulation );
-            fflush( logFile );
+            logWriterPrintf( logFile,
+                             "D %.0f %d %s age=%.2f %c (%d,%d) %s pop=%d\n",
+                             Time::timeSec(),
+                             inPlayerID, inPlayerEmail, 
+                             inAge, genderChar,
+                             inMapX, inMapY,
+                             causeString,
+                             inTotalRemainingPopulation );
             
             delete [] causeString;
             }
@@ -321,8 +327,7 @@ void logDeath( int inPlayerID, char *inPlayerEmail,
 void logName( int inPlayerID, char *inEmail, char *inName,
               int inLineageEveID ) {
     if( nameLogFile != NULL ) {
-        fprintf( nameLogFile, "%d %s\n", inPlayerID, inName );
-        fflush( nameLogFile );
+        logWriterPrintf( nameLogFile, "%d %s\n", inPlayerID, inName );
         }
     logPlayerNameForCurses( inEmail, inName, inLineageEveID );
     }
@@ -9,6 +9,10 @@
 #ifdef _WIN32
 #define fseeko fseeko64
 #define ftello ftello64
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#define LINEARDB3_MMAP_SUPPORTED
 #endif
 
 
@@ -32,6 +36,15 @@ void LINEARDB3_setMaxLoad( double inMaxLoad ) {
 
 
 
+static char useMmapForOpenCalls = false;
+
+
+void LINEARDB3_setUseMmap( char inUseMmap ) {
+    useMmapForOpenCalls = inUseMmap;
+    }
+
+
+
 
 #include "murmurhash2_64.cpp"
 
@@ -364,6 +377,121 @@ static int getRecordSizeBytes( int inKeySize, int inValueSize ) {
     }
 
 
+
+// smallest address space reservation for a mapped file
+// reserving well past the end of the file means that appends only
+// need a remap once in a long while
+#define LINEARDB3_MIN_MAP_RESERVE ( (uint64_t)64 * 1024 * 1024 )
+
+
+static void unmapFile( LINEARDB3 *inDB ) {
+    #ifdef LINEARDB3_MMAP_SUPPORTED
+    if( inDB->mapBase != NULL ) {
+        munmap( inDB->mapBase, inDB->mapSize );
+        }
+    #endif
+    inDB->mapBase = NULL;
+    inDB->mapSize = 0;
+    }
+
+
+
+// maps data file so that mapping covers at least inDB->fileSize bytes
+// any pending stdio writes must be flushed before calling
+//
+// returns 0 on success, -1 on failure
+// on failure, DB is left unmapped and falls back to stdio file access
+static int remapFile( LINEARDB3 *inDB ) {
+    unmapFile( inDB );
+    
+    // next stdio access must seek, no matter what ftello reports
+    inDB->lastOp = opWrite;
+
+    #ifdef LINEARDB3_MMAP_SUPPORTED
+    
+    uint64_t reserve = LINEARDB3_MIN_MAP_RESERVE;
+    
+    while( reserve < 2 * inDB->fileSize ) {
+        reserve *= 2;
+        }
+    
+    if( (uint64_t)(size_t)reserve != reserve ) {
+        // doesn't fit in address space
+        return -1;
+        }
+    
+    void *mapped = mmap( NULL, (size_t)reserve, 
+                         PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fileno( inDB->file ), 0 );
+    
+    if( mapped == MAP_FAILED ) {
+        printf( "lineardb3 failed to map %llu bytes of data file, "
+                "falling back to stdio access\n", 
+                (unsigned long long)reserve );
+        return -1;
+        }
+    
+    inDB->mapBase = (uint8_t*)mapped;
+    inDB->mapSize = reserve;
+    
+    return 0;
+    
+    #else
+    return -1;
+    #endif
+    }
+
+
+
+// appends a new key/value record to end of a mapped file
+// with a single write, remapping if it outgrows the mapping
+//
+// returns 0 on success, -1 on error
+static int appendMappedRecord( LINEARDB3 *inDB, uint64_t inFilePosRec,
+                               const void *inKey, const void *inValue ) {
+    #ifdef LINEARDB3_MMAP_SUPPORTED
+    
+    if( inFilePosRec != inDB->fileSize ) {
+        // make sure it matches where we've documented that
+        // the record should go
+        return -1;
+        }
+    
+    memcpy( inDB->recordBuffer, inKey, inDB->keySize );
+    memcpy( &( inDB->recordBuffer[ inDB->keySize ] ), 
+            inValue, inDB->valueSize );
+    
+    int fd = fileno( inDB->file );
+    
+    unsigned int numWritten = 0;
+    
+    while( numWritten < inDB->recordSizeBytes ) {
+        ssize_t result = pwrite( fd, 
+                                 &( inDB->recordBuffer[ numWritten ] ),
+                                 inDB->recordSizeBytes - numWritten,
+                                 (off_t)( inFilePosRec + numWritten ) );
+        if( result <= 0 ) {
+            return -1;
+            }
+        numWritten += result;
+        }
+    
+    inDB->fileSize += inDB->recordSizeBytes;
+
+    if( inDB->fileSize > inDB->mapSize ) {
+        // record already safely written, so a failed remap here
+        // just leaves us on stdio access
+        remapFile( inDB );
+        }
+    
+    return 0;
+    
+    #else
+    return -1;
+    #endif
+    }
+
+
 static void recomputeFingerprintMod( LINEARDB3 *inDB ) {
     inDB->fingerprintMod = inDB->hashTableSizeA;
     
@@ -422,6 +550,10 @@ int LINEARDB3_open(
     inDB->recordBuffer = NULL;
     inDB->maxOverflowDepth = 0;
 
+    inDB->mapBase = NULL;
+    inDB->mapSize = 0;
+    inDB->fileSize = 0;
+
     inDB->numRecords = 0;
     
     inDB->maxLoad = maxLoadForOpenCalls;
@@ -696,7 +828,17 @@ int LINEARDB3_open(
         }
     
 
-    
+    if( useMmapForOpenCalls ) {
+        if( fflush( inDB->file ) != 0 ||
+            fseeko( inDB->file, 0, SEEK_END ) ) {
+            return 1;
+            }
+        
+        inDB->fileSize = ftello( inDB->file );
+
+        // on failure, we just keep using stdio
+        remapFile( inDB );
+        }
 
 
     return 0;
@@ -706,6 +848,8 @@ int LINEARDB3_open(
 
 
 void LINEARDB3_close( LINEARDB3 *inDB ) {
+    unmapFile( inDB );
+
     if( inDB->recordBuffer != NULL ) {
         delete [] inDB->recordBuffer;
         inDB->recordBuffer = NULL;
@@ -1020,8 +1164,35 @@ static int LINEARDB3_considerFingerprintBucket( LINEARDB3 *inDB,
             
         uint64_t filePosRec = 
             LINEARDB3_HEADER_SIZE +
-            inBucket->fileIndex[ i ] * 
+            (uint64_t)inBucket->fileIndex[ i ] * 
             inDB->recordSizeBytes;
+        
+        if( inDB->mapBase != NULL ) {
+            // mapped file, no seeking or reading needed
+            
+            if( emptyRec ) {
+                // only get here on put
+                return appendMappedRecord( inDB, filePosRec,
+                                           inKey, inOutValue );
+                }
+            
+            uint8_t *mappedRec = &( inDB->mapBase[ filePosRec ] );
+            
+            if( ! keyComp( inDB->keySize, mappedRec, inKey ) ) {
+                // false match because of fingerprint collision
+                return 2;
+                }
+            
+            if( inPut ) {
+                memcpy( &( mappedRec[ inDB->keySize ] ), inOutValue,
+                        inDB->valueSize );
+                }
+            else {
+                memcpy( inOutValue, &( mappedRec[ inDB->keySize ] ),
+                        inDB->valueSize );
+                }
+            return 0;
+            }
             
         if( !emptyRec ) {
             
@@ -1227,9 +1398,14 @@ int LINEARDB3_getOrPut( LINEARDB3 *inDB, const void *inKey, void *inOutValue,
 
             uint64_t filePosRec = 
                 LINEARDB3_HEADER_SIZE +
-                newBucket->fileIndex[0] * 
+                (uint64_t)newBucket->fileIndex[0] * 
                 inDB->recordSizeBytes;
 
+            if( inDB->mapBase != NULL ) {
+                return appendMappedRecord( inDB, filePosRec, 
+                                           inKey, inOutValue );
+                }
+
             // don't seek unless we have to
             if( inDB->lastOp == opRead ||
                 ftello( inDB->file ) != (off_t)filePosRec ) {
@@ -1294,6 +1470,548 @@ int LINEARDB3_put( LINEARDB3 *inDB, const void *inKey, const void *inValue ) {
 
 
 
+// checks whether record at inFileIndex has key inKey
+// returns 1 if match, 0 if not, -1 on error
+static int recordKeyMatches( LINEARDB3 *inDB, uint32_t inFileIndex,
+                             const void *inKey ) {
+    uint64_t filePosRec = 
+        LINEARDB3_HEADER_SIZE +
+        (uint64_t)inFileIndex * inDB->recordSizeBytes;
+    
+    if( inDB->mapBase != NULL ) {
+        return keyComp( inDB->keySize, 
+                        &( inDB->mapBase[ filePosRec ] ), inKey );
+        }
+    
+    if( inDB->lastOp == opWrite || 
+        ftello( inDB->file ) != (off_t)filePosRec ) {
+        
+        if( fseeko( inDB->file, filePosRec, SEEK_SET ) ) {
+            return -1;
+            }
+        }
+    
+    int numRead = fread( inDB->recordBuffer, inDB->keySize, 1,
+                         inDB->file );
+    inDB->lastOp = opRead;
+    
+    if( numRead != 1 ) {
+        return -1;
+        }
+    
+    return keyComp( inDB->keySize, inDB->recordBuffer, inKey );
+    }
+
+
+
+// finds where in the data file an existing record lives, given the bin
+// and fingerprint already computed for inKey
+// returns 0 if found, 1 if not found, -1 on error
+static int findRecordIndex( LINEARDB3 *inDB, const void *inKey,
+                            uint64_t inBinNumber, uint32_t inFingerprint,
+                            uint32_t *outFileIndex ) {
+    
+    FingerprintBucket *thisBucket = getBucket( inDB->hashTable, inBinNumber );
+    
+    while( true ) {
+        for( int i=0; i<RECORDS_PER_BUCKET; i++ ) {
+            uint32_t binFP = thisBucket->fingerprints[ i ];
+            
+            if( binFP == 0 ) {
+                // first empty spot, remaining records empty too
+                return 1;
+                }
+            
+            if( binFP == inFingerprint ) {
+                int match = recordKeyMatches( inDB, 
+                                              thisBucket->fileIndex[ i ],
+                                              inKey );
+                if( match == -1 ) {
+                    return -1;
+                    }
+                if( match ) {
+                    *outFileIndex = thisBucket->fileIndex[ i ];
+                    return 0;
+                    }
+                // else fingerprint collision, keep going
+                }
+            }
+        
+        if( thisBucket->overflowIndex == 0 ) {
+            return 1;
+            }
+        
+        thisBucket = getBucket( inDB->overflowBuckets, 
+                                thisBucket->overflowIndex );
+        }
+    }
+
+
+
+// appends a record known to be absent to the end of inBinNumber's chain
+// and to the end of the data file
+//
+// table is not expanded here, caller must do that afterward
+//
+// returns 0 on success, -1 on error
+static int insertFreshRecord( LINEARDB3 *inDB, const void *inKey,
+                              const void *inValue,
+                              uint64_t inBinNumber, uint32_t inFingerprint ) {
+    
+    FingerprintBucket *thisBucket = getBucket( inDB->hashTable, inBinNumber );
+    
+    unsigned int overflowDepth = 0;
+    
+    int slot = -1;
+    
+    while( slot == -1 ) {
+        for( int i=0; i<RECORDS_PER_BUCKET; i++ ) {
+            if( thisBucket->fingerprints[ i ] == 0 ) {
+                slot = i;
+                break;
+                }
+            }
+        
+        if( slot != -1 ) {
+            break;
+            }
+        
+        overflowDepth++;
+        
+        if( overflowDepth > inDB->maxOverflowDepth ) {
+            inDB->maxOverflowDepth = overflowDepth;
+            }
+        
+        if( thisBucket->overflowIndex == 0 ) {
+            // end of chain is full, start a new overflow bucket
+            thisBucket->overflowIndex = 
+                getFirstEmptyBucketIndex( inDB->overflowBuckets );
+            slot = 0;
+            }
+        
+        thisBucket = getBucket( inDB->overflowBuckets, 
+                                thisBucket->overflowIndex );
+        }
+    
+    thisBucket->fingerprints[ slot ] = inFingerprint;
+    
+    // will go at end of file
+    thisBucket->fileIndex[ slot ] = inDB->numRecords;
+    
+    inDB->numRecords++;
+    
+    
+    uint64_t filePosRec = 
+        LINEARDB3_HEADER_SIZE +
+        (uint64_t)thisBucket->fileIndex[ slot ] * inDB->recordSizeBytes;
+    
+    if( inDB->mapBase != NULL ) {
+        return appendMappedRecord( inDB, filePosRec, inKey, inValue );
+        }
+    
+    // don't seek unless we have to
+    // a series of fresh inserts leaves us waiting at end of file
+    if( inDB->lastOp == opRead ||
+        ftello( inDB->file ) != (off_t)filePosRec ) {
+        
+        if( fseeko( inDB->file, 0, SEEK_END ) ) {
+            return -1;
+            }
+        
+        // make sure it matches where we've documented that
+        // the record should go
+        if( ftello( inDB->file ) != (off_t)filePosRec ) {
+            return -1;
+            }
+        }
+    
+    int numWritten = fwrite( inKey, inDB->keySize, 1, inDB->file );
+    inDB->lastOp = opWrite;
+    
+    numWritten += fwrite( inValue, inDB->valueSize, 1, inDB->file );
+    
+    if( numWritten != 2 ) {
+        return -1;
+        }
+    return 0;
+    }
+
+
+
+typedef struct {
+        uint32_t fileIndex;
+        unsigned int batchIndex;
+    } PlacedBatchRecord;
+
+
+static int placedBatchRecordCompare( const void *inA, const void *inB ) {
+    uint32_t a = ( (const PlacedBatchRecord*)inA )->fileIndex;
+    uint32_t b = ( (const PlacedBatchRecord*)inB )->fileIndex;
+    
+    if( a < b ) {
+        return -1;
+        }
+    if( a > b ) {
+        return 1;
+        }
+    return 0;
+    }
+
+
+typedef struct {
+        uint64_t binNumber;
+        uint32_t fingerprint;
+        unsigned int batchIndex;
+    } BinnedBatchRecord;
+
+
+// bin order, with batch order within a bin
+static int binnedBatchRecordCompare( const void *inA, const void *inB ) {
+    const BinnedBatchRecord *a = (const BinnedBatchRecord*)inA;
+    const BinnedBatchRecord *b = (const BinnedBatchRecord*)inB;
+    
+    if( a->binNumber < b->binNumber ) {
+        return -1;
+        }
+    if( a->binNumber > b->binNumber ) {
+        return 1;
+        }
+    if( a->batchIndex < b->batchIndex ) {
+        return -1;
+        }
+    if( a->batchIndex > b->batchIndex ) {
+        return 1;
+        }
+    return 0;
+    }
+
+
+
+int LINEARDB3_putMany( LINEARDB3 *inDB, unsigned int inNumRecords,
+                       const void *inKeys, const void *inValues ) {
+    
+    const uint8_t *keys = (const uint8_t*)inKeys;
+    const uint8_t *values = (const uint8_t*)inValues;
+    
+    // hash each key once, then walk the table in bin order
+    BinnedBatchRecord *binned = new BinnedBatchRecord[ inNumRecords ];
+    
+    for( unsigned int i=0; i<inNumRecords; i++ ) {
+        binned[i].binNumber = 
+            getBinNumber( inDB, &( keys[ i * inDB->keySize ] ),
+                          &( binned[i].fingerprint ) );
+        binned[i].batchIndex = i;
+        }
+    
+    qsort( binned, inNumRecords, sizeof( BinnedBatchRecord ),
+           binnedBatchRecordCompare );
+    
+
+    PlacedBatchRecord *existing = new PlacedBatchRecord[ inNumRecords ];
+    unsigned int numExisting = 0;
+
+    // indices into binned, still in bin order
+    unsigned int *fresh = new unsigned int[ inNumRecords ];
+    unsigned int numFresh = 0;
+    
+    int returnVal = 0;
+    
+
+    // first pass, find where existing records live
+    for( unsigned int i=0; i<inNumRecords; i++ ) {
+        BinnedBatchRecord *r = &( binned[i] );
+        
+        uint32_t fileIndex;
+        
+        int result = findRecordIndex( inDB, 
+                                      &( keys[ r->batchIndex * 
+                                               inDB->keySize ] ),
+                                      r->binNumber, r->fingerprint,
+                                      &fileIndex );
+        if( result == -1 ) {
+            returnVal = -1;
+            break;
+            }
+        else if( result == 0 ) {
+            existing[ numExisting ].fileIndex = fileIndex;
+            existing[ numExisting ].batchIndex = r->batchIndex;
+            numExisting++;
+            }
+        else {
+            fresh[ numFresh ] = i;
+            numFresh++;
+            }
+        }
+
+    
+    if( returnVal == 0 ) {
+        // overwrite existing values in one forward sweep through file
+        qsort( existing, numExisting, sizeof( PlacedBatchRecord ),
+               placedBatchRecordCompare );
+        
+        for( unsigned int i=0; i<numExisting; i++ ) {
+            uint64_t filePosValue = 
+                LINEARDB3_HEADER_SIZE +
+                (uint64_t)existing[i].fileIndex * inDB->recordSizeBytes +
+                inDB->keySize;
+
+            const uint8_t *value = 
+                &( values[ existing[i].batchIndex * inDB->valueSize ] );
+            
+            if( inDB->mapBase != NULL ) {
+                memcpy( &( inDB->mapBase[ filePosValue ] ), value,
+                        inDB->valueSize );
+                continue;
+                }
+            
+            // don't seek unless we have to
+            if( inDB->lastOp == opRead || 
+                ftello( inDB->file ) != (off_t)filePosValue ) {
+                
+                if( fseeko( inDB->file, filePosValue, SEEK_SET ) ) {
+                    returnVal = -1;
+                    break;
+                    }
+                }
+            
+            int numWritten = fwrite( value, inDB->valueSize, 1, 
+                                     inDB->file );
+            inDB->lastOp = opWrite;
+            
+            if( numWritten != 1 ) {
+                returnVal = -1;
+                break;
+                }
+            }
+        }
+    
+
+    if( returnVal == 0 ) {
+        // then append new ones at end of file, straight into the bins
+        // found above
+        // bins stay valid because the table isn't expanded until after
+        for( unsigned int i=0; i<numFresh; i++ ) {
+            BinnedBatchRecord *r = &( binned[ fresh[i] ] );
+            
+            if( insertFreshRecord( 
+                    inDB, 
+                    &( keys[ r->batchIndex * inDB->keySize ] ),
+                    &( values[ r->batchIndex * inDB->valueSize ] ),
+                    r->binNumber, r->fingerprint ) == -1 ) {
+                returnVal = -1;
+                break;
+                }
+            }
+        }
+    
+    if( numFresh > 0 &&
+        inDB->numRecords > 
+        ( inDB->hashTableSizeB * RECORDS_PER_BUCKET ) * inDB->maxLoad ) {
+        
+        if( expandTable( inDB ) == -1 ) {
+            returnVal = -1;
+            }
+        }
+    
+    delete [] binned;
+    delete [] existing;
+    delete [] fresh;
+    
+    return returnVal;
+    }
+
+
+
+// candidate records closer together than this in the file are fetched
+// with one read, reading through the records in between
+#define GET_MANY_MAX_GAP_BYTES 4096
+
+// largest single read
+#define GET_MANY_MAX_SPAN_BYTES 65536
+
+
+int LINEARDB3_getMany( LINEARDB3 *inDB, unsigned int inNumRecords,
+                       const void *inKeys, void *outValues,
+                       char *outResults ) {
+
+    const uint8_t *keys = (const uint8_t*)inKeys;
+    uint8_t *values = (uint8_t*)outValues;
+
+    for( unsigned int i=0; i<inNumRecords; i++ ) {
+        outResults[i] = 1;
+        }
+
+    if( inNumRecords == 0 ) {
+        return 0;
+        }
+
+
+    // first pass, table only, gather every record whose fingerprint
+    // matches one of our keys
+    // usually one per key, more on fingerprint collisions
+    unsigned int maxCandidates = inNumRecords;
+    unsigned int numCandidates = 0;
+    PlacedBatchRecord *candidates = new PlacedBatchRecord[ maxCandidates ];
+
+    for( unsigned int i=0; i<inNumRecords; i++ ) {
+        uint32_t fingerprint;
+
+        uint64_t binNumber =
+            getBinNumber( inDB, &( keys[ i * inDB->keySize ] ),
+                          &fingerprint );
+
+        FingerprintBucket *thisBucket =
+            getBucket( inDB->hashTable, binNumber );
+
+        char done = false;
+
+        while( ! done ) {
+            for( int b=0; b<RECORDS_PER_BUCKET; b++ ) {
+                uint32_t binFP = thisBucket->fingerprints[ b ];
+
+                if( binFP == 0 ) {
+                    // first empty spot, remaining records empty too
+                    done = true;
+                    break;
+                    }
+
+                if( binFP == fingerprint ) {
+                    if( numCandidates == maxCandidates ) {
+                        maxCandidates *= 2;
+                        PlacedBatchRecord *bigger =
+                            new PlacedBatchRecord[ maxCandidates ];
+                        memcpy( bigger, candidates,
+                                numCandidates * sizeof( PlacedBatchRecord ) );
+                        delete [] candidates;
+                        candidates = bigger;
+                        }
+                    candidates[ numCandidates ].fileIndex =
+                        thisBucket->fileIndex[ b ];
+                    candidates[ numCandidates ].batchIndex = i;
+                    numCandidates++;
+                    }
+                }
+
+            if( done || thisBucket->overflowIndex == 0 ) {
+                break;
+                }
+
+            thisBucket = getBucket( inDB->overflowBuckets,
+                                    thisBucket->overflowIndex );
+            }
+        }
+
+
+    qsort( candidates, numCandidates, sizeof( PlacedBatchRecord ),
+           placedBatchRecordCompare );
+
+
+    // second pass, read candidates in spans in one forward sweep
+    int returnVal = 0;
+
+    uint8_t *spanBuffer = NULL;
+
+    unsigned int spanStart = 0;
+
+    while( spanStart < numCandidates ) {
+
+        uint64_t spanStartPos =
+            LINEARDB3_HEADER_SIZE +
+            (uint64_t)candidates[ spanStart ].fileIndex *
+            inDB->recordSizeBytes;
+
+        uint64_t spanEndPos = spanStartPos + inDB->recordSizeBytes;
+
+        unsigned int spanEnd = spanStart + 1;
+
+        while( spanEnd < numCandidates ) {
+            uint64_t nextPos =
+                LINEARDB3_HEADER_SIZE +
+                (uint64_t)candidates[ spanEnd ].fileIndex *
+                inDB->recordSizeBytes;
+
+            uint64_t nextEndPos = nextPos + inDB->recordSizeBytes;
+
+            if( nextPos - spanEndPos > GET_MANY_MAX_GAP_BYTES ||
+                nextEndPos - spanStartPos > GET_MANY_MAX_SPAN_BYTES ) {
+                break;
+                }
+            // same record can show up twice if two keys share a
+            // fingerprint, spanEndPos stays put then
+            spanEndPos = nextEndPos;
+            spanEnd++;
+            }
+
+        const uint8_t *spanData;
+
+        if( inDB->mapBase != NULL ) {
+            spanData = &( inDB->mapBase[ spanStartPos ] );
+            }
+        else {
+            if( spanBuffer == NULL ) {
+                // spans can run one record past the limit when records
+                // are bigger than it
+                spanBuffer =
+                    new uint8_t[ GET_MANY_MAX_SPAN_BYTES +
+                                 inDB->recordSizeBytes ];
+                }
+
+            // never seek unless we have to
+            if( inDB->lastOp == opWrite ||
+                ftello( inDB->file ) != (off_t)spanStartPos ) {
+
+                if( fseeko( inDB->file, spanStartPos, SEEK_SET ) ) {
+                    returnVal = -1;
+                    break;
+                    }
+                }
+
+            int numRead = fread( spanBuffer, spanEndPos - spanStartPos, 1,
+                                 inDB->file );
+            inDB->lastOp = opRead;
+
+            if( numRead != 1 ) {
+                returnVal = -1;
+                break;
+                }
+            spanData = spanBuffer;
+            }
+
+        for( unsigned int c=spanStart; c<spanEnd; c++ ) {
+            unsigned int b = candidates[c].batchIndex;
+
+            if( outResults[b] == 0 ) {
+                // already found, this one was a fingerprint collision
+                continue;
+                }
+
+            const uint8_t *rec =
+                &( spanData[ LINEARDB3_HEADER_SIZE +
+                             (uint64_t)candidates[c].fileIndex *
+                             inDB->recordSizeBytes -
+                             spanStartPos ] );
+
+            if( keyComp( inDB->keySize, rec,
+                         &( keys[ b * inDB->keySize ] ) ) ) {
+                memcpy( &( values[ b * inDB->valueSize ] ),
+                        &( rec[ inDB->keySize ] ), inDB->valueSize );
+                outResults[b] = 0;
+                }
+            }
+
+        spanStart = spanEnd;
+        }
+
+    if( spanBuffer != NULL ) {
+        delete [] spanBuffer;
+        }
+    delete [] candidates;
+
+    return returnVal;
+    }
+
+
+
 void LINEARDB3_Iterator_init( LINEARDB3 *inDB, LINEARDB3_Iterator *inDBi ) {
     inDBi->db = inDB;
     inDBi->nextRecordIndex = 0;
@@ -1322,7 +2040,17 @@ int LINEARDB3_Iterator_next( LINEARDB3_Iterator *inDBi,
         
         uint64_t fileRecPos = 
             LINEARDB3_HEADER_SIZE + 
-            inDBi->nextRecordIndex * db->recordSizeBytes;
+            (uint64_t)inDBi->nextRecordIndex * db->recordSizeBytes;
+        
+        if( db->mapBase != NULL ) {
+            uint8_t *mappedRec = &( db->mapBase[ fileRecPos ] );
+            
+            memcpy( outKey, mappedRec, db->keySize );
+            memcpy( outValue, &( mappedRec[ db->keySize ] ), db->valueSize );
+            
+            inDBi->nextRecordIndex++;
+            return 1;
+            }
         
                     
         if( db->lastOp == opWrite ||
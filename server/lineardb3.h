@@ -1,3 +1,7 @@
+#ifndef LINEARDB3_H_INCLUDED
+#define LINEARDB3_H_INCLUDED
+
+
 
 
 // some compilers require this to access UINT64_MAX
@@ -104,7 +108,19 @@ typedef struct {
         LINEARDB3_PageManager *hashTable;
 
         LINEARDB3_PageManager *overflowBuckets;
-        
+
+
+        // non-NULL if file is memory-mapped (see LINEARDB3_setUseMmap)
+        // in that case, records are read and overwritten directly in
+        // mapped memory, and new records are appended with a single write
+        uint8_t *mapBase;
+
+        // bytes of address space reserved for mapping, can extend past
+        // end of file so that appends rarely need a remap
+        uint64_t mapSize;
+
+        // current size of data file on disk, in bytes
+        uint64_t fileSize;
 
     } LINEARDB3;
 
@@ -139,6 +155,26 @@ void LINEARDB3_setMaxLoad( double inMaxLoad );
 
 
 
+/**
+ * Set whether subsequent calls to LINEARDB3_open memory-map the data file.
+ *
+ * Defaults to false.
+ *
+ * When on, gets are served directly from mapped memory with no seek or
+ * read syscalls, and puts that overwrite existing records are plain
+ * memory writes.  The file format is unchanged, and mapped and unmapped
+ * opens of the same file are interchangeable.
+ *
+ * If mapping fails (or on platforms without mmap), the DB silently falls
+ * back to stdio file access.
+ *
+ * Like maxLoad, a given DB remembers the setting that was in effect when it
+ * was opened.
+ */
+void LINEARDB3_setUseMmap( char inUseMmap );
+
+
+
 
 /**
  * Open database
@@ -191,6 +227,29 @@ int LINEARDB3_get( LINEARDB3 *inDB, const void *inKey, void *outValue );
 
 
 
+/**
+ * Get a batch of entries
+ *
+ * All keys are located in the in-RAM hash table first, and then the
+ * candidate records are read in file order, with records that lie close
+ * together in the file fetched by a single read.  Results are the same
+ * as calling LINEARDB3_get on each key in turn, but random reads become
+ * a forward sweep through the file.
+ *
+ * @param db Database struct
+ * @param inNumRecords number of entries in batch
+ * @param inKeys packed keys (inNumRecords * key_size bytes)
+ * @param outValues packed value buffer (inNumRecords * value_size bytes
+ *   capacity), filled in batch order.  Values of not-found keys untouched.
+ * @param outResults one result per key, 0 if found, 1 if not found
+ * @return -1 on I/O error, 0 on success
+ */
+int LINEARDB3_getMany( LINEARDB3 *inDB, unsigned int inNumRecords,
+                       const void *inKeys, void *outValues,
+                       char *outResults );
+
+
+
 /**
  * Put an entry (overwriting it if it already exists)
  *
@@ -206,6 +265,27 @@ int LINEARDB3_put( LINEARDB3 *inDB, const void *inKey, const void *inValue );
 
 
 
+/**
+ * Put a batch of entries (overwriting any that already exist)
+ *
+ * Keys are hashed once and looked up in bucket order.  Existing records
+ * are then overwritten in file order, and new records are appended
+ * afterward, in bucket order, with the table expanded once at the end.
+ * The resulting contents are the same as calling LINEARDB3_put on each
+ * entry in turn, as long as keys in the batch are unique, but random
+ * writes become a forward sweep through the file.
+ *
+ * @param db Database struct
+ * @param inNumRecords number of entries in batch
+ * @param inKeys packed keys (inNumRecords * key_size bytes)
+ * @param inValues packed values (inNumRecords * value_size bytes)
+ * @return -1 on I/O error, 0 on success
+ */
+int LINEARDB3_putMany( LINEARDB3 *inDB, unsigned int inNumRecords,
+                       const void *inKeys, const void *inValues );
+
+
+
 /**
  * Cursor used for iterating over all entries in database
  */
@@ -293,3 +373,6 @@ uint32_t LINEARDB3_getPerfectTableSize( double inMaxLoad,
  */
 unsigned int LINEARDB3_getShrinkSize( LINEARDB3 *inDB,
                                       unsigned int inNewNumRecords );
+
+
+#endif
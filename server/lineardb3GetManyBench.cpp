@@ -0,0 +1,158 @@
+// reads chunk-shaped blocks of map keys from a LINEARDB3 with one
+// LINEARDB3_get per key, and with LINEARDB3_getMany, checks that both give
+// the same answers, and times each, with and without mmap
+//
+// usage:  lineardb3GetManyBench [numRecords]
+//
+// records are inserted in random order, the way map changes pile up in
+// map.db, so cells that are next to each other on the map are scattered
+// through the file
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lineardb3.h"
+#include "dbCommon.h"
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/random/JenkinsRandomSource.h"
+
+
+
+#define MAP_D 1000
+
+// like a 32x30 chunk, with 4 slots read per cell
+#define CHUNK_W 32
+#define CHUNK_H 30
+#define SLOTS 4
+
+#define NUM_CHUNKS 500
+
+static const char *dbName = "getManyBench_ldb3.db";
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numRecords = 1000000;
+
+    if( inNumArgs > 1 ) {
+        sscanf( inArgs[1], "%d", &numRecords );
+        }
+
+    int numKeys = CHUNK_W * CHUNK_H * SLOTS;
+
+    unsigned char *keys = new unsigned char[ numKeys * 16 ];
+    int *singleValues = new int[ numKeys ];
+    char *singleResults = new char[ numKeys ];
+    int *manyValues = new int[ numKeys ];
+    char *manyResults = new char[ numKeys ];
+
+    int numFailed = 0;
+
+    for( int useMmap=0; useMmap<2; useMmap++ ) {
+        LINEARDB3_setUseMmap( useMmap );
+
+        remove( dbName );
+
+        LINEARDB3 db;
+
+        if( LINEARDB3_open( &db, dbName, 0, 80000, 16, 4 ) != 0 ) {
+            printf( "Error creating DB.\n" );
+            return 1;
+            }
+
+        JenkinsRandomSource randSource( 4471 );
+
+        for( int i=0; i<numRecords; i++ ) {
+            unsigned char key[16];
+            intQuadToKey( randSource.getRandomBoundedInt( 0, MAP_D - 1 ),
+                          randSource.getRandomBoundedInt( 0, MAP_D - 1 ),
+                          randSource.getRandomBoundedInt( 0, SLOTS - 1 ),
+                          0, key );
+            int value = i;
+            LINEARDB3_put( &db, key, &value );
+            }
+
+
+        double singleSeconds = 0;
+        double manySeconds = 0;
+        int numFound = 0;
+        int numDiffering = 0;
+
+        for( int c=0; c<NUM_CHUNKS; c++ ) {
+            int x0 = randSource.getRandomBoundedInt( 0, MAP_D - CHUNK_W );
+            int y0 = randSource.getRandomBoundedInt( 0, MAP_D - CHUNK_H );
+
+            int k = 0;
+            for( int y=0; y<CHUNK_H; y++ ) {
+                for( int x=0; x<CHUNK_W; x++ ) {
+                    for( int s=0; s<SLOTS; s++ ) {
+                        intQuadToKey( x0 + x, y0 + y, s, 0,
+                                      &( keys[ k * 16 ] ) );
+                        k++;
+                        }
+                    }
+                }
+
+            double startTime = Time::getCurrentTime();
+
+            for( int i=0; i<numKeys; i++ ) {
+                singleResults[i] =
+                    LINEARDB3_get( &db, &( keys[ i * 16 ] ),
+                                   &( singleValues[i] ) );
+                }
+
+            singleSeconds += Time::getCurrentTime() - startTime;
+
+
+            startTime = Time::getCurrentTime();
+
+            if( LINEARDB3_getMany( &db, numKeys, keys,
+                                   manyValues, manyResults ) != 0 ) {
+                printf( "getMany failed\n" );
+                return 1;
+                }
+
+            manySeconds += Time::getCurrentTime() - startTime;
+
+
+            for( int i=0; i<numKeys; i++ ) {
+                if( singleResults[i] != manyResults[i] ||
+                    ( singleResults[i] == 0 &&
+                      singleValues[i] != manyValues[i] ) ) {
+                    numDiffering++;
+                    }
+                if( singleResults[i] == 0 ) {
+                    numFound++;
+                    }
+                }
+            }
+
+        LINEARDB3_close( &db );
+
+        printf( "%s:  %d keys read, %d found\n",
+                useMmap ? "mmap" : "stdio", NUM_CHUNKS * numKeys, numFound );
+        printf( "    get:      %7.3f sec\n", singleSeconds );
+        printf( "    getMany:  %7.3f sec  (%.1fx)\n",
+                manySeconds, singleSeconds / manySeconds );
+
+        if( numDiffering > 0 ) {
+            printf( "FAILED:  %d results differ\n", numDiffering );
+            numFailed++;
+            }
+        }
+
+    remove( dbName );
+
+    delete [] keys;
+    delete [] singleValues;
+    delete [] singleResults;
+    delete [] manyValues;
+    delete [] manyResults;
+
+    if( numFailed > 0 ) {
+        return 1;
+        }
+    return 0;
+    }
@@ -0,0 +1,1509 @@
+#include "logArchive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "minorGems/io/file/File.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+
+
+
+static const char *indexFileName = "index.txt";
+
+static const char *partitionMagic = "LAR1";
+
+
+
+typedef struct ColumnSpec {
+        char isString;
+        int scale;
+    } ColumnSpec;
+
+
+static ColumnSpec lifeColumns[ LIFE_NUM_COLUMNS ] = {
+    { false, 1 },    // time
+    { false, 1 },    // event
+    { false, 1 },    // id
+    { true, 1 },     // email
+    { false, 1 },    // gender
+    { false, 1 },    // x
+    { false, 1 },    // y
+    { false, 1 },    // parent id
+    { true, 1 },     // parent email
+    { false, 100 },  // age
+    { true, 1 },     // cause
+    { false, 1 },    // pop
+    { false, 1 },    // chain
+    { false, 1 },    // race
+    { false, 1 } };  // status
+
+
+static ColumnSpec foodColumns[ FOOD_NUM_COLUMNS ] = {
+    { false, 1 },        // time
+    { false, 1 },        // hour
+    { false, 1 },        // id
+    { false, 1 },        // count
+    { false, 1 },        // value
+    { false, 1000000 },  // av age
+    { false, 1 },        // av x
+    { false, 1 } };      // av y
+
+
+static ColumnSpec curseColumns[ CURSE_NUM_COLUMNS ] = {
+    { false, 1 },    // time
+    { false, 1 },    // event
+    { false, 1 },    // id
+    { true, 1 },     // email
+    { true, 1 },     // target email
+    { false, 1 } };  // score
+
+
+static ColumnSpec *tableColumns[ LOG_ARCHIVE_NUM_TABLES ] = {
+    lifeColumns, foodColumns, curseColumns };
+
+static int tableNumColumns[ LOG_ARCHIVE_NUM_TABLES ] = {
+    LIFE_NUM_COLUMNS, FOOD_NUM_COLUMNS, CURSE_NUM_COLUMNS };
+
+// log folders that start with this name
+static const char *tableFolderPrefix[ LOG_ARCHIVE_NUM_TABLES ] = {
+    "lifeLog", "foodLog", "curseLog" };
+
+
+
+
+// varints, 7 bits at a time, low bits first
+
+static void writeVarint( SimpleVector<unsigned char> *inBytes,
+                         uint64_t inV ) {
+    while( inV >= 0x80 ) {
+        inBytes->push_back( (unsigned char)( ( inV & 0x7F ) | 0x80 ) );
+        inV >>= 7;
+        }
+    inBytes->push_back( (unsigned char)inV );
+    }
+
+
+// small negative numbers to small positive numbers
+static uint64_t zigZag( int64_t inV ) {
+    return ( (uint64_t)inV << 1 ) ^ (uint64_t)( inV >> 63 );
+    }
+
+
+static int64_t unZigZag( uint64_t inV ) {
+    return (int64_t)( inV >> 1 ) ^ -(int64_t)( inV & 1 );
+    }
+
+
+// returns false if ran off end
+static char readVarint( unsigned char **ioPos, unsigned char *inEnd,
+                        uint64_t *outV ) {
+    uint64_t v = 0;
+    int shift = 0;
+
+    while( *ioPos < inEnd && shift < 64 ) {
+        unsigned char b = **ioPos;
+        ( *ioPos )++;
+
+        v |= (uint64_t)( b & 0x7F ) << shift;
+
+        if( ( b & 0x80 ) == 0 ) {
+            *outV = v;
+            return true;
+            }
+        shift += 7;
+        }
+    return false;
+    }
+
+
+
+
+// strings in one column of partition being built, each stored once
+typedef struct StringDictionary {
+        SimpleVector<char*> strings;
+
+        // index into strings + 1, or 0 for empty slot
+        int *slots;
+        int numSlots;
+    } StringDictionary;
+
+
+static unsigned int hashString( const char *inString ) {
+    // djb2
+    unsigned int hash = 5381;
+
+    for( const unsigned char *c = (const unsigned char*)inString;
+         *c != '\0'; c++ ) {
+        hash = hash * 33 + *c;
+        }
+    return hash;
+    }
+
+
+static void insertSlot( StringDictionary *inDict, int inIndex ) {
+    unsigned int mask = (unsigned int)( inDict->numSlots - 1 );
+
+    unsigned int s =
+        hashString( inDict->strings.getElementDirect( inIndex ) ) & mask;
+
+    while( inDict->slots[s] != 0 ) {
+        s = ( s + 1 ) & mask;
+        }
+    inDict->slots[s] = inIndex + 1;
+    }
+
+
+static int getStringIndex( StringDictionary *inDict, const char *inString ) {
+    unsigned int mask = (unsigned int)( inDict->numSlots - 1 );
+
+    unsigned int s = hashString( inString ) & mask;
+
+    while( inDict->slots[s] != 0 ) {
+        int index = inDict->slots[s] - 1;
+
+        if( strcmp( inDict->strings.getElementDirect( index ),
+                    inString ) == 0 ) {
+            return index;
+            }
+        s = ( s + 1 ) & mask;
+        }
+
+    // new string
+    inDict->strings.push_back( stringDuplicate( inString ) );
+
+    int index = inDict->strings.size() - 1;
+
+    if( inDict->strings.size() > inDict->numSlots / 2 ) {
+        delete [] inDict->slots;
+
+        inDict->numSlots *= 2;
+        inDict->slots = new int[ inDict->numSlots ];
+        memset( inDict->slots, 0, inDict->numSlots * sizeof( int ) );
+
+        for( int i=0; i<inDict->strings.size(); i++ ) {
+            insertSlot( inDict, i );
+            }
+        }
+    else {
+        insertSlot( inDict, index );
+        }
+
+    return index;
+    }
+
+
+
+
+typedef struct PartitionBuilder {
+        LogArchiveTable table;
+        int numColumns;
+
+        int numRows;
+
+        // one per column
+        // scaled numbers or dictionary indices
+        SimpleVector<int64_t> *values;
+        StringDictionary *dictionaries;
+    } PartitionBuilder;
+
+
+static void initBuilder( PartitionBuilder *outB, LogArchiveTable inTable ) {
+    outB->table = inTable;
+    outB->numColumns = tableNumColumns[ inTable ];
+    outB->numRows = 0;
+    outB->values = new SimpleVector<int64_t>[ outB->numColumns ];
+    outB->dictionaries = new StringDictionary[ outB->numColumns ];
+
+    for( int c=0; c<outB->numColumns; c++ ) {
+        outB->dictionaries[c].numSlots = 64;
+        outB->dictionaries[c].slots = new int[ 64 ];
+        memset( outB->dictionaries[c].slots, 0, 64 * sizeof( int ) );
+        }
+    }
+
+
+static void freeBuilder( PartitionBuilder *inB ) {
+    for( int c=0; c<inB->numColumns; c++ ) {
+        inB->dictionaries[c].strings.deallocateStringElements();
+        delete [] inB->dictionaries[c].slots;
+        }
+    delete [] inB->values;
+    delete [] inB->dictionaries;
+    }
+
+
+
+// one row being parsed
+// string columns point into buffers here, or at string constants
+typedef struct RowValues {
+        double numbers[ LIFE_NUM_COLUMNS ];
+        const char *strings[ LIFE_NUM_COLUMNS ];
+
+        char bufferA[1000];
+        char bufferB[1000];
+        char bufferC[1000];
+    } RowValues;
+
+
+static void clearRow( RowValues *outRow ) {
+    for( int c=0; c<LIFE_NUM_COLUMNS; c++ ) {
+        outRow->numbers[c] = 0;
+        outRow->strings[c] = "";
+        }
+    }
+
+
+static void addRow( PartitionBuilder *inB, RowValues *inRow ) {
+    ColumnSpec *spec = tableColumns[ inB->table ];
+
+    for( int c=0; c<inB->numColumns; c++ ) {
+        int64_t v;
+
+        if( spec[c].isString ) {
+            v = getStringIndex( &( inB->dictionaries[c] ),
+                                inRow->strings[c] );
+            }
+        else {
+            v = (int64_t)llround( inRow->numbers[c] * spec[c].scale );
+            }
+        inB->values[c].push_back( v );
+        }
+    inB->numRows++;
+    }
+
+
+
+
+// parsers for each log's lines
+// return false if line isn't one that goes in the archive
+
+static char parseLifeLine( char *inLine, RowValues *outRow ) {
+    char *email = outRow->bufferA;
+    char *parent = outRow->bufferB;
+    char *cause = outRow->bufferC;
+
+    char event = inLine[0];
+
+    double time;
+    int id, x, y, pop;
+    char gender;
+
+    if( event == 'B' ) {
+        int chain = 1;
+        char race = '?';
+        char status = '?';
+
+        // old-style lines might not have chain=, race=, or status= at end
+        int numRead = sscanf( inLine,
+                              "B %lf %d %999s %c (%d,%d) %999s pop=%d "
+                              "chain=%d race=%c status=%c",
+                              &time, &id, email, &gender, &x, &y, parent,
+                              &pop, &chain, &race, &status );
+        if( numRead < 8 ) {
+            return false;
+            }
+
+        outRow->numbers[ LIFE_PARENT_ID ] = -1;
+
+        int parentID;
+        if( sscanf( parent, "parent=%d,", &parentID ) == 1 ) {
+            outRow->numbers[ LIFE_PARENT_ID ] = parentID;
+
+            char *parentEmail = strstr( parent, "," );
+
+            // email left empty on malformed parent= with no comma
+            if( parentEmail != NULL ) {
+                outRow->strings[ LIFE_PARENT_EMAIL ] = &( parentEmail[1] );
+                }
+            }
+
+        outRow->numbers[ LIFE_CHAIN ] = chain;
+        outRow->numbers[ LIFE_RACE ] = race;
+        outRow->numbers[ LIFE_STATUS ] = status;
+        }
+    else if( event == 'D' ) {
+        double age;
+
+        int numRead = sscanf( inLine,
+                              "D %lf %d %999s age=%lf %c (%d,%d) %999s "
+                              "pop=%d",
+                              &time, &id, email, &age, &gender, &x, &y,
+                              cause, &pop );
+        if( numRead < 9 ) {
+            return false;
+            }
+
+        outRow->numbers[ LIFE_AGE ] = age;
+        outRow->strings[ LIFE_CAUSE ] = cause;
+        }
+    else {
+        return false;
+        }
+
+    outRow->numbers[ LIFE_TIME ] = time;
+    outRow->numbers[ LIFE_EVENT ] = event;
+    outRow->numbers[ LIFE_ID ] = id;
+    outRow->strings[ LIFE_EMAIL ] = email;
+    outRow->numbers[ LIFE_GENDER ] = gender;
+    outRow->numbers[ LIFE_X ] = x;
+    outRow->numbers[ LIFE_Y ] = y;
+    outRow->numbers[ LIFE_POP ] = pop;
+
+    return true;
+    }
+
+
+
+static char parseFoodLine( char *inLine, int *ioHour, double inDayStart,
+                           RowValues *outRow ) {
+    // food lines are counts for hour given by last hour= line,
+    // which is kept in ioHour between calls
+    // inDayStart is midnight at start of day log is from
+    int hour;
+    if( sscanf( inLine, "hour=%d", &hour ) == 1 ) {
+        *ioHour = hour;
+        return false;
+        }
+
+    int id, count, value, x, y;
+    double age;
+
+    int numRead = sscanf( inLine,
+                          "id=%d count=%d value=%d av_age=%lf "
+                          "av_mapX=%d av_mapY=%d",
+                          &id, &count, &value, &age, &x, &y );
+    if( numRead != 6 ) {
+        return false;
+        }
+
+    outRow->numbers[ FOOD_TIME ] = inDayStart + *ioHour * 3600;
+    outRow->numbers[ FOOD_HOUR ] = *ioHour;
+    outRow->numbers[ FOOD_ID ] = id;
+    outRow->numbers[ FOOD_COUNT ] = count;
+    outRow->numbers[ FOOD_VALUE ] = value;
+    outRow->numbers[ FOOD_AV_AGE ] = age;
+    outRow->numbers[ FOOD_AV_X ] = x;
+    outRow->numbers[ FOOD_AV_Y ] = y;
+
+    return true;
+    }
+
+
+
+static char parseCurseLine( char *inLine, RowValues *outRow ) {
+    char *email = outRow->bufferA;
+    char *targetEmail = outRow->bufferB;
+
+    char event = inLine[0];
+
+    double time;
+    int id = -1;
+    int score = 0;
+
+    email[0] = '\0';
+    targetEmail[0] = '\0';
+
+    char hasTarget = ( strstr( inLine, "=>" ) != NULL );
+
+    if( strncmp( inLine, "START ", 6 ) == 0 ||
+        strncmp( inLine, "STOP ", 5 ) == 0 ) {
+
+        if( sscanf( inLine, "%*s %lf", &time ) != 1 ) {
+            return false;
+            }
+        event = '+';
+        if( inLine[2] == 'O' ) {
+            event = '-';
+            }
+        }
+    else if( event == 'C' || event == 'F' || event == 'T' ||
+             ( event == 'A' && hasTarget == false ) ) {
+
+        // A lines without a target are forgive-all lines, with an ID
+        int numRead = sscanf( inLine, "%*c %lf %d %999s => %999s",
+                              &time, &id, email, targetEmail );
+        if( numRead < 3 ) {
+            return false;
+            }
+        }
+    else if( event == 'A' || event == 'E' ) {
+        int numRead = sscanf( inLine, "%*c %lf %999s => %999s",
+                              &time, email, targetEmail );
+        if( numRead != 3 ) {
+            return false;
+            }
+        }
+    else if( event == 'S' ) {
+        int numRead = sscanf( inLine, "S %lf %999s %d",
+                              &time, email, &score );
+        if( numRead != 3 ) {
+            return false;
+            }
+        }
+    else {
+        return false;
+        }
+
+    outRow->numbers[ CURSE_TIME ] = time;
+    outRow->numbers[ CURSE_EVENT ] = event;
+    outRow->numbers[ CURSE_ID ] = id;
+    outRow->strings[ CURSE_EMAIL ] = email;
+    outRow->strings[ CURSE_TARGET_EMAIL ] = targetEmail;
+    outRow->numbers[ CURSE_SCORE ] = score;
+
+    return true;
+    }
+
+
+
+// midnight at start of day that log file name like
+// 2019_03March_05_Tuesday.txt is for, or -1 if name isn't like that
+static double getLogFileDayStart( const char *inFileName ) {
+    int year, month, day;
+    char monthName[100];
+
+    if( sscanf( inFileName, "%d_%d%99[^_]_%d",
+                &year, &month, monthName, &day ) != 4 ) {
+        return -1;
+        }
+
+    struct tm ts;
+    memset( &ts, 0, sizeof( ts ) );
+
+    ts.tm_year = year - 1900;
+    ts.tm_mon = month - 1;
+    ts.tm_mday = day;
+    ts.tm_isdst = -1;
+
+    return (double)mktime( &ts );
+    }
+
+
+
+// inDayStart from getLogFileDayStart, for food logs
+// returns false on failure
+static char parseLogFile( const char *inPath, double inDayStart,
+                          PartitionBuilder *inB ) {
+
+    int hour = 0;
+
+    FILE *f = fopen( inPath, "r" );
+
+    if( f == NULL ) {
+        return false;
+        }
+
+    char line[4096];
+
+    RowValues row;
+
+    while( fgets( line, sizeof( line ), f ) != NULL ) {
+        clearRow( &row );
+
+        char parsed = false;
+
+        switch( inB->table ) {
+            case LOG_ARCHIVE_LIFE:
+                parsed = parseLifeLine( line, &row );
+                break;
+            case LOG_ARCHIVE_FOOD:
+                parsed = parseFoodLine( line, &hour, inDayStart, &row );
+                break;
+            case LOG_ARCHIVE_CURSE:
+                parsed = parseCurseLine( line, &row );
+                break;
+            default:
+                break;
+            }
+
+        if( parsed ) {
+            addRow( inB, &row );
+            }
+        }
+
+    fclose( f );
+
+    return true;
+    }
+
+
+
+
+// returns false on failure
+static char writePartition( PartitionBuilder *inB, const char *inPath,
+                            double *outMinTime, double *outMaxTime ) {
+
+    ColumnSpec *spec = tableColumns[ inB->table ];
+
+    SimpleVector<unsigned char> data;
+    SimpleVector<unsigned char> header;
+
+    writeVarint( &header, inB->table );
+    writeVarint( &header, inB->numRows );
+    writeVarint( &header, inB->numColumns );
+
+    *outMinTime = 0;
+    *outMaxTime = 0;
+
+    for( int c=0; c<inB->numColumns; c++ ) {
+        int64_t *values = inB->values[c].getElementArray();
+
+        int offset = data.size();
+
+        int64_t min = 0;
+        int64_t max = 0;
+
+        if( spec[c].isString ) {
+            StringDictionary *dict = &( inB->dictionaries[c] );
+
+            writeVarint( &data, dict->strings.size() );
+
+            for( int i=0; i<dict->strings.size(); i++ ) {
+                char *s = dict->strings.getElementDirect( i );
+                int length = strlen( s );
+
+                writeVarint( &data, length );
+                data.appendArray( (unsigned char*)s, length );
+                }
+
+            for( int r=0; r<inB->numRows; r++ ) {
+                writeVarint( &data, values[r] );
+                }
+            }
+        else {
+            int64_t last = 0;
+
+            for( int r=0; r<inB->numRows; r++ ) {
+                int64_t v = values[r];
+
+                writeVarint( &data, zigZag( v - last ) );
+                last = v;
+
+                if( r == 0 || v < min ) {
+                    min = v;
+                    }
+                if( r == 0 || v > max ) {
+                    max = v;
+                    }
+                }
+            }
+
+        delete [] values;
+
+        writeVarint( &header, spec[c].isString );
+        writeVarint( &header, spec[c].scale );
+        writeVarint( &header, zigZag( min ) );
+        writeVarint( &header, zigZag( max ) );
+        writeVarint( &header, offset );
+        writeVarint( &header, data.size() - offset );
+
+        if( c == 0 ) {
+            // time
+            *outMinTime = (double)min / spec[c].scale;
+            *outMaxTime = (double)max / spec[c].scale;
+            }
+        }
+
+
+    char *tempPath = autoSprintf( "%s.temp", inPath );
+
+    FILE *f = fopen( tempPath, "wb" );
+
+    if( f == NULL ) {
+        delete [] tempPath;
+        return false;
+        }
+
+    unsigned int headerLength = header.size();
+    unsigned char lengthBytes[4];
+    for( int i=0; i<4; i++ ) {
+        lengthBytes[i] = (unsigned char)( ( headerLength >> ( 8 * i ) ) &
+                                          0xFF );
+        }
+
+    fwrite( partitionMagic, 1, 4, f );
+    fwrite( lengthBytes, 1, 4, f );
+
+    unsigned char *headerBytes = header.getElementArray();
+    unsigned char *dataBytes = data.getElementArray();
+
+    fwrite( headerBytes, 1, header.size(), f );
+    int numWritten = fwrite( dataBytes, 1, data.size(), f );
+
+    delete [] headerBytes;
+    delete [] dataBytes;
+
+    char ok = ( numWritten == data.size() );
+
+    if( fclose( f ) != 0 ) {
+        ok = false;
+        }
+
+    if( ok ) {
+        // partition only replaced once new one fully written
+        remove( inPath );
+        ok = ( rename( tempPath, inPath ) == 0 );
+        }
+    else {
+        remove( tempPath );
+        }
+
+    delete [] tempPath;
+
+    return ok;
+    }
+
+
+
+
+double getLogArchiveNumber( LogArchivePartition *inPartition,
+                            int inColumn, int inRow ) {
+    LogArchiveColumn *c = &( inPartition->columns[ inColumn ] );
+
+    return (double)c->values[ inRow ] / c->scale;
+    }
+
+
+
+const char *getLogArchiveString( LogArchivePartition *inPartition,
+                                 int inColumn, int inRow ) {
+    LogArchiveColumn *c = &( inPartition->columns[ inColumn ] );
+
+    return c->dictionary[ c->values[ inRow ] ];
+    }
+
+
+
+void freeLogArchivePartition( LogArchivePartition *inPartition ) {
+    for( int c=0; c<inPartition->numColumns; c++ ) {
+        LogArchiveColumn *col = &( inPartition->columns[c] );
+
+        if( col->values != NULL ) {
+            delete [] col->values;
+            }
+        if( col->dictionary != NULL ) {
+            for( int i=0; i<col->dictionarySize; i++ ) {
+                delete [] col->dictionary[i];
+                }
+            delete [] col->dictionary;
+            }
+        }
+    delete [] inPartition->columns;
+    delete [] inPartition->sourceFolder;
+    delete [] inPartition->sourceFile;
+    delete inPartition;
+    }
+
+
+
+// returns false if block is malformed
+static char decodeColumn( unsigned char *inBlock, int inLength,
+                          int inNumRows, LogArchiveColumn *ioColumn ) {
+    unsigned char *pos = inBlock;
+    unsigned char *end = &( inBlock[ inLength ] );
+
+    uint64_t v;
+
+    ioColumn->values = new int64_t[ inNumRows ];
+
+    if( ioColumn->isString ) {
+        if( ! readVarint( &pos, end, &v ) ) {
+            return false;
+            }
+        int dictSize = (int)v;
+
+        ioColumn->dictionary = new char*[ dictSize ];
+        ioColumn->dictionarySize = 0;
+
+        for( int i=0; i<dictSize; i++ ) {
+            if( ! readVarint( &pos, end, &v ) ||
+                v > (uint64_t)( end - pos ) ) {
+                return false;
+                }
+            int length = (int)v;
+
+            char *s = new char[ length + 1 ];
+            memcpy( s, pos, length );
+            s[ length ] = '\0';
+            pos += length;
+
+            ioColumn->dictionary[i] = s;
+            ioColumn->dictionarySize++;
+            }
+
+        for( int r=0; r<inNumRows; r++ ) {
+            if( ! readVarint( &pos, end, &v ) || v >= (uint64_t)dictSize ) {
+                return false;
+                }
+            ioColumn->values[r] = (int64_t)v;
+            }
+        }
+    else {
+        int64_t last = 0;
+
+        for( int r=0; r<inNumRows; r++ ) {
+            if( ! readVarint( &pos, end, &v ) ) {
+                return false;
+                }
+            last += unZigZag( v );
+            ioColumn->values[r] = last;
+            }
+        }
+
+    return true;
+    }
+
+
+
+// returns NULL on failure, sets outSkipped if partition doesn't pass
+// query's column filter
+static LogArchivePartition *readPartition( const char *inPath,
+                                           LogArchiveQuery *inQuery,
+                                           char *outSkipped ) {
+    *outSkipped = false;
+
+    FILE *f = fopen( inPath, "rb" );
+
+    if( f == NULL ) {
+        return NULL;
+        }
+
+    unsigned char prefix[8];
+
+    if( fread( prefix, 1, 8, f ) != 8 ||
+        memcmp( prefix, partitionMagic, 4 ) != 0 ) {
+        fclose( f );
+        return NULL;
+        }
+
+    unsigned int headerLength = 0;
+    for( int i=0; i<4; i++ ) {
+        headerLength |= (unsigned int)prefix[ 4 + i ] << ( 8 * i );
+        }
+
+    if( headerLength > 65536 ) {
+        fclose( f );
+        return NULL;
+        }
+
+    unsigned char *header = new unsigned char[ headerLength ];
+
+    if( fread( header, 1, headerLength, f ) != headerLength ) {
+        delete [] header;
+        fclose( f );
+        return NULL;
+        }
+
+    unsigned char *pos = header;
+    unsigned char *end = &( header[ headerLength ] );
+
+    uint64_t table, numRows, numColumns;
+
+    if( ! readVarint( &pos, end, &table ) ||
+        ! readVarint( &pos, end, &numRows ) ||
+        ! readVarint( &pos, end, &numColumns ) ||
+        table != (uint64_t)inQuery->table ||
+        numColumns != (uint64_t)tableNumColumns[ inQuery->table ] ) {
+
+        delete [] header;
+        fclose( f );
+        return NULL;
+        }
+
+    LogArchivePartition *p = new LogArchivePartition;
+
+    p->table = inQuery->table;
+    p->sourceFolder = NULL;
+    p->sourceFile = NULL;
+    p->minTime = 0;
+    p->maxTime = 0;
+    p->numRows = (int)numRows;
+    p->numColumns = (int)numColumns;
+    p->columns = new LogArchiveColumn[ p->numColumns ];
+
+    int *offsets = new int[ p->numColumns ];
+    int *lengths = new int[ p->numColumns ];
+
+    char ok = true;
+
+    for( int c=0; c<p->numColumns; c++ ) {
+        LogArchiveColumn *col = &( p->columns[c] );
+
+        col->values = NULL;
+        col->dictionary = NULL;
+        col->dictionarySize = 0;
+
+        uint64_t isString, scale, min, max, offset, length;
+
+        if( ! readVarint( &pos, end, &isString ) ||
+            ! readVarint( &pos, end, &scale ) ||
+            ! readVarint( &pos, end, &min ) ||
+            ! readVarint( &pos, end, &max ) ||
+            ! readVarint( &pos, end, &offset ) ||
+            ! readVarint( &pos, end, &length ) ||
+            scale == 0 ) {
+            ok = false;
+            // rest stay NULL for free
+            for( int d=c+1; d<p->numColumns; d++ ) {
+                p->columns[d].values = NULL;
+                p->columns[d].dictionary = NULL;
+                p->columns[d].dictionarySize = 0;
+                }
+            break;
+            }
+
+        col->isString = (char)isString;
+        col->scale = (int)scale;
+        col->min = unZigZag( min );
+        col->max = unZigZag( max );
+
+        offsets[c] = (int)offset;
+        lengths[c] = (int)length;
+        }
+
+    delete [] header;
+
+
+    if( ok ) {
+        p->minTime = (double)p->columns[0].min / p->columns[0].scale;
+        p->maxTime = (double)p->columns[0].max / p->columns[0].scale;
+
+        int fc = inQuery->filterColumn;
+
+        if( fc >= 0 && fc < p->numColumns &&
+            ! p->columns[fc].isString &&
+            p->numRows > 0 ) {
+
+            double min = (double)p->columns[fc].min / p->columns[fc].scale;
+            double max = (double)p->columns[fc].max / p->columns[fc].scale;
+
+            if( max < inQuery->filterMin || min > inQuery->filterMax ) {
+                *outSkipped = true;
+                ok = false;
+                }
+            }
+        }
+
+
+    long dataStart = 8 + headerLength;
+
+    for( int c=0; ok && c<p->numColumns; c++ ) {
+        if( inQuery->columnMask != 0 &&
+            ( inQuery->columnMask & ( 1U << c ) ) == 0 ) {
+            continue;
+            }
+
+        unsigned char *block = new unsigned char[ lengths[c] ];
+
+        if( fseek( f, dataStart + offsets[c], SEEK_SET ) != 0 ||
+            (int)fread( block, 1, lengths[c], f ) != lengths[c] ||
+            ! decodeColumn( block, lengths[c], p->numRows,
+                            &( p->columns[c] ) ) ) {
+            ok = false;
+            }
+
+        delete [] block;
+        }
+
+    delete [] offsets;
+    delete [] lengths;
+
+    fclose( f );
+
+    if( !ok ) {
+        p->sourceFolder = stringDuplicate( "" );
+        p->sourceFile = stringDuplicate( "" );
+        freeLogArchivePartition( p );
+        return NULL;
+        }
+
+    return p;
+    }
+
+
+
+
+// runs inFunction( i, inData ) for each i in 0..inNumJobs-1, spread
+// across inNumThreads threads
+typedef void ( *JobFunction )( int inJobIndex, void *inData );
+
+
+class ArchiveWorkerThread : public Thread {
+
+    public:
+
+        ArchiveWorkerThread( JobFunction inFunction, void *inData,
+                             int inNumJobs, int *inNextJob,
+                             MutexLock *inLock )
+                : mFunction( inFunction ), mData( inData ),
+                  mNumJobs( inNumJobs ), mNextJob( inNextJob ),
+                  mLock( inLock ) {
+            start();
+            }
+
+
+        virtual void run() {
+            while( true ) {
+                mLock->lock();
+                int job = *mNextJob;
+                ( *mNextJob )++;
+                mLock->unlock();
+
+                if( job >= mNumJobs ) {
+                    return;
+                    }
+                mFunction( job, mData );
+                }
+            }
+
+    protected:
+
+        JobFunction mFunction;
+        void *mData;
+        int mNumJobs;
+        int *mNextJob;
+        MutexLock *mLock;
+    };
+
+
+
+static void runJobs( int inNumJobs, int inNumThreads,
+                     JobFunction inFunction, void *inData ) {
+
+    if( inNumThreads <= 1 || inNumJobs <= 1 ) {
+        for( int i=0; i<inNumJobs; i++ ) {
+            inFunction( i, inData );
+            }
+        return;
+        }
+
+    if( inNumThreads > inNumJobs ) {
+        inNumThreads = inNumJobs;
+        }
+
+    int nextJob = 0;
+    MutexLock lock;
+
+    ArchiveWorkerThread **threads = new ArchiveWorkerThread*[ inNumThreads ];
+
+    for( int i=0; i<inNumThreads; i++ ) {
+        threads[i] = new ArchiveWorkerThread( inFunction, inData,
+                                              inNumJobs, &nextJob, &lock );
+        }
+    for( int i=0; i<inNumThreads; i++ ) {
+        threads[i]->join();
+        delete threads[i];
+        }
+    delete [] threads;
+    }
+
+
+
+
+typedef struct IndexEntry {
+        int table;
+        char *partitionFile;
+        int numRows;
+        double minTime;
+        double maxTime;
+        long sourceSize;
+        char *sourceFolder;
+        char *sourceFile;
+    } IndexEntry;
+
+
+static void freeIndexEntries( SimpleVector<IndexEntry> *inEntries ) {
+    for( int i=0; i<inEntries->size(); i++ ) {
+        IndexEntry *e = inEntries->getElement( i );
+        delete [] e->partitionFile;
+        delete [] e->sourceFolder;
+        delete [] e->sourceFile;
+        }
+    inEntries->deleteAll();
+    }
+
+
+
+// returns false if no index
+static char readIndex( const char *inArchiveDir,
+                       SimpleVector<IndexEntry> *outEntries ) {
+    char *path = autoSprintf( "%s/%s", inArchiveDir, indexFileName );
+
+    FILE *f = fopen( path, "r" );
+
+    delete [] path;
+
+    if( f == NULL ) {
+        return false;
+        }
+
+    char partitionFile[500];
+    char sourceFolder[500];
+    char sourceFile[500];
+
+    IndexEntry e;
+
+    while( fscanf( f, "%d %499s %d %lf %lf %ld %499s %499s",
+                   &e.table, partitionFile, &e.numRows,
+                   &e.minTime, &e.maxTime, &e.sourceSize,
+                   sourceFolder, sourceFile ) == 8 ) {
+
+        if( e.table < 0 || e.table >= LOG_ARCHIVE_NUM_TABLES ) {
+            continue;
+            }
+
+        e.partitionFile = stringDuplicate( partitionFile );
+        e.sourceFolder = stringDuplicate( sourceFolder );
+        e.sourceFile = stringDuplicate( sourceFile );
+
+        outEntries->push_back( e );
+        }
+
+    fclose( f );
+
+    return true;
+    }
+
+
+
+// returns false on failure
+static char writeIndex( const char *inArchiveDir,
+                        SimpleVector<IndexEntry> *inEntries ) {
+    char *path = autoSprintf( "%s/%s", inArchiveDir, indexFileName );
+    char *tempPath = autoSprintf( "%s.temp", path );
+
+    FILE *f = fopen( tempPath, "w" );
+
+    char ok = ( f != NULL );
+
+    if( ok ) {
+        for( int i=0; i<inEntries->size(); i++ ) {
+            IndexEntry *e = inEntries->getElement( i );
+
+            fprintf( f, "%d %s %d %.0f %.0f %ld %s %s\n",
+                     e->table, e->partitionFile, e->numRows,
+                     floor( e->minTime ), ceil( e->maxTime ),
+                     e->sourceSize, e->sourceFolder, e->sourceFile );
+            }
+
+        if( fclose( f ) != 0 ) {
+            ok = false;
+            }
+        }
+
+    if( ok ) {
+        remove( path );
+        ok = ( rename( tempPath, path ) == 0 );
+        }
+
+    delete [] path;
+    delete [] tempPath;
+
+    return ok;
+    }
+
+
+
+
+typedef struct ConvertJob {
+        LogArchiveTable table;
+        char *sourcePath;
+
+        // found on main thread, mktime isn't safe to call from workers
+        double dayStart;
+        IndexEntry entry;
+        char succeeded;
+    } ConvertJob;
+
+
+typedef struct ConvertJobList {
+        const char *archiveDir;
+        ConvertJob *jobs;
+    } ConvertJobList;
+
+
+
+static void runConvertJob( int inJobIndex, void *inData ) {
+    ConvertJobList *list = (ConvertJobList*)inData;
+    ConvertJob *job = &( list->jobs[ inJobIndex ] );
+
+    PartitionBuilder b;
+    initBuilder( &b, job->table );
+
+    job->succeeded = false;
+
+    if( parseLogFile( job->sourcePath, job->dayStart, &b ) ) {
+        char *path = autoSprintf( "%s/%s", list->archiveDir,
+                                  job->entry.partitionFile );
+
+        job->entry.numRows = b.numRows;
+
+        job->succeeded = writePartition( &b, path,
+                                         &( job->entry.minTime ),
+                                         &( job->entry.maxTime ) );
+        delete [] path;
+        }
+
+    freeBuilder( &b );
+    }
+
+
+
+static char isArchivedLogFile( LogArchiveTable inTable, const char *inName ) {
+    int length = strlen( inName );
+
+    if( length < 4 || strcmp( &( inName[ length - 4 ] ), ".txt" ) != 0 ) {
+        return false;
+        }
+    if( strstr( inName, "_names" ) != NULL ||
+        strstr( inName, "Checkpoint" ) != NULL ) {
+        return false;
+        }
+    if( inTable == LOG_ARCHIVE_FOOD &&
+        getLogFileDayStart( inName ) < 0 ) {
+        return false;
+        }
+    return true;
+    }
+
+
+
+int convertLogsToArchive( const char *inServerDir,
+                          const char *inArchiveDir,
+                          int inNumThreads ) {
+
+    File serverDir( NULL, inServerDir );
+
+    if( ! serverDir.exists() || ! serverDir.isDirectory() ) {
+        printf( "Server dir %s not found\n", inServerDir );
+        return -1;
+        }
+
+    File archiveDir( NULL, inArchiveDir );
+
+    if( ! archiveDir.exists() ) {
+        archiveDir.makeDirectory();
+        }
+    if( ! archiveDir.isDirectory() ) {
+        printf( "Archive dir %s can't be created\n", inArchiveDir );
+        return -1;
+        }
+
+    SimpleVector<IndexEntry> entries;
+    readIndex( inArchiveDir, &entries );
+
+
+    SimpleVector<ConvertJob> jobs;
+
+    int numFolders;
+    File **folders = serverDir.getChildFilesSorted( &numFolders );
+
+    for( int i=0; i<numFolders; i++ ) {
+        char *folderName = folders[i]->getFileName();
+
+        int table = -1;
+
+        if( folders[i]->isDirectory() ) {
+            for( int t=0; t<LOG_ARCHIVE_NUM_TABLES; t++ ) {
+                if( strstr( folderName, tableFolderPrefix[t] ) ==
+                    folderName ) {
+                    table = t;
+                    }
+                }
+            if( strstr( folderName, "foodLogDetail" ) == folderName ) {
+                // different format, not archived
+                table = -1;
+                }
+            }
+
+        if( table == -1 ) {
+            delete [] folderName;
+            delete folders[i];
+            continue;
+            }
+
+        int numFiles;
+        File **files = folders[i]->getChildFilesSorted( &numFiles );
+
+        for( int j=0; j<numFiles; j++ ) {
+            char *fileName = files[j]->getFileName();
+
+            if( ! isArchivedLogFile( (LogArchiveTable)table, fileName ) ) {
+                delete [] fileName;
+                delete files[j];
+                continue;
+                }
+
+            long size = files[j]->getLength();
+
+            char upToDate = false;
+
+            for( int e=0; e<entries.size(); e++ ) {
+                IndexEntry *entry = entries.getElement( e );
+
+                if( strcmp( entry->sourceFolder, folderName ) == 0 &&
+                    strcmp( entry->sourceFile, fileName ) == 0 ) {
+
+                    if( entry->sourceSize == size ) {
+                        upToDate = true;
+                        }
+                    break;
+                    }
+                }
+
+            if( upToDate ) {
+                delete [] fileName;
+                delete files[j];
+                continue;
+                }
+
+            ConvertJob job;
+            job.table = (LogArchiveTable)table;
+            job.sourcePath = files[j]->getFullFileName();
+            job.dayStart = getLogFileDayStart( fileName );
+            job.succeeded = false;
+
+            job.entry.table = table;
+
+            int nameLength = strlen( fileName );
+            // drop .txt
+            fileName[ nameLength - 4 ] = '\0';
+            job.entry.partitionFile =
+                autoSprintf( "%s_%s.lar", folderName, fileName );
+            fileName[ nameLength - 4 ] = '.';
+
+            job.entry.numRows = 0;
+            job.entry.minTime = 0;
+            job.entry.maxTime = 0;
+            job.entry.sourceSize = size;
+            job.entry.sourceFolder = stringDuplicate( folderName );
+            job.entry.sourceFile = fileName;
+
+            jobs.push_back( job );
+
+            delete files[j];
+            }
+        delete [] files;
+
+        delete [] folderName;
+        delete folders[i];
+        }
+    delete [] folders;
+
+
+    ConvertJobList list = { inArchiveDir, jobs.getElementArray() };
+
+    runJobs( jobs.size(), inNumThreads, runConvertJob, &list );
+
+
+    int numConverted = 0;
+
+    for( int j=0; j<jobs.size(); j++ ) {
+        ConvertJob *job = &( list.jobs[j] );
+
+        delete [] job->sourcePath;
+
+        if( ! job->succeeded ) {
+            printf( "Failed to convert %s/%s\n",
+                    job->entry.sourceFolder, job->entry.sourceFile );
+
+            delete [] job->entry.partitionFile;
+            delete [] job->entry.sourceFolder;
+            delete [] job->entry.sourceFile;
+            continue;
+            }
+
+        // replace old entry for this source file, if any
+        for( int e=0; e<entries.size(); e++ ) {
+            IndexEntry *entry = entries.getElement( e );
+
+            if( strcmp( entry->partitionFile,
+                        job->entry.partitionFile ) == 0 ) {
+                delete [] entry->partitionFile;
+                delete [] entry->sourceFolder;
+                delete [] entry->sourceFile;
+                entries.deleteElement( e );
+                break;
+                }
+            }
+
+        entries.push_back( job->entry );
+        numConverted++;
+        }
+
+    delete [] list.jobs;
+
+
+    char ok = writeIndex( inArchiveDir, &entries );
+
+    freeIndexEntries( &entries );
+
+    if( !ok ) {
+        printf( "Failed to write archive index\n" );
+        return -1;
+        }
+
+    return numConverted;
+    }
+
+
+
+
+struct LogArchive {
+        char *dir;
+        SimpleVector<IndexEntry> entries;
+    };
+
+
+
+LogArchive *openLogArchive( const char *inArchiveDir ) {
+    LogArchive *a = new LogArchive;
+
+    if( ! readIndex( inArchiveDir, &( a->entries ) ) ) {
+        delete a;
+        return NULL;
+        }
+
+    a->dir = stringDuplicate( inArchiveDir );
+
+    return a;
+    }
+
+
+
+void closeLogArchive( LogArchive *inArchive ) {
+    freeIndexEntries( &( inArchive->entries ) );
+    delete [] inArchive->dir;
+    delete inArchive;
+    }
+
+
+
+void initLogArchiveQuery( LogArchiveQuery *outQuery,
+                          LogArchiveTable inTable ) {
+    outQuery->table = inTable;
+    outQuery->minTime = -HUGE_VAL;
+    outQuery->maxTime = HUGE_VAL;
+    outQuery->columnMask = 0;
+    outQuery->filterColumn = -1;
+    outQuery->filterMin = 0;
+    outQuery->filterMax = 0;
+    outQuery->processPartition = NULL;
+    outQuery->userData = NULL;
+    }
+
+
+
+typedef struct QueryJobList {
+        LogArchive *archive;
+        LogArchiveQuery *query;
+        IndexEntry **entries;
+        void **results;
+        char *skipped;
+    } QueryJobList;
+
+
+
+static void runQueryJob( int inJobIndex, void *inData ) {
+    QueryJobList *list = (QueryJobList*)inData;
+    IndexEntry *e = list->entries[ inJobIndex ];
+
+    char *path = autoSprintf( "%s/%s", list->archive->dir,
+                              e->partitionFile );
+
+    LogArchivePartition *p = readPartition( path, list->query,
+                                            &( list->skipped[ inJobIndex ] ) );
+    delete [] path;
+
+    if( p == NULL ) {
+        list->results[ inJobIndex ] = NULL;
+        return;
+        }
+
+    p->sourceFolder = stringDuplicate( e->sourceFolder );
+    p->sourceFile = stringDuplicate( e->sourceFile );
+
+    if( list->query->processPartition == NULL ) {
+        list->results[ inJobIndex ] = p;
+        }
+    else {
+        list->results[ inJobIndex ] =
+            list->query->processPartition( p, list->query->userData );
+
+        freeLogArchivePartition( p );
+        }
+    }
+
+
+
+static int compareEntryTimes( const void *inA, const void *inB ) {
+    IndexEntry *a = *( (IndexEntry**)inA );
+    IndexEntry *b = *( (IndexEntry**)inB );
+
+    int folderCompare = strcmp( a->sourceFolder, b->sourceFolder );
+
+    if( folderCompare != 0 ) {
+        return folderCompare;
+        }
+
+    if( a->minTime < b->minTime ) {
+        return -1;
+        }
+    if( a->minTime > b->minTime ) {
+        return 1;
+        }
+    return strcmp( a->partitionFile, b->partitionFile );
+    }
+
+
+
+void **runLogArchiveQuery( LogArchive *inArchive, LogArchiveQuery *inQuery,
+                           int inNumThreads, int *outNumResults ) {
+
+    SimpleVector<IndexEntry*> matching;
+
+    for( int i=0; i<inArchive->entries.size(); i++ ) {
+        IndexEntry *e = inArchive->entries.getElement( i );
+
+        if( e->table == inQuery->table &&
+            e->numRows > 0 &&
+            e->maxTime >= inQuery->minTime &&
+            e->minTime <= inQuery->maxTime ) {
+            matching.push_back( e );
+            }
+        }
+
+    int numJobs = matching.size();
+
+    QueryJobList list;
+    list.archive = inArchive;
+    list.query = inQuery;
+    list.entries = matching.getElementArray();
+    list.results = new void*[ numJobs ];
+    list.skipped = new char[ numJobs ];
+
+    qsort( list.entries, numJobs, sizeof( IndexEntry* ), compareEntryTimes );
+
+    runJobs( numJobs, inNumThreads, runQueryJob, &list );
+
+    // drop partitions that column filter skipped
+    int numResults = 0;
+    for( int i=0; i<numJobs; i++ ) {
+        if( ! list.skipped[i] ) {
+            list.results[ numResults ] = list.results[i];
+            numResults++;
+            }
+        }
+
+    delete [] list.entries;
+    delete [] list.skipped;
+
+    *outNumResults = numResults;
+    return list.results;
+    }
@@ -0,0 +1,221 @@
+#ifndef LOG_ARCHIVE_H_INCLUDED
+#define LOG_ARCHIVE_H_INCLUDED
+
+
+#include <stdint.h>
+
+
+// Compact binary archive of rotated life, food, and curse logs, for the
+// offline report tools.
+//
+// Each source log file (one day of one log folder) becomes one partition
+// file.  A partition stores each column separately:  numbers as
+// delta-encoded varints, strings as a per-partition dictionary plus
+// varint indices.  A report only reads and decodes the columns it asks
+// for.
+//
+// index.txt in the archive folder lists every partition with its row
+// count, time range, and the size of the source file it came from, so
+// queries can skip partitions outside their time range without opening
+// them, and conversion can skip source files that haven't changed.
+// Each partition header also holds the min and max of every number
+// column.
+//
+// Numbers are stored as integers.  Columns that hold fractional values
+// (ages, for example) have a scale, and the stored integer is
+// value * scale, exact for the precision the server logs with.
+
+
+
+enum LogArchiveTable {
+    LOG_ARCHIVE_LIFE = 0,
+    LOG_ARCHIVE_FOOD,
+    LOG_ARCHIVE_CURSE,
+    LOG_ARCHIVE_NUM_TABLES
+    };
+
+
+
+// columns for each table
+// column 0 is always time, in seconds
+// number columns that don't apply to a row are 0, string columns are ""
+
+// one row per B or D line in lifeLog*/ (not _names files)
+enum LifeColumn {
+    LIFE_TIME = 0,
+    // 'B' or 'D'
+    LIFE_EVENT,
+    LIFE_ID,
+    LIFE_EMAIL,
+    // 'F' or 'M'
+    LIFE_GENDER,
+    LIFE_X,
+    LIFE_Y,
+    // births only, -1 and "" for noParent
+    LIFE_PARENT_ID,
+    LIFE_PARENT_EMAIL,
+    // deaths only, age has scale 100
+    LIFE_AGE,
+    LIFE_CAUSE,
+    LIFE_POP,
+    // births only, 1, '?', and '?' on old lines that lack them
+    LIFE_CHAIN,
+    LIFE_RACE,
+    LIFE_STATUS,
+    LIFE_NUM_COLUMNS
+    };
+
+
+// one row per id= line in foodLog*/ (not foodLogDetail)
+enum FoodColumn {
+    // start of hour, from file name and hour= line
+    FOOD_TIME = 0,
+    FOOD_HOUR,
+    FOOD_ID,
+    FOOD_COUNT,
+    FOOD_VALUE,
+    // scale 1000000
+    FOOD_AV_AGE,
+    FOOD_AV_X,
+    FOOD_AV_Y,
+    FOOD_NUM_COLUMNS
+    };
+
+
+// one row per line in curseLog*/
+enum CurseColumn {
+    CURSE_TIME = 0,
+    // C, F, A, E, T, or S as in the log, '+' for START, '-' for STOP
+    CURSE_EVENT,
+    // -1 on lines without a player ID
+    CURSE_ID,
+    CURSE_EMAIL,
+    CURSE_TARGET_EMAIL,
+    // S lines only
+    CURSE_SCORE,
+    CURSE_NUM_COLUMNS
+    };
+
+
+
+typedef struct LogArchiveColumn {
+        char isString;
+
+        // number columns:  value * scale
+        // string columns:  index into dictionary
+        // NULL if column wasn't asked for
+        int64_t *values;
+
+        int scale;
+
+        // from partition header, even if column wasn't asked for
+        // value * scale, like values
+        int64_t min;
+        int64_t max;
+
+        int dictionarySize;
+        char **dictionary;
+    } LogArchiveColumn;
+
+
+
+typedef struct LogArchivePartition {
+        LogArchiveTable table;
+
+        // log folder and file the partition came from, like
+        // lifeLog_server2 and 2019_03March_05_Tuesday.txt
+        char *sourceFolder;
+        char *sourceFile;
+
+        double minTime;
+        double maxTime;
+
+        int numRows;
+
+        int numColumns;
+        LogArchiveColumn *columns;
+    } LogArchivePartition;
+
+
+// value * scale back to a value
+double getLogArchiveNumber( LogArchivePartition *inPartition,
+                            int inColumn, int inRow );
+
+// string column value, owned by partition
+const char *getLogArchiveString( LogArchivePartition *inPartition,
+                                 int inColumn, int inRow );
+
+void freeLogArchivePartition( LogArchivePartition *inPartition );
+
+
+
+
+// converts every log file found in lifeLog*, foodLog*, and curseLog*
+// folders in inServerDir that is new or has grown since the last run
+//
+// returns number of files converted, or -1 on failure
+int convertLogsToArchive( const char *inServerDir,
+                          const char *inArchiveDir,
+                          int inNumThreads );
+
+
+
+
+typedef struct LogArchive LogArchive;
+
+
+// returns NULL if inArchiveDir has no index
+LogArchive *openLogArchive( const char *inArchiveDir );
+
+void closeLogArchive( LogArchive *inArchive );
+
+
+
+typedef struct LogArchiveQuery {
+        LogArchiveTable table;
+
+        // inclusive, in seconds
+        double minTime;
+        double maxTime;
+
+        // bit (1 << column) set for each column to decode
+        // 0 for all
+        unsigned int columnMask;
+
+        // partitions whose min/max for this column doesn't overlap
+        // [filterMin, filterMax] are skipped, -1 for no filter
+        int filterColumn;
+        double filterMin;
+        double filterMax;
+
+        // called on worker threads, once for each matching partition,
+        // may not be called in time order
+        // returns a result for this partition, partition is freed after
+        //
+        // NULL to have partitions themselves returned as results, to be
+        // freed by caller
+        void *( *processPartition )( LogArchivePartition *inPartition,
+                                     void *inUserData );
+        void *userData;
+    } LogArchiveQuery;
+
+
+// sets up a query that matches every row of inTable
+void initLogArchiveQuery( LogArchiveQuery *outQuery, LogArchiveTable inTable );
+
+
+// runs processPartition for each matching partition on inNumThreads
+// worker threads
+//
+// returns results grouped by log folder, and in order of partition start
+// time within each folder, so they can be combined in the order each
+// server wrote its logs
+// results are NULL for partitions that failed to read
+//
+// result array destroyed by caller
+void **runLogArchiveQuery( LogArchive *inArchive, LogArchiveQuery *inQuery,
+                           int inNumThreads, int *outNumResults );
+
+
+
+#endif
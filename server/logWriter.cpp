@@ -0,0 +1,724 @@
+#include "logWriter.h"
+
+#include <atomic>
+
+#include <stdint.h>
+#include <string.h>
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/io/file/File.h"
+#include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/util/log/AppLog.h"
+
+
+
+struct LogWriterFile {
+        // NULL if open failed
+        FILE *file;
+        char *fileName;
+
+        // written to since last flush
+        // only touched by whichever thread is doing the writing
+        char dirty;
+    };
+
+
+
+enum logOp {
+    LOG_OP_OPEN,
+    LOG_OP_WRITE,
+    LOG_OP_CLOSE,
+    LOG_OP_BACKUP
+    };
+
+
+typedef struct LogRecord {
+        logOp op;
+        LogWriterFile *file;
+
+        // line for WRITE, mode for OPEN, backup file name for BACKUP
+        char *text;
+        int textLength;
+
+        double queueTime;
+    } LogRecord;
+
+
+
+// bounded multi-producer queue of record pointers (Vyukov)
+//
+// each cell's sequence number says whose turn it is:  equal to a
+// producer's claimed position when the cell is free for that producer,
+// one more than that once the record is in and the writer can take it
+typedef struct RingCell {
+        std::atomic<uint64_t> sequence;
+        LogRecord *record;
+    } RingCell;
+
+
+static RingCell *ring = NULL;
+static uint64_t ringMask = 0;
+
+static std::atomic<uint64_t> enqueuePos( 0 );
+
+// only touched by writer thread
+static uint64_t dequeuePos = 0;
+
+
+
+// returns false if full
+static char pushRecord( LogRecord *inRecord ) {
+    uint64_t pos = enqueuePos.load( std::memory_order_relaxed );
+
+    while( true ) {
+        RingCell *cell = &( ring[ pos & ringMask ] );
+
+        uint64_t seq = cell->sequence.load( std::memory_order_acquire );
+
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+
+        if( diff == 0 ) {
+            if( enqueuePos.compare_exchange_weak(
+                    pos, pos + 1, std::memory_order_relaxed ) ) {
+
+                cell->record = inRecord;
+                cell->sequence.store( pos + 1, std::memory_order_release );
+                return true;
+                }
+            // else pos now holds latest enqueuePos, try again
+            }
+        else if( diff < 0 ) {
+            // writer hasn't taken the record a full lap behind us yet
+            return false;
+            }
+        else {
+            // another producer got this cell first
+            pos = enqueuePos.load( std::memory_order_relaxed );
+            }
+        }
+    }
+
+
+
+// writer thread only
+// returns NULL if empty
+static LogRecord *popRecord() {
+    RingCell *cell = &( ring[ dequeuePos & ringMask ] );
+
+    uint64_t seq = cell->sequence.load( std::memory_order_acquire );
+
+    if( seq != dequeuePos + 1 ) {
+        // empty, or producer still filling cell
+        return NULL;
+        }
+
+    LogRecord *record = cell->record;
+
+    cell->sequence.store( dequeuePos + ringMask + 1,
+                          std::memory_order_release );
+    dequeuePos++;
+
+    return record;
+    }
+
+
+
+
+static int queueSize = 65536;
+
+static char dropWhenFull = false;
+
+static int idleSleepMS = 10;
+
+static double statsLogSeconds = 3600;
+static double lastStatsLogTime = 0;
+
+
+
+// counted by callers
+static std::atomic<int> numDropped( 0 );
+static std::atomic<int> numWaitedForRoom( 0 );
+static std::atomic<uint64_t> microsecondsWaitedForRoom( 0 );
+
+
+typedef struct LogWriterStats {
+        int numLines;
+        double numBytes;
+        int numBatches;
+        double maxBatchSeconds;
+
+        // from when line was queued until its batch was written and
+        // flushed
+        double sumLatency;
+        double maxLatency;
+
+        int maxQueued;
+    } LogWriterStats;
+
+
+// counted by writer
+static LogWriterStats stats;
+
+// guards stats and openErrors
+static MutexLock statsLock;
+
+// errors on writer thread are handed to main thread, so they can go
+// to AppLog without writer waiting on its own queue
+static SimpleVector<char*> openErrors;
+
+
+
+
+static void freeRecord( LogRecord *inRecord ) {
+    if( inRecord->text != NULL ) {
+        delete [] inRecord->text;
+        }
+    delete inRecord;
+    }
+
+
+
+static void reportError( char *inMessage, char inOnWriterThread ) {
+    if( inOnWriterThread ) {
+        statsLock.lock();
+        openErrors.push_back( inMessage );
+        statsLock.unlock();
+        }
+    else {
+        AppLog::error( inMessage );
+        delete [] inMessage;
+        }
+    }
+
+
+
+// does what record says, on whatever thread is doing the writing
+// files written to are added to ioDirtyFiles
+static void runRecord( LogRecord *inRecord,
+                       SimpleVector<LogWriterFile*> *ioDirtyFiles,
+                       char inOnWriterThread ) {
+
+    LogWriterFile *f = inRecord->file;
+
+    switch( inRecord->op ) {
+        case LOG_OP_OPEN:
+            f->file = fopen( f->fileName, inRecord->text );
+
+            if( f->file == NULL ) {
+                reportError( autoSprintf( "Failed to open log file %s",
+                                          f->fileName ),
+                             inOnWriterThread );
+                }
+            break;
+
+        case LOG_OP_WRITE:
+            if( f->file != NULL ) {
+                fwrite( inRecord->text, 1, inRecord->textLength, f->file );
+
+                if( ! f->dirty ) {
+                    f->dirty = true;
+                    ioDirtyFiles->push_back( f );
+                    }
+                }
+            break;
+
+        case LOG_OP_CLOSE:
+            if( f->dirty ) {
+                ioDirtyFiles->deleteElementEqualTo( f );
+                }
+            if( f->file != NULL ) {
+                fclose( f->file );
+                }
+            delete [] f->fileName;
+            delete f;
+            break;
+
+        case LOG_OP_BACKUP:
+            if( f->file != NULL ) {
+                fclose( f->file );
+                }
+
+            // move instead of copy, this can be a big file
+            // remove old one first (to avoid implementation-dependent
+            // behavior if destination exists)
+            remove( inRecord->text );
+            rename( f->fileName, inRecord->text );
+
+            // clear main log file and start writing to it again
+            f->file = fopen( f->fileName, "w" );
+
+            if( f->file == NULL ) {
+                reportError( autoSprintf( "Failed to open log file %s",
+                                          f->fileName ),
+                             inOnWriterThread );
+                }
+            break;
+        }
+    }
+
+
+
+static void flushDirtyFiles( SimpleVector<LogWriterFile*> *inDirtyFiles ) {
+    for( int i=0; i<inDirtyFiles->size(); i++ ) {
+        LogWriterFile *f = inDirtyFiles->getElementDirect( i );
+
+        fflush( f->file );
+        f->dirty = false;
+        }
+    inDirtyFiles->deleteAll();
+    }
+
+
+
+
+class LogWriterThread : public Thread {
+
+    public:
+
+        LogWriterThread()
+                : mStop( false ) {
+            start();
+            }
+
+
+        void stop() {
+            mStop.store( true, std::memory_order_release );
+            }
+
+
+        virtual void run() {
+            SimpleVector<LogWriterFile*> dirtyFiles;
+
+            while( true ) {
+                // check before draining, so that everything queued
+                // before stop is written
+                char stopping = mStop.load( std::memory_order_acquire );
+
+                double batchStart = Time::getCurrentTime();
+
+                int queued =
+                    (int)( enqueuePos.load( std::memory_order_relaxed ) -
+                           dequeuePos );
+
+                int numLines = 0;
+                double numBytes = 0;
+
+                // how long before batchStart each line was queued,
+                // negative if queued after
+                double sumQueuedAge = 0;
+                double maxQueuedAge = 0;
+
+                LogRecord *r;
+
+                while( ( r = popRecord() ) != NULL ) {
+                    runRecord( r, &dirtyFiles, true );
+
+                    if( r->op == LOG_OP_WRITE ) {
+                        numLines++;
+                        numBytes += r->textLength;
+
+                        double age = batchStart - r->queueTime;
+
+                        sumQueuedAge += age;
+                        if( numLines == 1 || age > maxQueuedAge ) {
+                            maxQueuedAge = age;
+                            }
+                        }
+
+                    freeRecord( r );
+                    }
+
+                if( dirtyFiles.size() > 0 ) {
+                    flushDirtyFiles( &dirtyFiles );
+                    }
+
+                if( numLines > 0 ) {
+                    // lines are written once flushed
+                    double batchSeconds =
+                        Time::getCurrentTime() - batchStart;
+
+                    double sumLatency =
+                        sumQueuedAge + numLines * batchSeconds;
+                    double maxLatency = maxQueuedAge + batchSeconds;
+
+                    statsLock.lock();
+
+                    stats.numLines += numLines;
+                    stats.numBytes += numBytes;
+                    stats.numBatches++;
+                    stats.sumLatency += sumLatency;
+
+                    if( maxLatency > stats.maxLatency ) {
+                        stats.maxLatency = maxLatency;
+                        }
+                    if( batchSeconds > stats.maxBatchSeconds ) {
+                        stats.maxBatchSeconds = batchSeconds;
+                        }
+                    if( queued > stats.maxQueued ) {
+                        stats.maxQueued = queued;
+                        }
+
+                    statsLock.unlock();
+                    }
+                else if( stopping ) {
+                    break;
+                    }
+                else {
+                    // let lines pile up into a batch
+                    Thread::staticSleep( idleSleepMS );
+                    }
+                }
+            }
+
+    protected:
+
+        std::atomic<char> mStop;
+    };
+
+
+
+static LogWriterThread *writerThread = NULL;
+
+// false if calls should do their work right away
+static std::atomic<char> writerRunning( false );
+
+
+
+
+void initLogWriter() {
+    if( ! SettingsManager::getIntSetting( "useLogWriterThread", 1 ) ) {
+        AppLog::info( "Log writer thread off, writing logs directly" );
+        return;
+        }
+
+    queueSize = SettingsManager::getIntSetting( "logWriterQueueSize", 65536 );
+
+    // round up to power of 2
+    int size = 2;
+    while( size < queueSize && size < ( 1 << 30 ) ) {
+        size *= 2;
+        }
+    queueSize = size;
+
+    dropWhenFull =
+        SettingsManager::getIntSetting( "logWriterDropWhenFull", 0 );
+
+    idleSleepMS =
+        SettingsManager::getIntSetting( "logWriterIdleSleepMS", 10 );
+
+    statsLogSeconds =
+        SettingsManager::getFloatSetting( "logWriterStatsLogSeconds", 3600 );
+
+    lastStatsLogTime = Time::getCurrentTime();
+
+    memset( &stats, 0, sizeof( stats ) );
+
+
+    ring = new RingCell[ queueSize ];
+    ringMask = (uint64_t)( queueSize - 1 );
+
+    for( int i=0; i<queueSize; i++ ) {
+        ring[i].sequence.store( (uint64_t)i, std::memory_order_relaxed );
+        ring[i].record = NULL;
+        }
+    enqueuePos.store( 0, std::memory_order_relaxed );
+    dequeuePos = 0;
+
+    writerThread = new LogWriterThread();
+
+    writerRunning.store( true, std::memory_order_release );
+
+    AppLog::infoF( "Log writer thread started, queue holds %d lines, "
+                   "%s when full",
+                   queueSize, dropWhenFull ? "dropping" : "waiting" );
+    }
+
+
+
+void freeLogWriter() {
+    if( writerThread == NULL ) {
+        return;
+        }
+
+    writerThread->stop();
+    writerThread->join();
+    delete writerThread;
+    writerThread = NULL;
+
+    writerRunning.store( false, std::memory_order_release );
+
+    // anything that got in after writer's last look
+    SimpleVector<LogWriterFile*> dirtyFiles;
+
+    LogRecord *r;
+    while( ( r = popRecord() ) != NULL ) {
+        runRecord( r, &dirtyFiles, false );
+        freeRecord( r );
+        }
+    flushDirtyFiles( &dirtyFiles );
+
+    delete [] ring;
+    ring = NULL;
+
+    statsLock.lock();
+    for( int i=0; i<openErrors.size(); i++ ) {
+        AppLog::error( openErrors.getElementDirect( i ) );
+        }
+    openErrors.deallocateStringElements();
+    statsLock.unlock();
+    }
+
+
+
+void stepLogWriter() {
+    if( writerThread == NULL ) {
+        return;
+        }
+
+    SimpleVector<char*> errors;
+    LogWriterStats s;
+
+    statsLock.lock();
+    for( int i=0; i<openErrors.size(); i++ ) {
+        errors.push_back( openErrors.getElementDirect( i ) );
+        }
+    openErrors.deleteAll();
+    s = stats;
+    statsLock.unlock();
+
+    for( int i=0; i<errors.size(); i++ ) {
+        AppLog::error( errors.getElementDirect( i ) );
+        }
+    errors.deallocateStringElements();
+
+
+    double curTime = Time::getCurrentTime();
+
+    if( statsLogSeconds > 0 &&
+        curTime - lastStatsLogTime > statsLogSeconds ) {
+
+        int dropped = numDropped.exchange( 0 );
+        int waited = numWaitedForRoom.exchange( 0 );
+        uint64_t waitedMicroseconds = microsecondsWaitedForRoom.exchange( 0 );
+
+        if( s.numLines > 0 || dropped > 0 ) {
+            double avLatency = 0;
+            if( s.numLines > 0 ) {
+                avLatency = s.sumLatency / s.numLines;
+                }
+
+            AppLog::infoF(
+                "Log writer:  %d lines (%.0f bytes) in %d batches, "
+                "max batch %.3f sec, queue latency av %.4f max %.3f sec, "
+                "max %d queued, %d waits for room (%.3f sec), "
+                "%d lines dropped",
+                s.numLines, s.numBytes, s.numBatches, s.maxBatchSeconds,
+                avLatency, s.maxLatency, s.maxQueued,
+                waited, waitedMicroseconds / 1000000.0, dropped );
+            }
+
+        statsLock.lock();
+        memset( &stats, 0, sizeof( stats ) );
+        statsLock.unlock();
+
+        lastStatsLogTime = curTime;
+        }
+    }
+
+
+
+
+// writes are the only records that can be dropped
+static void queueRecord( LogRecord *inRecord ) {
+
+    if( ! writerRunning.load( std::memory_order_acquire ) ) {
+        SimpleVector<LogWriterFile*> dirtyFiles;
+
+        runRecord( inRecord, &dirtyFiles, false );
+        flushDirtyFiles( &dirtyFiles );
+
+        freeRecord( inRecord );
+        return;
+        }
+
+    inRecord->queueTime = Time::getCurrentTime();
+
+    if( pushRecord( inRecord ) ) {
+        return;
+        }
+
+    if( dropWhenFull && inRecord->op == LOG_OP_WRITE ) {
+        numDropped++;
+        freeRecord( inRecord );
+        return;
+        }
+
+    numWaitedForRoom++;
+
+    double waitStart = Time::getCurrentTime();
+
+    while( ! pushRecord( inRecord ) ) {
+        Thread::staticSleep( 1 );
+        }
+
+    microsecondsWaitedForRoom +=
+        (uint64_t)( ( Time::getCurrentTime() - waitStart ) * 1000000 );
+    }
+
+
+
+static LogRecord *newRecord( logOp inOp, LogWriterFile *inFile,
+                             char *inText ) {
+    LogRecord *r = new LogRecord;
+
+    r->op = inOp;
+    r->file = inFile;
+    r->text = inText;
+    r->textLength = 0;
+    if( inText != NULL ) {
+        r->textLength = strlen( inText );
+        }
+    r->queueTime = 0;
+
+    return r;
+    }
+
+
+
+static LogWriterFile *newFile( const char *inFileName ) {
+    LogWriterFile *f = new LogWriterFile;
+
+    f->file = NULL;
+    f->fileName = stringDuplicate( inFileName );
+    f->dirty = false;
+
+    return f;
+    }
+
+
+
+LogWriterFile *logWriterOpen( const char *inFileName, const char *inMode ) {
+    LogWriterFile *f = newFile( inFileName );
+
+    queueRecord( newRecord( LOG_OP_OPEN, f, stringDuplicate( inMode ) ) );
+
+    return f;
+    }
+
+
+
+LogWriterFile *logWriterAdopt( FILE *inFile, const char *inFileName ) {
+    LogWriterFile *f = newFile( inFileName );
+
+    f->file = inFile;
+
+    return f;
+    }
+
+
+
+void logWriterPrintfV( LogWriterFile *inFile, const char *inFormat,
+                       va_list inArgList ) {
+
+    queueRecord( newRecord( LOG_OP_WRITE, inFile,
+                            vautoSprintf( inFormat, inArgList ) ) );
+    }
+
+
+
+void logWriterPrintf( LogWriterFile *inFile, const char *inFormat, ... ) {
+    va_list argList;
+    va_start( argList, inFormat );
+
+    logWriterPrintfV( inFile, inFormat, argList );
+
+    va_end( argList );
+    }
+
+
+
+void logWriterClose( LogWriterFile *inFile ) {
+    queueRecord( newRecord( LOG_OP_CLOSE, inFile, NULL ) );
+    }
+
+
+
+void logWriterBackup( LogWriterFile *inFile, const char *inBackupFileName ) {
+    queueRecord( newRecord( LOG_OP_BACKUP, inFile,
+                            stringDuplicate( inBackupFileName ) ) );
+    }
+
+
+
+
+AsyncFileLog::AsyncFileLog( const char *inFileName,
+                            unsigned long inSecondsBetweenBackups )
+        : FileLog( inFileName, inSecondsBetweenBackups ),
+          mWriterFile( NULL ) {
+
+    if( mLogFile != NULL ) {
+        // writer owns it now
+        mWriterFile = logWriterAdopt( mLogFile, mLogFileName );
+        mLogFile = NULL;
+        }
+    }
+
+
+
+AsyncFileLog::~AsyncFileLog() {
+    if( mWriterFile != NULL ) {
+        logWriterClose( mWriterFile );
+        mWriterFile = NULL;
+        }
+    }
+
+
+
+void AsyncFileLog::logStringV( const char *inLoggerName,
+                               int inLevel,
+                               const char *inFormatString,
+                               va_list inArgList ) {
+
+    if( mWriterFile == NULL || inLevel > mLoggingLevel ) {
+        return;
+        }
+
+    char *message = PrintLog::generateLogMessage( inLoggerName,
+                                                  inLevel,
+                                                  inFormatString,
+                                                  inArgList );
+
+    mLock->lock();
+
+    logWriterPrintf( mWriterFile, "%s\n", message );
+
+    if( mPrintOutNextMessage ) {
+        printf( "%s\n", message );
+        mPrintOutNextMessage = false;
+        }
+    else if( mPrintAllMessages ) {
+        char *plainMessage =
+            PrintLog::generatePlainMessage( inFormatString,
+                                            inArgList );
+        printf( "%s\n", plainMessage );
+        delete [] plainMessage;
+        }
+
+    if( Time::timeSec() - mTimeOfLastBackup > mSecondsBetweenBackups ) {
+        char *backupFileName = autoSprintf( "%s.backup", mLogFileName );
+
+        logWriterBackup( mWriterFile, backupFileName );
+
+        delete [] backupFileName;
+
+        mTimeOfLastBackup = Time::timeSec();
+        }
+
+    mLock->unlock();
+
+    delete [] message;
+    }
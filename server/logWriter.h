@@ -0,0 +1,102 @@
+#ifndef LOG_WRITER_H_INCLUDED
+#define LOG_WRITER_H_INCLUDED
+
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "minorGems/util/log/FileLog.h"
+
+
+
+// Background thread that does all writing for the game logs (life, food,
+// failure, and curse logs, the map change log, and log.txt), so that a
+// slow disk or a log rotation doesn't hold up a server step.
+//
+// Log calls format their line on the calling thread and push it onto a
+// lock-free queue that any thread can push to.  The writer thread takes
+// whatever has piled up, writes it, and flushes each file it wrote to
+// once per batch.  Opening, closing, and rotating files happens on the
+// writer thread too, in queue order, so files get exactly the same bytes
+// as when they were written directly.
+//
+// When the queue is full, callers either wait for room, or drop the
+// line, depending on the logWriterDropWhenFull setting.  Opens and closes
+// are never dropped.
+//
+// Before initLogWriter, after freeLogWriter, or with the useLogWriterThread
+// setting off, every call does its work right away on the calling thread.
+
+
+typedef struct LogWriterFile LogWriterFile;
+
+
+
+// reads settings and starts thread
+void initLogWriter();
+
+// writes everything still queued, then stops thread
+void freeLogWriter();
+
+
+// logs queue and latency stats every logWriterStatsLogSeconds
+// call from main thread
+void stepLogWriter();
+
+
+
+// like fopen
+// never returns NULL, failure to open is reported by writer, and writes
+// to a file that failed to open are discarded
+LogWriterFile *logWriterOpen( const char *inFileName,
+                              const char *inMode = "a" );
+
+
+// takes over an already-open file
+LogWriterFile *logWriterAdopt( FILE *inFile, const char *inFileName );
+
+
+// like fprintf, but file is flushed soon after, too
+void logWriterPrintf( LogWriterFile *inFile, const char *inFormat, ... );
+
+void logWriterPrintfV( LogWriterFile *inFile, const char *inFormat,
+                       va_list inArgList );
+
+
+// like fclose
+// inFile can't be used after this call
+void logWriterClose( LogWriterFile *inFile );
+
+
+// closes file, moves it to inBackupFileName (replacing what's there),
+// and opens a fresh, empty file under the original name
+void logWriterBackup( LogWriterFile *inFile, const char *inBackupFileName );
+
+
+
+
+// FileLog that writes through the log writer
+class AsyncFileLog : public FileLog {
+
+    public:
+
+        // see FileLog
+        AsyncFileLog( const char *inFileName,
+                      unsigned long inSecondsBetweenBackups = 3600 );
+
+        virtual ~AsyncFileLog();
+
+
+        // overrides FileLog::logStringV
+        virtual void logStringV( const char *inLoggerName,
+                                 int inLevel, const char* inFormatString,
+                                 va_list inArgList );
+
+    protected:
+
+        // NULL if file failed to open
+        LogWriterFile *mWriterFile;
+    };
+
+
+#endif
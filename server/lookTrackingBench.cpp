@@ -0,0 +1,330 @@
+// replays a look trace through CoordinateTimeTracking and through the
+// sorted-vector version it replaced, checks that both give the same
+// answers, and times each
+//
+// usage:  lookTrackingBench [lookTrace.txt]
+//
+// trace is recorded by server with recordLookTrace.ini set
+// with no trace, a made-up one is used, with players wandering apart
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "CoordinateTimeTracking.h"
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/random/JenkinsRandomSource.h"
+
+
+
+// old CoordinateTimeTracking, kept sorted by y, then x
+// with its insert point fixed, so answers can be compared
+class SortedCoordinateTimeTracking {
+    public:
+
+        SortedCoordinateTimeTracking()
+                : mNextIndex( 0 ) {
+            }
+
+
+        char checkExists( int inX, int inY, timeSec_t inCurTime ) {
+            int dir = 1;
+
+            int numRecords = mRecords.size();
+
+            if( numRecords > 0 ) {
+
+                CoordinateXYRecord *testR = mRecords.getElement( mNextIndex );
+
+                if( testR->y == inY &&
+                    testR->x == inX ) {
+                    testR->t = inCurTime;
+                    return true;
+                    }
+
+                if( testR->y > inY ||
+                    ( testR->y == inY
+                      &&
+                      testR->x > inX ) ) {
+                    dir = -1;
+                    }
+
+                if( dir == 1 ) {
+                    for( ; mNextIndex < numRecords; mNextIndex ++ ) {
+
+                        CoordinateXYRecord *r =
+                            mRecords.getElement( mNextIndex );
+                        if( r->y == inY &&
+                            r->x == inX ) {
+                            r->t = inCurTime;
+                            return true;
+                            }
+
+                        if( r->y > inY ||
+                            ( r->y == inY &&
+                              r->x > inX ) ) {
+                            break;
+                            }
+                        }
+                    }
+                else if( dir == -1 ) {
+                    for( ; mNextIndex > -1; mNextIndex -- ) {
+                        CoordinateXYRecord *r =
+                            mRecords.getElement( mNextIndex );
+                        if( r->y == inY &&
+                            r->x == inX ) {
+                            r->t = inCurTime;
+                            return true;
+                            }
+
+                        if( r->y < inY ||
+                            ( r->y == inY &&
+                              r->x < inX ) ) {
+                            // insert after smaller record
+                            // (server version inserted before it, which
+                            //  broke sort order and gave wrong answers)
+                            mNextIndex ++;
+                            break;
+                            }
+                        }
+                    }
+                }
+            else {
+                mNextIndex = 0;
+                }
+
+            CoordinateXYRecord r = { inX, inY, inCurTime };
+
+            if( mNextIndex == numRecords ) {
+                mRecords.push_back( r );
+                }
+            else if( mNextIndex == -1 ) {
+                mRecords.push_front( r );
+                mNextIndex = 0;
+                }
+            else {
+                mRecords.push_middle( r, mNextIndex );
+                }
+            return false;
+            }
+
+
+        void cleanStale( timeSec_t inStaleTime ) {
+            SimpleVector<CoordinateXYRecord> temp( mRecords.size() );
+
+            for( int i=0; i<mRecords.size(); i++ ) {
+                CoordinateXYRecord *r = mRecords.getElement( i );
+
+                if( r->t > inStaleTime ) {
+                    temp.push_back( *r );
+                    }
+                }
+            mRecords.deleteAll();
+            mRecords.push_back_other( &temp );
+
+            mNextIndex = 0;
+            }
+
+
+        int getNumRecords() {
+            return mRecords.size();
+            }
+
+
+    private:
+        SimpleVector<CoordinateXYRecord> mRecords;
+        int mNextIndex;
+    };
+
+
+
+typedef struct TraceEntry {
+        // 'L' for look, 'C' for clean
+        char type;
+        timeSec_t t;
+        int xStart, yStart, xEnd, yEnd;
+    } TraceEntry;
+
+
+static SimpleVector<TraceEntry> trace;
+
+
+
+static char readTrace( const char *inFileName ) {
+    FILE *f = fopen( inFileName, "r" );
+
+    if( f == NULL ) {
+        printf( "Failed to open %s\n", inFileName );
+        return false;
+        }
+
+    char type;
+    while( fscanf( f, " %c", &type ) == 1 ) {
+        TraceEntry e = { type, 0, 0, 0, 0, 0 };
+        int numRead = 0;
+
+        if( type == 'L' ) {
+            numRead = fscanf( f, "%lf %d %d %d %d", &e.t,
+                              &e.xStart, &e.yStart, &e.xEnd, &e.yEnd );
+            if( numRead != 5 ) {
+                break;
+                }
+            }
+        else if( type == 'C' ) {
+            numRead = fscanf( f, "%lf", &e.t );
+            if( numRead != 1 ) {
+                break;
+                }
+            }
+        else {
+            break;
+            }
+        trace.push_back( e );
+        }
+
+    fclose( f );
+    return true;
+    }
+
+
+
+// like server, every player looks around itself every 5 seconds,
+// and stale looks are cleaned every step
+static void makeTrace( int inNumPlayers, int inSeconds ) {
+    JenkinsRandomSource randSource( 3838 );
+
+    int *x = new int[ inNumPlayers ];
+    int *y = new int[ inNumPlayers ];
+
+    for( int p=0; p<inNumPlayers; p++ ) {
+        x[p] = randSource.getRandomBoundedInt( -5000, 5000 );
+        y[p] = randSource.getRandomBoundedInt( -5000, 5000 );
+        }
+
+    timeSec_t startT = 1000000;
+
+    for( int s=0; s<inSeconds; s++ ) {
+        timeSec_t t = startT + s;
+
+        for( int p=0; p<inNumPlayers; p++ ) {
+            x[p] += randSource.getRandomBoundedInt( -4, 4 );
+            y[p] += randSource.getRandomBoundedInt( -4, 4 );
+
+            if( ( s + p ) % 5 == 0 ) {
+                TraceEntry e = { 'L', t,
+                                 x[p] - 8, y[p] - 7, x[p] + 8, y[p] + 7 };
+                trace.push_back( e );
+                }
+            }
+
+        // several server steps per second
+        for( int i=0; i<10; i++ ) {
+            TraceEntry e = { 'C', t - 10, 0, 0, 0, 0 };
+            trace.push_back( e );
+            }
+        }
+
+    delete [] x;
+    delete [] y;
+    }
+
+
+
+// returns number of spots that were new
+template <class Tracking>
+static int replay( Tracking *inTracking, SimpleVector<char> *outResults,
+                   double *outSeconds ) {
+    int numNew = 0;
+
+    double startTime = Time::getCurrentTime();
+
+    for( int i=0; i<trace.size(); i++ ) {
+        TraceEntry *e = trace.getElement( i );
+
+        if( e->type == 'C' ) {
+            inTracking->cleanStale( e->t );
+            continue;
+            }
+
+        for( int y=e->yStart; y<=e->yEnd; y++ ) {
+            for( int x=e->xStart; x<=e->xEnd; x++ ) {
+                char exists = inTracking->checkExists( x, y, e->t );
+
+                if( ! exists ) {
+                    numNew++;
+                    }
+                if( outResults != NULL ) {
+                    outResults->push_back( exists );
+                    }
+                }
+            }
+        }
+
+    *outSeconds = Time::getCurrentTime() - startTime;
+
+    return numNew;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    if( inNumArgs > 1 ) {
+        if( ! readTrace( inArgs[1] ) ) {
+            return 1;
+            }
+        printf( "Read %d trace entries from %s\n", trace.size(), inArgs[1] );
+        }
+    else {
+        makeTrace( 200, 120 );
+        printf( "Made trace with %d entries\n", trace.size() );
+        }
+
+
+    SimpleVector<char> oldResults;
+    SimpleVector<char> newResults;
+
+    double oldSeconds, newSeconds;
+
+    SortedCoordinateTimeTracking oldTracking;
+    CoordinateTimeTracking newTracking;
+
+    int oldNew = replay( &oldTracking, &oldResults, &oldSeconds );
+    int newNew = replay( &newTracking, &newResults, &newSeconds );
+
+    int numMismatches = 0;
+
+    for( int i=0; i<oldResults.size(); i++ ) {
+        if( oldResults.getElementDirect( i ) !=
+            newResults.getElementDirect( i ) ) {
+            numMismatches++;
+            }
+        }
+
+    printf( "%d checks, %d new spots, %d records left\n",
+            oldResults.size(), newNew, newTracking.getNumRecords() );
+
+    if( oldNew != newNew ||
+        oldTracking.getNumRecords() != newTracking.getNumRecords() ) {
+        numMismatches++;
+        }
+
+
+    // time again without storing results
+    SortedCoordinateTimeTracking oldTracking2;
+    CoordinateTimeTracking newTracking2;
+
+    replay( &oldTracking2, NULL, &oldSeconds );
+    replay( &newTracking2, NULL, &newSeconds );
+
+    printf( "Sorted vector:  %.3f sec\n", oldSeconds );
+    printf( "Hash index:     %.3f sec\n", newSeconds );
+
+    if( numMismatches > 0 ) {
+        printf( "FAILED:  %d mismatches\n", numMismatches );
+        return 1;
+        }
+
+    printf( "All results match\n" );
+    return 0;
+    }
@@ -28,6 +28,8 @@
 //#include "stackdb.h"
 //#include "lineardb.h"
 #include "lineardb3.h"
+#include "dbWriteBatch.h"
+#include "logWriter.h"
 
 #include "minorGems/util/crc32.h"
 
@@ -93,6 +95,7 @@
 #define DB_open LINEARDB3_open
 #define DB_close LINEARDB3_close
 #define DB_get LINEARDB3_get
+#define DB_getMany LINEARDB3_getMany
 #define DB_put LINEARDB3_put
 // no distinction between put and put_new in lineardb3
 #define DB_put_new LINEARDB3_put
@@ -113,6 +116,7 @@
 
     
 #include "dbCommon.h"
+#include "terrainGen.h"
 
 
 #include <stdarg.h>
@@ -251,7 +255,7 @@ static unsigned int biomeRandSeedB = 941;
 static SimpleVector<int> barrierItemList;
 
 
-static FILE *mapChangeLogFile = NULL;
+static LogWriterFile *mapChangeLogFile = NULL;
 
 static double mapChangeLogTimeStart = -1;
 
@@ -324,17 +328,17 @@ static int specialBiomeBandDefaultIndex;
 static SimpleVector<int> *naturalMapIDs;
 static SimpleVector<float> *naturalMapChances;
 
-typedef struct MapGridPlacement {
-        int id;
-        int spacingX, spacingY;
-        int phaseX, phaseY;
-        int wiggleScaleX, wiggleScaleY;
-        SimpleVector<int> permittedBiomes;
-    } MapGridPlacement;
+// true for moving objects (animals), parallel to naturalMapIDs
+static SimpleVector<char> *naturalMapMoving;
 
 static SimpleVector<MapGridPlacement> gridPlacements;
 
 
+// procedural terrain settings, pointing at the above
+// reentrant, so it can be used by region prefill
+static TerrainGenerator terrainGen;
+
+
 
 static SimpleVector<int> allNaturalMapIDs;
 
@@ -391,6 +395,118 @@ static char metaDBOpen = false;
 
 
 
+// once initMap is done, puts to map, time, floor, floor time, and look time
+// DBs are collected here and applied once per step
+static DBWriteBatch mapWriteBatch;
+static char mapWriteBatchOn = false;
+
+static const char *mapWriteBatchLogName = "mapRedo.log";
+
+static int dbBatchIndex = -1;
+static int timeDBBatchIndex = -1;
+static int floorDBBatchIndex = -1;
+static int floorTimeDBBatchIndex = -1;
+static int lookTimeDBBatchIndex = -1;
+
+
+
+static int batchedDBGet( DB *inDB, int inBatchIndex, 
+                         unsigned char *inKey, unsigned char *outValue ) {
+    if( mapWriteBatchOn && 
+        mapWriteBatch.get( inBatchIndex, inKey, outValue ) ) {
+        return 0;
+        }
+    return DB_get( inDB, inKey, outValue );
+    }
+
+
+
+// like batchedDBGet for a packed array of keys, with one result per key
+// (0 found, 1 not found) in outResults
+// returns -1 on error
+static int batchedDBGetMany( DB *inDB, int inBatchIndex, unsigned int inNum,
+                             unsigned char *inKeys, unsigned char *outValues,
+                             char *outResults ) {
+    if( ! mapWriteBatchOn ) {
+        return DB_getMany( inDB, inNum, inKeys, outValues, outResults );
+        }
+
+    unsigned int keySize = inDB->keySize;
+    unsigned int valueSize = inDB->valueSize;
+    
+    // pending writes are newer than what's in DB, only look up the rest
+    SimpleVector<unsigned int> rest;
+    
+    for( unsigned int i=0; i<inNum; i++ ) {
+        if( mapWriteBatch.get( inBatchIndex, &( inKeys[ i * keySize ] ),
+                               &( outValues[ i * valueSize ] ) ) ) {
+            outResults[i] = 0;
+            }
+        else {
+            rest.push_back( i );
+            }
+        }
+
+    unsigned int numRest = rest.size();
+    
+    if( numRest == 0 ) {
+        return 0;
+        }
+    
+    unsigned char *restKeys = new unsigned char[ numRest * keySize ];
+    unsigned char *restValues = new unsigned char[ numRest * valueSize ];
+    char *restResults = new char[ numRest ];
+    
+    for( unsigned int r=0; r<numRest; r++ ) {
+        memcpy( &( restKeys[ r * keySize ] ),
+                &( inKeys[ rest.getElementDirect( r ) * keySize ] ), 
+                keySize );
+        }
+    
+    int result = DB_getMany( inDB, numRest, restKeys, restValues, 
+                             restResults );
+    
+    for( unsigned int r=0; r<numRest; r++ ) {
+        unsigned int i = rest.getElementDirect( r );
+        
+        outResults[i] = restResults[r];
+        
+        if( restResults[r] == 0 ) {
+            memcpy( &( outValues[ i * valueSize ] ),
+                    &( restValues[ r * valueSize ] ), valueSize );
+            }
+        }
+
+    delete [] restKeys;
+    delete [] restValues;
+    delete [] restResults;
+    
+    return result;
+    }
+
+
+
+static void batchedDBPut( DB *inDB, int inBatchIndex, 
+                          unsigned char *inKey, unsigned char *inValue ) {
+    if( mapWriteBatchOn ) {
+        mapWriteBatch.put( inBatchIndex, inKey, inValue );
+        }
+    else {
+        DB_put( inDB, inKey, inValue );
+        }
+    }
+
+
+
+// must be called before iterating through any batched DB
+static void flushMapWriteBatch() {
+    if( mapWriteBatchOn ) {
+        mapWriteBatch.flush();
+        }
+    }
+
+
+
 static int randSeed = 124567;
 //static JenkinsRandomSource randSource( randSeed );
 static CustomRandomSource randSource( randSeed );
@@ -486,6 +602,10 @@ liveDecayRecordLastLookTimeMaxContainedHashTable( 1024, defaultContRecord );
 
 static CoordinateTimeTracking lookTimeTracking;
 
+// if recordLookTrace.ini is set, looks and cleans of lookTimeTracking
+// are appended here, for replay in lookTrackingBench
+static FILE *lookTraceFile = NULL;
+
 
 
 // track currently in-process movements so that we can be queried
@@ -652,6 +772,7 @@ static char hasPrimaryHomeland( int inLineageEveID ) {
 
 
 #include "../commonSource/fractalNoise.h"
+#include "../commonSource/binaryMapChunk.h"
 
 
 
@@ -792,40 +913,6 @@ static void dbFloorPut( int inX, int inY, int inValue );
 
 
 
-// inKnee in 0..inf, smaller values make harder knees
-// intput in 0..1
-// output in 0..1
-
-// from Simplest AI trick in the book:
-// Normalized Tunable SIgmoid Function 
-// Dino Dini, GDC 2013
-double sigmoid( double inInput, double inKnee ) {
-    
-    // in -1,-1
-    double shiftedInput = inInput * 2 - 1;
-    
-
-    double sign = 1;
-    if( shiftedInput < 0 ) {
-        sign = -1;
-        }
-    
-    
-    double k = -1 - inKnee;
-    
-    double absInput = fabs( shiftedInput );
-
-    // out in -1..1
-    double out = sign * absInput * k / ( 1 + k - absInput );
-    
-    return ( out + 1 ) * 0.5;
-    }
-
-
-
-
-
-
 // optimization:
 // cache biomeIndex results in RAM
 
@@ -899,28 +986,7 @@ static void biomePutCached( int inX, int inY, int inBiome, int inSecondPlace,
 
 
 static int getSpecialBiomeIndexForYBand( int inY, char *outOfBand = NULL ) {
-    if( outOfBand != NULL ) {
-        *outOfBand = false;
-        }
-    
-    // new method, use y centers and thickness
-    int radius = specialBiomeBandThickness / 2;
-    
-    for( int i=0; i<specialBiomeBandYCenter.size(); i++ ) {
-        int yCenter = specialBiomeBandYCenter.getElementDirect( i );
-        
-        if( abs( inY - yCenter ) <= radius ) {
-            return specialBiomeBandIndexOrder.getElementDirect( i );
-            }
-        }
-    
-
-    // else not in radius of any band
-    if( outOfBand != NULL ) {
-        *outOfBand = true;
-        }
-    
-    return specialBiomeBandDefaultIndex;
+    return getTerrainSpecialBiomeForYBand( &terrainGen, inY, outOfBand );
     }
 
 
@@ -952,158 +1018,8 @@ static int computeMapBiomeIndex( int inX, int inY,
         }
 
     // else cache miss
-    pickedBiome = -1;
-
-
-    // try topographical altitude mapping
-
-    setXYRandomSeed( biomeRandSeedA, biomeRandSeedB );
-
-    double randVal = 
-        ( getXYFractal( inX, inY,
-                        0.55, 
-                        0.83332 + 0.08333 * numBiomes ) );
-
-    // push into range 0..1, based on sampled min/max values
-    randVal -= 0.099668;
-    randVal *= 1.268963;
-
-
-    // flatten middle
-    //randVal = ( pow( 2*(randVal - 0.5 ), 3 ) + 1 ) / 2;
-
-
-    // push into range 0..1 with manually tweaked values
-    // these values make it pretty even in terms of distribution:
-    //randVal -= 0.319;
-    //randVal *= 3;
-
-    
-
-    // these values are more intuitve to make a map that looks good
-    //randVal -= 0.23;
-    //randVal *= 1.9;
-    
-
-    
-
-    
-    // apply gamma correction
-    //randVal = pow( randVal, 1.5 );
-    /*
-    randVal += 0.4* sin( inX / 40.0 );
-    randVal += 0.4 *sin( inY / 40.0 );
-    
-    randVal += 0.8;
-    randVal /= 2.6;
-    */
-
-    // slow arc n to s:
-
-    // pow version has flat area in middle
-    //randVal += 0.7 * pow( ( inY / 354.0 ), 3 ) ;
-
-    // sin version 
-    //randVal += 0.3 * sin( 0.5 * M_PI * inY / 354.0 );
-    
-
-    /*
-        ( sin( M_PI * inY / 708 ) + 
-          (1/3.0) * sin( 3 * M_PI * inY / 708 ) );
-    */
-    //randVal += 0.5;
-    //randVal /= 2.0;
-
-
-    
-    float i = randVal * biomeTotalWeight;
-    
-    pickedBiome = 0;
-    while( pickedBiome < numBiomes &&
-           i > biomeCumuWeights[pickedBiome] ) {
-        pickedBiome++;
-        }
-    if( pickedBiome >= numBiomes ) {
-        pickedBiome = numBiomes - 1;
-        }
-    
-
-
-    if( pickedBiome >= regularBiomeLimit && numSpecialBiomes > 0 ) {
-        // special case:  on a peak, place a special biome here
-
-
-        if( specialBiomeBandMode ) {
-            // use band mode for these
-            pickedBiome = getSpecialBiomeIndexForYBand( inY );
-            
-            secondPlace = regularBiomeLimit - 1;
-            secondPlaceGap = 0.1;
-            }
-        else {
-            // use patches mode for these
-            pickedBiome = -1;
-            
-            
-            double maxValue = -10;
-            double secondMaxVal = -10;
-            
-            for( int i=regularBiomeLimit; i<numBiomes; i++ ) {
-                int biome = biomes[i];
-                
-                setXYRandomSeed( biome * 263 + biomeRandSeedA + 38475,
-                                 biomeRandSeedB );
-                
-                double randVal = getXYFractal(  inX,
-                                                inY,
-                                                0.55, 
-                                                2.4999 + 
-                                                0.2499 * numSpecialBiomes );
-                
-                if( randVal > maxValue ) {
-                    if( maxValue != -10 ) {
-                        secondMaxVal = maxValue;
-                        }
-                    maxValue = randVal;
-                    pickedBiome = i;
-                    }
-                }
-            
-            if( maxValue - secondMaxVal < 0.03 ) {
-                // close!  that means we're on a boundary between special biomes
-                
-                // stick last regular biome on this boundary, so special
-                // biomes never touch
-                secondPlace = pickedBiome;
-                secondPlaceGap = 0.1;
-                pickedBiome = regularBiomeLimit - 1;
-                }        
-            else {
-                secondPlace = regularBiomeLimit - 1;
-                secondPlaceGap = 0.1;
-                }
-            }
-        }
-    else {
-        // second place for regular biome rings
-        
-        secondPlace = pickedBiome - 1;
-        if( secondPlace < 0 ) {
-            secondPlace = pickedBiome + 1;
-            }
-        secondPlaceGap = 0.1;
-        }
-    
-
-    if( ! allowSecondPlaceBiomes ) {
-        // make the gap ridiculously big, so that second-place placement
-        // never happens.
-        // but keep secondPlace set different from pickedBiome
-        // (elsewhere in code, we avoid placing animals if 
-        // secondPlace == picked
-        secondPlaceGap = 10.0;
-        }
-
+    pickedBiome = getTerrainBiome( &terrainGen, inX, inY,
+                                   &secondPlace, &secondPlaceGap );
 
     biomePutCached( inX, inY, pickedBiome, secondPlace, secondPlaceGap );
     
@@ -1402,240 +1318,166 @@ static int getBaseMap( int inX, int inY, char *outGridPlacement = NULL ) {
     getBaseMapCallCount ++;
 
 
-    if( outGridPlacement != NULL ) {
-        *outGridPlacement = false;
-        }
-    
-
-    // see if any of our grids apply
-    setXYRandomSeed( 9753 );
-
-    for( int g=0; g < gridPlacements.size(); g++ ) {
-        MapGridPlacement *gp = gridPlacements.getElement( g );
+    char gridPlacement = false;
+    int checkedBiome = -1;
 
+    int id = getTerrainObject( &terrainGen, inX, inY, getMapBiomeIndex,
+                               &gridPlacement, &checkedBiome );
 
-        /*
-        double gridWiggleX = getXYFractal( inX / gp->spacingX, 
-                                           inY / gp->spacingY, 
-                                           0.1, 0.25 );
-        
-        double gridWiggleY = getXYFractal( inX / gp->spacingX, 
-                                           inY / gp->spacingY + 392387, 
-                                           0.1, 0.25 );
-        */
-        // turn wiggle off for now
-        double gridWiggleX = 0;
-        double gridWiggleY = 0;
-
-        if( ( inX + gp->phaseX + lrint( gridWiggleX * gp->wiggleScaleX ) ) 
-            % gp->spacingX == 0 &&
-            ( inY + gp->phaseY + lrint( gridWiggleY * gp->wiggleScaleY ) ) 
-            % gp->spacingY == 0 ) {
-            
-            // hits this grid
-
-            // make sure this biome is on the list for this object
-            int secondPlace;
-            double secondPlaceGap;
-        
-            int pickedBiome = getMapBiomeIndex( inX, inY, &secondPlace,
-                                                &secondPlaceGap );
-        
-            if( pickedBiome == -1 ) {
-                mapCacheInsert( inX, inY, 0 );
-                return 0;
-                }
+    // only override if it's not already set
+    // if it's already set, then we're calling getBaseMap for neighboring
+    // map cells (wide, tall, moving objects, etc.)
+    // getBaseMap is always called for our cell in question first
+    // before examining neighboring cells if needed
+    if( checkedBiome != -1 && lastCheckedBiome == -1 ) {
+        lastCheckedBiome = biomes[checkedBiome];
+        lastCheckedBiomeX = inX;
+        lastCheckedBiomeY = inY;
+        }
 
-            if( gp->permittedBiomes.getElementIndex( pickedBiome ) != -1 ) {
-                mapCacheInsert( inX, inY, gp->id, true );
+    mapCacheInsert( inX, inY, id, gridPlacement );
 
-                if( outGridPlacement != NULL ) {
-                    *outGridPlacement = true;
-                    }
-                return gp->id;
-                }
-            }    
+    if( outGridPlacement != NULL ) {
+        *outGridPlacement = gridPlacement;
         }
-             
 
+    return id;
+    }
 
-    setXYRandomSeed( 5379 );
-    
-    // first step:  save rest of work if density tells us that
-    // nothing is here anyway
-    double density = getXYFractal( inX, inY, 0.1, 0.25 );
-    
-    // correction
-    density = sigmoid( density, 0.1 );
-    
-    // scale
-    density *= .4;
-    // good for zoom in to map for teaser
-    //density = .70;
-    
-    setXYRandomSeed( 9877 );
-    
-    if( getXYRandom( inX, inY ) < density ) {
 
 
+// copy map settings into terrainGen
+// call again whenever they change (like when map is reseeded)
+static void syncTerrainGenerator() {
+    terrainGen.biomeSeedA = biomeRandSeedA;
+    terrainGen.biomeSeedB = biomeRandSeedB;
 
+    terrainGen.numBiomes = numBiomes;
+    terrainGen.biomes = biomes;
+    terrainGen.biomeCumuWeights = biomeCumuWeights;
+    terrainGen.biomeTotalWeight = biomeTotalWeight;
 
-        // next step, pick top two biomes
-        int secondPlace;
-        double secondPlaceGap;
-        
-        int pickedBiome = getMapBiomeIndex( inX, inY, &secondPlace,
-                                            &secondPlaceGap );
-        
-        if( pickedBiome == -1 ) {
-            mapCacheInsert( inX, inY, 0 );
-            return 0;
-            }
-        
-        // only override if it's not already set
-        // if it's already set, then we're calling getBaseMap for neighboring
-        // map cells (wide, tall, moving objects, etc.)
-        // getBaseMap is always called for our cell in question first
-        // before examining neighboring cells if needed
-        if( lastCheckedBiome == -1 ) {    
-            lastCheckedBiome = biomes[pickedBiome];
-            lastCheckedBiomeX = inX;
-            lastCheckedBiomeY = inY;
-            }
-        
+    terrainGen.regularBiomeLimit = regularBiomeLimit;
+    terrainGen.numSpecialBiomes = numSpecialBiomes;
 
-        
-        // randomly let objects from second place biome peek through
-        
-        // if gap is 0, this should happen 50 percent of the time
+    terrainGen.specialBiomeBandMode = specialBiomeBandMode;
+    terrainGen.specialBiomeBandThickness = specialBiomeBandThickness;
+    terrainGen.specialBiomeBandIndexOrder = &specialBiomeBandIndexOrder;
+    terrainGen.specialBiomeBandYCenter = &specialBiomeBandYCenter;
+    terrainGen.specialBiomeBandDefaultIndex = specialBiomeBandDefaultIndex;
 
-        // if gap is 1.0, it should never happen
+    terrainGen.allowSecondPlaceBiomes = allowSecondPlaceBiomes;
 
-        // larger values make second place less likely
-        double secondPlaceReduction = 10.0;
+    terrainGen.gridPlacements = &gridPlacements;
 
-        //printf( "Second place gap = %f, random(%d,%d)=%f\n", secondPlaceGap,
-        //        inX, inY, getXYRandom( 2087 + inX, 793 + inY ) );
-        
-        setXYRandomSeed( 348763 );
-        
-        if( getXYRandom( inX, inY ) > 
-            .5 + secondPlaceReduction * secondPlaceGap ) {
-        
-            // note that lastCheckedBiome is NOT changed, so ground
-            // shows the true, first-place biome, but object placement
-            // follows the second place biome
-            pickedBiome = secondPlace;
-            }
-        
+    terrainGen.naturalMapIDs = naturalMapIDs;
+    terrainGen.naturalMapChances = naturalMapChances;
+    terrainGen.naturalMapMoving = naturalMapMoving;
+    terrainGen.totalChanceWeight = totalChanceWeight;
 
-        int numObjects = naturalMapIDs[pickedBiome].size();
+    terrainGen.edgeObjectID = edgeObjectID;
+    terrainGen.xLimit = xLimit;
+    terrainGen.yLimit = yLimit;
+    }
 
-        if( numObjects == 0  ) {
-            mapCacheInsert( inX, inY, 0 );
-            return 0;
-            }
 
-    
-  
-        // something present here
 
-        
-        // special object in this region is 10x more common than it 
-        // would be otherwise
+// fills biome and base map caches for a whole block at once, using
+// region terrain generation, which is much cheaper per cell than
+// getBaseMap calls one cell at a time
+//
+// blocks bigger than base map cache are clipped
+static void prefillBaseMapCaches( int inStartX, int inStartY,
+                                  int inWidth, int inHeight ) {
+    if( numBiomes == 0 ) {
+        return;
+        }
 
+    if( inWidth > BASE_MAP_CACHE_SIZE ) {
+        inWidth = BASE_MAP_CACHE_SIZE;
+        }
+    if( inHeight > BASE_MAP_CACHE_SIZE ) {
+        inHeight = BASE_MAP_CACHE_SIZE;
+        }
 
-        int specialObjectIndex = -1;
-        double maxValue = -DBL_MAX;
-        
+    int numCells = inWidth * inHeight;
 
-        for( int i=0; i<numObjects; i++ ) {
-            
-            setXYRandomSeed( 793 * i + 123 );
-        
-            double randVal = getXYFractal(  inX, 
-                                            inY, 
-                                            0.3, 
-                                            0.15 + 0.016666 * numObjects );
+    if( numCells <= 0 ) {
+        return;
+        }
 
-            if( randVal > maxValue ) {
-                maxValue = randVal;
-                specialObjectIndex = i;
+    int numCached = 0;
+
+    for( int y=0; y<inHeight; y++ ) {
+        for( int x=0; x<inWidth; x++ ) {
+            if( mapCacheLookup( inStartX + x, inStartY + y ) != -1 ) {
+                numCached++;
                 }
             }
+        }
 
+    if( numCached > numCells / 2 ) {
+        // mostly there already, like when player walks back and forth
+        // leave rest to getBaseMap
+        return;
+        }
 
 
-        float oldSpecialChance = 
-            naturalMapChances[pickedBiome].getElementDirect( 
-                specialObjectIndex );
-        
-        float newSpecialChance = oldSpecialChance * 10;
-        
-        *( naturalMapChances[pickedBiome].getElement( specialObjectIndex ) )
-            = newSpecialChance;
-        
-        float oldTotalChanceWeight = totalChanceWeight[pickedBiome];
-        
-        totalChanceWeight[pickedBiome] -= oldSpecialChance;
-        totalChanceWeight[pickedBiome] += newSpecialChance;
-        
+    int *biomeIndices = new int[ numCells ];
+    int *secondPlaces = new int[ numCells ];
+    double *secondPlaceGaps = new double[ numCells ];
 
-        // pick one of our natural objects at random
+    getTerrainBiomeRegion( &terrainGen, inStartX, inStartY,
+                           inWidth, inHeight,
+                           biomeIndices, secondPlaces, secondPlaceGaps );
 
-        // pick value between 0 and total weight
-        
-        setXYRandomSeed( 4593873 );
-        
-        double randValue = 
-            totalChanceWeight[pickedBiome] * getXYRandom( inX, inY );
+    for( int y=0; y<inHeight; y++ ) {
+        int cellY = inStartY + y;
 
-        // walk through objects, summing weights, until one crosses threshold
-        int i = 0;
-        float weightSum = 0;        
-        
-        while( weightSum < randValue && i < numObjects ) {
-            weightSum += naturalMapChances[pickedBiome].getElementDirect( i );
-            i++;
+        for( int x=0; x<inWidth; x++ ) {
+            int cellX = inStartX + x;
+            int c = y * inWidth + x;
+
+            biomePutCached( cellX, cellY, biomeIndices[c],
+                            secondPlaces[c], secondPlaceGaps[c] );
+
+            if( anyBiomesInDB &&
+                cellX >= minBiomeXLoc && cellX <= maxBiomeXLoc &&
+                cellY >= minBiomeYLoc && cellY <= maxBiomeYLoc ) {
+                // biome DB may override generated biome here
+                biomeIndices[c] = getMapBiomeIndex( cellX, cellY,
+                                                    &( secondPlaces[c] ),
+                                                    &( secondPlaceGaps[c] ) );
+                }
             }
-        
-        i--;
-        
+        }
 
-        // restore chance of special object
-        *( naturalMapChances[pickedBiome].getElement( specialObjectIndex ) )
-            = oldSpecialChance;
 
-        totalChanceWeight[pickedBiome] = oldTotalChanceWeight;
+    int *ids = new int[ numCells ];
+    char *gridFlags = new char[ numCells ];
 
-        if( i >= 0 ) {
-            int returnID = naturalMapIDs[pickedBiome].getElementDirect( i );
-            
-            if( pickedBiome == secondPlace ) {
-                // object peeking through from second place biome
+    getTerrainObjectRegion( &terrainGen, inStartX, inStartY,
+                            inWidth, inHeight,
+                            biomeIndices, secondPlaces, secondPlaceGaps,
+                            ids, gridFlags );
 
-                // make sure it's not a moving object (animal)
-                // those are locked to their target biome only
-                TransRecord *t = getPTrans( -1, returnID );
-                if( t != NULL && t->move != 0 ) {
-                    // put empty tile there instead
-                    returnID = 0;
-                    }
-                }
+    for( int y=0; y<inHeight; y++ ) {
+        for( int x=0; x<inWidth; x++ ) {
+            int c = y * inWidth + x;
 
-            mapCacheInsert( inX, inY, returnID );
-            return returnID;
-            }
-        else {
-            mapCacheInsert( inX, inY, 0 );
-            return 0;
+            if( mapCacheLookup( inStartX + x, inStartY + y ) == -1 ) {
+                mapCacheInsert( inStartX + x, inStartY + y,
+                                ids[c], gridFlags[c] );
+                getBaseMapCallCount ++;
+                }
             }
         }
-    else {
-        mapCacheInsert( inX, inY, 0 );
-        return 0;
-        }
-    
+
+    delete [] biomeIndices;
+    delete [] secondPlaces;
+    delete [] secondPlaceGaps;
+    delete [] ids;
+    delete [] gridFlags;
     }
 
 
@@ -2120,6 +1962,13 @@ static DBTimeCacheRecord dbTimeCache[ DB_CACHE_SIZE ];
 
 
 
+// floor and floor time DBs have no slots, so these are keyed on x,y alone
+// (slot and subCont left 0)
+static DBCacheRecord floorCache[ DB_CACHE_SIZE ];
+static DBTimeCacheRecord floorTimeCache[ DB_CACHE_SIZE ];
+
+
+
 typedef struct BlockingCacheRecord {
         int x, y;
         // -1 if not present
@@ -2130,6 +1979,16 @@ static BlockingCacheRecord blockingCache[ DB_CACHE_SIZE ];
 
 
 
+typedef struct HeatCacheRecord {
+        int x, y;
+        MapHeatCell cell;
+        char present;
+    } HeatCacheRecord;
+
+static HeatCacheRecord heatCache[ DB_CACHE_SIZE ];
+
+
+
 
 
 static void initDBCaches() {
@@ -2142,11 +2001,19 @@ static void initDBCaches() {
     for( int i=0; i<DB_CACHE_SIZE; i++ ) {
         dbTimeCache[i] = blankTimeRecord;
         }
+    for( int i=0; i<DB_CACHE_SIZE; i++ ) {
+        floorCache[i] = blankRecord;
+        floorTimeCache[i] = blankTimeRecord;
+        }
     // -1 for empty
     BlockingCacheRecord blankBlockingRecord = { 0, 0, -1 };
     for( int i=0; i<DB_CACHE_SIZE; i++ ) {
         blockingCache[i] = blankBlockingRecord;
         }
+    HeatCacheRecord blankHeatRecord = { 0, 0, { 0, 0, 0 }, false };
+    for( int i=0; i<DB_CACHE_SIZE; i++ ) {
+        heatCache[i] = blankHeatRecord;
+        }
     }
 
     
@@ -2201,7 +2068,51 @@ static void dbTimePutCached( int inX, int inY, int inSlot, int inSubCont,
                          timeSec_t inValue ) {
     DBTimeCacheRecord r = { inX, inY, inSlot, inSubCont, inValue };
     
-    dbTimeCache[ computeDBCacheHash( inX, inY, inSlot, inSubCont ) ] = r;
+    dbTimeCache[ computeDBCacheHash( inX, inY, inSlot, inSubCont ) ] = r;
+    }
+
+
+
+// returns -2 on miss
+static int dbFloorGetCached( int inX, int inY ) {
+    DBCacheRecord r = floorCache[ computeBLCacheHash( inX, inY ) ];
+
+    if( r.x == inX && r.y == inY && r.value != -2 ) {
+        return r.value;
+        }
+    else {
+        return -2;
+        }
+    }
+
+
+
+static void dbFloorPutCached( int inX, int inY, int inValue ) {
+    DBCacheRecord r = { inX, inY, 0, 0, inValue };
+    
+    floorCache[ computeBLCacheHash( inX, inY ) ] = r;
+    }
+
+
+
+// returns 1 on miss
+static timeSec_t dbFloorTimeGetCached( int inX, int inY ) {
+    DBTimeCacheRecord r = floorTimeCache[ computeBLCacheHash( inX, inY ) ];
+
+    if( r.x == inX && r.y == inY && r.timeVal != 1 ) {
+        return r.timeVal;
+        }
+    else {
+        return 1;
+        }
+    }
+
+
+
+static void dbFloorTimePutCached( int inX, int inY, timeSec_t inValue ) {
+    DBTimeCacheRecord r = { inX, inY, 0, 0, inValue };
+    
+    floorTimeCache[ computeBLCacheHash( inX, inY ) ] = r;
     }
 
 
@@ -2243,6 +2154,37 @@ static void blockingClearCached( int inX, int inY ) {
 
 
 
+char getMapHeatCellCached( int inX, int inY, MapHeatCell *outCell ) {
+    HeatCacheRecord *r = &( heatCache[ computeBLCacheHash( inX, inY ) ] );
+
+    if( r->x == inX && r->y == inY && r->present ) {
+        *outCell = r->cell;
+        return true;
+        }
+    return false;
+    }
+
+
+
+void putMapHeatCellCached( int inX, int inY, MapHeatCell inCell ) {
+    HeatCacheRecord r = { inX, inY, inCell, true };
+    
+    heatCache[ computeBLCacheHash( inX, inY ) ] = r;
+    }
+
+
+
+static void heatClearCached( int inX, int inY ) {
+    
+    HeatCacheRecord *r = &( heatCache[ computeBLCacheHash( inX, inY ) ] );
+
+    if( r->x == inX && r->y == inY ) {
+        r->present = false;
+        }
+    }
+
+
+
 
 
 char lookTimeDBEmpty = false;
@@ -2501,6 +2443,8 @@ static char skipTrackingMapChanges = false;
 // returns num set after
 int cleanMap() {
     AppLog::info( "\nCleaning map of objects that have been removed..." );
+
+    flushMapWriteBatch();
     
     skipTrackingMapChanges = true;
     
@@ -3042,7 +2986,7 @@ static void setupMapChangeLogFile() {
     // always close file and start a new one when this is called
 
     if( mapChangeLogFile != NULL ) {
-        fclose( mapChangeLogFile );
+        logWriterClose( mapChangeLogFile );
         mapChangeLogFile = NULL;
         }
     
@@ -3064,13 +3008,19 @@ static void setupMapChangeLogFile() {
             
             delete f;
         
-            mapChangeLogFile = fopen( fullName, "a" );
+            // called mid-step when log rolls over, so open happens
+            // on log writer thread
+            mapChangeLogFile = logWriterOpen( fullName, "a" );
             delete [] fullName;
             }
         }
 
     mapChangeLogTimeStart = Time::getCurrentTime();
-    fprintf( mapChangeLogFile, "startTime: %.2f\n", mapChangeLogTimeStart );
+
+    if( mapChangeLogFile != NULL ) {
+        logWriterPrintf( mapChangeLogFile, "startTime: %.2f\n", 
+                         mapChangeLogTimeStart );
+        }
     }
 
 
@@ -3099,6 +3049,8 @@ void reseedMap( char inForceFresh ) {
             }
         }
     
+    syncTerrainGenerator();
+    
 
 
     if( !set ) {
@@ -3175,6 +3127,8 @@ void reseedMap( char inForceFresh ) {
 
         biomeRandSeedB = tempRandSourceB.getRandomInt();
         
+        syncTerrainGenerator();
+
         AppLog::infoF( "Generating fresh map rand seeds and saving to file: "
                        "%u %u\n", biomeRandSeedA, biomeRandSeedB );
 
@@ -3492,6 +3446,11 @@ char initMap() {
 
 
 
+    if( SettingsManager::getIntSetting( "recordLookTrace", 0 ) ) {
+        lookTraceFile = fopen( "lookTrace.txt", "a" );
+        }
+
+
     if( lookTimeDBFile.exists() &&
         SettingsManager::getIntSetting( "flushLookTimes", 0 ) ) {
         
@@ -3519,6 +3478,26 @@ char initMap() {
         }
 
     LINEARDB3_setMaxLoad( 0.80 );
+
+    // serve tile, time, biome, and floor lookups straight from
+    // memory-mapped DB files instead of a seek and read per lookup
+    LINEARDB3_setUseMmap( 
+        SettingsManager::getIntSetting( "useMappedDBFiles", 0 ) );
+
+    
+    // apply any batched writes that a crash kept from reaching the DBs
+    // before anything opens or cleans them
+    int numReplayed = replayDBWriteBatchLog( mapWriteBatchLogName );
+    
+    if( numReplayed == -1 ) {
+        AppLog::errorF( "Failed to replay map redo log %s", 
+                        mapWriteBatchLogName );
+        return false;
+        }
+    else if( numReplayed > 0 ) {
+        AppLog::infoF( "Replayed %d map DB writes from redo log %s",
+                       numReplayed, mapWriteBatchLogName );
+        }
     
     if( ! skipLookTimeCleanup ) {
         DB lookTimeDB_old;
@@ -4115,6 +4094,7 @@ char initMap() {
 
     naturalMapIDs = new SimpleVector<int>[ numBiomes ];
     naturalMapChances = new SimpleVector<float>[ numBiomes ];
+    naturalMapMoving = new SimpleVector<char>[ numBiomes ];
     totalChanceWeight = new float[ numBiomes ];
 
     for( int j=0; j<numBiomes; j++ ) {
@@ -4223,6 +4203,10 @@ char initMap() {
                     int bIndex = getBiomeIndex( b );
                     naturalMapIDs[bIndex].push_back( id );
                     naturalMapChances[bIndex].push_back( p );
+
+                    TransRecord *t = getPTrans( -1, id );
+                    naturalMapMoving[bIndex].push_back( t != NULL &&
+                                                        t->move != 0 );
                     
                     totalChanceWeight[bIndex] += p;
                     }
@@ -4236,6 +4220,8 @@ char initMap() {
             "Biome %d:  Found %d natural objects with total weight %f",
             biomes[j], naturalMapIDs[j].size(), totalChanceWeight[j] );
         }
+
+    syncTerrainGenerator();
     
     delete [] allObjects;
 
@@ -4415,6 +4401,24 @@ char initMap() {
     
     reseedMap( false );
         
+
+    if( SettingsManager::getIntSetting( "useMapWriteBatch", 0 ) ) {
+        dbBatchIndex = mapWriteBatch.addDB( &db, "map.db" );
+        timeDBBatchIndex = mapWriteBatch.addDB( &timeDB, "mapTime.db" );
+        floorDBBatchIndex = mapWriteBatch.addDB( &floorDB, "floor.db" );
+        floorTimeDBBatchIndex = 
+            mapWriteBatch.addDB( &floorTimeDB, "floorTime.db" );
+        lookTimeDBBatchIndex = 
+            mapWriteBatch.addDB( &lookTimeDB, "lookTime.db" );
+        
+        if( mapWriteBatch.openLog( mapWriteBatchLogName ) ) {
+            mapWriteBatchOn = true;
+            }
+        else {
+            mapWriteBatch.closeLog();
+            AppLog::error( "Falling back to unbatched map DB writes" );
+            }
+        }
     
 
     
@@ -4505,11 +4509,21 @@ static void rememberDummy( FILE *inFile, int inX, int inY,
 
 
 void freeMap( char inSkipCleanup ) {
+    if( mapWriteBatchOn ) {
+        mapWriteBatch.closeLog();
+        mapWriteBatchOn = false;
+        }
+    
     if( mapChangeLogFile != NULL ) {
-        fclose( mapChangeLogFile );
+        logWriterClose( mapChangeLogFile );
         mapChangeLogFile = NULL;
         }
     
+    if( lookTraceFile != NULL ) {
+        fclose( lookTraceFile );
+        lookTraceFile = NULL;
+        }
+    
     printf( "%d calls to getBaseMap\n", getBaseMapCallCount );
 
     skipTrackingMapChanges = true;
@@ -4765,6 +4779,7 @@ void freeMap( char inSkipCleanup ) {
     
     delete [] naturalMapIDs;
     delete [] naturalMapChances;
+    delete [] naturalMapMoving;
     delete [] totalChanceWeight;
 
     
@@ -4812,6 +4827,7 @@ void wipeMapFiles() {
     deleteFileByName( "meta.db" );
     
     deleteFileByName( "mapDummyRecall.txt" );
+    deleteFileByName( mapWriteBatchLogName );
     }
 
 
@@ -4836,7 +4852,7 @@ static int dbGet( int inX, int inY, int inSlot, int inSubCont = 0 ) {
     // look for changes to default in database
     intQuadToKey( inX, inY, inSlot, inSubCont, key );
     
-    int result = DB_get( &db, key, value );
+    int result = batchedDBGet( &db, dbBatchIndex, key, value );
     
     
     
@@ -4874,7 +4890,7 @@ static timeSec_t dbTimeGet( int inX, int inY, int inSlot, int inSubCont = 0 ) {
     // look for changes to default in database
     intQuadToKey( inX, inY, inSlot, inSubCont, key );
     
-    int result = DB_get( &timeDB, key, value );
+    int result = batchedDBGet( &timeDB, timeDBBatchIndex, key, value );
     
     timeSec_t timeVal;
     
@@ -4894,43 +4910,305 @@ static timeSec_t dbTimeGet( int inX, int inY, int inSlot, int inSubCont = 0 ) {
 
 
 static int dbFloorGet( int inX, int inY ) {
+    
+    int cachedVal = dbFloorGetCached( inX, inY );
+    if( cachedVal != -2 ) {
+        return cachedVal;
+        }
+    
     unsigned char key[9];
     unsigned char value[4];
 
     // look for changes to default in database
     intPairToKey( inX, inY, key );
     
-    int result = DB_get( &floorDB, key, value );
+    int result = batchedDBGet( &floorDB, floorDBBatchIndex, key, value );
+    
+    int returnVal;
     
     if( result == 0 ) {
         // found
-        int returnVal = valueToInt( value );
-        
-        return returnVal;
+        returnVal = valueToInt( value );
         }
     else {
-        return -1;
+        returnVal = -1;
         }
+    
+    dbFloorPutCached( inX, inY, returnVal );
+    
+    return returnVal;
     }
 
 
 
 // returns 0 if not found
 static timeSec_t dbFloorTimeGet( int inX, int inY ) {
+
+    timeSec_t cachedVal = dbFloorTimeGetCached( inX, inY );
+    if( cachedVal != 1 ) {
+        return cachedVal;
+        }
+    
     unsigned char key[8];
     unsigned char value[8];
 
     intPairToKey( inX, inY, key );
     
-    int result = DB_get( &floorTimeDB, key, value );
+    int result = batchedDBGet( &floorTimeDB, floorTimeDBBatchIndex, 
+                               key, value );
+    
+    timeSec_t timeVal;
     
     if( result == 0 ) {
         // found
-        return valueToTime( value );
+        timeVal = valueToTime( value );
         }
     else {
+        timeVal = 0;
+        }
+    
+    dbFloorTimePutCached( inX, inY, timeVal );
+    
+    return timeVal;
+    }
+
+
+
+enum prefetchDBKind {
+    PREFETCH_MAP,
+    PREFETCH_TIME,
+    PREFETCH_FLOOR,
+    PREFETCH_FLOOR_TIME
+    };
+
+
+typedef struct PrefetchKey {
+        int x, y, slot, subCont;
+    } PrefetchKey;
+
+
+
+// looks up all keys that aren't already cached with one sorted multi-get,
+// and caches the results the same way the single gets above do
+static void prefetchDBValues( prefetchDBKind inWhich,
+                              SimpleVector<PrefetchKey> *inKeys ) {
+    DB *whichDB;
+    int batchIndex;
+
+    switch( inWhich ) {
+        case PREFETCH_MAP:
+            whichDB = &db;
+            batchIndex = dbBatchIndex;
+            break;
+        case PREFETCH_TIME:
+            whichDB = &timeDB;
+            batchIndex = timeDBBatchIndex;
+            break;
+        case PREFETCH_FLOOR:
+            whichDB = &floorDB;
+            batchIndex = floorDBBatchIndex;
+            break;
+        default:
+            whichDB = &floorTimeDB;
+            batchIndex = floorTimeDBBatchIndex;
+            break;
+        }
+
+    SimpleVector<PrefetchKey> misses;
+
+    for( int i=0; i<inKeys->size(); i++ ) {
+        PrefetchKey k = inKeys->getElementDirect( i );
+
+        char cached;
+        switch( inWhich ) {
+            case PREFETCH_MAP:
+                cached =
+                    ( dbGetCached( k.x, k.y, k.slot, k.subCont ) != -2 );
+                break;
+            case PREFETCH_TIME:
+                cached =
+                    ( dbTimeGetCached( k.x, k.y, k.slot, k.subCont ) != 1 );
+                break;
+            case PREFETCH_FLOOR:
+                cached = ( dbFloorGetCached( k.x, k.y ) != -2 );
+                break;
+            default:
+                cached = ( dbFloorTimeGetCached( k.x, k.y ) != 1 );
+                break;
+            }
+
+        if( ! cached ) {
+            misses.push_back( k );
+            }
+        }
+
+    int numMisses = misses.size();
+
+    if( numMisses == 0 ) {
+        return;
+        }
+
+    unsigned int keySize = whichDB->keySize;
+    unsigned int valueSize = whichDB->valueSize;
+
+    unsigned char *keys = new unsigned char[ numMisses * keySize ];
+    unsigned char *values = new unsigned char[ numMisses * valueSize ];
+    char *results = new char[ numMisses ];
+
+    for( int i=0; i<numMisses; i++ ) {
+        PrefetchKey *k = misses.getElement( i );
+
+        if( inWhich == PREFETCH_MAP || inWhich == PREFETCH_TIME ) {
+            intQuadToKey( k->x, k->y, k->slot, k->subCont,
+                          &( keys[ i * keySize ] ) );
+            }
+        else {
+            intPairToKey( k->x, k->y, &( keys[ i * keySize ] ) );
+            }
+        }
+
+    if( batchedDBGetMany( whichDB, batchIndex, numMisses,
+                          keys, values, results ) != -1 ) {
+
+        for( int i=0; i<numMisses; i++ ) {
+            PrefetchKey *k = misses.getElement( i );
+            unsigned char *value = &( values[ i * valueSize ] );
+            char found = ( results[i] == 0 );
+
+            switch( inWhich ) {
+                case PREFETCH_MAP:
+                    dbPutCached( k->x, k->y, k->slot, k->subCont,
+                                 found ? valueToInt( value ) : -1 );
+                    break;
+                case PREFETCH_TIME:
+                    dbTimePutCached( k->x, k->y, k->slot, k->subCont,
+                                     found ? valueToTime( value ) : 0 );
+                    break;
+                case PREFETCH_FLOOR:
+                    dbFloorPutCached( k->x, k->y,
+                                      found ? valueToInt( value ) : -1 );
+                    break;
+                default:
+                    dbFloorTimePutCached( k->x, k->y,
+                                          found ? valueToTime( value ) : 0 );
+                    break;
+                }
+            }
+        }
+    // else leave cache alone, single gets will run into error later
+
+    delete [] keys;
+    delete [] values;
+    delete [] results;
+    }
+
+
+
+// number of contained items, from dbCache, 0 if none or not cached
+static int getNumContainedCached( int inX, int inY, int inSubCont ) {
+    int num = dbGetCached( inX, inY, NUM_CONT_SLOT, inSubCont );
+
+    if( num < 0 ) {
         return 0;
         }
+    return num;
+    }
+
+
+
+// warms the DB caches with everything that looking at these cells will
+// read (object, floor, their decay times, contained and sub-contained
+// items and their decay times), reading each DB in file order instead of
+// with scattered single gets
+static void prefetchMapCells( SimpleVector<GridPos> *inCells ) {
+    if( inCells->size() == 0 ) {
+        return;
+        }
+
+    SimpleVector<PrefetchKey> mapKeys;
+    SimpleVector<PrefetchKey> timeKeys;
+    SimpleVector<PrefetchKey> floorKeys;
+
+    for( int i=0; i<inCells->size(); i++ ) {
+        GridPos p = inCells->getElementDirect( i );
+
+        PrefetchKey objectKey = { p.x, p.y, 0, 0 };
+        PrefetchKey numContKey = { p.x, p.y, NUM_CONT_SLOT, 0 };
+        PrefetchKey decayKey = { p.x, p.y, DECAY_SLOT, 0 };
+
+        mapKeys.push_back( objectKey );
+        mapKeys.push_back( numContKey );
+        timeKeys.push_back( decayKey );
+        floorKeys.push_back( objectKey );
+        }
+
+    prefetchDBValues( PREFETCH_MAP, &mapKeys );
+    prefetchDBValues( PREFETCH_TIME, &timeKeys );
+    prefetchDBValues( PREFETCH_FLOOR, &floorKeys );
+    prefetchDBValues( PREFETCH_FLOOR_TIME, &floorKeys );
+
+
+    // container sizes known now, so we can fetch what's in them,
+    // a level at a time
+    for( int subLevel=0; subLevel<2; subLevel++ ) {
+        mapKeys.deleteAll();
+        timeKeys.deleteAll();
+
+        for( int i=0; i<inCells->size(); i++ ) {
+            GridPos p = inCells->getElementDirect( i );
+
+            int numCont = getNumContainedCached( p.x, p.y, 0 );
+
+            for( int c=0; c<numCont; c++ ) {
+
+                if( subLevel == 0 ) {
+                    PrefetchKey contKey =
+                        { p.x, p.y, FIRST_CONT_SLOT + c, 0 };
+                    PrefetchKey contDecayKey =
+                        { p.x, p.y, FIRST_CONT_SLOT + numCont + c, 0 };
+
+                    mapKeys.push_back( contKey );
+                    timeKeys.push_back( contDecayKey );
+
+                    // size of this slot's sub container, if any
+                    PrefetchKey numSubKey =
+                        { p.x, p.y, NUM_CONT_SLOT, c + 1 };
+                    mapKeys.push_back( numSubKey );
+                    continue;
+                    }
+
+                int numSub = getNumContainedCached( p.x, p.y, c + 1 );
+
+                for( int s=0; s<numSub; s++ ) {
+                    PrefetchKey subKey =
+                        { p.x, p.y, FIRST_CONT_SLOT + s, c + 1 };
+                    PrefetchKey subDecayKey =
+                        { p.x, p.y, FIRST_CONT_SLOT + numSub + s, c + 1 };
+
+                    mapKeys.push_back( subKey );
+                    timeKeys.push_back( subDecayKey );
+                    }
+                }
+            }
+
+        prefetchDBValues( PREFETCH_MAP, &mapKeys );
+        prefetchDBValues( PREFETCH_TIME, &timeKeys );
+        }
+    }
+
+
+
+void prefetchMapRegion( int inXStart, int inYStart, int inXEnd, int inYEnd ) {
+    SimpleVector<GridPos> cells;
+
+    for( int y=inYStart; y<=inYEnd; y++ ) {
+        for( int x=inXStart; x<=inXEnd; x++ ) {
+            GridPos p = { x, y };
+            cells.push_back( p );
+            }
+        }
+
+    prefetchMapCells( &cells );
     }
 
 
@@ -4942,7 +5220,8 @@ timeSec_t dbLookTimeGet( int inX, int inY ) {
 
     intPairToKey( inX/100, inY/100, key );
     
-    int result = DB_get( &lookTimeDB, key, value );
+    int result = batchedDBGet( &lookTimeDB, lookTimeDBBatchIndex, 
+                               key, value );
     
     if( result == 0 ) {
         // found
@@ -4963,6 +5242,7 @@ static void dbPut( int inX, int inY, int inSlot, int inValue,
         // object has changed
         // clear blocking cache
         blockingClearCached( inX, inY );
+        heatClearCached( inX, inY );
         }
     
 
@@ -5031,7 +5311,7 @@ static void dbPut( int inX, int inY, int inSlot, int inValue,
     intToValue( inValue, value );
             
     
-    DB_put( &db, key, value );
+    batchedDBPut( &db, dbBatchIndex, key, value );
 
     dbPutCached( inX, inY, inSlot, inSubCont, inValue );
     }
@@ -5052,7 +5332,7 @@ static void dbTimePut( int inX, int inY, int inSlot, timeSec_t inTime,
     timeToValue( inTime, value );
             
     
-    DB_put( &timeDB, key, value );
+    batchedDBPut( &timeDB, timeDBBatchIndex, key, value );
 
     dbTimePutCached( inX, inY, inSlot, inSubCont, inTime );
     }
@@ -5062,6 +5342,8 @@ static void dbTimePut( int inX, int inY, int inSlot, timeSec_t inTime,
 
 static void dbFloorPut( int inX, int inY, int inValue ) {
     
+    heatClearCached( inX, inY );
+    
 
     if( ! skipTrackingMapChanges ) {
         
@@ -5095,7 +5377,9 @@ static void dbFloorPut( int inX, int inY, int inValue ) {
     intToValue( inValue, value );
             
     
-    DB_put( &floorDB, key, value );
+    batchedDBPut( &floorDB, floorDBBatchIndex, key, value );
+    
+    dbFloorPutCached( inX, inY, inValue );
     }
 
 
@@ -5111,7 +5395,9 @@ static void dbFloorTimePut( int inX, int inY, timeSec_t inTime ) {
     timeToValue( inTime, value );
             
     
-    DB_put( &floorTimeDB, key, value );
+    batchedDBPut( &floorTimeDB, floorTimeDBBatchIndex, key, value );
+    
+    dbFloorTimePutCached( inX, inY, inTime );
     }
 
 
@@ -5127,7 +5413,7 @@ void dbLookTimePut( int inX, int inY, timeSec_t inTime ) {
     timeToValue( inTime, value );
             
     
-    DB_put( &lookTimeDB, key, value );
+    batchedDBPut( &lookTimeDB, lookTimeDBBatchIndex, key, value );
     }
 
 
@@ -6547,11 +6833,40 @@ int getMapObjectRaw( int inX, int inY ) {
 void lookAtRegion( int inXStart, int inYStart, int inXEnd, int inYEnd ) {
     timeSec_t currentTime = MAP_TIMESEC;
     
+    if( lookTraceFile != NULL ) {
+        fprintf( lookTraceFile, "L %.0f %d %d %d %d\n", currentTime,
+                 inXStart, inYStart, inXEnd, inYEnd );
+        }
+
+    // find spots we haven't looked at in a while first, and fetch
+    // everything we're going to read about them in one pass
+    SimpleVector<char> unlooked;
+    SimpleVector<GridPos> unlookedCells;
+    
+    for( int y=inYStart; y<=inYEnd; y++ ) {
+        for( int x=inXStart; x<=inXEnd; x++ ) {
+            char exists = lookTimeTracking.checkExists( x, y, currentTime );
+            
+            unlooked.push_back( ! exists );
+            
+            if( ! exists ) {
+                GridPos p = { x, y };
+                unlookedCells.push_back( p );
+                }
+            }
+        }
+    
+    prefetchMapCells( &unlookedCells );
+    
+    int cellIndex = 0;
+    
     for( int y=inYStart; y<=inYEnd; y++ ) {
         for( int x=inXStart; x<=inXEnd; x++ ) {
         
+            char unlookedCell = unlooked.getElementDirect( cellIndex );
+            cellIndex++;
             
-            if( ! lookTimeTracking.checkExists( x, y, currentTime ) ) {
+            if( unlookedCell ) {
                 
                 // we haven't looked at this spot in a while
                 
@@ -6703,6 +7018,18 @@ unsigned char *getChunkMessage( int inStartX, int inStartY,
                                 GridPos inRelativeToPos,
                                 int *outMessageLength ) {
     
+    return encodeChunkSnapshot( getChunkSnapshot( inStartX, inStartY,
+                                                  inWidth, inHeight,
+                                                  inRelativeToPos ),
+                                outMessageLength );
+    }
+
+
+
+MapChunkSnapshot *getChunkSnapshot( int inStartX, int inStartY, 
+                                    int inWidth, int inHeight,
+                                    GridPos inRelativeToPos ) {
+    
     int chunkCells = inWidth * inHeight;
     
     int *chunk = new int[chunkCells];
@@ -6743,6 +7070,17 @@ unsigned char *getChunkMessage( int inStartX, int inStartY,
     dbLookTimePut( endX, inStartY, curTime );
     dbLookTimePut( endX, endY, curTime );
     
+
+    // generate whole chunk's base map in one pass
+    // include margin where wide objects can reach in from
+    int prefillMargin = getMaxWideRadius();
+    
+    prefillBaseMapCaches( inStartX - prefillMargin, inStartY,
+                          inWidth + 2 * prefillMargin, inHeight );
+
+    // and read what's stored for it in file order
+    prefetchMapRegion( inStartX, inStartY, endX - 1, endY - 1 );
+    
     for( int y=inStartY; y<endY; y++ ) {
         int chunkY = y - inStartY;
         
@@ -6768,7 +7106,7 @@ unsigned char *getChunkMessage( int inStartX, int inStartY,
                 }
             chunkBiomes[ cI ] = lastCheckedBiome;
 
-            chunkFloors[cI] = getMapFloor( x, y );
+            chunkFloors[cI] = hideIDForClient( getMapFloor( x, y ) );
             
 
             int numContained;
@@ -6798,10 +7136,18 @@ unsigned char *getChunkMessage( int inStartX, int inStartY,
                                                           &numSubContained,
                                                           i + 1 );
                         if( subContained != NULL ) {
+                            for( int s=0; s<numSubContained; s++ ) {
+                                subContained[s] = 
+                                    hideIDForClient( subContained[s] );
+                                }
+                            
                             subContainedStackSizes[cI][i] = numSubContained;
                             subContainedStacks[cI][i] = subContained;
                             }
                         }
+
+                    containedStacks[cI][i] = 
+                        hideIDForClient( containedStacks[cI][i] );
                     }
                 }
             else {
@@ -6810,52 +7156,111 @@ unsigned char *getChunkMessage( int inStartX, int inStartY,
                 subContainedStackSizes[cI] = NULL;
                 subContainedStacks[cI] = NULL;
                 }
+
+            chunk[cI] = hideIDForClient( chunk[cI] );
             }
         
         }
 
 
+    MapChunkSnapshot *snapshot = new MapChunkSnapshot;
+    
+    snapshot->startX = inStartX;
+    snapshot->startY = inStartY;
+    snapshot->width = inWidth;
+    snapshot->height = inHeight;
+    snapshot->relativeToPos = inRelativeToPos;
+    
+    snapshot->objects = chunk;
+    snapshot->biomes = chunkBiomes;
+    snapshot->floors = chunkFloors;
+    
+    snapshot->containedStackSizes = containedStackSizes;
+    snapshot->containedStacks = containedStacks;
+    
+    snapshot->subContainedStackSizes = subContainedStackSizes;
+    snapshot->subContainedStacks = subContainedStacks;
+    
+    snapshot->binary = false;
+    snapshot->unchangedCells = NULL;
+    
+    return snapshot;
+    }
+
+
+
+unsigned char *encodeChunkSnapshot( MapChunkSnapshot *inSnapshot,
+                                    int *outMessageLength ) {
+    
+    int chunkCells = inSnapshot->width * inSnapshot->height;
+    
+    int *chunk = inSnapshot->objects;
+    int *chunkBiomes = inSnapshot->biomes;
+    int *chunkFloors = inSnapshot->floors;
+    
+    int *containedStackSizes = inSnapshot->containedStackSizes;
+    int **containedStacks = inSnapshot->containedStacks;
+
+    int **subContainedStackSizes = inSnapshot->subContainedStackSizes;
+    int ***subContainedStacks = inSnapshot->subContainedStacks;
+    
 
     SimpleVector<unsigned char> chunkDataBuffer;
 
-    for( int i=0; i<chunkCells; i++ ) {
+    if( inSnapshot->binary ) {
+        encodeBinaryMapChunk( chunkCells, inSnapshot->unchangedCells,
+                              chunkBiomes, chunkFloors, chunk,
+                              containedStackSizes, containedStacks,
+                              subContainedStackSizes, subContainedStacks,
+                              &chunkDataBuffer );
+        }
+    else {
+        // big enough for three ints with separators
+        char cell[40];
+
+        for( int i=0; i<chunkCells; i++ ) {
         
-        if( i > 0 ) {
-            chunkDataBuffer.appendArray( (unsigned char*)" ", 1 );
-            }
+            if( i > 0 ) {
+                chunkDataBuffer.appendArray( (unsigned char*)" ", 1 );
+                }
         
 
-        char *cell = autoSprintf( "%d:%d:%d", chunkBiomes[i],
-                                  hideIDForClient( chunkFloors[i] ), 
-                                  hideIDForClient( chunk[i] ) );
+            int cellLength = sprintf( cell, "%d:%d:%d", chunkBiomes[i],
+                                      chunkFloors[i], chunk[i] );
         
-        chunkDataBuffer.appendArray( (unsigned char*)cell, strlen(cell) );
-        delete [] cell;
+            chunkDataBuffer.appendArray( (unsigned char*)cell, cellLength );
 
-        if( containedStacks[i] != NULL ) {
-            for( int c=0; c<containedStackSizes[i]; c++ ) {
-                char *containedString = 
-                    autoSprintf( ",%d", 
-                                 hideIDForClient( containedStacks[i][c] ) );
+            if( containedStacks[i] != NULL ) {
+                for( int c=0; c<containedStackSizes[i]; c++ ) {
+                    cellLength = sprintf( cell, ",%d", 
+                                          containedStacks[i][c] );
         
-                chunkDataBuffer.appendArray( (unsigned char*)containedString, 
-                                             strlen( containedString ) );
-                delete [] containedString;
+                    chunkDataBuffer.appendArray( (unsigned char*)cell, 
+                                                 cellLength );
 
-                if( subContainedStacks[i][c] != NULL ) {
+                    if( subContainedStacks[i][c] != NULL ) {
                     
-                    for( int s=0; s<subContainedStackSizes[i][c]; s++ ) {
+                        for( int s=0; 
+                             s<subContainedStackSizes[i][c]; s++ ) {
                         
-                        char *subContainedString = 
-                            autoSprintf( ":%d", 
-                                         hideIDForClient( 
-                                             subContainedStacks[i][c][s] ) );
-        
-                        chunkDataBuffer.appendArray( 
-                            (unsigned char*)subContainedString, 
-                            strlen( subContainedString ) );
-                        delete [] subContainedString;
+                            cellLength = 
+                                sprintf( cell, ":%d", 
+                                         subContainedStacks[i][c][s] );
+        
+                            chunkDataBuffer.appendArray( 
+                                (unsigned char*)cell, cellLength );
+                            }
                         }
+                    }
+                }
+            }
+        }
+    
+
+    for( int i=0; i<chunkCells; i++ ) {
+        if( containedStacks[i] != NULL ) {
+            for( int c=0; c<containedStackSizes[i]; c++ ) {
+                if( subContainedStacks[i][c] != NULL ) {
                     delete [] subContainedStacks[i][c];
                     }
                 }
@@ -6888,13 +7293,28 @@ unsigned char *getChunkMessage( int inStartX, int inStartY,
 
 
 
-    char *header = autoSprintf( "MC\n%d %d %d %d\n%d %d\n#", 
-                                inWidth, inHeight,
-                                inStartX - inRelativeToPos.x, 
-                                inStartY - inRelativeToPos.y, 
+    if( inSnapshot->unchangedCells != NULL ) {
+        delete [] inSnapshot->unchangedCells;
+        }
+    
+    const char *messageType = "MC";
+    
+    if( inSnapshot->binary ) {
+        messageType = "MB";
+        }
+
+    char *header = autoSprintf( "%s\n%d %d %d %d\n%d %d\n#", 
+                                messageType,
+                                inSnapshot->width, inSnapshot->height,
+                                inSnapshot->startX - 
+                                inSnapshot->relativeToPos.x, 
+                                inSnapshot->startY - 
+                                inSnapshot->relativeToPos.y, 
                                 chunkDataBuffer.size(),
                                 compressedSize );
     
+    delete inSnapshot;
+    
     SimpleVector<unsigned char> buffer;
     buffer.appendArray( (unsigned char*)header, strlen( header ) );
     delete [] header;
@@ -7758,33 +8178,33 @@ static void logMapChange( int inX, int inY, int inID ) {
             }
 
         if( o != NULL && o->isUseDummy ) {
-            fprintf( mapChangeLogFile, 
-                     "%.2f %d %d %s%du%d %d\n",
-                     timeDelta,
-                     inX, inY,
-                     extraFlag,
-                     o->useDummyParent,
-                     o->thisUseDummyIndex,
-                     respPlayer );
+            logWriterPrintf( mapChangeLogFile, 
+                             "%.2f %d %d %s%du%d %d\n",
+                             timeDelta,
+                             inX, inY,
+                             extraFlag,
+                             o->useDummyParent,
+                             o->thisUseDummyIndex,
+                             respPlayer );
             }
         else if( o != NULL && o->isVariableDummy ) {
-            fprintf( mapChangeLogFile, 
-                     "%.2f %d %d %s%dv%d %d\n", 
-                     timeDelta,
-                     inX, inY,
-                     extraFlag,
-                     o->variableDummyParent,
-                     o->thisVariableDummyIndex,
-                     respPlayer );
+            logWriterPrintf( mapChangeLogFile, 
+                             "%.2f %d %d %s%dv%d %d\n", 
+                             timeDelta,
+                             inX, inY,
+                             extraFlag,
+                             o->variableDummyParent,
+                             o->thisVariableDummyIndex,
+                             respPlayer );
             }
         else {        
-            fprintf( mapChangeLogFile, 
-                     "%.2f %d %d %s%d %d\n", 
-                     timeDelta,
-                     inX, inY,
-                     extraFlag,
-                     inID,
-                     respPlayer );
+            logWriterPrintf( mapChangeLogFile, 
+                             "%.2f %d %d %s%d %d\n", 
+                             timeDelta,
+                             inX, inY,
+                             extraFlag,
+                             inID,
+                             respPlayer );
             }
         }
     }
@@ -8549,11 +8969,19 @@ static void cleanMaxContainedHashTable( int inX, int inY ) {
 void stepMap( SimpleVector<MapChangeRecord> *inMapChanges, 
               SimpleVector<ChangePosition> *inChangePosList ) {
     
+    // apply all DB writes made since last step in one sorted pass
+    flushMapWriteBatch();
+
     timeSec_t curTime = MAP_TIMESEC;
 
     
     lookTimeTracking.cleanStale( curTime - noLookCountAsStaleSeconds );
 
+    if( lookTraceFile != NULL ) {
+        fprintf( lookTraceFile, "C %.0f\n", 
+                 curTime - noLookCountAsStaleSeconds );
+        }
+
 
     while( liveDecayQueue.size() > 0 && 
            liveDecayQueue.checkMinPriority() <= curTime ) {
@@ -9999,6 +10427,9 @@ void stepMapLongTermCulling( int inNumCurrentPlayers ) {
         return;
         }
 
+    // iterators below only see what has reached the DB files
+    flushMapWriteBatch();
+
     
     if( !tileCullingIteratorSet ) {
         DB_Iterator_init( &db, &tileCullingIterator );
@@ -93,6 +93,50 @@ unsigned char *getChunkMessage( int inStartX, int inStartY,
                                 int *outMessageLength );
 
 
+
+// everything needed to build a chunk message, copied out of the map
+// with IDs already hidden for client
+typedef struct MapChunkSnapshot {
+        int startX, startY;
+        int width, height;
+        GridPos relativeToPos;
+        
+        int *objects;
+        int *biomes;
+        int *floors;
+        
+        int *containedStackSizes;
+        int **containedStacks;
+        
+        int **subContainedStackSizes;
+        int ***subContainedStacks;
+        
+        // false by default, true to encode as MB message
+        // (see binaryMapChunk.h)
+        char binary;
+        
+        // for binary, optional per-cell flags marking cells to leave out
+        // because client already has them
+        // NULL by default
+        unsigned char *unchangedCells;
+    } MapChunkSnapshot;
+
+
+// getChunkMessage split into two parts, so the second can run off the
+// main thread
+
+// reads map (and applies any pending decays), must be called from main thread
+MapChunkSnapshot *getChunkSnapshot( int inStartX, int inStartY, 
+                                    int inWidth, int inHeight,
+                                    GridPos inRelativeToPos );
+
+// formats and compresses a chunk message
+// touches nothing but inSnapshot, so safe to call from any thread
+// destroys inSnapshot
+unsigned char *encodeChunkSnapshot( MapChunkSnapshot *inSnapshot,
+                                    int *outMessageLength );
+
+
 // sets the player responsible for subsequent map changes
 // meant to track who set down an object
 // should be set to -1 (default) except for object set-down
@@ -182,6 +226,22 @@ int getMapFloor( int inX, int inY );
 
 void setMapFloor( int inX, int inY, int inID );
 
+
+
+// per-tile heat values, shared by everyone's heat map computations
+// cleared automatically whenever the tile's object or floor changes
+typedef struct MapHeatCell {
+        float heatOutput;
+        float rValue;
+        float rFloorValue;
+    } MapHeatCell;
+
+
+// returns true and fills outCell on a hit
+char getMapHeatCellCached( int inX, int inY, MapHeatCell *outCell );
+
+void putMapHeatCellCached( int inX, int inY, MapHeatCell inCell );
+
 void setFloorEtaDecay( int inX, int inY, timeSec_t inAbsoluteTimeInSeconds );
 
 timeSec_t getFloorEtaDecay( int inX, int inY );
@@ -221,6 +281,13 @@ int getNextDecayDelta();
 void lookAtRegion( int inXStart, int inYStart, int inXEnd, int inYEnd );
 
 
+// reads everything stored about a region (ends inclusive) into RAM caches
+// in one sorted pass through each DB, so that reading its cells one by one
+// afterward doesn't hit the disk in random order
+void prefetchMapRegion( int inXStart, int inYStart, 
+                        int inXEnd, int inYEnd );
+
+
 
 // any change lines resulting from step are appended to inMapChanges
 // any change positions are added to end of inChangePosList
@@ -0,0 +1,454 @@
+#include "mapChangeBroadcast.h"
+
+#include "minorGems/util/stringUtils.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+typedef struct EncodedMapChange {
+        int x, y;
+
+        char oldCoordsUsed;
+        int oldX, oldY;
+
+        // text of line after "x y ", up to old coords if they are used,
+        // or to end of line if not
+        char *middle;
+        int middleLength;
+
+        // text after old coords, including newline, NULL if not used
+        char *tail;
+        int tailLength;
+
+        int regionX, regionY;
+    } EncodedMapChange;
+
+
+static SimpleVector<EncodedMapChange> encodedChanges;
+
+static double regionSize = 1;
+
+
+
+typedef struct ChangeRegion {
+        int x, y;
+        // range in regionChangeIndices
+        int start;
+        int count;
+        char used;
+    } ChangeRegion;
+
+
+// open addressing, size is power of 2
+static ChangeRegion *regionTable = NULL;
+static int regionTableSize = 0;
+
+// change indices grouped by region, increasing within each region
+static int *regionChangeIndices = NULL;
+
+
+
+typedef struct SharedMapChangeMessage {
+        uint32_t hash;
+        int relativeToX, relativeToY;
+        SimpleVector<int> *indices;
+        unsigned char *message;
+        int length;
+    } SharedMapChangeMessage;
+
+
+static SimpleVector<SharedMapChangeMessage> sharedMessages;
+
+
+
+
+static int getRegionCoord( int inCoord ) {
+    return (int)floor( inCoord / regionSize );
+    }
+
+
+
+static uint32_t hashRegion( int inX, int inY ) {
+    uint32_t h = (uint32_t)inX * 2654435761U;
+    h ^= (uint32_t)inY * 2246822519U;
+    h ^= h >> 15;
+    return h;
+    }
+
+
+
+// returns record for region, or an unused slot where it would go
+static ChangeRegion *findRegion( int inX, int inY ) {
+    int mask = regionTableSize - 1;
+
+    int i = hashRegion( inX, inY ) & mask;
+
+    while( regionTable[i].used ) {
+        if( regionTable[i].x == inX && regionTable[i].y == inY ) {
+            break;
+            }
+        i = ( i + 1 ) & mask;
+        }
+
+    return &( regionTable[i] );
+    }
+
+
+
+
+void clearMapChangeBroadcast() {
+    for( int i=0; i<encodedChanges.size(); i++ ) {
+        EncodedMapChange *c = encodedChanges.getElement( i );
+
+        delete [] c->middle;
+        if( c->tail != NULL ) {
+            delete [] c->tail;
+            }
+        }
+    encodedChanges.deleteAll();
+
+    if( regionTable != NULL ) {
+        delete [] regionTable;
+        regionTable = NULL;
+        }
+    regionTableSize = 0;
+
+    if( regionChangeIndices != NULL ) {
+        delete [] regionChangeIndices;
+        regionChangeIndices = NULL;
+        }
+
+    for( int i=0; i<sharedMessages.size(); i++ ) {
+        SharedMapChangeMessage *m = sharedMessages.getElement( i );
+
+        delete m->indices;
+        delete [] m->message;
+        }
+    sharedMessages.deleteAll();
+    }
+
+
+
+void setMapChangeBroadcast( SimpleVector<MapChangeRecord> *inChanges,
+                            double inRegionSize ) {
+    clearMapChangeBroadcast();
+
+    regionSize = inRegionSize;
+    if( regionSize < 1 ) {
+        regionSize = 1;
+        }
+
+    int numChanges = inChanges->size();
+
+    if( numChanges == 0 ) {
+        return;
+        }
+
+
+    for( int i=0; i<numChanges; i++ ) {
+        MapChangeRecord *r = inChanges->getElement( i );
+
+        EncodedMapChange c;
+        c.x = r->absoluteX;
+        c.y = r->absoluteY;
+        c.oldCoordsUsed = r->oldCoordsUsed;
+        c.oldX = r->absoluteOldX;
+        c.oldY = r->absoluteOldY;
+
+        // format string always starts with "%d %d "
+        // followed by "%d %d" for old coords, if used
+        // (see getMapChangeRecord)
+        const char *middleStart = &( r->formatString[6] );
+
+        const char *tailStart = NULL;
+
+        if( c.oldCoordsUsed ) {
+            tailStart = strstr( middleStart, "%d %d" );
+            }
+
+        if( tailStart != NULL ) {
+            c.middleLength = tailStart - middleStart;
+
+            c.tail = stringDuplicate( &( tailStart[5] ) );
+            c.tailLength = strlen( c.tail );
+            }
+        else {
+            c.oldCoordsUsed = false;
+
+            c.middleLength = strlen( middleStart );
+
+            c.tail = NULL;
+            c.tailLength = 0;
+            }
+
+        c.middle = new char[ c.middleLength + 1 ];
+        memcpy( c.middle, middleStart, c.middleLength );
+        c.middle[ c.middleLength ] = '\0';
+
+        c.regionX = getRegionCoord( c.x );
+        c.regionY = getRegionCoord( c.y );
+
+        encodedChanges.push_back( c );
+        }
+
+
+    // table at most half full
+    regionTableSize = 16;
+    while( regionTableSize < numChanges * 2 ) {
+        regionTableSize *= 2;
+        }
+
+    regionTable = new ChangeRegion[ regionTableSize ];
+    memset( regionTable, 0, regionTableSize * sizeof( ChangeRegion ) );
+
+
+    // count changes in each region
+    for( int i=0; i<numChanges; i++ ) {
+        EncodedMapChange *c = encodedChanges.getElement( i );
+
+        ChangeRegion *region = findRegion( c->regionX, c->regionY );
+
+        if( ! region->used ) {
+            region->used = true;
+            region->x = c->regionX;
+            region->y = c->regionY;
+            region->count = 0;
+            }
+        region->count ++;
+        }
+
+    int nextStart = 0;
+    for( int i=0; i<regionTableSize; i++ ) {
+        if( regionTable[i].used ) {
+            regionTable[i].start = nextStart;
+            nextStart += regionTable[i].count;
+            // count again while filling
+            regionTable[i].count = 0;
+            }
+        }
+
+
+    // fill in change order, so indices increase within each region
+    regionChangeIndices = new int[ numChanges ];
+
+    for( int i=0; i<numChanges; i++ ) {
+        EncodedMapChange *c = encodedChanges.getElement( i );
+
+        ChangeRegion *region = findRegion( c->regionX, c->regionY );
+
+        regionChangeIndices[ region->start + region->count ] = i;
+        region->count ++;
+        }
+    }
+
+
+
+// from server.cpp
+extern double intDist( int inXA, int inYA, int inXB, int inYB );
+
+
+
+static int compareInts( const void *inA, const void *inB ) {
+    int a = *( (int*)inA );
+    int b = *( (int*)inB );
+
+    if( a < b ) {
+        return -1;
+        }
+    if( a > b ) {
+        return 1;
+        }
+    return 0;
+    }
+
+
+
+void getNearbyMapChanges( int inX, int inY, double inMaxDist,
+                          SimpleVector<int> *outIndices ) {
+    if( encodedChanges.size() == 0 ) {
+        return;
+        }
+
+    int startSize = outIndices->size();
+
+    int minRX = (int)floor( ( inX - inMaxDist ) / regionSize );
+    int maxRX = (int)floor( ( inX + inMaxDist ) / regionSize );
+    int minRY = (int)floor( ( inY - inMaxDist ) / regionSize );
+    int maxRY = (int)floor( ( inY + inMaxDist ) / regionSize );
+
+    int numRegionsFound = 0;
+
+    for( int ry=minRY; ry<=maxRY; ry++ ) {
+        for( int rx=minRX; rx<=maxRX; rx++ ) {
+            ChangeRegion *region = findRegion( rx, ry );
+
+            if( ! region->used ) {
+                continue;
+                }
+
+            numRegionsFound ++;
+
+            for( int i=0; i<region->count; i++ ) {
+                int index = regionChangeIndices[ region->start + i ];
+
+                EncodedMapChange *c = encodedChanges.getElement( index );
+
+                if( intDist( c->x, c->y, inX, inY ) <= inMaxDist ) {
+                    outIndices->push_back( index );
+                    }
+                }
+            }
+        }
+
+    int numFound = outIndices->size() - startSize;
+
+    if( numRegionsFound > 1 && numFound > 1 ) {
+        // merge regions back into original change order, which matters
+        // when the same spot changed more than once this step
+        qsort( outIndices->getElement( startSize ), numFound,
+               sizeof( int ), compareInts );
+        }
+    }
+
+
+
+static void appendInt( SimpleVector<char> *inBuffer, int inValue ) {
+    char digits[12];
+    int numDigits = 0;
+
+    // work with negative values, so int min doesn't overflow
+    int v = inValue;
+    if( v > 0 ) {
+        v = -v;
+        }
+
+    do {
+        digits[ numDigits++ ] = (char)( '0' - v % 10 );
+        v /= 10;
+        } while( v != 0 );
+
+    if( inValue < 0 ) {
+        inBuffer->push_back( '-' );
+        }
+
+    while( numDigits > 0 ) {
+        inBuffer->push_back( digits[ --numDigits ] );
+        }
+    }
+
+
+
+char *getMapChangeMessageText( SimpleVector<int> *inIndices,
+                               int inRelativeToX, int inRelativeToY ) {
+    SimpleVector<char> text;
+
+    text.appendElementString( "MX\n" );
+
+    for( int i=0; i<inIndices->size(); i++ ) {
+        EncodedMapChange *c =
+            encodedChanges.getElement( inIndices->getElementDirect( i ) );
+
+        appendInt( &text, c->x - inRelativeToX );
+        text.push_back( ' ' );
+        appendInt( &text, c->y - inRelativeToY );
+        text.push_back( ' ' );
+
+        text.appendArray( c->middle, c->middleLength );
+
+        if( c->oldCoordsUsed ) {
+            appendInt( &text, c->oldX - inRelativeToX );
+            text.push_back( ' ' );
+            appendInt( &text, c->oldY - inRelativeToY );
+
+            text.appendArray( c->tail, c->tailLength );
+            }
+        }
+
+    text.push_back( '#' );
+
+    return text.getElementString();
+    }
+
+
+
+static uint32_t hashMessageKey( SimpleVector<int> *inIndices,
+                                int inRelativeToX, int inRelativeToY ) {
+    // FNV-1a over values
+    uint32_t h = 2166136261U;
+
+    h = ( h ^ (uint32_t)inRelativeToX ) * 16777619U;
+    h = ( h ^ (uint32_t)inRelativeToY ) * 16777619U;
+
+    for( int i=0; i<inIndices->size(); i++ ) {
+        h = ( h ^ (uint32_t)inIndices->getElementDirect( i ) ) * 16777619U;
+        }
+
+    return h;
+    }
+
+
+
+static char sameIndices( SimpleVector<int> *inA, SimpleVector<int> *inB ) {
+    if( inA->size() != inB->size() ) {
+        return false;
+        }
+
+    for( int i=0; i<inA->size(); i++ ) {
+        if( inA->getElementDirect( i ) != inB->getElementDirect( i ) ) {
+            return false;
+            }
+        }
+
+    return true;
+    }
+
+
+
+unsigned char *getSharedMapChangeMessage( SimpleVector<int> *inIndices,
+                                          int inRelativeToX,
+                                          int inRelativeToY,
+                                          int *outLength ) {
+    uint32_t hash = hashMessageKey( inIndices, inRelativeToX, inRelativeToY );
+
+    for( int i=0; i<sharedMessages.size(); i++ ) {
+        SharedMapChangeMessage *m = sharedMessages.getElement( i );
+
+        if( m->hash == hash &&
+            m->relativeToX == inRelativeToX &&
+            m->relativeToY == inRelativeToY &&
+            sameIndices( m->indices, inIndices ) ) {
+
+            *outLength = m->length;
+            return m->message;
+            }
+        }
+
+    return NULL;
+    }
+
+
+
+void addSharedMapChangeMessage( SimpleVector<int> *inIndices,
+                                int inRelativeToX, int inRelativeToY,
+                                unsigned char *inMessage, int inLength ) {
+    SharedMapChangeMessage m;
+
+    m.hash = hashMessageKey( inIndices, inRelativeToX, inRelativeToY );
+    m.relativeToX = inRelativeToX;
+    m.relativeToY = inRelativeToY;
+
+    m.indices = new SimpleVector<int>();
+
+    for( int i=0; i<inIndices->size(); i++ ) {
+        m.indices->push_back( inIndices->getElementDirect( i ) );
+        }
+
+    m.message = inMessage;
+    m.length = inLength;
+
+    sharedMessages.push_back( m );
+    }
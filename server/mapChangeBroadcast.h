@@ -0,0 +1,65 @@
+#ifndef MAP_CHANGE_BROADCAST_H_INCLUDED
+#define MAP_CHANGE_BROADCAST_H_INCLUDED
+
+
+#include "map.h"
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// Map changes from one server step, encoded once for all players.
+//
+// Each change is split into the fixed text of its MX line and the
+// coordinates, which are the only part that depends on the receiving
+// player's birth pos.  Changes are bucketed by region, so finding the
+// changes near a player only looks at nearby buckets.
+//
+// Players that get the same set of changes relative to the same birth pos
+// can share one finished (maybe compressed) message.
+//
+// Changes are referred to by their index in the list passed to
+// setMapChangeBroadcast.
+
+
+// encodes changes for this step, replacing any from last step
+// inRegionSize should be the distance that players will ask about
+void setMapChangeBroadcast( SimpleVector<MapChangeRecord> *inChanges,
+                            double inRegionSize );
+
+
+// drops changes and shared messages from this step
+void clearMapChangeBroadcast();
+
+
+// appends indices of changes no more than inMaxDist away from inX, inY,
+// in increasing order
+void getNearbyMapChanges( int inX, int inY, double inMaxDist,
+                          SimpleVector<int> *outIndices );
+
+
+// full MX message text for a list of changes, with coordinates relative
+// to inRelativeToX, inRelativeToY
+// result destroyed by caller
+char *getMapChangeMessageText( SimpleVector<int> *inIndices,
+                               int inRelativeToX, int inRelativeToY );
+
+
+
+// returns message already made for this list of changes and birth pos
+// during this step, or NULL
+// returned message is still owned by broadcast, and is destroyed at
+// next set or clear
+unsigned char *getSharedMapChangeMessage( SimpleVector<int> *inIndices,
+                                          int inRelativeToX,
+                                          int inRelativeToY,
+                                          int *outLength );
+
+
+// takes ownership of inMessage
+void addSharedMapChangeMessage( SimpleVector<int> *inIndices,
+                                int inRelativeToX, int inRelativeToY,
+                                unsigned char *inMessage, int inLength );
+
+
+#endif
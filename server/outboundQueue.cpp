@@ -0,0 +1,166 @@
+#include "outboundQueue.h"
+
+#include <string.h>
+
+
+
+// big enough for a typical frame's worth of messages
+// grows past this during map chunk bursts
+#define INITIAL_QUEUE_SIZE 16384
+
+
+OutboundQueueStats outboundQueueStats = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+
+
+OutboundQueue::OutboundQueue()
+        : mBuffer( NULL ),
+          mSize( 0 ),
+          mStart( 0 ),
+          mNumQueued( 0 ) {
+    }
+
+
+
+OutboundQueue::~OutboundQueue() {
+    if( mBuffer != NULL ) {
+        delete [] mBuffer;
+        }
+    }
+
+
+
+char OutboundQueue::add( unsigned char *inData, int inLength,
+                         int inMaxBytes ) {
+    if( inLength <= 0 ) {
+        return true;
+        }
+
+    if( mNumQueued + inLength > inMaxBytes ) {
+        return false;
+        }
+
+    if( mNumQueued + inLength > mSize ) {
+        int newSize = mSize;
+
+        if( newSize == 0 ) {
+            newSize = INITIAL_QUEUE_SIZE;
+            }
+        while( newSize < mNumQueued + inLength ) {
+            newSize *= 2;
+            }
+
+        unsigned char *newBuffer = new unsigned char[ newSize ];
+
+        // unwrap old contents to front of new buffer
+        int firstPart = mSize - mStart;
+        if( firstPart > mNumQueued ) {
+            firstPart = mNumQueued;
+            }
+        if( firstPart > 0 ) {
+            memcpy( newBuffer, &( mBuffer[ mStart ] ), firstPart );
+            }
+        if( mNumQueued > firstPart ) {
+            memcpy( &( newBuffer[ firstPart ] ), mBuffer,
+                    mNumQueued - firstPart );
+            }
+
+        if( mBuffer != NULL ) {
+            delete [] mBuffer;
+            }
+        mBuffer = newBuffer;
+        mSize = newSize;
+        mStart = 0;
+        }
+
+    int mask = mSize - 1;
+    int end = ( mStart + mNumQueued ) & mask;
+
+    int firstPart = mSize - end;
+    if( firstPart > inLength ) {
+        firstPart = inLength;
+        }
+
+    memcpy( &( mBuffer[ end ] ), inData, firstPart );
+
+    if( inLength > firstPart ) {
+        // wrap around
+        memcpy( mBuffer, &( inData[ firstPart ] ), inLength - firstPart );
+        }
+
+    mNumQueued += inLength;
+
+    outboundQueueStats.bytesQueued += inLength;
+
+    if( mNumQueued > outboundQueueStats.maxQueued ) {
+        outboundQueueStats.maxQueued = mNumQueued;
+        }
+
+    return true;
+    }
+
+
+
+int OutboundQueue::flush( Socket *inSock ) {
+    if( mNumQueued == 0 ) {
+        return 0;
+        }
+
+    unsigned char *parts[2];
+    int partLengths[2];
+    int numParts = 1;
+
+    parts[0] = &( mBuffer[ mStart ] );
+    partLengths[0] = mSize - mStart;
+
+    if( partLengths[0] >= mNumQueued ) {
+        partLengths[0] = mNumQueued;
+        }
+    else {
+        // wrapped around
+        parts[1] = mBuffer;
+        partLengths[1] = mNumQueued - partLengths[0];
+        numParts = 2;
+        }
+
+    int numSent = inSock->sendMulti( parts, partLengths, numParts );
+
+    outboundQueueStats.numFlushes++;
+
+    if( numSent == -2 ) {
+        // full, nothing went through
+        numSent = 0;
+        }
+
+    if( numSent < 0 ) {
+        return -1;
+        }
+
+    mStart = ( mStart + numSent ) & ( mSize - 1 );
+    mNumQueued -= numSent;
+
+    outboundQueueStats.bytesSent += numSent;
+
+    if( mNumQueued > 0 ) {
+        outboundQueueStats.numPartialFlushes++;
+        }
+    else {
+        mStart = 0;
+
+        if( mSize > INITIAL_QUEUE_SIZE ) {
+            // done with burst, don't hang on to big buffer
+            delete [] mBuffer;
+            mBuffer = NULL;
+            mSize = 0;
+            }
+        }
+
+    return numSent;
+    }
+
+
+
+void OutboundQueue::clear() {
+    mStart = 0;
+    mNumQueued = 0;
+    }
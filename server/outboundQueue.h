@@ -0,0 +1,83 @@
+#ifndef OUTBOUND_QUEUE_H_INCLUDED
+#define OUTBOUND_QUEUE_H_INCLUDED
+
+
+#include "minorGems/network/Socket.h"
+
+
+
+// Ring buffer of bytes waiting to be sent on one client socket.
+//
+// Messages are copied in as they are generated during a server step, and
+// then everything that is waiting goes out in a single non-blocking gather
+// write.  Bytes that the kernel won't take yet stay queued for the next
+// flush, instead of the send failing.
+class OutboundQueue {
+    public:
+
+        OutboundQueue();
+
+        ~OutboundQueue();
+
+
+        // copies bytes onto end of queue
+        // returns false, and queues nothing, if that would put more than
+        // inMaxBytes in the queue
+        char add( unsigned char *inData, int inLength, int inMaxBytes );
+
+
+        // sends as many queued bytes as the socket will take without
+        // blocking
+        // returns number of bytes sent (0 if socket is full), or -1 on
+        // a socket error
+        int flush( Socket *inSock );
+
+
+        // drops all queued bytes
+        void clear();
+
+
+        int getNumQueued() {
+            return mNumQueued;
+            }
+
+
+    private:
+
+        unsigned char *mBuffer;
+
+        // always a power of 2
+        int mSize;
+
+        int mStart;
+        int mNumQueued;
+
+    };
+
+
+
+typedef struct OutboundQueueStats {
+        double bytesQueued;
+        double bytesSent;
+
+        // one for each gather write
+        int numFlushes;
+
+        // flushes that left bytes behind because socket was full
+        int numPartialFlushes;
+
+        // biggest queue seen on any socket
+        int maxQueued;
+
+        int numOverflowDisconnects;
+        int numStallDisconnects;
+
+        int numDeferredMapChunks;
+    } OutboundQueueStats;
+
+
+// running totals for all queues, reset by caller when reported
+extern OutboundQueueStats outboundQueueStats;
+
+
+#endif
@@ -0,0 +1,332 @@
+#include "playerGrid.h"
+
+#include <stdlib.h>
+
+
+
+// 16x16 tiles per grid cell
+#define CELL_SHIFT 4
+
+#define NUM_BUCKETS 4096
+
+// boxes spanning more cells than this in either direction go on
+// oversize list instead of into grid, so a long path can't fill up
+// hundreds of cells
+#define MAX_BOX_CELLS 8
+
+
+
+typedef struct PlayerGridBox {
+        char inGrid;
+        char oversize;
+        int minX, minY, maxX, maxY;
+    } PlayerGridBox;
+
+
+typedef struct PlayerGridEntry {
+        int cellX, cellY;
+        int index;
+    } PlayerGridEntry;
+
+
+
+static SimpleVector<PlayerGridEntry> *buckets = NULL;
+
+// indexed by player index
+static SimpleVector<PlayerGridBox> boxes;
+
+static SimpleVector<int> oversizeIndices;
+
+
+// last query that returned each index, to skip duplicates
+static SimpleVector<unsigned int> queryStamps;
+static unsigned int currentQueryStamp = 0;
+
+
+
+static int getBucket( int inCellX, int inCellY ) {
+    unsigned int h = (unsigned int)inCellX * 73856093U ^ 
+        (unsigned int)inCellY * 19349663U;
+    
+    return h % NUM_BUCKETS;
+    }
+
+
+
+static int toCell( int inTileCoord ) {
+    // arithmetic shift rounds toward negative infinity
+    return inTileCoord >> CELL_SHIFT;
+    }
+
+
+
+void initPlayerGrid() {
+    buckets = new SimpleVector<PlayerGridEntry>[ NUM_BUCKETS ];
+    }
+
+
+
+void freePlayerGrid() {
+    delete [] buckets;
+    buckets = NULL;
+    
+    boxes.deleteAll();
+    oversizeIndices.deleteAll();
+    queryStamps.deleteAll();
+    }
+
+
+
+void clearPlayerGrid() {
+    for( int b=0; b<NUM_BUCKETS; b++ ) {
+        buckets[b].deleteAll();
+        }
+    boxes.deleteAll();
+    oversizeIndices.deleteAll();
+    }
+
+
+
+void removePlayerGridBox( int inIndex ) {
+    if( inIndex >= boxes.size() ) {
+        return;
+        }
+    
+    PlayerGridBox *box = boxes.getElement( inIndex );
+    
+    if( ! box->inGrid ) {
+        return;
+        }
+    
+    if( box->oversize ) {
+        oversizeIndices.deleteElementEqualTo( inIndex );
+        }
+    else {
+        for( int cy = toCell( box->minY ); cy <= toCell( box->maxY ); cy++ ) {
+            for( int cx = toCell( box->minX ); cx <= toCell( box->maxX ); 
+                 cx++ ) {
+                
+                SimpleVector<PlayerGridEntry> *bucket = 
+                    &( buckets[ getBucket( cx, cy ) ] );
+                
+                for( int e=0; e<bucket->size(); e++ ) {
+                    PlayerGridEntry *entry = bucket->getElement( e );
+                    
+                    if( entry->index == inIndex &&
+                        entry->cellX == cx && entry->cellY == cy ) {
+                        bucket->deleteElement( e );
+                        break;
+                        }
+                    }
+                }
+            }
+        }
+    
+    box->inGrid = false;
+    }
+
+
+
+// changes index of box's entries in place
+static void renumberPlayerGridBox( int inOldIndex, int inNewIndex ) {
+    PlayerGridBox *box = boxes.getElement( inOldIndex );
+    
+    if( ! box->inGrid ) {
+        return;
+        }
+    
+    if( box->oversize ) {
+        for( int i=0; i<oversizeIndices.size(); i++ ) {
+            int *index = oversizeIndices.getElement( i );
+            
+            if( *index == inOldIndex ) {
+                *index = inNewIndex;
+                break;
+                }
+            }
+        return;
+        }
+    
+    for( int cy = toCell( box->minY ); cy <= toCell( box->maxY ); cy++ ) {
+        for( int cx = toCell( box->minX ); cx <= toCell( box->maxX ); cx++ ) {
+            
+            SimpleVector<PlayerGridEntry> *bucket = 
+                &( buckets[ getBucket( cx, cy ) ] );
+            
+            for( int e=0; e<bucket->size(); e++ ) {
+                PlayerGridEntry *entry = bucket->getElement( e );
+                
+                if( entry->index == inOldIndex &&
+                    entry->cellX == cx && entry->cellY == cy ) {
+                    entry->index = inNewIndex;
+                    break;
+                    }
+                }
+            }
+        }
+    }
+
+
+
+void deletePlayerGridIndex( int inIndex ) {
+    if( inIndex >= boxes.size() ) {
+        return;
+        }
+    
+    removePlayerGridBox( inIndex );
+    
+    // in increasing order, so a renumbered entry never matches a later
+    // old index
+    for( int i = inIndex + 1; i < boxes.size(); i++ ) {
+        renumberPlayerGridBox( i, i - 1 );
+        }
+    
+    boxes.deleteElement( inIndex );
+    
+    if( inIndex < queryStamps.size() ) {
+        queryStamps.deleteElement( inIndex );
+        }
+    }
+
+
+
+void setPlayerGridBox( int inIndex, 
+                       int inMinX, int inMinY, int inMaxX, int inMaxY ) {
+    
+    removePlayerGridBox( inIndex );
+    
+    while( boxes.size() <= inIndex ) {
+        PlayerGridBox empty = { false, false, 0, 0, 0, 0 };
+        boxes.push_back( empty );
+        }
+    
+    PlayerGridBox *box = boxes.getElement( inIndex );
+    
+    box->inGrid = true;
+    box->minX = inMinX;
+    box->minY = inMinY;
+    box->maxX = inMaxX;
+    box->maxY = inMaxY;
+    
+    int minCellX = toCell( inMinX );
+    int minCellY = toCell( inMinY );
+    int maxCellX = toCell( inMaxX );
+    int maxCellY = toCell( inMaxY );
+    
+    if( maxCellX - minCellX >= MAX_BOX_CELLS ||
+        maxCellY - minCellY >= MAX_BOX_CELLS ) {
+        box->oversize = true;
+        oversizeIndices.push_back( inIndex );
+        return;
+        }
+    
+    box->oversize = false;
+    
+    for( int cy = minCellY; cy <= maxCellY; cy++ ) {
+        for( int cx = minCellX; cx <= maxCellX; cx++ ) {
+            PlayerGridEntry entry = { cx, cy, inIndex };
+            
+            buckets[ getBucket( cx, cy ) ].push_back( entry );
+            }
+        }
+    }
+
+
+
+static void addIfTouching( int inIndex, 
+                           int inMinX, int inMinY, int inMaxX, int inMaxY,
+                           SimpleVector<int> *outIndices ) {
+    
+    while( queryStamps.size() <= inIndex ) {
+        queryStamps.push_back( 0 );
+        }
+    
+    unsigned int *stamp = queryStamps.getElement( inIndex );
+    
+    if( *stamp == currentQueryStamp ) {
+        // already found through another cell
+        return;
+        }
+    
+    PlayerGridBox *box = boxes.getElement( inIndex );
+    
+    if( box->maxX < inMinX || box->minX > inMaxX ||
+        box->maxY < inMinY || box->minY > inMaxY ) {
+        return;
+        }
+    
+    *stamp = currentQueryStamp;
+    outIndices->push_back( inIndex );
+    }
+
+
+
+static int compareInts( const void *inA, const void *inB ) {
+    return *( (int*)inA ) - *( (int*)inB );
+    }
+
+
+
+void getPlayerGridIndices( int inMinX, int inMinY, int inMaxX, int inMaxY,
+                           SimpleVector<int> *outIndices ) {
+    
+    currentQueryStamp++;
+    
+    if( currentQueryStamp == 0 ) {
+        // wrapped around, old stamps could collide
+        for( int i=0; i<queryStamps.size(); i++ ) {
+            *( queryStamps.getElement( i ) ) = 0;
+            }
+        currentQueryStamp = 1;
+        }
+    
+    int startSize = outIndices->size();
+    
+    int minCellX = toCell( inMinX );
+    int minCellY = toCell( inMinY );
+    int maxCellX = toCell( inMaxX );
+    int maxCellY = toCell( inMaxY );
+    
+    if( (long)( maxCellX - minCellX + 1 ) * ( maxCellY - minCellY + 1 ) >
+        NUM_BUCKETS ) {
+        // huge query, cheaper to check every box
+        for( int i=0; i<boxes.size(); i++ ) {
+            if( boxes.getElement( i )->inGrid ) {
+                addIfTouching( i, inMinX, inMinY, inMaxX, inMaxY, 
+                               outIndices );
+                }
+            }
+        }
+    else {
+        for( int cy = minCellY; cy <= maxCellY; cy++ ) {
+            for( int cx = minCellX; cx <= maxCellX; cx++ ) {
+                
+                SimpleVector<PlayerGridEntry> *bucket = 
+                    &( buckets[ getBucket( cx, cy ) ] );
+                
+                for( int e=0; e<bucket->size(); e++ ) {
+                    PlayerGridEntry *entry = bucket->getElement( e );
+                    
+                    if( entry->cellX == cx && entry->cellY == cy ) {
+                        addIfTouching( entry->index, 
+                                       inMinX, inMinY, inMaxX, inMaxY,
+                                       outIndices );
+                        }
+                    }
+                }
+            }
+        
+        for( int i=0; i<oversizeIndices.size(); i++ ) {
+            addIfTouching( oversizeIndices.getElementDirect( i ),
+                           inMinX, inMinY, inMaxX, inMaxY, outIndices );
+            }
+        }
+    
+    int numFound = outIndices->size() - startSize;
+    
+    if( numFound > 1 ) {
+        // sort in place, so callers see players in vector order
+        qsort( outIndices->getElement( startSize ), 
+               numFound, sizeof( int ), compareInts );
+        }
+    }
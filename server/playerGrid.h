@@ -0,0 +1,46 @@
+#ifndef PLAYER_GRID_H_INCLUDED
+#define PLAYER_GRID_H_INCLUDED
+
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// Uniform grid index of live player positions, so that position queries
+// don't need to scan every player.
+//
+// Players are referred to by their index in the server's players vector.
+// Each one has a bounding box covering every spot that they might be
+// found at until their position or path changes again (their whole path,
+// when moving).  Queries return every player whose box touches the query
+// rect, so callers must still check each player's exact position.
+
+
+void initPlayerGrid();
+
+void freePlayerGrid();
+
+
+// removes all players
+void clearPlayerGrid();
+
+
+// sets box for player at inIndex, replacing any old box
+void setPlayerGridBox( int inIndex, 
+                       int inMinX, int inMinY, int inMaxX, int inMaxY );
+
+void removePlayerGridBox( int inIndex );
+
+
+// removes player at inIndex, and shifts indices of players after them
+// down by one, to match deleting inIndex from players vector
+void deletePlayerGridIndex( int inIndex );
+
+
+// appends indices of players whose boxes touch rect, in increasing order,
+// with no duplicates
+void getPlayerGridIndices( int inMinX, int inMinY, int inMaxX, int inMaxY,
+                           SimpleVector<int> *outIndices );
+
+
+#endif
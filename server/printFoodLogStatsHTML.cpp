@@ -4,15 +4,21 @@
 #include "minorGems/io/file/File.h"
 #include "minorGems/util/stringUtils.h"
 
+#include "logArchive.h"
+
 
 void usage() {
     printf( "Usage:\n" );
     printf( "printFoodLogStatsHTML path_to_server_dir path_to_objects_dir "
-            "outHTMLFile\n\n" );
+            "outHTMLFile [num_threads]\n\n" );
     
     printf( "NOTE:  server dir can contain multiple foodLog dirs\n" );
     printf( "       (foodLog, foodLog_server2, etc.)\n\nd" );
 
+    printf( "NOTE:  if server dir contains a logArchive dir made by\n" );
+    printf( "       archiveLogs, that is read instead, using\n" );
+    printf( "       num_threads threads (default 4)\n\n" );
+
     
     printf( "Example:\n" );
     printf( "printFoodLogStatsHTML "
@@ -29,12 +35,17 @@ typedef struct FoodRec {
         int value;
     } FoodRec;
 
+
+typedef struct FoodRecLists {
+        SimpleVector<FoodRec> month;
+        SimpleVector<FoodRec> week;
+        SimpleVector<FoodRec> today;
+        SimpleVector<FoodRec> yesterday;
+        SimpleVector<FoodRec> hour;
+    } FoodRecLists;
+
     
-SimpleVector<FoodRec> monthRecords;
-SimpleVector<FoodRec> weekRecords;
-SimpleVector<FoodRec> todayRecords;
-SimpleVector<FoodRec> yesterdayRecords;
-SimpleVector<FoodRec> hourRecords;
+FoodRecLists allRecords;
 
 
 // to sort with largest value at the top
@@ -102,23 +113,25 @@ void addCountAndValue( SimpleVector<FoodRec> *inRecList, int inID,
 
 
 
-void processLogFile( File *inFile ) {
-    
-    char *path = inFile->getFullFileName();
+typedef struct FileAge {
+        char isThisWeek;
+        char isToday;
+        char isYesterday;
+        int currentHour;
+    } FileAge;
 
-    char isThisWeek = false;
-    char isToday = false;
-    char isYesterday = false;
-    char isThisHour = false;
-    
 
-    char *name = inFile->getFileName();
+
+// classifies log file by date in its name against current time
+FileAge getFileAge( const char *inFileName ) {
+    FileAge age = { false, false, false, 0 };
     
     int fileYear, fileMonth, fileDay;
 
     char monthName[100];
 
-    sscanf( name, "%d_%d%99[^_]_%d", &fileYear, &fileMonth, monthName, &fileDay );
+    sscanf( inFileName, "%d_%d%99[^_]_%d", 
+            &fileYear, &fileMonth, monthName, &fileDay );
     struct tm fileTimeStruct;
 
     time_t t = time( NULL );
@@ -158,20 +171,20 @@ void processLogFile( File *inFile ) {
     int currentDay = timeStruct->tm_mday;
     int currentMonth = timeStruct->tm_mon + 1;
     int currentYearDay = timeStruct->tm_yday;
-    int currentHour = timeStruct->tm_hour;
+    age.currentHour = timeStruct->tm_hour;
 
     if( currentYear == fileYear &&
         currentMonth == fileMonth &&
         currentDay == fileDay ) {
         
-        isToday = true;
+        age.isToday = true;
         }
 
 
     double secDiff = difftime( t, fileT );
     
     if( secDiff < 7 * 24 * 3600 ) {
-        isThisWeek = true;
+        age.isThisWeek = true;
         }
     
     
@@ -181,7 +194,7 @@ void processLogFile( File *inFile ) {
             fileMonth == 12 &&
             fileDay == 31 ) {
             
-            isYesterday = true;
+            age.isYesterday = true;
             }
         }
     else {
@@ -190,18 +203,58 @@ void processLogFile( File *inFile ) {
         if( currentDay > 1 &&
             currentYear == fileYear &&
             currentDay - 1 == fileDay ) {
-            isYesterday = true;
+            age.isYesterday = true;
             }
         // today is first day of month
         else if( currentDay == 1 &&
                  currentYear == fileYear &&
                  currentMonth - 1 == fileMonth &&
                  fileDay == numDaysInFileMonth ) {
-            isYesterday = true;
+            age.isYesterday = true;
+            }
+        }
+
+    return age;
+    }
+
+
+
+void addFoodRec( FoodRecLists *inLists, FileAge *inAge, char inIsThisHour,
+                 int inID, int inCount, int inValue ) {
+
+    addCountAndValue( &( inLists->month ), inID, inCount, inValue );
+
+    if( inAge->isThisWeek ) {
+        
+        addCountAndValue( &( inLists->week ), inID, inCount, inValue );
+        
+        if( inAge->isToday ) {
+            addCountAndValue( &( inLists->today ), inID, inCount, inValue );
+            if( inIsThisHour ) {
+                addCountAndValue( &( inLists->hour ), 
+                                  inID, inCount, inValue );
+                }
+            }
+        else if( inAge->isYesterday ) {
+            addCountAndValue( &( inLists->yesterday ), 
+                              inID, inCount, inValue );
             }
         }
+    }
+
+
+
+void processLogFile( File *inFile ) {
+    
+    char *path = inFile->getFullFileName();
+
+    char isThisHour = false;
     
 
+    char *name = inFile->getFileName();
+    
+    FileAge age = getFileAge( name );
+
     delete [] name;
     
 
@@ -228,9 +281,9 @@ void processLogFile( File *inFile ) {
                 }
             
             if( lastScannedHour != -1 && 
-                isToday &&
-                ( lastScannedHour == currentHour ||
-                  lastScannedHour == currentHour - 1 ) ) {
+                age.isToday &&
+                ( lastScannedHour == age.currentHour ||
+                  lastScannedHour == age.currentHour - 1 ) ) {
                 // if server running, this hour's data not recorded yet
                 isThisHour = true;
                 }
@@ -248,22 +301,8 @@ void processLogFile( File *inFile ) {
             
             if( numScanned == 6 ) {
 
-                addCountAndValue( &monthRecords, id, count, value );
-
-                if( isThisWeek ) {
-                    
-                    addCountAndValue( &weekRecords, id, count, value );
-                    
-                    if( isToday ) {
-                        addCountAndValue( &todayRecords, id, count, value );
-                        if( isThisHour ) {
-                            addCountAndValue( &hourRecords, id, count, value );
-                            }
-                        }
-                    else if( isYesterday ) {
-                        addCountAndValue( &yesterdayRecords, id, count, value );
-                        }
-                    }
+                addFoodRec( &allRecords, &age, isThisHour, 
+                            id, count, value );
 
                 scannedLine = true;
                 }
@@ -276,6 +315,108 @@ void processLogFile( File *inFile ) {
     }
 
 
+
+typedef struct FoodPartitionResult {
+        char *sourceFolder;
+        FoodRecLists recs;
+    } FoodPartitionResult;
+
+
+
+// runs on archive query worker threads
+void *processFoodPartition( LogArchivePartition *inPartition, 
+                            void *inUserData ) {
+    FoodPartitionResult *r = new FoodPartitionResult;
+    
+    r->sourceFolder = stringDuplicate( inPartition->sourceFolder );
+    
+    FileAge age = getFileAge( inPartition->sourceFile );
+
+    char isThisHour = false;
+    
+    for( int i=0; i<inPartition->numRows; i++ ) {
+        int hour = (int)getLogArchiveNumber( inPartition, FOOD_HOUR, i );
+        
+        if( age.isToday &&
+            ( hour == age.currentHour ||
+              hour == age.currentHour - 1 ) ) {
+            // if server running, this hour's data not recorded yet
+            isThisHour = true;
+            }
+        
+        addFoodRec( &( r->recs ), &age, isThisHour,
+                    (int)getLogArchiveNumber( inPartition, FOOD_ID, i ),
+                    (int)getLogArchiveNumber( inPartition, FOOD_COUNT, i ),
+                    (int)getLogArchiveNumber( inPartition, FOOD_VALUE, i ) );
+        }
+    
+    return r;
+    }
+
+
+
+void mergeRecList( SimpleVector<FoodRec> *inDest, 
+                   SimpleVector<FoodRec> *inSource ) {
+    for( int i=0; i<inSource->size(); i++ ) {
+        FoodRec *r = inSource->getElement( i );
+        addCountAndValue( inDest, r->id, r->count, r->value );
+        }
+    }
+
+
+
+void processFoodLogArchive( LogArchive *inArchive, int inNumThreads ) {
+    LogArchiveQuery q;
+    initLogArchiveQuery( &q, LOG_ARCHIVE_FOOD );
+    
+    q.columnMask = 
+        ( 1 << FOOD_HOUR ) | ( 1 << FOOD_ID ) | 
+        ( 1 << FOOD_COUNT ) | ( 1 << FOOD_VALUE );
+    q.processPartition = processFoodPartition;
+    
+    int numResults;
+    FoodPartitionResult **results = (FoodPartitionResult **)
+        runLogArchiveQuery( inArchive, &q, inNumThreads, &numResults );
+    
+    // results grouped by folder
+    // only use last 30 from each folder, like with text logs
+    // (empty log files aren't archived, so don't count here)
+    for( int i=0; i<numResults; i++ ) {
+        FoodPartitionResult *r = results[i];
+        
+        if( r == NULL ) {
+            printf( "Failed to read archive partition\n" );
+            continue;
+            }
+        
+        int numLaterInFolder = 0;
+        
+        for( int j=i+1; j<numResults; j++ ) {
+            if( results[j] != NULL ) {
+                if( strcmp( results[j]->sourceFolder, 
+                            r->sourceFolder ) != 0 ) {
+                    break;
+                    }
+                numLaterInFolder++;
+                }
+            }
+        
+        if( numLaterInFolder < 30 ) {
+            mergeRecList( &allRecords.month, &( r->recs.month ) );
+            mergeRecList( &allRecords.week, &( r->recs.week ) );
+            mergeRecList( &allRecords.today, &( r->recs.today ) );
+            mergeRecList( &allRecords.yesterday, &( r->recs.yesterday ) );
+            mergeRecList( &allRecords.hour, &( r->recs.hour ) );
+            }
+        
+        delete [] r->sourceFolder;
+        delete r;
+        }
+    delete [] results;
+    }
+
+
+
 void printTable( const char *inName, File *inObjectDir, FILE *inFile,
                  SimpleVector<FoodRec> *inRecList ) {
     
@@ -352,7 +493,7 @@ void processFoodLogFolder( File *inFolder ) {
 
 int main( int inNumArgs, char **inArgs ) {
 
-    if( inNumArgs != 4 ) {
+    if( inNumArgs != 4 && inNumArgs != 5 ) {
         usage();
         }
     
@@ -361,6 +502,12 @@ int main( int inNumArgs, char **inArgs ) {
     
     char *outPath = inArgs[3];
     
+    int numThreads = 4;
+    
+    if( inNumArgs == 5 ) {
+        sscanf( inArgs[4], "%d", &numThreads );
+        }
+    
     if( path[strlen(path) - 1] == '/' ) {
         path[strlen(path) - 1] = '\0';
         }
@@ -375,6 +522,21 @@ int main( int inNumArgs, char **inArgs ) {
     if( mainDir.exists() && mainDir.isDirectory() &&
         objDir.exists() && objDir.isDirectory() ) {
 
+        char *archivePath = autoSprintf( "%s/logArchive", path );
+        
+        LogArchive *archive = openLogArchive( archivePath );
+        
+        delete [] archivePath;
+        
+        if( archive != NULL ) {
+            printf( "Reading log archive\n" );
+            
+            processFoodLogArchive( archive, numThreads );
+            
+            closeLogArchive( archive );
+            }
+        else {
+        
         int numChildFiles;
         File **childFiles = mainDir.getChildFiles( &numChildFiles );
         
@@ -394,14 +556,14 @@ int main( int inNumArgs, char **inArgs ) {
             delete childFiles[i];
             }
         delete [] childFiles;
-
+            }
         
 
-        sortRecList( &monthRecords );
-        sortRecList( &weekRecords );
-        sortRecList( &todayRecords );
-        sortRecList( &yesterdayRecords );
-        sortRecList( &hourRecords );
+        sortRecList( &allRecords.month );
+        sortRecList( &allRecords.week );
+        sortRecList( &allRecords.today );
+        sortRecList( &allRecords.yesterday );
+        sortRecList( &allRecords.hour );
 
         FILE *outFile = fopen( outPath, "w" );
         
@@ -409,19 +571,19 @@ int main( int inNumArgs, char **inArgs ) {
         if( outFile != NULL ) {
             
             printTable( "Past Hour",
-                        &objDir, outFile, &hourRecords );
+                        &objDir, outFile, &allRecords.hour );
             
             printTable( "Today (so far)",
-                        &objDir, outFile, &todayRecords );
+                        &objDir, outFile, &allRecords.today );
             
             printTable( "Yesterday",
-                        &objDir, outFile, &yesterdayRecords );
+                        &objDir, outFile, &allRecords.yesterday );
             
             printTable( "Past week",
-                        &objDir, outFile, &weekRecords );
+                        &objDir, outFile, &allRecords.week );
 
             printTable( "Past month",
-                        &objDir, outFile, &monthRecords );
+                        &objDir, outFile, &allRecords.month );
         
             fclose( outFile );
             }
@@ -4,14 +4,21 @@
 #include "minorGems/io/file/File.h"
 #include "minorGems/util/stringUtils.h"
 
+#include "logArchive.h"
+
 
 void usage() {
     printf( "Usage:\n" );
-    printf( "printLifeLogPlayerData path_to_server_dir outDataFile\n\n" );
+    printf( "printLifeLogPlayerData path_to_server_dir outDataFile "
+            "[num_threads]\n\n" );
     
     printf( "NOTE:  server dir can contain multiple lifeLog dirs\n" );
     printf( "       (lifeLog, lifeLog_server2, etc.)\n\nd" );
 
+    printf( "NOTE:  if server dir contains a logArchive dir made by\n" );
+    printf( "       archiveLogs, that is read instead, using\n" );
+    printf( "       num_threads threads (default 4)\n\n" );
+
     printf( "Example:\n" );
     printf( "printLifeLogPlayerData "
             "~/checkout/OneLife/server data.txt\n\n" );
@@ -20,14 +27,10 @@ void usage() {
     }
 
 
-// used to keep track of hours passing
+// hours counted from here
 double startTime = 1262304000;
 double maxTime = startTime;
 
-int hoursPassed = 0;
-    
-SimpleVector<char *> uniqueEmails;
-
 
 typedef struct HourRecord {
         double time;
@@ -54,100 +57,99 @@ void addEmail( char *inEmail, SimpleVector<char*> *inUniqueEmails ) {
     }
 
 
-void addHourRecord( double inTime, SimpleVector<char*> *inUniqueEmails ) {
-    for( int i=0; i<hourRecords.size(); i++ ) {
-        if( hourRecords.getElementDirect( i ).time == inTime ) {        
-            HourRecord *r = hourRecords.getElement( i );
-            
-            for( int j=0; j<inUniqueEmails->size(); j++ ) {
-                addEmail( inUniqueEmails->getElementDirect( j ),
-                          &( r->uniqueEmails ) );
-                }
-            inUniqueEmails->deleteAll();
-            return;
+
+// finds or adds record for hour starting at inHourTime
+HourRecord *getHourRecord( SimpleVector<HourRecord> *inRecords, 
+                           double inHourTime ) {
+    for( int i=0; i<inRecords->size(); i++ ) {
+        if( inRecords->getElementDirect( i ).time == inHourTime ) {
+            return inRecords->getElement( i );
             }
         }
+    
     HourRecord r;
+    r.time = inHourTime;
+    r.uniquePlayers = 0;
+    
+    inRecords->push_back( r );
+    
+    return inRecords->getElement( inRecords->size() - 1 );
+    }
+
+
+
+// counts each birth in the hour it happened in, for both log text and
+// archive, so that they give the same report
+void addBirth( SimpleVector<HourRecord> *inRecords, 
+               double inTime, const char *inEmail ) {
     
-    hourRecords.push_back( r );
+    double hourTime = 
+        floor( ( inTime - startTime ) / 3600 ) * 3600 + startTime;
     
-    HourRecord *rPointer = hourRecords.getElement( hourRecords.size() - 1 );
+    HourRecord *r = getHourRecord( inRecords, hourTime );
+    
+    addEmail( stringToLowerCase( inEmail ), &( r->uniqueEmails ) );
+    }
+
+
+
+void addHourRecord( double inTime, SimpleVector<char*> *inUniqueEmails ) {
+    if( inTime > maxTime ) {
+        maxTime = inTime;
+        }
     
-    rPointer->time = inTime;
-    rPointer->uniqueEmails.push_back_other( inUniqueEmails );
+    HourRecord *r = getHourRecord( &hourRecords, inTime );
     
+    for( int j=0; j<inUniqueEmails->size(); j++ ) {
+        addEmail( inUniqueEmails->getElementDirect( j ),
+                  &( r->uniqueEmails ) );
+        }
     inUniqueEmails->deleteAll();
     }
 
 
 
 void processLogFile( File *inFile ) {
-    hoursPassed = 0;
-    
     char *path = inFile->getFullFileName();
 
     
     FILE *f = fopen( path, "r" );
     
     if( f != NULL ) {
-        char scannedLine = true;
         
-        while( scannedLine ) {
+        // same line parsing as archiveLogs, so that newer birth lines
+        // with fields after chain= are read too
+        char line[4096];
+        
+        while( fgets( line, sizeof( line ), f ) != NULL ) {
+            
+            if( line[0] != 'B' ) {
+                continue;
+                }
             
-            char event = 'X';
             double time = 0;
             int id = 0;
             char email[1000];
             char gender = 'F';
-            double age = 0;
             int locX, locY;
             char parent[1000];
-            char deathReason[1000];
-        
-            email[0] = '\0';
-            parent[0] = '\0';
-            deathReason[0] = '\0';        
-
             int pop = 0;
-            int parentChain = 1;
-        
-            fscanf( f, "%c ", &event );
-        
-        
-            if( event == 'B' ) {
-                fscanf( f, "%lf %d %999s %c (%d,%d) %999s pop=%d chain=%d\n",
+            
+            int numRead = 
+                sscanf( line, "B %lf %d %999s %c (%d,%d) %999s pop=%d",
                         &time, &id, email, &gender, 
-                        &locX, &locY, parent, &pop, &parentChain );
-                
-                if( time > maxTime ) {
-                    maxTime = time;
-                    }
-                
-                double deltaTime = time - startTime;
-                
-                char *lowerEmail = stringToLowerCase( email );
-                
-                
-                addEmail( lowerEmail, &uniqueEmails );
-
-                if( floor( deltaTime / 3600 ) > hoursPassed ) {
-                    hoursPassed = lrint( floor( deltaTime / 3600 ) );
-                    
-                    double hourTime = hoursPassed * 3600 + startTime;
-                    
-                    addHourRecord( hourTime, &uniqueEmails );
-                    }
-                }
-            else if( event == 'D' ) {
-                fscanf( f, "%lf %d %999s age=%lf %c (%d,%d) %999s pop=%d\n",
-                        &time, &id, email, &age, &gender, &locX, &locY, 
-                        deathReason, &pop );            
+                        &locX, &locY, parent, &pop );
+            
+            if( numRead < 8 ) {
+                continue;
                 }
-            else {
-                scannedLine = false;
+            
+            if( time > maxTime ) {
+                maxTime = time;
                 }
+            
+            addBirth( &hourRecords, time, email );
             }
-        
 
         fclose( f );
         }
@@ -157,6 +159,64 @@ void processLogFile( File *inFile ) {
 
 
 
+// births in one archive partition, grouped by hour
+void *hourRecordsFromPartition( LogArchivePartition *inPartition,
+                                void *inUnused ) {
+    SimpleVector<HourRecord> *records = new SimpleVector<HourRecord>();
+    
+    for( int i=0; i<inPartition->numRows; i++ ) {
+        
+        if( getLogArchiveNumber( inPartition, LIFE_EVENT, i ) != 'B' ) {
+            continue;
+            }
+        
+        addBirth( records, 
+                  getLogArchiveNumber( inPartition, LIFE_TIME, i ),
+                  getLogArchiveString( inPartition, LIFE_EMAIL, i ) );
+        }
+
+    return records;
+    }
+
+
+
+// returns num partitions processed
+int processLifeLogArchive( LogArchive *inArchive, int inNumThreads ) {
+    LogArchiveQuery q;
+    initLogArchiveQuery( &q, LOG_ARCHIVE_LIFE );
+    
+    q.columnMask = 
+        ( 1 << LIFE_TIME ) | ( 1 << LIFE_EVENT ) | ( 1 << LIFE_EMAIL );
+    q.processPartition = hourRecordsFromPartition;
+    
+    int numResults;
+    void **results = runLogArchiveQuery( inArchive, &q, inNumThreads,
+                                         &numResults );
+    
+    for( int i=0; i<numResults; i++ ) {
+        SimpleVector<HourRecord> *records = 
+            (SimpleVector<HourRecord> *)results[i];
+        
+        if( records == NULL ) {
+            printf( "Failed to read archive partition\n" );
+            continue;
+            }
+
+        for( int j=0; j<records->size(); j++ ) {
+            HourRecord *r = records->getElement( j );
+            
+            addHourRecord( r->time, &( r->uniqueEmails ) );
+            }
+        delete records;
+        }
+    delete [] results;
+    
+    return numResults;
+    }
+
+
+
+
 const char *checkpointFileName = "statsCheckpoint.txt";
 
 
@@ -197,7 +257,7 @@ int processLifeLogFolder( File *inFolder ) {
 
 int main( int inNumArgs, char **inArgs ) {
 
-    if( inNumArgs != 3 ) {
+    if( inNumArgs != 3 && inNumArgs != 4 ) {
         usage();
         }
     
@@ -205,13 +265,35 @@ int main( int inNumArgs, char **inArgs ) {
     
     char *outPath = inArgs[2];
     
+    int numThreads = 4;
+    
+    if( inNumArgs == 4 ) {
+        sscanf( inArgs[3], "%d", &numThreads );
+        }
+
     if( path[strlen(path) - 1] == '/' ) {
         path[strlen(path) - 1] = '\0';
         }
     
     File mainDir( NULL, path );
     
-    if( mainDir.exists() && mainDir.isDirectory() ) {
+    char *archivePath = autoSprintf( "%s/logArchive", path );
+    
+    LogArchive *archive = openLogArchive( archivePath );
+    
+    delete [] archivePath;
+    
+
+    if( archive != NULL ) {
+        printf( "Reading log archive\n" );
+        
+        int numFilesProcessed = processLifeLogArchive( archive, numThreads );
+        
+        closeLogArchive( archive );
+        
+        printf( "Processed %d files\n", numFilesProcessed );
+        }
+    else if( mainDir.exists() && mainDir.isDirectory() ) {
         
         
         int numFilesProcessed = 0;
@@ -241,44 +323,44 @@ int main( int inNumArgs, char **inArgs ) {
             
         
         printf( "Processed %d files\n", numFilesProcessed );
+        }
+    else {
+        usage();
+        }
 
-        FILE *outFile = fopen( outPath, "w" );
-        
 
-        if( outFile != NULL ) {
+    FILE *outFile = fopen( outPath, "w" );
+    
+
+    if( outFile != NULL ) {
 
-            int numRecords = hourRecords.size();
+        int numRecords = hourRecords.size();
+        
+        for( int j=0; j<numRecords; j++ ) {
             
-            for( int j=0; j<numRecords; j++ ) {
-                
-                int minI = -1;
-                double minTime = maxTime + 1;
+            int minI = -1;
+            double minTime = maxTime + 1;
+            
+            for( int i=0; i<hourRecords.size(); i++ ) {
+                HourRecord *r = hourRecords.getElement( i );
                 
-                for( int i=0; i<hourRecords.size(); i++ ) {
-                    HourRecord *r = hourRecords.getElement( i );
-                    
-                    if( r->time < minTime ) {
-                        minTime = r->time;
-                        minI = i;
-                        }
+                if( r->time < minTime ) {
+                    minTime = r->time;
+                    minI = i;
                     }
-                
-                HourRecord *r = hourRecords.getElement( minI );
+                }
+            
+            HourRecord *r = hourRecords.getElement( minI );
 
-                
+            
 
-                fprintf( outFile, "%.0f %d\n",
-                         r->time, r->uniqueEmails.size() );
-                r->uniqueEmails.deallocateStringElements();
+            fprintf( outFile, "%.0f %d\n",
+                     r->time, r->uniqueEmails.size() );
+            r->uniqueEmails.deallocateStringElements();
 
-                hourRecords.deleteElement( minI );
-                }
-            
-            fclose( outFile );
+            hourRecords.deleteElement( minI );
             }
+        
+        fclose( outFile );
         }
-    else {
-        usage();
-        }
-    
     }
@@ -4,6 +4,8 @@
 #include "minorGems/io/file/File.h"
 #include "minorGems/util/stringUtils.h"
 
+#include "logArchive.h"
+
 
 // enable this to generate MySQL to populate review database stats
 // disable this to dramatically improve performance
@@ -13,11 +15,16 @@ const char generateMySQL = false;
 
 void usage() {
     printf( "Usage:\n" );
-    printf( "printLifeLogStatsHTML path_to_server_dir outHTMLFile\n\n" );
+    printf( "printLifeLogStatsHTML path_to_server_dir outHTMLFile "
+            "[num_threads]\n\n" );
     
     printf( "NOTE:  server dir can contain multiple lifeLog dirs\n" );
     printf( "       (lifeLog, lifeLog_server2, etc.)\n\nd" );
 
+    printf( "NOTE:  if server dir contains a logArchive dir made by\n" );
+    printf( "       archiveLogs, that is read instead, using\n" );
+    printf( "       num_threads threads (default 4)\n\n" );
+
     printf( "Example:\n" );
     printf( "printLifeLogStatsHTML "
             "~/checkout/OneLife/server out.html\n\n" );
@@ -106,6 +113,94 @@ void addPlayerGame( char *inEmail,
 
 
 
+// inParentID only used for old-style lines with no chain length
+void addBirth( double inTime, int inID, const char *inEmail,
+               char inNoParent, int inParentID, int inParentChain ) {
+    Living l;
+    l.id = inID;
+
+    l.birthAge = 0;
+    l.parentChainLength = inParentChain;
+
+    l.birthTime = inTime;
+    l.email = stringToLowerCase( inEmail );
+
+    if( inNoParent ) {
+        l.birthAge = 14;
+        }
+    else if( l.parentChainLength == 1 ) {
+        // parent chain length not recorded in log
+        // (old-style record)
+        
+        // try recomputing it from scratch
+        for( int i=0; i<currentLiving.size(); i++ ) {
+            Living lp = currentLiving.getElementDirect( i );
+        
+            if( lp.id == inParentID ) {
+                l.parentChainLength = lp.parentChainLength + 1;
+                break;
+                }
+            }
+        }
+    currentLiving.push_back( l );
+    totalLives ++;
+    folderTotalLives ++;
+    
+    if( l.parentChainLength > longestFamilyChain ) {
+        longestFamilyChain = l.parentChainLength;
+        }
+    if( l.parentChainLength > folderLongestFamilyChain ) {
+        folderLongestFamilyChain = l.parentChainLength;
+        }
+    }
+
+
+
+void addDeath( double inTime, int inID, const char *inEmail, double inAge ) {
+    double yearsLived = inAge;
+    
+    char *lowerEmail = stringToLowerCase( inEmail );
+
+    // walk backwards, finding most recent birth that matches
+    // thus, we don't consider orphaned births (from server crashes)
+    // by accident
+    char foundBirth = false;
+    for( int i=currentLiving.size() - 1; i>=0; i-- ) {
+        Living l = currentLiving.getElementDirect( i );
+        
+        if( l.id == inID && strcmp( l.email, lowerEmail ) == 0 ) {
+            yearsLived -= l.birthAge;
+            
+            if( generateMySQL ) {
+                addPlayerGame( l.email, l.birthTime, inTime );
+                }
+            delete [] l.email;
+            currentLiving.deleteElement( i );
+            foundBirth = true;
+            break;
+            }
+        }
+
+    if( foundBirth ) {    
+        totalAge += yearsLived;
+        folderTotalAge += yearsLived;
+        
+        if( inAge >= 55 ) {
+            over55Count++;
+            folderOver55Count++;
+            }
+        }
+    else {
+        printf( "Orphaned death that had no matching birth:  "
+                "%.0f %d %s\n",
+                inTime, inID, lowerEmail );
+        }
+
+    delete [] lowerEmail;
+    }
+
+
+
 void processLogFile( File *inFile ) {
     
     char *path = inFile->getFullFileName();
@@ -154,92 +249,20 @@ void processLogFile( File *inFile ) {
                         &locX, &locY, parent, &pop, &parentChain, &race,
                         &status );
             
-                Living l;
-                l.id = id;
-            
-                l.birthAge = 0;
-                l.parentChainLength = parentChain;
-
-                l.birthTime = time;
-                l.email = stringToLowerCase( email );
-
-                if( strcmp( parent, "noParent" ) == 0 ) {
-                    l.birthAge = 14;
-                    }
-                else if( l.parentChainLength == 1 ) {
-                    // parent chain length not recorded in log
-                    // (old-style record)
-                    
-                    // try recomputing it from scratch
-                    int parentID = 0;
-                
-                    sscanf( parent, "parent=%d,", &parentID );
+                int parentID = 0;
                 
-                    for( int i=0; i<currentLiving.size(); i++ ) {
-                        Living lp = currentLiving.getElementDirect( i );
-                    
-                        if( lp.id == parentID ) {
-                            l.parentChainLength = lp.parentChainLength + 1;
-                            break;
-                            }
-                        }
-                    }
-                currentLiving.push_back( l );
-                totalLives ++;
-                folderTotalLives ++;
-                
-                if( l.parentChainLength > longestFamilyChain ) {
-                    longestFamilyChain = l.parentChainLength;
-                    }
-                if( l.parentChainLength > folderLongestFamilyChain ) {
-                    folderLongestFamilyChain = l.parentChainLength;
-                    }
+                sscanf( parent, "parent=%d,", &parentID );
+
+                addBirth( time, id, email, 
+                          ( strcmp( parent, "noParent" ) == 0 ),
+                          parentID, parentChain );
                 }
             else if( event == 'D' ) {
                 fscanf( f, "%lf %d %999s age=%lf %c (%d,%d) %999s pop=%d\n",
                         &time, &id, email, &age, &gender, &locX, &locY, 
                         deathReason, &pop );            
             
-                double yearsLived = age;
-                
-                char *lowerEmail = stringToLowerCase( email );
-
-                // walk backwards, finding most recent birth that matches
-                // thus, we don't consider orphaned births (from server crashes)
-                // by accident
-                char foundBirth = false;
-                for( int i=currentLiving.size() - 1; i>=0; i-- ) {
-                    Living l = currentLiving.getElementDirect( i );
-                    
-                    if( l.id == id && strcmp( l.email, lowerEmail ) == 0 ) {
-                        yearsLived -= l.birthAge;
-                        
-                        if( generateMySQL ) {
-                            addPlayerGame( l.email, l.birthTime, time );
-                            }
-                        delete [] l.email;
-                        currentLiving.deleteElement( i );
-                        foundBirth = true;
-                        break;
-                        }
-                    }
-            
-                if( foundBirth ) {    
-                    totalAge += yearsLived;
-                    folderTotalAge += yearsLived;
-                    
-                    if( age >= 55 ) {
-                        over55Count++;
-                        folderOver55Count++;
-                        }
-                    }
-                else {
-                    printf( "Orphaned death that had no matching birth:  "
-                            "%.0f %d %s\n",
-                            time, id, lowerEmail );
-                    }
-
-                delete [] lowerEmail;
+                addDeath( time, id, email, age );
                 }
             else {
                 scannedLine = false;
@@ -254,6 +277,66 @@ void processLogFile( File *inFile ) {
 
 
 
+// returns num partitions processed
+int processLifeLogArchive( LogArchive *inArchive, int inNumThreads ) {
+    LogArchiveQuery q;
+    initLogArchiveQuery( &q, LOG_ARCHIVE_LIFE );
+    
+    q.columnMask = 
+        ( 1 << LIFE_TIME ) | ( 1 << LIFE_EVENT ) | ( 1 << LIFE_ID ) |
+        ( 1 << LIFE_EMAIL ) | ( 1 << LIFE_PARENT_ID ) | 
+        ( 1 << LIFE_AGE ) | ( 1 << LIFE_CHAIN );
+    
+    // births must be matched to deaths in the order they were logged,
+    // so partitions come back whole and are walked here
+    int numPartitions;
+    LogArchivePartition **partitions = (LogArchivePartition **)
+        runLogArchiveQuery( inArchive, &q, inNumThreads, &numPartitions );
+    
+    int numProcessed = 0;
+
+    for( int p=0; p<numPartitions; p++ ) {
+        LogArchivePartition *part = partitions[p];
+        
+        if( part == NULL ) {
+            printf( "Failed to read archive partition\n" );
+            continue;
+            }
+
+        if( strstr( part->sourceFolder, "ahap" ) == NULL ) {
+            
+            for( int i=0; i<part->numRows; i++ ) {
+                char event = (char)getLogArchiveNumber( part, LIFE_EVENT, i );
+                double time = getLogArchiveNumber( part, LIFE_TIME, i );
+                int id = (int)getLogArchiveNumber( part, LIFE_ID, i );
+                const char *email = getLogArchiveString( part, LIFE_EMAIL, i );
+                
+                if( event == 'B' ) {
+                    // -1 for noParent
+                    int parentID = 
+                        (int)getLogArchiveNumber( part, LIFE_PARENT_ID, i );
+                    
+                    addBirth( time, id, email, ( parentID == -1 ), parentID,
+                              (int)getLogArchiveNumber( part, 
+                                                        LIFE_CHAIN, i ) );
+                    }
+                else if( event == 'D' ) {
+                    addDeath( time, id, email,
+                              getLogArchiveNumber( part, LIFE_AGE, i ) );
+                    }
+                }
+            numProcessed++;
+            }
+        
+        freeLogArchivePartition( part );
+        }
+    delete [] partitions;
+    
+    return numProcessed;
+    }
+
+
+
 
 const char *checkpointFileName = "statsCheckpoint.txt";
 
@@ -436,7 +519,7 @@ void printCommaInt( FILE *inFile, int inInt ) {
 
 int main( int inNumArgs, char **inArgs ) {
 
-    if( inNumArgs != 3 ) {
+    if( inNumArgs != 3 && inNumArgs != 4 ) {
         usage();
         }
     
@@ -444,17 +527,40 @@ int main( int inNumArgs, char **inArgs ) {
     
     char *outPath = inArgs[2];
     
+    int numThreads = 4;
+    
+    if( inNumArgs == 4 ) {
+        sscanf( inArgs[3], "%d", &numThreads );
+        }
+
     if( path[strlen(path) - 1] == '/' ) {
         path[strlen(path) - 1] = '\0';
         }
     
     File mainDir( NULL, path );
     
+    char *archivePath = autoSprintf( "%s/logArchive", path );
+    
+    LogArchive *archive = openLogArchive( archivePath );
+    
+    delete [] archivePath;
+    
     if( mainDir.exists() && mainDir.isDirectory() ) {
         
         
         int numFilesProcessed = 0;
         
+        if( archive != NULL ) {
+            printf( "Reading log archive\n" );
+            
+            // whole archive is fast enough to read that checkpoints
+            // aren't needed
+            numFilesProcessed = processLifeLogArchive( archive, numThreads );
+            
+            closeLogArchive( archive );
+            }
+        else {
+        
         int numChildFiles;
         File **childFiles = mainDir.getChildFiles( &numChildFiles );
         
@@ -476,6 +582,7 @@ int main( int inNumArgs, char **inArgs ) {
             delete childFiles[i];
             }
         delete [] childFiles;
+            }
         
 
         
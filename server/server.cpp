@@ -64,6 +64,15 @@
 #include "offspringTracker.h"
 #include "ipBanList.h"
 #include "periodicPlacements.h"
+#include "chunkBuilder.h"
+#include "taskScheduler.h"
+#include "chunkSentCache.h"
+#include "playerGrid.h"
+#include "outboundQueue.h"
+#include "mapChangeBroadcast.h"
+#include "../commonSource/binaryMapChunk.h"
+#include "clientMessage.h"
+#include "logWriter.h"
 
 
 #include "minorGems/util/random/JenkinsRandomSource.h"
@@ -687,6 +696,10 @@ typedef struct FreshConnection {
         char *clientTag;
         
         char reconnectOnly;
+        
+        char binaryMapChunks;
+        
+        char binaryClientActions;
 
     } FreshConnection;
 
@@ -866,6 +879,16 @@ typedef struct LiveObject {
         int lastSentMapX;
         int lastSentMapY;
         
+        // client asked for MB map chunks
+        char binaryMapChunks;
+        
+        // client may send binary action frames
+        char binaryClientActions;
+        
+        // what we've sent this client so far, for MB chunks
+        // NULL until first MB chunk sent
+        ChunkSentCache *chunkSentCache;
+        
         // path dest for the last full path that we checked completely
         // for getting too close to player's known map chunk
         GridPos mapChunkPathCheckedDest;
@@ -944,6 +967,15 @@ typedef struct LiveObject {
 
         Socket *sock;
         SimpleVector<char> *sockBuffer;
+
+        // messages waiting to go out on sock, sent at end of each step
+        OutboundQueue *outQueue;
+        
+        // last time outQueue was empty or made progress
+        double outQueueProgressTime;
+        
+        // is sockPoll watching sock for room to write?
+        char outQueueWatched;
         
         // indicates that some messages were sent to this player this 
         // frame, and they need a FRAME terminator message
@@ -1216,6 +1248,103 @@ int getNumPlayers() {
 
 
 
+// see playerGrid.h
+// grid refers to players by index, and is kept up to date as players
+// are added, removed, or moved
+// whole grid built on first query
+static char playerGridDirty = true;
+
+
+
+static void updatePlayerGridIndex( int inIndex ) {
+    LiveObject *o = players.getElement( inIndex );
+    
+    int minX = o->xs;
+    int maxX = o->xs;
+    int minY = o->ys;
+    int maxY = o->ys;
+    
+    if( o->xd < minX ) minX = o->xd;
+    if( o->xd > maxX ) maxX = o->xd;
+    if( o->yd < minY ) minY = o->yd;
+    if( o->yd > maxY ) maxY = o->yd;
+    
+    if( ( o->xs != o->xd || o->ys != o->yd ) && 
+        o->pathToDest != NULL ) {
+        // moving, could be anywhere along path
+        for( int p=0; p<o->pathLength; p++ ) {
+            GridPos pos = o->pathToDest[p];
+            
+            if( pos.x < minX ) minX = pos.x;
+            if( pos.x > maxX ) maxX = pos.x;
+            if( pos.y < minY ) minY = pos.y;
+            if( pos.y > maxY ) maxY = pos.y;
+            }
+        }
+    
+    setPlayerGridBox( inIndex, minX, minY, maxX, maxY );
+    }
+
+
+
+// call after changing a player's xs, ys, xd, yd, or path
+static void updatePlayerGrid( LiveObject *inPlayer ) {
+    if( playerGridDirty || players.size() == 0 ) {
+        // whole grid rebuilt before next query anyway
+        return;
+        }
+    
+    LiveObject *first = players.getElement( 0 );
+    
+    if( inPlayer < first || inPlayer >= first + players.size() ) {
+        // not in players (still loading tutorial)
+        return;
+        }
+    
+    updatePlayerGridIndex( inPlayer - first );
+    }
+
+
+
+// call after appending a player to players
+static void addLastPlayerToGrid() {
+    if( playerGridDirty ) {
+        return;
+        }
+    updatePlayerGridIndex( players.size() - 1 );
+    }
+
+
+
+// call after deleting player at inIndex from players
+static void deletePlayerFromGrid( int inIndex ) {
+    if( playerGridDirty ) {
+        return;
+        }
+    deletePlayerGridIndex( inIndex );
+    }
+
+
+
+// appends indices into players of those who might be within rect,
+// in increasing order
+// caller must check exact positions
+static void getPlayersNear( int inMinX, int inMinY, int inMaxX, int inMaxY,
+                            SimpleVector<int> *outIndices ) {
+    if( playerGridDirty ) {
+        clearPlayerGrid();
+        
+        for( int i=0; i<players.size(); i++ ) {
+            updatePlayerGridIndex( i );
+            }
+        playerGridDirty = false;
+        }
+    
+    getPlayerGridIndices( inMinX, inMinY, inMaxX, inMaxY, outIndices );
+    }
+
+
+
 char doesEveLineExist( int inEveID ) {
     for( int i=0; i<players.size(); i++ ) {
         LiveObject *o = players.getElement( i );
@@ -1944,6 +2073,7 @@ static void backToBasics( LiveObject *inPlayer ) {
         p->xd = p->xs;
         p->yd = p->ys;
         
+        updatePlayerGrid( p );
         
         p->birthPos.x = p->xs;
         p->birthPos.y = p->ys;
@@ -2494,6 +2624,9 @@ static void addShortLife( char *inEmail ) {
 
 
 
+static void discardPrebuiltMapChunks();
+
+
 void quitCleanup() {
     AppLog::info( "Cleaning up on quit..." );
 
@@ -2527,6 +2660,9 @@ void quitCleanup() {
         removeAllOwnership( nextPlayer, false );
 
         if( nextPlayer->sock != NULL ) {
+            // last chance for anything still queued, like shutdown message
+            nextPlayer->outQueue->flush( nextPlayer->sock );
+            
             delete nextPlayer->sock;
             nextPlayer->sock = NULL;
             }
@@ -2534,6 +2670,8 @@ void quitCleanup() {
             delete nextPlayer->sockBuffer;
             nextPlayer->sockBuffer = NULL;
             }
+        
+        delete nextPlayer->outQueue;
 
         delete nextPlayer->lineage;
 
@@ -2600,6 +2738,10 @@ void quitCleanup() {
 
         delete nextPlayer->babyBirthTimes;
         delete nextPlayer->babyIDs;        
+
+        if( nextPlayer->chunkSentCache != NULL ) {
+            freeChunkSentCache( nextPlayer->chunkSentCache );
+            }
         }
     players.deleteAll();
 
@@ -2652,6 +2794,12 @@ void quitCleanup() {
     freePeriodicPlacements();
     
 
+    discardPrebuiltMapChunks();
+    freeChunkBuilder();
+    freeTaskScheduler();
+    
+    freePlayerGrid();
+    
     freeMap();
 
     freeTransBank();
@@ -2770,6 +2918,9 @@ void quitCleanup() {
     recentScoresForPickingEve.deleteAll();
 
     shortLifeEmails.deallocateStringElements();
+
+    // last, so everything logged during cleanup gets written
+    freeLogWriter();
     }
 
 
@@ -2960,796 +3111,174 @@ char readSocketFull( Socket *inSock, SimpleVector<char> *inBuffer ) {
 
 
 
-// NULL if there's no full message available
-// if inLoginMessageOnly true, then we look for messages that start with
-// LOGIN or RLOGIN, and count sufficiently long messages that don't
-// start with either string as NONSENSE (this allows us to instantly reject 
-// web requests and other non-OHOL messages that don't end with # and don't
-// exceed our 200 char limit)
-char *getNextClientMessage( SimpleVector<char> *inBuffer,
-                            char inLoginMessageOnly = false ) {
-
-    // find first terminal character #
+// text of last binary client message, rebuilt for the log
+static char binaryMessageText[ BINARY_CLIENT_ACTION_MAX_TEXT ];
 
-    int index = inBuffer->getElementIndex( '#' );
-        
-    if( index == -1 ) {
-
-        if( inBuffer->size() > 200 ) {
-            // 200 characters with no message terminator?
-            // client is sending us nonsense
-            // cut it off here to avoid buffer overflow
-            
-            AppLog::info( "More than 200 characters in client receive buffer "
-                          "with no messsage terminator present, "
-                          "generating NONSENSE message." );
-            
-            return stringDuplicate( "NONSENSE 0 0" );
-            }
-        else if( inLoginMessageOnly && inBuffer->size() >= 6 ) {
-            char *buffString = inBuffer->getElementString();
-            
-            if( strstr( buffString, "LOGIN" ) != buffString &&
-                strstr( buffString, "RLOGIN" ) != buffString ) {
-                delete [] buffString;
-                
-                AppLog::info( 
-                    "More than 6 characters in client receive buffer "
-                    "with no LOGIN or RLOGIN present, when inLoginMessageOnly "
-                    "set, generating NONSENSE message." );
-                
-                return stringDuplicate( "NONSENSE 0 0" );
-                }
-            
-            delete [] buffString;
-            }
-        
 
 
-        return NULL;
+// computes a fractional index along path
+// 1.25 means 1/4 way between index 1 and 2 on path
+// thus, this can be as low as -1 (for starting position)
+double computePartialMovePathStepPrecise( LiveObject *inPlayer ) {
+    
+    if( inPlayer->pathLength == 0 || inPlayer->pathToDest == NULL ) {
+        return -1;
         }
+
+    double fractionDone = 
+        ( Time::getCurrentTime() - 
+          inPlayer->moveStartTime )
+        / inPlayer->moveTotalSeconds;
     
-    if( index > 1 && 
-        inBuffer->getElementDirect( 0 ) == 'K' &&
-        inBuffer->getElementDirect( 1 ) == 'A' ) {
-        
-        // a KA (keep alive) message
-        // short-cicuit the processing here
-        
-        inBuffer->deleteStartElements( index + 1 );
-        return NULL;
+    if( fractionDone > 1 ) {
+        fractionDone = 1;
         }
     
-        
+    if( fractionDone < 0 ) {
+        fractionDone = 0;
+        }
 
-    char *message = new char[ index + 1 ];
+    if( fractionDone == 1 ) {
+        // at last spot in path, no partial measurment necessary
+        return inPlayer->pathLength - 1;
+        }
     
-    // all but terminal character
-    for( int i=0; i<index; i++ ) {
-        message[i] = inBuffer->getElementDirect( i );
+    if( fractionDone == 0 ) {
+        // at start location, before first spot in path
+        return -1;
         }
+
+    double distDone = fractionDone * inPlayer->pathDist;
+
     
-    // delete from buffer, including terminal character
-    inBuffer->deleteStartElements( index + 1 );
+    // walk through path steps until we see dist done
+    double totalLength = 0;
     
-    message[ index ] = '\0';
+    GridPos lastPos = { inPlayer->xs, inPlayer->ys };
     
-    return message;
-    }
-
-
-
-
-
-typedef enum messageType {
-	MOVE,
-    USE,
-    SELF,
-    BABY,
-    UBABY,
-    REMV,
-    SREMV,
-    DROP,
-    SWAP,
-    KILL,
-    SAY,
-    EMOT,
-    JUMP,
-    DIE,
-    GRAVE,
-    OWNER,
-    FORCE,
-    MAP,
-    TRIGGER,
-    BUG,
-    PING,
-    VOGS,
-    VOGN,
-    VOGP,
-    VOGM,
-    VOGI,
-    VOGT,
-    VOGX,
-    PHOTO,
-    PHOID,
-    LEAD,
-    UNFOL,
-    PROP,
-    ORDR,
-    FLIP,
-    MOTH,
-    APVT,
-    UNKNOWN
-    } messageType;
-
-
+    double lastPosDist = 0;
 
+    for( int i=0; i<inPlayer->pathLength; i++ ) {
 
-typedef struct ClientMessage {
-        messageType type;
-        int x, y, c, i, id;
+        GridPos thisPos = inPlayer->pathToDest[i];
         
-        int trigger;
-        int bug;
-
-        // some messages have extra positions attached
-        int numExtraPos;
-
-        // NULL if there are no extra
-        GridPos *extraPos;
-
-        // null if type not SAY
-        char *saidText;
+        double stepLen;
         
-        // NULL if type not APVT
-        char *voteGithubUsername;
 
-        // null if type not BUG
-        char *bugText;
-        
-        // null if type not PHOID
-        char *photoIDString;
-        
+        if( thisPos.x != lastPos.x &&
+            thisPos.y != lastPos.y ) {
+            stepLen = diagLength;
+            }
+        else {
+            // not diag
+            stepLen = 1;
+            }
 
-        // for MOVE messages
-        int sequenceNumber;
+        totalLength += stepLen;
 
-    } ClientMessage;
+        if( totalLength > distDone ) {
+            // add in extra
+            return ( i - 1 ) + (distDone - lastPosDist) / stepLen;
+            }
 
+        lastPos = thisPos;
+        lastPosDist += stepLen;
+        }
+    
+    return inPlayer->pathLength - 1;
+    }
 
-static int pathDeltaMax = 16;
 
 
 
-static int stringToInt( char *inString ) {
-    return strtol( inString, NULL, 10 );
+int computePartialMovePathStep( LiveObject *inPlayer ) {
+    return lrint( computePartialMovePathStepPrecise( inPlayer ) );
     }
 
 
 
-// if extraPos present in result, destroyed by caller
-// inMessage may be modified by this call
-ClientMessage parseMessage( LiveObject *inPlayer, char *inMessage ) {
-    
-    char nameBuffer[100];
-    
-    ClientMessage m;
+doublePair computePartialMoveSpotPrecise( LiveObject *inPlayer ) {
+
+    double c = computePartialMovePathStepPrecise( inPlayer );
     
-    m.i = -1;
-    m.c = -1;
-    m.id = -1;
-    m.trigger = -1;
-    m.numExtraPos = 0;
-    m.extraPos = NULL;
-    m.saidText = NULL;
-    m.voteGithubUsername = NULL;
-    m.bugText = NULL;
-    m.photoIDString = NULL;
-    m.sequenceNumber = -1;
+    if( c == -1 ) {
+        doublePair result = { (double)inPlayer->xs, 
+                              (double)inPlayer->ys };
+        return result;
+        }
+
     
-    // don't require # terminator here
+    int aInd = floor( c );
+    int bInd = ceil( c );
     
     
-    //int numRead = sscanf( inMessage, 
-    //                      "%99s %d %d", nameBuffer, &( m.x ), &( m.y ) );
+    GridPos aPos;
     
-
-    // profiler finds sscanf as a hotspot
-    // try a custom bit of code instead
+    if( aInd >= 0 ) {
+        aPos = inPlayer->pathToDest[ aInd ];
+        }
+    else {
+        aPos.x = inPlayer->xs;
+        aPos.y = inPlayer->ys;
+        }
     
-    int numRead = 0;
+    double bMix = c - aInd;
     
-    int parseLen = strlen( inMessage );
-    if( parseLen > 99 ) {
-        parseLen = 99;
-        }
+    doublePair result = { (double)aPos.x, (double)aPos.y };
     
-    for( int i=0; i<parseLen; i++ ) {
-        if( inMessage[i] == ' ' ) {
-            switch( numRead ) {
-                case 0:
-                    if( i != 0 ) {
-                        memcpy( nameBuffer, inMessage, i );
-                        nameBuffer[i] = '\0';
-                        numRead++;
-                        // rewind back to read the space again
-                        // before the first number
-                        i--;
-                        }
-                    break;
-                case 1:
-                    m.x = stringToInt( &( inMessage[i] ) );
-                    numRead++;
-                    break;
-                case 2:
-                    m.y = stringToInt( &( inMessage[i] ) );
-                    numRead++;
-                    break;
-                }
-            if( numRead == 3 ) {
-                break;
-                }
-            }
+    if( bMix > 0 ) {
+        GridPos bPos = inPlayer->pathToDest[ bInd ];
+        
+        double aMix = 1.0 - bMix;
+        
+        result.x *= aMix;
+        result.y *= aMix;
+        
+        result.x += bMix * bPos.x;
+        result.y += bMix * bPos.y;
         }
     
+    return result;
+    }
 
-    
-    if( numRead >= 2 &&
-        strcmp( nameBuffer, "BUG" ) == 0 ) {
-        m.type = BUG;
-        m.bug = m.x;
-        m.bugText = stringDuplicate( inMessage );
-        return m;
-        }
 
 
-    if( numRead != 3 ) {
-        
-        if( numRead == 2 &&
-            strcmp( nameBuffer, "TRIGGER" ) == 0 ) {
-            m.type = TRIGGER;
-            m.trigger = m.x;
-            }
-        else {
-            m.type = UNKNOWN;
-            }
-        
-        return m;
+
+// if inOverrideC > -2, then it is used instead of current partial move step
+GridPos computePartialMoveSpot( LiveObject *inPlayer, int inOverrideC = -2 ) {
+
+    int c = inOverrideC;
+    if( c < -1 ) {
+        c = computePartialMovePathStep( inPlayer );
         }
     
-
-    if( strcmp( nameBuffer, "MOVE" ) == 0) {
-        m.type = MOVE;
-        
-        char *atPos = strstr( inMessage, "@" );
+    if( c >= 0 ) {
         
-        int offset = 3;
+        GridPos cPos = inPlayer->pathToDest[c];
         
-        if( atPos != NULL ) {
-            offset = 4;            
-            }
+        return cPos;
+        }
+    else {
+        GridPos cPos = { inPlayer->xs, inPlayer->ys };
         
+        return cPos;
+        }
+    }
+
 
-        // in place, so we don't need to deallocate them
-        SimpleVector<char *> *tokens =
-            tokenizeStringInPlace( inMessage );
-        
-        // require an even number of extra coords beyond offset
-        if( tokens->size() < offset + 2 || 
-            ( tokens->size() - offset ) %2 != 0 ) {
-            
-            delete tokens;
-            
-            m.type = UNKNOWN;
-            return m;
-            }
-        
-        if( atPos != NULL ) {
-            // skip @ symbol in token and parse int
-            m.sequenceNumber = 
-                stringToInt( &( tokens->getElementDirect( 3 )[1] ) );
-            }
 
-        int numTokens = tokens->size();
+GridPos getPlayerPos( LiveObject *inPlayer ) {
+    if( inPlayer->xs == inPlayer->xd &&
+        inPlayer->ys == inPlayer->yd ) {
         
-        m.numExtraPos = (numTokens - offset) / 2;
+        GridPos cPos = { inPlayer->xs, inPlayer->ys };
         
-        m.extraPos = new GridPos[ m.numExtraPos ];
-
-        for( int e=0; e<m.numExtraPos; e++ ) {
-            
-            char *xToken = tokens->getElementDirect( offset + e * 2 );
-            char *yToken = tokens->getElementDirect( offset + e * 2 + 1 );
-            
-            // profiler found sscanf is a bottleneck here
-            // try atoi (stringToInt) instead
-            //sscanf( xToken, "%d", &( m.extraPos[e].x ) );
-            //sscanf( yToken, "%d", &( m.extraPos[e].y ) );
-
-            m.extraPos[e].x = stringToInt( xToken );
-            m.extraPos[e].y = stringToInt( yToken );
-            
-            
-            if( abs( m.extraPos[e].x ) > pathDeltaMax ||
-                abs( m.extraPos[e].y ) > pathDeltaMax ) {
-                // path goes too far afield
-                
-                // terminate it here
-                m.numExtraPos = e;
-                
-                if( e == 0 ) {
-                    delete [] m.extraPos;
-                    m.extraPos = NULL;
-                    m.numExtraPos = 0;
-                    m.type = UNKNOWN;
-                    delete tokens;
-                    return m;
-                    }
-                break;
-                }
-                
-
-            // make them absolute
-            m.extraPos[e].x += m.x;
-            m.extraPos[e].y += m.y;
-            }
-        
-        delete tokens;
-        }
-    else if( strcmp( nameBuffer, "JUMP" ) == 0 ) {
-        m.type = JUMP;
-        }
-    else if( strcmp( nameBuffer, "DIE" ) == 0 ) {
-        m.type = DIE;
-        }
-    else if( strcmp( nameBuffer, "GRAVE" ) == 0 ) {
-        m.type = GRAVE;
-        }
-    else if( strcmp( nameBuffer, "OWNER" ) == 0 ) {
-        m.type = OWNER;
-        }
-    else if( strcmp( nameBuffer, "FORCE" ) == 0 ) {
-        m.type = FORCE;
-        }
-    else if( strcmp( nameBuffer, "USE" ) == 0 ) {
-        m.type = USE;
-        // read optional id parameter
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ), &( m.id ), &( m.i ) );
-        
-        if( numRead < 5 ) {
-            m.i = -1;
-            }
-        if( numRead < 4 ) {
-            m.id = -1;
-            }
-        }
-    else if( strcmp( nameBuffer, "SELF" ) == 0 ) {
-        m.type = SELF;
-
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ), &( m.i ) );
-        
-        if( numRead != 4 ) {
-            m.type = UNKNOWN;
-            }
-        }
-    else if( strcmp( nameBuffer, "UBABY" ) == 0 ) {
-        m.type = UBABY;
-
-        // id param optional
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ), &( m.i ), &( m.id ) );
-        
-        if( numRead != 4 && numRead != 5 ) {
-            m.type = UNKNOWN;
-            }
-        if( numRead != 5 ) {
-            m.id = -1;
-            }
-        }
-    else if( strcmp( nameBuffer, "BABY" ) == 0 ) {
-        m.type = BABY;
-        // read optional id parameter
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ), &( m.id ) );
-        
-        if( numRead != 4 ) {
-            m.id = -1;
-            }
-        }
-    else if( strcmp( nameBuffer, "PING" ) == 0 ) {
-        m.type = PING;
-        // read unique id parameter
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ), &( m.id ) );
-        
-        if( numRead != 4 ) {
-            m.id = 0;
-            }
-        }
-    else if( strcmp( nameBuffer, "SREMV" ) == 0 ) {
-        m.type = SREMV;
-        
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ), &( m.c ),
-                          &( m.i ) );
-        
-        if( numRead != 5 ) {
-            m.type = UNKNOWN;
-            }
-        }
-    else if( strcmp( nameBuffer, "REMV" ) == 0 ) {
-        m.type = REMV;
-        
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ), &( m.i ) );
-        
-        if( numRead != 4 ) {
-            m.type = UNKNOWN;
-            }
-        }
-    else if( strcmp( nameBuffer, "DROP" ) == 0 ) {
-        m.type = DROP;
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ), &( m.c ) );
-        
-        if( numRead != 4 ) {
-            m.type = UNKNOWN;
-            }
-        }
-    else if( strcmp( nameBuffer, "SWAP" ) == 0 ) {
-        m.type = SWAP;
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ) );
-        
-        if( numRead != 3 ) {
-            m.type = UNKNOWN;
-            }
-        }
-    else if( strcmp( nameBuffer, "KILL" ) == 0 ) {
-        m.type = KILL;
-        
-        // read optional id parameter
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ), &( m.id ) );
-        
-        if( numRead != 4 ) {
-            m.id = -1;
-            }
-        }
-    else if( strcmp( nameBuffer, "MAP" ) == 0 ) {
-        m.type = MAP;
-        }
-    else if( strcmp( nameBuffer, "SAY" ) == 0 ) {
-        m.type = SAY;
-
-        // look after third space
-        char *firstSpace = strstr( inMessage, " " );
-        
-        if( firstSpace != NULL ) {
-            
-            char *secondSpace = strstr( &( firstSpace[1] ), " " );
-            
-            if( secondSpace != NULL ) {
-
-                char *thirdSpace = strstr( &( secondSpace[1] ), " " );
-                
-                if( thirdSpace != NULL ) {
-                    m.saidText = stringDuplicate( &( thirdSpace[1] ) );
-                    }
-                }
-            }
-        }
-    else if( strcmp( nameBuffer, "EMOT" ) == 0 ) {
-        m.type = EMOT;
-
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ), &( m.i ) );
-        
-        if( numRead != 4 ) {
-            m.type = UNKNOWN;
-            }
-        }
-    else if( strcmp( nameBuffer, "VOGS" ) == 0 ) {
-        m.type = VOGS;
-        }
-    else if( strcmp( nameBuffer, "VOGN" ) == 0 ) {
-        m.type = VOGN;
-        }
-    else if( strcmp( nameBuffer, "VOGP" ) == 0 ) {
-        m.type = VOGP;
-        }
-    else if( strcmp( nameBuffer, "VOGM" ) == 0 ) {
-        m.type = VOGM;
-        }
-    else if( strcmp( nameBuffer, "VOGI" ) == 0 ) {
-        m.type = VOGI;
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ), &( m.id ) );
-        
-        if( numRead != 4 ) {
-            m.id = -1;
-            }
-        }
-    else if( strcmp( nameBuffer, "VOGT" ) == 0 ) {
-        m.type = VOGT;
-
-        // look after second space
-        char *firstSpace = strstr( inMessage, " " );
-        
-        if( firstSpace != NULL ) {
-            
-            char *secondSpace = strstr( &( firstSpace[1] ), " " );
-            
-            if( secondSpace != NULL ) {
-
-                char *thirdSpace = strstr( &( secondSpace[1] ), " " );
-                
-                if( thirdSpace != NULL ) {
-                    m.saidText = stringDuplicate( &( thirdSpace[1] ) );
-                    }
-                }
-            }
-        }
-    else if( strcmp( nameBuffer, "VOGX" ) == 0 ) {
-        m.type = VOGX;
-        }
-    else if( strcmp( nameBuffer, "PHOTO" ) == 0 ) {
-        m.type = PHOTO;
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %d", 
-                          nameBuffer, &( m.x ), &( m.y ), &( m.id ) );
-        
-        if( numRead != 4 ) {
-            m.id = 0;
-            }
-        }
-    else if( strcmp( nameBuffer, "PHOID" ) == 0 ) {
-        m.type = PHOID;
-        
-        m.photoIDString = new char[41];
-        m.photoIDString[0] = '\0';
-        
-        numRead = sscanf( inMessage, 
-                          "%99s %d %d %40s", 
-                          nameBuffer, &( m.x ), &( m.y ), m.photoIDString );
-        }
-    else if( strcmp( nameBuffer, "LEAD" ) == 0 ) {
-        m.type = LEAD;
-        }
-    else if( strcmp( nameBuffer, "UNFOL" ) == 0 ) {
-        m.type = UNFOL;
-        }
-    else if( strcmp( nameBuffer, "PROP" ) == 0 ) {
-        m.type = PROP;
-        }
-    else if( strcmp( nameBuffer, "ORDR" ) == 0 ) {
-        m.type = ORDR;
-        }
-    else if( strcmp( nameBuffer, "FLIP" ) == 0 ) {
-        m.type = FLIP;
-        }
-    else if( strcmp( nameBuffer, "MOTH" ) == 0 ) {
-        m.type = MOTH;
-        }
-    else if( strcmp( nameBuffer, "APVT" ) == 0 ) {
-        m.type = APVT;
-
-        // look after third space
-        char *firstSpace = strstr( inMessage, " " );
-        
-        if( firstSpace != NULL ) {
-            
-            char *secondSpace = strstr( &( firstSpace[1] ), " " );
-            
-            if( secondSpace != NULL ) {
-
-                char *thirdSpace = strstr( &( secondSpace[1] ), " " );
-                
-                if( thirdSpace != NULL ) {
-                    m.voteGithubUsername = 
-                        stringDuplicate( &( thirdSpace[1] ) );
-                    }
-                }
-            }
-        }
-    else {
-        m.type = UNKNOWN;
-        }
-    
-    // incoming client messages are relative to birth pos
-    // except NOT map pull messages, which are absolute
-    if( m.type != MAP ) {    
-        m.x += inPlayer->birthPos.x;
-        m.y += inPlayer->birthPos.y;
-
-        for( int i=0; i<m.numExtraPos; i++ ) {
-            m.extraPos[i].x += inPlayer->birthPos.x;
-            m.extraPos[i].y += inPlayer->birthPos.y;
-            }
-        }
-
-    return m;
-    }
-
-
-
-// computes a fractional index along path
-// 1.25 means 1/4 way between index 1 and 2 on path
-// thus, this can be as low as -1 (for starting position)
-double computePartialMovePathStepPrecise( LiveObject *inPlayer ) {
-    
-    if( inPlayer->pathLength == 0 || inPlayer->pathToDest == NULL ) {
-        return -1;
-        }
-
-    double fractionDone = 
-        ( Time::getCurrentTime() - 
-          inPlayer->moveStartTime )
-        / inPlayer->moveTotalSeconds;
-    
-    if( fractionDone > 1 ) {
-        fractionDone = 1;
-        }
-    
-    if( fractionDone < 0 ) {
-        fractionDone = 0;
-        }
-
-    if( fractionDone == 1 ) {
-        // at last spot in path, no partial measurment necessary
-        return inPlayer->pathLength - 1;
-        }
-    
-    if( fractionDone == 0 ) {
-        // at start location, before first spot in path
-        return -1;
-        }
-
-    double distDone = fractionDone * inPlayer->pathDist;
-
-    
-    // walk through path steps until we see dist done
-    double totalLength = 0;
-    
-    GridPos lastPos = { inPlayer->xs, inPlayer->ys };
-    
-    double lastPosDist = 0;
-
-    for( int i=0; i<inPlayer->pathLength; i++ ) {
-
-        GridPos thisPos = inPlayer->pathToDest[i];
-        
-        double stepLen;
-        
-
-        if( thisPos.x != lastPos.x &&
-            thisPos.y != lastPos.y ) {
-            stepLen = diagLength;
-            }
-        else {
-            // not diag
-            stepLen = 1;
-            }
-
-        totalLength += stepLen;
-
-        if( totalLength > distDone ) {
-            // add in extra
-            return ( i - 1 ) + (distDone - lastPosDist) / stepLen;
-            }
-
-        lastPos = thisPos;
-        lastPosDist += stepLen;
-        }
-    
-    return inPlayer->pathLength - 1;
-    }
-
-
-
-
-int computePartialMovePathStep( LiveObject *inPlayer ) {
-    return lrint( computePartialMovePathStepPrecise( inPlayer ) );
-    }
-
-
-
-doublePair computePartialMoveSpotPrecise( LiveObject *inPlayer ) {
-
-    double c = computePartialMovePathStepPrecise( inPlayer );
-    
-    if( c == -1 ) {
-        doublePair result = { (double)inPlayer->xs, 
-                              (double)inPlayer->ys };
-        return result;
-        }
-
-    
-    int aInd = floor( c );
-    int bInd = ceil( c );
-    
-    
-    GridPos aPos;
-    
-    if( aInd >= 0 ) {
-        aPos = inPlayer->pathToDest[ aInd ];
-        }
-    else {
-        aPos.x = inPlayer->xs;
-        aPos.y = inPlayer->ys;
-        }
-    
-    double bMix = c - aInd;
-    
-    doublePair result = { (double)aPos.x, (double)aPos.y };
-    
-    if( bMix > 0 ) {
-        GridPos bPos = inPlayer->pathToDest[ bInd ];
-        
-        double aMix = 1.0 - bMix;
-        
-        result.x *= aMix;
-        result.y *= aMix;
-        
-        result.x += bMix * bPos.x;
-        result.y += bMix * bPos.y;
-        }
-    
-    return result;
-    }
-
-
-
-
-// if inOverrideC > -2, then it is used instead of current partial move step
-GridPos computePartialMoveSpot( LiveObject *inPlayer, int inOverrideC = -2 ) {
-
-    int c = inOverrideC;
-    if( c < -1 ) {
-        c = computePartialMovePathStep( inPlayer );
-        }
-    
-    if( c >= 0 ) {
-        
-        GridPos cPos = inPlayer->pathToDest[c];
-        
-        return cPos;
-        }
-    else {
-        GridPos cPos = { inPlayer->xs, inPlayer->ys };
-        
-        return cPos;
-        }
-    }
-
-
-
-GridPos getPlayerPos( LiveObject *inPlayer ) {
-    if( inPlayer->xs == inPlayer->xd &&
-        inPlayer->ys == inPlayer->yd ) {
-        
-        GridPos cPos = { inPlayer->xs, inPlayer->ys };
-        
-        return cPos;
-        }
-    else {
-        return computePartialMoveSpot( inPlayer );
-        }
-    }
+        return cPos;
+        }
+    else {
+        return computePartialMoveSpot( inPlayer );
+        }
+    }
 
 
 
@@ -4537,7 +4066,7 @@ static double lastPeriodicStepTime = 0;
 
 
 // recompute heat for fixed number of players per timestep
-static int numPlayersRecomputeHeatPerStep = 8;
+static const int numPlayersRecomputeHeatPerStep = 8;
 static int lastPlayerIndexHeatRecomputed = -1;
 static double lastHeatUpdateTime = 0;
 static double heatUpdateTimeStep = 0.1;
@@ -4693,22 +4222,29 @@ static float computeHeldHeat( LiveObject *inPlayer ) {
 
 
 
-static void recomputeHeatMap( LiveObject *inPlayer ) {
-    
-    int gridSize = HEAT_MAP_D * HEAT_MAP_D;
+// what recomputing a player's heat map needs from the world
+typedef struct HeatMapInput {
+        LiveObject *player;
+        
+        float heatOutputGrid[ HEAT_MAP_D * HEAT_MAP_D ];
+        float rGrid[ HEAT_MAP_D * HEAT_MAP_D ];
+        float rFloorGrid[ HEAT_MAP_D * HEAT_MAP_D ];
+        
+        // biome heat value under player, before walls
+        float biomeHeat;
+    } HeatMapInput;
 
-    // assume indoors until we find an air boundary of space
-    inPlayer->isIndoors = true;
-    
 
-    // what if we recompute it from scratch every time?
-    for( int i=0; i<gridSize; i++ ) {
-        inPlayer->heatMap[i] = 0;
-        }
 
-    float heatOutputGrid[ HEAT_MAP_D * HEAT_MAP_D ];
-    float rGrid[ HEAT_MAP_D * HEAT_MAP_D ];
-    float rFloorGrid[ HEAT_MAP_D * HEAT_MAP_D ];
+// looks at map, caches, and other players, so main thread only
+static void gatherHeatMapInput( LiveObject *inPlayer, 
+                                HeatMapInput *outInput ) {
+    
+    outInput->player = inPlayer;
+
+    float *heatOutputGrid = outInput->heatOutputGrid;
+    float *rGrid = outInput->rGrid;
+    float *rFloorGrid = outInput->rFloorGrid;
 
 
     GridPos pos = getPlayerPos( inPlayer );
@@ -4724,6 +4260,13 @@ static void recomputeHeatMap( LiveObject *inPlayer ) {
         } 
 
     
+    int startX = pos.x - HEAT_MAP_D / 2;
+    int startY = pos.y - HEAT_MAP_D / 2;
+    
+    // read window's cells that aren't in RAM yet in one sorted pass,
+    // instead of one random disk read per cell below
+    prefetchMapRegion( startX, startY, 
+                       startX + HEAT_MAP_D - 1, startY + HEAT_MAP_D - 1 );
     
 
     for( int y=0; y<HEAT_MAP_D; y++ ) {
@@ -4734,6 +4277,18 @@ static void recomputeHeatMap( LiveObject *inPlayer ) {
             int mapX = pos.x + x - HEAT_MAP_D / 2;
                     
             int j = y * HEAT_MAP_D + x;
+            
+            // players in the same area share per-tile values, so
+            // most of these lookups are hits
+            MapHeatCell cell;
+            
+            if( getMapHeatCellCached( mapX, mapY, &cell ) ) {
+                heatOutputGrid[j] = cell.heatOutput;
+                rGrid[j] = cell.rValue;
+                rFloorGrid[j] = cell.rFloorValue;
+                continue;
+                }
+            
             heatOutputGrid[j] = 0;
             rGrid[j] = rAir;
             rFloorGrid[j] = rAir;
@@ -4817,9 +4372,48 @@ static void recomputeHeatMap( LiveObject *inPlayer ) {
                 heatOutputGrid[j] += fO->heatValue;
                 rFloorGrid[j] = rCombine( rFloorGrid[j], fO->rValue );
                 }
+            
+            cell.heatOutput = heatOutputGrid[j];
+            cell.rValue = rGrid[j];
+            cell.rFloorValue = rFloorGrid[j];
+            
+            putMapHeatCellCached( mapX, mapY, cell );
             }
         }
 
+    
+    int playerMapIndex = 
+        ( HEAT_MAP_D / 2 ) * HEAT_MAP_D +
+        ( HEAT_MAP_D / 2 );
+            
+    heatOutputGrid[ playerMapIndex ] += computeHeldHeat( inPlayer );
+
+
+    outInput->biomeHeat = getBiomeHeatValue( getMapBiome( pos.x, pos.y ) );
+    }
+
+
+
+// only touches inInput and inInput->player's heat fields, so heat maps
+// for different players can be computed on different threads
+static void computeHeatMap( HeatMapInput *inInput ) {
+    
+    LiveObject *inPlayer = inInput->player;
+    
+    float *heatOutputGrid = inInput->heatOutputGrid;
+    float *rGrid = inInput->rGrid;
+    float *rFloorGrid = inInput->rFloorGrid;
+
+    int gridSize = HEAT_MAP_D * HEAT_MAP_D;
+
+    // assume indoors until we find an air boundary of space
+    inPlayer->isIndoors = true;
+    
+
+    // what if we recompute it from scratch every time?
+    for( int i=0; i<gridSize; i++ ) {
+        inPlayer->heatMap[i] = 0;
+        }
 
     
     int numNeighbors = 8;
@@ -4830,11 +4424,6 @@ static void recomputeHeatMap( LiveObject *inPlayer ) {
     int playerMapIndex = 
         ( HEAT_MAP_D / 2 ) * HEAT_MAP_D +
         ( HEAT_MAP_D / 2 );
-        
-
-    
-            
-    heatOutputGrid[ playerMapIndex ] += computeHeldHeat( inPlayer );
     
 
     // grid of flags for points that are in same airspace (surrounded by walls)
@@ -4912,10 +4501,12 @@ static void recomputeHeatMap( LiveObject *inPlayer ) {
         }
 
     int numInAirspace = 0;
+    float airSpaceHeatSum = 0;
+    
     for( int i=0; i<gridSize; i++ ) {
-        if( airSpaceGrid[ i ] ) {
-            numInAirspace++;
-            }
+        // branch-free, so compiler can vectorize it
+        numInAirspace += airSpaceGrid[ i ];
+        airSpaceHeatSum += airSpaceGrid[ i ] * heatOutputGrid[ i ];
         }
     
     
@@ -4999,15 +4590,6 @@ static void recomputeHeatMap( LiveObject *inPlayer ) {
 
 
 
-    float airSpaceHeatSum = 0;
-    
-    for( int i=0; i<gridSize; i++ ) {
-        if( airSpaceGrid[i] ) {
-            airSpaceHeatSum += heatOutputGrid[i];
-            }
-        }
-
-
     float airSpaceHeatVal = 0;
     
     if( numInAirspace > 0 ) {
@@ -5067,7 +4649,7 @@ static void recomputeHeatMap( LiveObject *inPlayer ) {
     // (hot biome leaking into a building can never make the building
     //  just right).
     // Enclosed walls can make a hot biome not as hot, but never cool
-    float biomeHeat = getBiomeHeatValue( getMapBiome( pos.x, pos.y ) );
+    float biomeHeat = inInput->biomeHeat;
     
     if( biomeHeat > targetHeat ) {
         biomeHeat = boundaryLeak * (biomeHeat - targetHeat) + targetHeat;
@@ -5092,6 +4674,15 @@ static void recomputeHeatMap( LiveObject *inPlayer ) {
 
 
 
+static void computeHeatMapTask( int inIndex, void *inData ) {
+    HeatMapInput *inputs = (HeatMapInput*)inData;
+    
+    computeHeatMap( &( inputs[ inIndex ] ) );
+    }
+
+
+
+
 
 typedef struct MoveRecord {
         int playerID;
@@ -5254,9 +4845,27 @@ char *getMovesMessage( char inNewMovesOnly,
                        GridPos inLocalPos,
                        SimpleVector<ChangePosition> *inChangeVector = NULL ) {
     
+    // moves start within player's path bounds
+    SimpleVector<int> nearIndices;
+    getPlayersNear( inLocalPos.x - 32, inLocalPos.y - 32,
+                    inLocalPos.x + 32, inLocalPos.y + 32, &nearIndices );
+    
+    SimpleVector<MoveRecord> v;
     
-    SimpleVector<MoveRecord> v = getMoveRecords( inNewMovesOnly, 
-                                                 inChangeVector );
+    for( int n=0; n<nearIndices.size(); n++ ) {
+        LiveObject *o = players.getElement( nearIndices.getElementDirect( n ) );
+        
+        if( o->error ) {
+            continue;
+            }
+
+        if( ( o->xd != o->xs || o->yd != o->ys )
+            &&
+            ( o->newMove || !inNewMovesOnly ) ) {
+            
+            v.push_back( getMoveRecord( o, inNewMovesOnly, inChangeVector ) );
+            }
+        }
     
     SimpleVector<MoveRecord> closeRecords;
 
@@ -5338,33 +4947,67 @@ GridPos getClosestPlayerPos( int inX, int inY ) {
     double closeDist = DBL_MAX;
     GridPos closeP = { 0, 0 };
     
-    for( int i=0; i<players.size(); i++ ) {
-        LiveObject *o = players.getElement( i );
-        if( o->error ) {
-            continue;
-            }
-        if( o->heldByOther ) {
-            continue;
-            }
+    SimpleVector<int> nearIndices;
+    
+    // search growing squares around c until closest player found in square
+    // is also closer than anyone outside of it could be
+    int radius = 16;
+    
+    while( true ) {
+        nearIndices.deleteAll();
         
-        GridPos p;
-
-        if( o->xs == o->xd && o->ys == o->yd ) {
-            p.x = o->xd;
-            p.y = o->yd;
+        char wholeMap = ( radius > 1000000 );
+        
+        if( wholeMap ) {
+            for( int i=0; i<players.size(); i++ ) {
+                nearIndices.push_back( i );
+                }
             }
         else {
-            p = computePartialMoveSpot( o );
+            getPlayersNear( inX - radius, inY - radius,
+                            inX + radius, inY + radius, &nearIndices );
             }
         
-        double d = distance( p, c );
+        for( int n=0; n<nearIndices.size(); n++ ) {
+            LiveObject *o = 
+                players.getElement( nearIndices.getElementDirect( n ) );
+            if( o->error ) {
+                continue;
+                }
+            if( o->heldByOther ) {
+                continue;
+                }
+            
+            GridPos p;
+            
+            if( o->xs == o->xd && o->ys == o->yd ) {
+                p.x = o->xd;
+                p.y = o->yd;
+                }
+            else {
+                p = computePartialMoveSpot( o );
+                }
+            
+            double d = distance( p, c );
+            
+            if( d < closeDist ) {
+                closeDist = d;
+                closeP = p;
+                }
+            }
         
-        if( d < closeDist ) {
-            closeDist = d;
-            closeP = p;
+        if( wholeMap || closeDist <= radius ) {
+            return closeP;
             }
+        
+        // closest so far might be beaten by someone outside square
+        // start over with bigger square, keeping same tie-breaking
+        closeDist = DBL_MAX;
+        closeP.x = 0;
+        closeP.y = 0;
+        
+        radius *= 4;
         }
-    return closeP;
     }
 
 
@@ -5417,6 +5060,8 @@ static void setPlayerDisconnected( LiveObject *inPlayer,
         inPlayer->xs = p.x;
         inPlayer->ys = p.y;
 
+        updatePlayerGrid( inPlayer );
+
         inPlayer->birthPos = inPlayer->preVogBirthPos;
         }
     
@@ -5429,6 +5074,10 @@ static void setPlayerDisconnected( LiveObject *inPlayer,
         delete inPlayer->sock;
         inPlayer->sock = NULL;
         }
+
+    inPlayer->outQueue->clear();
+    inPlayer->outQueueWatched = false;
+    
     if( inPlayer->sockBuffer != NULL ) {
         delete inPlayer->sockBuffer;
         inPlayer->sockBuffer = NULL;
@@ -5437,6 +5086,125 @@ static void setPlayerDisconnected( LiveObject *inPlayer,
 
 
 
+// a client that falls this far behind is dropped
+static int maxOutboundQueueBytes = 4194304;
+
+// past this, hold off on map chunks until client catches up
+static int outboundQueueDeferBytes = 262144;
+
+// a client that takes nothing from a non-empty queue this long is dropped
+static double outboundQueueStallSeconds = 30;
+
+static double outboundStatsLogSeconds = 300;
+static double lastOutboundStatsLogTime = 0;
+
+
+
+// queues message to go out on player's socket at end of this step
+// returns inLength on success, or -1 if player's queue is full
+static int sendToPlayerSocket( LiveObject *inPlayer, 
+                               unsigned char *inMessage, int inLength ) {
+    if( inPlayer->sock == NULL ) {
+        return -1;
+        }
+    
+    if( ! inPlayer->outQueue->add( inMessage, inLength, 
+                                   maxOutboundQueueBytes ) ) {
+        AppLog::infoF( "Player %d (%s) has %d bytes waiting to be sent, "
+                       "more than limit of %d",
+                       inPlayer->id, inPlayer->email,
+                       inPlayer->outQueue->getNumQueued(),
+                       maxOutboundQueueBytes );
+        
+        outboundQueueStats.numOverflowDisconnects++;
+        return -1;
+        }
+    
+    return inLength;
+    }
+
+
+
+// client hasn't taken much of what we've already sent them
+// big sends that can wait, like map chunks, should wait
+static char isOutboundQueueBackedUp( LiveObject *inPlayer ) {
+    return ( inPlayer->outQueue->getNumQueued() > outboundQueueDeferBytes );
+    }
+
+
+
+// sends everything that was queued for each player during this step,
+// with one gather write per player
+static void flushOutboundQueues() {
+    double curTime = Time::getCurrentTime();
+    
+    for( int i=0; i<players.size(); i++ ) {
+        LiveObject *nextPlayer = players.getElement( i );
+        
+        if( ! nextPlayer->connected || nextPlayer->sock == NULL ) {
+            continue;
+            }
+        
+        OutboundQueue *q = nextPlayer->outQueue;
+
+        if( q->getNumQueued() > 0 ) {
+            
+            int numSent = q->flush( nextPlayer->sock );
+            
+            if( numSent < 0 ) {
+                setPlayerDisconnected( nextPlayer, "Socket write failed" );
+                continue;
+                }
+            
+            if( numSent > 0 ) {
+                nextPlayer->outQueueProgressTime = curTime;
+                }
+            else if( curTime - nextPlayer->outQueueProgressTime > 
+                     outboundQueueStallSeconds ) {
+                
+                outboundQueueStats.numStallDisconnects++;
+                setPlayerDisconnected( nextPlayer, "Outbound queue stalled" );
+                continue;
+                }
+            }
+        
+        if( q->getNumQueued() == 0 ) {
+            nextPlayer->outQueueProgressTime = curTime;
+            }
+        
+        // wake up from sockPoll when there is room for the rest
+        char watch = ( q->getNumQueued() > 0 );
+        
+        if( watch != nextPlayer->outQueueWatched ) {
+            sockPoll.setWatchWritable( nextPlayer->sock, watch );
+            nextPlayer->outQueueWatched = watch;
+            }
+        }
+
+
+    if( outboundStatsLogSeconds > 0 &&
+        curTime - lastOutboundStatsLogTime > outboundStatsLogSeconds ) {
+        
+        if( outboundQueueStats.numFlushes > 0 ) {    
+            OutboundQueueStats *st = &outboundQueueStats;
+
+            AppLog::infoF( 
+                "Outbound queues:  %.0f bytes queued, %.0f sent in %d writes "
+                "(%d partial), max queue %d bytes, %d map chunks deferred, "
+                "%d overflow and %d stall disconnects",
+                st->bytesQueued, st->bytesSent, st->numFlushes,
+                st->numPartialFlushes, st->maxQueued, 
+                st->numDeferredMapChunks,
+                st->numOverflowDisconnects, st->numStallDisconnects );
+            
+            memset( st, 0, sizeof( OutboundQueueStats ) );
+            }
+        lastOutboundStatsLogTime = curTime;
+        }
+    }
+
+
+
 // if inOnePlayerOnly set, we only send to that player
 void sendGlobalMessage( char *inMessage,
                         LiveObject *inOnePlayerOnly ) {
@@ -5466,9 +5234,8 @@ void sendGlobalMessage( char *inMessage,
                 minGlobalMessageSpacingSeconds ) {
                 
                 int numSent = 
-                    o->sock->send( (unsigned char*)fullMessage, 
-                                   len, 
-                                   false, false );
+                    sendToPlayerSocket( o, (unsigned char*)fullMessage, 
+                                        len );
                 
                 o->lastGlobalMessageTime = curTime;
                 
@@ -5644,6 +5411,318 @@ void checkCustomGlobalMessage() {
 
 
 
+typedef struct MapChunkRect {
+        int x, y, w, h;
+    } MapChunkRect;
+
+
+
+// computes the parts of the map that sendMapChunkMessage sends to inO
+// for a chunk centered on inXD, inYD
+// returns number of rects filled in (0, 1, or 2)
+static int getMapChunkRects( LiveObject *inO, int inXD, int inYD,
+                             MapChunkRect outRects[2] ) {
+    int xd = inXD;
+    int yd = inYD;
+    
+    int halfW = chunkDimensionX / 2;
+    int halfH = chunkDimensionY / 2;
+    
+    int fullStartX = xd - halfW;
+    int fullStartY = yd - halfH;
+    
+
+    if( ! inO->firstMapSent ) {
+        // send full rect centered on x,y
+        outRects[0].x = fullStartX;
+        outRects[0].y = fullStartY;
+        outRects[0].w = chunkDimensionX;
+        outRects[0].h = chunkDimensionY;
+        return 1;
+        }
+
+    
+    // our closest previous chunk center
+    int lastX = inO->lastSentMapX;
+    int lastY = inO->lastSentMapY;
+
+
+    // split next chunk into two bars by subtracting last chunk
+        
+    int horBarStartX = fullStartX;
+    int horBarStartY = fullStartY;
+    int horBarW = chunkDimensionX;
+    int horBarH = chunkDimensionY;
+        
+    if( yd > lastY ) {
+        // remove bottom of bar
+        horBarStartY = lastY + halfH;
+        horBarH = yd - lastY;
+        }
+    else {
+        // remove top of bar
+        horBarH = lastY - yd;
+        }
+
+    if( horBarH > chunkDimensionY ) {
+        // don't allow bar to grow too big if we have a huge jump
+        // like from VOG mode
+        horBarH = chunkDimensionY;
+        }
+        
+
+    int vertBarStartX = fullStartX;
+    int vertBarStartY = fullStartY;
+    int vertBarW = chunkDimensionX;
+    int vertBarH = chunkDimensionY;
+        
+    if( xd > lastX ) {
+        // remove left part of bar
+        vertBarStartX = lastX + halfW;
+        vertBarW = xd - lastX;
+        }
+    else {
+        // remove right part of bar
+        vertBarW = lastX - xd;
+        }
+        
+        
+    if( vertBarW > chunkDimensionX ) {
+        // don't allow bar to grow too big if we have a huge jump
+        // like from VOG mode
+        vertBarW = chunkDimensionX;
+        }
+        
+        
+    // now trim vert bar where it intersects with hor bar
+    if( yd > lastY ) {
+        // remove top of vert bar
+        vertBarH -= horBarH;
+        }
+    else {
+        // remove bottom of vert bar
+        vertBarStartY = horBarStartY + horBarH;
+        vertBarH -= horBarH;
+        }
+        
+    
+    int numRects = 0;
+    
+    // only send if non-zero width and height
+    if( horBarW > 0 && horBarH > 0 ) {
+        outRects[numRects].x = horBarStartX;
+        outRects[numRects].y = horBarStartY;
+        outRects[numRects].w = horBarW;
+        outRects[numRects].h = horBarH;
+        numRects++;
+        }
+    if( vertBarW > 0 && vertBarH > 0 ) {
+        outRects[numRects].x = vertBarStartX;
+        outRects[numRects].y = vertBarStartY;
+        outRects[numRects].w = vertBarW;
+        outRects[numRects].h = vertBarH;
+        numRects++;
+        }
+    
+    return numRects;
+    }
+
+
+
+// chunk messages started on the chunk builder's worker threads at the
+// top of the player send loop, before they are needed
+typedef struct PrebuiltMapChunk {
+        int playerID;
+        MapChunkRect rect;
+        GridPos relativeToPos;
+        ChunkBuildJob *job;
+        
+        // for MB chunks, NULL otherwise
+        uint64_t *cellHashes;
+        // cache generation that unchanged cells were marked against
+        int cacheGeneration;
+    } PrebuiltMapChunk;
+
+static SimpleVector<PrebuiltMapChunk> prebuiltMapChunks;
+
+static int mapChunkBuildThreads = 0;
+
+
+
+static void discardPrebuiltMapChunk( PrebuiltMapChunk *inChunk ) {
+    int len;
+    unsigned char *message = finishChunkBuild( inChunk->job, &len );
+    delete [] message;
+    
+    if( inChunk->cellHashes != NULL ) {
+        delete [] inChunk->cellHashes;
+        }
+    }
+
+
+
+static void discardPrebuiltMapChunks() {
+    for( int i=0; i<prebuiltMapChunks.size(); i++ ) {
+        discardPrebuiltMapChunk( prebuiltMapChunks.getElement( i ) );
+        }
+    prebuiltMapChunks.deleteAll();
+    }
+
+
+
+// snapshot of inRect for inO, set up for MB encoding if inO wants it
+// outCellHashes set to hashes to record in inO's cache once sent,
+// or NULL if not MB
+static MapChunkSnapshot *getPlayerChunkSnapshot( LiveObject *inO,
+                                                 MapChunkRect inRect,
+                                                 uint64_t **outCellHashes ) {
+    MapChunkSnapshot *snapshot = 
+        getChunkSnapshot( inRect.x, inRect.y, inRect.w, inRect.h,
+                          inO->birthPos );
+    
+    *outCellHashes = NULL;
+    
+    if( inO->binaryMapChunks ) {
+        snapshot->binary = true;
+        
+        if( inO->chunkSentCache == NULL ) {
+            inO->chunkSentCache = newChunkSentCache();
+            }
+        
+        *outCellHashes = getChunkSnapshotCellHashes( snapshot );
+        
+        markUnchangedCells( inO->chunkSentCache, snapshot, *outCellHashes );
+        }
+    
+    return snapshot;
+    }
+
+
+
+static void recordSentChunk( LiveObject *inO, MapChunkRect inRect,
+                             uint64_t *inCellHashes ) {
+    if( inCellHashes == NULL ) {
+        return;
+        }
+    
+    recordSentCells( inO->chunkSentCache,
+                     inRect.x - inO->birthPos.x,
+                     inRect.y - inO->birthPos.y,
+                     inRect.w, inRect.h, inCellHashes );
+    
+    delete [] inCellHashes;
+    }
+
+
+
+// snapshots (on this thread) and starts encoding (on worker threads)
+// all chunks that the player send loop will need to send this step
+static void prebuildMapChunks() {
+    discardPrebuiltMapChunks();
+
+    if( mapChunkBuildThreads <= 0 ) {
+        return;
+        }
+    
+    for( int p=0; p<players.size(); p++ ) {
+        LiveObject *o = players.getElement( p );
+        
+        if( ! o->connected || o->error ) {
+            continue;
+            }
+        
+        int xd = o->xd;
+        int yd = o->yd;
+        
+        if( o->firstMessageSent ) {
+            // same check that send loop makes
+            if( o->heldByOther ) {
+                LiveObject *holdingPlayer = getLiveObject( o->heldByOtherID );
+                
+                if( holdingPlayer != NULL ) {
+                    xd = holdingPlayer->xd;
+                    yd = holdingPlayer->yd;
+                    }
+                }
+            
+            if( abs( xd - o->lastSentMapX ) <= 7 &&
+                abs( yd - o->lastSentMapY ) <= 8 &&
+                o->firstMapSent ) {
+                // won't need a chunk this step
+                continue;
+                }
+            }
+
+        MapChunkRect rects[2];
+        int numRects = getMapChunkRects( o, xd, yd, rects );
+        
+        for( int r=0; r<numRects; r++ ) {
+            PrebuiltMapChunk c = { o->id, rects[r], o->birthPos, NULL,
+                                   NULL, 0 };
+            
+            c.job = startChunkBuild( 
+                getPlayerChunkSnapshot( o, rects[r], &( c.cellHashes ) ) );
+            
+            if( o->chunkSentCache != NULL ) {
+                // these rects don't overlap, and are sent in order,
+                // each one bumping generation once
+                c.cacheGeneration = o->chunkSentCache->generation + r;
+                }
+            
+            prebuiltMapChunks.push_back( c );
+            }
+        }
+    }
+
+
+
+// uses a prebuilt message for inO if there is one that matches,
+// or builds one now
+static unsigned char *getMapChunkMessageForPlayer( LiveObject *inO,
+                                                   MapChunkRect inRect,
+                                                   int *outMessageLength ) {
+    for( int i=0; i<prebuiltMapChunks.size(); i++ ) {
+        PrebuiltMapChunk *c = prebuiltMapChunks.getElement( i );
+        
+        if( c->playerID == inO->id &&
+            c->rect.x == inRect.x && c->rect.y == inRect.y &&
+            c->rect.w == inRect.w && c->rect.h == inRect.h &&
+            equal( c->relativeToPos, inO->birthPos ) ) {
+            
+            PrebuiltMapChunk chunk = *c;
+            prebuiltMapChunks.deleteElement( i );
+            
+            if( chunk.cellHashes != NULL &&
+                chunk.cacheGeneration != inO->chunkSentCache->generation ) {
+                // other chunks sent since this was built, 
+                // its unchanged cells may be wrong now
+                discardPrebuiltMapChunk( &chunk );
+                break;
+                }
+            
+            unsigned char *message = 
+                finishChunkBuild( chunk.job, outMessageLength );
+            
+            recordSentChunk( inO, inRect, chunk.cellHashes );
+            
+            return message;
+            }
+        }
+    
+    uint64_t *cellHashes;
+    
+    unsigned char *message = 
+        encodeChunkSnapshot( getPlayerChunkSnapshot( inO, inRect, 
+                                                     &cellHashes ),
+                             outMessageLength );
+    
+    recordSentChunk( inO, inRect, cellHashes );
+    
+    return message;
+    }
+
+
+
 // sets lastSentMap in inO if chunk goes through
 // returns result of send, auto-marks error in inO
 int sendMapChunkMessage( LiveObject *inO, 
@@ -5657,6 +5736,12 @@ int sendMapChunkMessage( LiveObject *inO,
         return 1;
         }
     
+    if( isOutboundQueueBackedUp( inO ) ) {
+        // try again on a later step, when they've caught up
+        outboundQueueStats.numDeferredMapChunks++;
+        return -2;
+        }
+    
     int messageLength = 0;
 
     int xd = inO->xd;
@@ -5668,136 +5753,25 @@ int sendMapChunkMessage( LiveObject *inO,
         }
     
     
-    int halfW = chunkDimensionX / 2;
-    int halfH = chunkDimensionY / 2;
-    
-    int fullStartX = xd - halfW;
-    int fullStartY = yd - halfH;
-    
-    int numSent = 0;
+    MapChunkRect rects[2];
+    int numRects = getMapChunkRects( inO, xd, yd, rects );
 
+    inO->firstMapSent = true;
     
+    int numSent = 0;
 
-    if( ! inO->firstMapSent ) {
-        // send full rect centered on x,y
-        
-        inO->firstMapSent = true;
-        
-        unsigned char *mapChunkMessage = getChunkMessage( fullStartX,
-                                                          fullStartY,
-                                                          chunkDimensionX,
-                                                          chunkDimensionY,
-                                                          inO->birthPos,
-                                                          &messageLength );
-                
-        numSent += 
-            inO->sock->send( mapChunkMessage, 
-                             messageLength, 
-                             false, false );
-                
-        delete [] mapChunkMessage;
-        }
-    else {
-        
-        // our closest previous chunk center
-        int lastX = inO->lastSentMapX;
-        int lastY = inO->lastSentMapY;
-
-
-        // split next chunk into two bars by subtracting last chunk
-        
-        int horBarStartX = fullStartX;
-        int horBarStartY = fullStartY;
-        int horBarW = chunkDimensionX;
-        int horBarH = chunkDimensionY;
-        
-        if( yd > lastY ) {
-            // remove bottom of bar
-            horBarStartY = lastY + halfH;
-            horBarH = yd - lastY;
-            }
-        else {
-            // remove top of bar
-            horBarH = lastY - yd;
-            }
-
-        if( horBarH > chunkDimensionY ) {
-            // don't allow bar to grow too big if we have a huge jump
-            // like from VOG mode
-            horBarH = chunkDimensionY;
-            }
-        
-
-        int vertBarStartX = fullStartX;
-        int vertBarStartY = fullStartY;
-        int vertBarW = chunkDimensionX;
-        int vertBarH = chunkDimensionY;
-        
-        if( xd > lastX ) {
-            // remove left part of bar
-            vertBarStartX = lastX + halfW;
-            vertBarW = xd - lastX;
-            }
-        else {
-            // remove right part of bar
-            vertBarW = lastX - xd;
-            }
-        
-        
-        if( vertBarW > chunkDimensionX ) {
-            // don't allow bar to grow too big if we have a huge jump
-            // like from VOG mode
-            vertBarW = chunkDimensionX;
-            }
+    for( int r=0; r<numRects; r++ ) {
+        int len;
+        unsigned char *mapChunkMessage = 
+            getMapChunkMessageForPlayer( inO, rects[r], &len );
         
-        
-        // now trim vert bar where it intersects with hor bar
-        if( yd > lastY ) {
-            // remove top of vert bar
-            vertBarH -= horBarH;
-            }
-        else {
-            // remove bottom of vert bar
-            vertBarStartY = horBarStartY + horBarH;
-            vertBarH -= horBarH;
-            }
-        
-        
-        // only send if non-zero width and height
-        if( horBarW > 0 && horBarH > 0 ) {
-            int len;
-            unsigned char *mapChunkMessage = getChunkMessage( horBarStartX,
-                                                              horBarStartY,
-                                                              horBarW,
-                                                              horBarH,
-                                                              inO->birthPos,
-                                                              &len );
-            messageLength += len;
-            
-            numSent += 
-                inO->sock->send( mapChunkMessage, 
-                                 len, 
-                                 false, false );
-            
-            delete [] mapChunkMessage;
-            }
-        if( vertBarW > 0 && vertBarH > 0 ) {
-            int len;
-            unsigned char *mapChunkMessage = getChunkMessage( vertBarStartX,
-                                                              vertBarStartY,
-                                                              vertBarW,
-                                                              vertBarH,
-                                                              inO->birthPos,
-                                                              &len );
-            messageLength += len;
+        messageLength += len;
             
-            numSent += 
-                inO->sock->send( mapChunkMessage, 
-                                 len, 
-                                 false, false );
+        numSent += 
+            sendToPlayerSocket( inO, mapChunkMessage, 
+                                len );
             
-            delete [] mapChunkMessage;
-            }
+        delete [] mapChunkMessage;
         }
     
     
@@ -5877,10 +5851,12 @@ char *getHoldingString( LiveObject *inObject ) {
 // only consider living, non-moving players
 char isMapSpotEmptyOfPlayers( int inX, int inY ) {
 
-    int numLive = players.size();
+    SimpleVector<int> nearIndices;
+    getPlayersNear( inX, inY, inX, inY, &nearIndices );
     
-    for( int i=0; i<numLive; i++ ) {
-        LiveObject *nextPlayer = players.getElement( i );
+    for( int n=0; n<nearIndices.size(); n++ ) {
+        LiveObject *nextPlayer = 
+            players.getElement( nearIndices.getElementDirect( n ) );
         
         if( // not about to be deleted
             ! nextPlayer->error &&
@@ -5988,6 +5964,8 @@ static void truncateMove( LiveObject *otherPlayer, int blockedStep ) {
     otherPlayer->yd 
         = otherPlayer->pathToDest[
             blockedStep - 1].y;
+    
+    updatePlayerGrid( otherPlayer );
     }
 
 
@@ -6022,10 +6000,14 @@ void handleMapChangeToPaths(
     if( inNewObject->blocksWalking ) {
     
         GridPos dropSpot = { inX, inY };
-          
-        int numLive = players.size();
-                      
-        for( int j=0; j<numLive; j++ ) {
+        
+        // only players whose path bounds cover spot can be blocked
+        SimpleVector<int> nearIndices;
+        getPlayersNear( inX, inY, inX, inY, &nearIndices );
+        
+        for( int n=0; n<nearIndices.size(); n++ ) {
+            int j = nearIndices.getElementDirect( n );
+            
             LiveObject *otherPlayer = 
                 players.getElement( j );
             
@@ -6040,7 +6022,7 @@ void handleMapChangeToPaths(
                     computePartialMoveSpot( otherPlayer );
                                         
                 if( distance( cPos, dropSpot ) 
-                    <= 2 * pathDeltaMax ) {
+                    <= 2 * PATH_DELTA_MAX ) {
                                             
                     // this is close enough
                     // to this path that it might
@@ -6094,6 +6076,8 @@ void handleMapChangeToPaths(
                                                 
                         otherPlayer->yd = 
                             otherPlayer->ys;
+                        
+                        updatePlayerGrid( otherPlayer );
                              
                         otherPlayer->posForced = true;
                     
@@ -7219,6 +7203,8 @@ GridPos handleDrop( int inX, int inY, LiveObject *inDroppingPlayer,
                     babyO->ys = inDroppingPlayer->yd;
 
                     babyO->heldByOther = false;
+                    
+                    updatePlayerGrid( babyO );
 
                     if( isFertileAge( inDroppingPlayer ) ) {    
                         // reset food decrement time
@@ -7267,6 +7253,8 @@ GridPos handleDrop( int inX, int inY, LiveObject *inDroppingPlayer,
             
             babyO->heldByOther = false;
             
+            updatePlayerGrid( babyO );
+            
             // force baby pos
             // baby can wriggle out of arms in same server step that it was
             // picked up.  In that case, the clients will never get the
@@ -8100,11 +8088,15 @@ static LiveObject *getHitPlayer( int inX, int inY,
                                  int *outHitIndex = NULL ) {
     GridPos targetPos = { inX, inY };
 
-    int numLive = players.size();
+    // only players whose path bounds cover target can be hit
+    SimpleVector<int> nearIndices;
+    getPlayersNear( inX, inY, inX, inY, &nearIndices );
                                     
     LiveObject *hitPlayer = NULL;
                                     
-    for( int j=0; j<numLive; j++ ) {
+    for( int n=0; n<nearIndices.size(); n++ ) {
+        int j = nearIndices.getElementDirect( n );
+        
         LiveObject *otherPlayer = 
             players.getElement( j );
         
@@ -8389,8 +8381,22 @@ static int countNonHelpless( GridPos inPos, double inRadius,
                              double inMinAge = 0 ) {
     int c = 0;
     
-    for( int i=0; i<players.size(); i++ ) {
-        LiveObject *p = players.getElement( i );
+    SimpleVector<int> nearIndices;
+    
+    if( inRadius > 1000000 ) {
+        for( int i=0; i<players.size(); i++ ) {
+            nearIndices.push_back( i );
+            }
+        }
+    else {
+        int r = (int)ceil( inRadius );
+        getPlayersNear( inPos.x - r, inPos.y - r, inPos.x + r, inPos.y + r,
+                        &nearIndices );
+        }
+    
+    for( int n=0; n<nearIndices.size(); n++ ) {
+        LiveObject *p = 
+            players.getElement( nearIndices.getElementDirect( n ) );
 
         if( ! isPlayerCountable( p ) ) {
             continue;
@@ -8936,6 +8942,8 @@ int processLoggedInPlayer( int inAllowOrForceReconnect,
                            CurseStatus inCurseStatus,
                            PastLifeStats inLifeStats,
                            float inFitnessScore,
+                           char inBinaryMapChunks,
+                           char inBinaryClientActions,
                            // set to -2 to force Eve
                            int inForceParentID = -1,
                            int inForceDisplayID = -1,
@@ -9022,8 +9030,21 @@ int processLoggedInPlayer( int inAllowOrForceReconnect,
             o->sock = inSock;
             o->sockBuffer = inSockBuffer;
             
+            // anything left over was meant for their old client
+            o->outQueue->clear();
+            o->outQueueProgressTime = Time::getCurrentTime();
+            o->outQueueWatched = false;
+            
             // they are connecting again, need to send them everything again
             o->firstMapSent = false;
+            
+            // new client has nothing cached
+            o->binaryMapChunks = inBinaryMapChunks;
+            o->binaryClientActions = inBinaryClientActions;
+            if( o->chunkSentCache != NULL ) {
+                freeChunkSentCache( o->chunkSentCache );
+                o->chunkSentCache = NULL;
+                }
             o->firstMessageSent = false;
             o->inFlight = false;
 
@@ -9050,6 +9071,8 @@ int processLoggedInPlayer( int inAllowOrForceReconnect,
                     
                     o->xs = holdingPlayer->xs;
                     o->ys = holdingPlayer->ys;
+                    
+                    updatePlayerGrid( o );
                     }
                 }
             
@@ -10807,6 +10830,9 @@ int processLoggedInPlayer( int inAllowOrForceReconnect,
     newObject.pathToDest = NULL;
     newObject.pathTruncated = 0;
     newObject.firstMapSent = false;
+    newObject.binaryMapChunks = inBinaryMapChunks;
+    newObject.binaryClientActions = inBinaryClientActions;
+    newObject.chunkSentCache = NULL;
     newObject.lastSentMapX = 0;
     newObject.lastSentMapY = 0;
     newObject.moveStartTime = Time::getCurrentTime();
@@ -10850,6 +10876,10 @@ int processLoggedInPlayer( int inAllowOrForceReconnect,
     newObject.sock = inSock;
     newObject.sockBuffer = inSockBuffer;
     
+    newObject.outQueue = new OutboundQueue();
+    newObject.outQueueProgressTime = Time::getCurrentTime();
+    newObject.outQueueWatched = false;
+    
     newObject.gotPartOfThisFrame = false;
     
     newObject.isNew = true;
@@ -11339,6 +11369,7 @@ int processLoggedInPlayer( int inAllowOrForceReconnect,
         }
     else {
         players.push_back( newObject );            
+        addLastPlayerToGrid();
         }
 
     if( newObject.isEve ) {
@@ -11536,7 +11567,9 @@ static void processWaitingTwinConnection( FreshConnection inConnection ) {
                                            inConnection.tutorialNumber,
                                            anyTwinCurseLevel,
                                            inConnection.lifeStats,
-                                           inConnection.fitnessScore );
+                                           inConnection.fitnessScore,
+                                           inConnection.binaryMapChunks,
+                                           inConnection.binaryClientActions );
         tempTwinEmails.deleteAll();
         
         if( newID == -1 ) {
@@ -11627,6 +11660,8 @@ static void processWaitingTwinConnection( FreshConnection inConnection ) {
                                    anyTwinCurseLevel,
                                    nextConnection->lifeStats,
                                    nextConnection->fitnessScore,
+                                   nextConnection->binaryMapChunks,
+                                   nextConnection->binaryClientActions,
                                    parent,
                                    displayID,
                                    forcedEvePos,
@@ -11662,6 +11697,7 @@ static void processWaitingTwinConnection( FreshConnection inConnection ) {
                 newTwinPlayer.isTutorial = true;
 
                 players.deleteElement( players.size() - 1 );
+                deletePlayerFromGrid( players.size() );
                 
                 tutorialLoadingPlayers.push_back( newTwinPlayer );
                 }
@@ -13004,9 +13040,8 @@ void sendMessageToPlayer( LiveObject *inPlayer,
         }
 
     int numSent = 
-        inPlayer->sock->send( message, 
-                              len, 
-                              false, false );
+        sendToPlayerSocket( inPlayer, message, 
+                            len );
         
     if( numSent != len ) {
         setPlayerDisconnected( inPlayer, "Socket write failed" );
@@ -13021,6 +13056,412 @@ void sendMessageToPlayer( LiveObject *inPlayer,
 
 
 
+typedef struct ChangePosRegionEntry {
+        int regionX, regionY;
+        int index;
+    } ChangePosRegionEntry;
+
+
+
+// this step's update or move positions, sorted by region, so that each
+// player only looks at positions in regions near them
+// read-only once built, so can be searched from any thread
+typedef struct ChangePosIndex {
+        double regionSize;
+        
+        int numEntries;
+        ChangePosRegionEntry *entries;
+        
+        // global positions go to everyone, and aren't in any region
+        SimpleVector<int> globalIndices;
+    } ChangePosIndex;
+
+
+
+static int compareRegionEntries( const void *inA, const void *inB ) {
+    ChangePosRegionEntry *a = (ChangePosRegionEntry*)inA;
+    ChangePosRegionEntry *b = (ChangePosRegionEntry*)inB;
+    
+    if( a->regionY != b->regionY ) {
+        return ( a->regionY < b->regionY ) ? -1 : 1;
+        }
+    if( a->regionX != b->regionX ) {
+        return ( a->regionX < b->regionX ) ? -1 : 1;
+        }
+    return a->index - b->index;
+    }
+
+
+
+static int getChangePosRegion( int inCoord, double inRegionSize ) {
+    return (int)floor( inCoord / inRegionSize );
+    }
+
+
+
+static void initChangePosIndex( ChangePosIndex *inIndex,
+                                SimpleVector<ChangePosition> *inPositions,
+                                double inRegionSize ) {
+    inIndex->regionSize = inRegionSize;
+    inIndex->numEntries = 0;
+    inIndex->entries = new ChangePosRegionEntry[ inPositions->size() ];
+    
+    for( int i=0; i<inPositions->size(); i++ ) {
+        ChangePosition *p = inPositions->getElement( i );
+        
+        if( p->global ) {
+            inIndex->globalIndices.push_back( i );
+            continue;
+            }
+        
+        ChangePosRegionEntry *e = &( inIndex->entries[ inIndex->numEntries ] );
+        
+        e->regionX = getChangePosRegion( p->x, inRegionSize );
+        e->regionY = getChangePosRegion( p->y, inRegionSize );
+        e->index = i;
+        
+        inIndex->numEntries++;
+        }
+    
+    qsort( inIndex->entries, inIndex->numEntries, 
+           sizeof( ChangePosRegionEntry ), compareRegionEntries );
+    }
+
+
+
+static void freeChangePosIndex( ChangePosIndex *inIndex ) {
+    delete [] inIndex->entries;
+    inIndex->entries = NULL;
+    inIndex->numEntries = 0;
+    inIndex->globalIndices.deleteAll();
+    }
+
+
+
+static int compareIndices( const void *inA, const void *inB ) {
+    return *( (int*)inA ) - *( (int*)inB );
+    }
+
+
+
+// appends indices of all global positions, and all others that might be
+// within inRadius of inX, inY, in increasing order
+// caller must check exact distances
+static void getNearChangePositions( ChangePosIndex *inIndex,
+                                    int inX, int inY, double inRadius,
+                                    SimpleVector<int> *outIndices ) {
+    
+    int startSize = outIndices->size();
+    
+    outIndices->push_back_other( &( inIndex->globalIndices ) );
+    
+    int minRX = getChangePosRegion( (int)floor( inX - inRadius ), 
+                                    inIndex->regionSize );
+    int maxRX = getChangePosRegion( (int)ceil( inX + inRadius ), 
+                                    inIndex->regionSize );
+    int minRY = getChangePosRegion( (int)floor( inY - inRadius ), 
+                                    inIndex->regionSize );
+    int maxRY = getChangePosRegion( (int)ceil( inY + inRadius ), 
+                                    inIndex->regionSize );
+    
+    for( int ry = minRY; ry <= maxRY; ry++ ) {
+        
+        // regions along row are next to each other in sorted entries
+        ChangePosRegionEntry key = { minRX, ry, -1 };
+        
+        int lo = 0;
+        int hi = inIndex->numEntries;
+        
+        while( lo < hi ) {
+            int mid = ( lo + hi ) / 2;
+            
+            if( compareRegionEntries( &( inIndex->entries[ mid ] ), 
+                                      &key ) < 0 ) {
+                lo = mid + 1;
+                }
+            else {
+                hi = mid;
+                }
+            }
+        
+        for( int e = lo; e < inIndex->numEntries; e++ ) {
+            ChangePosRegionEntry *entry = &( inIndex->entries[ e ] );
+            
+            if( entry->regionY != ry || entry->regionX > maxRX ) {
+                break;
+                }
+            outIndices->push_back( entry->index );
+            }
+        }
+    
+    int numFound = outIndices->size() - startSize;
+    
+    if( numFound > 1 ) {
+        qsort( outIndices->getElement( startSize ),
+               numFound, sizeof( int ), compareIndices );
+        }
+    }
+
+
+
+// PU and PM messages for one player, built for all players in parallel
+// before the send loop
+typedef struct PlayerFrameMessages {
+        // false for players that won't get PU or PM messages this step
+        char needed;
+        char built;
+        
+        // where distances to updates and moves are measured from
+        int playerXD, playerYD;
+        
+        GridPos birthPos;
+        GridPos pos;
+        
+        // NULL if nothing close enough
+        unsigned char *updateMessage;
+        int updateMessageLength;
+        
+        unsigned char *moveMessage;
+        int moveMessageLength;
+
+        // greater than maxDist but within maxDist2
+        // for either PU or PM messages, in need of a PO message
+        SimpleVector<int> middleDistancePlayerIDs;
+    } PlayerFrameMessages;
+
+
+
+// this step's updates and moves, read-only while messages are built
+typedef struct FrameMessageSources {
+        SimpleVector<UpdateRecord> *updates;
+        SimpleVector<ChangePosition> *updatesPos;
+        SimpleVector<int> *updatePlayerIDs;
+        
+        SimpleVector<MoveRecord> *moves;
+        SimpleVector<ChangePosition> *movesPos;
+        
+        ChangePosIndex *updatesIndex;
+        ChangePosIndex *movesIndex;
+        
+        PlayerFrameMessages *messages;
+    } FrameMessageSources;
+
+
+
+// touches nothing outside of inSources and ioMessages, so can run on
+// any thread
+static void buildPlayerFrameMessages( FrameMessageSources *inSources,
+                                      PlayerFrameMessages *ioMessages ) {
+    
+    double maxDist = getMaxChunkDimension();
+    double maxDist2 = maxDist * 2;
+    
+    int playerXD = ioMessages->playerXD;
+    int playerYD = ioMessages->playerYD;
+    
+    SimpleVector<int> *middleDistancePlayerIDs = 
+        &( ioMessages->middleDistancePlayerIDs );
+    
+    ioMessages->updateMessage = NULL;
+    ioMessages->updateMessageLength = 0;
+    ioMessages->moveMessage = NULL;
+    ioMessages->moveMessageLength = 0;
+    
+    
+    SimpleVector<UpdateRecord> *newUpdates = inSources->updates;
+    SimpleVector<ChangePosition> *newUpdatesPos = inSources->updatesPos;
+    
+    if( newUpdates->size() > 0 ) {
+        
+        SimpleVector<int> nearUpdates;
+        getNearChangePositions( inSources->updatesIndex, 
+                                playerXD, playerYD, maxDist2,
+                                &nearUpdates );
+
+        double minUpdateDist = maxDist2 * 2;                    
+
+        for( int n=0; n<nearUpdates.size(); n++ ) {
+            int u = nearUpdates.getElementDirect( n );
+            ChangePosition *p = newUpdatesPos->getElement( u );
+                        
+            // update messages can be global when a new
+            // player joins or an old player is deleted
+            if( p->global ) {
+                minUpdateDist = 0;
+                }
+            else {
+                double d = intDist( p->x, p->y, 
+                                    playerXD, 
+                                    playerYD );
+                    
+                if( d < minUpdateDist ) {
+                    minUpdateDist = d;
+                    }
+                if( d > maxDist && d <= maxDist2 ) {
+                    middleDistancePlayerIDs->push_back(
+                        inSources->updatePlayerIDs->getElementDirect( u ) );
+                    }
+                }
+            }
+
+        if( minUpdateDist <= maxDist ) {
+            // some updates close enough
+
+            // compose PU message for this player
+                        
+            SimpleVector<char> updateChars;
+                        
+            for( int n=0; n<nearUpdates.size(); n++ ) {
+                int u = nearUpdates.getElementDirect( n );
+                ChangePosition *p = newUpdatesPos->getElement( u );
+                        
+                double d = intDist( p->x, p->y, 
+                                    playerXD, playerYD );
+                            
+                if( ! p->global && d > maxDist ) {
+                    // skip this one, too far away
+                    continue;
+                    }
+
+                if( p->global &&  d > maxDist ) {
+                    // out of range global updates should
+                    // also be followed by PO message
+                    middleDistancePlayerIDs->push_back(
+                        inSources->updatePlayerIDs->getElementDirect( u ) );
+                    }
+                            
+                            
+                char *line =
+                    getUpdateLineFromRecord( 
+                        newUpdates->getElement( u ),
+                        ioMessages->birthPos,
+                        ioMessages->pos );
+                            
+                updateChars.appendElementString( line );
+                delete [] line;
+                }
+                        
+
+            if( updateChars.size() > 0 ) {
+                updateChars.push_back( '#' );
+                char *temp = updateChars.getElementString();
+
+                char *updateMessageText = 
+                    concatonate( "PU\n", temp );
+                delete [] temp;
+                            
+                int updateMessageLength = strlen( updateMessageText );
+
+                if( updateMessageLength < maxUncompressedSize ) {
+                    ioMessages->updateMessage = 
+                        (unsigned char*)updateMessageText;
+                    }
+                else {
+                    ioMessages->updateMessage = makeCompressedMessage( 
+                        updateMessageText, 
+                        updateMessageLength, &updateMessageLength );
+                
+                    delete [] updateMessageText;
+                    }
+                ioMessages->updateMessageLength = updateMessageLength;
+                }
+            }
+        }
+
+
+
+    SimpleVector<MoveRecord> *moveList = inSources->moves;
+    SimpleVector<ChangePosition> *movesPos = inSources->movesPos;
+    
+    if( moveList->size() > 0 ) {
+        
+        SimpleVector<int> nearMoves;
+        getNearChangePositions( inSources->movesIndex, 
+                                playerXD, playerYD, maxDist2,
+                                &nearMoves );
+                    
+        double minUpdateDist = maxDist2;
+                    
+        for( int n=0; n<nearMoves.size(); n++ ) {
+            int u = nearMoves.getElementDirect( n );
+            ChangePosition *p = movesPos->getElement( u );
+                        
+            // move messages are never global
+
+            double d = intDist( p->x, p->y, 
+                                playerXD, playerYD );
+                    
+            if( d < minUpdateDist ) {
+                minUpdateDist = d;
+                }
+            if( d > maxDist && d <= maxDist2 ) {
+                middleDistancePlayerIDs->push_back(
+                    moveList->getElement( u )->playerID );
+                }
+            }
+
+        if( minUpdateDist <= maxDist ) {
+                        
+            SimpleVector<MoveRecord> closeMoves;
+                        
+            for( int n=0; n<nearMoves.size(); n++ ) {
+                int u = nearMoves.getElementDirect( n );
+                ChangePosition *p = movesPos->getElement( u );
+                            
+                // move messages are never global
+                            
+                double d = intDist( p->x, p->y, 
+                                    playerXD, playerYD );
+                    
+                if( d > maxDist ) {
+                    continue;
+                    }
+                closeMoves.push_back( 
+                    moveList->getElementDirect( u ) );
+                }
+                        
+            if( closeMoves.size() > 0 ) {
+                            
+                char *moveMessageText = getMovesMessageFromList( 
+                    &closeMoves, ioMessages->birthPos );
+                        
+                if( moveMessageText != NULL ) {
+                    int moveMessageLength = strlen( moveMessageText );
+                    
+                    if( moveMessageLength > maxUncompressedSize ) {
+                        ioMessages->moveMessage = makeCompressedMessage( 
+                            moveMessageText,
+                            moveMessageLength,
+                            &moveMessageLength );
+                        delete [] moveMessageText;
+                        }
+                    else {
+                        ioMessages->moveMessage = 
+                            (unsigned char*)moveMessageText;
+                        }
+                    ioMessages->moveMessageLength = moveMessageLength;
+                    }
+                }
+            }
+        }
+    
+    ioMessages->built = true;
+    }
+
+
+
+static void buildPlayerFrameMessagesTask( int inIndex, void *inData ) {
+    FrameMessageSources *sources = (FrameMessageSources*)inData;
+    
+    PlayerFrameMessages *m = &( sources->messages[ inIndex ] );
+    
+    if( m->needed ) {
+        buildPlayerFrameMessages( sources, m );
+        }
+    }
+
+
+
 // result destroyed by caller
 static char *getWarReportMessage() {
     SimpleVector<char> workingMessage;
@@ -13407,9 +13848,13 @@ LiveObject *getClosestOtherPlayer( LiveObject *inThisPlayer,
     double closestDist = 20;
     LiveObject *closestOther = NULL;
     
-    for( int j=0; j<players.size(); j++ ) {
+    SimpleVector<int> nearIndices;
+    getPlayersNear( thisPos.x - 20, thisPos.y - 20, 
+                    thisPos.x + 20, thisPos.y + 20, &nearIndices );
+    
+    for( int n=0; n<nearIndices.size(); n++ ) {
         LiveObject *otherPlayer = 
-            players.getElement(j);
+            players.getElement( nearIndices.getElementDirect( n ) );
         
         if( otherPlayer != inThisPlayer &&
             ! otherPlayer->error &&
@@ -13674,10 +14119,9 @@ void apocalypseStep() {
                 if( !nextPlayer->error && nextPlayer->connected ) {
                     
                     int numSent = 
-                        nextPlayer->sock->send( 
+                        sendToPlayerSocket( nextPlayer, 
                             (unsigned char*)message, 
-                            messageLength,
-                            false, false );
+                            messageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -13825,10 +14269,9 @@ void apocalypseStep() {
                         if( !nextPlayer->error && nextPlayer->connected ) {
                     
                             int numSent = 
-                                nextPlayer->sock->send( 
+                                sendToPlayerSocket( nextPlayer, 
                                     (unsigned char*)message, 
-                                    messageLength,
-                                    false, false );
+                                    messageLength );
                             
                             nextPlayer->gotPartOfThisFrame = true;
                     
@@ -13881,10 +14324,9 @@ void monumentStep() {
 
 
                 int numSent = 
-                    nextPlayer->sock->send( 
+                    sendToPlayerSocket( nextPlayer, 
                         (unsigned char*)message, 
-                        messageLength,
-                        false, false );
+                        messageLength );
                 
                 nextPlayer->gotPartOfThisFrame = true;
                 
@@ -18386,7 +18828,7 @@ int main() {
 
 
     // make backup and delete old backup every day
-    AppLog::setLog( new FileLog( "log.txt", 86400 ) );
+    AppLog::setLog( new AsyncFileLog( "log.txt", 86400 ) );
 
     AppLog::setLoggingLevel( Log::DETAIL_LEVEL );
     AppLog::printAllMessages( true );
@@ -18394,6 +18836,8 @@ int main() {
     printf( "\n" );
     AppLog::info( "Server starting up" );
 
+    initLogWriter();
+
     printf( "\n" );
     
     
@@ -18715,6 +19159,25 @@ int main() {
         return 1;
         }
     
+    mapChunkBuildThreads = 
+        SettingsManager::getIntSetting( "mapChunkBuildThreads", 0 );
+    
+    initChunkBuilder( mapChunkBuildThreads );
+    
+    initTaskScheduler( 
+        SettingsManager::getIntSetting( "stepTaskThreads", 0 ) );
+    
+    maxOutboundQueueBytes =
+        SettingsManager::getIntSetting( "maxOutboundQueueBytes", 4194304 );
+    outboundQueueDeferBytes =
+        SettingsManager::getIntSetting( "outboundQueueDeferBytes", 262144 );
+    outboundQueueStallSeconds =
+        SettingsManager::getFloatSetting( "outboundQueueStallSeconds", 30 );
+    outboundStatsLogSeconds =
+        SettingsManager::getFloatSetting( "outboundStatsLogSeconds", 300 );
+    
+    initPlayerGrid();
+    
 
 
     if( false ) {
@@ -18889,10 +19352,9 @@ int main() {
                     }
 
                 if( nextPlayer->connected ) {    
-                    nextPlayer->sock->send( 
+                    sendToPlayerSocket( nextPlayer, 
                         (unsigned char*)shutdownMessage, 
-                        messageLength,
-                        false, false );
+                        messageLength );
                 
                     nextPlayer->gotPartOfThisFrame = true;
                     }
@@ -18991,6 +19453,7 @@ int main() {
 
             stepFoodLog();
             stepFailureLog();
+            stepLogWriter();
             
             stepPlayerStats();
             stepLineageLog();
@@ -19484,6 +19947,10 @@ int main() {
 
                 newConnection.email = NULL;
 
+                // outbound queue is flushed once per step, so every
+                // send should go out NOW
+                sock->setAlwaysNoDelay( true );
+
                 newConnection.sock = sock;
 
                 newConnection.sequenceNumber = nextSequenceNumber;
@@ -19519,6 +19986,9 @@ int main() {
                 
                 newConnection.clientTag = NULL;
                 
+                newConnection.binaryMapChunks = false;
+                newConnection.binaryClientActions = false;
+                
                 nextSequenceNumber ++;
                 
                 SettingsManager::setSetting( "sequenceNumber",
@@ -19788,6 +20258,11 @@ int main() {
                 // token spent successfully (or token server not used)
 
                 const char *message = "ACCEPTED\n#";
+                
+                if( nextConnection->binaryClientActions ) {
+                    // echo tag back so client knows it can send them
+                    message = "ACCEPTED\n" BINARY_CLIENT_ACTION_TAG "\n#";
+                    }
                 int messageLength = strlen( message );
                 
                 int numSent = 
@@ -19857,7 +20332,9 @@ int main() {
                             nextConnection->tutorialNumber,
                             nextConnection->curseStatus,
                             nextConnection->lifeStats,
-                            nextConnection->fitnessScore );
+                            nextConnection->fitnessScore,
+                            nextConnection->binaryMapChunks,
+                            nextConnection->binaryClientActions );
                         }
                                                         
                     newConnections.deleteElement( i );
@@ -19955,6 +20432,24 @@ int main() {
                                 tokens->getElementDirect( 1 );
                             
                             tokens->deleteElement( 1 );
+                            
+                            if( strstr( nextConnection->clientTag,
+                                        BINARY_MAP_CHUNK_CLIENT_TAG ) 
+                                != NULL ) {
+                                
+                                nextConnection->binaryMapChunks =
+                                    SettingsManager::getIntSetting( 
+                                        "allowBinaryMapChunks", 0 );
+                                }
+                            
+                            if( strstr( nextConnection->clientTag,
+                                        BINARY_CLIENT_ACTION_TAG ) 
+                                != NULL ) {
+                                
+                                nextConnection->binaryClientActions =
+                                    SettingsManager::getIntSetting( 
+                                        "allowBinaryClientActions", 0 );
+                                }
                             }
 
                         if( tokens->size() == 4 || tokens->size() == 5 ||
@@ -20090,6 +20585,11 @@ int main() {
                                 // let them in without checking
                                 
                                 const char *message = "ACCEPTED\n#";
+                                
+                                if( nextConnection->binaryClientActions ) {
+                                    message = "ACCEPTED\n" 
+                                        BINARY_CLIENT_ACTION_TAG "\n#";
+                                    }
                                 int messageLength = strlen( message );
                 
                                 int numSent = 
@@ -20152,7 +20652,11 @@ int main() {
                                             nextConnection->tutorialNumber,
                                             nextConnection->curseStatus,
                                             nextConnection->lifeStats,
-                                            nextConnection->fitnessScore );
+                                            nextConnection->fitnessScore,
+                                            nextConnection->
+                                                binaryMapChunks,
+                                            nextConnection->
+                                                binaryClientActions );
                                         }
                                                                         
                                     newConnections.deleteElement( i );
@@ -20331,6 +20835,7 @@ int main() {
             
 
             players.push_back( *nextPlayer );
+            addLastPlayerToGrid();
 
             tutorialLoadingPlayers.deleteElement( i );
             
@@ -20348,6 +20853,7 @@ int main() {
                                uniqueID );
             
                 players.push_back( *twinPlayer );
+                addLastPlayerToGrid();
 
                 tutorialLoadingPlayers.deleteElement( i );
                 
@@ -20697,6 +21203,9 @@ int main() {
 
             char *message = NULL;
             
+            ClientMessage binaryMessage;
+            char binaryMessageReady = false;
+            
             if( nextPlayer->connected ) {    
                 char result = 
                     readSocketFull( nextPlayer->sock, nextPlayer->sockBuffer );
@@ -20707,20 +21216,52 @@ int main() {
                 else {
                     // don't even bother parsing message buffer for players
                     // that are not currently connected
-                    message = getNextClientMessage( nextPlayer->sockBuffer );
+                    binaryClientFrameStatus frameStatus = BINARY_FRAME_NONE;
+                    
+                    if( nextPlayer->binaryClientActions ) {
+                        frameStatus = 
+                            getNextBinaryClientMessage( 
+                                nextPlayer->sockBuffer,
+                                nextPlayer->birthPos,
+                                &binaryMessage,
+                                binaryMessageText );
+                        }
+                    
+                    if( frameStatus == BINARY_FRAME_READY ) {
+                        binaryMessageReady = true;
+                        }
+                    else if( frameStatus == BINARY_FRAME_BAD ) {
+                        setPlayerDisconnected( nextPlayer, 
+                                               "Malformed binary message" );
+                        }
+                    else if( frameStatus == BINARY_FRAME_NONE ) {
+                        message = 
+                            getNextClientMessage( nextPlayer->sockBuffer );
+                        }
                     }
                 }
             
             
-            if( message != NULL ) {
+            if( message != NULL || binaryMessageReady ) {
                 someClientMessageReceived = true;
                 
-                AppLog::infoF( "Got client message from %d: %s",
-                               nextPlayer->id, message );
+                ClientMessage m;
+                
+                if( binaryMessageReady ) {
+                    m = binaryMessage;
+                    
+                    // same line as for text, so logs replay either way
+                    AppLog::infoF( "Got client message from %d: %s",
+                                   nextPlayer->id, binaryMessageText );
+                    }
+                else {
+                    AppLog::infoF( "Got client message from %d: %s",
+                                   nextPlayer->id, message );
                 
-                ClientMessage m = parseMessage( nextPlayer, message );
+                    m = parseMessage( nextPlayer->birthPos, message );
                 
-                delete [] message;
+                    delete [] message;
+                    }
                 
 
                 //Thread::staticSleep( 
@@ -20833,9 +21374,8 @@ int main() {
                                              &length );
                         
                         int numSent = 
-                            nextPlayer->sock->send( mapChunkMessage, 
-                                                    length, 
-                                                    false, false );
+                            sendToPlayerSocket( nextPlayer, mapChunkMessage, 
+                                                length );
                         
                         nextPlayer->gotPartOfThisFrame = true;
                         
@@ -20925,6 +21465,8 @@ int main() {
 
                         nextPlayer->xs = o.x;
                         nextPlayer->ys = o.y;
+                        
+                        updatePlayerGrid( nextPlayer );
 
                         if( distance( oldPos, o ) > 10000 ) {
                             nextPlayer->birthPos = o;
@@ -20982,6 +21524,8 @@ int main() {
                         nextPlayer->xs = o.x;
                         nextPlayer->ys = o.y;
                         
+                        updatePlayerGrid( nextPlayer );
+                        
                         if( distance( oldPos, o ) > 10000 ) {
                             nextPlayer->birthPos = o;
                             }
@@ -21008,6 +21552,8 @@ int main() {
                         nextPlayer->xs = m.x;
                         nextPlayer->ys = m.y;
                         
+                        updatePlayerGrid( nextPlayer );
+                        
                         char *message = autoSprintf( "VU\n%d %d\n#",
                                                      nextPlayer->xs - 
                                                      nextPlayer->birthPos.x,
@@ -21055,6 +21601,8 @@ int main() {
                         nextPlayer->xs = p.x;
                         nextPlayer->ys = p.y;
                         
+                        updatePlayerGrid( nextPlayer );
+                        
                         nextPlayer->birthPos = nextPlayer->preVogBirthPos;
 
                         // send them one last VU message to move them 
@@ -21874,6 +22422,8 @@ int main() {
                         nextPlayer->xd = nextPlayer->xs;
                         nextPlayer->yd = nextPlayer->ys;
                         
+                        updatePlayerGrid( nextPlayer );
+                        
                         nextPlayer->posForced = true;
                         
                         // send update about them to end the move
@@ -21960,6 +22510,7 @@ int main() {
                             nextPlayer->xs = cPos.x;
                             nextPlayer->ys = cPos.y;
                             
+                            updatePlayerGrid( nextPlayer );
                             
                             char cOnTheirNewPath = false;
                             
@@ -22129,6 +22680,8 @@ int main() {
                         nextPlayer->xd = m.extraPos[ m.numExtraPos - 1].x;
                         nextPlayer->yd = m.extraPos[ m.numExtraPos - 1].y;
                         
+                        updatePlayerGrid( nextPlayer );
+                        
 
                         if( distance( nextPlayer->lastPlayerUpdateAbsolutePos,
                                       m.extraPos[ m.numExtraPos - 1] ) 
@@ -22291,6 +22844,8 @@ int main() {
                                 nextPlayer->xd = nextPlayer->xs;
                                 nextPlayer->yd = nextPlayer->ys;
                                 
+                                updatePlayerGrid( nextPlayer );
+                                
                                 nextPlayer->posForced = true;
 
                                 // send update about them to end the move
@@ -22320,6 +22875,8 @@ int main() {
                                 nextPlayer->yd = 
                                     nextPlayer->pathToDest[ 
                                         nextPlayer->pathLength - 1 ].y;
+                                
+                                updatePlayerGrid( nextPlayer );
 
                                 // distance is number of orthogonal steps
                             
@@ -25483,6 +26040,8 @@ int main() {
                                         hitPlayer->xs = m.x;
                                         hitPlayer->ys = m.y;
                                         
+                                        updatePlayerGrid( hitPlayer );
+                                        
                                         // but don't send an update
                                         // about this
                                         // (everyone will get the pick-up
@@ -26969,19 +27528,7 @@ int main() {
                         } 
                     }
                 
-                if( m.numExtraPos > 0 ) {
-                    delete [] m.extraPos;
-                    }
-                
-                if( m.saidText != NULL ) {
-                    delete [] m.saidText;
-                    }
-                if( m.voteGithubUsername != NULL ) {
-                    delete [] m.voteGithubUsername;
-                    }
-                if( m.bugText != NULL ) {
-                    delete [] m.bugText;
-                    }
+                freeClientMessage( &m );
                 }
             }
 
@@ -28310,6 +28857,8 @@ int main() {
                         // done
                         nextPlayer->xs = nextPlayer->xd;
                         nextPlayer->ys = nextPlayer->yd;                        
+                        
+                        updatePlayerGrid( nextPlayer );
 
                         printf( "Player %d's move is done at %d,%d\n",
                                 nextPlayer->id,
@@ -28539,6 +29088,8 @@ int main() {
                                 nextPlayer->xs = destPos.x;
                                 nextPlayer->yd = destPos.y;
                                 nextPlayer->ys = destPos.y;
+                                
+                                updatePlayerGrid( nextPlayer );
 
                                 // reset their birth location
                                 // their landing position becomes their
@@ -28801,6 +29352,12 @@ int main() {
             
             
             // recompute heat map here for next players in line
+            
+            // gather from map here, then do the math for all of them
+            // in parallel
+            HeatMapInput heatInputs[ numPlayersRecomputeHeatPerStep ];
+            int numHeatInputs = 0;
+
             int r = 0;
             for( r=lastPlayerIndexHeatRecomputed+1; 
                  r < lastPlayerIndexHeatRecomputed + 1 + 
@@ -28808,9 +29365,13 @@ int main() {
                      &&
                      r < players.size(); r++ ) {
                 
-                recomputeHeatMap( players.getElement( r ) );
+                gatherHeatMapInput( players.getElement( r ),
+                                    &( heatInputs[ numHeatInputs ] ) );
+                numHeatInputs++;
                 }
             
+            parallelFor( numHeatInputs, computeHeatMapTask, heatInputs );
+            
             lastPlayerIndexHeatRecomputed = r - 1;
             
             if( r >= players.size() ) {
@@ -29104,6 +29665,9 @@ int main() {
         // mixed with player-caused changes
         stepMap( &mapChanges, &mapChangesPos );
         
+        // encode once for all players, below
+        setMapChangeBroadcast( &mapChanges, getMaxChunkDimension() );
+        
         
 
         
@@ -29589,6 +30153,64 @@ int main() {
         SimpleVector<int> playersReceivingPlayerUpdate;
         
 
+        prebuildMapChunks();
+        
+
+        // build and compress PU and PM messages for everyone in parallel
+        // ahead of the send loop, which just sends them
+        PlayerFrameMessages *frameMessages = 
+            new PlayerFrameMessages[ numLive ];
+        
+        // regions as big as the farthest distance players look at
+        ChangePosIndex updatesIndex;
+        initChangePosIndex( &updatesIndex, &newUpdatesPos, 
+                            getMaxChunkDimension() * 2 );
+        
+        ChangePosIndex movesIndex;
+        initChangePosIndex( &movesIndex, &movesPos, 
+                            getMaxChunkDimension() * 2 );
+        
+        FrameMessageSources frameSources = 
+            { &newUpdates, &newUpdatesPos, &newUpdatePlayerIDs,
+              &moveList, &movesPos,
+              &updatesIndex, &movesIndex,
+              frameMessages };
+        
+        for( int p=0; p<numLive; p++ ) {
+            LiveObject *nextPlayer = players.getElement( p );
+            PlayerFrameMessages *m = &( frameMessages[p] );
+            
+            m->built = false;
+            m->updateMessage = NULL;
+            m->moveMessage = NULL;
+            m->needed = 
+                ( newUpdates.size() > 0 || moveList.size() > 0 ) &&
+                nextPlayer->firstMessageSent &&
+                nextPlayer->connected;
+            
+            m->playerXD = nextPlayer->xd;
+            m->playerYD = nextPlayer->yd;
+            
+            if( nextPlayer->heldByOther ) {
+                LiveObject *holdingPlayer = 
+                    getLiveObject( nextPlayer->heldByOtherID );
+                
+                if( holdingPlayer != NULL ) {
+                    m->playerXD = holdingPlayer->xd;
+                    m->playerYD = holdingPlayer->yd;
+                    }
+                }
+            
+            m->birthPos = nextPlayer->birthPos;
+            m->pos = getPlayerPos( nextPlayer );
+            }
+        
+        parallelFor( numLive, buildPlayerFrameMessagesTask, &frameSources );
+        
+        freeChangePosIndex( &updatesIndex );
+        freeChangePosIndex( &movesIndex );
+
+        
         for( int p=0; p<numLive; p++ ) {
             
             LiveObject *nextPlayer = players.getElement(p);
@@ -29962,10 +30584,9 @@ int main() {
                 unsigned char *followM = getFollowingMessage( true, &followL );
                 
                 if( followM != NULL && nextPlayer->connected ) {
-                    nextPlayer->sock->send( 
+                    sendToPlayerSocket( nextPlayer, 
                         followM, 
-                        followL, 
-                        false, false );
+                        followL );
                     delete [] followM;
                     }
 
@@ -29976,10 +30597,9 @@ int main() {
                 unsigned char *exileM = getExileMessage( true, &exileL );
                 
                 if( exileM != NULL && nextPlayer->connected ) {
-                    nextPlayer->sock->send( 
+                    sendToPlayerSocket( nextPlayer, 
                         exileM, 
-                        exileL, 
-                        false, false );
+                        exileL );
                     delete [] exileM;
                     }
                 
@@ -30328,14 +30948,18 @@ int main() {
                     }
 
 
-                if( abs( playerXD - nextPlayer->lastSentMapX ) > 7
-                    ||
-                    abs( playerYD - nextPlayer->lastSentMapY ) > 8 
-                    ||
-                    ! nextPlayer->firstMapSent ) {
+                if( ( abs( playerXD - nextPlayer->lastSentMapX ) > 7
+                      ||
+                      abs( playerYD - nextPlayer->lastSentMapY ) > 8 
+                      ||
+                      ! nextPlayer->firstMapSent )
+                    &&
+                    ! isOutboundQueueBackedUp( nextPlayer ) ) {
                 
                     // moving out of bounds of chunk, send update
                     // or player flagged as needing first map again
+                    // (waits while client is behind on what we've sent,
+                    //  so we don't repeat player updates each step)
                     
                     sendMapChunkMessage( nextPlayer,
                                          // override if held
@@ -30415,9 +31039,19 @@ int main() {
 
                     // (so their held status overrides the baby's stale
                     //  position status).
-                    for( int j=0; j<numLive; j++ ) {
+                    int chunkRadius = getMaxChunkDimension() / 2;
+                    
+                    SimpleVector<int> nearIndices;
+                    getPlayersNear( playerXD - chunkRadius,
+                                    playerYD - chunkRadius,
+                                    playerXD + chunkRadius,
+                                    playerYD + chunkRadius,
+                                    &nearIndices );
+                    
+                    for( int n=0; n<nearIndices.size(); n++ ) {
                         LiveObject *otherPlayer = 
-                            players.getElement( j );
+                            players.getElement( 
+                                nearIndices.getElementDirect( n ) );
                         
                         if( otherPlayer->error ||
                             otherPlayer->vogMode ) {
@@ -30583,10 +31217,9 @@ int main() {
                 // are holding post-wound come later                
                 if( dyingMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
+                        sendToPlayerSocket( nextPlayer, 
                             dyingMessage, 
-                            dyingMessageLength, 
-                            false, false );
+                            dyingMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
 
@@ -30600,10 +31233,9 @@ int main() {
                 // EVERYONE gets info about now-healed players           
                 if( healingMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
+                        sendToPlayerSocket( nextPlayer, 
                             healingMessage, 
-                            healingMessageLength, 
-                            false, false );
+                            healingMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -30618,10 +31250,9 @@ int main() {
                 // EVERYONE gets info about new ghost players           
                 if( ghostMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
+                        sendToPlayerSocket( nextPlayer, 
                             ghostMessage, 
-                            ghostMessageLength, 
-                            false, false );
+                            ghostMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -30636,10 +31267,9 @@ int main() {
                 // EVERYONE gets info about emots           
                 if( emotMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
+                        sendToPlayerSocket( nextPlayer, 
                             emotMessage, 
-                            emotMessageLength, 
-                            false, false );
+                            emotMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -30653,10 +31283,9 @@ int main() {
                 // everyone gets wiggle message
                 if( wiggleMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
+                        sendToPlayerSocket( nextPlayer, 
                             (unsigned char*)wiggleMessage, 
-                            wiggleMessageLength, 
-                            false, false );
+                            wiggleMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -30675,199 +31304,53 @@ int main() {
                 // w/o ever stopping to create a PU message)
                 SimpleVector<int> middleDistancePlayerIDs;
                 
-
-
-
-                if( newUpdates.size() > 0 && nextPlayer->connected ) {
-
-                    double minUpdateDist = maxDist2 * 2;                    
-
-                    for( int u=0; u<newUpdatesPos.size(); u++ ) {
-                        ChangePosition *p = newUpdatesPos.getElement( u );
-                        
-                        // update messages can be global when a new
-                        // player joins or an old player is deleted
-                        if( p->global ) {
-                            minUpdateDist = 0;
-                            }
-                        else {
-                            double d = intDist( p->x, p->y, 
-                                                playerXD, 
-                                                playerYD );
-                    
-                            if( d < minUpdateDist ) {
-                                minUpdateDist = d;
-                                }
-                            if( d > maxDist && d <= maxDist2 ) {
-                                middleDistancePlayerIDs.push_back(
-                                    newUpdatePlayerIDs.getElementDirect( u ) );
-                                }
-                            }
-                        }
-
-                    if( minUpdateDist <= maxDist ) {
-                        // some updates close enough
-
-                        // compose PU message for this player
-                        
-                        unsigned char *updateMessage = NULL;
-                        int updateMessageLength = 0;
-                        SimpleVector<char> updateChars;
-                        
-                        for( int u=0; u<newUpdates.size(); u++ ) {
-                            ChangePosition *p = newUpdatesPos.getElement( u );
-                        
-                            double d = intDist( p->x, p->y, 
-                                                playerXD, playerYD );
-                            
-                            if( ! p->global && d > maxDist ) {
-                                // skip this one, too far away
-                                continue;
-                                }
-
-                            if( p->global &&  d > maxDist ) {
-                                // out of range global updates should
-                                // also be followed by PO message
-                                middleDistancePlayerIDs.push_back(
-                                    newUpdatePlayerIDs.getElementDirect( u ) );
-                                }
-                            
-                            
-                            char *line =
-                                getUpdateLineFromRecord( 
-                                    newUpdates.getElement( u ),
-                                    nextPlayer->birthPos,
-                                    getPlayerPos( nextPlayer ) );
-                            
-                            updateChars.appendElementString( line );
-                            delete [] line;
-                            }
-                        
-
-                        if( updateChars.size() > 0 ) {
-                            updateChars.push_back( '#' );
-                            char *temp = updateChars.getElementString();
-
-                            char *updateMessageText = 
-                                concatonate( "PU\n", temp );
-                            delete [] temp;
-                            
-                            updateMessageLength = strlen( updateMessageText );
-
-                            if( updateMessageLength < maxUncompressedSize ) {
-                                updateMessage = 
-                                    (unsigned char*)updateMessageText;
-                                }
-                            else {
-                                updateMessage = makeCompressedMessage( 
-                                    updateMessageText, 
-                                    updateMessageLength, &updateMessageLength );
                 
-                                delete [] updateMessageText;
-                                }
-                            }
-
-                        if( updateMessage != NULL ) {
-                            playersReceivingPlayerUpdate.push_back( 
-                                nextPlayer->id );
-                            
-                            int numSent = 
-                                nextPlayer->sock->send( 
-                                    updateMessage, 
-                                    updateMessageLength, 
-                                    false, false );
-                            
-                            nextPlayer->gotPartOfThisFrame = true;
-                            
-                            delete [] updateMessage;
-                            
-                            if( numSent != updateMessageLength ) {
-                                setPlayerDisconnected( nextPlayer, 
-                                                       "Socket write failed" );
-                                }
-                            }
-                        }
+                PlayerFrameMessages *frame = &( frameMessages[p] );
+                
+                if( ! frame->built && nextPlayer->connected ) {
+                    // not expected to get messages when they were built
+                    buildPlayerFrameMessages( &frameSources, frame );
                     }
+                
+                if( nextPlayer->connected ) {
+                    middleDistancePlayerIDs.push_back_other(
+                        &( frame->middleDistancePlayerIDs ) );
+                    }
+                
 
-
-
-
-                if( moveList.size() > 0 && nextPlayer->connected ) {
+                if( frame->updateMessage != NULL && 
+                    nextPlayer->connected ) {
                     
-                    double minUpdateDist = getMaxChunkDimension() * 2;
+                    playersReceivingPlayerUpdate.push_back( 
+                        nextPlayer->id );
                     
-                    for( int u=0; u<movesPos.size(); u++ ) {
-                        ChangePosition *p = movesPos.getElement( u );
-                        
-                        // move messages are never global
-
-                        double d = intDist( p->x, p->y, 
-                                            playerXD, playerYD );
+                    int numSent = 
+                        sendToPlayerSocket( nextPlayer, 
+                                            frame->updateMessage, 
+                                            frame->updateMessageLength );
                     
-                        if( d < minUpdateDist ) {
-                            minUpdateDist = d;
-                            }
-                        if( d > maxDist && d <= maxDist2 ) {
-                            middleDistancePlayerIDs.push_back(
-                                moveList.getElement( u )->playerID );
-                            }
+                    nextPlayer->gotPartOfThisFrame = true;
+                    
+                    if( numSent != frame->updateMessageLength ) {
+                        setPlayerDisconnected( nextPlayer, 
+                                               "Socket write failed" );
                         }
+                    }
+                
 
-                    if( minUpdateDist <= maxDist ) {
-                        
-                        SimpleVector<MoveRecord> closeMoves;
-                        
-                        for( int u=0; u<movesPos.size(); u++ ) {
-                            ChangePosition *p = movesPos.getElement( u );
-                            
-                            // move messages are never global
-                            
-                            double d = intDist( p->x, p->y, 
-                                                playerXD, playerYD );
+                if( frame->moveMessage != NULL && 
+                    nextPlayer->connected ) {
                     
-                            if( d > maxDist ) {
-                                continue;
-                                }
-                            closeMoves.push_back( 
-                                moveList.getElementDirect( u ) );
-                            }
-                        
-                        if( closeMoves.size() > 0 ) {
-                            
-                            char *moveMessageText = getMovesMessageFromList( 
-                                &closeMoves, nextPlayer->birthPos );
-                        
-                            unsigned char *moveMessage = NULL;
-                            int moveMessageLength = 0;
-        
-                            if( moveMessageText != NULL ) {
-                                moveMessage = (unsigned char*)moveMessageText;
-                                moveMessageLength = strlen( moveMessageText );
-
-                                if( moveMessageLength > maxUncompressedSize ) {
-                                    moveMessage = makeCompressedMessage( 
-                                        moveMessageText,
-                                        moveMessageLength,
-                                        &moveMessageLength );
-                                    delete [] moveMessageText;
-                                    }    
-                                }
-
-                            int numSent = 
-                                nextPlayer->sock->send( 
-                                    moveMessage, 
-                                    moveMessageLength, 
-                                    false, false );
-                            
-                            nextPlayer->gotPartOfThisFrame = true;
-                            
-                            delete [] moveMessage;
-                            
-                            if( numSent != moveMessageLength ) {
-                                setPlayerDisconnected( nextPlayer, 
-                                                       "Socket write failed" );
-                                }
-                            }
+                    int numSent = 
+                        sendToPlayerSocket( nextPlayer, 
+                                            frame->moveMessage, 
+                                            frame->moveMessageLength );
+                    
+                    nextPlayer->gotPartOfThisFrame = true;
+                    
+                    if( numSent != frame->moveMessageLength ) {
+                        setPlayerDisconnected( nextPlayer, 
+                                               "Socket write failed" );
                         }
                     }
                 
@@ -30921,10 +31404,9 @@ int main() {
                         }
                         
                     int numSent = 
-                        nextPlayer->sock->send( 
+                        sendToPlayerSocket( nextPlayer, 
                             outOfRangeMessage, 
-                            outOfRangeMessageLength, 
-                            false, false );
+                            outOfRangeMessageLength );
                         
                     nextPlayer->gotPartOfThisFrame = true;
 
@@ -30940,63 +31422,36 @@ int main() {
 
                 
                 if( mapChanges.size() > 0 && nextPlayer->connected ) {
-                    double minUpdateDist = getMaxChunkDimension() * 2;
                     
-                    for( int u=0; u<mapChangesPos.size(); u++ ) {
-                        ChangePosition *p = mapChangesPos.getElement( u );
-                        
-                        // map changes are never global
-
-                        double d = intDist( p->x, p->y, 
-                                            playerXD, playerYD );
-                        
-                        if( d < minUpdateDist ) {
-                            minUpdateDist = d;
-                            }
-                        }
-
-                    if( minUpdateDist <= maxDist ) {
+                    // map changes are never global
+                    SimpleVector<int> nearChanges;
+                    
+                    getNearbyMapChanges( playerXD, playerYD, maxDist,
+                                         &nearChanges );
+                    
+                    if( nearChanges.size() > 0 ) {
                         // at least one thing in map change list is close
                         // enough to this player
 
-                        // format custom map change message for this player
-                        
-                        
-                        unsigned char *mapChangeMessage = NULL;
+                        // other players with same birth pos that are
+                        // near the same changes get same message
                         int mapChangeMessageLength = 0;
-                        SimpleVector<char> mapChangeChars;
-
-                        for( int u=0; u<mapChanges.size(); u++ ) {
-                            ChangePosition *p = mapChangesPos.getElement( u );
-                        
-                            double d = intDist( p->x, p->y, 
-                                                playerXD, playerYD );
-                            
-                            if( d > maxDist ) {
-                                // skip this one, too far away
-                                continue;
-                                }
-                            MapChangeRecord *r = 
-                                mapChanges.getElement( u );
-                            
-                            char *lineString =
-                                getMapChangeLineString( 
-                                    r,
-                                    nextPlayer->birthPos.x,
-                                    nextPlayer->birthPos.y );
-                            
-                            mapChangeChars.appendElementString( lineString );
-                            delete [] lineString;
-                            }
                         
+                        unsigned char *mapChangeMessage = 
+                            getSharedMapChangeMessage( 
+                                &nearChanges, 
+                                nextPlayer->birthPos.x,
+                                nextPlayer->birthPos.y,
+                                &mapChangeMessageLength );
                         
-                        if( mapChangeChars.size() > 0 ) {
-                            mapChangeChars.push_back( '#' );
-                            char *temp = mapChangeChars.getElementString();
-
+                        if( mapChangeMessage == NULL ) {
+                            // format custom map change message for 
+                            // this player
                             char *mapChangeMessageText = 
-                                concatonate( "MX\n", temp );
-                            delete [] temp;
+                                getMapChangeMessageText( 
+                                    &nearChanges,
+                                    nextPlayer->birthPos.x,
+                                    nextPlayer->birthPos.y );
 
                             mapChangeMessageLength = 
                                 strlen( mapChangeMessageText );
@@ -31014,25 +31469,25 @@ int main() {
                 
                                 delete [] mapChangeMessageText;
                                 }
+                            
+                            addSharedMapChangeMessage( 
+                                &nearChanges,
+                                nextPlayer->birthPos.x,
+                                nextPlayer->birthPos.y,
+                                mapChangeMessage, mapChangeMessageLength );
                             }
-
                         
-                        if( mapChangeMessage != NULL ) {
 
-                            int numSent = 
-                                nextPlayer->sock->send( 
-                                    mapChangeMessage, 
-                                    mapChangeMessageLength, 
-                                    false, false );
-                            
-                            nextPlayer->gotPartOfThisFrame = true;
+                        int numSent = 
+                            sendToPlayerSocket( nextPlayer, 
+                                                mapChangeMessage, 
+                                                mapChangeMessageLength );
                             
-                            delete [] mapChangeMessage;
-
-                            if( numSent != mapChangeMessageLength ) {
-                                setPlayerDisconnected( nextPlayer, 
-                                                       "Socket write failed" );
-                                }
+                        nextPlayer->gotPartOfThisFrame = true;
+                        
+                        if( numSent != mapChangeMessageLength ) {
+                            setPlayerDisconnected( nextPlayer, 
+                                                   "Socket write failed" );
                             }
                         }
                     }
@@ -31265,10 +31720,9 @@ int main() {
                         
                         
                         int numSent = 
-                            nextPlayer->sock->send( 
+                            sendToPlayerSocket( nextPlayer, 
                                 message, 
-                                messageLen, 
-                                false, false );
+                                messageLen );
                         
                         delete [] message;
                         
@@ -31346,10 +31800,9 @@ int main() {
                             }
 
                         int numSent = 
-                            nextPlayer->sock->send( 
+                            sendToPlayerSocket( nextPlayer, 
                                 (unsigned char*)message,
-                                len, 
-                                false, false );
+                                len );
                         
                         delete [] message;
                         
@@ -31413,10 +31866,9 @@ int main() {
 
                     if( deleteUpdateMessage != NULL ) {
                         int numSent = 
-                            nextPlayer->sock->send( 
+                            sendToPlayerSocket( nextPlayer, 
                                 deleteUpdateMessage, 
-                                deleteUpdateMessageLength, 
-                                false, false );
+                                deleteUpdateMessageLength );
                     
                         nextPlayer->gotPartOfThisFrame = true;
                     
@@ -31434,10 +31886,9 @@ int main() {
                 // EVERYONE gets lineage info for new babies
                 if( lineageMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
+                        sendToPlayerSocket( nextPlayer, 
                             lineageMessage, 
-                            lineageMessageLength, 
-                            false, false );
+                            lineageMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -31455,10 +31906,9 @@ int main() {
                     nextPlayer->curseStatus.curseLevel == 0 ) {
 
                     int numSent = 
-                        nextPlayer->sock->send( 
+                        sendToPlayerSocket( nextPlayer, 
                             cursesMessage, 
-                            cursesMessageLength, 
-                            false, false );
+                            cursesMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -31471,10 +31921,9 @@ int main() {
                 // EVERYONE gets newly-given names
                 if( namesMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
+                        sendToPlayerSocket( nextPlayer, 
                             namesMessage, 
-                            namesMessageLength, 
-                            false, false );
+                            namesMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -31488,10 +31937,9 @@ int main() {
                 // EVERYONE gets following message
                 if( followingMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
+                        sendToPlayerSocket( nextPlayer, 
                             followingMessage, 
-                            followingMessageLength, 
-                            false, false );
+                            followingMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -31505,10 +31953,9 @@ int main() {
                 // EVERYONE gets exile message
                 if( exileMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
+                        sendToPlayerSocket( nextPlayer, 
                             exileMessage, 
-                            exileMessageLength, 
-                            false, false );
+                            exileMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -31581,10 +32028,9 @@ int main() {
                         int messageLength = strlen( foodMessage );
                         
                         int numSent = 
-                            nextPlayer->sock->send( 
+                            sendToPlayerSocket( nextPlayer, 
                                 (unsigned char*)foodMessage, 
-                                messageLength,
-                                false, false );
+                                messageLength );
                         
                         nextPlayer->gotPartOfThisFrame = true;
                         
@@ -31620,10 +32066,9 @@ int main() {
                     int messageLength = strlen( heatMessage );
                     
                     int numSent = 
-                         nextPlayer->sock->send( 
+                         sendToPlayerSocket( nextPlayer, 
                              (unsigned char*)heatMessage, 
-                             messageLength,
-                             false, false );
+                             messageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -31649,10 +32094,9 @@ int main() {
                     int messageLength = strlen( tokenMessage );
                     
                     int numSent = 
-                         nextPlayer->sock->send( 
+                         sendToPlayerSocket( nextPlayer, 
                              (unsigned char*)tokenMessage, 
-                             messageLength,
-                             false, false );
+                             messageLength );
 
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -31668,6 +32112,21 @@ int main() {
                 }
             }
 
+        // any not used (player disconnected during loop) are stale now
+        discardPrebuiltMapChunks();
+        
+        for( int p=0; p<numLive; p++ ) {
+            PlayerFrameMessages *m = &( frameMessages[p] );
+            
+            if( m->updateMessage != NULL ) {
+                delete [] m->updateMessage;
+                }
+            if( m->moveMessage != NULL ) {
+                delete [] m->moveMessage;
+                }
+            }
+        delete [] frameMessages;
+        
 
         for( int u=0; u<moveList.size(); u++ ) {
             MoveRecord *r = moveList.getElement( u );
@@ -31680,6 +32139,8 @@ int main() {
             MapChangeRecord *r = mapChanges.getElement( u );
             delete [] r->formatString;
             }
+        
+        clearMapChangeBroadcast();
 
         if( newUpdates.size() > 0 ) {
             
@@ -31777,10 +32238,9 @@ int main() {
             
             if( nextPlayer->gotPartOfThisFrame && nextPlayer->connected ) {
                 int numSent = 
-                    nextPlayer->sock->send( 
+                    sendToPlayerSocket( nextPlayer, 
                         (unsigned char*)frameMessage, 
-                        frameMessageLength,
-                        false, false );
+                        frameMessageLength );
 
                 if( numSent != frameMessageLength ) {
                     setPlayerDisconnected( nextPlayer, "Socket write failed" );
@@ -31789,6 +32249,8 @@ int main() {
             nextPlayer->gotPartOfThisFrame = false;
             }
         
+        flushOutboundQueues();
+        
 
         
         // handle closing any that have an error
@@ -31808,6 +32270,8 @@ int main() {
 
                 if( nextPlayer->sock != NULL ) {
                     sockPoll.removeSocket( nextPlayer->sock );
+                    
+                    nextPlayer->outQueue->flush( nextPlayer->sock );
                 
                     delete nextPlayer->sock;
                     nextPlayer->sock = NULL;
@@ -31818,6 +32282,8 @@ int main() {
                     nextPlayer->sockBuffer = NULL;
                     }
                 
+                delete nextPlayer->outQueue;
+                
                 delete nextPlayer->lineage;
                 
                 delete nextPlayer->ancestorIDs;
@@ -31883,7 +32349,12 @@ int main() {
                 delete nextPlayer->babyBirthTimes;
                 delete nextPlayer->babyIDs;
 
+                if( nextPlayer->chunkSentCache != NULL ) {
+                    freeChunkSentCache( nextPlayer->chunkSentCache );
+                    }
+
                 players.deleteElement( i );
+                deletePlayerFromGrid( i );
                 i--;
                 }
             }
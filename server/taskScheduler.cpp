@@ -0,0 +1,361 @@
+#include "taskScheduler.h"
+
+#include <atomic>
+#include <thread>
+
+#include <stdint.h>
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/BinarySemaphore.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/log/AppLog.h"
+
+
+
+// a range splits in half each time, so a deque never holds more than
+// about 32 ranges (one per halving of an int range)
+#define DEQUE_SIZE 64
+
+
+
+static uint64_t packRange( int inStart, int inEnd ) {
+    return ( (uint64_t)(uint32_t)inStart << 32 ) | (uint32_t)inEnd;
+    }
+
+
+static void unpackRange( uint64_t inRange, int *outStart, int *outEnd ) {
+    *outStart = (int)(uint32_t)( inRange >> 32 );
+    *outEnd = (int)(uint32_t)( inRange & 0xFFFFFFFF );
+    }
+
+
+
+// Chase-Lev deque of index ranges, fixed size
+//
+// owner pushes and pops at bottom, thieves steal from top
+// the only contention is over the last range, settled by a CAS on top
+class RangeDeque {
+    public:
+
+        RangeDeque()
+                : mTop( 0 ), mBottom( 0 ) {
+            }
+
+
+        // only called by owner
+        // returns false if full
+        char push( uint64_t inRange ) {
+            int64_t b = mBottom.load( std::memory_order_relaxed );
+            int64_t t = mTop.load( std::memory_order_acquire );
+
+            if( b - t >= DEQUE_SIZE ) {
+                return false;
+                }
+
+            mRanges[ b & ( DEQUE_SIZE - 1 ) ].store(
+                inRange, std::memory_order_relaxed );
+
+            mBottom.store( b + 1, std::memory_order_release );
+            return true;
+            }
+
+
+        // only called by owner
+        // returns false if empty
+        char pop( uint64_t *outRange ) {
+            int64_t b = mBottom.load( std::memory_order_relaxed ) - 1;
+
+            mBottom.store( b, std::memory_order_seq_cst );
+
+            int64_t t = mTop.load( std::memory_order_seq_cst );
+
+            if( t > b ) {
+                // empty
+                mBottom.store( b + 1, std::memory_order_relaxed );
+                return false;
+                }
+
+            *outRange = mRanges[ b & ( DEQUE_SIZE - 1 ) ].load(
+                std::memory_order_relaxed );
+
+            if( t == b ) {
+                // last one, race thieves for it
+                char won = mTop.compare_exchange_strong(
+                    t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed );
+
+                mBottom.store( b + 1, std::memory_order_relaxed );
+                return won;
+                }
+
+            return true;
+            }
+
+
+        // called by any thread
+        // returns false if empty or if another thread got there first
+        char steal( uint64_t *outRange ) {
+            int64_t t = mTop.load( std::memory_order_seq_cst );
+            int64_t b = mBottom.load( std::memory_order_seq_cst );
+
+            if( t >= b ) {
+                return false;
+                }
+
+            uint64_t range = mRanges[ t & ( DEQUE_SIZE - 1 ) ].load(
+                std::memory_order_relaxed );
+
+            if( ! mTop.compare_exchange_strong(
+                    t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed ) ) {
+                return false;
+                }
+
+            *outRange = range;
+            return true;
+            }
+
+
+    private:
+
+        std::atomic<int64_t> mTop;
+        std::atomic<int64_t> mBottom;
+
+        std::atomic<uint64_t> mRanges[ DEQUE_SIZE ];
+    };
+
+
+
+// deque 0 belongs to thread that calls parallelFor
+// deque i belongs to worker i - 1
+static RangeDeque *deques = NULL;
+static int numParticipants = 1;
+
+
+
+typedef struct ParallelJob {
+        void (*function)( int inIndex, void *inData );
+        void *data;
+        int grain;
+
+        // indices not yet run
+        std::atomic<int> numLeft;
+    } ParallelJob;
+
+
+static ParallelJob currentJob;
+
+
+// set while a parallelFor is using the workers
+static std::atomic<char> jobRunning( false );
+
+// workers that haven't checked out of current job yet
+static std::atomic<int> numWorkersInJob( 0 );
+
+// signaled by last worker to check out
+static BinarySemaphore workersDoneSemaphore;
+
+static char stopWorkers = false;
+
+
+
+// runs range, pushing back halves for others to steal until it
+// is no bigger than grain
+static void runRange( int inParticipant, uint64_t inRange ) {
+    int start, end;
+    unpackRange( inRange, &start, &end );
+
+    while( end - start > currentJob.grain ) {
+        int mid = start + ( end - start ) / 2;
+
+        if( ! deques[ inParticipant ].push( packRange( mid, end ) ) ) {
+            break;
+            }
+        end = mid;
+        }
+
+    for( int i=start; i<end; i++ ) {
+        currentJob.function( i, currentJob.data );
+        }
+
+    currentJob.numLeft.fetch_sub( end - start, std::memory_order_acq_rel );
+    }
+
+
+
+// works on current job until no indices are left
+static void workOnJob( int inParticipant ) {
+
+    int victim = inParticipant;
+
+    while( currentJob.numLeft.load( std::memory_order_acquire ) > 0 ) {
+        uint64_t range;
+
+        if( deques[ inParticipant ].pop( &range ) ) {
+            runRange( inParticipant, range );
+            continue;
+            }
+
+        // our deque is empty, look for work on others
+        char stole = false;
+
+        for( int i=1; i<numParticipants; i++ ) {
+            victim = ( victim + 1 ) % numParticipants;
+
+            if( victim == inParticipant ) {
+                continue;
+                }
+
+            if( deques[ victim ].steal( &range ) ) {
+                stole = true;
+                break;
+                }
+            }
+
+        if( stole ) {
+            runRange( inParticipant, range );
+            }
+        else {
+            // last ranges are still running somewhere
+            std::this_thread::yield();
+            }
+        }
+    }
+
+
+
+class TaskWorkerThread : public Thread {
+    public:
+
+        TaskWorkerThread( int inParticipant )
+                : mParticipant( inParticipant ) {
+            start();
+            }
+
+
+        void wake() {
+            mWakeSemaphore.signal();
+            }
+
+
+        virtual void run() {
+            while( true ) {
+                mWakeSemaphore.wait();
+
+                if( stopWorkers ) {
+                    return;
+                    }
+
+                workOnJob( mParticipant );
+
+                if( numWorkersInJob.fetch_sub(
+                        1, std::memory_order_acq_rel ) == 1 ) {
+                    workersDoneSemaphore.signal();
+                    }
+                }
+            }
+
+
+    private:
+
+        int mParticipant;
+
+        BinarySemaphore mWakeSemaphore;
+    };
+
+
+
+static SimpleVector<TaskWorkerThread*> workers;
+
+
+
+void initTaskScheduler( int inNumThreads ) {
+    if( inNumThreads < 0 ) {
+        inNumThreads = 0;
+        }
+
+    stopWorkers = false;
+
+    numParticipants = inNumThreads + 1;
+    deques = new RangeDeque[ numParticipants ];
+
+    for( int i=0; i<inNumThreads; i++ ) {
+        workers.push_back( new TaskWorkerThread( i + 1 ) );
+        }
+
+    if( inNumThreads > 0 ) {
+        AppLog::infoF( "Running parallel step phases on %d worker threads",
+                       inNumThreads );
+        }
+    }
+
+
+
+void freeTaskScheduler() {
+    stopWorkers = true;
+
+    for( int i=0; i<workers.size(); i++ ) {
+        TaskWorkerThread *t = workers.getElementDirect( i );
+        t->wake();
+        t->join();
+        delete t;
+        }
+    workers.deleteAll();
+
+    if( deques != NULL ) {
+        delete [] deques;
+        deques = NULL;
+        }
+    numParticipants = 1;
+    }
+
+
+
+int getNumTaskThreads() {
+    return workers.size();
+    }
+
+
+
+void parallelFor( int inCount,
+                  void (*inFunction)( int inIndex, void *inData ),
+                  void *inData,
+                  int inGrain ) {
+
+    if( inGrain < 1 ) {
+        inGrain = 1;
+        }
+
+    char expected = false;
+
+    if( workers.size() == 0 ||
+        inCount <= inGrain ||
+        ! jobRunning.compare_exchange_strong( expected, true ) ) {
+
+        for( int i=0; i<inCount; i++ ) {
+            inFunction( i, inData );
+            }
+        return;
+        }
+
+    currentJob.function = inFunction;
+    currentJob.data = inData;
+    currentJob.grain = inGrain;
+    currentJob.numLeft.store( inCount, std::memory_order_relaxed );
+
+    numWorkersInJob.store( workers.size(), std::memory_order_relaxed );
+
+    deques[0].push( packRange( 0, inCount ) );
+
+    for( int i=0; i<workers.size(); i++ ) {
+        workers.getElementDirect( i )->wake();
+        }
+
+    workOnJob( 0 );
+
+    // every index has run, but wait for workers to stop looking at
+    // deques and job before they can be reused
+    workersDoneSemaphore.wait();
+
+    jobRunning.store( false );
+    }
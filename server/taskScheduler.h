@@ -0,0 +1,61 @@
+#ifndef TASK_SCHEDULER_H_INCLUDED
+#define TASK_SCHEDULER_H_INCLUDED
+
+
+
+// Work-stealing pool for the parallel phases of a server step.
+//
+// A server step runs in phases:
+//
+//   1.  Serial:  read messages, apply actions, step the map, decay, kill
+//       states, and everything else that changes the world.  Order
+//       matters here, and map, database, and cache access is not
+//       thread-safe, so this all stays on the main thread.
+//
+//   2.  Serial gather:  copy what each player's work needs out of the
+//       world (map tiles around them, positions, biome heat).
+//
+//   3.  Parallel:  per-player work that only reads gathered data and
+//       only writes that player's own results (heat map math, building
+//       and compressing PU and PM messages).  This runs through parallelFor.
+//
+//   4.  Serial:  send results out through player sockets, in player order.
+//
+// Map chunk messages have their own pool (chunkBuilder), and map change
+// messages are already built once per step and shared (MX).
+//
+// parallelFor splits its index range in half over and over.  Each thread
+// keeps the halves it hasn't gotten to yet on its own lock-free deque,
+// working from the newest end, while idle threads steal from the oldest
+// end of other threads' deques, taking the biggest pieces first.
+
+
+
+// 0 threads means parallelFor runs everything on the calling thread
+void initTaskScheduler( int inNumThreads );
+
+// waits for worker threads to stop
+void freeTaskScheduler();
+
+
+int getNumTaskThreads();
+
+
+
+// calls inFunction once for each index in [0, inCount), spread over
+// worker threads and the calling thread, and returns once all calls
+// have returned
+//
+// ranges of inGrain indices or fewer are not split further
+//
+// only one parallelFor runs at a time.  A parallelFor called from inside
+// inFunction (or from a thread other than the one that started the
+// running one) runs inline.
+void parallelFor( int inCount,
+                  void (*inFunction)( int inIndex, void *inData ),
+                  void *inData,
+                  int inGrain = 1 );
+
+
+
+#endif
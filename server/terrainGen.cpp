@@ -0,0 +1,671 @@
+#include "terrainGen.h"
+
+#include "../commonSource/fractalNoise.h"
+
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+
+
+
+// inKnee in 0..inf, smaller values make harder knees
+// intput in 0..1
+// output in 0..1
+
+// from Simplest AI trick in the book:
+// Normalized Tunable SIgmoid Function
+// Dino Dini, GDC 2013
+static double sigmoid( double inInput, double inKnee ) {
+
+    // in -1,-1
+    double shiftedInput = inInput * 2 - 1;
+
+
+    double sign = 1;
+    if( shiftedInput < 0 ) {
+        sign = -1;
+        }
+
+
+    double k = -1 - inKnee;
+
+    double absInput = fabs( shiftedInput );
+
+    // out in -1..1
+    double out = sign * absInput * k / ( 1 + k - absInput );
+
+    return ( out + 1 ) * 0.5;
+    }
+
+
+
+
+int getTerrainSpecialBiomeForYBand( TerrainGenerator *inGen, int inY,
+                                    char *outOfBand ) {
+    if( outOfBand != NULL ) {
+        *outOfBand = false;
+        }
+
+    // new method, use y centers and thickness
+    int radius = inGen->specialBiomeBandThickness / 2;
+
+    for( int i=0; i<inGen->specialBiomeBandYCenter->size(); i++ ) {
+        int yCenter = inGen->specialBiomeBandYCenter->getElementDirect( i );
+
+        if( abs( inY - yCenter ) <= radius ) {
+            return inGen->specialBiomeBandIndexOrder->getElementDirect( i );
+            }
+        }
+
+
+    // else not in radius of any band
+    if( outOfBand != NULL ) {
+        *outOfBand = true;
+        }
+
+    return inGen->specialBiomeBandDefaultIndex;
+    }
+
+
+
+
+// noise fields used to pick biomes
+
+static XYRandomSeed getAltitudeSeed( TerrainGenerator *inGen ) {
+    return makeXYRandomSeed( inGen->biomeSeedA, inGen->biomeSeedB );
+    }
+
+static double getAltitudeScale( TerrainGenerator *inGen ) {
+    return 0.83332 + 0.08333 * inGen->numBiomes;
+    }
+
+
+static XYRandomSeed getPatchSeed( TerrainGenerator *inGen, int inBiomeIndex ) {
+    int biome = inGen->biomes[ inBiomeIndex ];
+
+    return makeXYRandomSeed( biome * 263 + inGen->biomeSeedA + 38475,
+                             inGen->biomeSeedB );
+    }
+
+static double getPatchScale( TerrainGenerator *inGen ) {
+    return 2.4999 + 0.2499 * inGen->numSpecialBiomes;
+    }
+
+
+
+// new code, topographic rings
+//
+// inAltitude is the altitude fractal at inX, inY
+//
+// inPatchValues has a region array of patch fractal values for each special
+// biome, or is NULL to compute them here for this cell only
+static int pickBiome( TerrainGenerator *inGen, int inX, int inY,
+                      double inAltitude,
+                      double **inPatchValues, int inCellIndex,
+                      int *outSecondPlace, double *outSecondPlaceGap ) {
+
+    int pickedBiome = -1;
+    int secondPlace = -1;
+    double secondPlaceGap = 0;
+
+    int numBiomes = inGen->numBiomes;
+    int regularBiomeLimit = inGen->regularBiomeLimit;
+
+
+    double randVal = inAltitude;
+
+    // push into range 0..1, based on sampled min/max values
+    randVal -= 0.099668;
+    randVal *= 1.268963;
+
+
+    float i = randVal * inGen->biomeTotalWeight;
+
+    pickedBiome = 0;
+    while( pickedBiome < numBiomes &&
+           i > inGen->biomeCumuWeights[pickedBiome] ) {
+        pickedBiome++;
+        }
+    if( pickedBiome >= numBiomes ) {
+        pickedBiome = numBiomes - 1;
+        }
+
+
+
+    if( pickedBiome >= regularBiomeLimit && inGen->numSpecialBiomes > 0 ) {
+        // special case:  on a peak, place a special biome here
+
+
+        if( inGen->specialBiomeBandMode ) {
+            // use band mode for these
+            pickedBiome = getTerrainSpecialBiomeForYBand( inGen, inY );
+
+            secondPlace = regularBiomeLimit - 1;
+            secondPlaceGap = 0.1;
+            }
+        else {
+            // use patches mode for these
+            pickedBiome = -1;
+
+
+            double maxValue = -10;
+            double secondMaxVal = -10;
+
+            for( int i=regularBiomeLimit; i<numBiomes; i++ ) {
+
+                double randVal;
+
+                if( inPatchValues != NULL ) {
+                    randVal =
+                        inPatchValues[ i - regularBiomeLimit ][ inCellIndex ];
+                    }
+                else {
+                    randVal = getXYFractal( getPatchSeed( inGen, i ),
+                                            inX,
+                                            inY,
+                                            0.55,
+                                            getPatchScale( inGen ) );
+                    }
+
+                if( randVal > maxValue ) {
+                    if( maxValue != -10 ) {
+                        secondMaxVal = maxValue;
+                        }
+                    maxValue = randVal;
+                    pickedBiome = i;
+                    }
+                }
+
+            if( maxValue - secondMaxVal < 0.03 ) {
+                // close!  that means we're on a boundary between special biomes
+
+                // stick last regular biome on this boundary, so special
+                // biomes never touch
+                secondPlace = pickedBiome;
+                secondPlaceGap = 0.1;
+                pickedBiome = regularBiomeLimit - 1;
+                }
+            else {
+                secondPlace = regularBiomeLimit - 1;
+                secondPlaceGap = 0.1;
+                }
+            }
+        }
+    else {
+        // second place for regular biome rings
+
+        secondPlace = pickedBiome - 1;
+        if( secondPlace < 0 ) {
+            secondPlace = pickedBiome + 1;
+            }
+        secondPlaceGap = 0.1;
+        }
+
+
+    if( ! inGen->allowSecondPlaceBiomes ) {
+        // make the gap ridiculously big, so that second-place placement
+        // never happens.
+        // but keep secondPlace set different from pickedBiome
+        // (elsewhere in code, we avoid placing animals if
+        // secondPlace == picked
+        secondPlaceGap = 10.0;
+        }
+
+    *outSecondPlace = secondPlace;
+    *outSecondPlaceGap = secondPlaceGap;
+
+    return pickedBiome;
+    }
+
+
+
+int getTerrainBiome( TerrainGenerator *inGen, int inX, int inY,
+                     int *outSecondPlace, double *outSecondPlaceGap ) {
+
+    // try topographical altitude mapping
+    double altitude = getXYFractal( getAltitudeSeed( inGen ), inX, inY,
+                                    0.55, getAltitudeScale( inGen ) );
+
+    return pickBiome( inGen, inX, inY, altitude, NULL, 0,
+                      outSecondPlace, outSecondPlaceGap );
+    }
+
+
+
+void getTerrainBiomeRegion( TerrainGenerator *inGen, int inX, int inY,
+                            int inWidth, int inHeight,
+                            int *outBiomes, int *outSecondPlaces,
+                            double *outSecondPlaceGaps ) {
+    int numCells = inWidth * inHeight;
+
+    if( numCells <= 0 ) {
+        return;
+        }
+
+    double *altitudes = new double[ numCells ];
+
+    getXYFractalRegion( getAltitudeSeed( inGen ), inX, inY, inWidth, inHeight,
+                        0.55, getAltitudeScale( inGen ), altitudes );
+
+
+    double **patchValues = NULL;
+
+    if( inGen->numSpecialBiomes > 0 && ! inGen->specialBiomeBandMode ) {
+        // only need patch fields if some cell lands on a peak
+        for( int c=0; c<numCells; c++ ) {
+            double randVal = altitudes[c];
+            randVal -= 0.099668;
+            randVal *= 1.268963;
+
+            float i = randVal * inGen->biomeTotalWeight;
+
+            int pickedBiome = 0;
+            while( pickedBiome < inGen->numBiomes &&
+                   i > inGen->biomeCumuWeights[pickedBiome] ) {
+                pickedBiome++;
+                }
+
+            if( pickedBiome >= inGen->regularBiomeLimit ) {
+                patchValues = new double*[ inGen->numSpecialBiomes ];
+
+                for( int s=0; s<inGen->numSpecialBiomes; s++ ) {
+                    patchValues[s] = new double[ numCells ];
+                    getXYFractalRegion(
+                        getPatchSeed( inGen, inGen->regularBiomeLimit + s ),
+                        inX, inY, inWidth, inHeight,
+                        0.55, getPatchScale( inGen ), patchValues[s] );
+                    }
+                break;
+                }
+            }
+        }
+
+
+    for( int y=0; y<inHeight; y++ ) {
+        for( int x=0; x<inWidth; x++ ) {
+            int c = y * inWidth + x;
+
+            outBiomes[c] = pickBiome( inGen, inX + x, inY + y, altitudes[c],
+                                      patchValues, c,
+                                      &( outSecondPlaces[c] ),
+                                      &( outSecondPlaceGaps[c] ) );
+            }
+        }
+
+    if( patchValues != NULL ) {
+        for( int s=0; s<inGen->numSpecialBiomes; s++ ) {
+            delete [] patchValues[s];
+            }
+        delete [] patchValues;
+        }
+    delete [] altitudes;
+    }
+
+
+
+
+// noise fields used to place objects
+
+#define DENSITY_SEED 5379
+#define DENSITY_ROUGHNESS 0.1
+#define DENSITY_SCALE 0.25
+
+#define PRESENCE_SEED 9877
+#define SECOND_PLACE_SEED 348763
+#define PICK_SEED 4593873
+
+
+
+static double densityFromFractal( double inFractal ) {
+    double density = inFractal;
+
+    // correction
+    density = sigmoid( density, 0.1 );
+
+    // scale
+    density *= .4;
+    // good for zoom in to map for teaser
+    //density = .70;
+
+    return density;
+    }
+
+
+
+// returns grid placement object at inX, inY, or -1 if no grid applies
+// looks up biome with inGetBiome, or takes it from inBiome if inGetBiome
+// is NULL
+// returns 0 if biome lookup fails
+static int getGridObject( TerrainGenerator *inGen, int inX, int inY,
+                          TerrainBiomeLookup inGetBiome,
+                          int inBiome ) {
+
+    SimpleVector<MapGridPlacement> *gridPlacements = inGen->gridPlacements;
+
+    for( int g=0; g < gridPlacements->size(); g++ ) {
+        MapGridPlacement *gp = gridPlacements->getElement( g );
+
+        /*
+        double gridWiggleX = getXYFractal( inX / gp->spacingX,
+                                           inY / gp->spacingY,
+                                           0.1, 0.25 );
+
+        double gridWiggleY = getXYFractal( inX / gp->spacingX,
+                                           inY / gp->spacingY + 392387,
+                                           0.1, 0.25 );
+        */
+        // turn wiggle off for now
+        double gridWiggleX = 0;
+        double gridWiggleY = 0;
+
+        if( ( inX + gp->phaseX + lrint( gridWiggleX * gp->wiggleScaleX ) )
+            % gp->spacingX == 0 &&
+            ( inY + gp->phaseY + lrint( gridWiggleY * gp->wiggleScaleY ) )
+            % gp->spacingY == 0 ) {
+
+            // hits this grid
+
+            // make sure this biome is on the list for this object
+            int pickedBiome = inBiome;
+
+            if( inGetBiome != NULL ) {
+                int secondPlace;
+                double secondPlaceGap;
+
+                pickedBiome = inGetBiome( inX, inY, &secondPlace,
+                                          &secondPlaceGap );
+                }
+
+            if( pickedBiome == -1 ) {
+                return 0;
+                }
+
+            if( gp->permittedBiomes.getElementIndex( pickedBiome ) != -1 ) {
+                return gp->id;
+                }
+            }
+        }
+
+    return -1;
+    }
+
+
+
+// picks natural object for a spot that passed the density test
+// in biomes picked for that spot
+static int pickNaturalObject( TerrainGenerator *inGen, int inX, int inY,
+                              int inPickedBiome,
+                              int inSecondPlace, double inSecondPlaceGap ) {
+
+    int pickedBiome = inPickedBiome;
+    int secondPlace = inSecondPlace;
+
+    // randomly let objects from second place biome peek through
+
+    // if gap is 0, this should happen 50 percent of the time
+
+    // if gap is 1.0, it should never happen
+
+    // larger values make second place less likely
+    double secondPlaceReduction = 10.0;
+
+    if( getXYRandom( makeXYRandomSeed( SECOND_PLACE_SEED ), inX, inY ) >
+        .5 + secondPlaceReduction * inSecondPlaceGap ) {
+
+        // note that ground shows the true, first-place biome, but object
+        // placement follows the second place biome
+        pickedBiome = secondPlace;
+        }
+
+
+    SimpleVector<int> *ids = &( inGen->naturalMapIDs[pickedBiome] );
+    SimpleVector<float> *chances = &( inGen->naturalMapChances[pickedBiome] );
+
+    int numObjects = ids->size();
+
+    if( numObjects == 0  ) {
+        return 0;
+        }
+
+
+
+    // something present here
+
+
+    // special object in this region is 10x more common than it
+    // would be otherwise
+
+
+    int specialObjectIndex = -1;
+    double maxValue = -DBL_MAX;
+
+
+    for( int i=0; i<numObjects; i++ ) {
+
+        double randVal = getXYFractal( makeXYRandomSeed( 793 * i + 123 ),
+                                       inX,
+                                       inY,
+                                       0.3,
+                                       0.15 + 0.016666 * numObjects );
+
+        if( randVal > maxValue ) {
+            maxValue = randVal;
+            specialObjectIndex = i;
+            }
+        }
+
+
+    // boost special object's chance, without changing the shared
+    // chance list
+    float oldSpecialChance = chances->getElementDirect( specialObjectIndex );
+
+    float newSpecialChance = oldSpecialChance * 10;
+
+    float totalChanceWeight = inGen->totalChanceWeight[pickedBiome];
+
+    totalChanceWeight -= oldSpecialChance;
+    totalChanceWeight += newSpecialChance;
+
+
+    // pick one of our natural objects at random
+
+    // pick value between 0 and total weight
+
+    double randValue =
+        totalChanceWeight *
+        getXYRandom( makeXYRandomSeed( PICK_SEED ), inX, inY );
+
+    // walk through objects, summing weights, until one crosses threshold
+    int i = 0;
+    float weightSum = 0;
+
+    while( weightSum < randValue && i < numObjects ) {
+        if( i == specialObjectIndex ) {
+            weightSum += newSpecialChance;
+            }
+        else {
+            weightSum += chances->getElementDirect( i );
+            }
+        i++;
+        }
+
+    i--;
+
+
+    if( i >= 0 ) {
+        int returnID = ids->getElementDirect( i );
+
+        if( pickedBiome == secondPlace ) {
+            // object peeking through from second place biome
+
+            // make sure it's not a moving object (animal)
+            // those are locked to their target biome only
+            if( inGen->naturalMapMoving[pickedBiome].getElementDirect( i ) ) {
+                // put empty tile there instead
+                returnID = 0;
+                }
+            }
+
+        return returnID;
+        }
+
+    return 0;
+    }
+
+
+
+static char isBeyondLimits( TerrainGenerator *inGen, int inX, int inY ) {
+    return ( inX > inGen->xLimit || inX < -inGen->xLimit ||
+             inY > inGen->yLimit || inY < -inGen->yLimit );
+    }
+
+
+
+int getTerrainObject( TerrainGenerator *inGen, int inX, int inY,
+                      TerrainBiomeLookup inGetBiome,
+                      char *outGridPlacement,
+                      int *outCheckedBiome ) {
+
+    if( outGridPlacement != NULL ) {
+        *outGridPlacement = false;
+        }
+    if( outCheckedBiome != NULL ) {
+        *outCheckedBiome = -1;
+        }
+
+    if( isBeyondLimits( inGen, inX, inY ) ) {
+        return inGen->edgeObjectID;
+        }
+
+    if( inGen->numBiomes == 0 ) {
+        return 0;
+        }
+
+
+    // see if any of our grids apply
+    int gridID = getGridObject( inGen, inX, inY, inGetBiome, -1 );
+
+    if( gridID != -1 ) {
+        if( gridID > 0 && outGridPlacement != NULL ) {
+            *outGridPlacement = true;
+            }
+        return gridID;
+        }
+
+
+    // first step:  save rest of work if density tells us that
+    // nothing is here anyway
+    double density =
+        densityFromFractal(
+            getXYFractal( makeXYRandomSeed( DENSITY_SEED ), inX, inY,
+                          DENSITY_ROUGHNESS, DENSITY_SCALE ) );
+
+    if( getXYRandom( makeXYRandomSeed( PRESENCE_SEED ), inX, inY )
+        >= density ) {
+        return 0;
+        }
+
+
+    // next step, pick top two biomes
+    int secondPlace;
+    double secondPlaceGap;
+
+    int pickedBiome = inGetBiome( inX, inY, &secondPlace, &secondPlaceGap );
+
+    if( pickedBiome == -1 ) {
+        return 0;
+        }
+
+    if( outCheckedBiome != NULL ) {
+        *outCheckedBiome = pickedBiome;
+        }
+
+    return pickNaturalObject( inGen, inX, inY, pickedBiome,
+                              secondPlace, secondPlaceGap );
+    }
+
+
+
+void getTerrainObjectRegion( TerrainGenerator *inGen, int inX, int inY,
+                             int inWidth, int inHeight,
+                             int *inBiomes, int *inSecondPlaces,
+                             double *inSecondPlaceGaps,
+                             int *outIDs, char *outGridPlacements ) {
+    int numCells = inWidth * inHeight;
+
+    if( numCells <= 0 ) {
+        return;
+        }
+
+    if( outGridPlacements != NULL ) {
+        for( int c=0; c<numCells; c++ ) {
+            outGridPlacements[c] = false;
+            }
+        }
+
+    if( inGen->numBiomes == 0 ) {
+        for( int c=0; c<numCells; c++ ) {
+            outIDs[c] = 0;
+            }
+        // edge still applies
+        }
+
+
+    double *density = new double[ numCells ];
+    double *presence = new double[ numCells ];
+
+    if( inGen->numBiomes > 0 ) {
+        getXYFractalRegion( makeXYRandomSeed( DENSITY_SEED ),
+                            inX, inY, inWidth, inHeight,
+                            DENSITY_ROUGHNESS, DENSITY_SCALE, density );
+
+        getXYRandomRegion( makeXYRandomSeed( PRESENCE_SEED ),
+                           inX, inY, inWidth, inHeight, presence );
+        }
+
+
+    for( int y=0; y<inHeight; y++ ) {
+        for( int x=0; x<inWidth; x++ ) {
+            int c = y * inWidth + x;
+            int cellX = inX + x;
+            int cellY = inY + y;
+
+            if( isBeyondLimits( inGen, cellX, cellY ) ) {
+                outIDs[c] = inGen->edgeObjectID;
+                continue;
+                }
+
+            if( inGen->numBiomes == 0 ) {
+                continue;
+                }
+
+            int gridID = getGridObject( inGen, cellX, cellY, NULL,
+                                        inBiomes[c] );
+
+            if( gridID != -1 ) {
+                if( gridID > 0 && outGridPlacements != NULL ) {
+                    outGridPlacements[c] = true;
+                    }
+                outIDs[c] = gridID;
+                continue;
+                }
+
+            if( presence[c] >= densityFromFractal( density[c] ) ) {
+                outIDs[c] = 0;
+                continue;
+                }
+
+            if( inBiomes[c] == -1 ) {
+                outIDs[c] = 0;
+                continue;
+                }
+
+            outIDs[c] = pickNaturalObject( inGen, cellX, cellY,
+                                           inBiomes[c], inSecondPlaces[c],
+                                           inSecondPlaceGaps[c] );
+            }
+        }
+
+    delete [] density;
+    delete [] presence;
+    }
@@ -0,0 +1,130 @@
+#ifndef TERRAIN_GEN_H_INCLUDED
+#define TERRAIN_GEN_H_INCLUDED
+
+
+#include <stdint.h>
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// Procedural generation of biomes and base map objects (what's on the map
+// before any player changes).
+//
+// Everything is computed from a TerrainGenerator, and nothing uses the
+// global fractal noise seed, so generators can be used from any thread, as
+// long as nothing changes them in the meantime.
+//
+// Per-cell and region calls give exactly the same results.  Region calls
+// evaluate the noise fields for a whole block at once, sharing work
+// between neighboring cells.
+//
+// Biomes are referred to by their index in the generator's biomes array.
+
+
+
+typedef struct MapGridPlacement {
+        int id;
+        int spacingX, spacingY;
+        int phaseX, phaseY;
+        int wiggleScaleX, wiggleScaleY;
+        SimpleVector<int> permittedBiomes;
+    } MapGridPlacement;
+
+
+
+// Points at the map's settings, which it owns
+typedef struct TerrainGenerator {
+        uint32_t biomeSeedA;
+        uint32_t biomeSeedB;
+
+        int numBiomes;
+        int *biomes;
+        float *biomeCumuWeights;
+        float biomeTotalWeight;
+
+        // biomes at this index and above are special
+        int regularBiomeLimit;
+        int numSpecialBiomes;
+
+        char specialBiomeBandMode;
+        int specialBiomeBandThickness;
+        // contains indices into biomes array instead of biome numbers
+        SimpleVector<int> *specialBiomeBandIndexOrder;
+        SimpleVector<int> *specialBiomeBandYCenter;
+        int specialBiomeBandDefaultIndex;
+
+        char allowSecondPlaceBiomes;
+
+        SimpleVector<MapGridPlacement> *gridPlacements;
+
+        // one vector per biome
+        SimpleVector<int> *naturalMapIDs;
+        SimpleVector<float> *naturalMapChances;
+        // true for objects that move on their own (animals), which
+        // can't peek through from a second place biome
+        SimpleVector<char> *naturalMapMoving;
+        float *totalChanceWeight;
+
+        // placed beyond limits
+        int edgeObjectID;
+        int xLimit;
+        int yLimit;
+    } TerrainGenerator;
+
+
+
+// for special biome bands
+// sets outOfBand to true if inY is outside of all bands
+int getTerrainSpecialBiomeForYBand( TerrainGenerator *inGen, int inY,
+                                    char *outOfBand = NULL );
+
+
+// gets biome index at inX, inY, along with second place biome index and
+// how close it came to winning (smaller gaps are closer)
+int getTerrainBiome( TerrainGenerator *inGen, int inX, int inY,
+                     int *outSecondPlace, double *outSecondPlaceGap );
+
+
+
+// where getTerrainObject gets biomes from, so that caller can cache them
+// or override them
+typedef int (*TerrainBiomeLookup)( int inX, int inY,
+                                   int *outSecondPlace,
+                                   double *outSecondPlaceGap );
+
+
+// gets base map object ID at inX, inY
+//
+// inGetBiome is only called when the biome is needed
+//
+// outGridPlacement set to whether object was placed by a grid
+// outCheckedBiome set to the first place biome index, if biome was
+//   looked up to place a natural object, or -1 otherwise
+int getTerrainObject( TerrainGenerator *inGen, int inX, int inY,
+                      TerrainBiomeLookup inGetBiome,
+                      char *outGridPlacement = NULL,
+                      int *outCheckedBiome = NULL );
+
+
+
+// region versions, filling inWidth * inHeight values for the block at
+// inX, inY, in row-major order
+
+void getTerrainBiomeRegion( TerrainGenerator *inGen, int inX, int inY,
+                            int inWidth, int inHeight,
+                            int *outBiomes, int *outSecondPlaces,
+                            double *outSecondPlaceGaps );
+
+
+// takes biomes for the region, as returned by getTerrainBiomeRegion, and
+// maybe adjusted by caller
+// outGridPlacements can be NULL
+void getTerrainObjectRegion( TerrainGenerator *inGen, int inX, int inY,
+                             int inWidth, int inHeight,
+                             int *inBiomes, int *inSecondPlaces,
+                             double *inSecondPlaceGaps,
+                             int *outIDs, char *outGridPlacements );
+
+
+#endif
@@ -0,0 +1,519 @@
+// checks that terrain generator gives exactly the same biomes and base map
+// objects as the old global-seed code from map.cpp, both one cell at a
+// time and for whole regions, and times each
+//
+// uses made-up biome and object settings, so it needs no data folders
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#include "terrainGen.h"
+#include "../commonSource/fractalNoise.h"
+
+#include "minorGems/system/Time.h"
+
+
+
+static TerrainGenerator gen;
+
+static int numMismatches = 0;
+
+
+
+// old getSpecialBiomeIndexForYBand from map.cpp
+static int getSpecialBiomeIndexForYBandOld( int inY ) {
+    
+    int radius = gen.specialBiomeBandThickness / 2;
+    
+    for( int i=0; i<gen.specialBiomeBandYCenter->size(); i++ ) {
+        int yCenter = gen.specialBiomeBandYCenter->getElementDirect( i );
+        
+        if( abs( inY - yCenter ) <= radius ) {
+            return gen.specialBiomeBandIndexOrder->getElementDirect( i );
+            }
+        }
+    
+    return gen.specialBiomeBandDefaultIndex;
+    }
+
+
+
+// old computeMapBiomeIndex from map.cpp, minus caching
+static int computeMapBiomeIndexOld( int inX, int inY,
+                                    int *outSecondPlaceIndex,
+                                    double *outSecondPlaceGap ) {
+    int secondPlace = -1;
+    double secondPlaceGap = 0;
+
+    int numBiomes = gen.numBiomes;
+    int regularBiomeLimit = gen.regularBiomeLimit;
+
+    setXYRandomSeed( gen.biomeSeedA, gen.biomeSeedB );
+
+    double randVal =
+        ( getXYFractal( inX, inY,
+                        0.55,
+                        0.83332 + 0.08333 * numBiomes ) );
+
+    randVal -= 0.099668;
+    randVal *= 1.268963;
+
+    float i = randVal * gen.biomeTotalWeight;
+
+    int pickedBiome = 0;
+    while( pickedBiome < numBiomes &&
+           i > gen.biomeCumuWeights[pickedBiome] ) {
+        pickedBiome++;
+        }
+    if( pickedBiome >= numBiomes ) {
+        pickedBiome = numBiomes - 1;
+        }
+
+    if( pickedBiome >= regularBiomeLimit && gen.numSpecialBiomes > 0 ) {
+
+        if( gen.specialBiomeBandMode ) {
+            pickedBiome = getSpecialBiomeIndexForYBandOld( inY );
+
+            secondPlace = regularBiomeLimit - 1;
+            secondPlaceGap = 0.1;
+            }
+        else {
+            pickedBiome = -1;
+
+            double maxValue = -10;
+            double secondMaxVal = -10;
+
+            for( int i=regularBiomeLimit; i<numBiomes; i++ ) {
+                int biome = gen.biomes[i];
+
+                setXYRandomSeed( biome * 263 + gen.biomeSeedA + 38475,
+                                 gen.biomeSeedB );
+
+                double randVal = getXYFractal(  inX,
+                                                inY,
+                                                0.55,
+                                                2.4999 +
+                                                0.2499 *
+                                                gen.numSpecialBiomes );
+
+                if( randVal > maxValue ) {
+                    if( maxValue != -10 ) {
+                        secondMaxVal = maxValue;
+                        }
+                    maxValue = randVal;
+                    pickedBiome = i;
+                    }
+                }
+
+            if( maxValue - secondMaxVal < 0.03 ) {
+                secondPlace = pickedBiome;
+                secondPlaceGap = 0.1;
+                pickedBiome = regularBiomeLimit - 1;
+                }
+            else {
+                secondPlace = regularBiomeLimit - 1;
+                secondPlaceGap = 0.1;
+                }
+            }
+        }
+    else {
+        secondPlace = pickedBiome - 1;
+        if( secondPlace < 0 ) {
+            secondPlace = pickedBiome + 1;
+            }
+        secondPlaceGap = 0.1;
+        }
+
+    if( ! gen.allowSecondPlaceBiomes ) {
+        secondPlaceGap = 10.0;
+        }
+
+    *outSecondPlaceIndex = secondPlace;
+    *outSecondPlaceGap = secondPlaceGap;
+
+    return pickedBiome;
+    }
+
+
+
+static double sigmoidOld( double inInput, double inKnee ) {
+    double shiftedInput = inInput * 2 - 1;
+
+    double sign = 1;
+    if( shiftedInput < 0 ) {
+        sign = -1;
+        }
+
+    double k = -1 - inKnee;
+
+    double absInput = fabs( shiftedInput );
+
+    double out = sign * absInput * k / ( 1 + k - absInput );
+
+    return ( out + 1 ) * 0.5;
+    }
+
+
+
+// old getBaseMap from map.cpp, minus caching, including the temporary
+// change to the shared chance lists
+static int getBaseMapOld( int inX, int inY, char *outGridPlacement ) {
+
+    *outGridPlacement = false;
+
+    if( inX > gen.xLimit || inX < -gen.xLimit ||
+        inY > gen.yLimit || inY < -gen.yLimit ) {
+        return gen.edgeObjectID;
+        }
+
+    for( int g=0; g < gen.gridPlacements->size(); g++ ) {
+        MapGridPlacement *gp = gen.gridPlacements->getElement( g );
+
+        if( ( inX + gp->phaseX ) % gp->spacingX == 0 &&
+            ( inY + gp->phaseY ) % gp->spacingY == 0 ) {
+
+            int secondPlace;
+            double secondPlaceGap;
+
+            int pickedBiome = computeMapBiomeIndexOld( inX, inY,
+                                                       &secondPlace,
+                                                       &secondPlaceGap );
+            if( pickedBiome == -1 ) {
+                return 0;
+                }
+
+            if( gp->permittedBiomes.getElementIndex( pickedBiome ) != -1 ) {
+                *outGridPlacement = true;
+                return gp->id;
+                }
+            }
+        }
+
+    setXYRandomSeed( 5379 );
+
+    double density = getXYFractal( inX, inY, 0.1, 0.25 );
+    density = sigmoidOld( density, 0.1 );
+    density *= .4;
+
+    setXYRandomSeed( 9877 );
+
+    if( getXYRandom( inX, inY ) < density ) {
+        int secondPlace;
+        double secondPlaceGap;
+
+        int pickedBiome = computeMapBiomeIndexOld( inX, inY, &secondPlace,
+                                                   &secondPlaceGap );
+        if( pickedBiome == -1 ) {
+            return 0;
+            }
+
+        setXYRandomSeed( 348763 );
+
+        if( getXYRandom( inX, inY ) > .5 + 10.0 * secondPlaceGap ) {
+            pickedBiome = secondPlace;
+            }
+
+        SimpleVector<float> *chances = &( gen.naturalMapChances[pickedBiome] );
+
+        int numObjects = gen.naturalMapIDs[pickedBiome].size();
+
+        if( numObjects == 0  ) {
+            return 0;
+            }
+
+        int specialObjectIndex = -1;
+        double maxValue = -DBL_MAX;
+
+        for( int i=0; i<numObjects; i++ ) {
+            setXYRandomSeed( 793 * i + 123 );
+
+            double randVal = getXYFractal(  inX,
+                                            inY,
+                                            0.3,
+                                            0.15 + 0.016666 * numObjects );
+            if( randVal > maxValue ) {
+                maxValue = randVal;
+                specialObjectIndex = i;
+                }
+            }
+
+        float oldSpecialChance =
+            chances->getElementDirect( specialObjectIndex );
+        float newSpecialChance = oldSpecialChance * 10;
+
+        *( chances->getElement( specialObjectIndex ) ) = newSpecialChance;
+
+        float oldTotalChanceWeight = gen.totalChanceWeight[pickedBiome];
+
+        gen.totalChanceWeight[pickedBiome] -= oldSpecialChance;
+        gen.totalChanceWeight[pickedBiome] += newSpecialChance;
+
+        setXYRandomSeed( 4593873 );
+
+        double randValue =
+            gen.totalChanceWeight[pickedBiome] * getXYRandom( inX, inY );
+
+        int i = 0;
+        float weightSum = 0;
+
+        while( weightSum < randValue && i < numObjects ) {
+            weightSum += chances->getElementDirect( i );
+            i++;
+            }
+
+        i--;
+
+        *( chances->getElement( specialObjectIndex ) ) = oldSpecialChance;
+        gen.totalChanceWeight[pickedBiome] = oldTotalChanceWeight;
+
+        if( i >= 0 ) {
+            int returnID = gen.naturalMapIDs[pickedBiome].getElementDirect( i );
+
+            if( pickedBiome == secondPlace ) {
+                if( gen.naturalMapMoving[pickedBiome].getElementDirect( i ) ) {
+                    returnID = 0;
+                    }
+                }
+            return returnID;
+            }
+        return 0;
+        }
+
+    return 0;
+    }
+
+
+
+static int lookupBiome( int inX, int inY, int *outSecondPlace,
+                        double *outSecondPlaceGap ) {
+    return getTerrainBiome( &gen, inX, inY, outSecondPlace,
+                            outSecondPlaceGap );
+    }
+
+
+
+#define MAX_BIOMES 8
+
+static int biomes[ MAX_BIOMES ];
+static float biomeCumuWeights[ MAX_BIOMES ];
+
+static SimpleVector<int> bandIndexOrder;
+static SimpleVector<int> bandYCenter;
+static SimpleVector<MapGridPlacement> gridPlacements;
+
+static SimpleVector<int> naturalMapIDs[ MAX_BIOMES ];
+static SimpleVector<float> naturalMapChances[ MAX_BIOMES ];
+static SimpleVector<char> naturalMapMoving[ MAX_BIOMES ];
+static float totalChanceWeight[ MAX_BIOMES ];
+
+
+
+static void setupGenerator( int inNumBiomes, int inNumSpecial,
+                            char inBandMode, char inAllowSecondPlace,
+                            uint32_t inSeedA, uint32_t inSeedB ) {
+    gen.biomeSeedA = inSeedA;
+    gen.biomeSeedB = inSeedB;
+
+    gen.numBiomes = inNumBiomes;
+    gen.biomes = biomes;
+    gen.biomeCumuWeights = biomeCumuWeights;
+
+    float total = 0;
+    for( int i=0; i<inNumBiomes; i++ ) {
+        biomes[i] = i * 2 + 1;
+        total += 0.1 + 0.05 * i;
+        biomeCumuWeights[i] = total;
+        }
+    gen.biomeTotalWeight = total;
+
+    gen.numSpecialBiomes = inNumSpecial;
+    gen.regularBiomeLimit = inNumBiomes - inNumSpecial;
+
+    gen.specialBiomeBandMode = inBandMode;
+    gen.specialBiomeBandThickness = 60;
+
+    bandIndexOrder.deleteAll();
+    bandYCenter.deleteAll();
+    for( int i=0; i<inNumSpecial; i++ ) {
+        bandIndexOrder.push_back( gen.regularBiomeLimit + i );
+        bandYCenter.push_back( -100 + 70 * i );
+        }
+    gen.specialBiomeBandIndexOrder = &bandIndexOrder;
+    gen.specialBiomeBandYCenter = &bandYCenter;
+    gen.specialBiomeBandDefaultIndex = 0;
+
+    gen.allowSecondPlaceBiomes = inAllowSecondPlace;
+
+    gridPlacements.deleteAll();
+    MapGridPlacement gp = { 9000, 7, 5, 2, 1, 4, 4, SimpleVector<int>() };
+    gp.permittedBiomes.push_back( 0 );
+    gp.permittedBiomes.push_back( 2 );
+    gridPlacements.push_back( gp );
+    gen.gridPlacements = &gridPlacements;
+
+    for( int b=0; b<inNumBiomes; b++ ) {
+        naturalMapIDs[b].deleteAll();
+        naturalMapChances[b].deleteAll();
+        naturalMapMoving[b].deleteAll();
+        totalChanceWeight[b] = 0;
+
+        // leave one biome empty
+        int numObjects = ( b == 1 ) ? 0 : 3 + b * 2;
+
+        for( int o=0; o<numObjects; o++ ) {
+            float p = 0.01f + 0.037f * ( ( o * 7 + b ) % 5 );
+
+            naturalMapIDs[b].push_back( 100 * ( b + 1 ) + o );
+            naturalMapChances[b].push_back( p );
+            naturalMapMoving[b].push_back( o % 3 == 0 );
+            totalChanceWeight[b] += p;
+            }
+        }
+    gen.naturalMapIDs = naturalMapIDs;
+    gen.naturalMapChances = naturalMapChances;
+    gen.naturalMapMoving = naturalMapMoving;
+    gen.totalChanceWeight = totalChanceWeight;
+
+    gen.edgeObjectID = 55;
+    gen.xLimit = 2147481977;
+    gen.yLimit = 2147481977;
+    }
+
+
+
+static void checkRegion( const char *inName, int inX, int inY,
+                         int inWidth, int inHeight ) {
+    int numCells = inWidth * inHeight;
+
+    int *oldBiomes = new int[ numCells ];
+    int *oldSecond = new int[ numCells ];
+    double *oldGaps = new double[ numCells ];
+    int *oldIDs = new int[ numCells ];
+    char *oldGrid = new char[ numCells ];
+
+    int *newIDs = new int[ numCells ];
+    char *newGrid = new char[ numCells ];
+
+    int *regionBiomes = new int[ numCells ];
+    int *regionSecond = new int[ numCells ];
+    double *regionGaps = new double[ numCells ];
+    int *regionIDs = new int[ numCells ];
+    char *regionGrid = new char[ numCells ];
+
+
+    double startTime = Time::getCurrentTime();
+
+    for( int y=0; y<inHeight; y++ ) {
+        for( int x=0; x<inWidth; x++ ) {
+            int c = y * inWidth + x;
+            oldBiomes[c] = computeMapBiomeIndexOld( inX + x, inY + y,
+                                                    &( oldSecond[c] ),
+                                                    &( oldGaps[c] ) );
+            oldIDs[c] = getBaseMapOld( inX + x, inY + y, &( oldGrid[c] ) );
+            }
+        }
+
+    double oldTime = Time::getCurrentTime() - startTime;
+
+
+    startTime = Time::getCurrentTime();
+
+    for( int y=0; y<inHeight; y++ ) {
+        for( int x=0; x<inWidth; x++ ) {
+            int c = y * inWidth + x;
+            int second;
+            double gap;
+            int biome = getTerrainBiome( &gen, inX + x, inY + y,
+                                         &second, &gap );
+
+            if( biome != oldBiomes[c] || second != oldSecond[c] ||
+                gap != oldGaps[c] ) {
+                numMismatches++;
+                }
+
+            newIDs[c] = getTerrainObject( &gen, inX + x, inY + y,
+                                          lookupBiome, &( newGrid[c] ) );
+            }
+        }
+
+    double newTime = Time::getCurrentTime() - startTime;
+
+
+    startTime = Time::getCurrentTime();
+
+    getTerrainBiomeRegion( &gen, inX, inY, inWidth, inHeight,
+                           regionBiomes, regionSecond, regionGaps );
+
+    getTerrainObjectRegion( &gen, inX, inY, inWidth, inHeight,
+                            regionBiomes, regionSecond, regionGaps,
+                            regionIDs, regionGrid );
+
+    double regionTime = Time::getCurrentTime() - startTime;
+
+
+    int regionMismatches = 0;
+
+    for( int c=0; c<numCells; c++ ) {
+        if( newIDs[c] != oldIDs[c] || newGrid[c] != oldGrid[c] ) {
+            numMismatches++;
+            }
+        if( regionBiomes[c] != oldBiomes[c] ||
+            regionSecond[c] != oldSecond[c] ||
+            regionGaps[c] != oldGaps[c] ||
+            regionIDs[c] != oldIDs[c] ||
+            regionGrid[c] != oldGrid[c] ) {
+            regionMismatches++;
+            }
+        }
+    numMismatches += regionMismatches;
+
+    printf( "%-28s %4dx%-4d at (%d,%d):  old %.3fs, per-cell %.3fs, "
+            "region %.3fs  (%d region mismatches)\n",
+            inName, inWidth, inHeight, inX, inY,
+            oldTime, newTime, regionTime, regionMismatches );
+
+    delete [] oldBiomes;
+    delete [] oldSecond;
+    delete [] oldGaps;
+    delete [] oldIDs;
+    delete [] oldGrid;
+    delete [] newIDs;
+    delete [] newGrid;
+    delete [] regionBiomes;
+    delete [] regionSecond;
+    delete [] regionGaps;
+    delete [] regionIDs;
+    delete [] regionGrid;
+    }
+
+
+
+int main() {
+
+    setupGenerator( 7, 3, false, true, 727, 941 );
+    checkRegion( "patches, second place", -200, -150, 400, 300 );
+    checkRegion( "patches, far away", 2000000000, -1999999000, 128, 128 );
+    checkRegion( "patches, chunk", 13, -9, 32, 30 );
+
+    setupGenerator( 7, 3, true, true, 3829471, 12 );
+    checkRegion( "bands, second place", -200, -150, 400, 300 );
+
+    setupGenerator( 5, 0, false, false, 99, 0 );
+    checkRegion( "no specials, no second", -50, 1000, 256, 256 );
+
+    // near edge of map
+    setupGenerator( 6, 2, false, true, 1, 2 );
+    gen.xLimit = 40;
+    checkRegion( "patches, past edge", 20, 0, 64, 16 );
+
+
+    if( numMismatches > 0 ) {
+        printf( "FAILED:  %d mismatches\n", numMismatches );
+        return 1;
+        }
+
+    printf( "All cells match\n" );
+    return 0;
+    }
@@ -0,0 +1,338 @@
+// times getTrans against the linear usesMap scan that it replaced,
+// over every transition in the data folders next to it
+//
+// run from a folder with objects, categories, transitions, etc.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../gameSource/objectBank.h"
+#include "../gameSource/transitionBank.h"
+#include "../gameSource/categoryBank.h"
+#include "../gameSource/animationBank.h"
+
+#include "minorGems/system/Time.h"
+
+
+
+typedef struct TransKey {
+        int actor;
+        int target;
+        char lastUseActor;
+        char lastUseTarget;
+    } TransKey;
+
+
+
+// old getTrans implementation
+static TransRecord *getTransLinear( int inActor, int inTarget, 
+                                    char inLastUseActor,
+                                    char inLastUseTarget ) {
+    int mapIndex = inTarget;
+    
+    if( mapIndex < 0 ) {
+        mapIndex = inActor;
+        }
+    
+    if( mapIndex < 0 ) {
+        return NULL;
+        }
+
+    SimpleVector<TransRecord*> *uses = getAllUses( mapIndex );
+    
+    if( uses == NULL ) {
+        return NULL;
+        }
+    
+    int numRecords = uses->size();
+    
+    for( int i=0; i<numRecords; i++ ) {
+        
+        TransRecord *r = uses->getElementDirect(i);
+        
+        if( r->actor == inActor && r->target == inTarget &&
+            r->lastUseActor == inLastUseActor &&
+            r->lastUseTarget == inLastUseTarget ) {
+            return r;
+            }
+        }
+    
+    return NULL;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+    
+    int numRounds = 100;
+    
+    if( inNumArgs > 1 ) {
+        sscanf( inArgs[1], "%d", &numRounds );
+        }
+
+    char rebuilding;
+    
+    initAnimationBankStart( &rebuilding );
+    while( initAnimationBankStep() < 1.0 );
+    initAnimationBankFinish();
+
+    initObjectBankStart( &rebuilding, true, true );
+    while( initObjectBankStep() < 1.0 );
+    initObjectBankFinish();
+
+    
+    initCategoryBankStart( &rebuilding );
+    while( initCategoryBankStep() < 1.0 );
+    initCategoryBankFinish();
+
+
+    // auto-generate category-based transitions, same as server
+    initTransBankStart( &rebuilding, true, true, true, true );
+    while( initTransBankStep() < 1.0 );
+    initTransBankFinish();
+    
+
+    // every key that hits, plus one that misses for each
+    // (server asks about plenty of pairs that have no transition)
+    SimpleVector<TransKey> keys;
+    
+    int maxID = getMaxObjectID();
+    
+    for( int id=0; id<=maxID; id++ ) {
+        SimpleVector<TransRecord*> *uses = getAllUses( id );
+        
+        if( uses == NULL ) {
+            continue;
+            }
+        
+        for( int i=0; i<uses->size(); i++ ) {
+            TransRecord *r = uses->getElementDirect( i );
+            
+            TransKey k = { r->actor, r->target, 
+                           r->lastUseActor, r->lastUseTarget };
+            keys.push_back( k );
+            
+            k.actor = maxID - r->actor;
+            keys.push_back( k );
+            }
+        }
+    
+    int numKeys = keys.size();
+    
+    printf( "Looking up %d keys %d times\n", numKeys, numRounds );
+
+
+    int numMismatches = 0;
+
+    for( int i=0; i<numKeys; i++ ) {
+        TransKey k = keys.getElementDirect( i );
+        
+        if( getTrans( k.actor, k.target, k.lastUseActor, k.lastUseTarget ) !=
+            getTransLinear( k.actor, k.target, 
+                            k.lastUseActor, k.lastUseTarget ) ) {
+            numMismatches++;
+            }
+        }
+
+    
+    // sum found pointers so loops aren't optimized away
+    unsigned long checksum = 0;
+    
+    double startTime = Time::getCurrentTime();
+    
+    for( int n=0; n<numRounds; n++ ) {
+        for( int i=0; i<numKeys; i++ ) {
+            TransKey *k = keys.getElement( i );
+            
+            checksum += (unsigned long)getTransLinear( k->actor, k->target, 
+                                                       k->lastUseActor,
+                                                       k->lastUseTarget );
+            }
+        }
+    
+    double linearTime = Time::getCurrentTime() - startTime;
+    
+    
+    startTime = Time::getCurrentTime();
+    
+    for( int n=0; n<numRounds; n++ ) {
+        for( int i=0; i<numKeys; i++ ) {
+            TransKey *k = keys.getElement( i );
+            
+            checksum -= (unsigned long)getTrans( k->actor, k->target, 
+                                                 k->lastUseActor,
+                                                 k->lastUseTarget );
+            }
+        }
+    
+    double tableTime = Time::getCurrentTime() - startTime;
+    
+
+    double numLookups = (double)numKeys * numRounds;
+    
+    if( numLookups > 0 ) {
+        printf( "Linear scan:  %.3f s (%.1f ns per lookup)\n", 
+                linearTime, 1e9 * linearTime / numLookups );
+        printf( "Hash table:   %.3f s (%.1f ns per lookup)\n", 
+                tableTime, 1e9 * tableTime / numLookups );
+        }
+    
+    printf( "%d mismatches, checksum %lu\n", numMismatches, checksum );
+    
+
+    freeTransBank();
+    freeCategoryBank();
+    freeObjectBank();
+    freeAnimationBank();
+    
+    if( numMismatches > 0 || checksum != 0 ) {
+        return 1;
+        }
+    return 0;
+    }
+
+
+
+
+// implement null versions of these to allow a headless build
+// we never call drawObject, but we need to use other objectBank functions
+
+
+void *getSprite( int ) {
+    return NULL;
+    }
+
+char *getSpriteTag( int ) {
+    return NULL;
+    }
+
+char isSpriteBankLoaded() {
+    return false;
+    }
+
+char markSpriteLive( int ) {
+    return false;
+    }
+
+void stepSpriteBank() {
+    }
+
+void drawSprite( void*, doublePair, double, double, char ) {
+    }
+
+void setDrawColor( float inR, float inG, float inB, float inA ) {
+    }
+
+void setDrawColor( FloatColor inColor ) {
+    }
+
+FloatColor getDrawColor() {
+    FloatColor c = { 1, 1, 1, 1 };
+    return c;
+    }
+
+void setDrawFade( float ) {
+    }
+
+float getTotalGlobalFade() {
+    return 1.0f;
+    }
+
+void toggleAdditiveTextureColoring( char inAdditive ) {
+    }
+
+void toggleAdditiveBlend( char ) {
+    }
+
+void toggleInvertedBlend( char ) {
+    }
+
+void drawSquare( doublePair, double ) {
+    }
+
+void drawRect( doublePair, double, double ) {
+    }
+
+void startAddingToStencil( char, char, float ) {
+    }
+
+void startDrawingThroughStencil( char ) {
+    }
+
+void stopStencil() {
+    }
+
+
+
+
+
+// dummy implementations of these functions, which are used in editor
+// and client, but not server
+#include "../gameSource/spriteBank.h"
+SpriteRecord *getSpriteRecord( int inSpriteID ) {
+    return NULL;
+    }
+
+#include "../gameSource/soundBank.h"
+void checkIfSoundStillNeeded( int inID ) {
+    }
+
+
+
+char getSpriteHit( int inID, int inXCenterOffset, int inYCenterOffset ) {
+    return false;
+    }
+
+
+char getUsesMultiplicativeBlending( int inID ) {
+    return false;
+    }
+
+
+
+char getNoFlip( int inID ) {
+    return false;
+    }
+
+
+
+void toggleMultiplicativeBlend( char inMultiplicative ) {
+    }
+
+
+void countLiveUse( SoundUsage inUsage ) {
+    }
+
+void unCountLiveUse( SoundUsage inUsage ) {
+    }
+
+
+
+// animation bank calls these only if lip sync hack is enabled, which
+// it never is for server
+void *loadSpriteBase( const char*, char ) {
+    return NULL;
+    }
+
+void freeSprite( void* ) {
+    }
+
+void startOutputAllFrames() {
+    }
+
+void stopOutputAllFrames() {
+    }
+
+
+char realSpriteBank() {
+    return false;
+    }
+
+
+
+
+// object and animation banks scale drawing by this client mod table,
+// which is never set up outside of the client
+#include "../gameSource/hetuwmod.h"
+double *HetuwMod::objectDrawScale = NULL;